@@ -35,6 +35,7 @@ struct DDS_PIXELFORMAT
 #define DDS_RGB         0x00000040  // DDPF_RGB
 #define DDS_RGBA        0x00000041  // DDPF_RGB | DDPF_ALPHAPIXELS
 #define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_LUMINANCEA  0x00020001  // DDPF_LUMINANCE | DDPF_ALPHAPIXELS
 #define DDS_ALPHA       0x00000002  // DDPF_ALPHA
 
 const DDS_PIXELFORMAT DDSPF_DXT1 =
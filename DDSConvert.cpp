@@ -0,0 +1,635 @@
+//--------------------------------------------------------------------------------------
+// File: DDSConvert.cpp
+//
+// CPU-side pixel and block conversion helpers used by the DDS loader and writer
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DDSConvert.h"
+#include <emmintrin.h>
+
+//--------------------------------------------------------------------------------------
+// Return the BPP for a particular format
+//--------------------------------------------------------------------------------------
+UINT BitsPerPixel( DXGI_FORMAT fmt )
+{
+    switch( fmt )
+    {
+    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+    case DXGI_FORMAT_R32G32B32A32_SINT:
+        return 128;
+
+    case DXGI_FORMAT_R32G32B32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_UINT:
+    case DXGI_FORMAT_R32G32B32_SINT:
+        return 96;
+
+    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_UINT:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:
+    case DXGI_FORMAT_R16G16B16A16_SINT:
+    case DXGI_FORMAT_R32G32_TYPELESS:
+    case DXGI_FORMAT_R32G32_FLOAT:
+    case DXGI_FORMAT_R32G32_UINT:
+    case DXGI_FORMAT_R32G32_SINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        return 64;
+
+    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UINT:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_R8G8B8A8_UINT:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_R8G8B8A8_SINT:
+    case DXGI_FORMAT_R16G16_TYPELESS:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_UINT:
+    case DXGI_FORMAT_R16G16_SNORM:
+    case DXGI_FORMAT_R16G16_SINT:
+    case DXGI_FORMAT_R32_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R32_SINT:
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        return 32;
+
+    case DXGI_FORMAT_R8G8_TYPELESS:
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R8G8_UINT:
+    case DXGI_FORMAT_R8G8_SNORM:
+    case DXGI_FORMAT_R8G8_SINT:
+    case DXGI_FORMAT_R16_TYPELESS:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_D16_UNORM:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_R16_SNORM:
+    case DXGI_FORMAT_R16_SINT:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+        return 16;
+
+    case DXGI_FORMAT_R8_TYPELESS:
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R8_UINT:
+    case DXGI_FORMAT_R8_SNORM:
+    case DXGI_FORMAT_R8_SINT:
+    case DXGI_FORMAT_A8_UNORM:
+        return 8;
+
+    case DXGI_FORMAT_R1_UNORM:
+        return 1;
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+        return 4;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 8;
+
+    // Callers such as the writer check for 0 and reject the format
+    default:
+        return 0;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+bool IsCompressed( DXGI_FORMAT fmt )
+{
+    switch( fmt )
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Get surface information for a particular format
+//--------------------------------------------------------------------------------------
+void GetSurfaceInfo( UINT width, UINT height, DXGI_FORMAT fmt, UINT* pNumBytes, UINT* pRowBytes, UINT* pNumRows )
+{
+    UINT numBytes = 0;
+    UINT rowBytes = 0;
+    UINT numRows = 0;
+
+    bool bc = true;
+    int bcnumBytesPerBlock = 16;
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        bcnumBytesPerBlock = 8;
+        break;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        break;
+
+    default:
+        bc = false;
+        break;
+    }
+
+    if( bc )
+    {
+        // Partial blocks at the right and bottom edges still take a full block
+        int numBlocksWide = 0;
+        if( width > 0 )
+            numBlocksWide = max( 1, ( width + 3 ) / 4 );
+        int numBlocksHigh = 0;
+        if( height > 0 )
+            numBlocksHigh = max( 1, ( height + 3 ) / 4 );
+        rowBytes = numBlocksWide * bcnumBytesPerBlock;
+        numRows = numBlocksHigh;
+    }
+    else
+    {
+        UINT bpp = BitsPerPixel( fmt );
+        rowBytes = ( width * bpp + 7 ) / 8; // round up to nearest byte
+        numRows = height;
+    }
+    numBytes = rowBytes * numRows;
+    if( pNumBytes != NULL )
+        *pNumBytes = numBytes;
+    if( pRowBytes != NULL )
+        *pRowBytes = rowBytes;
+    if( pNumRows != NULL )
+        *pNumRows = numRows;
+}
+
+
+//--------------------------------------------------------------------------------------
+// c * a / 255, rounded, without a divide
+//--------------------------------------------------------------------------------------
+static inline BYTE MulDiv255( UINT c, UINT a )
+{
+    UINT t = c * a + 128;
+    return ( BYTE )( ( t + ( t >> 8 ) ) >> 8 );
+}
+
+//--------------------------------------------------------------------------------------
+void SwizzleBGRA8ToRGBA8( BYTE* pPixels, SIZE_T NumPixels, bool bOpaque )
+{
+    DWORD* p = ( DWORD* )pPixels;
+    DWORD alpha = bOpaque ? 0xff000000 : 0;
+    for( SIZE_T i = 0; i < NumPixels; i++ )
+    {
+        DWORD c = p[i];
+        p[i] = ( c & 0xff00ff00 ) | ( ( c >> 16 ) & 0xff ) | ( ( c & 0xff ) << 16 ) | alpha;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void PremultiplyAlphaRGBA8( BYTE* pPixels, SIZE_T NumPixels )
+{
+    SIZE_T i = 0;
+
+    // Four pixels per iteration. Each half is widened to 16 bits, multiplied by its
+    // alpha splatted across the four channels and divided by 255 with the same
+    // rounding as MulDiv255. The original alpha is then blended back in.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16( 128 );
+    const __m128i alphaMask = _mm_set1_epi32( 0xff000000 );
+    for( ; i + 4 <= NumPixels; i += 4 )
+    {
+        __m128i px = _mm_loadu_si128( ( const __m128i* )( pPixels + i * 4 ) );
+
+        __m128i lo = _mm_unpacklo_epi8( px, zero );
+        __m128i hi = _mm_unpackhi_epi8( px, zero );
+        __m128i alo = _mm_shufflehi_epi16( _mm_shufflelo_epi16( lo, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 3, 3, 3, 3 ) );
+        __m128i ahi = _mm_shufflehi_epi16( _mm_shufflelo_epi16( hi, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 3, 3, 3, 3 ) );
+
+        lo = _mm_add_epi16( _mm_mullo_epi16( lo, alo ), bias );
+        hi = _mm_add_epi16( _mm_mullo_epi16( hi, ahi ), bias );
+        lo = _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_epi16( lo, 8 ) ), 8 );
+        hi = _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_epi16( hi, 8 ) ), 8 );
+
+        __m128i res = _mm_packus_epi16( lo, hi );
+        res = _mm_or_si128( _mm_andnot_si128( alphaMask, res ), _mm_and_si128( alphaMask, px ) );
+        _mm_storeu_si128( ( __m128i* )( pPixels + i * 4 ), res );
+    }
+
+    for( ; i < NumPixels; i++ )
+    {
+        BYTE* p = pPixels + i * 4;
+        UINT a = p[3];
+        p[0] = MulDiv255( p[0], a );
+        p[1] = MulDiv255( p[1], a );
+        p[2] = MulDiv255( p[2], a );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void DownsampleRGBA8( const BYTE* pSrc, UINT SrcWidth, UINT SrcHeight, UINT SrcPitch, BYTE* pDest, UINT DestPitch )
+{
+    UINT DestWidth = max( 1, SrcWidth >> 1 );
+    UINT DestHeight = max( 1, SrcHeight >> 1 );
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16( 2 );
+
+    for( UINT y = 0; y < DestHeight; y++ )
+    {
+        const BYTE* pRow0 = pSrc + ( y * 2 ) * SrcPitch;
+        const BYTE* pRow1 = ( y * 2 + 1 < SrcHeight ) ? pRow0 + SrcPitch : pRow0;
+        BYTE* pOut = pDest + y * DestPitch;
+
+        // Two destination texels (four source columns from each row) per iteration
+        UINT x = 0;
+        for( ; x + 2 <= DestWidth && x * 2 + 4 <= SrcWidth; x += 2 )
+        {
+            __m128i r0 = _mm_loadu_si128( ( const __m128i* )( pRow0 + x * 8 ) );
+            __m128i r1 = _mm_loadu_si128( ( const __m128i* )( pRow1 + x * 8 ) );
+            __m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( r0, zero ), _mm_unpacklo_epi8( r1, zero ) );
+            __m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( r0, zero ), _mm_unpackhi_epi8( r1, zero ) );
+            __m128i sum = _mm_add_epi16( _mm_unpacklo_epi64( lo, hi ), _mm_unpackhi_epi64( lo, hi ) );
+            sum = _mm_srli_epi16( _mm_add_epi16( sum, round ), 2 );
+            _mm_storel_epi64( ( __m128i* )( pOut + x * 4 ), _mm_packus_epi16( sum, sum ) );
+        }
+
+        for( ; x < DestWidth; x++ )
+        {
+            UINT x0 = x * 2;
+            UINT x1 = ( x0 + 1 < SrcWidth ) ? x0 + 1 : x0;
+            for( UINT c = 0; c < 4; c++ )
+            {
+                UINT s = pRow0[x0 * 4 + c] + pRow0[x1 * 4 + c] + pRow1[x0 * 4 + c] + pRow1[x1 * 4 + c];
+                pOut[x * 4 + c] = ( BYTE )( ( s + 2 ) >> 2 );
+            }
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// 5:6:5 helpers
+//--------------------------------------------------------------------------------------
+static inline WORD PackRGB565( int r, int g, int b )
+{
+    return ( WORD )( ( ( r >> 3 ) << 11 ) | ( ( g >> 2 ) << 5 ) | ( b >> 3 ) );
+}
+
+static inline void UnpackRGB565( WORD c, int* pRGB )
+{
+    int r = ( c >> 11 ) & 0x1f;
+    int g = ( c >> 5 ) & 0x3f;
+    int b = c & 0x1f;
+    pRGB[0] = ( r << 3 ) | ( r >> 2 );
+    pRGB[1] = ( g << 2 ) | ( g >> 4 );
+    pRGB[2] = ( b << 3 ) | ( b >> 2 );
+}
+
+static void BuildColorPalette( WORD c0, WORD c1, int pPalette[4][3] )
+{
+    UnpackRGB565( c0, pPalette[0] );
+    UnpackRGB565( c1, pPalette[1] );
+    for( int c = 0; c < 3; c++ )
+    {
+        pPalette[2][c] = ( 2 * pPalette[0][c] + pPalette[1][c] ) / 3;
+        pPalette[3][c] = ( pPalette[0][c] + 2 * pPalette[1][c] ) / 3;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void DecodeBCColorBlock( const BYTE* pBlock, DWORD* pColors )
+{
+    WORD c0 = ( WORD )( pBlock[0] | ( pBlock[1] << 8 ) );
+    WORD c1 = ( WORD )( pBlock[2] | ( pBlock[3] << 8 ) );
+    DWORD indices = pBlock[4] | ( pBlock[5] << 8 ) | ( pBlock[6] << 16 ) | ( pBlock[7] << 24 );
+
+    int palette[4][3];
+    BuildColorPalette( c0, c1, palette );
+
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+    {
+        const int* p = palette[ ( indices >> ( i * 2 ) ) & 3 ];
+        pColors[i] = 0xff000000 | ( p[2] << 16 ) | ( p[1] << 8 ) | p[0];
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Bounding box fit: the endpoints are the corners of the colour bounding box, with the
+// diagonal flipped on red/blue when they are anti-correlated with green, then inset by
+// 1/16th of the range so the extremes land closer to the interpolated entries.
+//--------------------------------------------------------------------------------------
+void EncodeBCColorBlock( const DWORD* pColors, BYTE* pBlock )
+{
+    int minC[3] = { 255, 255, 255 };
+    int maxC[3] = { 0, 0, 0 };
+    int mean[3] = { 0, 0, 0 };
+
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+    {
+        for( int c = 0; c < 3; c++ )
+        {
+            int v = ( pColors[i] >> ( c * 8 ) ) & 0xff;
+            minC[c] = min( minC[c], v );
+            maxC[c] = max( maxC[c], v );
+            mean[c] += v;
+        }
+    }
+
+    int covRG = 0;
+    int covBG = 0;
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+    {
+        int r = ( int )( pColors[i] & 0xff ) * DDS_BLOCK_TEXELS - mean[0];
+        int g = ( int )( ( pColors[i] >> 8 ) & 0xff ) * DDS_BLOCK_TEXELS - mean[1];
+        int b = ( int )( ( pColors[i] >> 16 ) & 0xff ) * DDS_BLOCK_TEXELS - mean[2];
+        covRG += ( r >> 4 ) * ( g >> 4 );
+        covBG += ( b >> 4 ) * ( g >> 4 );
+    }
+    if( covRG < 0 )
+    {
+        int t = minC[0]; minC[0] = maxC[0]; maxC[0] = t;
+    }
+    if( covBG < 0 )
+    {
+        int t = minC[2]; minC[2] = maxC[2]; maxC[2] = t;
+    }
+
+    for( int c = 0; c < 3; c++ )
+    {
+        int inset = ( maxC[c] - minC[c] ) / 16;
+        maxC[c] = max( 0, min( 255, maxC[c] - inset ) );
+        minC[c] = max( 0, min( 255, minC[c] + inset ) );
+    }
+
+    WORD c0 = PackRGB565( maxC[0], maxC[1], maxC[2] );
+    WORD c1 = PackRGB565( minC[0], minC[1], minC[2] );
+
+    // c0 > c1 selects the four colour mode for BC1, which BC2/BC3 always use
+    if( c0 < c1 )
+    {
+        WORD t = c0; c0 = c1; c1 = t;
+    }
+
+    DWORD indices = 0;
+    if( c0 != c1 )
+    {
+        int palette[4][3];
+        BuildColorPalette( c0, c1, palette );
+
+        for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+        {
+            int r = pColors[i] & 0xff;
+            int g = ( pColors[i] >> 8 ) & 0xff;
+            int b = ( pColors[i] >> 16 ) & 0xff;
+
+            int best = 0;
+            int bestDist = INT_MAX;
+            for( int p = 0; p < 4; p++ )
+            {
+                int dr = r - palette[p][0];
+                int dg = g - palette[p][1];
+                int db = b - palette[p][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if( dist < bestDist )
+                {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= ( DWORD )best << ( i * 2 );
+        }
+    }
+
+    pBlock[0] = ( BYTE )( c0 & 0xff );
+    pBlock[1] = ( BYTE )( c0 >> 8 );
+    pBlock[2] = ( BYTE )( c1 & 0xff );
+    pBlock[3] = ( BYTE )( c1 >> 8 );
+    pBlock[4] = ( BYTE )( indices & 0xff );
+    pBlock[5] = ( BYTE )( ( indices >> 8 ) & 0xff );
+    pBlock[6] = ( BYTE )( ( indices >> 16 ) & 0xff );
+    pBlock[7] = ( BYTE )( indices >> 24 );
+}
+
+//--------------------------------------------------------------------------------------
+void DecodeBC2AlphaBlock( const BYTE* pBlock, BYTE* pAlpha )
+{
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+    {
+        BYTE a = ( BYTE )( ( pBlock[i >> 1] >> ( ( i & 1 ) * 4 ) ) & 0xf );
+        pAlpha[i] = ( BYTE )( a * 17 );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void DecodeBC3AlphaBlock( const BYTE* pBlock, BYTE* pAlpha )
+{
+    UINT a[8];
+    a[0] = pBlock[0];
+    a[1] = pBlock[1];
+    if( a[0] > a[1] )
+    {
+        for( UINT i = 1; i < 7; i++ )
+            a[i + 1] = ( ( 7 - i ) * a[0] + i * a[1] ) / 7;
+    }
+    else
+    {
+        for( UINT i = 1; i < 5; i++ )
+            a[i + 1] = ( ( 5 - i ) * a[0] + i * a[1] ) / 5;
+        a[6] = 0;
+        a[7] = 255;
+    }
+
+    UINT64 indices = 0;
+    for( UINT i = 0; i < 6; i++ )
+        indices |= ( UINT64 )pBlock[2 + i] << ( i * 8 );
+
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+        pAlpha[i] = ( BYTE )a[ ( indices >> ( i * 3 ) ) & 7 ];
+}
+
+//--------------------------------------------------------------------------------------
+void EncodeBC2AlphaBlock( const BYTE* pAlpha, BYTE* pBlock )
+{
+    ZeroMemory( pBlock, 8 );
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+    {
+        UINT a = ( pAlpha[i] * 15 + 127 ) / 255;
+        pBlock[i >> 1] |= ( BYTE )( a << ( ( i & 1 ) * 4 ) );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Endpoints are the block's alpha range in the eight value mode (a0 > a1)
+//--------------------------------------------------------------------------------------
+void EncodeBC3AlphaBlock( const BYTE* pAlpha, BYTE* pBlock )
+{
+    UINT aMin = 255;
+    UINT aMax = 0;
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+    {
+        aMin = min( aMin, ( UINT )pAlpha[i] );
+        aMax = max( aMax, ( UINT )pAlpha[i] );
+    }
+
+    pBlock[0] = ( BYTE )aMax;
+    pBlock[1] = ( BYTE )aMin;
+
+    UINT64 indices = 0;
+    if( aMax != aMin )
+    {
+        UINT a[8];
+        a[0] = aMax;
+        a[1] = aMin;
+        for( UINT i = 1; i < 7; i++ )
+            a[i + 1] = ( ( 7 - i ) * aMax + i * aMin ) / 7;
+
+        for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+        {
+            UINT best = 0;
+            int bestDist = INT_MAX;
+            for( UINT p = 0; p < 8; p++ )
+            {
+                int dist = abs( ( int )pAlpha[i] - ( int )a[p] );
+                if( dist < bestDist )
+                {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= ( UINT64 )best << ( i * 3 );
+        }
+    }
+
+    for( UINT i = 0; i < 6; i++ )
+        pBlock[2 + i] = ( BYTE )( ( indices >> ( i * 8 ) ) & 0xff );
+}
+
+//--------------------------------------------------------------------------------------
+static void PremultiplyColorBlock( BYTE* pColorBlock, const BYTE* pAlpha )
+{
+    // Fully opaque blocks are unchanged by premultiplication
+    bool bOpaque = true;
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+    {
+        if( pAlpha[i] != 0xff )
+        {
+            bOpaque = false;
+            break;
+        }
+    }
+    if( bOpaque )
+        return;
+
+    DWORD colors[DDS_BLOCK_TEXELS];
+    DecodeBCColorBlock( pColorBlock, colors );
+    for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+        colors[i] = ( colors[i] & 0x00ffffff ) | ( ( DWORD )pAlpha[i] << 24 );
+    PremultiplyAlphaRGBA8( ( BYTE* )colors, DDS_BLOCK_TEXELS );
+    EncodeBCColorBlock( colors, pColorBlock );
+}
+
+//--------------------------------------------------------------------------------------
+void PremultiplyAlphaBC2( BYTE* pBlocks, SIZE_T NumBlocks )
+{
+    BYTE alpha[DDS_BLOCK_TEXELS];
+    for( SIZE_T i = 0; i < NumBlocks; i++ )
+    {
+        BYTE* pBlock = pBlocks + i * 16;
+        DecodeBC2AlphaBlock( pBlock, alpha );
+        PremultiplyColorBlock( pBlock + 8, alpha );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void PremultiplyAlphaBC3( BYTE* pBlocks, SIZE_T NumBlocks )
+{
+    BYTE alpha[DDS_BLOCK_TEXELS];
+    for( SIZE_T i = 0; i < NumBlocks; i++ )
+    {
+        BYTE* pBlock = pBlocks + i * 16;
+        DecodeBC3AlphaBlock( pBlock, alpha );
+        PremultiplyColorBlock( pBlock + 8, alpha );
+    }
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// File: DDSConvert.h
+//
+// CPU-side pixel and block conversion helpers used by the DDS loader and writer
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef _DDSCONVERT_H_
+#define _DDSCONVERT_H_
+
+#include <dxgiformat.h>
+
+//--------------------------------------------------------------------------------------
+// Format traits shared by the DDS loader and writer
+//--------------------------------------------------------------------------------------
+UINT BitsPerPixel( DXGI_FORMAT fmt );
+bool IsCompressed( DXGI_FORMAT fmt );
+void GetSurfaceInfo( UINT width, UINT height, DXGI_FORMAT fmt, __out_opt UINT* pNumBytes, __out_opt UINT* pRowBytes,
+                     __out_opt UINT* pNumRows );
+
+//--------------------------------------------------------------------------------------
+// Colours passed to and from the block helpers are packed as 0xAABBGGRR
+//--------------------------------------------------------------------------------------
+#define DDS_BLOCK_TEXELS 16
+
+// 8bpc BGRA to RGBA swap, in place. bOpaque sets the fourth byte to 0xff for X8 sources,
+// whose fourth byte is undefined.
+void SwizzleBGRA8ToRGBA8( __inout_bcount(NumPixels*4) BYTE* pPixels, SIZE_T NumPixels, bool bOpaque );
+
+// 8bpc RGBA/BGRA (alpha in the fourth byte) premultiply, in place
+void PremultiplyAlphaRGBA8( __inout_bcount(NumPixels*4) BYTE* pPixels, SIZE_T NumPixels );
+
+// 2x2 box filter of an 8bpc, four channel surface into the next mip level
+void DownsampleRGBA8( __in_bcount(SrcPitch*SrcHeight) const BYTE* pSrc, UINT SrcWidth, UINT SrcHeight, UINT SrcPitch,
+                      __out BYTE* pDest, UINT DestPitch );
+
+// BC1-style colour block (used as-is by BC1, and as the second half of BC2/BC3)
+void DecodeBCColorBlock( __in_bcount(8) const BYTE* pBlock, __out_ecount(16) DWORD* pColors );
+void EncodeBCColorBlock( __in_ecount(16) const DWORD* pColors, __out_bcount(8) BYTE* pBlock );
+
+// Alpha halves of BC2 and BC3 blocks
+void DecodeBC2AlphaBlock( __in_bcount(8) const BYTE* pBlock, __out_ecount(16) BYTE* pAlpha );
+void DecodeBC3AlphaBlock( __in_bcount(8) const BYTE* pBlock, __out_ecount(16) BYTE* pAlpha );
+void EncodeBC2AlphaBlock( __in_ecount(16) const BYTE* pAlpha, __out_bcount(8) BYTE* pBlock );
+void EncodeBC3AlphaBlock( __in_ecount(16) const BYTE* pAlpha, __out_bcount(8) BYTE* pBlock );
+
+// Decode each block, scale colour by alpha and re-fit the colour endpoints. The alpha
+// half of each block is left untouched since premultiplying does not change it.
+void PremultiplyAlphaBC2( __inout_bcount(NumBlocks*16) BYTE* pBlocks, SIZE_T NumBlocks );
+void PremultiplyAlphaBC3( __inout_bcount(NumBlocks*16) BYTE* pBlocks, SIZE_T NumBlocks );
+
+#endif // _DDSCONVERT_H_
@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// File: DDSLoaderStats.cpp
+//
+// Per-stage timing and byte counters for the DDS loader
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DDSLoaderStats.h"
+#include <stdio.h>
+
+volatile LONG g_bDDSLoaderStatsEnabled = 0;
+
+// Loads can run on several threads, so updates to the aggregates are serialized. The
+// lock is only taken while collection is enabled.
+static SRWLOCK s_StatsLock = SRWLOCK_INIT;
+static DDS_LOADER_STATS s_Stats;
+
+static const char* s_StageNames[DDS_STAGE_COUNT] =
+{
+    "open",
+    "read",
+    "parse",
+    "convert",
+    "create_resource",
+    "create_srv",
+    "total",
+};
+
+//--------------------------------------------------------------------------------------
+static double GetElapsedMs( const LARGE_INTEGER& Start )
+{
+    static LARGE_INTEGER s_Frequency = {0};
+    if( s_Frequency.QuadPart == 0 )
+        QueryPerformanceFrequency( &s_Frequency );
+
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter( &Now );
+    return ( double )( Now.QuadPart - Start.QuadPart ) * 1000.0 / ( double )s_Frequency.QuadPart;
+}
+
+//--------------------------------------------------------------------------------------
+static void AddSample( DDS_STAGE_STATS* pStage, double fMs, UINT64 Bytes )
+{
+    UINT bucket = 0;
+    for( double fUs = fMs * 1000.0; fUs >= 1.0 && bucket < DDS_STATS_HISTOGRAM_BUCKETS - 1; fUs *= 0.5 )
+        bucket++;
+
+    pStage->Count++;
+    pStage->Bytes += Bytes;
+    pStage->TotalMs += fMs;
+    pStage->MaxMs = max( pStage->MaxMs, fMs );
+    pStage->Histogram[bucket]++;
+}
+
+//--------------------------------------------------------------------------------------
+void DDSStatsRecord( DDS_LOAD_STAGE stage, const LARGE_INTEGER& Start, UINT64 Bytes )
+{
+    double fMs = GetElapsedMs( Start );
+
+    AcquireSRWLockExclusive( &s_StatsLock );
+    AddSample( &s_Stats.Stages[stage], fMs, Bytes );
+    ReleaseSRWLockExclusive( &s_StatsLock );
+}
+
+//--------------------------------------------------------------------------------------
+void DDSStatsRecordLoad( const DDS_LOAD_TIMER* pTimer, HRESULT hr )
+{
+    double fMs = GetElapsedMs( pTimer->LoadStart );
+
+    AcquireSRWLockExclusive( &s_StatsLock );
+    s_Stats.NumLoads++;
+    if( FAILED( hr ) )
+        s_Stats.NumFailures++;
+    AddSample( &s_Stats.Stages[DDS_STAGE_TOTAL], fMs, 0 );
+    ReleaseSRWLockExclusive( &s_StatsLock );
+}
+
+//--------------------------------------------------------------------------------------
+void DDSLoaderEnableStats( bool bEnable )
+{
+    InterlockedExchange( &g_bDDSLoaderStatsEnabled, bEnable ? 1 : 0 );
+}
+
+//--------------------------------------------------------------------------------------
+bool DDSLoaderStatsEnabled()
+{
+    return g_bDDSLoaderStatsEnabled != 0;
+}
+
+//--------------------------------------------------------------------------------------
+void DDSLoaderGetStats( DDS_LOADER_STATS* pStats )
+{
+    if( !pStats )
+        return;
+
+    AcquireSRWLockShared( &s_StatsLock );
+    *pStats = s_Stats;
+    ReleaseSRWLockShared( &s_StatsLock );
+}
+
+//--------------------------------------------------------------------------------------
+void DDSLoaderResetStats()
+{
+    AcquireSRWLockExclusive( &s_StatsLock );
+    ZeroMemory( &s_Stats, sizeof( s_Stats ) );
+    ReleaseSRWLockExclusive( &s_StatsLock );
+}
+
+//--------------------------------------------------------------------------------------
+const char* DDSLoaderStageName( DDS_LOAD_STAGE stage )
+{
+    if( stage < 0 || stage >= DDS_STAGE_COUNT )
+        return "unknown";
+    return s_StageNames[stage];
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DDSLoaderDumpStatsJSON( const WCHAR* szFileName )
+{
+    if( !szFileName )
+        return E_INVALIDARG;
+
+    DDS_LOADER_STATS stats;
+    DDSLoaderGetStats( &stats );
+
+    FILE* pFile = NULL;
+    if( _wfopen_s( &pFile, szFileName, L"wt" ) != 0 || !pFile )
+        return E_FAIL;
+
+    fprintf( pFile, "{\n" );
+    fprintf( pFile, "  \"enabled\": %s,\n", DDSLoaderStatsEnabled() ? "true" : "false" );
+    fprintf( pFile, "  \"loads\": %I64u,\n", stats.NumLoads );
+    fprintf( pFile, "  \"failures\": %I64u,\n", stats.NumFailures );
+    fprintf( pFile, "  \"histogram_bucket_limits_us\": \"2^i, last bucket unbounded\",\n" );
+    fprintf( pFile, "  \"stages\": {\n" );
+    for( UINT i = 0; i < DDS_STAGE_COUNT; i++ )
+    {
+        const DDS_STAGE_STATS& stage = stats.Stages[i];
+        fprintf( pFile, "    \"%s\": { \"count\": %I64u, \"bytes\": %I64u, \"total_ms\": %.3f, \"avg_ms\": %.3f, "
+                 "\"max_ms\": %.3f, \"histogram\": [", s_StageNames[i], stage.Count, stage.Bytes, stage.TotalMs,
+                 stage.Count ? stage.TotalMs / ( double )stage.Count : 0.0, stage.MaxMs );
+        for( UINT j = 0; j < DDS_STATS_HISTOGRAM_BUCKETS; j++ )
+            fprintf( pFile, j ? ", %I64u" : "%I64u", stage.Histogram[j] );
+        fprintf( pFile, "] }%s\n", ( i + 1 < DDS_STAGE_COUNT ) ? "," : "" );
+    }
+    fprintf( pFile, "  }\n" );
+    fprintf( pFile, "}\n" );
+
+    bool bFailed = ferror( pFile ) != 0;
+    fclose( pFile );
+
+    return bFailed ? E_FAIL : S_OK;
+}
@@ -0,0 +1,100 @@
+//--------------------------------------------------------------------------------------
+// File: DDSLoaderStats.h
+//
+// Per-stage timing and byte counters for the DDS loader
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef _DDSLOADERSTATS_H_
+#define _DDSLOADERSTATS_H_
+
+//--------------------------------------------------------------------------------------
+// Stages of a CreateDDSTextureFromFile call. The D3D9 path has no separate SRV stage.
+//--------------------------------------------------------------------------------------
+enum DDS_LOAD_STAGE
+{
+    DDS_STAGE_OPEN = 0,         // CreateFile and file size query
+    DDS_STAGE_READ,             // allocation and ReadFile
+    DDS_STAGE_PARSE,            // magic number and header validation
+    DDS_STAGE_CONVERT,          // format resolution, plus swizzle and premultiply when needed
+    DDS_STAGE_CREATE_RESOURCE,  // CreateTexture2D, or CreateTexture/UpdateTexture for D3D9
+    DDS_STAGE_CREATE_SRV,       // CreateShaderResourceView
+    DDS_STAGE_TOTAL,            // the whole call, successful or not
+    DDS_STAGE_COUNT
+};
+
+// Histogram bucket i counts samples from 2^(i-1) up to 2^i microseconds (bucket 0 is
+// under 1us); the last bucket also takes everything longer
+#define DDS_STATS_HISTOGRAM_BUCKETS 24
+
+struct DDS_STAGE_STATS
+{
+    UINT64 Count;
+    UINT64 Bytes;
+    double TotalMs;
+    double MaxMs;
+    UINT64 Histogram[DDS_STATS_HISTOGRAM_BUCKETS];
+};
+
+struct DDS_LOADER_STATS
+{
+    UINT64 NumLoads;
+    UINT64 NumFailures;
+    DDS_STAGE_STATS Stages[DDS_STAGE_COUNT];
+};
+
+//--------------------------------------------------------------------------------------
+// Collection is off by default. While it is off the loader only tests a flag per stage.
+//--------------------------------------------------------------------------------------
+void DDSLoaderEnableStats( bool bEnable );
+bool DDSLoaderStatsEnabled();
+void DDSLoaderGetStats( __out DDS_LOADER_STATS* pStats );
+void DDSLoaderResetStats();
+const char* DDSLoaderStageName( DDS_LOAD_STAGE stage );
+
+// Writes the current aggregates as a JSON object
+HRESULT DDSLoaderDumpStatsJSON( __in_z const WCHAR* szFileName );
+
+//--------------------------------------------------------------------------------------
+// Used by the loader to time one load. Begin/End pairs bracket each stage; the clock
+// is only read when collection was enabled at the start of the load.
+//--------------------------------------------------------------------------------------
+struct DDS_LOAD_TIMER
+{
+    bool bEnabled;
+    LARGE_INTEGER LoadStart;
+    LARGE_INTEGER StageStart;
+};
+
+extern volatile LONG g_bDDSLoaderStatsEnabled;
+
+void DDSStatsRecord( DDS_LOAD_STAGE stage, const LARGE_INTEGER& Start, UINT64 Bytes );
+void DDSStatsRecordLoad( const DDS_LOAD_TIMER* pTimer, HRESULT hr );
+
+inline void DDSStatsBeginLoad( __out DDS_LOAD_TIMER* pTimer )
+{
+    pTimer->bEnabled = ( g_bDDSLoaderStatsEnabled != 0 );
+    if( pTimer->bEnabled )
+        QueryPerformanceCounter( &pTimer->LoadStart );
+}
+
+inline void DDSStatsEndLoad( __in const DDS_LOAD_TIMER* pTimer, HRESULT hr )
+{
+    if( pTimer->bEnabled )
+        DDSStatsRecordLoad( pTimer, hr );
+}
+
+inline void DDSStatsBeginStage( __inout DDS_LOAD_TIMER* pTimer )
+{
+    if( pTimer->bEnabled )
+        QueryPerformanceCounter( &pTimer->StageStart );
+}
+
+inline void DDSStatsEndStage( __in const DDS_LOAD_TIMER* pTimer, DDS_LOAD_STAGE stage, UINT64 Bytes )
+{
+    if( pTimer->bEnabled )
+        DDSStatsRecord( stage, pTimer->StageStart, Bytes );
+}
+
+#endif // _DDSLOADERSTATS_H_
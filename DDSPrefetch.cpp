@@ -0,0 +1,426 @@
+//--------------------------------------------------------------------------------------
+// File: DDSPrefetch.cpp
+//
+// Records the order and timing of DDS loads for a scene and replays it on later runs,
+// reading the files into the system file cache ahead of the loader
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DDSPrefetch.h"
+#include <stdio.h>
+
+// Read size used to pull a file into the file cache
+#define DDS_PREFETCH_READ_CHUNK ( 256 * 1024 )
+
+// Longest the replay thread sleeps before re-checking how far the loader has got
+#define DDS_PREFETCH_POLL_MS 50
+
+struct DDS_TRACE_ENTRY
+{
+    WCHAR szFileName[MAX_PATH];
+    DWORD dwOffsetMs;   // time since DDSPrefetchBeginScene when the load was requested
+    UINT Hash;          // of the case folded name, not saved
+};
+
+// Open addressing table of entry indices keyed by file name. Slots hold an index + 1 so
+// that zero means empty, and there are always at least twice as many slots as entries.
+struct DDS_NAME_TABLE
+{
+    UINT* pSlots;
+    UINT SlotMask;
+    UINT NumEntries;
+};
+
+volatile LONG g_bDDSPrefetchSceneActive = 0;
+
+// Scene state. The recorded list and the replay flags are written from whichever
+// threads call the loader, so they are guarded by s_SceneLock.
+static SRWLOCK s_SceneLock = SRWLOCK_INIT;
+static WCHAR s_szTraceFile[MAX_PATH];
+static DWORD s_dwSceneStart = 0;
+static DWORD s_dwLeadMs = DDS_PREFETCH_DEFAULT_LEAD_MS;
+static CGrowableArray<DDS_TRACE_ENTRY> s_Recorded;
+static DDS_NAME_TABLE s_RecordedNames = { NULL, 0, 0 };
+
+// Trace loaded from the previous run. The entries don't change while the replay thread
+// runs; the flags do.
+static DDS_TRACE_ENTRY* s_pReplay = NULL;
+static UINT s_NumReplay = 0;
+static volatile LONG* s_pRequested = NULL;
+static volatile LONG* s_pPrefetched = NULL;
+static DDS_NAME_TABLE s_ReplayNames = { NULL, 0, 0 };
+static volatile LONG s_DemandOffsetMs = 0;
+
+static HANDLE s_hReplayThread = NULL;
+static HANDLE s_hStopEvent = NULL;
+
+static volatile LONG s_NumPrefetched = 0;
+static volatile LONG s_NumHits = 0;
+
+//--------------------------------------------------------------------------------------
+// FNV-1a over the name folded to lower case, since file names compare without case
+//--------------------------------------------------------------------------------------
+static UINT HashFileName( const WCHAR* szFileName )
+{
+    UINT Hash = 2166136261u;
+    for( const WCHAR* p = szFileName; *p; p++ )
+    {
+        Hash ^= ( UINT )towlower( *p );
+        Hash *= 16777619u;
+    }
+    return Hash;
+}
+
+//--------------------------------------------------------------------------------------
+static void FreeNameTable( DDS_NAME_TABLE* pTable )
+{
+    SAFE_DELETE_ARRAY( pTable->pSlots );
+    pTable->SlotMask = 0;
+    pTable->NumEntries = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Index of the first entry added with this name, or -1
+//--------------------------------------------------------------------------------------
+static int FindName( const DDS_NAME_TABLE* pTable, const DDS_TRACE_ENTRY* pEntries, const WCHAR* szFileName,
+                     UINT Hash )
+{
+    if( !pTable->pSlots )
+        return -1;
+
+    for( UINT iSlot = Hash & pTable->SlotMask; pTable->pSlots[iSlot] != 0; iSlot = ( iSlot + 1 ) & pTable->SlotMask )
+    {
+        const DDS_TRACE_ENTRY* pEntry = &pEntries[ pTable->pSlots[iSlot] - 1 ];
+        if( pEntry->Hash == Hash && _wcsicmp( pEntry->szFileName, szFileName ) == 0 )
+            return ( int )pTable->pSlots[iSlot] - 1;
+    }
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------
+// Adds entry iEntry, first doubling the table and rehashing what's in it when it would
+// be more than half full
+//--------------------------------------------------------------------------------------
+static HRESULT AddName( DDS_NAME_TABLE* pTable, const DDS_TRACE_ENTRY* pEntries, UINT iEntry )
+{
+    if( ( pTable->NumEntries + 1 ) * 2 > pTable->SlotMask + 1 || !pTable->pSlots )
+    {
+        UINT NumSlots = 64;
+        while( NumSlots < ( pTable->NumEntries + 1 ) * 2 )
+            NumSlots *= 2;
+
+        UINT* pSlots = new UINT[NumSlots];
+        if( !pSlots )
+            return E_OUTOFMEMORY;
+        ZeroMemory( pSlots, sizeof( UINT ) * NumSlots );
+
+        UINT* pOld = pTable->pSlots;
+        UINT OldSlots = pOld ? pTable->SlotMask + 1 : 0;
+        pTable->pSlots = pSlots;
+        pTable->SlotMask = NumSlots - 1;
+        for( UINT i = 0; i < OldSlots; i++ )
+        {
+            if( pOld[i] == 0 )
+                continue;
+            UINT iSlot = pEntries[ pOld[i] - 1 ].Hash & pTable->SlotMask;
+            while( pSlots[iSlot] != 0 )
+                iSlot = ( iSlot + 1 ) & pTable->SlotMask;
+            pSlots[iSlot] = pOld[i];
+        }
+        delete[] pOld;
+    }
+
+    UINT iSlot = pEntries[iEntry].Hash & pTable->SlotMask;
+    while( pTable->pSlots[iSlot] != 0 )
+        iSlot = ( iSlot + 1 ) & pTable->SlotMask;
+    pTable->pSlots[iSlot] = iEntry + 1;
+    pTable->NumEntries++;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT LoadTrace( const WCHAR* szTraceFile )
+{
+    FILE* pFile = NULL;
+    if( _wfopen_s( &pFile, szTraceFile, L"rt, ccs=UTF-8" ) != 0 || !pFile )
+        return HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND );
+
+    CGrowableArray<DDS_TRACE_ENTRY> entries;
+    WCHAR szLine[MAX_PATH + 32];
+    while( fgetws( szLine, MAX_PATH + 32, pFile ) )
+    {
+        // Each line is "<offset ms>\t<file name>"
+        WCHAR* pEnd = NULL;
+        DDS_TRACE_ENTRY entry;
+        entry.dwOffsetMs = wcstoul( szLine, &pEnd, 10 );
+        if( !pEnd || *pEnd != L'\t' )
+            continue;
+
+        WCHAR* szName = pEnd + 1;
+        size_t len = wcslen( szName );
+        while( len > 0 && ( szName[len - 1] == L'\n' || szName[len - 1] == L'\r' ) )
+            szName[--len] = 0;
+        if( len == 0 || len >= MAX_PATH )
+            continue;
+        wcscpy_s( entry.szFileName, MAX_PATH, szName );
+
+        entry.Hash = HashFileName( entry.szFileName );
+        entries.Add( entry );
+    }
+    fclose( pFile );
+
+    if( entries.GetSize() == 0 )
+        return S_FALSE;
+
+    s_NumReplay = entries.GetSize();
+    s_pReplay = new DDS_TRACE_ENTRY[s_NumReplay];
+    s_pRequested = new LONG[s_NumReplay];
+    s_pPrefetched = new LONG[s_NumReplay];
+    if( !s_pReplay || !s_pRequested || !s_pPrefetched )
+        return E_OUTOFMEMORY;
+
+    CopyMemory( s_pReplay, entries.GetData(), sizeof( DDS_TRACE_ENTRY ) * s_NumReplay );
+    ZeroMemory( ( void* )s_pRequested, sizeof( LONG ) * s_NumReplay );
+    ZeroMemory( ( void* )s_pPrefetched, sizeof( LONG ) * s_NumReplay );
+
+    // A name listed twice keeps its first entry
+    for( UINT i = 0; i < s_NumReplay; i++ )
+    {
+        if( FindName( &s_ReplayNames, s_pReplay, s_pReplay[i].szFileName, s_pReplay[i].Hash ) >= 0 )
+            continue;
+        if( FAILED( AddName( &s_ReplayNames, s_pReplay, i ) ) )
+            return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT SaveTrace( const WCHAR* szTraceFile )
+{
+    FILE* pFile = NULL;
+    if( _wfopen_s( &pFile, szTraceFile, L"wt, ccs=UTF-8" ) != 0 || !pFile )
+        return E_FAIL;
+
+    for( int i = 0; i < s_Recorded.GetSize(); i++ )
+        fwprintf( pFile, L"%u\t%s\n", s_Recorded[i].dwOffsetMs, s_Recorded[i].szFileName );
+
+    bool bFailed = ferror( pFile ) != 0;
+    fclose( pFile );
+    return bFailed ? E_FAIL : S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static void FreeReplay()
+{
+    SAFE_DELETE_ARRAY( s_pReplay );
+    SAFE_DELETE_ARRAY( s_pRequested );
+    SAFE_DELETE_ARRAY( s_pPrefetched );
+    FreeNameTable( &s_ReplayNames );
+    s_NumReplay = 0;
+    s_DemandOffsetMs = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Read the whole file and throw the data away; what matters is that it is now in the
+// system file cache when the loader opens it
+//--------------------------------------------------------------------------------------
+static void ReadAhead( const WCHAR* szFileName, BYTE* pScratch )
+{
+    HANDLE hFile = CreateFile( szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return;
+
+    DWORD BytesRead = 0;
+    while( ReadFile( hFile, pScratch, DDS_PREFETCH_READ_CHUNK, &BytesRead, NULL ) && BytesRead > 0 )
+    {
+        if( WaitForSingleObject( s_hStopEvent, 0 ) == WAIT_OBJECT_0 )
+            break;
+    }
+
+    CloseHandle( hFile );
+}
+
+//--------------------------------------------------------------------------------------
+// Walks the previous run's trace in order. Each file is read once the scene clock is
+// within the lead time of when it was requested last time. The scene clock runs at
+// least as fast as the loader's progress through the trace, so a run that loads faster
+// than the recorded one pulls the prefetcher along with it.
+//--------------------------------------------------------------------------------------
+static DWORD WINAPI ReplayThreadProc( LPVOID pContext )
+{
+    BYTE* pScratch = new BYTE[DDS_PREFETCH_READ_CHUNK];
+    if( !pScratch )
+        return 1;
+
+    for( UINT i = 0; i < s_NumReplay; i++ )
+    {
+        DWORD dwDue = ( s_pReplay[i].dwOffsetMs > s_dwLeadMs ) ? s_pReplay[i].dwOffsetMs - s_dwLeadMs : 0;
+
+        for(; ; )
+        {
+            if( s_pRequested[i] )
+                break;
+
+            DWORD dwClock = max( GetTickCount() - s_dwSceneStart, ( DWORD )s_DemandOffsetMs );
+            if( dwClock >= dwDue )
+                break;
+
+            if( WaitForSingleObject( s_hStopEvent, min( dwDue - dwClock, ( DWORD )DDS_PREFETCH_POLL_MS ) ) == WAIT_OBJECT_0 )
+            {
+                delete[] pScratch;
+                return 0;
+            }
+        }
+
+        // The loader got here first
+        if( s_pRequested[i] )
+            continue;
+
+        ReadAhead( s_pReplay[i].szFileName, pScratch );
+        InterlockedExchange( &s_pPrefetched[i], 1 );
+        InterlockedIncrement( &s_NumPrefetched );
+
+        if( WaitForSingleObject( s_hStopEvent, 0 ) == WAIT_OBJECT_0 )
+            break;
+    }
+
+    delete[] pScratch;
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DDSPrefetchBeginScene( const WCHAR* szTraceFile, DWORD dwLeadMs )
+{
+    if( !szTraceFile || wcslen( szTraceFile ) >= MAX_PATH )
+        return E_INVALIDARG;
+
+    if( g_bDDSPrefetchSceneActive )
+        DDSPrefetchEndScene();
+
+    wcscpy_s( s_szTraceFile, MAX_PATH, szTraceFile );
+    s_dwLeadMs = dwLeadMs;
+    s_Recorded.RemoveAll();
+    FreeNameTable( &s_RecordedNames );
+    s_NumPrefetched = 0;
+    s_NumHits = 0;
+
+    HRESULT hr = LoadTrace( szTraceFile );
+    if( hr == E_OUTOFMEMORY )
+    {
+        FreeReplay();
+        return hr;
+    }
+
+    s_dwSceneStart = GetTickCount();
+
+    if( s_NumReplay > 0 )
+    {
+        s_hStopEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+        if( s_hStopEvent )
+            s_hReplayThread = CreateThread( NULL, 0, ReplayThreadProc, NULL, 0, NULL );
+
+        if( s_hReplayThread )
+        {
+            SetThreadPriority( s_hReplayThread, THREAD_PRIORITY_BELOW_NORMAL );
+        }
+        else
+        {
+            // Carry on recording without replay
+            if( s_hStopEvent )
+                CloseHandle( s_hStopEvent );
+            s_hStopEvent = NULL;
+            FreeReplay();
+        }
+    }
+
+    InterlockedExchange( &g_bDDSPrefetchSceneActive, 1 );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DDSPrefetchEndScene()
+{
+    if( !g_bDDSPrefetchSceneActive )
+        return S_FALSE;
+
+    InterlockedExchange( &g_bDDSPrefetchSceneActive, 0 );
+
+    if( s_hReplayThread )
+    {
+        SetEvent( s_hStopEvent );
+        WaitForSingleObject( s_hReplayThread, INFINITE );
+        CloseHandle( s_hReplayThread );
+        s_hReplayThread = NULL;
+    }
+    if( s_hStopEvent )
+    {
+        CloseHandle( s_hStopEvent );
+        s_hStopEvent = NULL;
+    }
+
+    // Loads already past the flag test finish recording before the state goes away
+    AcquireSRWLockExclusive( &s_SceneLock );
+    HRESULT hr = S_OK;
+    if( s_Recorded.GetSize() > 0 )
+        hr = SaveTrace( s_szTraceFile );
+    s_Recorded.RemoveAll();
+    FreeNameTable( &s_RecordedNames );
+    FreeReplay();
+    ReleaseSRWLockExclusive( &s_SceneLock );
+
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+void DDSPrefetchGetCounts( UINT* pNumPrefetched, UINT* pNumHits )
+{
+    if( pNumPrefetched )
+        *pNumPrefetched = ( UINT )s_NumPrefetched;
+    if( pNumHits )
+        *pNumHits = ( UINT )s_NumHits;
+}
+
+//--------------------------------------------------------------------------------------
+void DDSPrefetchRecordLoad( const WCHAR* szFileName )
+{
+    // A name too long for a trace entry can't have been recorded or replayed either
+    if( !szFileName || wcslen( szFileName ) >= MAX_PATH )
+        return;
+
+    UINT Hash = HashFileName( szFileName );
+
+    AcquireSRWLockExclusive( &s_SceneLock );
+
+    if( !g_bDDSPrefetchSceneActive )
+    {
+        ReleaseSRWLockExclusive( &s_SceneLock );
+        return;
+    }
+
+    DWORD dwOffsetMs = GetTickCount() - s_dwSceneStart;
+
+    // Only the first request for a file matters for prefetching
+    if( FindName( &s_RecordedNames, s_Recorded.GetData(), szFileName, Hash ) < 0 )
+    {
+        DDS_TRACE_ENTRY entry;
+        wcscpy_s( entry.szFileName, MAX_PATH, szFileName );
+        entry.dwOffsetMs = dwOffsetMs;
+        entry.Hash = Hash;
+        if( SUCCEEDED( s_Recorded.Add( entry ) ) &&
+            FAILED( AddName( &s_RecordedNames, s_Recorded.GetData(), s_Recorded.GetSize() - 1 ) ) )
+            s_Recorded.Remove( s_Recorded.GetSize() - 1 );
+    }
+
+    int i = FindName( &s_ReplayNames, s_pReplay, szFileName, Hash );
+    if( i >= 0 )
+    {
+        if( InterlockedExchange( &s_pRequested[i], 1 ) == 0 && s_pPrefetched[i] )
+            InterlockedIncrement( &s_NumHits );
+        if( ( LONG )s_pReplay[i].dwOffsetMs > s_DemandOffsetMs )
+            InterlockedExchange( &s_DemandOffsetMs, ( LONG )s_pReplay[i].dwOffsetMs );
+    }
+
+    ReleaseSRWLockExclusive( &s_SceneLock );
+}
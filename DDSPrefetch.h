@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// File: DDSPrefetch.h
+//
+// Records the order and timing of DDS loads for a scene and replays it on later runs,
+// reading the files into the system file cache ahead of the loader
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef _DDSPREFETCH_H_
+#define _DDSPREFETCH_H_
+
+// How far ahead of the recorded request time a file is read
+#define DDS_PREFETCH_DEFAULT_LEAD_MS 1500
+
+//--------------------------------------------------------------------------------------
+// Call DDSPrefetchBeginScene when a level starts loading and DDSPrefetchEndScene once
+// it is up. If szTraceFile exists from an earlier run, it is replayed on a background
+// thread. Every load made through CreateDDSTextureFromFile in between is recorded and
+// the trace file is rewritten by DDSPrefetchEndScene, so it follows changes to the
+// level's content. The loading code itself doesn't change.
+//--------------------------------------------------------------------------------------
+HRESULT DDSPrefetchBeginScene( __in_z const WCHAR* szTraceFile, DWORD dwLeadMs = DDS_PREFETCH_DEFAULT_LEAD_MS );
+HRESULT DDSPrefetchEndScene();
+
+// Number of files read ahead and, of those, how many the loader asked for afterwards
+void DDSPrefetchGetCounts( __out_opt UINT* pNumPrefetched, __out_opt UINT* pNumHits );
+
+//--------------------------------------------------------------------------------------
+// Called by the loader at the start of every load. Outside of a scene this is a flag
+// test.
+//--------------------------------------------------------------------------------------
+extern volatile LONG g_bDDSPrefetchSceneActive;
+
+void DDSPrefetchRecordLoad( __in_z const WCHAR* szFileName );
+
+inline void DDSPrefetchNotifyLoad( __in_z const WCHAR* szFileName )
+{
+    if( g_bDDSPrefetchSceneActive )
+        DDSPrefetchRecordLoad( szFileName );
+}
+
+#endif // _DDSPREFETCH_H_
@@ -8,13 +8,22 @@
 #include "DXUT.h"
 #include "DDSTextureLoader.h"
 #include "DDS.h"
+#include "DDSConvert.h"
+#include "DDSLoaderStats.h"
+#include "DDSPrefetch.h"
+
+// Private data tag set on textures the loader converted to premultiplied alpha
+// {5E1A3F41-7F1C-4C3E-9E5B-2C4B0D2F8A61}
+static const GUID DDSLOADER_PremultipliedAlpha =
+    { 0x5e1a3f41, 0x7f1c, 0x4c3e, { 0x9e, 0x5b, 0x2c, 0x4b, 0x0d, 0x2f, 0x8a, 0x61 } };
 
 //--------------------------------------------------------------------------------------
 static HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** ppHeapData,
                                         DDS_HEADER** ppHeader,
-                                        BYTE** ppBitData, UINT* pBitSize )
+                                        BYTE** ppBitData, UINT* pBitSize, DDS_LOAD_TIMER* pTimer )
 {
     // open the file
+    DDSStatsBeginStage( pTimer );
     HANDLE hFile = CreateFile( szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
                                FILE_FLAG_SEQUENTIAL_SCAN, NULL );
     if( INVALID_HANDLE_VALUE == hFile )
@@ -23,6 +32,7 @@ static HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** p
     // Get the file size
     LARGE_INTEGER FileSize = {0};
     GetFileSizeEx( hFile, &FileSize );
+    DDSStatsEndStage( pTimer, DDS_STAGE_OPEN, 0 );
 
     // File is too big for 32-bit allocation, so reject read
     if( FileSize.HighPart > 0 )
@@ -39,6 +49,7 @@ static HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** p
     }
 
     // create enough space for the file data
+    DDSStatsBeginStage( pTimer );
     *ppHeapData = new BYTE[ FileSize.LowPart ];
     if( !( *ppHeapData ) )
     {
@@ -61,8 +72,10 @@ static HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** p
         SAFE_DELETE_ARRAY( *ppHeapData );
         return E_FAIL;
     }
+    DDSStatsEndStage( pTimer, DDS_STAGE_READ, BytesRead );
 
     // DDS files always start with the same magic number ("DDS ")
+    DDSStatsBeginStage( pTimer );
     DWORD dwMagicNumber = *( DWORD* )( *ppHeapData );
     if( dwMagicNumber != DDS_MAGIC )
     {
@@ -104,6 +117,7 @@ static HRESULT LoadTextureDataFromFile( __in_z const WCHAR* szFileName, BYTE** p
                  + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
     *ppBitData = *ppHeapData + offset;
     *pBitSize = FileSize.LowPart - offset;
+    DDSStatsEndStage( pTimer, DDS_STAGE_PARSE, offset );
 
     CloseHandle( hFile );
 
@@ -221,133 +235,6 @@ static UINT BitsPerPixel( D3DFORMAT fmt )
     }
 }
 
-static UINT BitsPerPixel( DXGI_FORMAT fmt )
-{
-    switch( fmt )
-    {
-    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
-    case DXGI_FORMAT_R32G32B32A32_FLOAT:
-    case DXGI_FORMAT_R32G32B32A32_UINT:
-    case DXGI_FORMAT_R32G32B32A32_SINT:
-        return 128;
-
-    case DXGI_FORMAT_R32G32B32_TYPELESS:
-    case DXGI_FORMAT_R32G32B32_FLOAT:
-    case DXGI_FORMAT_R32G32B32_UINT:
-    case DXGI_FORMAT_R32G32B32_SINT:
-        return 96;
-
-    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
-    case DXGI_FORMAT_R16G16B16A16_FLOAT:
-    case DXGI_FORMAT_R16G16B16A16_UNORM:
-    case DXGI_FORMAT_R16G16B16A16_UINT:
-    case DXGI_FORMAT_R16G16B16A16_SNORM:
-    case DXGI_FORMAT_R16G16B16A16_SINT:
-    case DXGI_FORMAT_R32G32_TYPELESS:
-    case DXGI_FORMAT_R32G32_FLOAT:
-    case DXGI_FORMAT_R32G32_UINT:
-    case DXGI_FORMAT_R32G32_SINT:
-    case DXGI_FORMAT_R32G8X24_TYPELESS:
-    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
-    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
-    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
-        return 64;
-
-    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
-    case DXGI_FORMAT_R10G10B10A2_UNORM:
-    case DXGI_FORMAT_R10G10B10A2_UINT:
-    case DXGI_FORMAT_R11G11B10_FLOAT:
-    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
-    case DXGI_FORMAT_R8G8B8A8_UNORM:
-    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-    case DXGI_FORMAT_R8G8B8A8_UINT:
-    case DXGI_FORMAT_R8G8B8A8_SNORM:
-    case DXGI_FORMAT_R8G8B8A8_SINT:
-    case DXGI_FORMAT_R16G16_TYPELESS:
-    case DXGI_FORMAT_R16G16_FLOAT:
-    case DXGI_FORMAT_R16G16_UNORM:
-    case DXGI_FORMAT_R16G16_UINT:
-    case DXGI_FORMAT_R16G16_SNORM:
-    case DXGI_FORMAT_R16G16_SINT:
-    case DXGI_FORMAT_R32_TYPELESS:
-    case DXGI_FORMAT_D32_FLOAT:
-    case DXGI_FORMAT_R32_FLOAT:
-    case DXGI_FORMAT_R32_UINT:
-    case DXGI_FORMAT_R32_SINT:
-    case DXGI_FORMAT_R24G8_TYPELESS:
-    case DXGI_FORMAT_D24_UNORM_S8_UINT:
-    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
-    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
-    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
-    case DXGI_FORMAT_R8G8_B8G8_UNORM:
-    case DXGI_FORMAT_G8R8_G8B8_UNORM:
-    case DXGI_FORMAT_B8G8R8A8_UNORM:
-    case DXGI_FORMAT_B8G8R8X8_UNORM:
-    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
-    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
-    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
-    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-        return 32;
-
-    case DXGI_FORMAT_R8G8_TYPELESS:
-    case DXGI_FORMAT_R8G8_UNORM:
-    case DXGI_FORMAT_R8G8_UINT:
-    case DXGI_FORMAT_R8G8_SNORM:
-    case DXGI_FORMAT_R8G8_SINT:
-    case DXGI_FORMAT_R16_TYPELESS:
-    case DXGI_FORMAT_R16_FLOAT:
-    case DXGI_FORMAT_D16_UNORM:
-    case DXGI_FORMAT_R16_UNORM:
-    case DXGI_FORMAT_R16_UINT:
-    case DXGI_FORMAT_R16_SNORM:
-    case DXGI_FORMAT_R16_SINT:
-    case DXGI_FORMAT_B5G6R5_UNORM:
-    case DXGI_FORMAT_B5G5R5A1_UNORM:
-        return 16;
-
-    case DXGI_FORMAT_R8_TYPELESS:
-    case DXGI_FORMAT_R8_UNORM:
-    case DXGI_FORMAT_R8_UINT:
-    case DXGI_FORMAT_R8_SNORM:
-    case DXGI_FORMAT_R8_SINT:
-    case DXGI_FORMAT_A8_UNORM:
-        return 8;
-
-    case DXGI_FORMAT_R1_UNORM:
-        return 1;
-
-    case DXGI_FORMAT_BC1_TYPELESS:
-    case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC1_UNORM_SRGB:
-        return 4;
-
-    case DXGI_FORMAT_BC2_TYPELESS:
-    case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC2_UNORM_SRGB:
-    case DXGI_FORMAT_BC3_TYPELESS:
-    case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC3_UNORM_SRGB:
-    case DXGI_FORMAT_BC4_TYPELESS:
-    case DXGI_FORMAT_BC4_UNORM:
-    case DXGI_FORMAT_BC4_SNORM:
-    case DXGI_FORMAT_BC5_TYPELESS:
-    case DXGI_FORMAT_BC5_UNORM:
-    case DXGI_FORMAT_BC5_SNORM:
-    case DXGI_FORMAT_BC6H_TYPELESS:
-    case DXGI_FORMAT_BC6H_UF16:
-    case DXGI_FORMAT_BC6H_SF16:
-    case DXGI_FORMAT_BC7_TYPELESS:
-    case DXGI_FORMAT_BC7_UNORM:
-    case DXGI_FORMAT_BC7_UNORM_SRGB:
-        return 8;
-
-    default:
-        assert( FALSE ); // unhandled format
-        return 0;
-    }
-}
-
 
 //--------------------------------------------------------------------------------------
 // Get surface information for a particular format
@@ -397,73 +284,6 @@ static void GetSurfaceInfo( UINT width, UINT height, D3DFORMAT fmt, UINT* pNumBy
         *pNumRows = numRows;
 }
 
-static void GetSurfaceInfo( UINT width, UINT height, DXGI_FORMAT fmt, UINT* pNumBytes, UINT* pRowBytes, UINT* pNumRows )
-{
-    UINT numBytes = 0;
-    UINT rowBytes = 0;
-    UINT numRows = 0;
-
-    bool bc = true;
-    int bcnumBytesPerBlock = 16;
-    switch (fmt)
-    {
-    case DXGI_FORMAT_BC1_TYPELESS:
-    case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC1_UNORM_SRGB:
-    case DXGI_FORMAT_BC4_TYPELESS:
-    case DXGI_FORMAT_BC4_UNORM:
-    case DXGI_FORMAT_BC4_SNORM:
-        bcnumBytesPerBlock = 8;
-        break;
-
-    case DXGI_FORMAT_BC2_TYPELESS:
-    case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC2_UNORM_SRGB:
-    case DXGI_FORMAT_BC3_TYPELESS:
-    case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC3_UNORM_SRGB:
-    case DXGI_FORMAT_BC5_TYPELESS:
-    case DXGI_FORMAT_BC5_UNORM:
-    case DXGI_FORMAT_BC5_SNORM:
-    case DXGI_FORMAT_BC6H_TYPELESS:
-    case DXGI_FORMAT_BC6H_UF16:
-    case DXGI_FORMAT_BC6H_SF16:
-    case DXGI_FORMAT_BC7_TYPELESS:
-    case DXGI_FORMAT_BC7_UNORM:
-    case DXGI_FORMAT_BC7_UNORM_SRGB:
-        break;
-
-    default:
-        bc = false;
-        break;
-    }
-
-    if( bc )
-    {
-        int numBlocksWide = 0;
-        if( width > 0 )
-            numBlocksWide = max( 1, width / 4 );
-        int numBlocksHigh = 0;
-        if( height > 0 )
-            numBlocksHigh = max( 1, height / 4 );
-        rowBytes = numBlocksWide * bcnumBytesPerBlock;
-        numRows = numBlocksHigh;
-    }
-    else
-    {
-        UINT bpp = BitsPerPixel( fmt );
-        rowBytes = ( width * bpp + 7 ) / 8; // round up to nearest byte
-        numRows = height;
-    }
-    numBytes = rowBytes * numRows;
-    if( pNumBytes != NULL )
-        *pNumBytes = numBytes;
-    if( pRowBytes != NULL )
-        *pRowBytes = rowBytes;
-    if( pNumRows != NULL )
-        *pNumRows = numRows;
-}
-
 
 //--------------------------------------------------------------------------------------
 #define ISBITMASK( r,g,b,a ) ( ddpf.dwRBitMask == r && ddpf.dwGBitMask == g && ddpf.dwBBitMask == b && ddpf.dwABitMask == a )
@@ -726,9 +546,67 @@ static DXGI_FORMAT GetDXGIFormat( const DDS_PIXELFORMAT& ddpf )
 }
 
 
+
+//--------------------------------------------------------------------------------------
+// Premultiply an 8bpc RGBA/BGRA mip chain in place. Only the top level of each array
+// slice is converted; the lower levels are rebuilt from it so that filtering happens in
+// premultiplied space rather than on the straight-alpha mips stored in the file.
+//--------------------------------------------------------------------------------------
+static HRESULT PremultiplyMipChainRGBA8( __inout_bcount(BitSize) BYTE* pBitData, UINT BitSize, UINT iWidth,
+                                         UINT iHeight, UINT iMipCount, UINT iArraySize )
+{
+    UINT64 RequiredSize = 0;
+    for( UINT i = 0, w = iWidth, h = iHeight; i < iMipCount; i++ )
+    {
+        RequiredSize += ( UINT64 )w * h * 4;
+        w = max( 1, w >> 1 );
+        h = max( 1, h >> 1 );
+    }
+    if( RequiredSize * iArraySize > BitSize )
+        return E_FAIL;
+
+    BYTE* pSrcBits = pBitData;
+    for( UINT j = 0; j < iArraySize; j++ )
+    {
+        UINT w = iWidth;
+        UINT h = iHeight;
+        PremultiplyAlphaRGBA8( pSrcBits, ( SIZE_T )w * h );
+
+        BYTE* pLevel = pSrcBits;
+        pSrcBits += w * h * 4;
+        for( UINT i = 1; i < iMipCount; i++ )
+        {
+            DownsampleRGBA8( pLevel, w, h, w * 4, pSrcBits, max( 1, w >> 1 ) * 4 );
+            pLevel = pSrcBits;
+            w = max( 1, w >> 1 );
+            h = max( 1, h >> 1 );
+            pSrcBits += w * h * 4;
+        }
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Premultiply every block of a BC2 or BC3 mip chain in place
+//--------------------------------------------------------------------------------------
+static HRESULT PremultiplyMipChainBC( __inout_bcount(BitSize) BYTE* pBitData, UINT BitSize, UINT64 DataSize,
+                                      bool bBC3 )
+{
+    if( DataSize > BitSize )
+        return E_FAIL;
+
+    if( bBC3 )
+        PremultiplyAlphaBC3( pBitData, ( SIZE_T )( DataSize / 16 ) );
+    else
+        PremultiplyAlphaBC2( pBitData, ( SIZE_T )( DataSize / 16 ) );
+
+    return S_OK;
+}
+
 //--------------------------------------------------------------------------------------
 static HRESULT CreateTextureFromDDS( LPDIRECT3DDEVICE9 pDev, DDS_HEADER* pHeader, __inout_bcount(BitSize) BYTE* pBitData, UINT BitSize,
-                                     __out LPDIRECT3DTEXTURE9* ppTex )
+                                     UINT loadFlags, __out LPDIRECT3DTEXTURE9* ppTex, DDS_LOAD_TIMER* pTimer )
 {
     HRESULT hr = S_OK;
     D3DLOCKED_RECT LockedRect = {0};
@@ -746,9 +624,51 @@ static HRESULT CreateTextureFromDDS( LPDIRECT3DDEVICE9 pDev, DDS_HEADER* pHeader
         return E_FAIL;
     }
 
+    DDSStatsBeginStage( pTimer );
     D3DFORMAT fmt = GetD3D9Format( pHeader->ddspf );
 
+    UINT ConvertBytes = 0;
+    bool bPremultiplied = false;
+    if( loadFlags & DDS_LOADER_PREMULTIPLY_ALPHA )
+    {
+        UINT64 DataSize = 0;
+        for( UINT i = 0, w = iWidth, h = iHeight; i < iMipCount; i++ )
+        {
+            UINT NumBytes = 0;
+            GetSurfaceInfo( w, h, fmt, &NumBytes, NULL, NULL );
+            DataSize += NumBytes;
+            w = max( 1, w >> 1 );
+            h = max( 1, h >> 1 );
+        }
+
+        // DXT3/DXT5 become DXT2/DXT4, which are the premultiplied variants in D3D9
+        switch( fmt )
+        {
+        case D3DFMT_A8R8G8B8:
+        case D3DFMT_A8B8G8R8:
+            V_RETURN( PremultiplyMipChainRGBA8( pBitData, BitSize, iWidth, iHeight, iMipCount, 1 ) );
+            bPremultiplied = true;
+            break;
+
+        case D3DFMT_DXT3:
+            V_RETURN( PremultiplyMipChainBC( pBitData, BitSize, DataSize, false ) );
+            fmt = D3DFMT_DXT2;
+            bPremultiplied = true;
+            break;
+
+        case D3DFMT_DXT5:
+            V_RETURN( PremultiplyMipChainBC( pBitData, BitSize, DataSize, true ) );
+            fmt = D3DFMT_DXT4;
+            bPremultiplied = true;
+            break;
+        }
+        if( bPremultiplied )
+            ConvertBytes = BitSize;
+    }
+    DDSStatsEndStage( pTimer, DDS_STAGE_CONVERT, ConvertBytes );
+
     // Create the texture
+    DDSStatsBeginStage( pTimer );
     LPDIRECT3DTEXTURE9 pTexture;
     LPDIRECT3DTEXTURE9 pStagingTexture;
     hr = pDev->CreateTexture( iWidth,
@@ -810,7 +730,17 @@ static HRESULT CreateTextureFromDDS( LPDIRECT3DDEVICE9 pDev, DDS_HEADER* pHeader
     hr = pDev->UpdateTexture( pStagingTexture, pTexture );
     SAFE_RELEASE( pStagingTexture );
     if( FAILED( hr ) )
+    {
+        SAFE_RELEASE( pTexture );
         return hr;
+    }
+    DDSStatsEndStage( pTimer, DDS_STAGE_CREATE_RESOURCE, BitSize );
+
+    if( bPremultiplied )
+    {
+        BOOL bTag = TRUE;
+        pTexture->SetPrivateData( DDSLOADER_PremultipliedAlpha, &bTag, sizeof( bTag ), 0 );
+    }
 
     // Set the result
     *ppTex = pTexture;
@@ -819,7 +749,8 @@ static HRESULT CreateTextureFromDDS( LPDIRECT3DDEVICE9 pDev, DDS_HEADER* pHeader
 
 //--------------------------------------------------------------------------------------
 static HRESULT CreateTextureFromDDS( ID3D11Device* pDev, DDS_HEADER* pHeader, __inout_bcount(BitSize) BYTE* pBitData,
-                                     UINT BitSize, __out ID3D11ShaderResourceView** ppSRV, bool bSRGB )
+                                     UINT BitSize, UINT loadFlags, __out ID3D11ShaderResourceView** ppSRV, bool bSRGB,
+                                     DDS_LOAD_TIMER* pTimer )
 {
     HRESULT hr = S_OK;
 
@@ -833,6 +764,10 @@ static HRESULT CreateTextureFromDDS( ID3D11Device* pDev, DDS_HEADER* pHeader, __
     if ( iMipCount > D3D11_REQ_MIP_LEVELS )
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
 
+    // Format resolution, swizzling and premultiplying all count as the convert stage
+    DDSStatsBeginStage( pTimer );
+    UINT ConvertBytes = 0;
+
     D3D11_TEXTURE2D_DESC desc;
     if ((  pHeader->ddspf.dwFlags & DDS_FOURCC )
         && (MAKEFOURCC( 'D', 'X', '1', '0' ) == pHeader->ddspf.dwFourCC ) )
@@ -874,15 +809,10 @@ static HRESULT CreateTextureFromDDS( ID3D11Device* pDev, DDS_HEADER* pHeader, __
                 {
                     desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 
-                    if ( BitSize >= 3 )
-                    {
-                        for( UINT i = 0; i < BitSize; i += 4 )
-                        {
-                            BYTE a = pBitData[i];
-                            pBitData[i] = pBitData[i + 2];
-                            pBitData[i + 2] = a;
-                        }
-                    }
+                    // The X8 byte is undefined, so it becomes an opaque alpha before
+                    // anything (premultiplying included) reads it
+                    SwizzleBGRA8ToRGBA8( pBitData, BitSize / 4, fmt == D3DFMT_X8R8G8B8 );
+                    ConvertBytes = BitSize;
                 }
                 break;
 
@@ -894,10 +824,52 @@ static HRESULT CreateTextureFromDDS( ID3D11Device* pDev, DDS_HEADER* pHeader, __
             }
         }
     }
+
+    bool bPremultiplied = false;
+    if( loadFlags & DDS_LOADER_PREMULTIPLY_ALPHA )
+    {
+        UINT64 DataSize = 0;
+        for( UINT i = 0, w = iWidth, h = iHeight; i < iMipCount; i++ )
+        {
+            UINT NumBytes = 0;
+            GetSurfaceInfo( w, h, desc.Format, &NumBytes, NULL, NULL );
+            DataSize += NumBytes;
+            w = max( 1, w >> 1 );
+            h = max( 1, h >> 1 );
+        }
+        DataSize *= desc.ArraySize;
+
+        switch( desc.Format )
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            V_RETURN( PremultiplyMipChainRGBA8( pBitData, BitSize, iWidth, iHeight, iMipCount, desc.ArraySize ) );
+            bPremultiplied = true;
+            break;
+
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            V_RETURN( PremultiplyMipChainBC( pBitData, BitSize, DataSize, false ) );
+            bPremultiplied = true;
+            break;
+
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            V_RETURN( PremultiplyMipChainBC( pBitData, BitSize, DataSize, true ) );
+            bPremultiplied = true;
+            break;
+        }
+        if( bPremultiplied )
+            ConvertBytes = BitSize;
+    }
+    DDSStatsEndStage( pTimer, DDS_STAGE_CONVERT, ConvertBytes );
     
     desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 
     // Create the texture
+    DDSStatsBeginStage( pTimer );
     desc.Width = iWidth;
     desc.Height = iHeight;
     desc.MipLevels = iMipCount;
@@ -943,15 +915,25 @@ static HRESULT CreateTextureFromDDS( ID3D11Device* pDev, DDS_HEADER* pHeader, __
     hr = pDev->CreateTexture2D( &desc, pInitData, &pTex2D );
     if( SUCCEEDED( hr ) && pTex2D )
     {
+        DDSStatsEndStage( pTimer, DDS_STAGE_CREATE_RESOURCE, BitSize );
+
 #if defined(DEBUG) || defined(PROFILE)
         pTex2D->SetPrivateData( WKPDID_D3DDebugObjectName, sizeof("DDSTextureLoader")-1, "DDSTextureLoader" );
 #endif
+        if( bPremultiplied )
+        {
+            BOOL bTag = TRUE;
+            pTex2D->SetPrivateData( DDSLOADER_PremultipliedAlpha, sizeof( bTag ), &bTag );
+        }
         D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
         ZeroMemory( &SRVDesc, sizeof( SRVDesc ) );
         SRVDesc.Format = desc.Format;
         SRVDesc.ViewDimension = D3D_SRV_DIMENSION_TEXTURE2D;
         SRVDesc.Texture2D.MipLevels = desc.MipLevels;
+        DDSStatsBeginStage( pTimer );
         hr = pDev->CreateShaderResourceView( pTex2D, &SRVDesc, ppSRV );
+        if( SUCCEEDED( hr ) )
+            DDSStatsEndStage( pTimer, DDS_STAGE_CREATE_SRV, 0 );
         SAFE_RELEASE( pTex2D );
     }
 
@@ -962,47 +944,75 @@ static HRESULT CreateTextureFromDDS( ID3D11Device* pDev, DDS_HEADER* pHeader, __
 
 //--------------------------------------------------------------------------------------
 HRESULT CreateDDSTextureFromFile( LPDIRECT3DDEVICE9 pDev, const WCHAR* szFileName, LPDIRECT3DTEXTURE9* ppTex )
+{
+    return CreateDDSTextureFromFileEx( pDev, szFileName, DDS_LOADER_DEFAULT, ppTex );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CreateDDSTextureFromFileEx( LPDIRECT3DDEVICE9 pDev, const WCHAR* szFileName, UINT loadFlags,
+                                    LPDIRECT3DTEXTURE9* ppTex )
 {
     if ( !pDev || !szFileName || !ppTex )
         return E_INVALIDARG;
 
+    DDSPrefetchNotifyLoad( szFileName );
+
+    DDS_LOAD_TIMER Timer;
+    DDSStatsBeginLoad( &Timer );
+
     BYTE* pHeapData = NULL;
     DDS_HEADER* pHeader= NULL;
     BYTE* pBitData = NULL;
     UINT BitSize = 0;
 
-    HRESULT hr = LoadTextureDataFromFile( szFileName, &pHeapData, &pHeader, &pBitData, &BitSize );
+    HRESULT hr = LoadTextureDataFromFile( szFileName, &pHeapData, &pHeader, &pBitData, &BitSize, &Timer );
     if(FAILED(hr))
     {
         SAFE_DELETE_ARRAY( pHeapData );
+        DDSStatsEndLoad( &Timer, hr );
         return hr;
     }
 
-    hr = CreateTextureFromDDS( pDev, pHeader, pBitData, BitSize, ppTex );
+    hr = CreateTextureFromDDS( pDev, pHeader, pBitData, BitSize, loadFlags, ppTex, &Timer );
     SAFE_DELETE_ARRAY( pHeapData );
+    DDSStatsEndLoad( &Timer, hr );
     return hr;
 }
 
 //--------------------------------------------------------------------------------------
 HRESULT CreateDDSTextureFromFile( ID3D11Device* pDev, const WCHAR* szFileName, ID3D11ShaderResourceView** ppSRV, bool bSRGB )
+{
+    return CreateDDSTextureFromFileEx( pDev, szFileName, DDS_LOADER_DEFAULT, ppSRV, bSRGB );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CreateDDSTextureFromFileEx( ID3D11Device* pDev, const WCHAR* szFileName, UINT loadFlags,
+                                    ID3D11ShaderResourceView** ppSRV, bool bSRGB )
 {
     if ( !pDev || !szFileName || !ppSRV )
         return E_INVALIDARG;
 
+    DDSPrefetchNotifyLoad( szFileName );
+
+    DDS_LOAD_TIMER Timer;
+    DDSStatsBeginLoad( &Timer );
+
     BYTE* pHeapData = NULL;
     DDS_HEADER* pHeader = NULL;
     BYTE* pBitData = NULL;
     UINT BitSize = 0;
 
-    HRESULT hr = LoadTextureDataFromFile( szFileName, &pHeapData, &pHeader, &pBitData, &BitSize );
+    HRESULT hr = LoadTextureDataFromFile( szFileName, &pHeapData, &pHeader, &pBitData, &BitSize, &Timer );
     if(FAILED(hr))
     {
         SAFE_DELETE_ARRAY( pHeapData );
+        DDSStatsEndLoad( &Timer, hr );
         return hr;
     }
 
-    hr = CreateTextureFromDDS( pDev, pHeader, pBitData, BitSize, ppSRV, bSRGB );
+    hr = CreateTextureFromDDS( pDev, pHeader, pBitData, BitSize, loadFlags, ppSRV, bSRGB, &Timer );
     SAFE_DELETE_ARRAY( pHeapData );
+    DDSStatsEndLoad( &Timer, hr );
 
 #if defined(DEBUG) || defined(PROFILE)
     if ( *ppSRV )
@@ -1021,3 +1031,25 @@ HRESULT CreateDDSTextureFromFile( ID3D11Device* pDev, const WCHAR* szFileName, I
 
     return hr;
 }
+
+//--------------------------------------------------------------------------------------
+bool IsDDSTexturePremultiplied( IDirect3DResource9* pResource )
+{
+    if( !pResource )
+        return false;
+
+    BOOL bTag = FALSE;
+    DWORD Size = sizeof( bTag );
+    return SUCCEEDED( pResource->GetPrivateData( DDSLOADER_PremultipliedAlpha, &bTag, &Size ) ) && bTag;
+}
+
+//--------------------------------------------------------------------------------------
+bool IsDDSTexturePremultiplied( ID3D11Resource* pResource )
+{
+    if( !pResource )
+        return false;
+
+    BOOL bTag = FALSE;
+    UINT Size = sizeof( bTag );
+    return SUCCEEDED( pResource->GetPrivateData( DDSLOADER_PremultipliedAlpha, &Size, &bTag ) ) && bTag;
+}
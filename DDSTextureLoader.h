@@ -9,5 +9,22 @@
 #include <d3d9.h>
 #include <d3d11.h>
 
+//--------------------------------------------------------------------------------------
+// Load flags for the Ex variants
+//--------------------------------------------------------------------------------------
+enum DDS_LOADER_FLAGS
+{
+    DDS_LOADER_DEFAULT              = 0,
+    DDS_LOADER_PREMULTIPLY_ALPHA    = 0x1,  // convert straight alpha to premultiplied alpha during upload
+};
+
 HRESULT CreateDDSTextureFromFile( __in LPDIRECT3DDEVICE9 pDev, __in_z const WCHAR* szFileName, __out_opt LPDIRECT3DTEXTURE9* ppTex );
-HRESULT CreateDDSTextureFromFile( __in ID3D11Device* pDev, __in_z const WCHAR* szFileName, __out_opt ID3D11ShaderResourceView** ppSRV, bool sRGB = false );
\ No newline at end of file
+HRESULT CreateDDSTextureFromFile( __in ID3D11Device* pDev, __in_z const WCHAR* szFileName, __out_opt ID3D11ShaderResourceView** ppSRV, bool sRGB = false );
+
+HRESULT CreateDDSTextureFromFileEx( __in LPDIRECT3DDEVICE9 pDev, __in_z const WCHAR* szFileName, UINT loadFlags, __out_opt LPDIRECT3DTEXTURE9* ppTex );
+HRESULT CreateDDSTextureFromFileEx( __in ID3D11Device* pDev, __in_z const WCHAR* szFileName, UINT loadFlags, __out_opt ID3D11ShaderResourceView** ppSRV, bool sRGB = false );
+
+// Returns true if the texture was converted to premultiplied alpha by the loader, so
+// callers that cache or post-process textures don't convert it a second time
+bool IsDDSTexturePremultiplied( __in IDirect3DResource9* pResource );
+bool IsDDSTexturePremultiplied( __in ID3D11Resource* pResource );
@@ -0,0 +1,669 @@
+//--------------------------------------------------------------------------------------
+// File: DDSTextureWriter.cpp
+//
+// Functions for saving a DDS texture without using D3DX
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DDS.h"
+#include "DDSConvert.h"
+#include "DDSTextureWriter.h"
+
+// Block rows handed to each encode work item, and how many work items may be queued
+// per CPU before the writer waits for the oldest one to finish
+#define DDS_ENCODE_CHUNK_BLOCK_ROWS 16
+#define DDS_ENCODE_CHUNKS_PER_CPU   4
+
+//--------------------------------------------------------------------------------------
+// Pick the legacy pixel format for a DXGI format, if there is one. Returns false when
+// the format can only be described by the DX10 extension header.
+//--------------------------------------------------------------------------------------
+static bool GetLegacyPixelFormat( DXGI_FORMAT fmt, __out DDS_PIXELFORMAT* pPF )
+{
+    DDS_PIXELFORMAT pf = { sizeof( DDS_PIXELFORMAT ), 0, 0, 0, 0, 0, 0, 0 };
+
+#define SETMASK( flags, bits, r,g,b,a ) { pf.dwFlags = flags; pf.dwRGBBitCount = bits; \
+    pf.dwRBitMask = r; pf.dwGBitMask = g; pf.dwBBitMask = b; pf.dwABitMask = a; }
+#define SETFOURCC( fcc ) { pf.dwFlags = DDS_FOURCC; pf.dwFourCC = fcc; }
+
+    switch( fmt )
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        SETMASK( DDS_RGBA, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 ); break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+        pf = DDSPF_A8R8G8B8; break;
+    case DXGI_FORMAT_B5G6R5_UNORM:
+        pf = DDSPF_R5G6B5; break;
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+        pf = DDSPF_A1R5G5B5; break;
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+        SETMASK( DDS_RGBA, 32, 0x000003ff, 0x000ffc00, 0x3ff00000, 0xc0000000 ); break;
+    case DXGI_FORMAT_R16G16_UNORM:
+        SETMASK( DDS_RGB, 32, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000 ); break;
+    case DXGI_FORMAT_R8_UNORM:
+        SETMASK( DDS_LUMINANCE, 8, 0x000000ff, 0x00000000, 0x00000000, 0x00000000 ); break;
+    case DXGI_FORMAT_R16_UNORM:
+        SETMASK( DDS_LUMINANCE, 16, 0x0000ffff, 0x00000000, 0x00000000, 0x00000000 ); break;
+    case DXGI_FORMAT_R8G8_UNORM:
+        SETMASK( DDS_LUMINANCEA, 16, 0x000000ff, 0x00000000, 0x00000000, 0x0000ff00 ); break;
+    case DXGI_FORMAT_A8_UNORM:
+        SETMASK( DDS_ALPHA, 8, 0x00000000, 0x00000000, 0x00000000, 0x000000ff ); break;
+
+    case DXGI_FORMAT_BC1_UNORM:             pf = DDSPF_DXT1; break;
+    case DXGI_FORMAT_BC2_UNORM:             pf = DDSPF_DXT3; break;
+    case DXGI_FORMAT_BC3_UNORM:             pf = DDSPF_DXT5; break;
+    case DXGI_FORMAT_BC4_UNORM:             SETFOURCC( MAKEFOURCC( 'B', 'C', '4', 'U' ) ); break;
+    case DXGI_FORMAT_BC4_SNORM:             SETFOURCC( MAKEFOURCC( 'B', 'C', '4', 'S' ) ); break;
+    case DXGI_FORMAT_BC5_UNORM:             SETFOURCC( MAKEFOURCC( 'A', 'T', 'I', '2' ) ); break;
+    case DXGI_FORMAT_BC5_SNORM:             SETFOURCC( MAKEFOURCC( 'B', 'C', '5', 'S' ) ); break;
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:       SETFOURCC( MAKEFOURCC( 'R', 'G', 'B', 'G' ) ); break;
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:       SETFOURCC( MAKEFOURCC( 'G', 'R', 'G', 'B' ) ); break;
+
+    // D3DFORMAT enums, as written by D3DX
+    case DXGI_FORMAT_R16G16B16A16_UNORM:    SETFOURCC( 36 ); break;  // D3DFMT_A16B16G16R16
+    case DXGI_FORMAT_R16G16B16A16_SNORM:    SETFOURCC( 110 ); break; // D3DFMT_Q16W16V16U16
+    case DXGI_FORMAT_R16_FLOAT:             SETFOURCC( 111 ); break; // D3DFMT_R16F
+    case DXGI_FORMAT_R16G16_FLOAT:          SETFOURCC( 112 ); break; // D3DFMT_G16R16F
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:    SETFOURCC( 113 ); break; // D3DFMT_A16B16G16R16F
+    case DXGI_FORMAT_R32_FLOAT:             SETFOURCC( 114 ); break; // D3DFMT_R32F
+    case DXGI_FORMAT_R32G32_FLOAT:          SETFOURCC( 115 ); break; // D3DFMT_G32R32F
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:    SETFOURCC( 116 ); break; // D3DFMT_A32B32G32R32F
+
+    default:
+        // sRGB, typeless and the remaining DXGI formats need the DX10 header
+        return false;
+    }
+
+#undef SETMASK
+#undef SETFOURCC
+
+    *pPF = pf;
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Work out the block compressed format to write for an 8bpc source and the writer
+// flags. Returns DXGI_FORMAT_UNKNOWN when the data is written as-is. *pbOpaque is set
+// for X8 sources, whose fourth byte must not end up in the encoded alpha.
+//--------------------------------------------------------------------------------------
+static DXGI_FORMAT GetEncodeFormat( DXGI_FORMAT fmt, UINT writerFlags, __out bool* pbBGRA, __out bool* pbOpaque )
+{
+    bool bSRGB = false;
+    *pbBGRA = false;
+    *pbOpaque = false;
+
+    switch( fmt )
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+        break;
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        bSRGB = true;
+        break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+        *pbBGRA = true;
+        break;
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+        *pbBGRA = true;
+        *pbOpaque = true;
+        break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        *pbBGRA = true;
+        bSRGB = true;
+        break;
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        *pbBGRA = true;
+        *pbOpaque = true;
+        bSRGB = true;
+        break;
+    default:
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+    if( writerFlags & DDS_WRITER_ENCODE_BC1 )
+        return bSRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+    if( writerFlags & DDS_WRITER_ENCODE_BC2 )
+        return bSRGB ? DXGI_FORMAT_BC2_UNORM_SRGB : DXGI_FORMAT_BC2_UNORM;
+    if( writerFlags & DDS_WRITER_ENCODE_BC3 )
+        return bSRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+
+//--------------------------------------------------------------------------------------
+// A horizontal band of blocks from one subresource, encoded on a thread pool thread
+//--------------------------------------------------------------------------------------
+struct DDS_ENCODE_CHUNK
+{
+    const BYTE* pSrc;       // top-left texel of the subresource
+    UINT SrcPitch;
+    UINT Width;
+    UINT Height;
+    UINT BlockRowStart;
+    UINT BlockRowCount;
+    DXGI_FORMAT Format;     // BC1, BC2 or BC3
+    bool bBGRA;
+    bool bOpaque;           // the source's fourth byte is undefined (X8), so alpha is 0xff
+    BYTE* pDest;
+    UINT DestSize;
+    HANDLE hDone;
+};
+
+//--------------------------------------------------------------------------------------
+static void EncodeChunk( DDS_ENCODE_CHUNK* pChunk )
+{
+    UINT BlocksWide = ( pChunk->Width + 3 ) / 4;
+    bool bAlphaBlock = ( pChunk->Format != DXGI_FORMAT_BC1_UNORM && pChunk->Format != DXGI_FORMAT_BC1_UNORM_SRGB );
+    bool bBC2 = ( pChunk->Format == DXGI_FORMAT_BC2_UNORM || pChunk->Format == DXGI_FORMAT_BC2_UNORM_SRGB );
+    BYTE* pDest = pChunk->pDest;
+
+    DWORD colors[DDS_BLOCK_TEXELS];
+    BYTE alpha[DDS_BLOCK_TEXELS];
+
+    for( UINT by = pChunk->BlockRowStart; by < pChunk->BlockRowStart + pChunk->BlockRowCount; by++ )
+    {
+        for( UINT bx = 0; bx < BlocksWide; bx++ )
+        {
+            // Gather the block, repeating the last row/column for partial edge blocks
+            for( UINT i = 0; i < DDS_BLOCK_TEXELS; i++ )
+            {
+                UINT x = min( bx * 4 + ( i & 3 ), pChunk->Width - 1 );
+                UINT y = min( by * 4 + ( i >> 2 ), pChunk->Height - 1 );
+                DWORD c = *( const DWORD* )( pChunk->pSrc + y * pChunk->SrcPitch + x * 4 );
+                if( pChunk->bBGRA )
+                    c = ( c & 0xff00ff00 ) | ( ( c >> 16 ) & 0xff ) | ( ( c & 0xff ) << 16 );
+                if( pChunk->bOpaque )
+                    c |= 0xff000000;
+                colors[i] = c;
+                alpha[i] = ( BYTE )( c >> 24 );
+            }
+
+            if( bAlphaBlock )
+            {
+                if( bBC2 )
+                    EncodeBC2AlphaBlock( alpha, pDest );
+                else
+                    EncodeBC3AlphaBlock( alpha, pDest );
+                pDest += 8;
+            }
+
+            EncodeBCColorBlock( colors, pDest );
+            pDest += 8;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+static DWORD WINAPI EncodeChunkProc( LPVOID pContext )
+{
+    DDS_ENCODE_CHUNK* pChunk = ( DDS_ENCODE_CHUNK* )pContext;
+    EncodeChunk( pChunk );
+    SetEvent( pChunk->hDone );
+    return 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT WriteBytes( HANDLE hFile, const void* pData, UINT Size )
+{
+    DWORD BytesWritten = 0;
+    if( !WriteFile( hFile, pData, Size, &BytesWritten, NULL ) || BytesWritten != Size )
+        return HRESULT_FROM_WIN32( GetLastError() );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Write one subresource tightly packed, as the loader expects
+//--------------------------------------------------------------------------------------
+static HRESULT WriteSubresource( HANDLE hFile, const D3D11_SUBRESOURCE_DATA* pData, UINT RowBytes, UINT NumRows )
+{
+    if( pData->SysMemPitch == RowBytes )
+        return WriteBytes( hFile, pData->pSysMem, RowBytes * NumRows );
+
+    HRESULT hr;
+    const BYTE* pSrc = ( const BYTE* )pData->pSysMem;
+    for( UINT r = 0; r < NumRows; r++ )
+    {
+        hr = WriteBytes( hFile, pSrc, RowBytes );
+        if( FAILED( hr ) )
+            return hr;
+        pSrc += pData->SysMemPitch;
+    }
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Block compress one subresource. The bands are encoded on the system thread pool and
+// written to the file in order as each one completes, so encoding overlaps with I/O and
+// only a bounded number of bands are held in memory at once.
+//--------------------------------------------------------------------------------------
+static HRESULT EncodeAndWriteSubresource( HANDLE hFile, const D3D11_SUBRESOURCE_DATA* pData, UINT Width, UINT Height,
+                                          DXGI_FORMAT EncodeFormat, bool bBGRA, bool bOpaque, UINT MaxInFlight )
+{
+    UINT RowBytes = 0;
+    GetSurfaceInfo( Width, Height, EncodeFormat, NULL, &RowBytes, NULL );
+
+    UINT BlocksHigh = ( Height + 3 ) / 4;
+    UINT NumChunks = ( BlocksHigh + DDS_ENCODE_CHUNK_BLOCK_ROWS - 1 ) / DDS_ENCODE_CHUNK_BLOCK_ROWS;
+
+    DDS_ENCODE_CHUNK* pChunks = new DDS_ENCODE_CHUNK[NumChunks];
+    if( !pChunks )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pChunks, sizeof( DDS_ENCODE_CHUNK ) * NumChunks );
+
+    HRESULT hr = S_OK;
+    UINT iIssued = 0;
+    UINT iWritten = 0;
+    while( iWritten < iIssued || ( SUCCEEDED( hr ) && iWritten < NumChunks ) )
+    {
+        // Keep the pool fed until the in-flight limit is reached
+        while( SUCCEEDED( hr ) && iIssued < NumChunks && iIssued - iWritten < MaxInFlight )
+        {
+            DDS_ENCODE_CHUNK* pChunk = &pChunks[iIssued];
+            pChunk->pSrc = ( const BYTE* )pData->pSysMem;
+            pChunk->SrcPitch = pData->SysMemPitch;
+            pChunk->Width = Width;
+            pChunk->Height = Height;
+            pChunk->BlockRowStart = iIssued * DDS_ENCODE_CHUNK_BLOCK_ROWS;
+            pChunk->BlockRowCount = min( ( UINT )DDS_ENCODE_CHUNK_BLOCK_ROWS, BlocksHigh - pChunk->BlockRowStart );
+            pChunk->Format = EncodeFormat;
+            pChunk->bBGRA = bBGRA;
+            pChunk->bOpaque = bOpaque;
+            pChunk->DestSize = RowBytes * pChunk->BlockRowCount;
+            pChunk->pDest = new BYTE[pChunk->DestSize];
+            pChunk->hDone = CreateEvent( NULL, TRUE, FALSE, NULL );
+            if( !pChunk->pDest || !pChunk->hDone )
+            {
+                SAFE_DELETE_ARRAY( pChunk->pDest );
+                if( pChunk->hDone )
+                    CloseHandle( pChunk->hDone );
+                pChunk->hDone = NULL;
+                hr = E_OUTOFMEMORY;
+                break;
+            }
+
+            // Fall back to encoding on this thread if the pool refuses the work item
+            if( !QueueUserWorkItem( EncodeChunkProc, pChunk, WT_EXECUTEDEFAULT ) )
+                EncodeChunkProc( pChunk );
+
+            iIssued++;
+        }
+
+        if( iWritten == iIssued )
+            break;
+
+        // Wait for the oldest band, write it out and release it. Bands still in flight
+        // after a failure are waited on but not written.
+        DDS_ENCODE_CHUNK* pChunk = &pChunks[iWritten];
+        WaitForSingleObject( pChunk->hDone, INFINITE );
+        if( SUCCEEDED( hr ) )
+            hr = WriteBytes( hFile, pChunk->pDest, pChunk->DestSize );
+        CloseHandle( pChunk->hDone );
+        SAFE_DELETE_ARRAY( pChunk->pDest );
+        iWritten++;
+    }
+
+    SAFE_DELETE_ARRAY( pChunks );
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT WriteDDSFile( HANDLE hFile, const DDS_WRITER_DESC* pDesc,
+                             const D3D11_SUBRESOURCE_DATA* pSubresources, UINT writerFlags )
+{
+    HRESULT hr;
+
+    bool bBGRA = false;
+    bool bOpaque = false;
+    DXGI_FORMAT EncodeFormat = GetEncodeFormat( pDesc->Format, writerFlags, &bBGRA, &bOpaque );
+    DXGI_FORMAT FileFormat = ( EncodeFormat != DXGI_FORMAT_UNKNOWN ) ? EncodeFormat : pDesc->Format;
+
+    UINT TopNumBytes = 0;
+    UINT TopRowBytes = 0;
+    GetSurfaceInfo( pDesc->Width, pDesc->Height, FileFormat, &TopNumBytes, &TopRowBytes, NULL );
+    bool bCompressed = IsCompressed( FileFormat );
+
+    DDS_HEADER header;
+    ZeroMemory( &header, sizeof( header ) );
+    header.dwSize = sizeof( DDS_HEADER );
+    header.dwHeaderFlags = DDS_HEADER_FLAGS_TEXTURE;
+    header.dwHeaderFlags |= bCompressed ? DDS_HEADER_FLAGS_LINEARSIZE : DDS_HEADER_FLAGS_PITCH;
+    header.dwHeight = pDesc->Height;
+    header.dwWidth = pDesc->Width;
+    header.dwPitchOrLinearSize = bCompressed ? TopNumBytes : TopRowBytes;
+    header.dwMipMapCount = pDesc->MipLevels;
+    header.dwSurfaceFlags = DDS_SURFACE_FLAGS_TEXTURE;
+    if( pDesc->MipLevels > 1 )
+    {
+        header.dwHeaderFlags |= DDS_HEADER_FLAGS_MIPMAP;
+        header.dwSurfaceFlags |= DDS_SURFACE_FLAGS_MIPMAP;
+    }
+    if( pDesc->bCubemap )
+    {
+        header.dwSurfaceFlags |= DDS_SURFACE_FLAGS_CUBEMAP;
+        header.dwCubemapFlags = DDS_CUBEMAP_ALLFACES;
+    }
+
+    // The legacy header can only describe a single texture or a single cube map
+    bool bLegacy = !( writerFlags & DDS_WRITER_FORCE_DX10_HEADER )
+                   && ( pDesc->ArraySize == 1 || ( pDesc->bCubemap && pDesc->ArraySize == 6 ) )
+                   && GetLegacyPixelFormat( FileFormat, &header.ddspf );
+
+    DDS_HEADER_DXT10 ext;
+    ZeroMemory( &ext, sizeof( ext ) );
+    if( !bLegacy )
+    {
+        header.ddspf = DDSPF_DX10;
+        ext.dxgiFormat = FileFormat;
+        ext.resourceDimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+        ext.miscFlag = pDesc->bCubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+        ext.arraySize = pDesc->bCubemap ? pDesc->ArraySize / 6 : pDesc->ArraySize;
+    }
+
+    DWORD dwMagicNumber = DDS_MAGIC;
+    hr = WriteBytes( hFile, &dwMagicNumber, sizeof( DWORD ) );
+    if( FAILED( hr ) )
+        return hr;
+    hr = WriteBytes( hFile, &header, sizeof( DDS_HEADER ) );
+    if( FAILED( hr ) )
+        return hr;
+    if( !bLegacy )
+    {
+        hr = WriteBytes( hFile, &ext, sizeof( DDS_HEADER_DXT10 ) );
+        if( FAILED( hr ) )
+            return hr;
+    }
+
+    SYSTEM_INFO si;
+    GetSystemInfo( &si );
+    UINT MaxInFlight = max( 1, si.dwNumberOfProcessors ) * DDS_ENCODE_CHUNKS_PER_CPU;
+
+    const D3D11_SUBRESOURCE_DATA* pData = pSubresources;
+    for( UINT j = 0; j < pDesc->ArraySize; j++ )
+    {
+        UINT w = pDesc->Width;
+        UINT h = pDesc->Height;
+        for( UINT i = 0; i < pDesc->MipLevels; i++, pData++ )
+        {
+            if( EncodeFormat != DXGI_FORMAT_UNKNOWN )
+            {
+                hr = EncodeAndWriteSubresource( hFile, pData, w, h, EncodeFormat, bBGRA, bOpaque, MaxInFlight );
+                if( FAILED( hr ) )
+                    return hr;
+            }
+            else
+            {
+                UINT RowBytes = 0;
+                UINT NumRows = 0;
+                GetSurfaceInfo( w, h, FileFormat, NULL, &RowBytes, &NumRows );
+                hr = WriteSubresource( hFile, pData, RowBytes, NumRows );
+                if( FAILED( hr ) )
+                    return hr;
+            }
+
+            w = max( 1, w >> 1 );
+            h = max( 1, h >> 1 );
+        }
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT SaveDDSTextureToFile( __in_z const WCHAR* szFileName, __in const DDS_WRITER_DESC* pDesc,
+                              __in_ecount(pDesc->MipLevels*pDesc->ArraySize) const D3D11_SUBRESOURCE_DATA* pSubresources,
+                              UINT writerFlags )
+{
+    if( !szFileName || !pDesc || !pSubresources )
+        return E_INVALIDARG;
+
+    if( pDesc->Width == 0 || pDesc->Height == 0 || pDesc->MipLevels == 0 || pDesc->ArraySize == 0
+        || ( pDesc->bCubemap && ( pDesc->ArraySize % 6 ) != 0 )
+        || pDesc->Format == DXGI_FORMAT_UNKNOWN || BitsPerPixel( pDesc->Format ) == 0 )
+        return E_INVALIDARG;
+
+    HANDLE hFile = CreateFile( szFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return HRESULT_FROM_WIN32( GetLastError() );
+
+    HRESULT hr = WriteDDSFile( hFile, pDesc, pSubresources, writerFlags );
+    CloseHandle( hFile );
+
+    // Don't leave a truncated file behind
+    if( FAILED( hr ) )
+        DeleteFile( szFileName );
+
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT SaveDDSTextureToFile( __in ID3D11DeviceContext* pContext, __in ID3D11Texture2D* pTexture,
+                              __in_z const WCHAR* szFileName, UINT writerFlags )
+{
+    if( !pContext || !pTexture || !szFileName )
+        return E_INVALIDARG;
+
+    HRESULT hr;
+
+    D3D11_TEXTURE2D_DESC desc;
+    pTexture->GetDesc( &desc );
+
+    // Multisampled surfaces must be resolved by the caller
+    if( desc.SampleDesc.Count > 1 )
+        return E_INVALIDARG;
+
+    ID3D11Device* pDev = NULL;
+    pContext->GetDevice( &pDev );
+
+    D3D11_TEXTURE2D_DESC StagingDesc = desc;
+    StagingDesc.Usage = D3D11_USAGE_STAGING;
+    StagingDesc.BindFlags = 0;
+    StagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    StagingDesc.MiscFlags &= D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+    ID3D11Texture2D* pStaging = NULL;
+    hr = pDev->CreateTexture2D( &StagingDesc, NULL, &pStaging );
+    SAFE_RELEASE( pDev );
+    if( FAILED( hr ) )
+        return hr;
+
+    pContext->CopyResource( pStaging, pTexture );
+
+    UINT NumSubresources = desc.MipLevels * desc.ArraySize;
+    D3D11_SUBRESOURCE_DATA* pData = new D3D11_SUBRESOURCE_DATA[NumSubresources];
+    if( !pData )
+    {
+        SAFE_RELEASE( pStaging );
+        return E_OUTOFMEMORY;
+    }
+
+    // D3D11 subresource indices run mip-major within each array slice, which is the same
+    // order the file uses
+    UINT iMapped = 0;
+    for( ; iMapped < NumSubresources; iMapped++ )
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        hr = pContext->Map( pStaging, iMapped, D3D11_MAP_READ, 0, &mapped );
+        if( FAILED( hr ) )
+            break;
+        pData[iMapped].pSysMem = mapped.pData;
+        pData[iMapped].SysMemPitch = mapped.RowPitch;
+        pData[iMapped].SysMemSlicePitch = mapped.DepthPitch;
+    }
+
+    if( SUCCEEDED( hr ) )
+    {
+        DDS_WRITER_DESC WriterDesc;
+        WriterDesc.Width = desc.Width;
+        WriterDesc.Height = desc.Height;
+        WriterDesc.MipLevels = desc.MipLevels;
+        WriterDesc.ArraySize = desc.ArraySize;
+        WriterDesc.Format = desc.Format;
+        WriterDesc.bCubemap = ( desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE ) != 0;
+
+        hr = SaveDDSTextureToFile( szFileName, &WriterDesc, pData, writerFlags );
+    }
+
+    for( UINT i = 0; i < iMapped; i++ )
+        pContext->Unmap( pStaging, i );
+
+    SAFE_DELETE_ARRAY( pData );
+    SAFE_RELEASE( pStaging );
+
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+// A save handed to the thread pool. The texels are a private copy, so the texture and
+// the context are free again as soon as SaveDDSTextureToFileAsync returns.
+//--------------------------------------------------------------------------------------
+struct DDS_SAVE_JOB
+{
+    WCHAR szFileName[MAX_PATH];
+    DDS_WRITER_DESC Desc;
+    D3D11_SUBRESOURCE_DATA* pSubresources;
+    BYTE* pTexels;
+    UINT WriterFlags;
+};
+
+static volatile LONG g_NumPendingSaves = 0;
+
+//--------------------------------------------------------------------------------------
+static void FreeSaveJob( DDS_SAVE_JOB* pJob )
+{
+    SAFE_DELETE_ARRAY( pJob->pSubresources );
+    SAFE_DELETE_ARRAY( pJob->pTexels );
+    delete pJob;
+}
+
+//--------------------------------------------------------------------------------------
+static DWORD WINAPI SaveJobProc( LPVOID pContext )
+{
+    DDS_SAVE_JOB* pJob = ( DDS_SAVE_JOB* )pContext;
+    SaveDDSTextureToFile( pJob->szFileName, &pJob->Desc, pJob->pSubresources, pJob->WriterFlags );
+    FreeSaveJob( pJob );
+    InterlockedDecrement( &g_NumPendingSaves );
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Only the copy back from the GPU happens on the calling thread; the encode and the
+// file I/O run on the thread pool
+//--------------------------------------------------------------------------------------
+HRESULT SaveDDSTextureToFileAsync( __in ID3D11DeviceContext* pContext, __in ID3D11Texture2D* pTexture,
+                                   __in_z const WCHAR* szFileName, UINT writerFlags )
+{
+    if( !pContext || !pTexture || !szFileName || wcslen( szFileName ) >= MAX_PATH )
+        return E_INVALIDARG;
+
+    HRESULT hr;
+
+    D3D11_TEXTURE2D_DESC desc;
+    pTexture->GetDesc( &desc );
+    if( desc.SampleDesc.Count > 1 || BitsPerPixel( desc.Format ) == 0 )
+        return E_INVALIDARG;
+
+    DDS_SAVE_JOB* pJob = new DDS_SAVE_JOB;
+    if( !pJob )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pJob, sizeof( DDS_SAVE_JOB ) );
+    wcscpy_s( pJob->szFileName, MAX_PATH, szFileName );
+    pJob->Desc.Width = desc.Width;
+    pJob->Desc.Height = desc.Height;
+    pJob->Desc.MipLevels = desc.MipLevels;
+    pJob->Desc.ArraySize = desc.ArraySize;
+    pJob->Desc.Format = desc.Format;
+    pJob->Desc.bCubemap = ( desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE ) != 0;
+    pJob->WriterFlags = writerFlags;
+
+    // Each subresource is copied tightly packed into one block
+    UINT NumSubresources = desc.MipLevels * desc.ArraySize;
+    SIZE_T TotalBytes = 0;
+    for( UINT j = 0; j < desc.ArraySize; j++ )
+    {
+        for( UINT i = 0; i < desc.MipLevels; i++ )
+        {
+            UINT NumBytes = 0;
+            GetSurfaceInfo( max( 1, desc.Width >> i ), max( 1, desc.Height >> i ), desc.Format, &NumBytes, NULL, NULL );
+            TotalBytes += NumBytes;
+        }
+    }
+
+    pJob->pSubresources = new D3D11_SUBRESOURCE_DATA[NumSubresources];
+    pJob->pTexels = new BYTE[ max( TotalBytes, 1 ) ];
+    if( !pJob->pSubresources || !pJob->pTexels )
+    {
+        FreeSaveJob( pJob );
+        return E_OUTOFMEMORY;
+    }
+
+    ID3D11Device* pDev = NULL;
+    pContext->GetDevice( &pDev );
+
+    D3D11_TEXTURE2D_DESC StagingDesc = desc;
+    StagingDesc.Usage = D3D11_USAGE_STAGING;
+    StagingDesc.BindFlags = 0;
+    StagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    StagingDesc.MiscFlags &= D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+    ID3D11Texture2D* pStaging = NULL;
+    hr = pDev->CreateTexture2D( &StagingDesc, NULL, &pStaging );
+    SAFE_RELEASE( pDev );
+    if( FAILED( hr ) )
+    {
+        FreeSaveJob( pJob );
+        return hr;
+    }
+
+    pContext->CopyResource( pStaging, pTexture );
+
+    BYTE* pDest = pJob->pTexels;
+    for( UINT iSub = 0; iSub < NumSubresources && SUCCEEDED( hr ); iSub++ )
+    {
+        UINT Mip = iSub % desc.MipLevels;
+        UINT RowBytes = 0;
+        UINT NumRows = 0;
+        GetSurfaceInfo( max( 1, desc.Width >> Mip ), max( 1, desc.Height >> Mip ), desc.Format, NULL, &RowBytes,
+                        &NumRows );
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        hr = pContext->Map( pStaging, iSub, D3D11_MAP_READ, 0, &mapped );
+        if( FAILED( hr ) )
+            break;
+        for( UINT r = 0; r < NumRows; r++ )
+            CopyMemory( pDest + r * RowBytes, ( const BYTE* )mapped.pData + r * mapped.RowPitch, RowBytes );
+        pContext->Unmap( pStaging, iSub );
+
+        pJob->pSubresources[iSub].pSysMem = pDest;
+        pJob->pSubresources[iSub].SysMemPitch = RowBytes;
+        pJob->pSubresources[iSub].SysMemSlicePitch = RowBytes * NumRows;
+        pDest += RowBytes * NumRows;
+    }
+    SAFE_RELEASE( pStaging );
+
+    if( FAILED( hr ) )
+    {
+        FreeSaveJob( pJob );
+        return hr;
+    }
+
+    InterlockedIncrement( &g_NumPendingSaves );
+    if( !QueueUserWorkItem( SaveJobProc, pJob, WT_EXECUTELONGFUNCTION ) )
+        SaveJobProc( pJob );
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void WaitForDDSSaves()
+{
+    while( g_NumPendingSaves > 0 )
+        Sleep( 1 );
+}
@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------------------
+// File: DDSTextureWriter.h
+//
+// Functions for saving a DDS texture without using D3DX
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef _DDSTEXTUREWRITER_H_
+#define _DDSTEXTUREWRITER_H_
+
+#include <d3d11.h>
+
+//--------------------------------------------------------------------------------------
+// Writer flags
+//--------------------------------------------------------------------------------------
+enum DDS_WRITER_FLAGS
+{
+    DDS_WRITER_DEFAULT              = 0,
+    DDS_WRITER_FORCE_DX10_HEADER    = 0x1,  // always write the DX10 extension header
+    DDS_WRITER_ENCODE_BC1           = 0x2,  // block compress 8bpc RGBA/BGRA data on write
+    DDS_WRITER_ENCODE_BC2           = 0x4,
+    DDS_WRITER_ENCODE_BC3           = 0x8,
+};
+
+//--------------------------------------------------------------------------------------
+// Describes the texture passed to SaveDDSTextureToFile. Subresources are ordered the
+// same way as D3D11_SUBRESOURCE_DATA for CreateTexture2D: each array slice (or cube
+// face) in turn, with its mip levels in order.
+//--------------------------------------------------------------------------------------
+struct DDS_WRITER_DESC
+{
+    UINT Width;
+    UINT Height;
+    UINT MipLevels;
+    UINT ArraySize;     // multiple of 6 when bCubemap is set
+    DXGI_FORMAT Format;
+    bool bCubemap;
+};
+
+HRESULT SaveDDSTextureToFile( __in_z const WCHAR* szFileName, __in const DDS_WRITER_DESC* pDesc,
+                              __in_ecount(pDesc->MipLevels*pDesc->ArraySize) const D3D11_SUBRESOURCE_DATA* pSubresources,
+                              UINT writerFlags );
+
+// Copies the texture to a staging resource and writes every subresource
+HRESULT SaveDDSTextureToFile( __in ID3D11DeviceContext* pContext, __in ID3D11Texture2D* pTexture,
+                              __in_z const WCHAR* szFileName, UINT writerFlags );
+
+// The same without holding up the caller: the texture is copied back to memory before
+// this returns, and the encode and the write then happen on the thread pool. A failure
+// there leaves no file behind. WaitForDDSSaves blocks until every save has finished,
+// which should happen before exit.
+HRESULT SaveDDSTextureToFileAsync( __in ID3D11DeviceContext* pContext, __in ID3D11Texture2D* pTexture,
+                                   __in_z const WCHAR* szFileName, UINT writerFlags );
+void WaitForDDSSaves();
+
+#endif // _DDSTEXTUREWRITER_H_
@@ -0,0 +1,462 @@
+//--------------------------------------------------------------------------------------
+// File: DDSTiledLayout.cpp
+//
+// Morton (Z-order) tiled layout for CPU-resident 8bpc RGBA texture data
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DDSConvert.h"
+#include "DDSTiledLayout.h"
+#include <emmintrin.h>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+HRESULT CreateTiledSurface( UINT Width, UINT Height, DDS_TILED_SURFACE* pSurface )
+{
+    if( !pSurface || Width == 0 || Height == 0 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pSurface, sizeof( DDS_TILED_SURFACE ) );
+
+    UINT TilesWide = ( Width + DDS_TILE_DIM - 1 ) >> DDS_TILE_SHIFT;
+    UINT TilesHigh = ( Height + DDS_TILE_DIM - 1 ) >> DDS_TILE_SHIFT;
+    UINT64 NumTexels = ( UINT64 )TilesWide * TilesHigh * DDS_TILE_TEXELS;
+    if( NumTexels * sizeof( DWORD ) > 0xffffffff )
+        return E_INVALIDARG;
+
+    // 16 byte alignment for the SSE2 loads and stores; tiles are 4KB so this also keeps
+    // every tile on its own cache lines
+    pSurface->pTexels = ( DWORD* )_aligned_malloc( ( size_t )NumTexels * sizeof( DWORD ), 16 );
+    if( !pSurface->pTexels )
+        return E_OUTOFMEMORY;
+
+    pSurface->Width = Width;
+    pSurface->Height = Height;
+    pSurface->TilesWide = TilesWide;
+    pSurface->TilesHigh = TilesHigh;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void DestroyTiledSurface( DDS_TILED_SURFACE* pSurface )
+{
+    if( !pSurface )
+        return;
+
+    if( pSurface->pTexels )
+        _aligned_free( pSurface->pTexels );
+    ZeroMemory( pSurface, sizeof( DDS_TILED_SURFACE ) );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Tiles are filled 4x2 texels at a time. With x a multiple of 4 and y a multiple of 2,
+// those 8 texels are the Z-order run [Morton(x,y), Morton(x,y)+8): the left 2x2 quad
+// followed by the right one. Each quad is the low (or high) halves of the two rows.
+//--------------------------------------------------------------------------------------
+void LinearToTiledRGBA8( const BYTE* pSrc, UINT SrcPitch, DDS_TILED_SURFACE* pDest )
+{
+    UINT Width = pDest->Width;
+    UINT Height = pDest->Height;
+
+    for( UINT ty = 0; ty < pDest->TilesHigh; ty++ )
+    {
+        for( UINT tx = 0; tx < pDest->TilesWide; tx++ )
+        {
+            DWORD* pTile = pDest->pTexels + ( ty * pDest->TilesWide + tx ) * DDS_TILE_TEXELS;
+
+            for( UINT by = 0; by < DDS_TILE_DIM; by += 2 )
+            {
+                UINT y = ty * DDS_TILE_DIM + by;
+                for( UINT bx = 0; bx < DDS_TILE_DIM; bx += 4 )
+                {
+                    UINT x = tx * DDS_TILE_DIM + bx;
+                    DWORD* pOut = pTile + DDSMortonEncode2D( bx, by );
+
+                    if( x + 4 <= Width && y + 2 <= Height )
+                    {
+                        const BYTE* pRow0 = pSrc + y * SrcPitch + x * 4;
+                        __m128i r0 = _mm_loadu_si128( ( const __m128i* )pRow0 );
+                        __m128i r1 = _mm_loadu_si128( ( const __m128i* )( pRow0 + SrcPitch ) );
+                        _mm_store_si128( ( __m128i* )pOut, _mm_unpacklo_epi64( r0, r1 ) );
+                        _mm_store_si128( ( __m128i* )( pOut + 4 ), _mm_unpackhi_epi64( r0, r1 ) );
+                    }
+                    else
+                    {
+                        // Edge of the image: repeat the last valid column and row
+                        for( UINT i = 0; i < 8; i++ )
+                        {
+                            UINT sx = min( x + ( i & 1 ) + ( ( i >> 2 ) << 1 ), Width - 1 );
+                            UINT sy = min( y + ( ( i >> 1 ) & 1 ), Height - 1 );
+                            pOut[i] = *( const DWORD* )( pSrc + sy * SrcPitch + sx * 4 );
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void TiledToLinearRGBA8( const DDS_TILED_SURFACE* pSrc, BYTE* pDest, UINT DestPitch )
+{
+    UINT Width = pSrc->Width;
+    UINT Height = pSrc->Height;
+
+    for( UINT ty = 0; ty < pSrc->TilesHigh; ty++ )
+    {
+        for( UINT tx = 0; tx < pSrc->TilesWide; tx++ )
+        {
+            const DWORD* pTile = pSrc->pTexels + ( ty * pSrc->TilesWide + tx ) * DDS_TILE_TEXELS;
+
+            for( UINT by = 0; by < DDS_TILE_DIM; by += 2 )
+            {
+                UINT y = ty * DDS_TILE_DIM + by;
+                if( y >= Height )
+                    break;
+
+                for( UINT bx = 0; bx < DDS_TILE_DIM; bx += 4 )
+                {
+                    UINT x = tx * DDS_TILE_DIM + bx;
+                    if( x >= Width )
+                        break;
+
+                    const DWORD* pIn = pTile + DDSMortonEncode2D( bx, by );
+                    BYTE* pRow0 = pDest + y * DestPitch + x * 4;
+
+                    if( x + 4 <= Width && y + 2 <= Height )
+                    {
+                        __m128i q0 = _mm_load_si128( ( const __m128i* )pIn );
+                        __m128i q1 = _mm_load_si128( ( const __m128i* )( pIn + 4 ) );
+                        _mm_storeu_si128( ( __m128i* )pRow0, _mm_unpacklo_epi64( q0, q1 ) );
+                        _mm_storeu_si128( ( __m128i* )( pRow0 + DestPitch ), _mm_unpackhi_epi64( q0, q1 ) );
+                    }
+                    else
+                    {
+                        for( UINT i = 0; i < 8; i++ )
+                        {
+                            UINT dx = x + ( i & 1 ) + ( ( i >> 2 ) << 1 );
+                            UINT dy = y + ( ( i >> 1 ) & 1 );
+                            if( dx < Width && dy < Height )
+                                *( DWORD* )( pDest + dy * DestPitch + dx * 4 ) = pIn[i];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void PadTiledSurfaceEdges( DDS_TILED_SURFACE* pSurface )
+{
+    UINT PaddedWidth = pSurface->TilesWide * DDS_TILE_DIM;
+    UINT PaddedHeight = pSurface->TilesHigh * DDS_TILE_DIM;
+    UINT Width = pSurface->Width;
+    UINT Height = pSurface->Height;
+
+    if( Width < PaddedWidth )
+    {
+        for( UINT y = 0; y < Height; y++ )
+        {
+            DWORD Edge = *DDSTiledTexel( pSurface, Width - 1, y );
+            for( UINT x = Width; x < PaddedWidth; x++ )
+                *DDSTiledTexel( pSurface, x, y ) = Edge;
+        }
+    }
+
+    for( UINT y = Height; y < PaddedHeight; y++ )
+    {
+        for( UINT x = 0; x < PaddedWidth; x++ )
+            *DDSTiledTexel( pSurface, x, y ) = *DDSTiledTexel( pSurface, x, Height - 1 );
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Box filter the four consecutive texels at pQuad (one 2x2 quad in Z-order)
+//--------------------------------------------------------------------------------------
+static inline __m128i SumQuad( const DWORD* pQuad, __m128i zero )
+{
+    __m128i q = _mm_load_si128( ( const __m128i* )pQuad );
+    __m128i s = _mm_add_epi16( _mm_unpacklo_epi8( q, zero ), _mm_unpackhi_epi8( q, zero ) );
+    return _mm_add_epi16( s, _mm_srli_si128( s, 8 ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Each quadrant of a destination tile comes from one whole source tile. Since
+// Morton(2x,2y) = 4 * Morton(x,y), destination texel i of the quadrant is the average
+// of source texels 4i..4i+3, so both sides are read and written strictly in order.
+//--------------------------------------------------------------------------------------
+void DownsampleTiledRGBA8( const DDS_TILED_SURFACE* pSrc, DDS_TILED_SURFACE* pDest )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16( 2 );
+    const UINT QuadrantTexels = DDS_TILE_TEXELS / 4;
+
+    for( UINT ty = 0; ty < pDest->TilesHigh; ty++ )
+    {
+        for( UINT tx = 0; tx < pDest->TilesWide; tx++ )
+        {
+            DWORD* pDestTile = pDest->pTexels + ( ty * pDest->TilesWide + tx ) * DDS_TILE_TEXELS;
+
+            for( UINT q = 0; q < 4; q++ )
+            {
+                UINT sx = tx * 2 + ( q & 1 );
+                UINT sy = ty * 2 + ( q >> 1 );
+
+                // Source tiles past the edge only feed padding, which is refilled below
+                if( sx >= pSrc->TilesWide || sy >= pSrc->TilesHigh )
+                    continue;
+
+                const DWORD* pIn = pSrc->pTexels + ( sy * pSrc->TilesWide + sx ) * DDS_TILE_TEXELS;
+                DWORD* pOut = pDestTile + q * QuadrantTexels;
+
+                for( UINT i = 0; i < QuadrantTexels; i += 4, pIn += 16 )
+                {
+                    __m128i s0 = SumQuad( pIn, zero );
+                    __m128i s1 = SumQuad( pIn + 4, zero );
+                    __m128i s2 = SumQuad( pIn + 8, zero );
+                    __m128i s3 = SumQuad( pIn + 12, zero );
+                    __m128i lo = _mm_srli_epi16( _mm_add_epi16( _mm_unpacklo_epi64( s0, s1 ), round ), 2 );
+                    __m128i hi = _mm_srli_epi16( _mm_add_epi16( _mm_unpacklo_epi64( s2, s3 ), round ), 2 );
+                    _mm_store_si128( ( __m128i* )( pOut + i ), _mm_packus_epi16( lo, hi ) );
+                }
+            }
+        }
+    }
+
+    PadTiledSurfaceEdges( pDest );
+}
+
+
+//--------------------------------------------------------------------------------------
+static inline DWORD BlendBilinear( DWORD c00, DWORD c10, DWORD c01, DWORD c11, UINT fx, UINT fy )
+{
+    // fx, fy are 8-bit fractions
+    DWORD Result = 0;
+    for( UINT c = 0; c < 32; c += 8 )
+    {
+        UINT top = ( ( c00 >> c ) & 0xff ) * ( 256 - fx ) + ( ( c10 >> c ) & 0xff ) * fx;
+        UINT bottom = ( ( c01 >> c ) & 0xff ) * ( 256 - fx ) + ( ( c11 >> c ) & 0xff ) * fx;
+        UINT v = ( top * ( 256 - fy ) + bottom * fy + 32768 ) >> 16;
+        Result |= v << c;
+    }
+    return Result;
+}
+
+//--------------------------------------------------------------------------------------
+static inline void GetBilinearFootprint( float f, UINT Size, UINT* p0, UINT* p1, UINT* pFrac )
+{
+    f -= 0.5f;
+    float fl = floorf( f );
+    int i0 = ( int )fl;
+    *pFrac = ( UINT )( ( f - fl ) * 256.0f );
+    int i1 = i0 + 1;
+    i0 = max( 0, min( i0, ( int )Size - 1 ) );
+    i1 = max( 0, min( i1, ( int )Size - 1 ) );
+    *p0 = ( UINT )i0;
+    *p1 = ( UINT )i1;
+}
+
+//--------------------------------------------------------------------------------------
+DWORD SampleBilinearRGBA8( const BYTE* pSrc, UINT Width, UINT Height, UINT Pitch, float x, float y )
+{
+    UINT x0, x1, y0, y1, fx, fy;
+    GetBilinearFootprint( x, Width, &x0, &x1, &fx );
+    GetBilinearFootprint( y, Height, &y0, &y1, &fy );
+
+    const DWORD* pRow0 = ( const DWORD* )( pSrc + y0 * Pitch );
+    const DWORD* pRow1 = ( const DWORD* )( pSrc + y1 * Pitch );
+    return BlendBilinear( pRow0[x0], pRow0[x1], pRow1[x0], pRow1[x1], fx, fy );
+}
+
+//--------------------------------------------------------------------------------------
+DWORD SampleBilinearTiledRGBA8( const DDS_TILED_SURFACE* pSrc, float x, float y )
+{
+    UINT x0, x1, y0, y1, fx, fy;
+    GetBilinearFootprint( x, pSrc->Width, &x0, &x1, &fx );
+    GetBilinearFootprint( y, pSrc->Height, &y0, &y1, &fy );
+
+    return BlendBilinear( *DDSTiledTexel( pSrc, x0, y0 ), *DDSTiledTexel( pSrc, x1, y0 ),
+                          *DDSTiledTexel( pSrc, x0, y1 ), *DDSTiledTexel( pSrc, x1, y1 ), fx, fy );
+}
+
+
+//--------------------------------------------------------------------------------------
+CDDSTiledIterator::CDDSTiledIterator( const DDS_TILED_SURFACE* pSurface )
+{
+    m_pSurface = pSurface;
+    m_NumTiles = pSurface->TilesWide * pSurface->TilesHigh;
+    m_Tile = 0;
+    m_Index = 0;
+    m_X = 0;
+    m_Y = 0;
+    SkipPadding();
+}
+
+//--------------------------------------------------------------------------------------
+void CDDSTiledIterator::Next()
+{
+    m_Index++;
+    if( m_Index == DDS_TILE_TEXELS )
+    {
+        m_Index = 0;
+        m_Tile++;
+    }
+    SkipPadding();
+}
+
+//--------------------------------------------------------------------------------------
+void CDDSTiledIterator::SkipPadding()
+{
+    while( m_Tile < m_NumTiles )
+    {
+        m_X = ( m_Tile % m_pSurface->TilesWide ) * DDS_TILE_DIM + DDSMortonCompact1By1( m_Index );
+        m_Y = ( m_Tile / m_pSurface->TilesWide ) * DDS_TILE_DIM + DDSMortonCompact1By1( m_Index >> 1 );
+        if( m_X < m_pSurface->Width && m_Y < m_pSurface->Height )
+            return;
+
+        m_Index++;
+        if( m_Index == DDS_TILE_TEXELS )
+        {
+            m_Index = 0;
+            m_Tile++;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+static double GetElapsedMs( const LARGE_INTEGER& Start, const LARGE_INTEGER& Frequency )
+{
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter( &Now );
+    return ( double )( Now.QuadPart - Start.QuadPart ) * 1000.0 / ( double )Frequency.QuadPart;
+}
+
+//--------------------------------------------------------------------------------------
+static volatile DWORD s_BenchmarkSink = 0;
+
+HRESULT DDSBenchmarkTiledLayout( UINT Size, DDS_TILED_BENCHMARK* pResults )
+{
+    if( !pResults || Size < 2 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResults, sizeof( DDS_TILED_BENCHMARK ) );
+
+    UINT NumMips = 1;
+    while( ( Size >> NumMips ) > 0 )
+        NumMips++;
+
+    HRESULT hr = S_OK;
+    BYTE** ppLinear = new BYTE*[NumMips];
+    DDS_TILED_SURFACE* pTiled = new DDS_TILED_SURFACE[NumMips];
+    BYTE* pScratch = NULL;
+    if( !ppLinear || !pTiled )
+    {
+        SAFE_DELETE_ARRAY( ppLinear );
+        SAFE_DELETE_ARRAY( pTiled );
+        return E_OUTOFMEMORY;
+    }
+    ZeroMemory( ppLinear, sizeof( BYTE* ) * NumMips );
+    ZeroMemory( pTiled, sizeof( DDS_TILED_SURFACE ) * NumMips );
+
+    for( UINT i = 0; i < NumMips && SUCCEEDED( hr ); i++ )
+    {
+        UINT s = max( 1, Size >> i );
+        ppLinear[i] = new BYTE[s * s * 4];
+        if( !ppLinear[i] )
+            hr = E_OUTOFMEMORY;
+        else
+            hr = CreateTiledSurface( s, s, &pTiled[i] );
+    }
+    if( SUCCEEDED( hr ) )
+    {
+        pScratch = new BYTE[Size * Size * 4];
+        if( !pScratch )
+            hr = E_OUTOFMEMORY;
+    }
+
+    if( SUCCEEDED( hr ) )
+    {
+        // Something with detail at every scale, so the filters do real work
+        DWORD* pTexels = ( DWORD* )ppLinear[0];
+        for( UINT y = 0; y < Size; y++ )
+        {
+            for( UINT x = 0; x < Size; x++ )
+                pTexels[y * Size + x] = ( x * 7 ) ^ ( ( y * 13 ) << 8 ) ^ ( ( x * y ) << 16 ) ^ 0xff000000;
+        }
+
+        LARGE_INTEGER Frequency, Start;
+        QueryPerformanceFrequency( &Frequency );
+
+        QueryPerformanceCounter( &Start );
+        LinearToTiledRGBA8( ppLinear[0], Size * 4, &pTiled[0] );
+        pResults->LinearToTiledMs = GetElapsedMs( Start, Frequency );
+
+        QueryPerformanceCounter( &Start );
+        TiledToLinearRGBA8( &pTiled[0], pScratch, Size * 4 );
+        pResults->TiledToLinearMs = GetElapsedMs( Start, Frequency );
+
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 1; i < NumMips; i++ )
+        {
+            UINT s = max( 1, Size >> ( i - 1 ) );
+            DownsampleRGBA8( ppLinear[i - 1], s, s, s * 4, ppLinear[i], max( 1, s >> 1 ) * 4 );
+        }
+        pResults->LinearMipChainMs = GetElapsedMs( Start, Frequency );
+
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 1; i < NumMips; i++ )
+            DownsampleTiledRGBA8( &pTiled[i - 1], &pTiled[i] );
+        pResults->TiledMipChainMs = GetElapsedMs( Start, Frequency );
+
+        // A 30 degree rotated walk at one sample per texel, which is what a CPU-side
+        // resample or a software rasterizer sees. Row-major layouts touch a new cache
+        // line on almost every step down the rotated rows.
+        const float fCos = 0.8660254f;
+        const float fSin = 0.5f;
+        const float fCentre = Size * 0.5f;
+        DWORD Sink = 0;
+
+        QueryPerformanceCounter( &Start );
+        for( UINT v = 0; v < Size; v++ )
+        {
+            for( UINT u = 0; u < Size; u++ )
+            {
+                float du = u - fCentre, dv = v - fCentre;
+                Sink ^= SampleBilinearRGBA8( ppLinear[0], Size, Size, Size * 4,
+                                             fCentre + du * fCos - dv * fSin, fCentre + du * fSin + dv * fCos );
+            }
+        }
+        pResults->LinearSampleMs = GetElapsedMs( Start, Frequency );
+
+        QueryPerformanceCounter( &Start );
+        for( UINT v = 0; v < Size; v++ )
+        {
+            for( UINT u = 0; u < Size; u++ )
+            {
+                float du = u - fCentre, dv = v - fCentre;
+                Sink ^= SampleBilinearTiledRGBA8( &pTiled[0], fCentre + du * fCos - dv * fSin,
+                                                  fCentre + du * fSin + dv * fCos );
+            }
+        }
+        pResults->TiledSampleMs = GetElapsedMs( Start, Frequency );
+
+        // Keep the sampling loops from being optimized away
+        s_BenchmarkSink = Sink;
+    }
+
+    SAFE_DELETE_ARRAY( pScratch );
+    for( UINT i = 0; i < NumMips; i++ )
+    {
+        SAFE_DELETE_ARRAY( ppLinear[i] );
+        DestroyTiledSurface( &pTiled[i] );
+    }
+    SAFE_DELETE_ARRAY( ppLinear );
+    SAFE_DELETE_ARRAY( pTiled );
+
+    return hr;
+}
@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------------------
+// File: DDSTiledLayout.h
+//
+// Morton (Z-order) tiled layout for CPU-resident 8bpc RGBA texture data
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef _DDSTILEDLAYOUT_H_
+#define _DDSTILEDLAYOUT_H_
+
+//--------------------------------------------------------------------------------------
+// A tiled surface is a row-major grid of 32x32 texel tiles (4KB at 4 bytes a texel).
+// Texels inside a tile are stored in Z-order, so any 2^n x 2^n aligned block is
+// contiguous: a 2x2 quad is 16 bytes and a 4x4 block is one 64 byte cache line. The
+// right and bottom tiles are padded out, and the padding repeats the last valid column
+// and row so filters can read past the edge without clamping.
+//--------------------------------------------------------------------------------------
+#define DDS_TILE_DIM        32
+#define DDS_TILE_SHIFT      5
+#define DDS_TILE_TEXELS     ( DDS_TILE_DIM * DDS_TILE_DIM )
+
+struct DDS_TILED_SURFACE
+{
+    DWORD* pTexels;     // 0xAABBGGRR for RGBA data; channel order is preserved as-is
+    UINT Width;
+    UINT Height;
+    UINT TilesWide;
+    UINT TilesHigh;
+};
+
+//--------------------------------------------------------------------------------------
+// Spread the low 16 bits of v out to the even bits of the result, and back
+//--------------------------------------------------------------------------------------
+inline UINT DDSMortonPart1By1( UINT v )
+{
+    v &= 0x0000ffff;
+    v = ( v | ( v << 8 ) ) & 0x00ff00ff;
+    v = ( v | ( v << 4 ) ) & 0x0f0f0f0f;
+    v = ( v | ( v << 2 ) ) & 0x33333333;
+    v = ( v | ( v << 1 ) ) & 0x55555555;
+    return v;
+}
+
+inline UINT DDSMortonCompact1By1( UINT v )
+{
+    v &= 0x55555555;
+    v = ( v | ( v >> 1 ) ) & 0x33333333;
+    v = ( v | ( v >> 2 ) ) & 0x0f0f0f0f;
+    v = ( v | ( v >> 4 ) ) & 0x00ff00ff;
+    v = ( v | ( v >> 8 ) ) & 0x0000ffff;
+    return v;
+}
+
+inline UINT DDSMortonEncode2D( UINT x, UINT y )
+{
+    return DDSMortonPart1By1( x ) | ( DDSMortonPart1By1( y ) << 1 );
+}
+
+inline UINT DDSTiledTexelIndex( const DDS_TILED_SURFACE* pSurface, UINT x, UINT y )
+{
+    UINT Tile = ( y >> DDS_TILE_SHIFT ) * pSurface->TilesWide + ( x >> DDS_TILE_SHIFT );
+    return Tile * DDS_TILE_TEXELS + DDSMortonEncode2D( x & ( DDS_TILE_DIM - 1 ), y & ( DDS_TILE_DIM - 1 ) );
+}
+
+inline DWORD* DDSTiledTexel( const DDS_TILED_SURFACE* pSurface, UINT x, UINT y )
+{
+    return pSurface->pTexels + DDSTiledTexelIndex( pSurface, x, y );
+}
+
+//--------------------------------------------------------------------------------------
+// Allocation and conversion. Pitches are in bytes.
+//--------------------------------------------------------------------------------------
+HRESULT CreateTiledSurface( UINT Width, UINT Height, __out DDS_TILED_SURFACE* pSurface );
+void DestroyTiledSurface( __inout DDS_TILED_SURFACE* pSurface );
+
+void LinearToTiledRGBA8( __in const BYTE* pSrc, UINT SrcPitch, __inout DDS_TILED_SURFACE* pDest );
+void TiledToLinearRGBA8( __in const DDS_TILED_SURFACE* pSrc, __out BYTE* pDest, UINT DestPitch );
+
+// Re-fill the padding from the last valid column and row after writing texels directly
+void PadTiledSurfaceEdges( __inout DDS_TILED_SURFACE* pSurface );
+
+// 2x2 box filter into the next mip level, which must already be allocated at
+// max( 1, Width / 2 ) x max( 1, Height / 2 ). Matches DownsampleRGBA8 on linear data.
+void DownsampleTiledRGBA8( __in const DDS_TILED_SURFACE* pSrc, __inout DDS_TILED_SURFACE* pDest );
+
+// Bilinear fetch at texel coordinates (texel centres at +0.5), clamped to the edges
+DWORD SampleBilinearRGBA8( __in const BYTE* pSrc, UINT Width, UINT Height, UINT Pitch, float x, float y );
+DWORD SampleBilinearTiledRGBA8( __in const DDS_TILED_SURFACE* pSrc, float x, float y );
+
+//--------------------------------------------------------------------------------------
+// Visits the valid texels of a tiled surface in storage order, skipping the padding
+//--------------------------------------------------------------------------------------
+class CDDSTiledIterator
+{
+public:
+            CDDSTiledIterator( const DDS_TILED_SURFACE* pSurface );
+
+    bool    IsValid() const { return m_Tile < m_NumTiles; }
+    void    Next();
+
+    UINT    GetX() const { return m_X; }
+    UINT    GetY() const { return m_Y; }
+    DWORD*  GetTexel() const { return m_pSurface->pTexels + m_Tile * DDS_TILE_TEXELS + m_Index; }
+
+protected:
+    void    SkipPadding();
+
+    const DDS_TILED_SURFACE* m_pSurface;
+    UINT m_NumTiles;
+    UINT m_Tile;
+    UINT m_Index;
+    UINT m_X;
+    UINT m_Y;
+};
+
+//--------------------------------------------------------------------------------------
+// Times linear and tiled mip chain generation and a rotated bilinear sampling pass over
+// a Size x Size RGBA8 texture
+//--------------------------------------------------------------------------------------
+struct DDS_TILED_BENCHMARK
+{
+    double LinearToTiledMs;
+    double TiledToLinearMs;
+    double LinearMipChainMs;
+    double TiledMipChainMs;
+    double LinearSampleMs;
+    double TiledSampleMs;
+};
+
+HRESULT DDSBenchmarkTiledLayout( UINT Size, __out DDS_TILED_BENCHMARK* pResults );
+
+#endif // _DDSTILEDLAYOUT_H_
@@ -4,6 +4,7 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
 #include "DXUT.h"
+#include "../DDSTextureWriter.h"
 #include <atlstr.h>
 #define DXUT_MIN_WINDOW_SIZE_X 200
 #define DXUT_MIN_WINDOW_SIZE_Y 200
@@ -3657,6 +3658,9 @@ void WINAPI DXUTShutdown( int nExitCode )
     // would be wise to backup/restore the settings from a file so they can be 
     // restored when the crashed app is run again.
 
+    // Screenshots may still be writing on the thread pool
+    WaitForDDSSaves();
+
     // Shutdown D3D11
     IDXGIFactory1* pDXGIFactory = g_pDXUTState.GetDXGIFactory();
     SAFE_RELEASE( pDXGIFactory );
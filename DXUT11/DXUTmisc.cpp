@@ -6,6 +6,7 @@
 // Copyright (c) Microsoft Corporation. All rights reserved
 //--------------------------------------------------------------------------------------
 #include "dxut.h"
+#include "../DDSTextureWriter.h"
 #include <xinput.h>
 
 
@@ -254,7 +255,13 @@ HRESULT DXUTSnapD3D11Screenshot( LPCTSTR szFileName, D3DX11_IMAGE_FILE_FORMAT if
         pCompatableTexture->GetDesc(&dsc);
     }
 
-    hr = D3DX11SaveTextureToFileW(dc, pCompatableTexture, iff, szFileName); 
+    // DDS goes through the sample's own writer so the common screenshot path doesn't
+    // depend on D3DX; the other image formats still need it. The DDS is written on the
+    // thread pool, so the frame only waits for the copy back.
+    if ( iff == D3DX11_IFF_DDS )
+        hr = SaveDDSTextureToFileAsync(dc, pCompatableTexture, szFileName, DDS_WRITER_DEFAULT);
+    else
+        hr = D3DX11SaveTextureToFileW(dc, pCompatableTexture, iff, szFileName); 
         
     SAFE_RELEASE(pBackBuffer);
     SAFE_RELEASE(pCompatableTexture);
@@ -262,3 +269,78 @@ HRESULT DXUTSnapD3D11Screenshot( LPCTSTR szFileName, D3DX11_IMAGE_FILE_FORMAT if
     return hr;
 
 }
+
+
+//--------------------------------------------------------------------------------------
+// Shared state for one DXUTParallelFor call. It lives on the caller's stack, so the
+// caller waits for every helper to leave, not just for every item to finish.
+//--------------------------------------------------------------------------------------
+struct DXUT_PARALLEL_FOR
+{
+    LPDXUTPARALLELCALLBACK pfnCallback;
+    void* pContext;
+    UINT NumItems;
+    volatile LONG NextItem;
+    volatile LONG NumHelpers;
+    HANDLE hHelpersDone;
+};
+
+static void DXUTParallelForRun( DXUT_PARALLEL_FOR* pFor )
+{
+    for(; ; )
+    {
+        UINT iItem = ( UINT )( InterlockedIncrement( &pFor->NextItem ) - 1 );
+        if( iItem >= pFor->NumItems )
+            break;
+        pFor->pfnCallback( iItem, pFor->pContext );
+    }
+}
+
+static DWORD WINAPI DXUTParallelForProc( LPVOID pParam )
+{
+    DXUT_PARALLEL_FOR* pFor = ( DXUT_PARALLEL_FOR* )pParam;
+    DXUTParallelForRun( pFor );
+    if( InterlockedDecrement( &pFor->NumHelpers ) == 0 )
+        SetEvent( pFor->hHelpersDone );
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+void DXUTParallelFor( UINT NumItems, LPDXUTPARALLELCALLBACK pfnCallback, void* pContext )
+{
+    if( NumItems == 0 )
+        return;
+
+    SYSTEM_INFO si;
+    GetSystemInfo( &si );
+    UINT NumHelpers = min( NumItems, ( UINT )max( 1, si.dwNumberOfProcessors ) ) - 1;
+
+    DXUT_PARALLEL_FOR For;
+    For.pfnCallback = pfnCallback;
+    For.pContext = pContext;
+    For.NumItems = NumItems;
+    For.NextItem = 0;
+    For.NumHelpers = 1;     // held by this thread until every helper is queued
+    For.hHelpersDone = NumHelpers ? CreateEvent( NULL, TRUE, FALSE, NULL ) : NULL;
+    if( !For.hHelpersDone )
+        NumHelpers = 0;
+
+    for( UINT i = 0; i < NumHelpers; i++ )
+    {
+        InterlockedIncrement( &For.NumHelpers );
+        if( !QueueUserWorkItem( DXUTParallelForProc, &For, WT_EXECUTEDEFAULT ) )
+        {
+            InterlockedDecrement( &For.NumHelpers );
+            break;
+        }
+    }
+
+    DXUTParallelForRun( &For );
+
+    if( For.hHelpersDone )
+    {
+        if( InterlockedDecrement( &For.NumHelpers ) != 0 )
+            WaitForSingleObject( For.hHelpersDone, INFINITE );
+        CloseHandle( For.hHelpersDone );
+    }
+}
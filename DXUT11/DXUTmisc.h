@@ -28,12 +28,24 @@ HRESULT DXUTStopRumbleOnAllControllers();
 void DXUTEnableXInput( bool bEnable );
 
 //--------------------------------------------------------------------------------------
-// Takes a screen shot of a 32bit D3D11 back buffer and saves the images to a BMP file
+// Takes a screen shot of a 32bit D3D11 back buffer and saves the images to a BMP file.
+// DDS screen shots are written by SaveDDSTextureToFile and don't go through D3DX.
 //--------------------------------------------------------------------------------------
 
 HRESULT DXUTSnapD3D11Screenshot( LPCTSTR szFileName, D3DX11_IMAGE_FILE_FORMAT iff = D3DX11_IFF_DDS  );
 
 
+//--------------------------------------------------------------------------------------
+// Calls pfnCallback( i, pContext ) once for every i in [0, NumItems) using the system
+// thread pool. The calling thread takes items too, and the call returns once every item
+// is done. Items are handed out one at a time, so callbacks can vary widely in cost,
+// but each should be worth at least a few microseconds of work.
+//--------------------------------------------------------------------------------------
+typedef void ( CALLBACK*LPDXUTPARALLELCALLBACK )( UINT iItem, void* pContext );
+
+void DXUTParallelFor( UINT NumItems, LPDXUTPARALLELCALLBACK pfnCallback, void* pContext );
+
+
 //--------------------------------------------------------------------------------------
 // A growable array
 //--------------------------------------------------------------------------------------
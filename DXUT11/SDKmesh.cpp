@@ -11,6 +11,8 @@
 #include "DXUT.h"
 #include "SDKMesh.h"
 #include "SDKMisc.h"
+#include "SDKmeshMapping.h"
+#include <xmmintrin.h>
 
 //--------------------------------------------------------------------------------------
 void CDXUTSDKMesh::LoadMaterials( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pMaterials, UINT numMaterials,
@@ -52,6 +54,9 @@ void CDXUTSDKMesh::LoadMaterials( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pM
     }
     else
     {
+        if( SUCCEEDED( BeginTextureLoads( pd3dDevice, pMaterials, numMaterials ) ) )
+            return;
+
         for( UINT m = 0; m < numMaterials; m++ )
         {
             pMaterials[m].pDiffuseTexture11 = NULL;
@@ -91,6 +96,65 @@ void CDXUTSDKMesh::LoadMaterials( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pM
     }
 }
 
+//--------------------------------------------------------------------------------------
+// Hands every material texture to SDKMeshBeginTextureLoads, which loads each distinct
+// file once and fills the views in as the loads finish. Until then they stay NULL and
+// count as outstanding, so CheckLoadDone reports the mesh as loading.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::BeginTextureLoads( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pMaterials, UINT numMaterials )
+{
+    HRESULT hr;
+
+    WaitForTextures();
+    ZeroMemory( &m_TextureLoadStats, sizeof( SDKMESH_TEXTURE_LOAD_STATS ) );
+
+    SDKMESH_TEXTURE_REQUEST* pRequests = new SDKMESH_TEXTURE_REQUEST[ max( numMaterials * 3, 1 ) ];
+    if( !pRequests )
+        return E_OUTOFMEMORY;
+
+    UINT NumRequests = 0;
+    for( UINT m = 0; m < numMaterials; m++ )
+    {
+        pMaterials[m].pDiffuseTexture11 = NULL;
+        pMaterials[m].pNormalTexture11 = NULL;
+        pMaterials[m].pSpecularTexture11 = NULL;
+        pMaterials[m].pDiffuseRV11 = NULL;
+        pMaterials[m].pNormalRV11 = NULL;
+        pMaterials[m].pSpecularRV11 = NULL;
+
+        const char* pszNames[3] = { pMaterials[m].DiffuseTexture, pMaterials[m].NormalTexture,
+                                    pMaterials[m].SpecularTexture };
+        ID3D11ShaderResourceView** ppTargets[3] = { &pMaterials[m].pDiffuseRV11, &pMaterials[m].pNormalRV11,
+                                                    &pMaterials[m].pSpecularRV11 };
+        for( UINT t = 0; t < 3; t++ )
+        {
+            if( pszNames[t][0] == 0 )
+                continue;
+
+            SDKMESH_TEXTURE_REQUEST* pRequest = &pRequests[NumRequests++];
+            sprintf_s( pRequest->szPath, MAX_PATH, "%s%s", m_strPath, pszNames[t] );
+            pRequest->bSRGB = ( t == 0 );
+            pRequest->ppTarget = ppTargets[t];
+        }
+    }
+
+    hr = SDKMeshBeginTextureLoads( pd3dDevice, pRequests, NumRequests, m_bAsyncTexturesOnLoad, &m_pTextureLoader );
+    delete []pRequests;
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// Blocks until the textures are loaded and keeps what the load measured
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::WaitForTextures()
+{
+    if( !m_pTextureLoader )
+        return;
+
+    SDKMeshEndTextureLoads( m_pTextureLoader, &m_TextureLoadStats );
+    m_pTextureLoader = NULL;
+}
+
 //--------------------------------------------------------------------------------------
 void CDXUTSDKMesh::LoadMaterials( IDirect3DDevice9* pd3dDevice, SDKMESH_MATERIAL* pMaterials, UINT numMaterials,
                                   SDKMESH_CALLBACKS9* pLoaderCallbacks )
@@ -345,7 +409,42 @@ HRESULT CDXUTSDKMesh::CreateFromFile( ID3D11Device* pDev11,
     GetFileSizeEx( m_hFile, &FileSize );
     UINT cBytes = FileSize.LowPart;
 
-    // Allocate memory
+    // Map the file and copy just the header and non-buffer section, which get their
+    // pointers fixed up in place. The vertex and index buffers are created straight
+    // from the view, which stays mapped until Destroy for GetRawVerticesAt and friends.
+    BYTE* pView = NULL;
+    if( cBytes >= sizeof( SDKMESH_HEADER ) &&
+        SUCCEEDED( SDKMeshMapFileView( m_hFile, cBytes, &m_hFileMappingObject, &pView ) ) )
+    {
+        CloseHandle( m_hFile );
+        m_hFile = 0;
+
+        m_MappedPointers.Add( pView );
+        m_MappedBytes = cBytes;
+
+        SDKMESH_HEADER* pHeader = ( SDKMESH_HEADER* )pView;
+        if( pHeader->HeaderSize + pHeader->NonBufferDataSize > cBytes )
+            hr = E_FAIL;
+        else
+            hr = CreateFromMemory( pDev11,
+                                   pDev9,
+                                   pView,
+                                   cBytes,
+                                   bCreateAdjacencyIndices,
+                                   true,
+                                   pLoaderCallbacks11,
+                                   pLoaderCallbacks9 );
+        if( FAILED( hr ) )
+        {
+            SAFE_DELETE_ARRAY( m_pHeapData );
+            m_pStaticMeshData = NULL;
+            UnmapFile();
+        }
+
+        return hr;
+    }
+
+    // Fall back to reading the whole file into memory
     m_pStaticMeshData = new BYTE[ cBytes ];
     if( !m_pStaticMeshData )
     {
@@ -387,9 +486,7 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
                                         SDKMESH_CALLBACKS9* pLoaderCallbacks9 )
 {
     HRESULT hr = E_FAIL;
-    D3DXVECTOR3 lower; 
-    D3DXVECTOR3 upper; 
-    
+
     m_pDev9 = pDev9;
 	m_pDev11 = pDev11;
 
@@ -446,34 +543,115 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
     // Get the start of the buffer data
     UINT64 BufferDataStart = m_pMeshHeader->HeaderSize + m_pMeshHeader->NonBufferDataSize;
 
-    // Create VBs
+    // Find the vertex and index data. Creating a buffer overwrites its DataOffset.
     m_ppVertices = new BYTE*[m_pMeshHeader->NumVertexBuffers];
     for( UINT i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+        m_ppVertices[i] = ( BYTE* )( pBufferData + ( m_pVertexBufferArray[i].DataOffset - BufferDataStart ) );
+
+    m_ppIndices = new BYTE*[m_pMeshHeader->NumIndexBuffers];
+    for( UINT i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
+        m_ppIndices[i] = ( BYTE* )( pBufferData + ( m_pIndexBufferArray[i].DataOffset - BufferDataStart ) );
+
+    // Buffer loader callbacks create buffers in their own time, so they can't be lazy.
+    // Nor can buffers read from the caller's memory when only the non-buffer data is
+    // copied, as the caller may free it once this returns; a mapped view is the mesh's
+    // own. The passes that rewrite or read every buffer are skipped, as they'd read the
+    // whole file.
+    bool bLazyBuffers = m_bLazyBuffersOnLoad;
+    if( bCopyStatic && m_MappedPointers.GetSize() == 0 )
+        bLazyBuffers = false;
+    if( pLoaderCallbacks11 && ( pLoaderCallbacks11->pCreateVertexBuffer || pLoaderCallbacks11->pCreateIndexBuffer ) )
+        bLazyBuffers = false;
+    if( pLoaderCallbacks9 && ( pLoaderCallbacks9->pCreateVertexBuffer || pLoaderCallbacks9->pCreateIndexBuffer ) )
+        bLazyBuffers = false;
+
+    // Reorder before anything is copied into buffers
+    ZeroMemory( &m_VertexCacheStats, sizeof( SDKMESH_VERTEX_CACHE_STATS ) );
+    if( m_bOptimizeOnLoad && !bLazyBuffers )
+    {
+        HRESULT hrOptimize = OptimizeVertexCache();
+        if( FAILED( hrOptimize ) )
+        {
+            hr = hrOptimize;
+            goto Error;
+        }
+    }
+
+    if( m_bNarrowIndicesOnLoad && !bLazyBuffers )
+    {
+        HRESULT hrNarrow = NarrowIndexBuffers();
+        if( FAILED( hrNarrow ) )
+        {
+            hr = hrNarrow;
+            goto Error;
+        }
+    }
+
+    ZeroMemory( &m_QuantizationStats, sizeof( SDKMESH_QUANTIZATION_STATS ) );
+    if( m_bQuantizeOnLoad && !bLazyBuffers )
+    {
+        HRESULT hrQuantize = QuantizeVertexStreams();
+        if( FAILED( hrQuantize ) )
+        {
+            hr = hrQuantize;
+            goto Error;
+        }
+    }
+
+    DestroyMeshResidency();
+    if( bLazyBuffers )
+    {
+        HRESULT hrResidency = CreateMeshResidency();
+        if( FAILED( hrResidency ) )
+        {
+            hr = hrResidency;
+            goto Error;
+        }
+    }
+
+    // Create VBs. A packed buffer is created from its packed copy, while the header goes
+    // on describing the float vertices the CPU side reads.
+    for( UINT i = 0; i < m_pMeshHeader->NumVertexBuffers && !bLazyBuffers; i++ )
     {
-        BYTE* pVertices = NULL;
-        pVertices = ( BYTE* )( pBufferData + ( m_pVertexBufferArray[i].DataOffset - BufferDataStart ) );
+        BYTE* pVertices = m_ppVertices[i];
+        UINT64 SizeBytes = m_pVertexBufferArray[i].SizeBytes;
+        if( m_pQuantizedStreams && m_pQuantizedStreams[i].pVertices )
+        {
+            pVertices = m_pQuantizedStreams[i].pVertices;
+            m_pVertexBufferArray[i].SizeBytes = m_pQuantizedStreams[i].SizeBytes;
+        }
 
         if( pDev11 )
             CreateVertexBuffer( pDev11, &m_pVertexBufferArray[i], pVertices, pLoaderCallbacks11 );
         else if( pDev9 )
             CreateVertexBuffer( pDev9, &m_pVertexBufferArray[i], pVertices, pLoaderCallbacks9 );
+        m_pVertexBufferArray[i].SizeBytes = SizeBytes;
+    }
 
-        m_ppVertices[i] = pVertices;
+    // Loader callbacks may copy the packed vertices later, so those stay until Destroy
+    if( m_pQuantizedStreams && !( pLoaderCallbacks11 && pLoaderCallbacks11->pCreateVertexBuffer ) &&
+        !( pLoaderCallbacks9 && pLoaderCallbacks9->pCreateVertexBuffer ) )
+    {
+        for( UINT i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+            SAFE_DELETE_ARRAY( m_pQuantizedStreams[i].pVertices );
     }
 
     // Create IBs
-    m_ppIndices = new BYTE*[m_pMeshHeader->NumIndexBuffers];
-    for( UINT i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
+    for( UINT i = 0; i < m_pMeshHeader->NumIndexBuffers && !bLazyBuffers; i++ )
     {
-        BYTE* pIndices = NULL;
-        pIndices = ( BYTE* )( pBufferData + ( m_pIndexBufferArray[i].DataOffset - BufferDataStart ) );
-
         if( pDev11 )
-            CreateIndexBuffer( pDev11, &m_pIndexBufferArray[i], pIndices, pLoaderCallbacks11 );
+            CreateIndexBuffer( pDev11, &m_pIndexBufferArray[i], m_ppIndices[i], pLoaderCallbacks11 );
         else if( pDev9 )
-            CreateIndexBuffer( pDev9, &m_pIndexBufferArray[i], pIndices, pLoaderCallbacks9 );
+            CreateIndexBuffer( pDev9, &m_pIndexBufferArray[i], m_ppIndices[i], pLoaderCallbacks9 );
+    }
 
-        m_ppIndices[i] = pIndices;
+    // Adjacent topologies only exist in D3D11. Adjacency reads every index buffer, so
+    // it isn't built for lazy buffers.
+    if( bCreateAdjacencyIndices && pDev11 && !bLazyBuffers )
+    {
+        hr = CreateAdjacencyIndices( pDev11 );
+        if( FAILED( hr ) )
+            goto Error;
     }
 
     // Load Materials
@@ -495,96 +673,32 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
     if( !m_pWorldPoseFrameMatrices )
         goto Error;
 
-    SDKMESH_SUBSET* pSubset = NULL;
-    D3D11_PRIMITIVE_TOPOLOGY PrimType;
-
-    // update bounding volume 
-    SDKMESH_MESH* currentMesh = &m_pMeshArray[0];
-    int tris = 0;
-    for (UINT meshi=0; meshi < m_pMeshHeader->NumMeshes; ++meshi) {
-        lower.x = FLT_MAX; lower.y = FLT_MAX; lower.z = FLT_MAX;
-        upper.x = -FLT_MAX; upper.y = -FLT_MAX; upper.z = -FLT_MAX;
-        currentMesh = GetMesh( meshi );
-        INT indsize;
-        if (m_pIndexBufferArray[currentMesh->IndexBuffer].IndexType == IT_16BIT ) {
-            indsize = 2;
-        }else {
-            indsize = 4;        
-        }
-
-        for( UINT subset = 0; subset < currentMesh->NumSubsets; subset++ )
-        {
-            pSubset = GetSubset( meshi, subset ); //&m_pSubsetArray[ currentMesh->pSubsets[subset] ];
-
-            PrimType = GetPrimitiveType11( ( SDKMESH_PRIMITIVE_TYPE )pSubset->PrimitiveType );
-            assert( PrimType == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );// only triangle lists are handled.
-
-            UINT IndexCount = ( UINT )pSubset->IndexCount;
-            UINT IndexStart = ( UINT )pSubset->IndexStart;
+    // LOD selection reads frame positions before anything has been transformed
+    for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
+    {
+        D3DXMatrixIdentity( &m_pTransformedFrameMatrices[i] );
+        D3DXMatrixIdentity( &m_pWorldPoseFrameMatrices[i] );
+    }
 
-            /*if( bAdjacent )
-            {
-                IndexCount *= 2;
-                IndexStart *= 2;
-            }*/
-     
-        //BYTE* pIndices = NULL;
-            //m_ppIndices[i]
-            UINT *ind = ( UINT * )m_ppIndices[currentMesh->IndexBuffer];
-            FLOAT *verts =  ( FLOAT* )m_ppVertices[currentMesh->VertexBuffers[0]];
-            UINT stride = (UINT)m_pVertexBufferArray[currentMesh->VertexBuffers[0]].StrideBytes;
-            assert (stride % 4 == 0);
-            stride /=4;
-            for (UINT vertind = IndexStart; vertind < IndexStart + IndexCount; ++vertind) {
-                UINT current_ind=0;
-                if (indsize == 2) {
-                    UINT ind_div2 = vertind / 2;
-                    current_ind = ind[ind_div2];
-                    if (vertind %2 ==0) {
-                        current_ind = current_ind << 16;
-                        current_ind = current_ind >> 16;
-                    }else {
-                        current_ind = current_ind >> 16;
-                    }
-                }else {
-                    current_ind = ind[vertind];
-                }
-                tris++;
-                D3DXVECTOR3 *pt = (D3DXVECTOR3*)&(verts[stride * current_ind]);
-                if (pt->x < lower.x) {
-                    lower.x = pt->x;
-                }
-                if (pt->y < lower.y) {
-                    lower.y = pt->y;
-                }
-                if (pt->z < lower.z) {
-                    lower.z = pt->z;
-                }
-                if (pt->x > upper.x) {
-                    upper.x = pt->x;
-                }
-                if (pt->y > upper.y) {
-                    upper.y = pt->y;
-                }
-                if (pt->z > upper.z) {
-                    upper.z = pt->z;
-                }
-                //BYTE** m_ppVertices;
-                //BYTE** m_ppIndices;
-            }
-            //pd3dDeviceContext->DrawIndexed( IndexCount, IndexStart, VertexStart );
-        }
+    hr = CreateFrameOrder();
+    if( FAILED( hr ) )
+        goto Error;
 
-        D3DXVECTOR3 half = upper - lower;
-        half *=0.5f;
+    hr = SDKMeshCreateFrameIndex( m_pFrameArray, m_pMeshHeader->NumFrames, &m_FrameIndex );
+    if( FAILED( hr ) )
+        goto Error;
 
-        currentMesh->BoundingBoxCenter = lower + half;
-        currentMesh->BoundingBoxExtents = half;
+    // Per-subset and per-mesh bounding volumes
+    hr = ComputeBoundingVolumes();
+    if( FAILED( hr ) )
+        goto Error;
 
+    if( m_LoadLODSettings.NumLODs > 0 )
+    {
+        hr = GenerateLODs( &m_LoadLODSettings );
+        if( FAILED( hr ) )
+            goto Error;
     }
-    // Update 
-        
-
 
     hr = S_OK;
 Error:
@@ -598,627 +712,3933 @@ Error:
 }
 
 //--------------------------------------------------------------------------------------
-// transform bind pose frame using a recursive traversal
+// Bounding volumes are computed over each subset's VertexStart/VertexCount range, so
+// every vertex is read once no matter how many triangles share it. Positions are taken
+// to be the first three floats of each vertex in the mesh's first stream. Large subsets
+// are split into chunks and the chunks are spread across threads.
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::TransformBindPoseFrame( UINT iFrame, D3DXMATRIX* pParentWorld )
-{
-    if( !m_pBindPoseFrameMatrices )
-        return;
+#define SDKMESH_BOUNDS_CHUNK_VERTICES 16384
 
-    // Transform ourselves
-    D3DXMATRIX LocalWorld;
-    D3DXMatrixMultiply( &LocalWorld, &m_pFrameArray[iFrame].Matrix, pParentWorld );
-    m_pBindPoseFrameMatrices[iFrame] = LocalWorld;
+struct SDKMESH_BOUNDS_CHUNK
+{
+    UINT iSubset;
+    const BYTE* pVertices;
+    UINT Stride;
+    UINT NumVertices;
+    __m128 Min;
+    __m128 Max;
+    float MaxDistSq;
+};
+
+struct SDKMESH_BOUNDS_CONTEXT
+{
+    SDKMESH_BOUNDS_CHUNK* pChunks;
+    SDKMESH_SUBSET_BOUNDS* pBounds;
+};
 
-    // Transform our siblings
-    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
-        TransformBindPoseFrame( m_pFrameArray[iFrame].SiblingFrame, pParentWorld );
+// Loads x, y, z into the low three lanes. The fourth lane is whatever follows the
+// position, so only the last vertex of a tightly packed stream needs a safe load.
+static inline __m128 LoadPosition( const BYTE* pVertex )
+{
+    return _mm_loadu_ps( ( const float* )pVertex );
+}
 
-    // Transform our children
-    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
-        TransformBindPoseFrame( m_pFrameArray[iFrame].ChildFrame, &LocalWorld );
+static inline __m128 LoadLastPosition( const BYTE* pVertex )
+{
+    const float* p = ( const float* )pVertex;
+    return _mm_set_ps( 0.0f, p[2], p[1], p[0] );
 }
 
 //--------------------------------------------------------------------------------------
-// transform frame using a recursive traversal
-//--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::TransformFrame( UINT iFrame, D3DXMATRIX* pParentWorld, double fTime )
+static void CALLBACK ComputeChunkBox( UINT iChunk, void* pContext )
 {
-    // Get the tick data
-    D3DXMATRIX LocalTransform;
-    UINT iTick = GetAnimationKeyFromTime( fTime );
-
-    if( INVALID_ANIMATION_DATA != m_pFrameArray[iFrame].AnimationDataIndex )
+    SDKMESH_BOUNDS_CHUNK* pChunk = &( ( SDKMESH_BOUNDS_CONTEXT* )pContext )->pChunks[iChunk];
+    const BYTE* p = pChunk->pVertices;
+    UINT Stride = pChunk->Stride;
+    UINT NumFast = ( Stride >= 16 ) ? pChunk->NumVertices : pChunk->NumVertices - 1;
+
+    __m128 vMin = _mm_set1_ps( FLT_MAX );
+    __m128 vMax = _mm_set1_ps( -FLT_MAX );
+    UINT i = 0;
+    for(; i + 4 <= NumFast; i += 4, p += 4 * Stride )
     {
-        SDKANIMATION_FRAME_DATA* pFrameData = &m_pAnimationFrameData[ m_pFrameArray[iFrame].AnimationDataIndex ];
-        SDKANIMATION_DATA* pData = &pFrameData->pAnimationData[ iTick ];
-
-        // turn it into a matrix (Ignore scaling for now)
-        D3DXVECTOR3 parentPos = pData->Translation;
-        D3DXMATRIX mTranslate;
-        D3DXMatrixTranslation( &mTranslate, parentPos.x, parentPos.y, parentPos.z );
-
-        D3DXQUATERNION quat;
-        D3DXMATRIX mQuat;
-        quat.w = pData->Orientation.w;
-        quat.x = pData->Orientation.x;
-        quat.y = pData->Orientation.y;
-        quat.z = pData->Orientation.z;
-        if( quat.w == 0 && quat.x == 0 && quat.y == 0 && quat.z == 0 )
-            D3DXQuaternionIdentity( &quat );
-        D3DXQuaternionNormalize( &quat, &quat );
-        D3DXMatrixRotationQuaternion( &mQuat, &quat );
-        LocalTransform = ( mQuat * mTranslate );
+        __m128 v0 = LoadPosition( p );
+        __m128 v1 = LoadPosition( p + Stride );
+        __m128 v2 = LoadPosition( p + 2 * Stride );
+        __m128 v3 = LoadPosition( p + 3 * Stride );
+        vMin = _mm_min_ps( vMin, _mm_min_ps( _mm_min_ps( v0, v1 ), _mm_min_ps( v2, v3 ) ) );
+        vMax = _mm_max_ps( vMax, _mm_max_ps( _mm_max_ps( v0, v1 ), _mm_max_ps( v2, v3 ) ) );
     }
-    else
+    for(; i < pChunk->NumVertices; i++, p += Stride )
     {
-        LocalTransform = m_pFrameArray[iFrame].Matrix;
+        __m128 v = ( i < NumFast ) ? LoadPosition( p ) : LoadLastPosition( p );
+        vMin = _mm_min_ps( vMin, v );
+        vMax = _mm_max_ps( vMax, v );
     }
 
-    // Transform ourselves
-    D3DXMATRIX LocalWorld;
-    D3DXMatrixMultiply( &LocalWorld, &LocalTransform, pParentWorld );
-    m_pTransformedFrameMatrices[iFrame] = LocalWorld;
-    m_pWorldPoseFrameMatrices[iFrame] = LocalWorld;
-
-    // Transform our siblings
-    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
-        TransformFrame( m_pFrameArray[iFrame].SiblingFrame, pParentWorld, fTime );
-
-    // Transform our children
-    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
-        TransformFrame( m_pFrameArray[iFrame].ChildFrame, &LocalWorld, fTime );
+    pChunk->Min = vMin;
+    pChunk->Max = vMax;
 }
 
 //--------------------------------------------------------------------------------------
-// transform frame assuming that it is an absolute transformation
-//--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::TransformFrameAbsolute( UINT iFrame, double fTime )
+static void CALLBACK ComputeChunkRadius( UINT iChunk, void* pContext )
 {
-    D3DXMATRIX mTrans1;
-    D3DXMATRIX mTrans2;
-    D3DXMATRIX mRot1;
-    D3DXMATRIX mRot2;
-    D3DXQUATERNION quat1;
-    D3DXQUATERNION quat2;
-    D3DXMATRIX mTo;
-    D3DXMATRIX mInvTo;
-    D3DXMATRIX mFrom;
+    SDKMESH_BOUNDS_CONTEXT* pBoundsContext = ( SDKMESH_BOUNDS_CONTEXT* )pContext;
+    SDKMESH_BOUNDS_CHUNK* pChunk = &pBoundsContext->pChunks[iChunk];
+    const D3DXVECTOR3& Center = pBoundsContext->pBounds[pChunk->iSubset].BoundingBoxCenter;
+    const BYTE* p = pChunk->pVertices;
+    UINT Stride = pChunk->Stride;
+    UINT NumFast = ( Stride >= 16 ) ? pChunk->NumVertices : pChunk->NumVertices - 1;
+
+    // Four vertices at a time, transposed so each lane holds one vertex
+    __m128 vCenter = _mm_set_ps( 0.0f, Center.z, Center.y, Center.x );
+    __m128 vCx = _mm_set1_ps( Center.x );
+    __m128 vCy = _mm_set1_ps( Center.y );
+    __m128 vCz = _mm_set1_ps( Center.z );
+    __m128 vMaxDistSq = _mm_setzero_ps();
+    UINT i = 0;
+    for(; i + 4 <= NumFast; i += 4, p += 4 * Stride )
+    {
+        __m128 x = LoadPosition( p );
+        __m128 y = LoadPosition( p + Stride );
+        __m128 z = LoadPosition( p + 2 * Stride );
+        __m128 w = LoadPosition( p + 3 * Stride );
+        _MM_TRANSPOSE4_PS( x, y, z, w );
+        x = _mm_sub_ps( x, vCx );
+        y = _mm_sub_ps( y, vCy );
+        z = _mm_sub_ps( z, vCz );
+        __m128 DistSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_mul_ps( z, z ) );
+        vMaxDistSq = _mm_max_ps( vMaxDistSq, DistSq );
+    }
 
-    UINT iTick = GetAnimationKeyFromTime( fTime );
+    float Lanes[4];
+    _mm_storeu_ps( Lanes, vMaxDistSq );
+    float MaxDistSq = max( max( Lanes[0], Lanes[1] ), max( Lanes[2], Lanes[3] ) );
 
-    if( INVALID_ANIMATION_DATA != m_pFrameArray[iFrame].AnimationDataIndex )
+    for(; i < pChunk->NumVertices; i++, p += Stride )
     {
-        SDKANIMATION_FRAME_DATA* pFrameData = &m_pAnimationFrameData[ m_pFrameArray[iFrame].AnimationDataIndex ];
-        SDKANIMATION_DATA* pData = &pFrameData->pAnimationData[ iTick ];
-        SDKANIMATION_DATA* pDataOrig = &pFrameData->pAnimationData[ 0 ];
-
-        D3DXMatrixTranslation( &mTrans1, -pDataOrig->Translation.x,
-                               -pDataOrig->Translation.y,
-                               -pDataOrig->Translation.z );
-        D3DXMatrixTranslation( &mTrans2, pData->Translation.x,
-                               pData->Translation.y,
-                               pData->Translation.z );
-
-        quat1.x = pDataOrig->Orientation.x;
-        quat1.y = pDataOrig->Orientation.y;
-        quat1.z = pDataOrig->Orientation.z;
-        quat1.w = pDataOrig->Orientation.w;
-        D3DXQuaternionInverse( &quat1, &quat1 );
-        D3DXMatrixRotationQuaternion( &mRot1, &quat1 );
-        mInvTo = mTrans1 * mRot1;
+        __m128 d = _mm_sub_ps( ( i < NumFast ) ? LoadPosition( p ) : LoadLastPosition( p ), vCenter );
+        d = _mm_mul_ps( d, d );
+        _mm_storeu_ps( Lanes, d );
+        MaxDistSq = max( MaxDistSq, Lanes[0] + Lanes[1] + Lanes[2] );
+    }
 
-        quat2.x = pData->Orientation.x;
-        quat2.y = pData->Orientation.y;
-        quat2.z = pData->Orientation.z;
-        quat2.w = pData->Orientation.w;
-        D3DXMatrixRotationQuaternion( &mRot2, &quat2 );
-        mFrom = mRot2 * mTrans2;
+    pChunk->MaxDistSq = MaxDistSq;
+}
 
-        D3DXMATRIX mOutput = mInvTo * mFrom;
-        m_pTransformedFrameMatrices[iFrame] = mOutput;
+//--------------------------------------------------------------------------------------
+// Older files can leave VertexCount at zero; the range is then taken from the indices.
+// *pMaxIndex is one past the largest index, so it is kept in 64 bits: an index of
+// 0xffffffff would wrap to 0 in a UINT.
+//--------------------------------------------------------------------------------------
+static void GetSubsetIndexRange( const SDKMESH_SUBSET* pSubset, const BYTE* pIndices, UINT IndexType,
+                                 UINT64* pMinIndex, UINT64* pMaxIndex )
+{
+    UINT MinIndex = UINT_MAX;
+    UINT MaxIndex = 0;
+    UINT64 IndexStart = pSubset->IndexStart;
+    UINT64 IndexEnd = IndexStart + pSubset->IndexCount;
+    if( IndexType == IT_16BIT )
+    {
+        const WORD* pIndices16 = ( const WORD* )pIndices;
+        for( UINT64 i = IndexStart; i < IndexEnd; i++ )
+        {
+            MinIndex = min( MinIndex, ( UINT )pIndices16[i] );
+            MaxIndex = max( MaxIndex, ( UINT )pIndices16[i] );
+        }
+    }
+    else
+    {
+        const UINT* pIndices32 = ( const UINT* )pIndices;
+        for( UINT64 i = IndexStart; i < IndexEnd; i++ )
+        {
+            MinIndex = min( MinIndex, pIndices32[i] );
+            MaxIndex = max( MaxIndex, pIndices32[i] );
+        }
     }
+
+    *pMinIndex = ( MinIndex <= MaxIndex ) ? MinIndex : 0;
+    *pMaxIndex = ( MinIndex <= MaxIndex ) ? ( UINT64 )MaxIndex + 1 : 0;
 }
 
-#define MAX_D3D11_VERTEX_STREAMS D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::RenderMesh( UINT iMesh,
-                               bool bAdjacent,
-                               ID3D11DeviceContext* pd3dDeviceContext,
-                               UINT iDiffuseSlot,
-                               UINT iNormalSlot,
-                               UINT iSpecularSlot )
+HRESULT CDXUTSDKMesh::ComputeBoundingVolumes()
 {
-    if( 0 < GetOutstandingBufferResources() )
-        return;
-
-    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+    UINT NumSubsets = m_pMeshHeader->NumTotalSubsets;
+    SAFE_DELETE_ARRAY( m_pSubsetBounds );
+
+    // Cull boxes are built from these bounds; Cull recreates them on demand
+    SDKMeshDestroyCullBoxes( &m_CullBoxes );
+    SAFE_DELETE_ARRAY( m_pFrameCullBox );
+    SAFE_DELETE_ARRAY( m_pVisibleBits );
+    m_bCullBoxesLocal = false;
+    m_bCullingActive = false;
+    m_pSubsetBounds = new SDKMESH_SUBSET_BOUNDS[ NumSubsets ];
+    if( !m_pSubsetBounds )
+        return E_OUTOFMEMORY;
 
-    UINT Strides[MAX_D3D11_VERTEX_STREAMS];
-    UINT Offsets[MAX_D3D11_VERTEX_STREAMS];
-    ID3D11Buffer* pVB[MAX_D3D11_VERTEX_STREAMS];
+    // Lazily created meshes go by the boxes in the file rather than read every vertex.
+    // A subset shared between meshes gets the box of the first one.
+    if( m_Residency.pMeshResident )
+    {
+        ZeroMemory( m_pSubsetBounds, sizeof( SDKMESH_SUBSET_BOUNDS ) * NumSubsets );
+        for( UINT iMesh = m_pMeshHeader->NumMeshes; iMesh > 0; iMesh-- )
+        {
+            const SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh - 1];
+            for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+            {
+                SDKMESH_SUBSET_BOUNDS* pBounds = &m_pSubsetBounds[ pMesh->pSubsets[i] ];
+                pBounds->BoundingBoxCenter = pMesh->BoundingBoxCenter;
+                pBounds->BoundingBoxExtents = pMesh->BoundingBoxExtents;
+                pBounds->BoundingSphereRadius = D3DXVec3Length( &pMesh->BoundingBoxExtents );
+            }
+        }
+        return S_OK;
+    }
 
-    if( pMesh->NumVertexBuffers > MAX_D3D11_VERTEX_STREAMS )
-        return;
+    // Work out each subset's vertex range. A subset shared between meshes is measured
+    // against the first mesh that references it.
+    UINT64* pRangeStart = new UINT64[ NumSubsets * 2 ];
+    const BYTE** ppSubsetVertices = new const BYTE*[ NumSubsets ];
+    UINT* pSubsetStride = new UINT[ NumSubsets ];
+    if( !pRangeStart || !ppSubsetVertices || !pSubsetStride )
+    {
+        SAFE_DELETE_ARRAY( pRangeStart );
+        SAFE_DELETE_ARRAY( ppSubsetVertices );
+        SAFE_DELETE_ARRAY( pSubsetStride );
+        return E_OUTOFMEMORY;
+    }
+    UINT64* pRangeEnd = pRangeStart + NumSubsets;
+    ZeroMemory( pRangeStart, sizeof( UINT64 ) * NumSubsets * 2 );
+    ZeroMemory( ppSubsetVertices, sizeof( BYTE* ) * NumSubsets );
 
-    for( UINT64 i = 0; i < pMesh->NumVertexBuffers; i++ )
+    UINT NumChunks = 0;
+    for( UINT iMesh = 0; iMesh < m_pMeshHeader->NumMeshes; iMesh++ )
     {
-        pVB[i] = m_pVertexBufferArray[ pMesh->VertexBuffers[i] ].pVB11;
-        Strides[i] = ( UINT )m_pVertexBufferArray[ pMesh->VertexBuffers[i] ].StrideBytes;
-        Offsets[i] = 0;
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        UINT iVB = pMesh->VertexBuffers[0];
+        UINT64 NumVBVertices = m_pVertexBufferArray[iVB].NumVertices;
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+        {
+            UINT iSubset = pMesh->pSubsets[i];
+            if( ppSubsetVertices[iSubset] )
+                continue;
+
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[iSubset];
+            UINT64 Start = pSubset->VertexStart;
+            UINT64 End = Start + pSubset->VertexCount;
+            if( pSubset->VertexCount == 0 )
+            {
+                // Indices are relative to VertexStart, as in DrawIndexed
+                UINT64 MinIndex, MaxIndex;
+                GetSubsetIndexRange( pSubset, m_ppIndices[pMesh->IndexBuffer],
+                                     m_pIndexBufferArray[pMesh->IndexBuffer].IndexType, &MinIndex, &MaxIndex );
+                End = Start + MaxIndex;
+                Start += MinIndex;
+            }
+            End = min( End, NumVBVertices );
+            Start = min( Start, End );
+
+            pSubsetStride[iSubset] = ( UINT )m_pVertexBufferArray[iVB].StrideBytes;
+            ppSubsetVertices[iSubset] = m_ppVertices[iVB];
+            pRangeStart[iSubset] = Start;
+            pRangeEnd[iSubset] = End;
+            NumChunks += ( UINT )( ( End - Start + SDKMESH_BOUNDS_CHUNK_VERTICES - 1 ) / SDKMESH_BOUNDS_CHUNK_VERTICES );
+        }
     }
 
-    SDKMESH_INDEX_BUFFER_HEADER* pIndexBufferArray;
-    if( bAdjacent )
-        pIndexBufferArray = m_pAdjacencyIndexBufferArray;
-    else
-        pIndexBufferArray = m_pIndexBufferArray;
+    SDKMESH_BOUNDS_CHUNK* pChunks = ( SDKMESH_BOUNDS_CHUNK* )_aligned_malloc(
+        sizeof( SDKMESH_BOUNDS_CHUNK ) * max( 1, NumChunks ), 16 );
+    if( !pChunks )
+    {
+        SAFE_DELETE_ARRAY( pRangeStart );
+        SAFE_DELETE_ARRAY( ppSubsetVertices );
+        SAFE_DELETE_ARRAY( pSubsetStride );
+        return E_OUTOFMEMORY;
+    }
 
-    ID3D11Buffer* pIB = pIndexBufferArray[ pMesh->IndexBuffer ].pIB11;
-    DXGI_FORMAT ibFormat = DXGI_FORMAT_R16_UINT;
-    switch( pIndexBufferArray[ pMesh->IndexBuffer ].IndexType )
+    UINT iChunk = 0;
+    for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
     {
-    case IT_16BIT:
-        ibFormat = DXGI_FORMAT_R16_UINT;
-        break;
-    case IT_32BIT:
-        ibFormat = DXGI_FORMAT_R32_UINT;
-        break;
-    };
+        for( UINT64 v = pRangeStart[iSubset]; v < pRangeEnd[iSubset]; v += SDKMESH_BOUNDS_CHUNK_VERTICES )
+        {
+            SDKMESH_BOUNDS_CHUNK* pChunk = &pChunks[iChunk++];
+            pChunk->iSubset = iSubset;
+            pChunk->Stride = pSubsetStride[iSubset];
+            pChunk->pVertices = ppSubsetVertices[iSubset] + v * pChunk->Stride;
+            pChunk->NumVertices = ( UINT )min( ( UINT64 )SDKMESH_BOUNDS_CHUNK_VERTICES, pRangeEnd[iSubset] - v );
+        }
+    }
 
-    pd3dDeviceContext->IASetVertexBuffers( 0, pMesh->NumVertexBuffers, pVB, Strides, Offsets );
-    pd3dDeviceContext->IASetIndexBuffer( pIB, ibFormat, 0 );
+    SDKMESH_BOUNDS_CONTEXT Context;
+    Context.pChunks = pChunks;
+    Context.pBounds = m_pSubsetBounds;
 
-    SDKMESH_SUBSET* pSubset = NULL;
-    SDKMESH_MATERIAL* pMat = NULL;
-    D3D11_PRIMITIVE_TOPOLOGY PrimType;
+    // Boxes first, since the spheres are centred on them
+    DXUTParallelFor( NumChunks, ComputeChunkBox, &Context );
 
-    for( UINT subset = 0; subset < pMesh->NumSubsets; subset++ )
+    __m128 vHalf = _mm_set1_ps( 0.5f );
+    iChunk = 0;
+    for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
     {
-        pSubset = &m_pSubsetArray[ pMesh->pSubsets[subset] ];
-
-        PrimType = GetPrimitiveType11( ( SDKMESH_PRIMITIVE_TYPE )pSubset->PrimitiveType );
-        if( bAdjacent )
+        __m128 vMin = _mm_setzero_ps();
+        __m128 vMax = _mm_setzero_ps();
+        if( iChunk < NumChunks && pChunks[iChunk].iSubset == iSubset )
         {
-            switch( PrimType )
+            vMin = pChunks[iChunk].Min;
+            vMax = pChunks[iChunk].Max;
+            for( iChunk++; iChunk < NumChunks && pChunks[iChunk].iSubset == iSubset; iChunk++ )
             {
-            case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST:
-                PrimType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST_ADJ;
-                break;
-            case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP:
-                PrimType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP_ADJ;
-                break;
-            case D3D11_PRIMITIVE_TOPOLOGY_LINELIST:
-                PrimType = D3D11_PRIMITIVE_TOPOLOGY_LINELIST_ADJ;
-                break;
-            case D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP:
-                PrimType = D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP_ADJ;
-                break;
+                vMin = _mm_min_ps( vMin, pChunks[iChunk].Min );
+                vMax = _mm_max_ps( vMax, pChunks[iChunk].Max );
             }
         }
 
-        pd3dDeviceContext->IASetPrimitiveTopology( PrimType );
+        float Center[4], Extents[4];
+        _mm_storeu_ps( Center, _mm_mul_ps( _mm_add_ps( vMin, vMax ), vHalf ) );
+        _mm_storeu_ps( Extents, _mm_mul_ps( _mm_sub_ps( vMax, vMin ), vHalf ) );
+        m_pSubsetBounds[iSubset].BoundingBoxCenter = D3DXVECTOR3( Center[0], Center[1], Center[2] );
+        m_pSubsetBounds[iSubset].BoundingBoxExtents = D3DXVECTOR3( Extents[0], Extents[1], Extents[2] );
+        m_pSubsetBounds[iSubset].BoundingSphereRadius = 0.0f;
+    }
 
-        pMat = &m_pMaterialArray[ pSubset->MaterialID ];
-        if( iDiffuseSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pDiffuseRV11 ) )
-            pd3dDeviceContext->PSSetShaderResources( iDiffuseSlot, 1, &pMat->pDiffuseRV11 );
-        if( iNormalSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pNormalRV11 ) )
-            pd3dDeviceContext->PSSetShaderResources( iNormalSlot, 1, &pMat->pNormalRV11 );
-        if( iSpecularSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pSpecularRV11 ) )
-            pd3dDeviceContext->PSSetShaderResources( iSpecularSlot, 1, &pMat->pSpecularRV11 );
+    DXUTParallelFor( NumChunks, ComputeChunkRadius, &Context );
 
-        UINT IndexCount = ( UINT )pSubset->IndexCount;
-        UINT IndexStart = ( UINT )pSubset->IndexStart;
-        UINT VertexStart = ( UINT )pSubset->VertexStart;
-        if( bAdjacent )
+    for( iChunk = 0; iChunk < NumChunks; iChunk++ )
+    {
+        SDKMESH_SUBSET_BOUNDS* pBounds = &m_pSubsetBounds[pChunks[iChunk].iSubset];
+        pBounds->BoundingSphereRadius = max( pBounds->BoundingSphereRadius, pChunks[iChunk].MaxDistSq );
+    }
+    for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
+        m_pSubsetBounds[iSubset].BoundingSphereRadius = sqrtf( m_pSubsetBounds[iSubset].BoundingSphereRadius );
+
+    // Mesh boxes are the union of their subsets' boxes
+    for( UINT iMesh = 0; iMesh < m_pMeshHeader->NumMeshes; iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        D3DXVECTOR3 Lower( 0, 0, 0 );
+        D3DXVECTOR3 Upper( 0, 0, 0 );
+        bool bEmpty = true;
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
         {
-            IndexCount *= 2;
-            IndexStart *= 2;
+            UINT iSubset = pMesh->pSubsets[i];
+            if( pRangeStart[iSubset] == pRangeEnd[iSubset] )
+                continue;
+
+            const SDKMESH_SUBSET_BOUNDS* pBounds = &m_pSubsetBounds[iSubset];
+            D3DXVECTOR3 SubsetLower = pBounds->BoundingBoxCenter - pBounds->BoundingBoxExtents;
+            D3DXVECTOR3 SubsetUpper = pBounds->BoundingBoxCenter + pBounds->BoundingBoxExtents;
+            if( bEmpty )
+            {
+                Lower = SubsetLower;
+                Upper = SubsetUpper;
+                bEmpty = false;
+            }
+            else
+            {
+                D3DXVec3Minimize( &Lower, &Lower, &SubsetLower );
+                D3DXVec3Maximize( &Upper, &Upper, &SubsetUpper );
+            }
         }
 
-        pd3dDeviceContext->DrawIndexed( IndexCount, IndexStart, VertexStart );
+        D3DXVECTOR3 Half = ( Upper - Lower ) * 0.5f;
+        pMesh->BoundingBoxCenter = Lower + Half;
+        pMesh->BoundingBoxExtents = Half;
     }
+
+    _aligned_free( pChunks );
+    SAFE_DELETE_ARRAY( pRangeStart );
+    SAFE_DELETE_ARRAY( ppSubsetVertices );
+    SAFE_DELETE_ARRAY( pSubsetStride );
+
+    return S_OK;
 }
 
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::RenderFrame( UINT iFrame,
-                                bool bAdjacent,
-                                ID3D11DeviceContext* pd3dDeviceContext,
-                                UINT iDiffuseSlot,
-                                UINT iNormalSlot,
-                                UINT iSpecularSlot )
+// Load-time vertex cache optimization. Each triangle list subset has its triangles
+// reordered on its own, so the subsets run in parallel; subsets whose index ranges
+// partly overlap keep their order. Vertices are then renumbered in order of first use
+// across all the subsets drawing from the same VertexStart and VertexCount range,
+// ranges also running in parallel. That is only done for vertex buffers whose subsets
+// all have such ranges, either identical or disjoint, and whose meshes all bind the
+// same streams, and only where every stream of the range is such a buffer; any other
+// buffer keeps its vertex order.
+//--------------------------------------------------------------------------------------
+#define OPTIMIZE_UNUSED 0xffffffff
+#define OPTIMIZE_SKIP   0xfffffffe
+
+struct SDKMESH_OPTIMIZE_SUBSET
 {
-    if( !m_pStaticMeshData || !m_pFrameArray )
-        return;
+    BYTE* pIndices;         // the subset's first index
+    UINT IndexType;
+    UINT NumIndices;
+    UINT NumVertices;       // one past the largest index
+    UINT NumMissesBefore;
+    UINT NumMissesAfter;
+    UINT NumUsedVertices;
+    HRESULT hr;
+};
+
+struct SDKMESH_OPTIMIZE_RANGE
+{
+    UINT iVB;               // the range's buffer in the first stream
+    UINT64 VertexStart;
+    UINT64 VertexCount;
+    UINT NumStreams;
+    UINT VBs[MAX_VERTEX_STREAMS];
+    BYTE* pStreams[MAX_VERTEX_STREAMS];
+    UINT Strides[MAX_VERTEX_STREAMS];
+    HRESULT hr;
+};
+
+struct SDKMESH_OPTIMIZE_CONTEXT
+{
+    SDKMESH_OPTIMIZE_SUBSET* pSubsets;
+    UINT* pSubsetRange;     // range of each subset, or OPTIMIZE_UNUSED
+    UINT NumSubsets;
+    SDKMESH_OPTIMIZE_RANGE* pRanges;
+};
 
-    if( m_pFrameArray[iFrame].Mesh != INVALID_MESH )
+static void ReadOptimizeIndices( const SDKMESH_OPTIMIZE_SUBSET* pSubset, UINT* pOut )
+{
+    if( pSubset->IndexType == IT_16BIT )
     {
-        RenderMesh( m_pFrameArray[iFrame].Mesh,
-                    bAdjacent,
-                    pd3dDeviceContext,
-                    iDiffuseSlot,
-                    iNormalSlot,
-                    iSpecularSlot );
+        const WORD* pIndices16 = ( const WORD* )pSubset->pIndices;
+        for( UINT i = 0; i < pSubset->NumIndices; i++ )
+            pOut[i] = pIndices16[i];
     }
+    else
+    {
+        CopyMemory( pOut, pSubset->pIndices, sizeof( UINT ) * pSubset->NumIndices );
+    }
+}
 
-    // Render our children
-    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
-        RenderFrame( m_pFrameArray[iFrame].ChildFrame, bAdjacent, pd3dDeviceContext, iDiffuseSlot, 
-                     iNormalSlot, iSpecularSlot );
-
-    // Render our siblings
-    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
-        RenderFrame( m_pFrameArray[iFrame].SiblingFrame, bAdjacent, pd3dDeviceContext, iDiffuseSlot, 
-                     iNormalSlot, iSpecularSlot );
+static void WriteOptimizeIndices( SDKMESH_OPTIMIZE_SUBSET* pSubset, const UINT* pIn )
+{
+    if( pSubset->IndexType == IT_16BIT )
+    {
+        WORD* pIndices16 = ( WORD* )pSubset->pIndices;
+        for( UINT i = 0; i < pSubset->NumIndices; i++ )
+            pIndices16[i] = ( WORD )pIn[i];
+    }
+    else
+    {
+        CopyMemory( pSubset->pIndices, pIn, sizeof( UINT ) * pSubset->NumIndices );
+    }
 }
 
 //--------------------------------------------------------------------------------------
+static void CALLBACK OptimizeSubsetFaces( UINT iJob, void* pContext )
+{
+    SDKMESH_OPTIMIZE_CONTEXT* pOptimize = ( SDKMESH_OPTIMIZE_CONTEXT* )pContext;
+    SDKMESH_OPTIMIZE_SUBSET* pSubset = &pOptimize->pSubsets[iJob];
+    if( pSubset->NumIndices == 0 )
+        return;
+
+    UINT* pIndices = new UINT[ pSubset->NumIndices * 2 ];
+    if( !pIndices )
+    {
+        pSubset->hr = E_OUTOFMEMORY;
+        return;
+    }
+    UINT* pOptimized = pIndices + pSubset->NumIndices;
+
+    ReadOptimizeIndices( pSubset, pIndices );
+    pSubset->NumVertices = 0;
+    for( UINT i = 0; i < pSubset->NumIndices; i++ )
+        pSubset->NumVertices = max( pSubset->NumVertices, pIndices[i] + 1 );
+
+    HRESULT hr = SDKMeshAnalyzeVertexCache( pIndices, pSubset->NumIndices, pSubset->NumVertices,
+                                            SDKMESH_MEASURE_CACHE_SIZE, &pSubset->NumMissesBefore,
+                                            &pSubset->NumUsedVertices );
+    if( SUCCEEDED( hr ) )
+        hr = SDKMeshOptimizeFaces( pIndices, pSubset->NumIndices, pSubset->NumVertices, pOptimized );
+    if( SUCCEEDED( hr ) )
+        hr = SDKMeshAnalyzeVertexCache( pOptimized, pSubset->NumIndices, pSubset->NumVertices,
+                                        SDKMESH_MEASURE_CACHE_SIZE, &pSubset->NumMissesAfter, NULL );
+
+    // Keep the authored order if it was already as good
+    if( SUCCEEDED( hr ) )
+    {
+        if( pSubset->NumMissesAfter < pSubset->NumMissesBefore )
+            WriteOptimizeIndices( pSubset, pOptimized );
+        else
+            pSubset->NumMissesAfter = pSubset->NumMissesBefore;
+    }
+
+    pSubset->hr = hr;
+    delete []pIndices;
+}
 
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::RenderMesh( UINT iMesh,
-                               LPDIRECT3DDEVICE9 pd3dDevice,
-                               LPD3DXEFFECT pEffect,
-                               D3DXHANDLE hTechnique,
-                               D3DXHANDLE htxDiffuse,
-                               D3DXHANDLE htxNormal,
-                               D3DXHANDLE htxSpecular )
+static void CALLBACK OptimizeRangeVertices( UINT iRange, void* pContext )
 {
-    if( 0 < GetOutstandingBufferResources() )
+    SDKMESH_OPTIMIZE_CONTEXT* pOptimize = ( SDKMESH_OPTIMIZE_CONTEXT* )pContext;
+    SDKMESH_OPTIMIZE_RANGE* pRange = &pOptimize->pRanges[iRange];
+    UINT VertexCount = ( UINT )pRange->VertexCount;
+
+    UINT MaxIndices = 0;
+    for( UINT iSubset = 0; iSubset < pOptimize->NumSubsets; iSubset++ )
+    {
+        if( pOptimize->pSubsetRange[iSubset] == iRange )
+            MaxIndices = max( MaxIndices, pOptimize->pSubsets[iSubset].NumIndices );
+    }
+
+    UINT* pRemap = new UINT[ VertexCount ];
+    UINT* pIndices = new UINT[ MaxIndices ];
+    if( !pRemap || !pIndices )
+    {
+        SAFE_DELETE_ARRAY( pRemap );
+        SAFE_DELETE_ARRAY( pIndices );
+        pRange->hr = E_OUTOFMEMORY;
         return;
+    }
 
-    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+    // Number the vertices as the reordered triangles first reach them
+    memset( pRemap, 0xff, sizeof( UINT ) * VertexCount );
+    UINT NextVertex = 0;
+    for( UINT iSubset = 0; iSubset < pOptimize->NumSubsets; iSubset++ )
+    {
+        if( pOptimize->pSubsetRange[iSubset] != iRange )
+            continue;
 
-    // set vb streams
-    for( UINT i = 0; i < ( UINT )pMesh->NumVertexBuffers; i++ )
+        SDKMESH_OPTIMIZE_SUBSET* pSubset = &pOptimize->pSubsets[iSubset];
+        ReadOptimizeIndices( pSubset, pIndices );
+        NextVertex = SDKMeshRemapVertices( pIndices, pSubset->NumIndices, pRemap, NextVertex );
+        WriteOptimizeIndices( pSubset, pIndices );
+    }
+    SDKMeshFinishVertexRemap( pRemap, VertexCount, NextVertex );
+
+    HRESULT hr = S_OK;
+    for( UINT i = 0; i < pRange->NumStreams && SUCCEEDED( hr ); i++ )
+        hr = SDKMeshPermuteVertices( pRange->pStreams[i], pRange->Strides[i], VertexCount, pRemap );
+
+    pRange->hr = hr;
+    delete []pRemap;
+    delete []pIndices;
+}
+
+//--------------------------------------------------------------------------------------
+static bool MeshStreamsMatch( const SDKMESH_MESH* pA, const SDKMESH_MESH* pB )
+{
+    if( pA->NumVertexBuffers != pB->NumVertexBuffers )
+        return false;
+    for( UINT i = 0; i < pA->NumVertexBuffers; i++ )
     {
-        pd3dDevice->SetStreamSource( i,
-                                     m_pVertexBufferArray[ pMesh->VertexBuffers[i] ].pVB9,
-                                     0,
-                                     ( UINT )m_pVertexBufferArray[ pMesh->VertexBuffers[i] ].StrideBytes );
+        if( pA->VertexBuffers[i] != pB->VertexBuffers[i] )
+            return false;
     }
+    return true;
+}
 
-    // Set our index buffer as well
-    pd3dDevice->SetIndices( m_pIndexBufferArray[ pMesh->IndexBuffer ].pIB9 );
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::OptimizeVertexCache()
+{
+    ZeroMemory( &m_VertexCacheStats, sizeof( SDKMESH_VERTEX_CACHE_STATS ) );
 
-    // Render the scene with this technique 
-    pEffect->SetTechnique( hTechnique );
+    UINT NumSubsets = m_pMeshHeader->NumTotalSubsets;
+    UINT NumVBs = m_pMeshHeader->NumVertexBuffers;
+    if( NumSubsets == 0 )
+        return S_OK;
 
-    SDKMESH_SUBSET* pSubset = NULL;
-    SDKMESH_MATERIAL* pMat = NULL;
-    D3DPRIMITIVETYPE PrimType;
-    UINT cPasses = 0;
-    pEffect->Begin( &cPasses, 0 );
+    SDKMESH_OPTIMIZE_SUBSET* pSubsets = new SDKMESH_OPTIMIZE_SUBSET[ NumSubsets ];
+    SDKMESH_OPTIMIZE_RANGE* pRanges = new SDKMESH_OPTIMIZE_RANGE[ NumSubsets ];
+    UINT* pSubsetMesh = new UINT[ NumSubsets * 2 + NumVBs ];
+    if( !pSubsets || !pRanges || !pSubsetMesh )
+    {
+        SAFE_DELETE_ARRAY( pSubsets );
+        SAFE_DELETE_ARRAY( pRanges );
+        SAFE_DELETE_ARRAY( pSubsetMesh );
+        return E_OUTOFMEMORY;
+    }
+    UINT* pSubsetRange = pSubsetMesh + NumSubsets;
+    UINT* pVBMesh = pSubsetRange + NumSubsets;
+    ZeroMemory( pSubsets, sizeof( SDKMESH_OPTIMIZE_SUBSET ) * NumSubsets );
+    memset( pSubsetMesh, 0xff, sizeof( UINT ) * ( NumSubsets * 2 + NumVBs ) );
+
+    // A subset shared by meshes that draw it from different buffers is left alone, as is
+    // a vertex buffer whose meshes don't bind the same streams
+    for( UINT iMesh = 0; iMesh < m_pMeshHeader->NumMeshes; iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+        {
+            UINT iSubset = pMesh->pSubsets[i];
+            UINT iOwner = pSubsetMesh[iSubset];
+            if( iOwner == OPTIMIZE_UNUSED )
+                pSubsetMesh[iSubset] = iMesh;
+            else if( iOwner != OPTIMIZE_SKIP && ( m_pMeshArray[iOwner].IndexBuffer != pMesh->IndexBuffer ||
+                                                  !MeshStreamsMatch( &m_pMeshArray[iOwner], pMesh ) ) )
+                pSubsetMesh[iSubset] = OPTIMIZE_SKIP;
+        }
 
-    for( UINT p = 0; p < cPasses; ++p )
+        for( UINT i = 0; i < pMesh->NumVertexBuffers; i++ )
+        {
+            UINT iVB = pMesh->VertexBuffers[i];
+            UINT iOwner = pVBMesh[iVB];
+            if( iOwner == OPTIMIZE_UNUSED )
+                pVBMesh[iVB] = iMesh;
+            else if( iOwner != OPTIMIZE_SKIP && !MeshStreamsMatch( &m_pMeshArray[iOwner], pMesh ) )
+                pVBMesh[iVB] = OPTIMIZE_SKIP;
+
+            // The same buffer bound to two streams would be permuted twice
+            for( UINT j = 0; j < i; j++ )
+            {
+                if( pMesh->VertexBuffers[j] == iVB )
+                    pVBMesh[iVB] = OPTIMIZE_SKIP;
+            }
+        }
+    }
+
+    // Triangle list subsets, each index range only once. Subsets drawing the same range
+    // share one job. Ranges that partly overlap can't be reordered on their own without
+    // moving triangles from one subset to another, so they are all left alone.
+    SDKMESH_INDEX_RANGE* pIndexRanges = new SDKMESH_INDEX_RANGE[ NumSubsets ];
+    UINT* pGroup = new UINT[ NumSubsets ];
+    bool* pSameRange = new bool[ NumSubsets ];
+    HRESULT hr = ( pIndexRanges && pGroup && pSameRange ) ? S_OK : E_OUTOFMEMORY;
+    if( SUCCEEDED( hr ) )
     {
-        pEffect->BeginPass( p );
+        ZeroMemory( pIndexRanges, sizeof( SDKMESH_INDEX_RANGE ) * NumSubsets );
+        for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
+        {
+            UINT iMesh = pSubsetMesh[iSubset];
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[iSubset];
+            if( iMesh >= OPTIMIZE_SKIP || pSubset->PrimitiveType != PT_TRIANGLE_LIST )
+                continue;
 
-        for( UINT subset = 0; subset < pMesh->NumSubsets; subset++ )
+            UINT iIB = m_pMeshArray[iMesh].IndexBuffer;
+            if( pSubset->IndexStart + pSubset->IndexCount > m_pIndexBufferArray[iIB].NumIndices )
+                continue;
+
+            pIndexRanges[iSubset].iBuffer = iIB;
+            pIndexRanges[iSubset].IndexStart = pSubset->IndexStart;
+            pIndexRanges[iSubset].IndexCount = pSubset->IndexCount;
+        }
+        hr = SDKMeshGroupIndexRanges( pIndexRanges, NumSubsets, pGroup, pSameRange );
+    }
+    if( SUCCEEDED( hr ) )
+    {
+        for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
         {
-            pSubset = &m_pSubsetArray[ pMesh->pSubsets[subset] ];
+            const SDKMESH_INDEX_RANGE* pRange = &pIndexRanges[iSubset];
+            if( pRange->IndexCount == 0 || pGroup[iSubset] != iSubset || !pSameRange[iSubset] )
+                continue;
 
-            PrimType = GetPrimitiveType9( ( SDKMESH_PRIMITIVE_TYPE )pSubset->PrimitiveType );
+            SDKMESH_INDEX_BUFFER_HEADER* pIB = &m_pIndexBufferArray[pRange->iBuffer];
+            UINT IndexSize = ( pIB->IndexType == IT_16BIT ) ? sizeof( WORD ) : sizeof( UINT );
+            pSubsets[iSubset].pIndices = m_ppIndices[pRange->iBuffer] + pRange->IndexStart * IndexSize;
+            pSubsets[iSubset].IndexType = pIB->IndexType;
+            pSubsets[iSubset].NumIndices = ( UINT )( pRange->IndexCount / 3 ) * 3;
+        }
+    }
+    SAFE_DELETE_ARRAY( pIndexRanges );
+    SAFE_DELETE_ARRAY( pGroup );
+    SAFE_DELETE_ARRAY( pSameRange );
 
-            if( INVALID_MATERIAL != pSubset->MaterialID && m_pMeshHeader->NumMaterials > 0 )
+    SDKMESH_OPTIMIZE_CONTEXT Context;
+    Context.pSubsets = pSubsets;
+    Context.pSubsetRange = pSubsetRange;
+    Context.NumSubsets = NumSubsets;
+    Context.pRanges = pRanges;
+
+    if( SUCCEEDED( hr ) )
+        DXUTParallelFor( NumSubsets, OptimizeSubsetFaces, &Context );
+
+    for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
+    {
+        SDKMESH_OPTIMIZE_SUBSET* pOptimized = &pSubsets[iSubset];
+        if( FAILED( pOptimized->hr ) )
+            hr = pOptimized->hr;
+        if( pOptimized->NumIndices == 0 || FAILED( pOptimized->hr ) )
+            continue;
+
+        m_VertexCacheStats.NumSubsets++;
+        m_VertexCacheStats.NumTriangles += pOptimized->NumIndices / 3;
+        m_VertexCacheStats.NumVertices += pOptimized->NumUsedVertices;
+        m_VertexCacheStats.NumMissesBefore += pOptimized->NumMissesBefore;
+        m_VertexCacheStats.NumMissesAfter += pOptimized->NumMissesAfter;
+    }
+
+    // Group the subsets of each vertex buffer by range. Anything on the buffer that can't
+    // be renumbered, or ranges that partly overlap, keep the whole buffer as it is.
+    UINT NumRanges = 0;
+    for( UINT iMesh = 0; iMesh < m_pMeshHeader->NumMeshes && SUCCEEDED( hr ); iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        UINT iVB = pMesh->VertexBuffers[0];
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+        {
+            UINT iSubset = pMesh->pSubsets[i];
+            if( pSubsetRange[iSubset] != OPTIMIZE_UNUSED )
+                continue;
+
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[iSubset];
+            SDKMESH_OPTIMIZE_SUBSET* pOptimized = &pSubsets[iSubset];
+            bool bRemap = pSubsetMesh[iSubset] == iMesh && pOptimized->NumIndices > 0 &&
+                pSubset->VertexCount > 0 && pOptimized->NumVertices <= pSubset->VertexCount &&
+                ( pOptimized->IndexType != IT_16BIT || pSubset->VertexCount <= 0x10000 );
+            for( UINT j = 0; j < pMesh->NumVertexBuffers && bRemap; j++ )
+                bRemap = ( pSubset->VertexStart + pSubset->VertexCount <=
+                           m_pVertexBufferArray[pMesh->VertexBuffers[j]].NumVertices );
+            if( !bRemap )
             {
-                pMat = &m_pMaterialArray[ pSubset->MaterialID ];
-                if( htxDiffuse && !IsErrorResource( pMat->pDiffuseTexture9 ) )
-                    pEffect->SetTexture( htxDiffuse, pMat->pDiffuseTexture9 );
-                if( htxNormal && !IsErrorResource( pMat->pNormalTexture9 ) )
-                    pEffect->SetTexture( htxNormal, pMat->pNormalTexture9 );
-                if( htxSpecular && !IsErrorResource( pMat->pSpecularTexture9 ) )
-                    pEffect->SetTexture( htxSpecular, pMat->pSpecularTexture9 );
+                pVBMesh[iVB] = OPTIMIZE_SKIP;
+                continue;
             }
 
-            pEffect->CommitChanges();
+            UINT iRange = 0;
+            for(; iRange < NumRanges; iRange++ )
+            {
+                SDKMESH_OPTIMIZE_RANGE* pRange = &pRanges[iRange];
+                if( pRange->iVB != iVB )
+                    continue;
+                if( pRange->VertexStart == pSubset->VertexStart && pRange->VertexCount == pSubset->VertexCount )
+                    break;
+                if( pRange->VertexStart < pSubset->VertexStart + pSubset->VertexCount &&
+                    pSubset->VertexStart < pRange->VertexStart + pRange->VertexCount )
+                    pVBMesh[iVB] = OPTIMIZE_SKIP;
+            }
 
-            UINT PrimCount = ( UINT )pSubset->IndexCount;
-            UINT IndexStart = ( UINT )pSubset->IndexStart;
-            UINT VertexStart = ( UINT )pSubset->VertexStart;
-            UINT VertexCount = ( UINT )pSubset->VertexCount;
-            if( D3DPT_TRIANGLELIST == PrimType )
-                PrimCount /= 3;
-            if( D3DPT_LINELIST == PrimType )
-                PrimCount /= 2;
-            if( D3DPT_TRIANGLESTRIP == PrimType )
-                PrimCount = ( PrimCount - 3 ) + 1;
-            if( D3DPT_LINESTRIP == PrimType )
-                PrimCount -= 1;
+            if( iRange == NumRanges )
+            {
+                SDKMESH_OPTIMIZE_RANGE* pRange = &pRanges[NumRanges++];
+                pRange->iVB = iVB;
+                pRange->VertexStart = pSubset->VertexStart;
+                pRange->VertexCount = pSubset->VertexCount;
+                pRange->NumStreams = pMesh->NumVertexBuffers;
+                for( UINT j = 0; j < pMesh->NumVertexBuffers; j++ )
+                {
+                    pRange->VBs[j] = pMesh->VertexBuffers[j];
+                    SDKMESH_VERTEX_BUFFER_HEADER* pVB = &m_pVertexBufferArray[pMesh->VertexBuffers[j]];
+                    pRange->Strides[j] = ( UINT )pVB->StrideBytes;
+                    pRange->pStreams[j] = m_ppVertices[pMesh->VertexBuffers[j]] +
+                        pSubset->VertexStart * pVB->StrideBytes;
+                }
+                pRange->hr = S_OK;
+            }
+            pSubsetRange[iSubset] = iRange;
+        }
+    }
 
-            pd3dDevice->DrawIndexedPrimitive( PrimType, VertexStart, 0, VertexCount, IndexStart, PrimCount );
+    // Drop the ranges that permute any buffer that turned out to be unsafe and compact
+    // the rest
+    UINT NumKept = 0;
+    for( UINT iRange = 0; iRange < NumRanges; iRange++ )
+    {
+        bool bKeep = true;
+        for( UINT j = 0; j < pRanges[iRange].NumStreams && bKeep; j++ )
+            bKeep = ( pVBMesh[pRanges[iRange].VBs[j]] != OPTIMIZE_SKIP );
+        for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
+        {
+            if( pSubsetRange[iSubset] == iRange )
+                pSubsetRange[iSubset] = bKeep ? NumKept : OPTIMIZE_UNUSED;
         }
+        if( bKeep )
+            pRanges[NumKept++] = pRanges[iRange];
+    }
 
-        pEffect->EndPass();
+    if( SUCCEEDED( hr ) )
+    {
+        DXUTParallelFor( NumKept, OptimizeRangeVertices, &Context );
+        for( UINT iRange = 0; iRange < NumKept; iRange++ )
+        {
+            if( FAILED( pRanges[iRange].hr ) )
+                hr = pRanges[iRange].hr;
+        }
+        m_VertexCacheStats.NumRemappedVertexRanges = NumKept;
     }
 
-    pEffect->End();
+    SDKMESH_VERTEX_CACHE_STATS* pStats = &m_VertexCacheStats;
+    if( pStats->NumTriangles > 0 )
+    {
+        pStats->ACMRBefore = ( float )pStats->NumMissesBefore / pStats->NumTriangles;
+        pStats->ACMRAfter = ( float )pStats->NumMissesAfter / pStats->NumTriangles;
+        pStats->ATVRBefore = ( float )pStats->NumMissesBefore / pStats->NumVertices;
+        pStats->ATVRAfter = ( float )pStats->NumMissesAfter / pStats->NumVertices;
+    }
+
+    SAFE_DELETE_ARRAY( pSubsets );
+    SAFE_DELETE_ARRAY( pRanges );
+    SAFE_DELETE_ARRAY( pSubsetMesh );
+
+    return hr;
 }
 
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::RenderFrame( UINT iFrame,
-                                LPDIRECT3DDEVICE9 pd3dDevice,
-                                LPD3DXEFFECT pEffect,
-                                D3DXHANDLE hTechnique,
-                                D3DXHANDLE htxDiffuse,
-                                D3DXHANDLE htxNormal,
-                                D3DXHANDLE htxSpecular )
+// LOD generation. Every level of every triangle list subset is simplified from the full
+// detail indices on its own, so the jobs run in parallel and errors don't stack up
+// from level to level.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_LOD_JOB
 {
-    if( !m_pStaticMeshData || !m_pFrameArray )
+    SDKMESH_SIMPLIFY_SOURCE Source;     // pointers already offset to the subset's VertexStart
+    UINT MaxVertices;                   // vertices from VertexStart to the end of the buffer
+    const BYTE* pIndices;               // the subset's first index
+    UINT IndexType;
+    UINT NumIndices;
+    UINT TargetIndices;
+    float MaxError;
+    float NormalWeight;
+    float TexCoordWeight;
+    UINT* pResult;
+    UINT NumResult;
+    float Error;
+    HRESULT hr;
+};
+
+static void CALLBACK SimplifySubsetLOD( UINT iJob, void* pContext )
+{
+    SDKMESH_LOD_JOB* pJob = &( ( SDKMESH_LOD_JOB* )pContext )[iJob];
+    if( pJob->NumIndices == 0 )
         return;
 
-    if( m_pFrameArray[iFrame].Mesh != INVALID_MESH )
+    UINT* pIndices = new UINT[ pJob->NumIndices ];
+    pJob->pResult = new UINT[ pJob->NumIndices ];
+    if( !pIndices || !pJob->pResult )
     {
-        RenderMesh( m_pFrameArray[iFrame].Mesh,
-                    pd3dDevice,
-                    pEffect,
-                    hTechnique,
-                    htxDiffuse,
-                    htxNormal,
-                    htxSpecular );
+        SAFE_DELETE_ARRAY( pIndices );
+        pJob->hr = E_OUTOFMEMORY;
+        return;
     }
 
-    // Render our children
-    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
-        RenderFrame( m_pFrameArray[iFrame].ChildFrame, pd3dDevice, pEffect, hTechnique, htxDiffuse, htxNormal,
-                     htxSpecular );
+    UINT NumVertices = 0;
+    for( UINT i = 0; i < pJob->NumIndices; i++ )
+    {
+        pIndices[i] = ( pJob->IndexType == IT_16BIT ) ? ( ( const WORD* )pJob->pIndices )[i] :
+            ( ( const UINT* )pJob->pIndices )[i];
+        NumVertices = max( NumVertices, pIndices[i] + 1 );
+    }
 
-    // Render our siblings
-    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
-        RenderFrame( m_pFrameArray[iFrame].SiblingFrame, pd3dDevice, pEffect, hTechnique, htxDiffuse, htxNormal,
-                     htxSpecular );
+    if( NumVertices > pJob->MaxVertices )
+    {
+        pJob->hr = E_INVALIDARG;
+    }
+    else
+    {
+        pJob->Source.NumVertices = NumVertices;
+        pJob->hr = SDKMeshSimplify( &pJob->Source, pIndices, pJob->NumIndices, pJob->TargetIndices, pJob->MaxError,
+                                    pJob->NormalWeight, pJob->TexCoordWeight, pJob->pResult, &pJob->NumResult,
+                                    &pJob->Error );
+    }
+    delete []pIndices;
 }
 
+//--------------------------------------------------------------------------------------
+static const D3DVERTEXELEMENT9* FindDeclElement( const D3DVERTEXELEMENT9* pDecl, BYTE Usage, BYTE Type )
+{
+    for( UINT i = 0; i < MAX_VERTEX_ELEMENTS && pDecl[i].Stream != 0xff; i++ )
+    {
+        if( pDecl[i].Usage == Usage && pDecl[i].UsageIndex == 0 && pDecl[i].Type == Type )
+            return &pDecl[i];
+    }
+    return NULL;
+}
 
 //--------------------------------------------------------------------------------------
-CDXUTSDKMesh::CDXUTSDKMesh() : m_NumOutstandingResources( 0 ),
-                               m_bLoading( false ),
-                               m_hFile( 0 ),
-                               m_hFileMappingObject( 0 ),
-                               m_pMeshHeader( NULL ),
-                               m_pStaticMeshData( NULL ),
-                               m_pHeapData( NULL ),
-                               m_pAdjacencyIndexBufferArray( NULL ),
-                               m_pAnimationData( NULL ),
-                               m_pAnimationHeader( NULL ),
-                               m_ppVertices( NULL ),
-                               m_ppIndices( NULL ),
-                               m_pBindPoseFrameMatrices( NULL ),
-                               m_pTransformedFrameMatrices( NULL ),
-                               m_pWorldPoseFrameMatrices( NULL ),
-                               m_pDev9( NULL ),
-							   m_pDev11( NULL )
+HRESULT CDXUTSDKMesh::GenerateLODs( const SDKMESH_LOD_SETTINGS* pSettings )
+{
+    if( !m_pMeshHeader || !m_pSubsetBounds )
+        return E_FAIL;
+
+    SDKMESH_LOD_SETTINGS Settings;
+    if( pSettings )
+    {
+        Settings = *pSettings;
+    }
+    else
+    {
+        Settings.NumLODs = SDKMESH_DEFAULT_LOD_COUNT;
+        Settings.TriangleRatio = SDKMESH_DEFAULT_LOD_TRIANGLE_RATIO;
+        Settings.MaxError = SDKMESH_DEFAULT_LOD_MAX_ERROR;
+        Settings.NormalWeight = SDKMESH_DEFAULT_LOD_NORMAL_WEIGHT;
+        Settings.TexCoordWeight = SDKMESH_DEFAULT_LOD_TEXCOORD_WEIGHT;
+    }
+
+    DestroyLODs();
+    if( Settings.NumLODs == 0 )
+        return S_OK;
+
+    UINT NumMeshes = m_pMeshHeader->NumMeshes;
+    UINT NumVBs = m_pMeshHeader->NumVertexBuffers;
+    UINT NumLevels = Settings.NumLODs;
+
+    // A vertex used by more than one subset is locked so the subsets stay joined
+    UINT64 TotalVertices = 0;
+    UINT64* pVBFirst = new UINT64[ NumVBs ];
+    if( !pVBFirst )
+        return E_OUTOFMEMORY;
+    for( UINT i = 0; i < NumVBs; i++ )
+    {
+        pVBFirst[i] = TotalVertices;
+        TotalVertices += m_pVertexBufferArray[i].NumVertices;
+    }
+
+    UINT* pVertexSubset = new UINT[ ( SIZE_T )TotalVertices ];
+    bool* pLocked = new bool[ ( SIZE_T )TotalVertices ];
+    UINT NumJobs = 0;
+    for( UINT iMesh = 0; iMesh < NumMeshes; iMesh++ )
+        NumJobs += m_pMeshArray[iMesh].NumSubsets * NumLevels;
+    SDKMESH_LOD_JOB* pJobs = new SDKMESH_LOD_JOB[ max( NumJobs, 1 ) ];
+    m_pLODs = new SDKMESH_LOD[ NumMeshes * NumLevels ];
+    m_pMeshLODs = new UINT[ NumMeshes ];
+    if( !pVertexSubset || !pLocked || !pJobs || !m_pLODs || !m_pMeshLODs )
+    {
+        SAFE_DELETE_ARRAY( pVBFirst );
+        SAFE_DELETE_ARRAY( pVertexSubset );
+        SAFE_DELETE_ARRAY( pLocked );
+        SAFE_DELETE_ARRAY( pJobs );
+        DestroyLODs();
+        return E_OUTOFMEMORY;
+    }
+    m_MaxLODs = NumLevels;
+    ZeroMemory( m_pLODs, sizeof( SDKMESH_LOD ) * NumMeshes * NumLevels );
+    ZeroMemory( m_pMeshLODs, sizeof( UINT ) * NumMeshes );
+    ZeroMemory( pJobs, sizeof( SDKMESH_LOD_JOB ) * max( NumJobs, 1 ) );
+    memset( pVertexSubset, 0xff, sizeof( UINT ) * ( SIZE_T )TotalVertices );
+    ZeroMemory( pLocked, sizeof( bool ) * ( SIZE_T )TotalVertices );
+
+    for( UINT iMesh = 0; iMesh < NumMeshes; iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        UINT iVB = pMesh->VertexBuffers[0];
+        SDKMESH_INDEX_BUFFER_HEADER* pIB = &m_pIndexBufferArray[pMesh->IndexBuffer];
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+        {
+            UINT iSubset = pMesh->pSubsets[i];
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[iSubset];
+            for( UINT64 j = pSubset->IndexStart; j < pSubset->IndexStart + pSubset->IndexCount; j++ )
+            {
+                UINT64 v = pSubset->VertexStart + ( ( pIB->IndexType == IT_16BIT ) ?
+                                                    ( ( WORD* )m_ppIndices[pMesh->IndexBuffer] )[j] :
+                                                    ( ( UINT* )m_ppIndices[pMesh->IndexBuffer] )[j] );
+                if( v >= m_pVertexBufferArray[iVB].NumVertices )
+                    continue;
+                UINT* pOwner = &pVertexSubset[pVBFirst[iVB] + v];
+                if( *pOwner == OPTIMIZE_UNUSED )
+                    *pOwner = iSubset;
+                else if( *pOwner != iSubset )
+                    pLocked[pVBFirst[iVB] + v] = true;
+            }
+        }
+    }
+
+    // One job for each level of each triangle list subset
+    UINT iJob = 0;
+    for( UINT iMesh = 0; iMesh < NumMeshes; iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        float Radius = D3DXVec3Length( &pMesh->BoundingBoxExtents );
+
+        SDKMESH_SIMPLIFY_SOURCE Source;
+        ZeroMemory( &Source, sizeof( SDKMESH_SIMPLIFY_SOURCE ) );
+        for( UINT i = 0; i < pMesh->NumVertexBuffers; i++ )
+        {
+            UINT iVB = pMesh->VertexBuffers[i];
+            SDKMESH_VERTEX_BUFFER_HEADER* pVB = &m_pVertexBufferArray[iVB];
+            const D3DVERTEXELEMENT9* pElement;
+            if( !Source.pPositions && ( pElement = FindDeclElement( pVB->Decl, D3DDECLUSAGE_POSITION,
+                                                                    D3DDECLTYPE_FLOAT3 ) ) != NULL )
+            {
+                Source.pPositions = m_ppVertices[iVB] + pElement->Offset;
+                Source.PositionStride = ( UINT )pVB->StrideBytes;
+            }
+            if( !Source.pNormals && ( pElement = FindDeclElement( pVB->Decl, D3DDECLUSAGE_NORMAL,
+                                                                  D3DDECLTYPE_FLOAT3 ) ) != NULL )
+            {
+                Source.pNormals = m_ppVertices[iVB] + pElement->Offset;
+                Source.NormalStride = ( UINT )pVB->StrideBytes;
+            }
+            if( !Source.pTexCoords && ( pElement = FindDeclElement( pVB->Decl, D3DDECLUSAGE_TEXCOORD,
+                                                                    D3DDECLTYPE_FLOAT2 ) ) != NULL )
+            {
+                Source.pTexCoords = m_ppVertices[iVB] + pElement->Offset;
+                Source.TexCoordStride = ( UINT )pVB->StrideBytes;
+            }
+        }
+
+        UINT iVB = pMesh->VertexBuffers[0];
+        SDKMESH_INDEX_BUFFER_HEADER* pIB = &m_pIndexBufferArray[pMesh->IndexBuffer];
+        UINT IndexSize = ( pIB->IndexType == IT_16BIT ) ? sizeof( WORD ) : sizeof( UINT );
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+        {
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[pMesh->pSubsets[i]];
+            float Target = ( float )( pSubset->IndexCount / 3 );
+            for( UINT iLevel = 0; iLevel < NumLevels; iLevel++ )
+            {
+                SDKMESH_LOD_JOB* pJob = &pJobs[iJob++];
+                Target *= Settings.TriangleRatio;
+                if( !Source.pPositions || pSubset->PrimitiveType != PT_TRIANGLE_LIST ||
+                    pSubset->VertexStart >= m_pVertexBufferArray[iVB].NumVertices )
+                    continue;
+
+                pJob->Source = Source;
+                pJob->Source.pPositions += pSubset->VertexStart * Source.PositionStride;
+                if( Source.pNormals )
+                    pJob->Source.pNormals += pSubset->VertexStart * Source.NormalStride;
+                if( Source.pTexCoords )
+                    pJob->Source.pTexCoords += pSubset->VertexStart * Source.TexCoordStride;
+                pJob->Source.pLocked = &pLocked[pVBFirst[iVB] + pSubset->VertexStart];
+                pJob->MaxVertices = ( UINT )( m_pVertexBufferArray[iVB].NumVertices - pSubset->VertexStart );
+                pJob->pIndices = m_ppIndices[pMesh->IndexBuffer] + pSubset->IndexStart * IndexSize;
+                pJob->IndexType = pIB->IndexType;
+                pJob->NumIndices = ( UINT )( pSubset->IndexCount / 3 ) * 3;
+                pJob->TargetIndices = ( UINT )( Target + 0.5f ) * 3;
+                pJob->MaxError = Settings.MaxError * Radius;
+                pJob->NormalWeight = Settings.NormalWeight * Radius;
+                pJob->TexCoordWeight = Settings.TexCoordWeight * Radius;
+            }
+        }
+    }
+
+    // Jobs left empty above keep the subset's original indices in every level
+    DXUTParallelFor( NumJobs, SimplifySubsetLOD, pJobs );
+
+    // A subset that can't be simplified, such as one with indices past the end of its
+    // vertex buffer, keeps its original indices in every level, so the rest of the mesh
+    // still gets its LODs. Only running out of memory fails the whole call.
+    HRESULT hr = S_OK;
+    for( UINT iFirst = 0; iFirst < NumJobs; iFirst += NumLevels )
+    {
+        bool bFailed = false;
+        for( iJob = iFirst; iJob < iFirst + NumLevels; iJob++ )
+        {
+            if( pJobs[iJob].hr == E_OUTOFMEMORY )
+                hr = E_OUTOFMEMORY;
+            bFailed = bFailed || FAILED( pJobs[iJob].hr );
+        }
+        if( !bFailed )
+            continue;
+
+        for( iJob = iFirst; iJob < iFirst + NumLevels; iJob++ )
+            SAFE_DELETE_ARRAY( pJobs[iJob].pResult );
+    }
+
+    // Put each level's subsets together into one index buffer. A mesh stops at the
+    // first level that removes nothing.
+    iJob = 0;
+    for( UINT iMesh = 0; iMesh < NumMeshes && SUCCEEDED( hr ); iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        SDKMESH_INDEX_BUFFER_HEADER* pIB = &m_pIndexBufferArray[pMesh->IndexBuffer];
+        UINT IndexSize = ( pIB->IndexType == IT_16BIT ) ? sizeof( WORD ) : sizeof( UINT );
+        SDKMESH_LOD_JOB* pMeshJobs = &pJobs[iJob];
+        iJob += pMesh->NumSubsets * NumLevels;
+
+        UINT64 PreviousIndices = GetNumIndices( iMesh );
+        float PreviousError = 0.0f;
+        for( UINT iLevel = 0; iLevel < NumLevels && SUCCEEDED( hr ); iLevel++ )
+        {
+            UINT64 NumIndices = 0;
+            for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+            {
+                SDKMESH_LOD_JOB* pJob = &pMeshJobs[i * NumLevels + iLevel];
+                NumIndices += pJob->pResult ? pJob->NumResult : m_pSubsetArray[pMesh->pSubsets[i]].IndexCount;
+            }
+            if( NumIndices >= PreviousIndices || NumIndices == 0 )
+                break;
+
+            SDKMESH_LOD* pLOD = &m_pLODs[iMesh * NumLevels + iLevel];
+            pLOD->IndexBuffer.NumIndices = NumIndices;
+            pLOD->IndexBuffer.SizeBytes = NumIndices * IndexSize;
+            pLOD->IndexBuffer.IndexType = pIB->IndexType;
+            pLOD->pIndices = new BYTE[ ( SIZE_T )pLOD->IndexBuffer.SizeBytes ];
+            pLOD->pSubsetIndices = new UINT[ pMesh->NumSubsets * 2 ];
+            if( !pLOD->pIndices || !pLOD->pSubsetIndices )
+            {
+                hr = E_OUTOFMEMORY;
+                break;
+            }
+
+            pLOD->Error = PreviousError;
+            UINT Start = 0;
+            for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+            {
+                SDKMESH_LOD_JOB* pJob = &pMeshJobs[i * NumLevels + iLevel];
+                SDKMESH_SUBSET* pSubset = &m_pSubsetArray[pMesh->pSubsets[i]];
+                BYTE* pDest = pLOD->pIndices + ( SIZE_T )Start * IndexSize;
+                UINT Count;
+                if( pJob->pResult )
+                {
+                    Count = pJob->NumResult;
+                    for( UINT j = 0; j < Count; j++ )
+                    {
+                        if( IndexSize == sizeof( WORD ) )
+                            ( ( WORD* )pDest )[j] = ( WORD )pJob->pResult[j];
+                        else
+                            ( ( UINT* )pDest )[j] = pJob->pResult[j];
+                    }
+                    pLOD->Error = max( pLOD->Error, pJob->Error );
+                }
+                else
+                {
+                    Count = ( UINT )pSubset->IndexCount;
+                    CopyMemory( pDest, m_ppIndices[pMesh->IndexBuffer] + pSubset->IndexStart * IndexSize,
+                                ( SIZE_T )Count * IndexSize );
+                }
+                pLOD->pSubsetIndices[i * 2] = Start;
+                pLOD->pSubsetIndices[i * 2 + 1] = Count;
+                Start += Count;
+            }
+
+            if( m_pDev11 )
+                hr = CreateIndexBuffer( m_pDev11, &pLOD->IndexBuffer, pLOD->pIndices );
+            else if( m_pDev9 )
+                hr = CreateIndexBuffer( m_pDev9, &pLOD->IndexBuffer, pLOD->pIndices );
+            else
+                pLOD->IndexBuffer.DataOffset = 0;
+
+            m_pMeshLODs[iMesh] = iLevel + 1;
+            PreviousIndices = NumIndices;
+            PreviousError = pLOD->Error;
+        }
+    }
+
+    for( iJob = 0; iJob < NumJobs; iJob++ )
+        SAFE_DELETE_ARRAY( pJobs[iJob].pResult );
+    SAFE_DELETE_ARRAY( pJobs );
+    SAFE_DELETE_ARRAY( pVBFirst );
+    SAFE_DELETE_ARRAY( pVertexSubset );
+    SAFE_DELETE_ARRAY( pLocked );
+
+    if( FAILED( hr ) )
+        DestroyLODs();
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::DestroyLODs()
+{
+    if( m_pLODs && m_pMeshHeader )
+    {
+        for( UINT i = 0; i < m_pMeshHeader->NumMeshes * m_MaxLODs; i++ )
+        {
+            SAFE_RELEASE( m_pLODs[i].IndexBuffer.pIB11 );
+            SAFE_DELETE_ARRAY( m_pLODs[i].pIndices );
+            SAFE_DELETE_ARRAY( m_pLODs[i].pSubsetIndices );
+        }
+    }
+    SAFE_DELETE_ARRAY( m_pLODs );
+    SAFE_DELETE_ARRAY( m_pMeshLODs );
+    m_MaxLODs = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// The triangles of one mesh's hierarchy, over the float3 positions of its vertex data.
+// Triangles with an index past the end of the vertex buffer are left out. *ppTriangles
+// is NULL for a mesh without positions; otherwise the caller deletes it.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::GetBVHTriangles( UINT iMesh, SDKMESH_BVH_TRIANGLE** ppTriangles, UINT* pNumTriangles )
+{
+    *ppTriangles = NULL;
+    *pNumTriangles = 0;
+
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+    SDKMESH_INDEX_BUFFER_HEADER* pIB = &m_pIndexBufferArray[pMesh->IndexBuffer];
+
+    const BYTE* pPositions = NULL;
+    UINT PositionStride = 0;
+    UINT64 NumVertices = 0;
+    for( UINT i = 0; i < pMesh->NumVertexBuffers && !pPositions; i++ )
+    {
+        SDKMESH_VERTEX_BUFFER_HEADER* pVB = &m_pVertexBufferArray[ pMesh->VertexBuffers[i] ];
+        const D3DVERTEXELEMENT9* pElement = FindDeclElement( pVB->Decl, D3DDECLUSAGE_POSITION, D3DDECLTYPE_FLOAT3 );
+        if( pElement )
+        {
+            pPositions = m_ppVertices[ pMesh->VertexBuffers[i] ] + pElement->Offset;
+            PositionStride = ( UINT )pVB->StrideBytes;
+            NumVertices = pVB->NumVertices;
+        }
+    }
+    if( !pPositions )
+        return S_OK;
+
+    UINT NumTriangles = 0;
+    for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+    {
+        SDKMESH_SUBSET* pSubset = &m_pSubsetArray[ pMesh->pSubsets[i] ];
+        if( pSubset->PrimitiveType == PT_TRIANGLE_LIST &&
+            pSubset->IndexStart + pSubset->IndexCount <= pIB->NumIndices )
+            NumTriangles += ( UINT )( pSubset->IndexCount / 3 );
+    }
+
+    SDKMESH_BVH_TRIANGLE* pTriangles = new SDKMESH_BVH_TRIANGLE[ max( NumTriangles, 1 ) ];
+    if( !pTriangles )
+        return E_OUTOFMEMORY;
+
+    UINT NumUsed = 0;
+    for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+    {
+        SDKMESH_SUBSET* pSubset = &m_pSubsetArray[ pMesh->pSubsets[i] ];
+        if( pSubset->PrimitiveType != PT_TRIANGLE_LIST ||
+            pSubset->IndexStart + pSubset->IndexCount > pIB->NumIndices )
+            continue;
+
+        for( UINT t = 0; t < ( UINT )( pSubset->IndexCount / 3 ); t++ )
+        {
+            UINT64 Corner[3];
+            for( UINT k = 0; k < 3; k++ )
+            {
+                UINT64 j = pSubset->IndexStart + t * 3 + k;
+                if( pIB->IndexType == IT_16BIT )
+                    Corner[k] = ( ( const WORD* )m_ppIndices[pMesh->IndexBuffer] )[j];
+                else
+                    Corner[k] = ( ( const UINT* )m_ppIndices[pMesh->IndexBuffer] )[j];
+                Corner[k] += pSubset->VertexStart;
+            }
+            if( Corner[0] >= NumVertices || Corner[1] >= NumVertices || Corner[2] >= NumVertices )
+                continue;
+
+            SDKMeshSetBVHTriangle( &pTriangles[NumUsed++],
+                                   ( const float* )( pPositions + Corner[0] * PositionStride ),
+                                   ( const float* )( pPositions + Corner[1] * PositionStride ),
+                                   ( const float* )( pPositions + Corner[2] * PositionStride ), i, t );
+        }
+    }
+
+    *ppTriangles = pTriangles;
+    *pNumTriangles = NumUsed;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// What a saved hierarchy was built from: its triangle count and a 64 bit FNV-1a hash of
+// the triangles, which covers the indices, the positions and the subsets they're in
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::GetBVHFingerprint( UINT iMesh, UINT* pNumTriangles, UINT64* pHash )
+{
+    SDKMESH_BVH_TRIANGLE* pTriangles = NULL;
+    HRESULT hr = GetBVHTriangles( iMesh, &pTriangles, pNumTriangles );
+    if( FAILED( hr ) )
+        return hr;
+
+    UINT64 Hash = 14695981039346656037ULL;
+    const BYTE* pBytes = ( const BYTE* )pTriangles;
+    for( SIZE_T i = 0; pTriangles && i < sizeof( SDKMESH_BVH_TRIANGLE ) * *pNumTriangles; i++ )
+        Hash = ( Hash ^ pBytes[i] ) * 1099511628211ULL;
+    *pHash = Hash;
+
+    SAFE_DELETE_ARRAY( pTriangles );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// One hierarchy for each mesh, see GetBVHTriangles
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::BuildBVHs()
+{
+    if( !m_pMeshHeader )
+        return E_FAIL;
+
+    DestroyBVHs();
+    UINT NumMeshes = m_pMeshHeader->NumMeshes;
+    m_pBVHs = new SDKMESH_BVH[ max( NumMeshes, 1 ) ];
+    if( !m_pBVHs )
+        return E_OUTOFMEMORY;
+    ZeroMemory( m_pBVHs, sizeof( SDKMESH_BVH ) * max( NumMeshes, 1 ) );
+
+    HRESULT hr = S_OK;
+    for( UINT iMesh = 0; iMesh < NumMeshes && SUCCEEDED( hr ); iMesh++ )
+    {
+        SDKMESH_BVH_TRIANGLE* pTriangles = NULL;
+        UINT NumTriangles = 0;
+        hr = GetBVHTriangles( iMesh, &pTriangles, &NumTriangles );
+        if( SUCCEEDED( hr ) && pTriangles )
+            hr = SDKMeshBuildBVH( pTriangles, NumTriangles, &m_pBVHs[iMesh] );
+        SAFE_DELETE_ARRAY( pTriangles );
+    }
+
+    if( FAILED( hr ) )
+        DestroyBVHs();
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::DestroyBVHs()
+{
+    if( m_pBVHs && m_pMeshHeader )
+    {
+        for( UINT i = 0; i < m_pMeshHeader->NumMeshes; i++ )
+            SDKMeshDestroyBVH( &m_pBVHs[i] );
+    }
+    SAFE_DELETE_ARRAY( m_pBVHs );
+}
+
+//--------------------------------------------------------------------------------------
+// A BVH file is this header, a fingerprint of each mesh's triangles (see
+// GetBVHFingerprint), then each mesh's hierarchy as SDKMeshWriteBVH lays it out
+//--------------------------------------------------------------------------------------
+#define SDKMESH_BVH_FILE_MAGIC      0x46564253  // 'SBVF'
+#define SDKMESH_BVH_FILE_VERSION    2
+
+struct SDKMESH_BVH_FILE_HEADER
+{
+    UINT Magic;
+    UINT Version;
+    UINT NumMeshes;
+    UINT Reserved;
+};
+
+struct SDKMESH_BVH_FILE_MESH
+{
+    UINT NumTriangles;
+    UINT Reserved;
+    UINT64 Hash;
+};
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::SaveBVHs( LPCTSTR szFileName )
+{
+    if( !m_pBVHs )
+        return E_FAIL;
+
+    UINT NumMeshes = m_pMeshHeader->NumMeshes;
+    UINT64 Size = sizeof( SDKMESH_BVH_FILE_HEADER ) + sizeof( SDKMESH_BVH_FILE_MESH ) * ( UINT64 )NumMeshes;
+    for( UINT i = 0; i < NumMeshes; i++ )
+        Size += SDKMeshGetBVHSize( &m_pBVHs[i] );
+    if( Size > 0xffffffff )
+        return E_FAIL;
+
+    BYTE* pData = new BYTE[ ( size_t )Size ];
+    if( !pData )
+        return E_OUTOFMEMORY;
+
+    SDKMESH_BVH_FILE_HEADER Header;
+    Header.Magic = SDKMESH_BVH_FILE_MAGIC;
+    Header.Version = SDKMESH_BVH_FILE_VERSION;
+    Header.NumMeshes = NumMeshes;
+    Header.Reserved = 0;
+    CopyMemory( pData, &Header, sizeof( SDKMESH_BVH_FILE_HEADER ) );
+
+    HRESULT hr = S_OK;
+    SDKMESH_BVH_FILE_MESH* pMeshes = ( SDKMESH_BVH_FILE_MESH* )( pData + sizeof( SDKMESH_BVH_FILE_HEADER ) );
+    for( UINT i = 0; i < NumMeshes && SUCCEEDED( hr ); i++ )
+    {
+        pMeshes[i].Reserved = 0;
+        hr = GetBVHFingerprint( i, &pMeshes[i].NumTriangles, &pMeshes[i].Hash );
+    }
+    if( FAILED( hr ) )
+    {
+        delete []pData;
+        return hr;
+    }
+
+    BYTE* pWrite = ( BYTE* )( pMeshes + NumMeshes );
+    for( UINT i = 0; i < NumMeshes; i++ )
+    {
+        SDKMeshWriteBVH( &m_pBVHs[i], pWrite );
+        pWrite += SDKMeshGetBVHSize( &m_pBVHs[i] );
+    }
+
+    HANDLE hFile = CreateFile( szFileName, FILE_WRITE_DATA, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+    {
+        hr = HRESULT_FROM_WIN32( GetLastError() );
+    }
+    else
+    {
+        DWORD dwBytesWritten = 0;
+        if( !WriteFile( hFile, pData, ( DWORD )Size, &dwBytesWritten, NULL ) || dwBytesWritten != ( DWORD )Size )
+            hr = E_FAIL;
+        CloseHandle( hFile );
+    }
+
+    delete []pData;
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// The file has to have been saved from this mesh: the mesh count and each mesh's
+// triangle count and hash have to match, and each hierarchy has to hold that many
+// triangles. A file that doesn't match fails with E_FAIL before the hierarchies there
+// are now are let go.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::LoadBVHs( LPCTSTR szFileName )
+{
+    if( !m_pMeshHeader )
+        return E_FAIL;
+
+    HRESULT hr = E_FAIL;
+    WCHAR strPath[MAX_PATH];
+    V_RETURN( DXUTFindDXSDKMediaFileCch( strPath, MAX_PATH, szFileName ) );
+
+    HANDLE hFile = CreateFile( strPath, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return DXUTERR_MEDIANOTFOUND;
+
+    LARGE_INTEGER FileSize;
+    BYTE* pData = NULL;
+    DWORD dwBytesRead = 0;
+    if( !GetFileSizeEx( hFile, &FileSize ) || FileSize.QuadPart < ( LONGLONG )sizeof( SDKMESH_BVH_FILE_HEADER ) ||
+        FileSize.QuadPart > 0xffffffff )
+        goto Error;
+
+    pData = new BYTE[ ( size_t )FileSize.QuadPart ];
+    if( !pData )
+    {
+        hr = E_OUTOFMEMORY;
+        goto Error;
+    }
+    if( !ReadFile( hFile, pData, ( DWORD )FileSize.QuadPart, &dwBytesRead, NULL ) ||
+        dwBytesRead != ( DWORD )FileSize.QuadPart )
+        goto Error;
+
+    {
+        SDKMESH_BVH_FILE_HEADER Header;
+        CopyMemory( &Header, pData, sizeof( SDKMESH_BVH_FILE_HEADER ) );
+        UINT64 Offset = sizeof( SDKMESH_BVH_FILE_HEADER ) + sizeof( SDKMESH_BVH_FILE_MESH ) * ( UINT64 )Header.NumMeshes;
+        if( Header.Magic != SDKMESH_BVH_FILE_MAGIC || Header.Version != SDKMESH_BVH_FILE_VERSION ||
+            Header.NumMeshes != m_pMeshHeader->NumMeshes || Offset > ( UINT64 )FileSize.QuadPart )
+            goto Error;
+
+        const SDKMESH_BVH_FILE_MESH* pMeshes = ( const SDKMESH_BVH_FILE_MESH* )( pData +
+                                                                                sizeof( SDKMESH_BVH_FILE_HEADER ) );
+        for( UINT i = 0; i < Header.NumMeshes; i++ )
+        {
+            UINT NumTriangles = 0;
+            UINT64 Hash = 0;
+            hr = GetBVHFingerprint( i, &NumTriangles, &Hash );
+            if( FAILED( hr ) )
+                goto Error;
+            hr = E_FAIL;
+            if( NumTriangles != pMeshes[i].NumTriangles || Hash != pMeshes[i].Hash )
+                goto Error;
+        }
+
+        DestroyBVHs();
+        m_pBVHs = new SDKMESH_BVH[ max( Header.NumMeshes, 1 ) ];
+        if( !m_pBVHs )
+        {
+            hr = E_OUTOFMEMORY;
+            goto Error;
+        }
+        ZeroMemory( m_pBVHs, sizeof( SDKMESH_BVH ) * max( Header.NumMeshes, 1 ) );
+
+        hr = S_OK;
+        for( UINT i = 0; i < Header.NumMeshes && SUCCEEDED( hr ); i++ )
+        {
+            UINT64 BytesRead = 0;
+            hr = SDKMeshReadBVH( pData + Offset, FileSize.QuadPart - Offset, &m_pBVHs[i], &BytesRead );
+            if( SUCCEEDED( hr ) && m_pBVHs[i].NumTriangles != pMeshes[i].NumTriangles )
+                hr = E_FAIL;
+            Offset += BytesRead;
+        }
+        if( FAILED( hr ) )
+            DestroyBVHs();
+    }
+
+Error:
+    SAFE_DELETE_ARRAY( pData );
+    CloseHandle( hFile );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// The level a frame's mesh is drawn at, or NULL for full detail. The frame's world
+// matrix is from the last TransformMesh or TransformBindPose; its largest axis scale
+// scales the bounds and the errors alike.
+//--------------------------------------------------------------------------------------
+const SDKMESH_LOD* CDXUTSDKMesh::GetFrameLOD( UINT iMesh, UINT iFrame )
+{
+    if( !m_bLODSelection || !m_pMeshLODs || m_pMeshLODs[iMesh] == 0 )
+        return NULL;
+
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+    D3DXVECTOR3 Center = pMesh->BoundingBoxCenter;
+    float Scale = 1.0f;
+    if( iFrame != INVALID_FRAME )
+    {
+        const D3DXMATRIX* pWorld = &m_pWorldPoseFrameMatrices[iFrame];
+        D3DXVec3TransformCoord( &Center, &pMesh->BoundingBoxCenter, pWorld );
+        float ScaleSq = max( max( pWorld->_11 * pWorld->_11 + pWorld->_12 * pWorld->_12 + pWorld->_13 * pWorld->_13,
+                                  pWorld->_21 * pWorld->_21 + pWorld->_22 * pWorld->_22 + pWorld->_23 * pWorld->_23 ),
+                             pWorld->_31 * pWorld->_31 + pWorld->_32 * pWorld->_32 + pWorld->_33 * pWorld->_33 );
+        Scale = sqrtf( ScaleSq );
+    }
+
+    D3DXVECTOR3 ToEye = m_vLODEye - Center;
+    if( Scale <= 0.0f )
+        return NULL;
+    float Distance = max( D3DXVec3Length( &ToEye ) - D3DXVec3Length( &pMesh->BoundingBoxExtents ) * Scale, 1e-4f );
+
+    UINT iLOD = SelectLOD( iMesh, Distance / Scale );
+    return ( iLOD > 0 ) ? &m_pLODs[iMesh * m_MaxLODs + iLOD - 1] : NULL;
+}
+
+//--------------------------------------------------------------------------------------
+// Adjacency indices. Each index buffer gets a twin twice its size, so a subset's
+// IndexStart and IndexCount double as RenderMesh expects. Triangle list subsets are
+// filled in by SDKMeshGenerateAdjacency in parallel; everything else has each index
+// written twice, which reads as "no neighbour" for the other adjacency topologies.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_ADJACENCY_JOB
+{
+    const BYTE* pPositions;     // already offset to the subset's VertexStart, or NULL
+    UINT PositionStride;
+    UINT MaxVertices;
+    const BYTE* pIndices;       // the first index of the job's range
+    BYTE* pAdjacency;           // its first adjacency index
+    UINT IndexType;
+    UINT NumIndices;
+    HRESULT hr;
+};
+
+static void CALLBACK GenerateSubsetAdjacency( UINT iJob, void* pContext )
+{
+    SDKMESH_ADJACENCY_JOB* pJob = &( ( SDKMESH_ADJACENCY_JOB* )pContext )[iJob];
+    if( pJob->NumIndices == 0 )
+        return;
+
+    UINT* pIndices = new UINT[ pJob->NumIndices ];
+    UINT* pAdjacency = new UINT[ pJob->NumIndices * 2 ];
+    if( !pIndices || !pAdjacency )
+    {
+        SAFE_DELETE_ARRAY( pIndices );
+        SAFE_DELETE_ARRAY( pAdjacency );
+        pJob->hr = E_OUTOFMEMORY;
+        return;
+    }
+
+    UINT NumVertices = 0;
+    for( UINT i = 0; i < pJob->NumIndices; i++ )
+    {
+        pIndices[i] = ( pJob->IndexType == IT_16BIT ) ? ( ( const WORD* )pJob->pIndices )[i] :
+            ( ( const UINT* )pJob->pIndices )[i];
+        NumVertices = max( NumVertices, pIndices[i] + 1 );
+    }
+
+    // Indices past the vertex buffer can't be welded, so match those by index
+    const BYTE* pPositions = ( NumVertices <= pJob->MaxVertices ) ? pJob->pPositions : NULL;
+    pJob->hr = SDKMeshGenerateAdjacency( pPositions, pJob->PositionStride, NumVertices, pIndices,
+                                         pJob->NumIndices, pAdjacency );
+    if( SUCCEEDED( pJob->hr ) )
+    {
+        for( UINT i = 0; i < pJob->NumIndices * 2; i++ )
+        {
+            if( pJob->IndexType == IT_16BIT )
+                ( ( WORD* )pJob->pAdjacency )[i] = ( WORD )pAdjacency[i];
+            else
+                ( ( UINT* )pJob->pAdjacency )[i] = pAdjacency[i];
+        }
+    }
+
+    delete []pIndices;
+    delete []pAdjacency;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateAdjacencyIndices( ID3D11Device* pd3dDevice )
+{
+    UINT NumIBs = m_pMeshHeader->NumIndexBuffers;
+    m_pAdjacencyIndexBufferArray = new SDKMESH_INDEX_BUFFER_HEADER[ NumIBs ];
+    BYTE** ppAdjacency = new BYTE*[ NumIBs ];
+    UINT NumJobs = 0;
+    for( UINT iMesh = 0; iMesh < m_pMeshHeader->NumMeshes; iMesh++ )
+        NumJobs += m_pMeshArray[iMesh].NumSubsets;
+    SDKMESH_ADJACENCY_JOB* pJobs = new SDKMESH_ADJACENCY_JOB[ max( NumJobs, 1 ) ];
+    SDKMESH_INDEX_RANGE* pRanges = new SDKMESH_INDEX_RANGE[ max( NumJobs, 1 ) ];
+    UINT64* pMergeKeys = new UINT64[ max( NumJobs, 1 ) ];
+    if( !m_pAdjacencyIndexBufferArray || !ppAdjacency || !pJobs || !pRanges || !pMergeKeys )
+    {
+        SAFE_DELETE_ARRAY( m_pAdjacencyIndexBufferArray );
+        SAFE_DELETE_ARRAY( ppAdjacency );
+        SAFE_DELETE_ARRAY( pJobs );
+        SAFE_DELETE_ARRAY( pRanges );
+        SAFE_DELETE_ARRAY( pMergeKeys );
+        return E_OUTOFMEMORY;
+    }
+    ZeroMemory( ppAdjacency, sizeof( BYTE* ) * NumIBs );
+    ZeroMemory( pJobs, sizeof( SDKMESH_ADJACENCY_JOB ) * max( NumJobs, 1 ) );
+    ZeroMemory( pRanges, sizeof( SDKMESH_INDEX_RANGE ) * max( NumJobs, 1 ) );
+    ZeroMemory( pMergeKeys, sizeof( UINT64 ) * max( NumJobs, 1 ) );
+
+    HRESULT hr = S_OK;
+    for( UINT i = 0; i < NumIBs; i++ )
+    {
+        SDKMESH_INDEX_BUFFER_HEADER* pIB = &m_pIndexBufferArray[i];
+        SDKMESH_INDEX_BUFFER_HEADER* pAdjIB = &m_pAdjacencyIndexBufferArray[i];
+        ZeroMemory( pAdjIB, sizeof( SDKMESH_INDEX_BUFFER_HEADER ) );
+        pAdjIB->NumIndices = pIB->NumIndices * 2;
+        pAdjIB->SizeBytes = pIB->SizeBytes * 2;
+        pAdjIB->IndexType = pIB->IndexType;
+
+        ppAdjacency[i] = new BYTE[ ( SIZE_T )pAdjIB->SizeBytes ];
+        if( !ppAdjacency[i] )
+        {
+            hr = E_OUTOFMEMORY;
+            break;
+        }
+
+        if( pIB->IndexType == IT_16BIT )
+        {
+            const WORD* pSrc = ( const WORD* )m_ppIndices[i];
+            WORD* pDest = ( WORD* )ppAdjacency[i];
+            for( UINT64 j = 0; j < pIB->NumIndices; j++ )
+                pDest[j * 2] = pDest[j * 2 + 1] = pSrc[j];
+        }
+        else
+        {
+            const UINT* pSrc = ( const UINT* )m_ppIndices[i];
+            UINT* pDest = ( UINT* )ppAdjacency[i];
+            for( UINT64 j = 0; j < pIB->NumIndices; j++ )
+                pDest[j * 2] = pDest[j * 2 + 1] = pSrc[j];
+        }
+    }
+
+    UINT iJob = 0;
+    for( UINT iMesh = 0; iMesh < m_pMeshHeader->NumMeshes && SUCCEEDED( hr ); iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        SDKMESH_INDEX_BUFFER_HEADER* pIB = &m_pIndexBufferArray[pMesh->IndexBuffer];
+
+        const BYTE* pPositions = NULL;
+        UINT PositionStride = 0;
+        UINT NumVertices = 0;
+        for( UINT i = 0; i < pMesh->NumVertexBuffers && !pPositions; i++ )
+        {
+            SDKMESH_VERTEX_BUFFER_HEADER* pVB = &m_pVertexBufferArray[ pMesh->VertexBuffers[i] ];
+            const D3DVERTEXELEMENT9* pElement = FindDeclElement( pVB->Decl, D3DDECLUSAGE_POSITION, D3DDECLTYPE_FLOAT3 );
+            if( pElement )
+            {
+                pPositions = m_ppVertices[ pMesh->VertexBuffers[i] ] + pElement->Offset;
+                PositionStride = ( UINT )pVB->StrideBytes;
+                NumVertices = ( UINT )pVB->NumVertices;
+            }
+        }
+
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+        {
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[ pMesh->pSubsets[i] ];
+            SDKMESH_ADJACENCY_JOB* pJob = &pJobs[iJob];
+            SDKMESH_INDEX_RANGE* pRange = &pRanges[iJob];
+            pMergeKeys[iJob++] = ( ( UINT64 )pMesh->VertexBuffers[0] << 32 ) | ( UINT )pSubset->VertexStart;
+            if( pSubset->PrimitiveType != PT_TRIANGLE_LIST ||
+                pSubset->IndexStart + pSubset->IndexCount > pIB->NumIndices )
+                continue;
+
+            if( pPositions && pSubset->VertexStart < NumVertices )
+            {
+                pJob->pPositions = pPositions + pSubset->VertexStart * PositionStride;
+                pJob->PositionStride = PositionStride;
+                pJob->MaxVertices = NumVertices - ( UINT )pSubset->VertexStart;
+            }
+            pJob->IndexType = pIB->IndexType;
+            pRange->iBuffer = pMesh->IndexBuffer;
+            pRange->IndexStart = pSubset->IndexStart;
+            pRange->IndexCount = pSubset->IndexCount;
+        }
+    }
+
+    // Each range of the adjacency buffer is written by one job only. Subsets sharing
+    // indices, such as one subset drawn by two meshes, become one job over all of them
+    // when they index the same vertices, so adjacency carries across from one to the
+    // other. Otherwise each job is clipped to the triangles no earlier one covers.
+    if( SUCCEEDED( hr ) )
+        hr = SDKMeshSplitIndexRanges( pRanges, NumJobs, pMergeKeys );
+    for( iJob = 0; iJob < NumJobs && SUCCEEDED( hr ); iJob++ )
+    {
+        SDKMESH_ADJACENCY_JOB* pJob = &pJobs[iJob];
+        const SDKMESH_INDEX_RANGE* pRange = &pRanges[iJob];
+        UINT IndexSize = ( pJob->IndexType == IT_16BIT ) ? sizeof( WORD ) : sizeof( UINT );
+        pJob->pIndices = m_ppIndices[pRange->iBuffer] + pRange->IndexStart * IndexSize;
+        pJob->pAdjacency = ppAdjacency[pRange->iBuffer] + pRange->IndexStart * 2 * IndexSize;
+        pJob->NumIndices = ( UINT )pRange->IndexCount;
+    }
+
+    if( SUCCEEDED( hr ) )
+    {
+        // Subsets that aren't triangle lists keep their doubled indices
+        DXUTParallelFor( NumJobs, GenerateSubsetAdjacency, pJobs );
+        for( iJob = 0; iJob < NumJobs; iJob++ )
+        {
+            if( FAILED( pJobs[iJob].hr ) )
+                hr = pJobs[iJob].hr;
+        }
+    }
+
+    for( UINT i = 0; i < NumIBs && SUCCEEDED( hr ); i++ )
+        hr = CreateIndexBuffer( pd3dDevice, &m_pAdjacencyIndexBufferArray[i], ppAdjacency[i] );
+
+    for( UINT i = 0; i < NumIBs; i++ )
+        SAFE_DELETE_ARRAY( ppAdjacency[i] );
+    SAFE_DELETE_ARRAY( ppAdjacency );
+    SAFE_DELETE_ARRAY( pJobs );
+    SAFE_DELETE_ARRAY( pRanges );
+    SAFE_DELETE_ARRAY( pMergeKeys );
+
+    if( FAILED( hr ) )
+    {
+        for( UINT i = 0; i < NumIBs; i++ )
+            SAFE_RELEASE( m_pAdjacencyIndexBufferArray[i].pIB11 );
+        SAFE_DELETE_ARRAY( m_pAdjacencyIndexBufferArray );
+    }
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// Index narrowing. A 32 bit index buffer is rewritten as 16 bit, in place, when every
+// index fits once each subset's lowest index is moved into its VertexStart (which is
+// only done where it's needed). 0xffff is kept out of range since it's a strip cut.
+// Subsets sharing indices with a different rebase, or drawn from two index buffers,
+// leave the buffer as it is.
+//--------------------------------------------------------------------------------------
+#define NARROW_UNCOVERED 0xffffffff
+#define NARROW_MAX_INDEX 0xfffe
+
+HRESULT CDXUTSDKMesh::NarrowIndexBuffers()
+{
+    UINT NumIBs = m_pMeshHeader->NumIndexBuffers;
+    UINT NumSubsets = m_pMeshHeader->NumTotalSubsets;
+    UINT* pSubsetIB = new UINT[ max( NumSubsets, 1 ) ];
+    bool* pNarrow = new bool[ max( NumIBs, 1 ) ];
+    if( !pSubsetIB || !pNarrow )
+    {
+        SAFE_DELETE_ARRAY( pSubsetIB );
+        SAFE_DELETE_ARRAY( pNarrow );
+        return E_OUTOFMEMORY;
+    }
+    memset( pSubsetIB, 0xff, sizeof( UINT ) * max( NumSubsets, 1 ) );
+    for( UINT i = 0; i < NumIBs; i++ )
+        pNarrow[i] = ( m_pIndexBufferArray[i].IndexType == IT_32BIT );
+
+    for( UINT iMesh = 0; iMesh < m_pMeshHeader->NumMeshes; iMesh++ )
+    {
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        for( UINT i = 0; i < pMesh->NumSubsets; i++ )
+        {
+            UINT* pIB = &pSubsetIB[ pMesh->pSubsets[i] ];
+            if( *pIB != NARROW_UNCOVERED && *pIB != pMesh->IndexBuffer )
+            {
+                pNarrow[*pIB] = false;
+                pNarrow[pMesh->IndexBuffer] = false;
+            }
+            *pIB = pMesh->IndexBuffer;
+        }
+    }
+
+    HRESULT hr = S_OK;
+    for( UINT iIB = 0; iIB < NumIBs && SUCCEEDED( hr ); iIB++ )
+    {
+        if( !pNarrow[iIB] )
+            continue;
+
+        // The rebase of every index, so overlaps are caught and uncovered indices checked
+        SDKMESH_INDEX_BUFFER_HEADER* pHeader = &m_pIndexBufferArray[iIB];
+        UINT* pIndices = ( UINT* )m_ppIndices[iIB];
+        UINT NumIndices = ( UINT )pHeader->NumIndices;
+        UINT* pBase = new UINT[ max( NumIndices, 1 ) ];
+        if( !pBase )
+        {
+            hr = E_OUTOFMEMORY;
+            break;
+        }
+        memset( pBase, 0xff, sizeof( UINT ) * max( NumIndices, 1 ) );
+
+        bool bFits = true;
+        for( UINT iSubset = 0; iSubset < NumSubsets && bFits; iSubset++ )
+        {
+            if( pSubsetIB[iSubset] != iIB )
+                continue;
+
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[iSubset];
+            if( pSubset->IndexStart + pSubset->IndexCount > NumIndices )
+            {
+                bFits = false;
+                break;
+            }
+
+            UINT64 MinIndex, MaxIndex;
+            GetSubsetIndexRange( pSubset, m_ppIndices[iIB], IT_32BIT, &MinIndex, &MaxIndex );
+            UINT Base = 0;
+            if( MaxIndex > NARROW_MAX_INDEX )
+                Base = ( UINT )MinIndex;
+            if( MaxIndex - Base > NARROW_MAX_INDEX )
+            {
+                bFits = false;
+                break;
+            }
+
+            for( UINT64 i = pSubset->IndexStart; i < pSubset->IndexStart + pSubset->IndexCount; i++ )
+            {
+                if( pBase[i] != NARROW_UNCOVERED && pBase[i] != Base )
+                {
+                    bFits = false;
+                    break;
+                }
+                pBase[i] = Base;
+            }
+        }
+
+        for( UINT i = 0; i < NumIndices && bFits; i++ )
+        {
+            if( pIndices[i] - ( ( pBase[i] == NARROW_UNCOVERED ) ? 0 : pBase[i] ) > NARROW_MAX_INDEX )
+                bFits = false;
+        }
+
+        if( bFits )
+        {
+            for( UINT i = 0; i < NumIndices; i++ )
+            {
+                if( pBase[i] != NARROW_UNCOVERED )
+                    pIndices[i] -= pBase[i];
+            }
+
+            for( UINT iSubset = 0; iSubset < NumSubsets; iSubset++ )
+            {
+                SDKMESH_SUBSET* pSubset = &m_pSubsetArray[iSubset];
+                if( pSubsetIB[iSubset] != iIB || pSubset->IndexCount == 0 )
+                    continue;
+
+                UINT Base = pBase[ pSubset->IndexStart ];
+                pSubset->VertexStart += Base;
+                if( pSubset->VertexCount > 0 )
+                    pSubset->VertexCount = ( pSubset->VertexCount > Base ) ? pSubset->VertexCount - Base : 0;
+            }
+
+            SDKMeshPackIndices16( pIndices, NumIndices, ( WORD* )pIndices );
+            pHeader->IndexType = IT_16BIT;
+            pHeader->SizeBytes = pHeader->NumIndices * sizeof( WORD );
+        }
+
+        delete []pBase;
+    }
+
+    SAFE_DELETE_ARRAY( pSubsetIB );
+    SAFE_DELETE_ARRAY( pNarrow );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// Vertex quantization. Each vertex buffer is packed on its own thread.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_QUANTIZE_JOB
+{
+    const SDKMESH_VERTEX_BUFFER_HEADER* pHeader;
+    const BYTE* pVertices;
+    SDKMESH_QUANTIZED_STREAM* pStream;
+    HRESULT hr;
+};
+
+static void CALLBACK QuantizeStream( UINT iJob, void* pContext )
+{
+    SDKMESH_QUANTIZE_JOB* pJob = &( ( SDKMESH_QUANTIZE_JOB* )pContext )[iJob];
+    pJob->hr = SDKMeshQuantizeStream( pJob->pHeader->Decl, ( UINT )pJob->pHeader->StrideBytes,
+                                      pJob->pHeader->NumVertices, pJob->pVertices, pJob->pStream );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::QuantizeVertexStreams()
+{
+    UINT NumVBs = m_pMeshHeader->NumVertexBuffers;
+    m_pQuantizedStreams = new SDKMESH_QUANTIZED_STREAM[ max( NumVBs, 1 ) ];
+    SDKMESH_QUANTIZE_JOB* pJobs = new SDKMESH_QUANTIZE_JOB[ max( NumVBs, 1 ) ];
+    if( !m_pQuantizedStreams || !pJobs )
+    {
+        SAFE_DELETE_ARRAY( m_pQuantizedStreams );
+        SAFE_DELETE_ARRAY( pJobs );
+        return E_OUTOFMEMORY;
+    }
+    ZeroMemory( m_pQuantizedStreams, sizeof( SDKMESH_QUANTIZED_STREAM ) * max( NumVBs, 1 ) );
+
+    for( UINT i = 0; i < NumVBs; i++ )
+    {
+        pJobs[i].pHeader = &m_pVertexBufferArray[i];
+        pJobs[i].pVertices = m_ppVertices[i];
+        pJobs[i].pStream = &m_pQuantizedStreams[i];
+        pJobs[i].hr = S_OK;
+    }
+    DXUTParallelFor( NumVBs, QuantizeStream, pJobs );
+
+    HRESULT hr = S_OK;
+    SDKMESH_QUANTIZATION_STATS* pStats = &m_QuantizationStats;
+    for( UINT i = 0; i < NumVBs; i++ )
+    {
+        SDKMESH_QUANTIZED_STREAM* pStream = &m_pQuantizedStreams[i];
+        if( FAILED( pJobs[i].hr ) )
+            hr = pJobs[i].hr;
+
+        pStats->BytesBefore += m_pVertexBufferArray[i].SizeBytes;
+        if( pJobs[i].hr != S_OK )
+        {
+            // Not packed; the buffer goes in as it is
+            SAFE_DELETE_ARRAY( pStream->pVertices );
+            ZeroMemory( pStream, sizeof( SDKMESH_QUANTIZED_STREAM ) );
+            pStats->BytesAfter += m_pVertexBufferArray[i].SizeBytes;
+            continue;
+        }
+
+        pStats->NumStreams++;
+        pStats->NumVertices += m_pVertexBufferArray[i].NumVertices;
+        pStats->BytesAfter += pStream->SizeBytes;
+        pStats->MaxPositionError = max( pStats->MaxPositionError, pStream->MaxPositionError );
+        pStats->MaxNormalError = max( pStats->MaxNormalError, pStream->MaxNormalError );
+        pStats->MaxTexCoordError = max( pStats->MaxTexCoordError, pStream->MaxTexCoordError );
+    }
+    SAFE_DELETE_ARRAY( pJobs );
+
+    if( FAILED( hr ) )
+    {
+        for( UINT i = 0; i < NumVBs; i++ )
+            SAFE_DELETE_ARRAY( m_pQuantizedStreams[i].pVertices );
+        SAFE_DELETE_ARRAY( m_pQuantizedStreams );
+        ZeroMemory( &m_QuantizationStats, sizeof( SDKMESH_QUANTIZATION_STATS ) );
+    }
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// out = a * b for row-vector matrices: each row of out is a's row dotted down b's rows
+//--------------------------------------------------------------------------------------
+static inline void MultiplyFrameMatrix( D3DXMATRIX* pOut, const D3DXMATRIX* pA, const D3DXMATRIX* pB )
+{
+    __m128 b0 = _mm_loadu_ps( &pB->_11 );
+    __m128 b1 = _mm_loadu_ps( &pB->_21 );
+    __m128 b2 = _mm_loadu_ps( &pB->_31 );
+    __m128 b3 = _mm_loadu_ps( &pB->_41 );
+
+    const float* pRowA = &pA->_11;
+    float* pRowOut = &pOut->_11;
+    for( UINT i = 0; i < 4; i++, pRowA += 4, pRowOut += 4 )
+    {
+        __m128 r = _mm_mul_ps( _mm_set1_ps( pRowA[0] ), b0 );
+        r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( pRowA[1] ), b1 ) );
+        r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( pRowA[2] ), b2 ) );
+        r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( pRowA[3] ), b3 ) );
+        _mm_storeu_ps( pRowOut, r );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Walks the child/sibling links from frame 0 with an explicit stack. Pushing the sibling
+// before the child puts every frame's descendants straight after it, so a frame plus
+// its later siblings and all their descendants is one contiguous range.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateFrameOrder()
+{
+    UINT NumFrames = m_pMeshHeader->NumFrames;
+    m_NumOrderedFrames = 0;
+    if( NumFrames == 0 )
+        return S_OK;
+
+    m_pFrameOrder = new UINT[ NumFrames ];
+    m_pFrameOrderParent = new UINT[ NumFrames ];
+    m_pFrameOrderEnd = new UINT[ NumFrames ];
+    m_pFrameOrderPos = new UINT[ NumFrames ];
+    m_pFrameOrderLocal = new D3DXMATRIX[ NumFrames ];
+    UINT* pStack = new UINT[ ( NumFrames * 2 + 1 ) * 2 ];
+    if( !m_pFrameOrder || !m_pFrameOrderParent || !m_pFrameOrderEnd || !m_pFrameOrderPos || !m_pFrameOrderLocal ||
+        !pStack )
+    {
+        SAFE_DELETE_ARRAY( pStack );
+        return E_OUTOFMEMORY;
+    }
+
+    // Each stack entry is a frame and its parent's position
+    for( UINT i = 0; i < NumFrames; i++ )
+        m_pFrameOrderPos[i] = INVALID_FRAME;
+
+    UINT StackSize = 0;
+    pStack[StackSize++] = 0;
+    pStack[StackSize++] = INVALID_FRAME;
+    while( StackSize > 0 )
+    {
+        UINT ParentPos = pStack[--StackSize];
+        UINT iFrame = pStack[--StackSize];
+
+        // Malformed links can't make the walk revisit a frame or overflow the stack
+        if( iFrame >= NumFrames || m_pFrameOrderPos[iFrame] != INVALID_FRAME )
+            continue;
+
+        UINT Pos = m_NumOrderedFrames++;
+        m_pFrameOrder[Pos] = iFrame;
+        m_pFrameOrderParent[Pos] = ParentPos;
+        m_pFrameOrderEnd[Pos] = Pos + 1;
+        m_pFrameOrderPos[iFrame] = Pos;
+
+        UINT iSibling = m_pFrameArray[iFrame].SiblingFrame;
+        UINT iChild = m_pFrameArray[iFrame].ChildFrame;
+        if( iSibling < NumFrames && m_pFrameOrderPos[iSibling] == INVALID_FRAME )
+        {
+            pStack[StackSize++] = iSibling;
+            pStack[StackSize++] = ParentPos;
+        }
+        if( iChild < NumFrames && m_pFrameOrderPos[iChild] == INVALID_FRAME )
+        {
+            pStack[StackSize++] = iChild;
+            pStack[StackSize++] = Pos;
+        }
+    }
+
+    // Parents come before their children, so one backwards pass pushes each subtree's
+    // end up to its root
+    for( UINT Pos = m_NumOrderedFrames; Pos-- > 0; )
+    {
+        UINT ParentPos = m_pFrameOrderParent[Pos];
+        if( ParentPos != INVALID_FRAME )
+            m_pFrameOrderEnd[ParentPos] = max( m_pFrameOrderEnd[ParentPos], m_pFrameOrderEnd[Pos] );
+    }
+
+    SAFE_DELETE_ARRAY( pStack );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// The positions covered by the old recursive traversal starting at iFrame: the frame,
+// its later siblings and everything below them
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::GetFrameOrderRange( UINT iFrame, UINT* pStart, UINT* pEnd )
+{
+    *pStart = *pEnd = 0;
+    if( !m_pFrameOrderPos || iFrame >= m_pMeshHeader->NumFrames || m_pFrameOrderPos[iFrame] == INVALID_FRAME )
+        return;
+
+    UINT Pos = m_pFrameOrderPos[iFrame];
+    UINT ParentPos = m_pFrameOrderParent[Pos];
+    *pStart = Pos;
+    *pEnd = ( ParentPos == INVALID_FRAME ) ? m_NumOrderedFrames : m_pFrameOrderEnd[ParentPos];
+}
+
+//--------------------------------------------------------------------------------------
+// transform bind pose frame in one pass over the flattened hierarchy
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformBindPoseFrame( UINT iFrame, D3DXMATRIX* pParentWorld )
+{
+    if( !m_pBindPoseFrameMatrices )
+        return;
+
+    // Gather the local matrices first; frames can be edited through GetFrame, so they
+    // aren't cached from load
+    UINT Start, End;
+    GetFrameOrderRange( iFrame, &Start, &End );
+    for( UINT Pos = Start; Pos < End; Pos++ )
+        m_pFrameOrderLocal[Pos] = m_pFrameArray[ m_pFrameOrder[Pos] ].Matrix;
+
+    for( UINT Pos = Start; Pos < End; Pos++ )
+    {
+        UINT ParentPos = m_pFrameOrderParent[Pos];
+        const D3DXMATRIX* pParent = ( ParentPos == INVALID_FRAME || ParentPos < Start ) ?
+            pParentWorld : &m_pBindPoseFrameMatrices[ m_pFrameOrder[ParentPos] ];
+        MultiplyFrameMatrix( &m_pBindPoseFrameMatrices[ m_pFrameOrder[Pos] ], &m_pFrameOrderLocal[Pos], pParent );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Keyframe blending. Orientations are ( x, y, z, w ) quaternions in one register; an
+// all-zero orientation in the file stands for the identity.
+//--------------------------------------------------------------------------------------
+static inline __m128 Dot4( __m128 a, __m128 b )
+{
+    __m128 m = _mm_mul_ps( a, b );
+    m = _mm_add_ps( m, _mm_movehl_ps( m, m ) );
+    m = _mm_add_ss( m, _mm_shuffle_ps( m, m, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+    return _mm_shuffle_ps( m, m, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+}
+
+static inline __m128 LoadKeyVector( const D3DXVECTOR3& v )
+{
+    return _mm_set_ps( 0.0f, v.z, v.y, v.x );
+}
+
+static inline __m128 LoadKeyOrientation( const SDKANIMATION_DATA* pKey )
+{
+    __m128 q = _mm_loadu_ps( &pKey->Orientation.x );
+    if( _mm_movemask_ps( _mm_cmpneq_ps( q, _mm_setzero_ps() ) ) == 0 )
+        return _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f );
+    return q;
+}
+
+static inline __m128 NormalizeQuaternion( __m128 q )
+{
+    __m128 LengthSq = Dot4( q, q );
+    if( _mm_cvtss_f32( LengthSq ) <= 0.0f )
+        return _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f );
+    return _mm_div_ps( q, _mm_sqrt_ps( LengthSq ) );
+}
+
+static __m128 InterpolateOrientation( __m128 q0, __m128 q1, float fBlend, SDKMESH_ANIMATION_INTERPOLATION Mode )
+{
+    // Take the short way round
+    __m128 Dot = Dot4( q0, q1 );
+    __m128 Flip = _mm_and_ps( _mm_cmplt_ps( Dot, _mm_setzero_ps() ), _mm_set1_ps( -0.0f ) );
+    q1 = _mm_xor_ps( q1, Flip );
+    float fDot = fabsf( _mm_cvtss_f32( Dot ) );
+
+    // Nearly parallel keys are blended linearly either way, which avoids dividing by a
+    // vanishing sine
+    if( Mode == SDKMESH_INTERPOLATE_SLERP && fDot < 0.9995f )
+    {
+        float fTheta = acosf( fDot );
+        float fInvSin = 1.0f / sinf( fTheta );
+        __m128 s0 = _mm_set1_ps( sinf( ( 1.0f - fBlend ) * fTheta ) * fInvSin );
+        __m128 s1 = _mm_set1_ps( sinf( fBlend * fTheta ) * fInvSin );
+        return NormalizeQuaternion( _mm_add_ps( _mm_mul_ps( q0, s0 ), _mm_mul_ps( q1, s1 ) ) );
+    }
+
+    __m128 t = _mm_set1_ps( fBlend );
+    return NormalizeQuaternion( _mm_add_ps( q0, _mm_mul_ps( _mm_sub_ps( q1, q0 ), t ) ) );
+}
+
+static inline __m128 LerpKeyVector( __m128 a, __m128 b, float fBlend )
+{
+    return _mm_add_ps( a, _mm_mul_ps( _mm_sub_ps( b, a ), _mm_set1_ps( fBlend ) ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Scale * rotation * translation for row vectors, written straight into the matrix: the
+// rotation rows scaled by S, with T in the last row. Same result as chaining
+// D3DXMatrixScaling, D3DXMatrixRotationQuaternion and D3DXMatrixTranslation.
+//--------------------------------------------------------------------------------------
+static void ComposeTRSMatrix( D3DXMATRIX* pOut, __m128 Scale, __m128 Rotation, __m128 Translation )
+{
+    float q[4], s[4], t[4];
+    _mm_storeu_ps( q, Rotation );
+    _mm_storeu_ps( s, Scale );
+    _mm_storeu_ps( t, Translation );
+
+    float x2 = q[0] + q[0], y2 = q[1] + q[1], z2 = q[2] + q[2];
+    float xx = q[0] * x2, yy = q[1] * y2, zz = q[2] * z2;
+    float xy = q[0] * y2, xz = q[0] * z2, yz = q[1] * z2;
+    float wx = q[3] * x2, wy = q[3] * y2, wz = q[3] * z2;
+
+    pOut->_11 = ( 1.0f - ( yy + zz ) ) * s[0];
+    pOut->_12 = ( xy + wz ) * s[0];
+    pOut->_13 = ( xz - wy ) * s[0];
+    pOut->_14 = 0.0f;
+    pOut->_21 = ( xy - wz ) * s[1];
+    pOut->_22 = ( 1.0f - ( xx + zz ) ) * s[1];
+    pOut->_23 = ( yz + wx ) * s[1];
+    pOut->_24 = 0.0f;
+    pOut->_31 = ( xz + wy ) * s[2];
+    pOut->_32 = ( yz - wx ) * s[2];
+    pOut->_33 = ( 1.0f - ( xx + yy ) ) * s[2];
+    pOut->_34 = 0.0f;
+    pOut->_41 = t[0];
+    pOut->_42 = t[1];
+    pOut->_43 = t[2];
+    pOut->_44 = 1.0f;
+}
+
+//--------------------------------------------------------------------------------------
+// Exporters that don't write scale leave it at zero, which is read as unit scale
+//--------------------------------------------------------------------------------------
+static inline __m128 FixKeyScale( __m128 Scale )
+{
+    __m128 IsZero = _mm_cmpeq_ps( Scale, _mm_setzero_ps() );
+    if( ( _mm_movemask_ps( IsZero ) & 7 ) == 7 )
+        return _mm_set1_ps( 1.0f );
+    return Scale;
+}
+
+//--------------------------------------------------------------------------------------
+// Playback loops over keys 1 to NumAnimationKeys - 1 (key 0 is the reference pose),
+// blending from the last key back into the first. With STEP interpolation this gives
+// the same key as GetAnimationKeyFromTime and a blend of zero.
+//--------------------------------------------------------------------------------------
+static void GetKeysFromTime( const SDKANIMATION_FILE_HEADER* pHeader, SDKMESH_ANIMATION_INTERPOLATION Interpolation,
+                             double fTime, UINT* piKey0, UINT* piKey1, float* pfBlend )
+{
+    *piKey0 = *piKey1 = 0;
+    *pfBlend = 0.0f;
+    if( pHeader == NULL || pHeader->NumAnimationKeys < 2 )
+        return;
+
+    UINT NumLoopKeys = pHeader->NumAnimationKeys - 1;
+    double fTick = pHeader->AnimationFPS * fTime;
+    double fWhole = floor( fTick );
+    double fLoop = fmod( fWhole, ( double )NumLoopKeys );
+    if( fLoop < 0.0 )
+        fLoop += NumLoopKeys;
+    UINT iTick = ( UINT )fLoop;
+
+    *piKey0 = iTick + 1;
+    if( Interpolation == SDKMESH_INTERPOLATE_STEP )
+    {
+        *piKey1 = *piKey0;
+        return;
+    }
+
+    *piKey1 = ( iTick + 1 ) % NumLoopKeys + 1;
+    *pfBlend = ( float )( fTick - fWhole );
+}
+
+//--------------------------------------------------------------------------------------
+// One key of one animated frame, from the compressed tracks when there are some
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::GetAnimationKey( UINT iAnimationData, UINT iKey, __m128* pTranslation, __m128* pRotation,
+                                    __m128* pScale )
+{
+    if( m_CompressedAnimation.pTracks )
+    {
+        SDKMeshSampleCompressedKey( &m_CompressedAnimation, iAnimationData, iKey, pTranslation, pRotation, pScale );
+        return;
+    }
+
+    const SDKANIMATION_DATA* pKey = &m_pAnimationFrameData[iAnimationData].pAnimationData[iKey];
+    *pTranslation = LoadKeyVector( pKey->Translation );
+    *pRotation = LoadKeyOrientation( pKey );
+    *pScale = LoadKeyVector( pKey->Scaling );
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::GetAnimatedLocalTransform( UINT iFrame, UINT iKey0, UINT iKey1, float fBlend,
+                                              D3DXMATRIX* pLocal )
+{
+    if( INVALID_ANIMATION_DATA != m_pFrameArray[iFrame].AnimationDataIndex )
+    {
+        UINT iAnimationData = m_pFrameArray[iFrame].AnimationDataIndex;
+        __m128 Translation0, Rotation0, Scale0;
+        __m128 Translation1, Rotation1, Scale1;
+        GetAnimationKey( iAnimationData, iKey0, &Translation0, &Rotation0, &Scale0 );
+        GetAnimationKey( iAnimationData, iKey1, &Translation1, &Rotation1, &Scale1 );
+
+        __m128 Rotation = InterpolateOrientation( Rotation0, Rotation1, fBlend, m_AnimationInterpolation );
+        __m128 Translation = LerpKeyVector( Translation0, Translation1, fBlend );
+        __m128 Scale = FixKeyScale( LerpKeyVector( Scale0, Scale1, fBlend ) );
+        ComposeTRSMatrix( pLocal, Scale, Rotation, Translation );
+    }
+    else
+    {
+        *pLocal = m_pFrameArray[iFrame].Matrix;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+static inline void SampleClipTrack( const SDKANIMATION_FRAME_DATA* pTrack, UINT iKey0, UINT iKey1, float fBlend,
+                                    SDKMESH_ANIMATION_INTERPOLATION Mode, __m128* pTranslation,
+                                    __m128* pRotation, __m128* pScale )
+{
+    const SDKANIMATION_DATA* pKey0 = &pTrack->pAnimationData[iKey0];
+    const SDKANIMATION_DATA* pKey1 = &pTrack->pAnimationData[iKey1];
+    *pRotation = InterpolateOrientation( LoadKeyOrientation( pKey0 ), LoadKeyOrientation( pKey1 ), fBlend, Mode );
+    *pTranslation = LerpKeyVector( LoadKeyVector( pKey0->Translation ), LoadKeyVector( pKey1->Translation ), fBlend );
+    *pScale = FixKeyScale( LerpKeyVector( LoadKeyVector( pKey0->Scaling ), LoadKeyVector( pKey1->Scaling ), fBlend ) );
+}
+
+//--------------------------------------------------------------------------------------
+// The local matrix of every ordered frame from a stack of layers. Each frame samples
+// its layers into registers and SDKMeshBlendLayerSamples blends them, so a single
+// matrix is built at the end and a layer costs little more than its keys.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::GetBlendedLocalTransforms( const SDKMESH_ANIMATION_LAYER* pLayers, UINT NumLayers,
+                                              D3DXMATRIX* pLocal )
+{
+    // The keys and blend factor are the same for every frame of a layer
+    UINT Key0[SDKMESH_MAX_ANIMATION_LAYERS], Key1[SDKMESH_MAX_ANIMATION_LAYERS];
+    float Blend[SDKMESH_MAX_ANIMATION_LAYERS];
+    for( UINT i = 0; i < NumLayers; i++ )
+        GetKeysFromTime( m_pAnimationClips[ pLayers[i].iClip ].pHeader, m_AnimationInterpolation, pLayers[i].fTime,
+                         &Key0[i], &Key1[i], &Blend[i] );
+
+    SDKMESH_LAYER_SAMPLE Samples[SDKMESH_MAX_ANIMATION_LAYERS];
+    for( UINT Pos = 0; Pos < m_NumOrderedFrames; Pos++ )
+    {
+        UINT iFrame = m_pFrameOrder[Pos];
+        UINT NumSamples = 0;
+        for( UINT i = 0; i < NumLayers; i++ )
+        {
+            const SDKMESH_ANIMATION_LAYER* pLayer = &pLayers[i];
+            const SDKMESH_ANIMATION_CLIP* pClip = &m_pAnimationClips[pLayer->iClip];
+            UINT iTrack = pClip->pFrameTracks[iFrame];
+            float fWeight = pLayer->fWeight * ( pLayer->pFrameWeights ? pLayer->pFrameWeights[iFrame] : 1.0f );
+            if( iTrack == INVALID_ANIMATION_DATA || fWeight <= 0.0f )
+                continue;
+
+            SDKMESH_LAYER_SAMPLE* pSample = &Samples[NumSamples++];
+            const SDKANIMATION_FRAME_DATA* pTrack = &pClip->pFrameData[iTrack];
+            SampleClipTrack( pTrack, Key0[i], Key1[i], Blend[i], m_AnimationInterpolation, &pSample->Translation,
+                             &pSample->Rotation, &pSample->Scale );
+            if( pLayer->bAdditive )
+                SampleClipTrack( pTrack, 0, 0, 0.0f, m_AnimationInterpolation, &pSample->RefTranslation,
+                                 &pSample->RefRotation, &pSample->RefScale );
+            pSample->fWeight = fWeight;
+            pSample->bAdditive = pLayer->bAdditive;
+        }
+
+        // Untouched frames keep their exact matrix rather than a rebuilt one
+        if( NumSamples == 0 )
+        {
+            pLocal[Pos] = m_pFrameArray[iFrame].Matrix;
+            continue;
+        }
+
+        __m128 Translation, Rotation, Scale;
+        SDKMeshBlendLayerSamples( Samples, NumSamples, &m_pFrameRestPose[iFrame], &Translation, &Rotation, &Scale );
+        ComposeTRSMatrix( &pLocal[Pos], Scale, Rotation, Translation );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// transform frame in one pass over the flattened hierarchy
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformFrame( UINT iFrame, D3DXMATRIX* pParentWorld, double fTime )
+{
+    // The keys and blend factor are the same for every frame
+    UINT iKey0, iKey1;
+    float fBlend;
+    GetAnimationKeysFromTime( fTime, &iKey0, &iKey1, &fBlend );
+
+    TransformFrameRange( iFrame, pParentWorld, iKey0, iKey1, fBlend, m_pFrameOrderLocal, m_pWorldPoseFrameMatrices,
+                         m_pTransformedFrameMatrices );
+}
+
+//--------------------------------------------------------------------------------------
+// The pose arrays are passed in so instances can keep their own. pLocal is scratch
+// space for NumFrames matrices.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformFrameRange( UINT iFrame, const D3DXMATRIX* pParentWorld, UINT iKey0, UINT iKey1,
+                                        float fBlend, D3DXMATRIX* pLocal, D3DXMATRIX* pWorldPose,
+                                        D3DXMATRIX* pTransformed )
+{
+    UINT Start, End;
+    GetFrameOrderRange( iFrame, &Start, &End );
+    for( UINT Pos = Start; Pos < End; Pos++ )
+        GetAnimatedLocalTransform( m_pFrameOrder[Pos], iKey0, iKey1, fBlend, &pLocal[Pos] );
+
+    ConcatenateFrameRange( Start, End, pParentWorld, pLocal, pWorldPose, pTransformed );
+}
+
+//--------------------------------------------------------------------------------------
+// Chains the local matrices of positions Start to End of the frame order down the
+// hierarchy, starting from pParentWorld
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::ConcatenateFrameRange( UINT Start, UINT End, const D3DXMATRIX* pParentWorld,
+                                          const D3DXMATRIX* pLocal, D3DXMATRIX* pWorldPose,
+                                          D3DXMATRIX* pTransformed )
+{
+    for( UINT Pos = Start; Pos < End; Pos++ )
+    {
+        UINT iCurrent = m_pFrameOrder[Pos];
+        UINT ParentPos = m_pFrameOrderParent[Pos];
+        const D3DXMATRIX* pParent = ( ParentPos == INVALID_FRAME || ParentPos < Start ) ?
+            pParentWorld : &pWorldPose[ m_pFrameOrder[ParentPos] ];
+
+        MultiplyFrameMatrix( &pWorldPose[iCurrent], &pLocal[Pos], pParent );
+        pTransformed[iCurrent] = pWorldPose[iCurrent];
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// transform frame assuming that it is an absolute transformation
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformFrameAbsolute( UINT iFrame, double fTime )
+{
+    UINT iKey0, iKey1;
+    float fBlend;
+    GetAnimationKeysFromTime( fTime, &iKey0, &iKey1, &fBlend );
+    TransformFrameAbsolute( iFrame, iKey0, iKey1, fBlend, m_pTransformedFrameMatrices );
+}
+
+void CDXUTSDKMesh::TransformFrameAbsolute( UINT iFrame, UINT iKey0, UINT iKey1, float fBlend,
+                                           D3DXMATRIX* pTransformed )
+{
+    D3DXMATRIX mTrans1;
+    D3DXMATRIX mRot1;
+    D3DXQUATERNION quat1;
+    D3DXMATRIX mInvTo;
+    D3DXMATRIX mFrom;
+
+    if( INVALID_ANIMATION_DATA != m_pFrameArray[iFrame].AnimationDataIndex )
+    {
+        UINT iAnimationData = m_pFrameArray[iFrame].AnimationDataIndex;
+        __m128 TranslationOrig, RotationOrig, ScaleOrig;
+        __m128 Translation0, Rotation0, Scale0;
+        __m128 Translation1, Rotation1, Scale1;
+        GetAnimationKey( iAnimationData, 0, &TranslationOrig, &RotationOrig, &ScaleOrig );
+        GetAnimationKey( iAnimationData, iKey0, &Translation0, &Rotation0, &Scale0 );
+        GetAnimationKey( iAnimationData, iKey1, &Translation1, &Rotation1, &Scale1 );
+
+        float Orig[4];
+        _mm_storeu_ps( Orig, TranslationOrig );
+        D3DXMatrixTranslation( &mTrans1, -Orig[0], -Orig[1], -Orig[2] );
+
+        _mm_storeu_ps( Orig, RotationOrig );
+        quat1.x = Orig[0];
+        quat1.y = Orig[1];
+        quat1.z = Orig[2];
+        quat1.w = Orig[3];
+        D3DXQuaternionInverse( &quat1, &quat1 );
+        D3DXMatrixRotationQuaternion( &mRot1, &quat1 );
+        mInvTo = mTrans1 * mRot1;
+
+        // Absolute transforms have never applied the key's scale
+        __m128 Rotation = InterpolateOrientation( Rotation0, Rotation1, fBlend, m_AnimationInterpolation );
+        __m128 Translation = LerpKeyVector( Translation0, Translation1, fBlend );
+        ComposeTRSMatrix( &mFrom, _mm_set1_ps( 1.0f ), Rotation, Translation );
+
+        D3DXMATRIX mOutput = mInvTo * mFrom;
+        pTransformed[iFrame] = mOutput;
+    }
+}
+
+#define MAX_D3D11_VERTEX_STREAMS D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT
+//--------------------------------------------------------------------------------------
+static D3D11_PRIMITIVE_TOPOLOGY GetAdjacentTopology11( D3D11_PRIMITIVE_TOPOLOGY PrimType )
+{
+    switch( PrimType )
+    {
+    case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST:
+        return D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST_ADJ;
+    case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP:
+        return D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP_ADJ;
+    case D3D11_PRIMITIVE_TOPOLOGY_LINELIST:
+        return D3D11_PRIMITIVE_TOPOLOGY_LINELIST_ADJ;
+    case D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP:
+        return D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP_ADJ;
+    }
+    return PrimType;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetMeshBuffers11( UINT iMesh, const SDKMESH_INDEX_BUFFER_HEADER* pIndexBuffer,
+                                     bool bVertexBuffers, ID3D11DeviceContext* pd3dDeviceContext )
+{
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+
+    if( bVertexBuffers )
+    {
+        UINT Strides[MAX_D3D11_VERTEX_STREAMS];
+        UINT Offsets[MAX_D3D11_VERTEX_STREAMS];
+        ID3D11Buffer* pVB[MAX_D3D11_VERTEX_STREAMS];
+
+        for( UINT64 i = 0; i < pMesh->NumVertexBuffers; i++ )
+        {
+            pVB[i] = m_pVertexBufferArray[ pMesh->VertexBuffers[i] ].pVB11;
+            Strides[i] = GetBufferStride( pMesh->VertexBuffers[i] );
+            Offsets[i] = 0;
+        }
+        pd3dDeviceContext->IASetVertexBuffers( 0, pMesh->NumVertexBuffers, pVB, Strides, Offsets );
+    }
+
+    DXGI_FORMAT ibFormat = DXGI_FORMAT_R16_UINT;
+    switch( pIndexBuffer->IndexType )
+    {
+    case IT_16BIT:
+        ibFormat = DXGI_FORMAT_R16_UINT;
+        break;
+    case IT_32BIT:
+        ibFormat = DXGI_FORMAT_R32_UINT;
+        break;
+    };
+
+    pd3dDeviceContext->IASetIndexBuffer( pIndexBuffer->pIB11, ibFormat, 0 );
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::RenderMesh( UINT iMesh,
+                               bool bAdjacent,
+                               ID3D11DeviceContext* pd3dDeviceContext,
+                               UINT iDiffuseSlot,
+                               UINT iNormalSlot,
+                               UINT iSpecularSlot,
+                               UINT iFrame )
+{
+    if( 0 < GetOutstandingBufferResources() )
+        return;
+
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+
+    if( pMesh->NumVertexBuffers > MAX_D3D11_VERTEX_STREAMS )
+        return;
+
+    // No adjacency was built, as with lazy buffers
+    if( bAdjacent && !m_pAdjacencyIndexBufferArray )
+        return;
+
+    if( m_Residency.pMeshResident && !m_Residency.pMeshResident[iMesh] && FAILED( PrefetchMesh( iMesh ) ) )
+        return;
+
+    // Adjacency is only built for the full detail indices
+    const SDKMESH_LOD* pLOD = bAdjacent ? NULL : GetFrameLOD( iMesh, iFrame );
+
+    SDKMESH_INDEX_BUFFER_HEADER* pIndexBuffer;
+    if( pLOD )
+        pIndexBuffer = ( SDKMESH_INDEX_BUFFER_HEADER* )&pLOD->IndexBuffer;
+    else if( bAdjacent )
+        pIndexBuffer = &m_pAdjacencyIndexBufferArray[ pMesh->IndexBuffer ];
+    else
+        pIndexBuffer = &m_pIndexBufferArray[ pMesh->IndexBuffer ];
+
+    SetMeshBuffers11( iMesh, pIndexBuffer, true, pd3dDeviceContext );
+
+    SDKMESH_SUBSET* pSubset = NULL;
+    SDKMESH_MATERIAL* pMat = NULL;
+    D3D11_PRIMITIVE_TOPOLOGY PrimType;
+
+    for( UINT subset = 0; subset < pMesh->NumSubsets; subset++ )
+    {
+        if( iFrame != INVALID_FRAME && !IsSubsetVisible( iFrame, subset ) )
+            continue;
+
+        pSubset = &m_pSubsetArray[ pMesh->pSubsets[subset] ];
+
+        PrimType = GetPrimitiveType11( ( SDKMESH_PRIMITIVE_TYPE )pSubset->PrimitiveType );
+        if( bAdjacent )
+            PrimType = GetAdjacentTopology11( PrimType );
+
+        pd3dDeviceContext->IASetPrimitiveTopology( PrimType );
+
+        pMat = &m_pMaterialArray[ pSubset->MaterialID ];
+        if( iDiffuseSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pDiffuseRV11 ) )
+            pd3dDeviceContext->PSSetShaderResources( iDiffuseSlot, 1, &pMat->pDiffuseRV11 );
+        if( iNormalSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pNormalRV11 ) )
+            pd3dDeviceContext->PSSetShaderResources( iNormalSlot, 1, &pMat->pNormalRV11 );
+        if( iSpecularSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pSpecularRV11 ) )
+            pd3dDeviceContext->PSSetShaderResources( iSpecularSlot, 1, &pMat->pSpecularRV11 );
+
+        UINT IndexCount = ( UINT )pSubset->IndexCount;
+        UINT IndexStart = ( UINT )pSubset->IndexStart;
+        UINT VertexStart = ( UINT )pSubset->VertexStart;
+        if( pLOD )
+        {
+            IndexStart = pLOD->pSubsetIndices[subset * 2];
+            IndexCount = pLOD->pSubsetIndices[subset * 2 + 1];
+        }
+        if( bAdjacent )
+        {
+            IndexCount *= 2;
+            IndexStart *= 2;
+        }
+
+        pd3dDeviceContext->DrawIndexed( IndexCount, IndexStart, VertexStart );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// RenderMesh at full detail for NumInstances copies; the instance stream is already set
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::RenderMeshInstanced( UINT iMesh,
+                                        UINT NumInstances,
+                                        ID3D11DeviceContext* pd3dDeviceContext,
+                                        UINT iDiffuseSlot,
+                                        UINT iNormalSlot,
+                                        UINT iSpecularSlot )
+{
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+
+    if( pMesh->NumVertexBuffers > MAX_D3D11_VERTEX_STREAMS )
+        return;
+
+    if( m_Residency.pMeshResident && !m_Residency.pMeshResident[iMesh] && FAILED( PrefetchMesh( iMesh ) ) )
+        return;
+
+    SetMeshBuffers11( iMesh, &m_pIndexBufferArray[ pMesh->IndexBuffer ], true, pd3dDeviceContext );
+
+    for( UINT subset = 0; subset < pMesh->NumSubsets; subset++ )
+    {
+        SDKMESH_SUBSET* pSubset = &m_pSubsetArray[ pMesh->pSubsets[subset] ];
+
+        pd3dDeviceContext->IASetPrimitiveTopology( GetPrimitiveType11( ( SDKMESH_PRIMITIVE_TYPE )
+                                                                       pSubset->PrimitiveType ) );
+
+        SDKMESH_MATERIAL* pMat = &m_pMaterialArray[ pSubset->MaterialID ];
+        if( iDiffuseSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pDiffuseRV11 ) )
+            pd3dDeviceContext->PSSetShaderResources( iDiffuseSlot, 1, &pMat->pDiffuseRV11 );
+        if( iNormalSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pNormalRV11 ) )
+            pd3dDeviceContext->PSSetShaderResources( iNormalSlot, 1, &pMat->pNormalRV11 );
+        if( iSpecularSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pSpecularRV11 ) )
+            pd3dDeviceContext->PSSetShaderResources( iSpecularSlot, 1, &pMat->pSpecularRV11 );
+
+        pd3dDeviceContext->DrawIndexedInstanced( ( UINT )pSubset->IndexCount, NumInstances,
+                                                 ( UINT )pSubset->IndexStart, ( INT )pSubset->VertexStart, 0 );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::RenderFrame( UINT iFrame,
+                                bool bAdjacent,
+                                ID3D11DeviceContext* pd3dDeviceContext,
+                                UINT iDiffuseSlot,
+                                UINT iNormalSlot,
+                                UINT iSpecularSlot )
+{
+    if( !m_pStaticMeshData || !m_pFrameArray )
+        return;
+
+    if( m_pFrameArray[iFrame].Mesh != INVALID_MESH && IsMeshVisible( iFrame ) )
+    {
+        RenderMesh( m_pFrameArray[iFrame].Mesh,
+                    bAdjacent,
+                    pd3dDeviceContext,
+                    iDiffuseSlot,
+                    iNormalSlot,
+                    iSpecularSlot,
+                    iFrame );
+    }
+
+    // Render our children
+    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
+        RenderFrame( m_pFrameArray[iFrame].ChildFrame, bAdjacent, pd3dDeviceContext, iDiffuseSlot, 
+                     iNormalSlot, iSpecularSlot );
+
+    // Render our siblings
+    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
+        RenderFrame( m_pFrameArray[iFrame].SiblingFrame, bAdjacent, pd3dDeviceContext, iDiffuseSlot, 
+                     iNormalSlot, iSpecularSlot );
+}
+
+//--------------------------------------------------------------------------------------
+// Frames are visited in m_pFrameOrder, which is the order RenderFrame( 0 ) walks them
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::GatherDraws( SDKMESH_DRAW_LIST* pList, bool bAdjacent )
+{
+    if( !pList || !pList->pRecords )
+        return E_INVALIDARG;
+
+    SDKMeshResetDrawList( pList );
+    if( !m_pStaticMeshData || !m_pFrameArray || !m_pFrameOrder )
+        return E_FAIL;
+    if( bAdjacent && !m_pAdjacencyIndexBufferArray )
+        return E_FAIL;
+
+    HRESULT hr;
+    for( UINT iPos = 0; iPos < m_NumOrderedFrames; iPos++ )
+    {
+        UINT iFrame = m_pFrameOrder[iPos];
+        UINT iMesh = m_pFrameArray[iFrame].Mesh;
+        if( iMesh == INVALID_MESH || !IsMeshVisible( iFrame ) )
+            continue;
+
+        SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+        if( pMesh->NumVertexBuffers > MAX_D3D11_VERTEX_STREAMS )
+            continue;
+
+        const SDKMESH_LOD* pLOD = bAdjacent ? NULL : GetFrameLOD( iMesh, iFrame );
+
+        SDKMESH_DRAW_RECORD Record;
+        Record.Key = 0;
+        Record.iMesh = iMesh;
+        if( bAdjacent )
+            Record.iLOD = SDKMESH_DRAW_ADJACENCY;
+        else
+            Record.iLOD = pLOD ? ( UINT )( pLOD - &m_pLODs[iMesh * m_MaxLODs] ) + 1 : 0;
+
+        for( UINT subset = 0; subset < pMesh->NumSubsets; subset++ )
+        {
+            if( !IsSubsetVisible( iFrame, subset ) )
+                continue;
+
+            SDKMESH_SUBSET* pSubset = &m_pSubsetArray[ pMesh->pSubsets[subset] ];
+            D3D11_PRIMITIVE_TOPOLOGY PrimType = GetPrimitiveType11( ( SDKMESH_PRIMITIVE_TYPE )pSubset->PrimitiveType );
+            if( bAdjacent )
+                PrimType = GetAdjacentTopology11( PrimType );
+
+            Record.iMaterial = pSubset->MaterialID;
+            Record.Topology = PrimType;
+            Record.IndexCount = ( UINT )pSubset->IndexCount;
+            Record.IndexStart = ( UINT )pSubset->IndexStart;
+            Record.VertexStart = ( UINT )pSubset->VertexStart;
+            if( pLOD )
+            {
+                Record.IndexStart = pLOD->pSubsetIndices[subset * 2];
+                Record.IndexCount = pLOD->pSubsetIndices[subset * 2 + 1];
+            }
+            if( bAdjacent )
+            {
+                Record.IndexCount *= 2;
+                Record.IndexStart *= 2;
+            }
+
+            V_RETURN( SDKMeshAddDrawRecord( pList, &Record ) );
+        }
+    }
+
+    return SDKMeshBuildDrawCommands( pList );
+}
+
+//--------------------------------------------------------------------------------------
+// Vertex buffers are only set again when the mesh changes, not just its LOD, and a
+// texture already bound to its slot isn't bound again. Draws with no material leave
+// the textures as they are.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::ExecuteDrawList( const SDKMESH_DRAW_LIST* pList,
+                                    ID3D11DeviceContext* pd3dDeviceContext,
+                                    UINT iDiffuseSlot,
+                                    UINT iNormalSlot,
+                                    UINT iSpecularSlot,
+                                    SDKMESH_DRAW_EXECUTE_STATS* pStats )
+{
+    SDKMESH_DRAW_EXECUTE_STATS Stats;
+    ZeroMemory( &Stats, sizeof( SDKMESH_DRAW_EXECUTE_STATS ) );
+
+    if( pList && 0 == GetOutstandingBufferResources() )
+    {
+        UINT Slots[3] = { iDiffuseSlot, iNormalSlot, iSpecularSlot };
+        ID3D11ShaderResourceView* pBound[3] = { NULL, NULL, NULL };
+        bool bBound[3] = { false, false, false };
+        UINT iBoundMesh = INVALID_MESH;
+        bool bSkipDraws = false;
+
+        for( UINT i = 0; i < pList->NumCommands; i++ )
+        {
+            const SDKMESH_DRAW_COMMAND* pCommand = &pList->pCommands[i];
+            switch( pCommand->Op )
+            {
+            case SDKMESH_DRAW_SET_BUFFERS:
+            {
+                UINT iMesh = pCommand->Args[0];
+                UINT iLOD = pCommand->Args[1];
+                SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+
+                // A mesh whose buffers can't be created skips its draws
+                bSkipDraws = m_Residency.pMeshResident && !m_Residency.pMeshResident[iMesh] && FAILED( PrefetchMesh( iMesh ) );
+                if( bSkipDraws )
+                {
+                    iBoundMesh = INVALID_MESH;
+                    break;
+                }
+
+                // So does one recorded with an LOD or adjacency buffer it doesn't have. The
+                // buffers bound before stay bound, so iBoundMesh is left as it is.
+                const SDKMESH_INDEX_BUFFER_HEADER* pIndexBuffer = NULL;
+                if( iLOD == SDKMESH_DRAW_ADJACENCY )
+                {
+                    if( m_pAdjacencyIndexBufferArray )
+                        pIndexBuffer = &m_pAdjacencyIndexBufferArray[ pMesh->IndexBuffer ];
+                }
+                else if( iLOD > 0 )
+                {
+                    const SDKMESH_LOD* pLOD = GetLOD( iMesh, iLOD );
+                    if( pLOD )
+                        pIndexBuffer = &pLOD->IndexBuffer;
+                }
+                else
+                    pIndexBuffer = &m_pIndexBufferArray[ pMesh->IndexBuffer ];
+
+                bSkipDraws = ( pIndexBuffer == NULL );
+                if( bSkipDraws )
+                    break;
+
+                SetMeshBuffers11( iMesh, pIndexBuffer, iMesh != iBoundMesh, pd3dDeviceContext );
+                if( iMesh != iBoundMesh )
+                    Stats.NumVertexBufferSets++;
+                Stats.NumIndexBufferSets++;
+                iBoundMesh = iMesh;
+                break;
+            }
+
+            case SDKMESH_DRAW_SET_TOPOLOGY:
+                pd3dDeviceContext->IASetPrimitiveTopology( ( D3D11_PRIMITIVE_TOPOLOGY )pCommand->Args[0] );
+                Stats.NumTopologySets++;
+                break;
+
+            case SDKMESH_DRAW_SET_MATERIAL:
+            {
+                if( pCommand->Args[0] == INVALID_MATERIAL )
+                    break;
+
+                SDKMESH_MATERIAL* pMat = &m_pMaterialArray[ pCommand->Args[0] ];
+                ID3D11ShaderResourceView* pViews[3] = { pMat->pDiffuseRV11, pMat->pNormalRV11, pMat->pSpecularRV11 };
+                for( UINT s = 0; s < 3; s++ )
+                {
+                    if( Slots[s] == INVALID_SAMPLER_SLOT || IsErrorResource( pViews[s] ) )
+                        continue;
+                    if( bBound[s] && pBound[s] == pViews[s] )
+                        continue;
+
+                    pd3dDeviceContext->PSSetShaderResources( Slots[s], 1, &pViews[s] );
+                    pBound[s] = pViews[s];
+                    bBound[s] = true;
+                    Stats.NumShaderResourceSets++;
+                }
+                break;
+            }
+
+            case SDKMESH_DRAW_INDEXED:
+                if( bSkipDraws )
+                    break;
+                pd3dDeviceContext->DrawIndexed( pCommand->Args[0], pCommand->Args[1], pCommand->Args[2] );
+                Stats.NumDraws++;
+                break;
+            }
+        }
+    }
+
+    if( pStats )
+        *pStats = Stats;
+}
+
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::RenderMesh( UINT iMesh,
+                               LPDIRECT3DDEVICE9 pd3dDevice,
+                               LPD3DXEFFECT pEffect,
+                               D3DXHANDLE hTechnique,
+                               D3DXHANDLE htxDiffuse,
+                               D3DXHANDLE htxNormal,
+                               D3DXHANDLE htxSpecular,
+                               UINT iFrame )
+{
+    if( 0 < GetOutstandingBufferResources() )
+        return;
+
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+
+    if( m_Residency.pMeshResident && !m_Residency.pMeshResident[iMesh] && FAILED( PrefetchMesh( iMesh ) ) )
+        return;
+
+    // set vb streams
+    for( UINT i = 0; i < ( UINT )pMesh->NumVertexBuffers; i++ )
+    {
+        pd3dDevice->SetStreamSource( i,
+                                     m_pVertexBufferArray[ pMesh->VertexBuffers[i] ].pVB9,
+                                     0,
+                                     GetBufferStride( pMesh->VertexBuffers[i] ) );
+    }
+
+    // Set our index buffer as well
+    const SDKMESH_LOD* pLOD = GetFrameLOD( iMesh, iFrame );
+    if( pLOD )
+        pd3dDevice->SetIndices( pLOD->IndexBuffer.pIB9 );
+    else
+        pd3dDevice->SetIndices( m_pIndexBufferArray[ pMesh->IndexBuffer ].pIB9 );
+
+    // Render the scene with this technique 
+    pEffect->SetTechnique( hTechnique );
+
+    SDKMESH_SUBSET* pSubset = NULL;
+    SDKMESH_MATERIAL* pMat = NULL;
+    D3DPRIMITIVETYPE PrimType;
+    UINT cPasses = 0;
+    pEffect->Begin( &cPasses, 0 );
+
+    for( UINT p = 0; p < cPasses; ++p )
+    {
+        pEffect->BeginPass( p );
+
+        for( UINT subset = 0; subset < pMesh->NumSubsets; subset++ )
+        {
+            if( iFrame != INVALID_FRAME && !IsSubsetVisible( iFrame, subset ) )
+                continue;
+
+            pSubset = &m_pSubsetArray[ pMesh->pSubsets[subset] ];
+
+            PrimType = GetPrimitiveType9( ( SDKMESH_PRIMITIVE_TYPE )pSubset->PrimitiveType );
+
+            if( INVALID_MATERIAL != pSubset->MaterialID && m_pMeshHeader->NumMaterials > 0 )
+            {
+                pMat = &m_pMaterialArray[ pSubset->MaterialID ];
+                if( htxDiffuse && !IsErrorResource( pMat->pDiffuseTexture9 ) )
+                    pEffect->SetTexture( htxDiffuse, pMat->pDiffuseTexture9 );
+                if( htxNormal && !IsErrorResource( pMat->pNormalTexture9 ) )
+                    pEffect->SetTexture( htxNormal, pMat->pNormalTexture9 );
+                if( htxSpecular && !IsErrorResource( pMat->pSpecularTexture9 ) )
+                    pEffect->SetTexture( htxSpecular, pMat->pSpecularTexture9 );
+            }
+
+            pEffect->CommitChanges();
+
+            UINT PrimCount = ( UINT )pSubset->IndexCount;
+            UINT IndexStart = ( UINT )pSubset->IndexStart;
+            UINT VertexStart = ( UINT )pSubset->VertexStart;
+            UINT VertexCount = ( UINT )pSubset->VertexCount;
+            if( pLOD )
+            {
+                IndexStart = pLOD->pSubsetIndices[subset * 2];
+                PrimCount = pLOD->pSubsetIndices[subset * 2 + 1];
+                if( PrimCount == 0 )
+                    continue;
+            }
+            if( D3DPT_TRIANGLELIST == PrimType )
+                PrimCount /= 3;
+            if( D3DPT_LINELIST == PrimType )
+                PrimCount /= 2;
+            if( D3DPT_TRIANGLESTRIP == PrimType )
+                PrimCount = ( PrimCount - 3 ) + 1;
+            if( D3DPT_LINESTRIP == PrimType )
+                PrimCount -= 1;
+
+            pd3dDevice->DrawIndexedPrimitive( PrimType, VertexStart, 0, VertexCount, IndexStart, PrimCount );
+        }
+
+        pEffect->EndPass();
+    }
+
+    pEffect->End();
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::RenderFrame( UINT iFrame,
+                                LPDIRECT3DDEVICE9 pd3dDevice,
+                                LPD3DXEFFECT pEffect,
+                                D3DXHANDLE hTechnique,
+                                D3DXHANDLE htxDiffuse,
+                                D3DXHANDLE htxNormal,
+                                D3DXHANDLE htxSpecular )
+{
+    if( !m_pStaticMeshData || !m_pFrameArray )
+        return;
+
+    if( m_pFrameArray[iFrame].Mesh != INVALID_MESH && IsMeshVisible( iFrame ) )
+    {
+        RenderMesh( m_pFrameArray[iFrame].Mesh,
+                    pd3dDevice,
+                    pEffect,
+                    hTechnique,
+                    htxDiffuse,
+                    htxNormal,
+                    htxSpecular,
+                    iFrame );
+    }
+
+    // Render our children
+    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
+        RenderFrame( m_pFrameArray[iFrame].ChildFrame, pd3dDevice, pEffect, hTechnique, htxDiffuse, htxNormal,
+                     htxSpecular );
+
+    // Render our siblings
+    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
+        RenderFrame( m_pFrameArray[iFrame].SiblingFrame, pd3dDevice, pEffect, hTechnique, htxDiffuse, htxNormal,
+                     htxSpecular );
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTSDKMesh::CDXUTSDKMesh() : m_NumOutstandingResources( 0 ),
+                               m_NumInstances( 0 ),
+                               m_bLoading( false ),
+                               m_hFile( 0 ),
+                               m_hFileMappingObject( 0 ),
+                               m_MappedBytes( 0 ),
+                               m_pMeshHeader( NULL ),
+                               m_pStaticMeshData( NULL ),
+                               m_pHeapData( NULL ),
+                               m_pAdjacencyIndexBufferArray( NULL ),
+                               m_pAnimationData( NULL ),
+                               m_pAnimationHeader( NULL ),
+                               m_AnimationInterpolation( SDKMESH_INTERPOLATE_NLERP ),
+                               m_ppVertices( NULL ),
+                               m_ppIndices( NULL ),
+                               m_pAnimationClips( NULL ),
+                               m_NumAnimationClips( 0 ),
+                               m_pFrameRestPose( NULL ),
+                               m_pBindPoseFrameMatrices( NULL ),
+                               m_pTransformedFrameMatrices( NULL ),
+                               m_pWorldPoseFrameMatrices( NULL ),
+                               m_pSubsetBounds( NULL ),
+                               m_NumOrderedFrames( 0 ),
+                               m_pFrameOrder( NULL ),
+                               m_pFrameOrderParent( NULL ),
+                               m_pFrameOrderEnd( NULL ),
+                               m_pFrameOrderPos( NULL ),
+                               m_pFrameOrderLocal( NULL ),
+                               m_pFrameCullBox( NULL ),
+                               m_pVisibleBits( NULL ),
+                               m_bCullBoxesLocal( false ),
+                               m_bCullingActive( false ),
+                               m_bOptimizeOnLoad( false ),
+                               m_bNarrowIndicesOnLoad( false ),
+                               m_bQuantizeOnLoad( false ),
+                               m_pQuantizedStreams( NULL ),
+                               m_bAsyncTexturesOnLoad( true ),
+                               m_pTextureLoader( NULL ),
+                               m_pLODs( NULL ),
+                               m_pMeshLODs( NULL ),
+                               m_MaxLODs( 0 ),
+                               m_bLODSelection( false ),
+                               m_fLODPixelsPerUnit( 0.0f ),
+                               m_fLODMaxPixelError( 1.0f ),
+                               m_pBVHs( NULL ),
+                               m_bLazyBuffersOnLoad( false ),
+                               m_pDev9( NULL ),
+							   m_pDev11( NULL )
+{
+    ZeroMemory( &m_CullBoxes, sizeof( SDKMESH_CULL_BOXES ) );
+    ZeroMemory( &m_CompressedAnimation, sizeof( SDKMESH_COMPRESSED_ANIMATION ) );
+    ZeroMemory( &m_VertexCacheStats, sizeof( SDKMESH_VERTEX_CACHE_STATS ) );
+    ZeroMemory( &m_QuantizationStats, sizeof( SDKMESH_QUANTIZATION_STATS ) );
+    ZeroMemory( &m_TextureLoadStats, sizeof( SDKMESH_TEXTURE_LOAD_STATS ) );
+    ZeroMemory( &m_LoadLODSettings, sizeof( SDKMESH_LOD_SETTINGS ) );
+    ZeroMemory( &m_vLODEye, sizeof( D3DXVECTOR3 ) );
+    ZeroMemory( &m_InstanceRing, sizeof( SDKMESH_INSTANCE_RING ) );
+    ZeroMemory( &m_FrameIndex, sizeof( SDKMESH_FRAME_INDEX ) );
+    ZeroMemory( &m_Residency, sizeof( SDKMESH_RESIDENCY ) );
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTSDKMesh::~CDXUTSDKMesh()
+{
+    Destroy();
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::UnmapFile()
+{
+    for( int i = 0; i < m_MappedPointers.GetSize(); i++ )
+        SDKMeshUnmapFileView( NULL, m_MappedPointers[i], m_MappedBytes );
+    m_MappedPointers.RemoveAll();
+
+    if( m_hFileMappingObject )
+        CloseHandle( m_hFileMappingObject );
+    m_hFileMappingObject = 0;
+    m_MappedBytes = 0;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::Create( ID3D11Device* pDev11, LPCTSTR szFileName, bool bCreateAdjacencyIndices,
+                              SDKMESH_CALLBACKS11* pLoaderCallbacks )
+{
+    return CreateFromFile( pDev11,  NULL, szFileName, bCreateAdjacencyIndices, pLoaderCallbacks,  NULL );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::Create( IDirect3DDevice9* pDev9, LPCTSTR szFileName, bool bCreateAdjacencyIndices,
+                              SDKMESH_CALLBACKS9* pLoaderCallbacks )
+{
+    return CreateFromFile( NULL,  pDev9, szFileName, bCreateAdjacencyIndices, NULL,  pLoaderCallbacks );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::Create( ID3D11Device* pDev11, BYTE* pData, UINT DataBytes, bool bCreateAdjacencyIndices,
+                              bool bCopyStatic, SDKMESH_CALLBACKS11* pLoaderCallbacks )
+{
+    return CreateFromMemory( pDev11, NULL, pData, DataBytes, bCreateAdjacencyIndices, bCopyStatic,
+                             pLoaderCallbacks,  NULL );
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::Create( IDirect3DDevice9* pDev9, BYTE* pData, UINT DataBytes, bool bCreateAdjacencyIndices,
+                              bool bCopyStatic, SDKMESH_CALLBACKS9* pLoaderCallbacks )
+{
+    return CreateFromMemory( NULL, pDev9, pData, DataBytes, bCreateAdjacencyIndices, bCopyStatic, NULL, 
+                             pLoaderCallbacks );
+}
+
+//--------------------------------------------------------------------------------------
+// Reads a whole animation file. *pDataBytes is what was read, which the header's
+// AnimationDataSize may not claim to exceed.
+//--------------------------------------------------------------------------------------
+static HRESULT ReadAnimationFile( const WCHAR* szFileName, BYTE** ppData, UINT64* pDataBytes )
+{
+    HRESULT hr = E_FAIL;
+    DWORD dwBytesRead = 0;
+    LARGE_INTEGER liMove;
+    LARGE_INTEGER FileSize;
+    WCHAR strPath[MAX_PATH];
+    BYTE* pData = NULL;
+    UINT64 DataBytes = 0;
+
+    // Find the path for the file
+    V_RETURN( DXUTFindDXSDKMediaFileCch( strPath, MAX_PATH, szFileName ) );
+
+    // Open the file
+    HANDLE hFile = CreateFile( strPath, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return DXUTERR_MEDIANOTFOUND;
+
+    /////////////////////////
+    // Header
+    SDKANIMATION_FILE_HEADER fileheader;
+    if( !ReadFile( hFile, &fileheader, sizeof( SDKANIMATION_FILE_HEADER ), &dwBytesRead, NULL ) ||
+        dwBytesRead != sizeof( SDKANIMATION_FILE_HEADER ) )
+        goto Error;
+    if( !GetFileSizeEx( hFile, &FileSize ) ||
+        fileheader.AnimationDataSize > ( UINT64 )FileSize.QuadPart - sizeof( SDKANIMATION_FILE_HEADER ) ||
+        fileheader.AnimationDataSize > 0xffffffff - sizeof( SDKANIMATION_FILE_HEADER ) )
+        goto Error;
+
+    //allocate
+    DataBytes = sizeof( SDKANIMATION_FILE_HEADER ) + fileheader.AnimationDataSize;
+    pData = new BYTE[ ( size_t )DataBytes ];
+    if( !pData )
+    {
+        hr = E_OUTOFMEMORY;
+        goto Error;
+    }
+
+    // read it all in
+    liMove.QuadPart = 0;
+    if( !SetFilePointerEx( hFile, liMove, NULL, FILE_BEGIN ) )
+        goto Error;
+    if( !ReadFile( hFile, pData, ( DWORD )DataBytes, &dwBytesRead, NULL ) || dwBytesRead != ( DWORD )DataBytes )
+        goto Error;
+
+    *ppData = pData;
+    *pDataBytes = DataBytes;
+    pData = NULL;
+    hr = S_OK;
+Error:
+    SAFE_DELETE_ARRAY( pData );
+    CloseHandle( hFile );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::LoadAnimation( WCHAR* szFileName )
+{
+    HRESULT hr;
+    BYTE* pData = NULL;
+    UINT64 DataBytes = 0;
+
+    // Keys from an earlier CompressAnimation would shadow the new ones
+    SDKMeshDestroyCompressedAnimation( &m_CompressedAnimation );
+
+    V_RETURN( ReadAnimationFile( szFileName, &pData, &DataBytes ) );
+    SAFE_DELETE_ARRAY( m_pAnimationData );
+    m_pAnimationData = pData;
+
+    // pointer fixup
+    m_pAnimationHeader = ( SDKANIMATION_FILE_HEADER* )m_pAnimationData;
+    m_pAnimationFrameData = ( SDKANIMATION_FRAME_DATA* )( m_pAnimationData + m_pAnimationHeader->AnimationDataOffset );
+
+    UINT64 BaseOffset = sizeof( SDKANIMATION_FILE_HEADER );
+    for( UINT i = 0; i < m_pAnimationHeader->NumFrames; i++ )
+    {
+        m_pAnimationFrameData[i].pAnimationData = ( SDKANIMATION_DATA* )( m_pAnimationData +
+                                                                          m_pAnimationFrameData[i].DataOffset +
+                                                                          BaseOffset );
+        SDKMESH_FRAME* pFrame = FindFrame( m_pAnimationFrameData[i].FrameName );
+        if( pFrame )
+        {
+            pFrame->AnimationDataIndex = i;
+        }
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Unlike LoadAnimation this checks every offset in the file against its size, and
+// binds tracks to frames in a table of the clip's own, leaving the frames alone. When
+// two tracks name the same frame the first one drives it.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::LoadAnimationClip( WCHAR* szFileName, UINT* piClip )
+{
+    if( !m_pMeshHeader )
+        return E_FAIL;
+
+    HRESULT hr;
+    V_RETURN( CreateFrameRestPose() );
+
+    SDKMESH_ANIMATION_CLIP Clip;
+    ZeroMemory( &Clip, sizeof( SDKMESH_ANIMATION_CLIP ) );
+    UINT64 DataBytes = 0;
+    V_RETURN( ReadAnimationFile( szFileName, &Clip.pData, &DataBytes ) );
+    Clip.pHeader = ( SDKANIMATION_FILE_HEADER* )Clip.pData;
+
+    const SDKANIMATION_FILE_HEADER* pHeader = Clip.pHeader;
+    UINT64 TrackBytes = ( UINT64 )pHeader->NumAnimationKeys * sizeof( SDKANIMATION_DATA );
+    hr = S_OK;
+    if( pHeader->FrameTransformType != FTT_RELATIVE || pHeader->NumAnimationKeys == 0 ||
+        pHeader->AnimationDataOffset > DataBytes ||
+        ( UINT64 )pHeader->NumFrames * sizeof( SDKANIMATION_FRAME_DATA ) > DataBytes - pHeader->AnimationDataOffset )
+        hr = E_FAIL;
+
+    if( SUCCEEDED( hr ) )
+    {
+        Clip.pFrameData = ( SDKANIMATION_FRAME_DATA* )( Clip.pData + pHeader->AnimationDataOffset );
+        for( UINT i = 0; i < pHeader->NumFrames && SUCCEEDED( hr ); i++ )
+        {
+            UINT64 Offset = Clip.pFrameData[i].DataOffset + sizeof( SDKANIMATION_FILE_HEADER );
+            if( Clip.pFrameData[i].DataOffset > DataBytes || Offset > DataBytes || TrackBytes > DataBytes - Offset )
+                hr = E_FAIL;
+            else
+                Clip.pFrameData[i].pAnimationData = ( SDKANIMATION_DATA* )( Clip.pData + Offset );
+        }
+    }
+
+    UINT NumFrames = m_pMeshHeader->NumFrames;
+    SDKMESH_ANIMATION_CLIP* pClips = NULL;
+    if( SUCCEEDED( hr ) )
+    {
+        Clip.pFrameTracks = new UINT[ max( NumFrames, 1 ) ];
+        pClips = new SDKMESH_ANIMATION_CLIP[ m_NumAnimationClips + 1 ];
+        if( !Clip.pFrameTracks || !pClips )
+            hr = E_OUTOFMEMORY;
+    }
+
+    if( FAILED( hr ) )
+    {
+        SAFE_DELETE_ARRAY( Clip.pData );
+        SAFE_DELETE_ARRAY( Clip.pFrameTracks );
+        SAFE_DELETE_ARRAY( pClips );
+        return hr;
+    }
+
+    for( UINT i = 0; i < NumFrames; i++ )
+        Clip.pFrameTracks[i] = INVALID_ANIMATION_DATA;
+    for( UINT i = 0; i < pHeader->NumFrames; i++ )
+    {
+        UINT iFrame = FindFrameIndex( Clip.pFrameData[i].FrameName );
+        if( iFrame != INVALID_FRAME && Clip.pFrameTracks[iFrame] == INVALID_ANIMATION_DATA )
+            Clip.pFrameTracks[iFrame] = i;
+    }
+
+    if( m_NumAnimationClips > 0 )
+        CopyMemory( pClips, m_pAnimationClips, sizeof( SDKMESH_ANIMATION_CLIP ) * m_NumAnimationClips );
+    pClips[m_NumAnimationClips] = Clip;
+    SAFE_DELETE_ARRAY( m_pAnimationClips );
+    m_pAnimationClips = pClips;
+
+    if( piClip )
+        *piClip = m_NumAnimationClips;
+    m_NumAnimationClips++;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::DestroyAnimationClips()
+{
+    for( UINT i = 0; i < m_NumAnimationClips; i++ )
+    {
+        SAFE_DELETE_ARRAY( m_pAnimationClips[i].pData );
+        SAFE_DELETE_ARRAY( m_pAnimationClips[i].pFrameTracks );
+    }
+    SAFE_DELETE_ARRAY( m_pAnimationClips );
+    m_NumAnimationClips = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Each frame's Matrix as translation, rotation and scale, which blending needs wherever
+// the layers' weights leave part of a frame to its own transform. Matrices that don't
+// come apart keep their translation only.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateFrameRestPose()
+{
+    if( m_pFrameRestPose )
+        return S_OK;
+
+    UINT NumFrames = m_pMeshHeader->NumFrames;
+    m_pFrameRestPose = new SDKMESH_FRAME_TRS[ max( NumFrames, 1 ) ];
+    if( !m_pFrameRestPose )
+        return E_OUTOFMEMORY;
+
+    for( UINT i = 0; i < NumFrames; i++ )
+    {
+        SDKMESH_FRAME_TRS* pRest = &m_pFrameRestPose[i];
+        const D3DXMATRIX* pMatrix = &m_pFrameArray[i].Matrix;
+        if( FAILED( D3DXMatrixDecompose( &pRest->Scale, &pRest->Rotation, &pRest->Translation, pMatrix ) ) )
+        {
+            pRest->Translation = D3DXVECTOR3( pMatrix->_41, pMatrix->_42, pMatrix->_43 );
+            D3DXQuaternionIdentity( &pRest->Rotation );
+            pRest->Scale = D3DXVECTOR3( 1.0f, 1.0f, 1.0f );
+        }
+    }
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::Destroy()
+{
+    // The texture loads write into the materials freed below
+    WaitForTextures();
+
+    if( !CheckLoadDone() )
+        return E_PENDING;
+
+    // Instances point into the frame and animation data freed below
+    if( m_NumInstances != 0 )
+        return HRESULT_FROM_WIN32( ERROR_BUSY );
+
+    if( m_pStaticMeshData )
+    {
+        if( m_pMaterialArray )
+        {
+            for( UINT64 m = 0; m < m_pMeshHeader->NumMaterials; m++ )
+            {
+                if( m_pDev9 )
+                {
+                    if( !IsErrorResource( m_pMaterialArray[m].pDiffuseTexture9 ) )
+                        SAFE_RELEASE( m_pMaterialArray[m].pDiffuseTexture9 );
+                    if( !IsErrorResource( m_pMaterialArray[m].pNormalTexture9 ) )
+                        SAFE_RELEASE( m_pMaterialArray[m].pNormalTexture9 );
+                    if( !IsErrorResource( m_pMaterialArray[m].pSpecularTexture9 ) )
+                        SAFE_RELEASE( m_pMaterialArray[m].pSpecularTexture9 );
+                }
+				else if( m_pDev11 )
+                {
+                    //ID3D11Resource* pRes = NULL;
+                    if( m_pMaterialArray[m].pDiffuseRV11 && !IsErrorResource( m_pMaterialArray[m].pDiffuseRV11 ) )
+                    {
+                        //m_pMaterialArray[m].pDiffuseRV11->GetResource( &pRes );
+                        //SAFE_RELEASE( pRes );
+
+                        SAFE_RELEASE( m_pMaterialArray[m].pDiffuseRV11 );
+                    }
+                    if( m_pMaterialArray[m].pNormalRV11 && !IsErrorResource( m_pMaterialArray[m].pNormalRV11 ) )
+                    {
+                        //m_pMaterialArray[m].pNormalRV11->GetResource( &pRes );
+                        //SAFE_RELEASE( pRes );
+
+                        SAFE_RELEASE( m_pMaterialArray[m].pNormalRV11 );
+                    }
+                    if( m_pMaterialArray[m].pSpecularRV11 && !IsErrorResource( m_pMaterialArray[m].pSpecularRV11 ) )
+                    {
+                        //m_pMaterialArray[m].pSpecularRV11->GetResource( &pRes );
+                        //SAFE_RELEASE( pRes );
+
+                        SAFE_RELEASE( m_pMaterialArray[m].pSpecularRV11 );
+                    }
+                }
+            }
+        }
+
+        for( UINT64 i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+        {
+            if( !IsErrorResource( m_pVertexBufferArray[i].pVB9 ) )
+                SAFE_RELEASE( m_pVertexBufferArray[i].pVB9 );
+        }
+
+        for( UINT64 i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
+        {
+            if( !IsErrorResource( m_pIndexBufferArray[i].pIB9 ) )
+                SAFE_RELEASE( m_pIndexBufferArray[i].pIB9 );
+        }
+    }
+
+    if( m_pAdjacencyIndexBufferArray )
+    {
+        for( UINT64 i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
+        {
+            SAFE_RELEASE( m_pAdjacencyIndexBufferArray[i].pIB11 );
+        }
+    }
+    SAFE_DELETE_ARRAY( m_pAdjacencyIndexBufferArray );
+    DestroyLODs();
+    DestroyBVHs();
+    DestroyMeshResidency();
+    SDKMeshDestroyInstanceRing( &m_InstanceRing );
+
+    if( m_pQuantizedStreams )
+    {
+        for( UINT64 i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+            SAFE_DELETE_ARRAY( m_pQuantizedStreams[i].pVertices );
+    }
+    SAFE_DELETE_ARRAY( m_pQuantizedStreams );
+
+    SAFE_DELETE_ARRAY( m_pHeapData );
+    m_pStaticMeshData = NULL;
+    SAFE_DELETE_ARRAY( m_pAnimationData );
+    SDKMeshDestroyCompressedAnimation( &m_CompressedAnimation );
+    DestroyAnimationClips();
+    SAFE_DELETE_ARRAY( m_pFrameRestPose );
+    SAFE_DELETE_ARRAY( m_pBindPoseFrameMatrices );
+    SAFE_DELETE_ARRAY( m_pTransformedFrameMatrices );
+    SAFE_DELETE_ARRAY( m_pWorldPoseFrameMatrices );
+    SAFE_DELETE_ARRAY( m_pSubsetBounds );
+    SAFE_DELETE_ARRAY( m_pFrameOrder );
+    SAFE_DELETE_ARRAY( m_pFrameOrderParent );
+    SAFE_DELETE_ARRAY( m_pFrameOrderEnd );
+    SAFE_DELETE_ARRAY( m_pFrameOrderPos );
+    SAFE_DELETE_ARRAY( m_pFrameOrderLocal );
+    m_NumOrderedFrames = 0;
+    SDKMeshDestroyFrameIndex( &m_FrameIndex );
+    SDKMeshDestroyCullBoxes( &m_CullBoxes );
+    SAFE_DELETE_ARRAY( m_pFrameCullBox );
+    SAFE_DELETE_ARRAY( m_pVisibleBits );
+    m_bCullBoxesLocal = false;
+    m_bCullingActive = false;
+
+    SAFE_DELETE_ARRAY( m_ppVertices );
+    SAFE_DELETE_ARRAY( m_ppIndices );
+
+    UnmapFile();
+
+    m_pMeshHeader = NULL;
+    m_pVertexBufferArray = NULL;
+    m_pIndexBufferArray = NULL;
+    m_pMeshArray = NULL;
+    m_pSubsetArray = NULL;
+    m_pFrameArray = NULL;
+    m_pMaterialArray = NULL;
+
+    m_pAnimationHeader = NULL;
+    m_pAnimationFrameData = NULL;
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// transform the bind pose
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformBindPose( D3DXMATRIX* pWorld )
+{
+    TransformBindPoseFrame( 0, pWorld );
+}
+
+//--------------------------------------------------------------------------------------
+// transform the mesh frames according to the animation for time fTime
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformMesh( D3DXMATRIX* pWorld, double fTime )
+{
+    EvaluatePose( pWorld, fTime, m_pFrameOrderLocal, m_pWorldPoseFrameMatrices, m_pTransformedFrameMatrices );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::TransformMeshBlended( const D3DXMATRIX* pWorld, const SDKMESH_ANIMATION_LAYER* pLayers,
+                                            UINT NumLayers )
+{
+    return EvaluateBlendedPose( pWorld, pLayers, NumLayers, m_pFrameOrderLocal, m_pWorldPoseFrameMatrices,
+                                m_pTransformedFrameMatrices );
+}
+
+//--------------------------------------------------------------------------------------
+// TransformMesh into caller-owned pose arrays. This only reads the mesh, so instances
+// of one mesh can be evaluated on several threads at once.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::EvaluatePose( const D3DXMATRIX* pWorld, double fTime, D3DXMATRIX* pLocal,
+                                 D3DXMATRIX* pWorldPose, D3DXMATRIX* pTransformed )
+{
+    UINT iKey0, iKey1;
+    float fBlend;
+    GetAnimationKeysFromTime( fTime, &iKey0, &iKey1, &fBlend );
+
+    if( m_pAnimationHeader == NULL || FTT_RELATIVE == m_pAnimationHeader->FrameTransformType )
+    {
+        TransformFrameRange( 0, pWorld, iKey0, iKey1, fBlend, pLocal, pWorldPose, pTransformed );
+        ApplyInverseBindPose( pTransformed );
+    }
+    else if( FTT_ABSOLUTE == m_pAnimationHeader->FrameTransformType )
+    {
+        for( UINT i = 0; i < m_pAnimationHeader->NumFrames; i++ )
+            TransformFrameAbsolute( i, iKey0, iKey1, fBlend, pTransformed );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// For each frame, move the transform to the bind pose, then move it to the final
+// position
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::ApplyInverseBindPose( D3DXMATRIX* pTransformed )
+{
+    D3DXMATRIX mInvBindPose;
+    D3DXMATRIX mFinal;
+    for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
+    {
+        D3DXMatrixInverse( &mInvBindPose, NULL, &m_pBindPoseFrameMatrices[i] );
+        mFinal = mInvBindPose * pTransformed[i];
+        pTransformed[i] = mFinal;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Blended poses, for TransformMeshBlended and instances alike. Only reads the mesh.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::EvaluateBlendedPose( const D3DXMATRIX* pWorld, const SDKMESH_ANIMATION_LAYER* pLayers,
+                                           UINT NumLayers, D3DXMATRIX* pLocal, D3DXMATRIX* pWorldPose,
+                                           D3DXMATRIX* pTransformed )
+{
+    if( NumLayers > SDKMESH_MAX_ANIMATION_LAYERS || ( NumLayers > 0 && !pLayers ) )
+        return E_INVALIDARG;
+    for( UINT i = 0; i < NumLayers; i++ )
+    {
+        if( pLayers[i].iClip >= m_NumAnimationClips )
+            return E_INVALIDARG;
+    }
+
+    GetBlendedLocalTransforms( pLayers, NumLayers, pLocal );
+    ConcatenateFrameRange( 0, m_NumOrderedFrames, pWorld, pLocal, pWorldPose, pTransformed );
+    ApplyInverseBindPose( pTransformed );
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateCullBoxes()
+{
+    UINT NumFrames = m_pMeshHeader->NumFrames;
+    m_pFrameCullBox = new UINT[ NumFrames ];
+    if( !m_pFrameCullBox )
+        return E_OUTOFMEMORY;
+
+    UINT NumBoxes = 0;
+    for( UINT i = 0; i < NumFrames; i++ )
+    {
+        UINT iMesh = m_pFrameArray[i].Mesh;
+        if( iMesh == INVALID_MESH )
+        {
+            m_pFrameCullBox[i] = INVALID_FRAME;
+            continue;
+        }
+
+        m_pFrameCullBox[i] = NumBoxes;
+        NumBoxes += 1 + m_pMeshArray[iMesh].NumSubsets;
+    }
+
+    HRESULT hr = SDKMeshCreateCullBoxes( NumBoxes, &m_CullBoxes );
+    if( SUCCEEDED( hr ) )
+    {
+        m_pVisibleBits = new DWORD[ SDKMESH_CULL_MASK_DWORDS( NumBoxes ) ];
+        if( !m_pVisibleBits )
+            hr = E_OUTOFMEMORY;
+    }
+    if( FAILED( hr ) )
+    {
+        SDKMeshDestroyCullBoxes( &m_CullBoxes );
+        SAFE_DELETE_ARRAY( m_pFrameCullBox );
+        return hr;
+    }
+
+    m_bCullBoxesLocal = false;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::Cull( const D3DXMATRIX* pWorldViewProj, const D3DXMATRIX* pFrameMatrices )
+{
+    if( !m_pStaticMeshData || !m_pFrameArray || !m_pSubsetBounds )
+        return 0;
+
+    if( !m_pFrameCullBox && FAILED( CreateCullBoxes() ) )
+    {
+        m_bCullingActive = false;
+        return 0;
+    }
+
+    // Object space boxes only need writing once
+    if( pFrameMatrices || !m_bCullBoxesLocal )
+    {
+        for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
+        {
+            UINT iBox = m_pFrameCullBox[i];
+            if( iBox == INVALID_FRAME )
+                continue;
+
+            SDKMESH_MESH* pMesh = &m_pMeshArray[ m_pFrameArray[i].Mesh ];
+            if( pFrameMatrices )
+                SDKMeshTransformCullBox( &m_CullBoxes, iBox, pFrameMatrices[i], pMesh->BoundingBoxCenter,
+                                         pMesh->BoundingBoxExtents );
+            else
+                SDKMeshSetCullBox( &m_CullBoxes, iBox, pMesh->BoundingBoxCenter, pMesh->BoundingBoxExtents );
+
+            for( UINT j = 0; j < pMesh->NumSubsets; j++ )
+            {
+                const SDKMESH_SUBSET_BOUNDS* pBounds = &m_pSubsetBounds[ pMesh->pSubsets[j] ];
+                if( pFrameMatrices )
+                    SDKMeshTransformCullBox( &m_CullBoxes, iBox + 1 + j, pFrameMatrices[i],
+                                             pBounds->BoundingBoxCenter, pBounds->BoundingBoxExtents );
+                else
+                    SDKMeshSetCullBox( &m_CullBoxes, iBox + 1 + j, pBounds->BoundingBoxCenter,
+                                       pBounds->BoundingBoxExtents );
+            }
+        }
+        m_bCullBoxesLocal = ( pFrameMatrices == NULL );
+    }
+
+    SDKMESH_FRUSTUM Frustum;
+    SDKMeshExtractFrustum( *pWorldViewProj, &Frustum );
+    SDKMeshCullBoxes( &Frustum, &m_CullBoxes, m_pVisibleBits );
+    m_bCullingActive = true;
+
+    // A subset can only be visible if its mesh is
+    UINT NumVisible = 0;
+    for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
+    {
+        if( m_pFrameCullBox[i] == INVALID_FRAME || !IsMeshVisible( i ) )
+            continue;
+
+        for( UINT j = 0; j < m_pMeshArray[ m_pFrameArray[i].Mesh ].NumSubsets; j++ )
+        {
+            if( IsSubsetVisible( i, j ) )
+                NumVisible++;
+        }
+    }
+
+    return NumVisible;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::DisableCulling()
+{
+    m_bCullingActive = false;
+}
+
+//--------------------------------------------------------------------------------------
+const DWORD* CDXUTSDKMesh::GetVisibilityMask()
+{
+    return m_bCullingActive ? m_pVisibleBits : NULL;
+}
+
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::GetFrameCullBox( UINT iFrame )
+{
+    return m_pFrameCullBox ? m_pFrameCullBox[iFrame] : INVALID_FRAME;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::IsMeshVisible( UINT iFrame )
+{
+    if( !m_bCullingActive || m_pFrameCullBox[iFrame] == INVALID_FRAME )
+        return true;
+    return SDKMeshIsBoxVisible( m_pVisibleBits, m_pFrameCullBox[iFrame] );
+}
+
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::IsSubsetVisible( UINT iFrame, UINT iSubset )
+{
+    if( !m_bCullingActive || m_pFrameCullBox[iFrame] == INVALID_FRAME )
+        return true;
+    return SDKMeshIsBoxVisible( m_pVisibleBits, m_pFrameCullBox[iFrame] + 1 + iSubset );
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetOptimizeOnLoad( bool bOptimize )
+{
+    m_bOptimizeOnLoad = bOptimize;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::GetOptimizeOnLoad()
+{
+    return m_bOptimizeOnLoad;
+}
+
+//--------------------------------------------------------------------------------------
+// Zeroed unless the last load was optimized
+//--------------------------------------------------------------------------------------
+const SDKMESH_VERTEX_CACHE_STATS* CDXUTSDKMesh::GetVertexCacheStats()
+{
+    return &m_VertexCacheStats;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetNarrowIndicesOnLoad( bool bNarrow )
+{
+    m_bNarrowIndicesOnLoad = bNarrow;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::GetNarrowIndicesOnLoad()
 {
+    return m_bNarrowIndicesOnLoad;
 }
 
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetQuantizeOnLoad( bool bQuantize )
+{
+    m_bQuantizeOnLoad = bQuantize;
+}
 
 //--------------------------------------------------------------------------------------
-CDXUTSDKMesh::~CDXUTSDKMesh()
+bool CDXUTSDKMesh::GetQuantizeOnLoad()
 {
-    Destroy();
+    return m_bQuantizeOnLoad;
 }
 
 //--------------------------------------------------------------------------------------
-HRESULT CDXUTSDKMesh::Create( ID3D11Device* pDev11, LPCTSTR szFileName, bool bCreateAdjacencyIndices,
-                              SDKMESH_CALLBACKS11* pLoaderCallbacks )
+const SDKMESH_QUANTIZED_STREAM* CDXUTSDKMesh::GetQuantizedStream( UINT iMesh, UINT iVB )
 {
-    return CreateFromFile( pDev11,  NULL, szFileName, bCreateAdjacencyIndices, pLoaderCallbacks,  NULL );
+    if( !m_pQuantizedStreams )
+        return NULL;
+    const SDKMESH_QUANTIZED_STREAM* pStream = &m_pQuantizedStreams[ m_pMeshArray[ iMesh ].VertexBuffers[iVB] ];
+    return ( pStream->StrideBytes > 0 ) ? pStream : NULL;
 }
 
 //--------------------------------------------------------------------------------------
-HRESULT CDXUTSDKMesh::Create( IDirect3DDevice9* pDev9, LPCTSTR szFileName, bool bCreateAdjacencyIndices,
-                              SDKMESH_CALLBACKS9* pLoaderCallbacks )
+// Zeroed unless the last load was quantized
+//--------------------------------------------------------------------------------------
+const SDKMESH_QUANTIZATION_STATS* CDXUTSDKMesh::GetQuantizationStats()
 {
-    return CreateFromFile( NULL,  pDev9, szFileName, bCreateAdjacencyIndices, NULL,  pLoaderCallbacks );
+    return &m_QuantizationStats;
 }
 
 //--------------------------------------------------------------------------------------
-HRESULT CDXUTSDKMesh::Create( ID3D11Device* pDev11, BYTE* pData, UINT DataBytes, bool bCreateAdjacencyIndices,
-                              bool bCopyStatic, SDKMESH_CALLBACKS11* pLoaderCallbacks )
+// The stride of vertex buffer iVB as the GPU sees it, for binding it. Callers outside
+// the class get the file's stride from GetVertexStride.
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::GetBufferStride( UINT iVB )
 {
-    return CreateFromMemory( pDev11, NULL, pData, DataBytes, bCreateAdjacencyIndices, bCopyStatic,
-                             pLoaderCallbacks,  NULL );
+    if( m_pQuantizedStreams && m_pQuantizedStreams[iVB].StrideBytes > 0 )
+        return m_pQuantizedStreams[iVB].StrideBytes;
+    return ( UINT )m_pVertexBufferArray[iVB].StrideBytes;
 }
 
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetAsyncTexturesOnLoad( bool bAsync )
+{
+    m_bAsyncTexturesOnLoad = bAsync;
+}
 
 //--------------------------------------------------------------------------------------
-HRESULT CDXUTSDKMesh::Create( IDirect3DDevice9* pDev9, BYTE* pData, UINT DataBytes, bool bCreateAdjacencyIndices,
-                              bool bCopyStatic, SDKMESH_CALLBACKS9* pLoaderCallbacks )
+bool CDXUTSDKMesh::GetAsyncTexturesOnLoad()
 {
-    return CreateFromMemory( NULL, pDev9, pData, DataBytes, bCreateAdjacencyIndices, bCopyStatic, NULL, 
-                             pLoaderCallbacks );
+    return m_bAsyncTexturesOnLoad;
 }
 
 //--------------------------------------------------------------------------------------
-HRESULT CDXUTSDKMesh::LoadAnimation( WCHAR* szFileName )
+// Filled in once the textures of the last load are done, see CheckLoadDone
+//--------------------------------------------------------------------------------------
+const SDKMESH_TEXTURE_LOAD_STATS* CDXUTSDKMesh::GetTextureLoadStats()
 {
-    HRESULT hr = E_FAIL;
-    DWORD dwBytesRead = 0;
-    LARGE_INTEGER liMove;
-    WCHAR strPath[MAX_PATH];
+    return &m_TextureLoadStats;
+}
 
-    // Find the path for the file
-    V_RETURN( DXUTFindDXSDKMediaFileCch( strPath, MAX_PATH, szFileName ) );
+//--------------------------------------------------------------------------------------
+// NULL or NumLODs = 0 turns load time LODs off
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetLODsOnLoad( const SDKMESH_LOD_SETTINGS* pSettings )
+{
+    if( pSettings )
+        m_LoadLODSettings = *pSettings;
+    else
+        ZeroMemory( &m_LoadLODSettings, sizeof( SDKMESH_LOD_SETTINGS ) );
+}
 
-    // Open the file
-    HANDLE hFile = CreateFile( strPath, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING,
-                               FILE_FLAG_SEQUENTIAL_SCAN, NULL );
-    if( INVALID_HANDLE_VALUE == hFile )
-        return DXUTERR_MEDIANOTFOUND;
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::GetNumLODs( UINT iMesh )
+{
+    if( !m_pMeshLODs )
+        return 1;
+    return m_pMeshLODs[iMesh] + 1;
+}
 
-    /////////////////////////
-    // Header
-    SDKANIMATION_FILE_HEADER fileheader;
-    if( !ReadFile( hFile, &fileheader, sizeof( SDKANIMATION_FILE_HEADER ), &dwBytesRead, NULL ) )
-        goto Error;
+//--------------------------------------------------------------------------------------
+// Level 0 is the mesh's own index buffer, so it returns NULL
+//--------------------------------------------------------------------------------------
+const SDKMESH_LOD* CDXUTSDKMesh::GetLOD( UINT iMesh, UINT iLOD )
+{
+    if( iLOD == 0 || iLOD >= GetNumLODs( iMesh ) )
+        return NULL;
+    return &m_pLODs[iMesh * m_MaxLODs + iLOD - 1];
+}
 
-    //allocate
-    m_pAnimationData = new BYTE[ ( size_t )( sizeof( SDKANIMATION_FILE_HEADER ) + fileheader.AnimationDataSize ) ];
-    if( !m_pAnimationData )
-    {
-        hr = E_OUTOFMEMORY;
-        goto Error;
-    }
+//--------------------------------------------------------------------------------------
+float CDXUTSDKMesh::GetLODError( UINT iMesh, UINT iLOD )
+{
+    const SDKMESH_LOD* pLOD = GetLOD( iMesh, iLOD );
+    return pLOD ? pLOD->Error : 0.0f;
+}
 
-    // read it all in
-    liMove.QuadPart = 0;
-    if( !SetFilePointerEx( hFile, liMove, NULL, FILE_BEGIN ) )
-        goto Error;
-    if( !ReadFile( hFile, m_pAnimationData, ( DWORD )( sizeof( SDKANIMATION_FILE_HEADER ) +
-                                                       fileheader.AnimationDataSize ), &dwBytesRead, NULL ) )
-        goto Error;
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetLODView( const D3DXVECTOR3* pEye, float fPixelsPerUnit, float fMaxPixelError )
+{
+    m_vLODEye = *pEye;
+    m_fLODPixelsPerUnit = fPixelsPerUnit;
+    m_fLODMaxPixelError = fMaxPixelError;
+    m_bLODSelection = true;
+}
 
-    // pointer fixup
-    m_pAnimationHeader = ( SDKANIMATION_FILE_HEADER* )m_pAnimationData;
-    m_pAnimationFrameData = ( SDKANIMATION_FRAME_DATA* )( m_pAnimationData + m_pAnimationHeader->AnimationDataOffset );
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::DisableLODSelection()
+{
+    m_bLODSelection = false;
+}
 
-    UINT64 BaseOffset = sizeof( SDKANIMATION_FILE_HEADER );
-    for( UINT i = 0; i < m_pAnimationHeader->NumFrames; i++ )
+//--------------------------------------------------------------------------------------
+// The coarsest level whose error, seen from fDistance, covers at most the allowed
+// number of pixels
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::SelectLOD( UINT iMesh, float fDistance )
+{
+    UINT NumLODs = GetNumLODs( iMesh );
+    UINT iLOD = 0;
+    for( UINT i = 1; i < NumLODs; i++ )
     {
-        m_pAnimationFrameData[i].pAnimationData = ( SDKANIMATION_DATA* )( m_pAnimationData +
-                                                                          m_pAnimationFrameData[i].DataOffset +
-                                                                          BaseOffset );
-        SDKMESH_FRAME* pFrame = FindFrame( m_pAnimationFrameData[i].FrameName );
-        if( pFrame )
-        {
-            pFrame->AnimationDataIndex = i;
-        }
+        if( m_pLODs[iMesh * m_MaxLODs + i - 1].Error * m_fLODPixelsPerUnit > m_fLODMaxPixelError * fDistance )
+            break;
+        iLOD = i;
     }
-
-    hr = S_OK;
-Error:
-    CloseHandle( hFile );
-    return hr;
+    return iLOD;
 }
 
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::Destroy()
+// NULL until BuildBVHs or LoadBVHs
+//--------------------------------------------------------------------------------------
+const SDKMESH_BVH* CDXUTSDKMesh::GetBVH( UINT iMesh )
 {
-    if( !CheckLoadDone() )
-        return;
+    if( !m_pBVHs || iMesh >= m_pMeshHeader->NumMeshes )
+        return NULL;
+    return &m_pBVHs[iMesh];
+}
 
-    if( m_pStaticMeshData )
-    {
-        if( m_pMaterialArray )
-        {
-            for( UINT64 m = 0; m < m_pMeshHeader->NumMaterials; m++ )
-            {
-                if( m_pDev9 )
-                {
-                    if( !IsErrorResource( m_pMaterialArray[m].pDiffuseTexture9 ) )
-                        SAFE_RELEASE( m_pMaterialArray[m].pDiffuseTexture9 );
-                    if( !IsErrorResource( m_pMaterialArray[m].pNormalTexture9 ) )
-                        SAFE_RELEASE( m_pMaterialArray[m].pNormalTexture9 );
-                    if( !IsErrorResource( m_pMaterialArray[m].pSpecularTexture9 ) )
-                        SAFE_RELEASE( m_pMaterialArray[m].pSpecularTexture9 );
-                }
-				else if( m_pDev11 )
-                {
-                    //ID3D11Resource* pRes = NULL;
-                    if( m_pMaterialArray[m].pDiffuseRV11 && !IsErrorResource( m_pMaterialArray[m].pDiffuseRV11 ) )
-                    {
-                        //m_pMaterialArray[m].pDiffuseRV11->GetResource( &pRes );
-                        //SAFE_RELEASE( pRes );
+//--------------------------------------------------------------------------------------
+// The ray is in the space of the mesh's vertex data; a frame's world matrix has to be
+// undone first
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::IntersectRay( UINT iMesh, const D3DXVECTOR3* pOrigin, const D3DXVECTOR3* pDirection,
+                                 float fMaxDistance, bool bAnyHit, SDKMESH_RAY_HIT* pHit )
+{
+    return SDKMeshIntersectBVH( GetBVH( iMesh ), pOrigin, pDirection, fMaxDistance, bAnyHit, pHit );
+}
 
-                        SAFE_RELEASE( m_pMaterialArray[m].pDiffuseRV11 );
-                    }
-                    if( m_pMaterialArray[m].pNormalRV11 && !IsErrorResource( m_pMaterialArray[m].pNormalRV11 ) )
-                    {
-                        //m_pMaterialArray[m].pNormalRV11->GetResource( &pRes );
-                        //SAFE_RELEASE( pRes );
+//--------------------------------------------------------------------------------------
+// The buffer pointers share their storage with the file offsets, which have been read
+// into m_ppVertices and m_ppIndices by now, so they're cleared for the lazy path
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateMeshResidency()
+{
+    HRESULT hr = SDKMeshCreateResidency( m_pMeshHeader->NumMeshes, m_pMeshHeader->NumVertexBuffers,
+                                         m_pMeshHeader->NumIndexBuffers, CreateLazyBuffer, ReleaseLazyBuffer, this,
+                                         &m_Residency );
+    if( FAILED( hr ) )
+        return hr;
 
-                        SAFE_RELEASE( m_pMaterialArray[m].pNormalRV11 );
-                    }
-                    if( m_pMaterialArray[m].pSpecularRV11 && !IsErrorResource( m_pMaterialArray[m].pSpecularRV11 ) )
-                    {
-                        //m_pMaterialArray[m].pSpecularRV11->GetResource( &pRes );
-                        //SAFE_RELEASE( pRes );
+    for( UINT i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+        m_pVertexBufferArray[i].DataOffset = 0;
+    for( UINT i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
+        m_pIndexBufferArray[i].DataOffset = 0;
 
-                        SAFE_RELEASE( m_pMaterialArray[m].pSpecularRV11 );
-                    }
-                }
-            }
-        }
+    return S_OK;
+}
 
-        for( UINT64 i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
-        {
-            if( !IsErrorResource( m_pVertexBufferArray[i].pVB9 ) )
-                SAFE_RELEASE( m_pVertexBufferArray[i].pVB9 );
-        }
+//--------------------------------------------------------------------------------------
+// The buffers themselves are released by Destroy along with the rest
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::DestroyMeshResidency()
+{
+    SDKMeshDestroyResidency( &m_Residency );
+}
 
-        for( UINT64 i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
-        {
-            if( !IsErrorResource( m_pIndexBufferArray[i].pIB9 ) )
-                SAFE_RELEASE( m_pIndexBufferArray[i].pIB9 );
-        }
+//--------------------------------------------------------------------------------------
+// Once the device has its copy, the pages of the mapped file it came from are dropped.
+// Nothing writes to the view on the lazy path, so they're read back from the file if
+// the CPU side wants them again.
+//--------------------------------------------------------------------------------------
+HRESULT CALLBACK CDXUTSDKMesh::CreateLazyBuffer( bool bVertices, UINT iBuffer, void* pContext, UINT64* pSizeBytes )
+{
+    CDXUTSDKMesh* pMesh = ( CDXUTSDKMesh* )pContext;
+    HRESULT hr = E_FAIL;
+    BYTE* pData;
+    UINT64 SizeBytes;
+    if( bVertices )
+    {
+        SDKMESH_VERTEX_BUFFER_HEADER* pHeader = &pMesh->m_pVertexBufferArray[iBuffer];
+        pData = pMesh->m_ppVertices[iBuffer];
+        SizeBytes = pHeader->SizeBytes;
+        if( pMesh->m_pDev11 )
+            hr = pMesh->CreateVertexBuffer( pMesh->m_pDev11, pHeader, pData );
+        else if( pMesh->m_pDev9 )
+            hr = pMesh->CreateVertexBuffer( pMesh->m_pDev9, pHeader, pData );
     }
-
-    if( m_pAdjacencyIndexBufferArray )
+    else
     {
-        for( UINT64 i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
-        {
-            SAFE_RELEASE( m_pAdjacencyIndexBufferArray[i].pIB11 );
-        }
+        SDKMESH_INDEX_BUFFER_HEADER* pHeader = &pMesh->m_pIndexBufferArray[iBuffer];
+        pData = pMesh->m_ppIndices[iBuffer];
+        SizeBytes = pHeader->SizeBytes;
+        if( pMesh->m_pDev11 )
+            hr = pMesh->CreateIndexBuffer( pMesh->m_pDev11, pHeader, pData );
+        else if( pMesh->m_pDev9 )
+            hr = pMesh->CreateIndexBuffer( pMesh->m_pDev9, pHeader, pData );
     }
-    SAFE_DELETE_ARRAY( m_pAdjacencyIndexBufferArray );
+    if( FAILED( hr ) )
+        return hr;
 
-    SAFE_DELETE_ARRAY( m_pHeapData );
-    m_pStaticMeshData = NULL;
-    SAFE_DELETE_ARRAY( m_pAnimationData );
-    SAFE_DELETE_ARRAY( m_pBindPoseFrameMatrices );
-    SAFE_DELETE_ARRAY( m_pTransformedFrameMatrices );
-    SAFE_DELETE_ARRAY( m_pWorldPoseFrameMatrices );
+    if( pMesh->m_MappedPointers.GetSize() > 0 )
+        SDKMeshReleaseFileViewPages( pData, SizeBytes );
 
-    SAFE_DELETE_ARRAY( m_ppVertices );
-    SAFE_DELETE_ARRAY( m_ppIndices );
+    *pSizeBytes = SizeBytes;
+    return S_OK;
+}
 
-    m_pMeshHeader = NULL;
-    m_pVertexBufferArray = NULL;
-    m_pIndexBufferArray = NULL;
-    m_pMeshArray = NULL;
-    m_pSubsetArray = NULL;
-    m_pFrameArray = NULL;
-    m_pMaterialArray = NULL;
+//--------------------------------------------------------------------------------------
+void CALLBACK CDXUTSDKMesh::ReleaseLazyBuffer( bool bVertices, UINT iBuffer, void* pContext )
+{
+    CDXUTSDKMesh* pMesh = ( CDXUTSDKMesh* )pContext;
+    if( bVertices )
+        SAFE_RELEASE( pMesh->m_pVertexBufferArray[iBuffer].pVB9 );
+    else
+        SAFE_RELEASE( pMesh->m_pIndexBufferArray[iBuffer].pIB9 );
+}
 
-    m_pAnimationHeader = NULL;
-    m_pAnimationFrameData = NULL;
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetLazyBuffersOnLoad( bool bLazy )
+{
+    m_bLazyBuffersOnLoad = bLazy;
+}
 
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::GetLazyBuffersOnLoad()
+{
+    return m_bLazyBuffersOnLoad;
 }
 
 //--------------------------------------------------------------------------------------
-// transform the bind pose
+// Does nothing for a mesh that's resident already, which every mesh of a load without
+// lazy buffers is
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::TransformBindPose( D3DXMATRIX* pWorld )
+HRESULT CDXUTSDKMesh::PrefetchMesh( UINT iMesh )
 {
-    TransformBindPoseFrame( 0, pWorld );
+    if( !m_pMeshHeader || iMesh >= m_pMeshHeader->NumMeshes )
+        return E_INVALIDARG;
+    if( !m_Residency.pMeshResident )
+        return S_OK;
+
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+    return SDKMeshAcquireMesh( &m_Residency, iMesh, pMesh->VertexBuffers, pMesh->NumVertexBuffers,
+                               pMesh->IndexBuffer );
 }
 
 //--------------------------------------------------------------------------------------
-// transform the mesh frames according to the animation for time fTime
+// Buffers still used by another resident mesh stay. A context can go on holding a
+// buffer it has bound, so the memory is only freed once it lets go.
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::TransformMesh( D3DXMATRIX* pWorld, double fTime )
+void CDXUTSDKMesh::EvictMesh( UINT iMesh )
 {
-    if( m_pAnimationHeader == NULL || FTT_RELATIVE == m_pAnimationHeader->FrameTransformType )
-    {
-        TransformFrame( 0, pWorld, fTime );
+    if( !m_Residency.pMeshResident || iMesh >= m_pMeshHeader->NumMeshes )
+        return;
 
-        // For each frame, move the transform to the bind pose, then
-        // move it to the final position
-        D3DXMATRIX mInvBindPose;
-        D3DXMATRIX mFinal;
-        for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
-        {
-            D3DXMatrixInverse( &mInvBindPose, NULL, &m_pBindPoseFrameMatrices[i] );
-            mFinal = mInvBindPose * m_pTransformedFrameMatrices[i];
-            m_pTransformedFrameMatrices[i] = mFinal;
-        }
-    }
-    else if( FTT_ABSOLUTE == m_pAnimationHeader->FrameTransformType )
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+    SDKMeshReleaseMesh( &m_Residency, iMesh, pMesh->VertexBuffers, pMesh->NumVertexBuffers, pMesh->IndexBuffer );
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::EvictAllMeshes()
+{
+    if( !m_Residency.pMeshResident )
+        return;
+
+    for( UINT i = 0; i < m_pMeshHeader->NumMeshes; i++ )
+        EvictMesh( i );
+}
+
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::IsMeshResident( UINT iMesh )
+{
+    if( !m_pMeshHeader || iMesh >= m_pMeshHeader->NumMeshes )
+        return false;
+    return !m_Residency.pMeshResident || m_Residency.pMeshResident[iMesh];
+}
+
+//--------------------------------------------------------------------------------------
+// Zero for a load without lazy buffers
+//--------------------------------------------------------------------------------------
+const SDKMESH_STREAMING_STATS* CDXUTSDKMesh::GetStreamingStats()
+{
+    return &m_Residency.Stats;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::SkinMesh( UINT iMesh, D3DXVECTOR3* pPositions, D3DXVECTOR3* pNormals,
+                                D3DXVECTOR3* pTangents, const D3DXMATRIX* pFrameMatrices )
+{
+    if( !m_pMeshHeader || iMesh >= m_pMeshHeader->NumMeshes )
+        return E_INVALIDARG;
+
+    HRESULT hr;
+    SDKMESH_MESH* pMesh = &m_pMeshArray[iMesh];
+
+    SDKMESH_SKIN_SOURCE Source;
+    ZeroMemory( &Source, sizeof( SDKMESH_SKIN_SOURCE ) );
+    for( UINT i = 0; i < pMesh->NumVertexBuffers; i++ )
     {
-        for( UINT i = 0; i < m_pAnimationHeader->NumFrames; i++ )
-            TransformFrameAbsolute( i, fTime );
+        UINT iVB = pMesh->VertexBuffers[i];
+        SDKMESH_VERTEX_BUFFER_HEADER* pHeader = &m_pVertexBufferArray[iVB];
+        V_RETURN( SDKMeshAddSkinStream( &Source, pHeader->Decl, m_ppVertices[iVB], ( UINT )pHeader->StrideBytes,
+                                        ( UINT )pHeader->NumVertices ) );
     }
-}
 
+    // Gather the mesh's bones so blend indices can address them directly
+    if( !pFrameMatrices )
+        pFrameMatrices = m_pTransformedFrameMatrices;
+
+    UINT NumBones = max( 1, pMesh->NumFrameInfluences );
+    D3DXMATRIX* pBones = new D3DXMATRIX[ NumBones ];
+    if( !pBones )
+        return E_OUTOFMEMORY;
+
+    D3DXMatrixIdentity( &pBones[0] );
+    for( UINT i = 0; i < pMesh->NumFrameInfluences; i++ )
+        pBones[i] = pFrameMatrices[ pMesh->pFrameInfluences[i] ];
+
+    hr = SDKMeshSkinVertices( &Source, pBones, NumBones, pPositions, pNormals, pTangents );
+
+    SAFE_DELETE_ARRAY( pBones );
+    return hr;
+}
 
 //--------------------------------------------------------------------------------------
 void CDXUTSDKMesh::Render( ID3D11DeviceContext* pd3dDeviceContext,
@@ -1239,6 +4659,74 @@ void CDXUTSDKMesh::RenderAdjacent( ID3D11DeviceContext* pd3dDeviceContext,
 }
 
 
+//--------------------------------------------------------------------------------------
+// The instances go through the ring in batches of whatever fits, each batch drawing
+// every mesh in the frame hierarchy. Returns S_FALSE while the buffers are loading.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::RenderInstanced( ID3D11DeviceContext* pd3dDeviceContext,
+                                       const D3DXMATRIX* pWorlds,
+                                       UINT NumInstances,
+                                       const void* pInstanceData,
+                                       UINT InstanceDataStride,
+                                       UINT iDiffuseSlot,
+                                       UINT iNormalSlot,
+                                       UINT iSpecularSlot )
+{
+    HRESULT hr;
+
+    if( !pd3dDeviceContext || ( NumInstances > 0 && !pWorlds ) || ( InstanceDataStride > 0 && !pInstanceData ) )
+        return E_INVALIDARG;
+    if( !m_pStaticMeshData || !m_pFrameArray || !m_pFrameOrder )
+        return E_FAIL;
+    if( 0 < GetOutstandingBufferResources() )
+        return S_FALSE;
+    if( NumInstances == 0 )
+        return S_OK;
+
+    if( !m_InstanceRing.pBuffer )
+    {
+        if( !m_pDev11 )
+            return E_FAIL;
+        V_RETURN( SDKMeshCreateInstanceRing( m_pDev11, SDKMESH_INSTANCE_RING_BYTES, &m_InstanceRing ) );
+    }
+
+    UINT Stride = SDKMESH_INSTANCE_TRANSFORM_BYTES + InstanceDataStride;
+    if( Stride > m_InstanceRing.SizeBytes )
+        return E_INVALIDARG;
+
+    for( UINT iFirst = 0; iFirst < NumInstances; )
+    {
+        UINT Count = NumInstances - iFirst;
+        BYTE* pData;
+        UINT Offset;
+        V_RETURN( SDKMeshMapInstances( pd3dDeviceContext, &m_InstanceRing, Stride, &Count, ( void** )&pData,
+                                       &Offset ) );
+
+        for( UINT i = 0; i < Count; i++ )
+        {
+            BYTE* pInstance = pData + ( SIZE_T )i * Stride;
+            memcpy( pInstance, &pWorlds[iFirst + i], SDKMESH_INSTANCE_TRANSFORM_BYTES );
+            if( InstanceDataStride > 0 )
+                memcpy( pInstance + SDKMESH_INSTANCE_TRANSFORM_BYTES,
+                        ( const BYTE* )pInstanceData + ( SIZE_T )( iFirst + i ) * InstanceDataStride,
+                        InstanceDataStride );
+        }
+        SDKMeshUnmapInstances( pd3dDeviceContext, &m_InstanceRing );
+
+        pd3dDeviceContext->IASetVertexBuffers( SDKMESH_INSTANCE_SLOT, 1, &m_InstanceRing.pBuffer, &Stride, &Offset );
+        for( UINT iPos = 0; iPos < m_NumOrderedFrames; iPos++ )
+        {
+            UINT iMesh = m_pFrameArray[ m_pFrameOrder[iPos] ].Mesh;
+            if( iMesh != INVALID_MESH )
+                RenderMeshInstanced( iMesh, Count, pd3dDeviceContext, iDiffuseSlot, iNormalSlot, iSpecularSlot );
+        }
+
+        iFirst += Count;
+    }
+
+    return S_OK;
+}
+
 //--------------------------------------------------------------------------------------
 void CDXUTSDKMesh::Render( LPDIRECT3DDEVICE9 pd3dDevice,
                            LPD3DXEFFECT pEffect,
@@ -1320,6 +4808,8 @@ SDKMESH_INDEX_TYPE CDXUTSDKMesh::GetIndexType( UINT iMesh )
 //--------------------------------------------------------------------------------------
 ID3D11Buffer* CDXUTSDKMesh::GetAdjIB11( UINT iMesh )
 {
+    if( !m_pAdjacencyIndexBufferArray )
+        return NULL;
     return m_pAdjacencyIndexBufferArray[ m_pMeshArray[ iMesh ].IndexBuffer ].pIB11;
 }
 
@@ -1479,6 +4969,9 @@ SDKMESH_SUBSET* CDXUTSDKMesh::GetSubset( UINT iMesh, UINT iSubset )
     return &m_pSubsetArray[ m_pMeshArray[ iMesh ].pSubsets[iSubset] ];
 }
 
+//--------------------------------------------------------------------------------------
+// The stride of the file's vertices, which GetRawVerticesAt and the vertex buffer
+// header describe. A packed buffer's stride is in GetQuantizedStream.
 //--------------------------------------------------------------------------------------
 UINT CDXUTSDKMesh::GetVertexStride( UINT iMesh, UINT iVB )
 {
@@ -1499,16 +4992,29 @@ SDKMESH_FRAME* CDXUTSDKMesh::GetFrame( UINT iFrame )
 }
 
 //--------------------------------------------------------------------------------------
-SDKMESH_FRAME* CDXUTSDKMesh::FindFrame( char* pszName )
+SDKMESH_FRAME* CDXUTSDKMesh::FindFrame( const char* pszName )
 {
-    for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
-    {
-        if( _stricmp( m_pFrameArray[i].Name, pszName ) == 0 )
-        {
-            return &m_pFrameArray[i];
-        }
-    }
-    return NULL;
+    UINT iFrame = FindFrameIndex( pszName );
+    return ( iFrame == INVALID_FRAME ) ? NULL : &m_pFrameArray[iFrame];
+}
+
+//--------------------------------------------------------------------------------------
+// The index of the first frame with the name, or INVALID_FRAME
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::FindFrameIndex( const char* pszName )
+{
+    SDKMESH_FRAME_NAME Name = SDKMeshMakeFrameName( pszName );
+    return FindFrameIndex( &Name );
+}
+
+//--------------------------------------------------------------------------------------
+// Resolving a frame's index once and keeping it beats any name lookup, but where names
+// have to be looked up every frame, hashing them once with SDKMeshMakeFrameName leaves
+// a probe and usually a single compare
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::FindFrameIndex( const SDKMESH_FRAME_NAME* pName )
+{
+    return SDKMeshLookupFrame( &m_FrameIndex, m_pFrameArray, pName );
 }
 
 //--------------------------------------------------------------------------------------
@@ -1535,6 +5041,12 @@ D3DXVECTOR3 CDXUTSDKMesh::GetMeshBBoxExtents( UINT iMesh )
     return m_pMeshArray[iMesh].BoundingBoxExtents;
 }
 
+//--------------------------------------------------------------------------------------
+const SDKMESH_SUBSET_BOUNDS* CDXUTSDKMesh::GetSubsetBounds( UINT iMesh, UINT iSubset )
+{
+    return &m_pSubsetBounds[ m_pMeshArray[ iMesh ].pSubsets[iSubset] ];
+}
+
 //--------------------------------------------------------------------------------------
 UINT CDXUTSDKMesh::GetOutstandingResources()
 {
@@ -1602,14 +5114,19 @@ UINT CDXUTSDKMesh::GetOutstandingBufferResources()
     if( !m_pMeshHeader )
         return 1;
 
+    // Lazy buffers that no resident mesh uses aren't waited for
     for( UINT i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
     {
+        if( m_Residency.pVertexBufferRefs && m_Residency.pVertexBufferRefs[i] == 0 )
+            continue;
         if( !m_pVertexBufferArray[i].pVB9 && !IsErrorResource( m_pVertexBufferArray[i].pVB9 ) )
             outstandingResources ++;
     }
 
     for( UINT i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
     {
+        if( m_Residency.pIndexBufferRefs && m_Residency.pIndexBufferRefs[i] == 0 )
+            continue;
         if( !m_pIndexBufferArray[i].pIB9 && !IsErrorResource( m_pIndexBufferArray[i].pIB9 ) )
             outstandingResources ++;
     }
@@ -1620,6 +5137,9 @@ UINT CDXUTSDKMesh::GetOutstandingBufferResources()
 //--------------------------------------------------------------------------------------
 bool CDXUTSDKMesh::CheckLoadDone()
 {
+    if( m_pTextureLoader && SDKMeshIsTextureLoadDone( m_pTextureLoader ) )
+        WaitForTextures();
+
     if( 0 == GetOutstandingResources() )
     {
         m_bLoading = false;
@@ -1712,6 +5232,72 @@ UINT CDXUTSDKMesh::GetAnimationKeyFromTime( double fTime )
     return iTick;
 }
 
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::GetAnimationKeysFromTime( double fTime, UINT* piKey0, UINT* piKey1, float* pfBlend )
+{
+    GetKeysFromTime( m_pAnimationHeader, m_AnimationInterpolation, fTime, piKey0, piKey1, pfBlend );
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::SetAnimationInterpolation( SDKMESH_ANIMATION_INTERPOLATION Interpolation )
+{
+    m_AnimationInterpolation = Interpolation;
+}
+
+//--------------------------------------------------------------------------------------
+SDKMESH_ANIMATION_INTERPOLATION CDXUTSDKMesh::GetAnimationInterpolation()
+{
+    return m_AnimationInterpolation;
+}
+
+//--------------------------------------------------------------------------------------
+// Returns S_FALSE if the animation is already compressed
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CompressAnimation( const SDKMESH_ANIMATION_COMPRESSION* pSettings,
+                                         SDKMESH_ANIMATION_COMPRESSION_STATS* pStats )
+{
+    if( m_pAnimationHeader == NULL )
+        return E_FAIL;
+    if( IsAnimationCompressed() )
+        return S_FALSE;
+
+    HRESULT hr;
+    V_RETURN( SDKMeshCompressAnimation( m_pAnimationFrameData, m_pAnimationHeader->NumFrames,
+                                        m_pAnimationHeader->NumAnimationKeys, pSettings, &m_CompressedAnimation,
+                                        pStats ) );
+
+    // Keep the header and frame table and let the source keys go. If the smaller copy
+    // can't be made the source just stays where it is.
+    UINT NumFrames = m_pAnimationHeader->NumFrames;
+    SIZE_T FrameDataBytes = sizeof( SDKANIMATION_FRAME_DATA ) * NumFrames;
+    BYTE* pAnimationData = new BYTE[ sizeof( SDKANIMATION_FILE_HEADER ) + FrameDataBytes ];
+    if( !pAnimationData )
+        return S_OK;
+
+    SDKANIMATION_FILE_HEADER* pHeader = ( SDKANIMATION_FILE_HEADER* )pAnimationData;
+    SDKANIMATION_FRAME_DATA* pFrameData = ( SDKANIMATION_FRAME_DATA* )( pAnimationData +
+                                                                        sizeof( SDKANIMATION_FILE_HEADER ) );
+    *pHeader = *m_pAnimationHeader;
+    pHeader->AnimationDataOffset = sizeof( SDKANIMATION_FILE_HEADER );
+    pHeader->AnimationDataSize = FrameDataBytes;
+    memcpy( pFrameData, m_pAnimationFrameData, FrameDataBytes );
+    for( UINT i = 0; i < NumFrames; i++ )
+        pFrameData[i].pAnimationData = NULL;
+
+    SAFE_DELETE_ARRAY( m_pAnimationData );
+    m_pAnimationData = pAnimationData;
+    m_pAnimationHeader = pHeader;
+    m_pAnimationFrameData = pFrameData;
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::IsAnimationCompressed()
+{
+    return m_CompressedAnimation.pTracks != NULL;
+}
+
 bool CDXUTSDKMesh::GetAnimationProperties( UINT* pNumKeys, FLOAT* pFrameTime )
 {
     if( m_pAnimationHeader == NULL )
@@ -1725,6 +5311,363 @@ bool CDXUTSDKMesh::GetAnimationProperties( UINT* pNumKeys, FLOAT* pFrameTime )
     return true;
 }
 
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::GetNumAnimationClips()
+{
+    return m_NumAnimationClips;
+}
+
+//--------------------------------------------------------------------------------------
+const SDKMESH_ANIMATION_CLIP* CDXUTSDKMesh::GetAnimationClip( UINT iClip )
+{
+    if( iClip >= m_NumAnimationClips )
+        return NULL;
+    return &m_pAnimationClips[iClip];
+}
+
+//--------------------------------------------------------------------------------------
+// Seconds until a clip's playback loops
+//--------------------------------------------------------------------------------------
+double CDXUTSDKMesh::GetAnimationClipLength( UINT iClip )
+{
+    const SDKMESH_ANIMATION_CLIP* pClip = GetAnimationClip( iClip );
+    if( !pClip || pClip->pHeader->NumAnimationKeys < 2 || pClip->pHeader->AnimationFPS == 0 )
+        return 0.0;
+    return ( double )( pClip->pHeader->NumAnimationKeys - 1 ) / pClip->pHeader->AnimationFPS;
+}
+
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::GetNumInstances()
+{
+    return ( UINT )m_NumInstances;
+}
+
+
+//-------------------------------------------------------------------------------------
+// CDXUTSDKMeshInstance implementation.
+//-------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+CDXUTSDKMeshInstance::CDXUTSDKMeshInstance() : m_pMesh( NULL ),
+                                               m_fTime( 0.0 ),
+                                               m_pLocalFrameMatrices( NULL ),
+                                               m_pWorldPoseFrameMatrices( NULL ),
+                                               m_pTransformedFrameMatrices( NULL )
+{
+    D3DXMatrixIdentity( &m_mWorld );
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTSDKMeshInstance::~CDXUTSDKMeshInstance()
+{
+    Destroy();
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMeshInstance::Create( CDXUTSDKMesh* pMesh )
+{
+    Destroy();
+
+    if( !pMesh || !pMesh->m_pMeshHeader )
+        return E_INVALIDARG;
+
+    UINT NumFrames = pMesh->GetNumFrames();
+    m_pLocalFrameMatrices = new D3DXMATRIX[ NumFrames ];
+    m_pWorldPoseFrameMatrices = new D3DXMATRIX[ NumFrames ];
+    m_pTransformedFrameMatrices = new D3DXMATRIX[ NumFrames ];
+    if( !m_pLocalFrameMatrices || !m_pWorldPoseFrameMatrices || !m_pTransformedFrameMatrices )
+    {
+        Destroy();
+        return E_OUTOFMEMORY;
+    }
+
+    // Frames the animation doesn't reach keep the identity, as they would on the mesh
+    for( UINT i = 0; i < NumFrames; i++ )
+    {
+        D3DXMatrixIdentity( &m_pWorldPoseFrameMatrices[i] );
+        D3DXMatrixIdentity( &m_pTransformedFrameMatrices[i] );
+    }
+
+    m_pMesh = pMesh;
+    InterlockedIncrement( &m_pMesh->m_NumInstances );
+    m_fTime = 0.0;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshInstance::Destroy()
+{
+    if( m_pMesh )
+        InterlockedDecrement( &m_pMesh->m_NumInstances );
+    m_pMesh = NULL;
+
+    SAFE_DELETE_ARRAY( m_pLocalFrameMatrices );
+    SAFE_DELETE_ARRAY( m_pWorldPoseFrameMatrices );
+    SAFE_DELETE_ARRAY( m_pTransformedFrameMatrices );
+}
+
+//--------------------------------------------------------------------------------------
+CDXUTSDKMesh* CDXUTSDKMeshInstance::GetMesh()
+{
+    return m_pMesh;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshInstance::SetWorld( const D3DXMATRIX* pWorld )
+{
+    m_mWorld = *pWorld;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshInstance::SetTime( double fTime )
+{
+    m_fTime = fTime;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshInstance::AdvanceTime( double fElapsedTime )
+{
+    m_fTime += fElapsedTime;
+}
+
+//--------------------------------------------------------------------------------------
+double CDXUTSDKMeshInstance::GetTime()
+{
+    return m_fTime;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshInstance::Evaluate()
+{
+    if( !m_pMesh )
+        return;
+
+    m_pMesh->EvaluatePose( &m_mWorld, m_fTime, m_pLocalFrameMatrices, m_pWorldPoseFrameMatrices,
+                           m_pTransformedFrameMatrices );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMeshInstance::EvaluateBlended( const SDKMESH_ANIMATION_LAYER* pLayers, UINT NumLayers )
+{
+    if( !m_pMesh )
+        return E_FAIL;
+
+    return m_pMesh->EvaluateBlendedPose( &m_mWorld, pLayers, NumLayers, m_pLocalFrameMatrices,
+                                         m_pWorldPoseFrameMatrices, m_pTransformedFrameMatrices );
+}
+
+//--------------------------------------------------------------------------------------
+// A character is a few dozen frames, too little work for a pool thread on its own, so
+// each work item evaluates a run of instances
+//--------------------------------------------------------------------------------------
+#define SDKMESH_INSTANCES_PER_ITEM 16
+
+struct SDKMESH_INSTANCE_BATCH
+{
+    CDXUTSDKMeshInstance** ppInstances;
+    UINT NumInstances;
+};
+
+static void CALLBACK EvaluateInstanceRun( UINT iItem, void* pContext )
+{
+    SDKMESH_INSTANCE_BATCH* pBatch = ( SDKMESH_INSTANCE_BATCH* )pContext;
+    UINT iStart = iItem * SDKMESH_INSTANCES_PER_ITEM;
+    UINT iEnd = min( iStart + SDKMESH_INSTANCES_PER_ITEM, pBatch->NumInstances );
+    for( UINT i = iStart; i < iEnd; i++ )
+        pBatch->ppInstances[i]->Evaluate();
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshInstance::EvaluateBatch( CDXUTSDKMeshInstance** ppInstances, UINT NumInstances )
+{
+    SDKMESH_INSTANCE_BATCH Batch;
+    Batch.ppInstances = ppInstances;
+    Batch.NumInstances = NumInstances;
+
+    UINT NumItems = ( NumInstances + SDKMESH_INSTANCES_PER_ITEM - 1 ) / SDKMESH_INSTANCES_PER_ITEM;
+    DXUTParallelFor( NumItems, EvaluateInstanceRun, &Batch );
+}
+
+//--------------------------------------------------------------------------------------
+const D3DXMATRIX* CDXUTSDKMeshInstance::GetWorldMatrix( UINT iFrameIndex )
+{
+    return &m_pWorldPoseFrameMatrices[iFrameIndex];
+}
+
+//--------------------------------------------------------------------------------------
+const D3DXMATRIX* CDXUTSDKMeshInstance::GetInfluenceMatrix( UINT iFrameIndex )
+{
+    return &m_pTransformedFrameMatrices[iFrameIndex];
+}
+
+//--------------------------------------------------------------------------------------
+const D3DXMATRIX* CDXUTSDKMeshInstance::GetMeshInfluenceMatrix( UINT iMesh, UINT iInfluence )
+{
+    UINT iFrame = m_pMesh->m_pMeshArray[iMesh].pFrameInfluences[ iInfluence ];
+    return &m_pTransformedFrameMatrices[iFrame];
+}
+
+
+//--------------------------------------------------------------------------------------
+// Shared mesh cache. Lookups are by path as given, so the same file reached through
+// two different relative paths is loaded twice. The load options are part of the key:
+// a mesh loaded with other options is a different mesh. Each entry keeps its own copy
+// of the loader callbacks, all NULL when there are none, and holds a reference on its
+// device.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_SHARED_ENTRY
+{
+    WCHAR strFileName[MAX_PATH];
+    ID3D11Device* pDev11;
+    SDKMESH_LOAD_OPTIONS Options;
+    SDKMESH_CALLBACKS11 LoaderCallbacks;
+    CDXUTSDKMesh* pMesh;
+    UINT RefCount;
+};
+
+static CGrowableArray <SDKMESH_SHARED_ENTRY> s_SharedMeshes;
+static SRWLOCK s_SharedMeshLock = SRWLOCK_INIT;
+
+//--------------------------------------------------------------------------------------
+// Field by field, since the struct has padding. The callbacks are compared by value
+// and the LOD settings only when LODs are on.
+//--------------------------------------------------------------------------------------
+static bool SameLoadOptions( const SDKMESH_SHARED_ENTRY* pEntry, const SDKMESH_LOAD_OPTIONS* pOptions,
+                             const SDKMESH_CALLBACKS11* pLoaderCallbacks )
+{
+    const SDKMESH_LOAD_OPTIONS* pA = &pEntry->Options;
+    if( pA->bCreateAdjacencyIndices != pOptions->bCreateAdjacencyIndices || pA->bOptimize != pOptions->bOptimize ||
+        pA->bNarrowIndices != pOptions->bNarrowIndices || pA->bQuantize != pOptions->bQuantize ||
+        pA->bWaitForTextures != pOptions->bWaitForTextures || pA->bLazyBuffers != pOptions->bLazyBuffers )
+        return false;
+
+    if( pA->LODs.NumLODs != pOptions->LODs.NumLODs )
+        return false;
+    if( pA->LODs.NumLODs > 0 &&
+        ( pA->LODs.TriangleRatio != pOptions->LODs.TriangleRatio || pA->LODs.MaxError != pOptions->LODs.MaxError ||
+          pA->LODs.NormalWeight != pOptions->LODs.NormalWeight ||
+          pA->LODs.TexCoordWeight != pOptions->LODs.TexCoordWeight ) )
+        return false;
+
+    const SDKMESH_CALLBACKS11* pB = &pEntry->LoaderCallbacks;
+    return pB->pCreateTextureFromFile == pLoaderCallbacks->pCreateTextureFromFile &&
+           pB->pCreateVertexBuffer == pLoaderCallbacks->pCreateVertexBuffer &&
+           pB->pCreateIndexBuffer == pLoaderCallbacks->pCreateIndexBuffer &&
+           pB->pContext == pLoaderCallbacks->pContext;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DXUTCreateSharedSDKMesh( ID3D11Device* pDev11, LPCTSTR szFileName, CDXUTSDKMesh** ppMesh,
+                                 const SDKMESH_LOAD_OPTIONS* pOptions )
+{
+    if( !pDev11 || !szFileName || !ppMesh )
+        return E_INVALIDARG;
+    *ppMesh = NULL;
+
+    HRESULT hr = S_OK;
+
+    SDKMESH_LOAD_OPTIONS Options;
+    ZeroMemory( &Options, sizeof( SDKMESH_LOAD_OPTIONS ) );
+    if( pOptions )
+        Options = *pOptions;
+
+    SDKMESH_CALLBACKS11 LoaderCallbacks;
+    ZeroMemory( &LoaderCallbacks, sizeof( SDKMESH_CALLBACKS11 ) );
+    if( Options.pLoaderCallbacks )
+        LoaderCallbacks = *Options.pLoaderCallbacks;
+
+    // The lock is held across the load so two threads asking for the same file don't
+    // both read it; loads of different files serialize as a result
+    AcquireSRWLockExclusive( &s_SharedMeshLock );
+
+    for( int i = 0; i < s_SharedMeshes.GetSize(); i++ )
+    {
+        SDKMESH_SHARED_ENTRY& Entry = s_SharedMeshes[i];
+        if( Entry.pDev11 == pDev11 && SameLoadOptions( &Entry, &Options, &LoaderCallbacks ) &&
+            _wcsicmp( Entry.strFileName, szFileName ) == 0 )
+        {
+            Entry.RefCount++;
+            *ppMesh = Entry.pMesh;
+            ReleaseSRWLockExclusive( &s_SharedMeshLock );
+            return S_OK;
+        }
+    }
+
+    SDKMESH_SHARED_ENTRY Entry;
+    ZeroMemory( &Entry, sizeof( SDKMESH_SHARED_ENTRY ) );
+    hr = StringCchCopy( Entry.strFileName, MAX_PATH, szFileName );
+    if( SUCCEEDED( hr ) )
+    {
+        Entry.pMesh = new CDXUTSDKMesh();
+        if( !Entry.pMesh )
+            hr = E_OUTOFMEMORY;
+    }
+    if( SUCCEEDED( hr ) )
+    {
+        CDXUTSDKMesh* pMesh = Entry.pMesh;
+        pMesh->SetOptimizeOnLoad( Options.bOptimize );
+        pMesh->SetNarrowIndicesOnLoad( Options.bNarrowIndices );
+        pMesh->SetQuantizeOnLoad( Options.bQuantize );
+        pMesh->SetAsyncTexturesOnLoad( !Options.bWaitForTextures );
+        pMesh->SetLazyBuffersOnLoad( Options.bLazyBuffers );
+        pMesh->SetLODsOnLoad( Options.LODs.NumLODs > 0 ? &Options.LODs : NULL );
+        hr = pMesh->Create( pDev11, szFileName, Options.bCreateAdjacencyIndices, Options.pLoaderCallbacks );
+    }
+    if( SUCCEEDED( hr ) )
+    {
+        // The entry keeps its own copy of the callbacks, not the caller's pointer
+        Entry.pDev11 = pDev11;
+        Entry.Options = Options;
+        Entry.Options.pLoaderCallbacks = NULL;
+        Entry.LoaderCallbacks = LoaderCallbacks;
+        Entry.RefCount = 1;
+        hr = s_SharedMeshes.Add( Entry );
+    }
+
+    if( SUCCEEDED( hr ) )
+    {
+        pDev11->AddRef();
+        *ppMesh = Entry.pMesh;
+    }
+    else
+        SAFE_DELETE( Entry.pMesh );
+
+    ReleaseSRWLockExclusive( &s_SharedMeshLock );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+void DXUTReleaseSharedSDKMesh( CDXUTSDKMesh* pMesh )
+{
+    if( !pMesh )
+        return;
+
+    CDXUTSDKMesh* pDestroy = NULL;
+    ID3D11Device* pDev11 = NULL;
+
+    AcquireSRWLockExclusive( &s_SharedMeshLock );
+    for( int i = 0; i < s_SharedMeshes.GetSize(); i++ )
+    {
+        if( s_SharedMeshes[i].pMesh == pMesh )
+        {
+            if( --s_SharedMeshes[i].RefCount == 0 )
+            {
+                pDestroy = pMesh;
+                pDev11 = s_SharedMeshes[i].pDev11;
+                s_SharedMeshes.Remove( i );
+            }
+            break;
+        }
+    }
+    ReleaseSRWLockExclusive( &s_SharedMeshLock );
+
+    // Destroy releases device objects, which doesn't need the cache lock. The device
+    // goes last, after everything created on it.
+    SAFE_DELETE( pDestroy );
+    SAFE_RELEASE( pDev11 );
+}
+
 
 //-------------------------------------------------------------------------------------
 // CDXUTXFileMesh implementation.
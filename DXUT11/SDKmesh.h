@@ -13,6 +13,14 @@
 #ifndef _SDKMESH_
 #define _SDKMESH_
 
+#include "SDKmeshCulling.h"
+#include "SDKmeshSkinning.h"
+#include "SDKmeshOptimize.h"
+#include "SDKmeshSimplify.h"
+#include "SDKmeshAdjacency.h"
+#include "SDKmeshTextureLoad.h"
+#include "SDKmeshBVH.h"
+
 //--------------------------------------------------------------------------------------
 // Hard Defines for the various structures
 //--------------------------------------------------------------------------------------
@@ -255,8 +263,65 @@ struct SDKANIMATION_FRAME_DATA
     };
 };
 
+#include "SDKmeshAnimation.h"
+#include "SDKmeshQuantize.h"
+#include "SDKmeshDrawList.h"
+#include "SDKmeshInstancing.h"
+#include "SDKmeshFrameIndex.h"
+#include "SDKmeshResidency.h"
+
 #ifndef _CONVERTER_APP_
 
+//--------------------------------------------------------------------------------------
+// Bounds computed at load time for each subset (not part of the file format). The
+// sphere shares the box's center and encloses every vertex in the subset's range.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_SUBSET_BOUNDS
+{
+    D3DXVECTOR3 BoundingBoxCenter;
+    D3DXVECTOR3 BoundingBoxExtents;
+    float BoundingSphereRadius;
+};
+
+//--------------------------------------------------------------------------------------
+// Levels of detail built by CDXUTSDKMesh::GenerateLODs. Each level is one index buffer
+// over the mesh's own vertices holding all of the mesh's subsets in order. Errors and
+// weights are fractions of the mesh's bounding box half diagonal.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_LOD_SETTINGS
+{
+    UINT NumLODs;           // levels after the full detail one
+    float TriangleRatio;    // triangles kept by each level, relative to the level before
+    float MaxError;
+    float NormalWeight;
+    float TexCoordWeight;
+};
+
+#define SDKMESH_DEFAULT_LOD_COUNT           4
+#define SDKMESH_DEFAULT_LOD_TRIANGLE_RATIO  0.5f
+#define SDKMESH_DEFAULT_LOD_MAX_ERROR       0.1f
+#define SDKMESH_DEFAULT_LOD_NORMAL_WEIGHT   0.05f
+#define SDKMESH_DEFAULT_LOD_TEXCOORD_WEIGHT 0.05f
+
+struct SDKMESH_LOD
+{
+    SDKMESH_INDEX_BUFFER_HEADER IndexBuffer;    // same index type as the mesh's own
+    BYTE* pIndices;
+    UINT* pSubsetIndices;   // IndexStart and IndexCount of each of the mesh's subsets
+    float Error;            // largest simplification error so far, in model units
+};
+
+//--------------------------------------------------------------------------------------
+// How animation keys are blended between ticks. STEP holds each key for a whole tick,
+// which is how the class has always played animations back.
+//--------------------------------------------------------------------------------------
+enum SDKMESH_ANIMATION_INTERPOLATION
+{
+    SDKMESH_INTERPOLATE_STEP = 0,
+    SDKMESH_INTERPOLATE_NLERP,
+    SDKMESH_INTERPOLATE_SLERP,
+};
+
 //--------------------------------------------------------------------------------------
 // AsyncLoading callbacks
 //--------------------------------------------------------------------------------------
@@ -296,17 +361,23 @@ struct SDKMESH_CALLBACKS11
 //--------------------------------------------------------------------------------------
 class CDXUTSDKMesh
 {
+    friend class CDXUTSDKMeshInstance;
+
 private:
     UINT m_NumOutstandingResources;
+    volatile LONG m_NumInstances;
     bool m_bLoading;
     //BYTE*                         m_pBufferData;
     HANDLE m_hFile;
     HANDLE m_hFileMappingObject;
     CGrowableArray <BYTE*> m_MappedPointers;
+    UINT64 m_MappedBytes;
     IDirect3DDevice9* m_pDev9;
     ID3D11Device* m_pDev11;
     ID3D11DeviceContext* m_pDevContext11;
 
+    void                            UnmapFile();
+
 protected:
     //These are the pointers to the two chunks of data loaded in from the mesh file
     BYTE* m_pStaticMeshData;
@@ -331,19 +402,97 @@ protected:
     // Adjacency information (not part of the m_pStaticMeshData, so it must be created and destroyed separately )
     SDKMESH_INDEX_BUFFER_HEADER* m_pAdjacencyIndexBufferArray;
 
-    //Animation (TODO: Add ability to load/track multiple animation sets)
+    // Bounds for each entry of m_pSubsetArray
+    SDKMESH_SUBSET_BOUNDS* m_pSubsetBounds;
+
+    // Culling: one box for each frame's mesh followed by one for each of its subsets.
+    // m_pFrameCullBox holds the index of a frame's first box, or INVALID_FRAME.
+    SDKMESH_CULL_BOXES m_CullBoxes;
+    UINT* m_pFrameCullBox;
+    DWORD* m_pVisibleBits;
+    bool m_bCullBoxesLocal;
+    bool m_bCullingActive;
+
+    //Load-time vertex cache optimization and what it measured
+    bool m_bOptimizeOnLoad;
+    SDKMESH_VERTEX_CACHE_STATS m_VertexCacheStats;
+
+    //Load-time narrowing of 32 bit index buffers that fit in 16 bits
+    bool m_bNarrowIndicesOnLoad;
+
+    //Load-time vertex quantization: a packed layout for each vertex buffer (StrideBytes
+    //is 0 for buffers left as they were), or NULL when it's off
+    bool m_bQuantizeOnLoad;
+    SDKMESH_QUANTIZED_STREAM* m_pQuantizedStreams;
+    SDKMESH_QUANTIZATION_STATS m_QuantizationStats;
+
+    //Material textures still loading in the background, or NULL
+    bool m_bAsyncTexturesOnLoad;
+    SDKMESH_TEXTURE_LOADER* m_pTextureLoader;
+    SDKMESH_TEXTURE_LOAD_STATS m_TextureLoadStats;
+
+    //Levels of detail: m_MaxLODs slots for each mesh, of which the first m_pMeshLODs[i]
+    //are filled. Level 0 is the mesh itself and isn't stored.
+    SDKMESH_LOD* m_pLODs;
+    UINT* m_pMeshLODs;
+    UINT m_MaxLODs;
+    SDKMESH_LOD_SETTINGS m_LoadLODSettings;
+    bool m_bLODSelection;
+    D3DXVECTOR3 m_vLODEye;
+    float m_fLODPixelsPerUnit;
+    float m_fLODMaxPixelError;
+
+    //Instance data for RenderInstanced, created on first use
+    SDKMESH_INSTANCE_RING m_InstanceRing;
+
+    //Ray casting hierarchies, one for each mesh, or NULL until they're built or loaded
+    SDKMESH_BVH* m_pBVHs;
+
+    //Lazily created buffers. m_Residency.pMeshResident is NULL when the load created
+    //them all.
+    bool m_bLazyBuffersOnLoad;
+    SDKMESH_RESIDENCY m_Residency;
+
+    //Animation from LoadAnimation, which TransformMesh plays
     SDKANIMATION_FILE_HEADER* m_pAnimationHeader;
     SDKANIMATION_FRAME_DATA* m_pAnimationFrameData;
+    SDKMESH_ANIMATION_INTERPOLATION m_AnimationInterpolation;
+
+    //Once CompressAnimation has run the keys come from here and the frame data's
+    //pAnimationData pointers are NULL
+    SDKMESH_COMPRESSED_ANIMATION m_CompressedAnimation;
+
+    //Further animations loaded as clips for TransformMeshBlended, and each frame's own
+    //transform taken apart, which is made along with the first clip
+    SDKMESH_ANIMATION_CLIP* m_pAnimationClips;
+    UINT m_NumAnimationClips;
+    SDKMESH_FRAME_TRS* m_pFrameRestPose;
+
     D3DXMATRIX* m_pBindPoseFrameMatrices;
     D3DXMATRIX* m_pTransformedFrameMatrices;
     D3DXMATRIX* m_pWorldPoseFrameMatrices;
 
+    //Frames reachable from frame 0 in parent-before-child order, built at load so the
+    //hierarchy can be transformed in one linear pass. The arrays are indexed by position
+    //in that order except m_pFrameOrderPos, which maps a frame to its position.
+    UINT m_NumOrderedFrames;
+    UINT* m_pFrameOrder;            // frame at each position
+    UINT* m_pFrameOrderParent;      // position of the parent, or INVALID_FRAME
+    UINT* m_pFrameOrderEnd;         // one past the last descendant
+    UINT* m_pFrameOrderPos;         // INVALID_FRAME for frames that can't be reached
+    D3DXMATRIX* m_pFrameOrderLocal; // local matrices, filled in by each transform pass
+
+    //Frame names hashed at load for FindFrame
+    SDKMESH_FRAME_INDEX m_FrameIndex;
+
 protected:
     void                            LoadMaterials( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pMaterials,
                                                    UINT NumMaterials, SDKMESH_CALLBACKS11* pLoaderCallbacks=NULL );
 
     void                            LoadMaterials( IDirect3DDevice9* pd3dDevice, SDKMESH_MATERIAL* pMaterials,
                                                    UINT NumMaterials, SDKMESH_CALLBACKS9* pLoaderCallbacks=NULL );
+    HRESULT                         BeginTextureLoads( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pMaterials,
+                                                       UINT NumMaterials );
 
     HRESULT                         CreateVertexBuffer( ID3D11Device* pd3dDevice,
                                                         SDKMESH_VERTEX_BUFFER_HEADER* pHeader, void* pVertices,
@@ -374,18 +523,68 @@ protected:
                                                       SDKMESH_CALLBACKS11* pLoaderCallbacks11 = NULL,
                                                       SDKMESH_CALLBACKS9* pLoaderCallbacks9 = NULL );
 
+    HRESULT                         CreateAdjacencyIndices( ID3D11Device* pd3dDevice );
+    HRESULT                         ComputeBoundingVolumes();
+    HRESULT                         OptimizeVertexCache();
+    HRESULT                         NarrowIndexBuffers();
+    HRESULT                         QuantizeVertexStreams();
+    HRESULT                         CreateMeshResidency();
+    void                            DestroyMeshResidency();
+    static HRESULT CALLBACK         CreateLazyBuffer( bool bVertices, UINT iBuffer, void* pContext,
+                                                      UINT64* pSizeBytes );
+    static void CALLBACK            ReleaseLazyBuffer( bool bVertices, UINT iBuffer, void* pContext );
+    UINT                            GetBufferStride( UINT iVB );
+    HRESULT                         GetBVHTriangles( UINT iMesh, SDKMESH_BVH_TRIANGLE** ppTriangles,
+                                                     UINT* pNumTriangles );
+    HRESULT                         GetBVHFingerprint( UINT iMesh, UINT* pNumTriangles, UINT64* pHash );
+    const SDKMESH_LOD*              GetFrameLOD( UINT iMesh, UINT iFrame );
+    HRESULT                         CreateCullBoxes();
+    HRESULT                         CreateFrameOrder();
+    void                            GetFrameOrderRange( UINT iFrame, UINT* pStart, UINT* pEnd );
+    void                            GetAnimationKey( UINT iAnimationData, UINT iKey, __m128* pTranslation,
+                                                     __m128* pRotation, __m128* pScale );
+    void                            GetAnimatedLocalTransform( UINT iFrame, UINT iKey0, UINT iKey1, float fBlend,
+                                                               D3DXMATRIX* pLocal );
+
     //frame manipulation
     void                            TransformBindPoseFrame( UINT iFrame, D3DXMATRIX* pParentWorld );
     void                            TransformFrame( UINT iFrame, D3DXMATRIX* pParentWorld, double fTime );
     void                            TransformFrameAbsolute( UINT iFrame, double fTime );
+    void                            TransformFrameAbsolute( UINT iFrame, UINT iKey0, UINT iKey1, float fBlend,
+                                                            D3DXMATRIX* pTransformed );
+    void                            TransformFrameRange( UINT iFrame, const D3DXMATRIX* pParentWorld, UINT iKey0,
+                                                         UINT iKey1, float fBlend, D3DXMATRIX* pLocal,
+                                                         D3DXMATRIX* pWorldPose, D3DXMATRIX* pTransformed );
+    void                            EvaluatePose( const D3DXMATRIX* pWorld, double fTime, D3DXMATRIX* pLocal,
+                                                  D3DXMATRIX* pWorldPose, D3DXMATRIX* pTransformed );
+    void                            ConcatenateFrameRange( UINT Start, UINT End, const D3DXMATRIX* pParentWorld,
+                                                           const D3DXMATRIX* pLocal, D3DXMATRIX* pWorldPose,
+                                                           D3DXMATRIX* pTransformed );
+    void                            ApplyInverseBindPose( D3DXMATRIX* pTransformed );
+    HRESULT                         CreateFrameRestPose();
+    void                            GetBlendedLocalTransforms( const SDKMESH_ANIMATION_LAYER* pLayers,
+                                                               UINT NumLayers, D3DXMATRIX* pLocal );
+    HRESULT                         EvaluateBlendedPose( const D3DXMATRIX* pWorld,
+                                                         const SDKMESH_ANIMATION_LAYER* pLayers, UINT NumLayers,
+                                                         D3DXMATRIX* pLocal, D3DXMATRIX* pWorldPose,
+                                                         D3DXMATRIX* pTransformed );
 
     //Direct3D 11 rendering helpers
+    void                            SetMeshBuffers11( UINT iMesh, const SDKMESH_INDEX_BUFFER_HEADER* pIndexBuffer,
+                                                      bool bVertexBuffers, ID3D11DeviceContext* pd3dDeviceContext );
     void                            RenderMesh( UINT iMesh,
                                                 bool bAdjacent,
                                                 ID3D11DeviceContext* pd3dDeviceContext,
                                                 UINT iDiffuseSlot,
                                                 UINT iNormalSlot,
-                                                UINT iSpecularSlot );
+                                                UINT iSpecularSlot,
+                                                UINT iFrame = INVALID_FRAME );
+    void                            RenderMeshInstanced( UINT iMesh,
+                                                         UINT NumInstances,
+                                                         ID3D11DeviceContext* pd3dDeviceContext,
+                                                         UINT iDiffuseSlot,
+                                                         UINT iNormalSlot,
+                                                         UINT iSpecularSlot );
     void                            RenderFrame( UINT iFrame,
                                                  bool bAdjacent,
                                                  ID3D11DeviceContext* pd3dDeviceContext,
@@ -401,7 +600,8 @@ protected:
                                                 D3DXHANDLE hTechnique,
                                                 D3DXHANDLE htxDiffuse,
                                                 D3DXHANDLE htxNormal,
-                                                D3DXHANDLE htxSpecular );
+                                                D3DXHANDLE htxSpecular,
+                                                UINT iFrame = INVALID_FRAME );
     void                            RenderFrame( UINT iFrame,
                                                  LPDIRECT3DDEVICE9 pd3dDevice,
                                                  LPD3DXEFFECT pEffect,
@@ -425,12 +625,139 @@ public:
                                             bool bCreateAdjacencyIndices=false, bool bCopyStatic=false,
                                             SDKMESH_CALLBACKS9* pLoaderCallbacks=NULL );
     virtual HRESULT                 LoadAnimation( WCHAR* szFileName );
-    virtual void                    Destroy();
+    //Fails, leaving the mesh loaded, while instances still use it or CheckLoadDone is false
+    virtual HRESULT                 Destroy();
 
     //Frame manipulation
     void                            TransformBindPose( D3DXMATRIX* pWorld );
     void                            TransformMesh( D3DXMATRIX* pWorld, double fTime );
 
+    //Culling. Cull tests every frame's mesh and subset boxes against the frustum of
+    //pWorldViewProj and Render skips whatever is outside until the next Cull or
+    //DisableCulling. Boxes are in object space unless pFrameMatrices is given, in which
+    //case frame i's boxes are transformed by pFrameMatrices[i] first (GetWorldMatrix( 0 )
+    //after TransformMesh, for example). Returns the number of visible subsets.
+    UINT                            Cull( const D3DXMATRIX* pWorldViewProj, const D3DXMATRIX* pFrameMatrices = NULL );
+    void                            DisableCulling();
+    const DWORD*                    GetVisibilityMask();
+    UINT                            GetFrameCullBox( UINT iFrame );
+    bool                            IsMeshVisible( UINT iFrame );
+    bool                            IsSubsetVisible( UINT iFrame, UINT iSubset );
+
+    //Load-time vertex cache optimization. When turned on before Create, each triangle
+    //list subset's triangles are reordered for the post-transform cache and its vertices
+    //for fetch locality (see SDKmeshOptimize.h) before the buffers are created. The
+    //vertex and index data are rewritten in place, including memory passed to Create.
+    void                            SetOptimizeOnLoad( bool bOptimize );
+    bool                            GetOptimizeOnLoad();
+    const SDKMESH_VERTEX_CACHE_STATS* GetVertexCacheStats();
+
+    //Index narrowing. When turned on before Create, 32 bit index buffers whose subsets
+    //all span fewer than 65535 vertices are rewritten as 16 bit, moving a subset's
+    //lowest index into its VertexStart where that's what makes it fit. Off by default,
+    //since it changes the index types and subset ranges callers see.
+    void                            SetNarrowIndicesOnLoad( bool bNarrow );
+    bool                            GetNarrowIndicesOnLoad();
+
+    //Vertex quantization. With SetQuantizeOnLoad( true ) each Create packs the vertex
+    //buffers it creates as SDKmeshQuantize.h describes, roughly halving their size; the
+    //CPU side keeps the file's float vertices, and GetVertexStride and the vertex buffer
+    //headers go on describing those. GetQuantizedStream has the packed Decl, stride and
+    //input layout to bind and build shaders against, or NULL for a buffer that wasn't
+    //packed.
+    void                            SetQuantizeOnLoad( bool bQuantize );
+    bool                            GetQuantizeOnLoad();
+    const SDKMESH_QUANTIZED_STREAM* GetQuantizedStream( UINT iMesh, UINT iVB );
+    const SDKMESH_QUANTIZATION_STATS* GetQuantizationStats();
+
+    //Material textures. Without texture loader callbacks a Direct3D 11 Create loads each
+    //distinct texture file once, across the thread pool, and by default returns before
+    //they're done: materials fill in as their loads finish and CheckLoadDone turns true
+    //once all have. SetAsyncTexturesOnLoad( false ) makes Create wait for them instead.
+    //On DXUT's device, files are shared with other meshes through the resource cache.
+    void                            SetAsyncTexturesOnLoad( bool bAsync );
+    bool                            GetAsyncTexturesOnLoad();
+    void                            WaitForTextures();
+    const SDKMESH_TEXTURE_LOAD_STATS* GetTextureLoadStats();
+
+    //Levels of detail. GenerateLODs simplifies each triangle list subset into up to
+    //NumLODs coarser index buffers over the same vertices (see SDKmeshSimplify.h), keeping
+    //the vertices subsets share so neighbouring subsets stay joined, and creates them on
+    //the mesh's device. pSettings may be NULL for the defaults. A subset that can't be
+    //simplified, such as one whose indices run past its vertex buffer, keeps its own
+    //indices in every level. SetLODsOnLoad does the same at the end of each Create; a
+    //cooking tool can write out GetLOD's indices.
+    HRESULT                         GenerateLODs( const SDKMESH_LOD_SETTINGS* pSettings = NULL );
+    void                            SetLODsOnLoad( const SDKMESH_LOD_SETTINGS* pSettings );
+    void                            DestroyLODs();
+    UINT                            GetNumLODs( UINT iMesh );
+    const SDKMESH_LOD*              GetLOD( UINT iMesh, UINT iLOD );
+    float                           GetLODError( UINT iMesh, UINT iLOD );
+
+    //LOD selection. Once SetLODView is called, rendering draws each frame's mesh at the
+    //coarsest level whose error, projected from the nearest point of the mesh's bounds
+    //to pEye, stays within fMaxPixelError pixels. pEye is in the space of the frame
+    //world matrices (world space after TransformMesh); fPixelsPerUnit is the viewport
+    //height over 2 * tan( FovY / 2 ). SelectLOD applies the same test to a distance.
+    void                            SetLODView( const D3DXVECTOR3* pEye, float fPixelsPerUnit,
+                                                float fMaxPixelError = 1.0f );
+    void                            DisableLODSelection();
+    UINT                            SelectLOD( UINT iMesh, float fDistance );
+
+    //Ray casting. BuildBVHs builds a triangle hierarchy (see SDKmeshBVH.h) over the
+    //triangle list subsets of each mesh, in the space of its vertex data, which is the
+    //bind pose. SaveBVHs writes them all to one file that LoadBVHs reads back, so a tool
+    //can build them once; LoadBVHs fails on a file saved from other triangles.
+    //IntersectRay numbers the hit subset as GetSubset does.
+    HRESULT                         BuildBVHs();
+    void                            DestroyBVHs();
+    HRESULT                         SaveBVHs( LPCTSTR szFileName );
+    HRESULT                         LoadBVHs( LPCTSTR szFileName );
+    const SDKMESH_BVH*              GetBVH( UINT iMesh );
+    bool                            IntersectRay( UINT iMesh, const D3DXVECTOR3* pOrigin,
+                                                  const D3DXVECTOR3* pDirection, float fMaxDistance,
+                                                  bool bAnyHit, SDKMESH_RAY_HIT* pHit );
+
+    //Lazy buffers. With SetLazyBuffersOnLoad( true ) Create only reads the header section
+    //and a mesh's vertex and index buffers are created the first time it's rendered or
+    //PrefetchMesh is called, straight from the mapped file, whose pages are then dropped.
+    //EvictMesh releases the buffers again. Until then GetVB11 and friends return NULL.
+    //Culling uses the boxes stored in the file, and the optimize, narrow and quantize
+    //passes are skipped since they rewrite every buffer. Adjacency isn't built either,
+    //since it reads every index, so adjacent rendering draws nothing and GetAdjIB11
+    //returns NULL; GenerateLODs still reads all the indices. Loader callbacks that
+    //create buffers turn lazy buffers off, and so does CreateFromMemory with bCopyStatic,
+    //since the caller may free the buffer data once Create returns.
+    //Residency isn't locked, so prefetch and render from one thread.
+    void                            SetLazyBuffersOnLoad( bool bLazy );
+    bool                            GetLazyBuffersOnLoad();
+    HRESULT                         PrefetchMesh( UINT iMesh );
+    void                            EvictMesh( UINT iMesh );
+    void                            EvictAllMeshes();
+    bool                            IsMeshResident( UINT iMesh );
+    const SDKMESH_STREAMING_STATS*  GetStreamingStats();
+
+    //Sorted drawing. GatherDraws refills pList with a record for every subset Render
+    //would draw, with the same culling and LOD selection, and sorts it into its command
+    //stream (see SDKmeshDrawList.h). ExecuteDrawList replays that stream on the context,
+    //setting only the state that changes. Direct3D 11 only.
+    HRESULT                         GatherDraws( SDKMESH_DRAW_LIST* pList, bool bAdjacent = false );
+    void                            ExecuteDrawList( const SDKMESH_DRAW_LIST* pList,
+                                                     ID3D11DeviceContext* pd3dDeviceContext,
+                                                     UINT iDiffuseSlot = INVALID_SAMPLER_SLOT,
+                                                     UINT iNormalSlot = INVALID_SAMPLER_SLOT,
+                                                     UINT iSpecularSlot = INVALID_SAMPLER_SLOT,
+                                                     SDKMESH_DRAW_EXECUTE_STATS* pStats = NULL );
+
+    //CPU skinning. Skins every vertex of mesh iMesh by its frame influences, taken from
+    //pFrameMatrices indexed by frame (GetInfluenceMatrix( 0 ) of the mesh or of an
+    //instance) or from the last TransformMesh when it is NULL. Each output holds
+    //GetNumVertices( iMesh, 0 ) vectors and may be NULL. A mesh without influences comes
+    //out in its bind pose.
+    HRESULT                         SkinMesh( UINT iMesh, D3DXVECTOR3* pPositions, D3DXVECTOR3* pNormals = NULL,
+                                              D3DXVECTOR3* pTangents = NULL,
+                                              const D3DXMATRIX* pFrameMatrices = NULL );
+
 
     //Direct3D 11 Rendering
     virtual void                    Render( ID3D11DeviceContext* pd3dDeviceContext,
@@ -442,6 +769,20 @@ public:
                                                     UINT iNormalSlot = INVALID_SAMPLER_SLOT,
                                                     UINT iSpecularSlot = INVALID_SAMPLER_SLOT );
 
+    //Draws NumInstances copies of the mesh with one DrawIndexedInstanced per subset,
+    //streaming each copy's world matrix and InstanceDataStride bytes of pInstanceData
+    //(which may be NULL) through a ring buffer as SDKmeshInstancing.h lays out. Copies
+    //are drawn at full detail and aren't culled, since the visibility mask and LOD
+    //selection describe a single placement.
+    HRESULT                         RenderInstanced( ID3D11DeviceContext* pd3dDeviceContext,
+                                                     const D3DXMATRIX* pWorlds,
+                                                     UINT NumInstances,
+                                                     const void* pInstanceData = NULL,
+                                                     UINT InstanceDataStride = 0,
+                                                     UINT iDiffuseSlot = INVALID_SAMPLER_SLOT,
+                                                     UINT iNormalSlot = INVALID_SAMPLER_SLOT,
+                                                     UINT iSpecularSlot = INVALID_SAMPLER_SLOT );
+
     //Direct3D 9 Rendering
     virtual void                    Render( LPDIRECT3DDEVICE9 pd3dDevice,
                                             LPD3DXEFFECT pEffect,
@@ -488,11 +829,14 @@ public:
     UINT                            GetVertexStride( UINT iMesh, UINT iVB );
     UINT                            GetNumFrames();
     SDKMESH_FRAME*                  GetFrame( UINT iFrame );
-    SDKMESH_FRAME*                  FindFrame( char* pszName );
+    SDKMESH_FRAME*                  FindFrame( const char* pszName );
+    UINT                            FindFrameIndex( const char* pszName );
+    UINT                            FindFrameIndex( const SDKMESH_FRAME_NAME* pName );
     UINT64                          GetNumVertices( UINT iMesh, UINT iVB );
     UINT64                          GetNumIndices( UINT iMesh );
     D3DXVECTOR3                     GetMeshBBoxCenter( UINT iMesh );
     D3DXVECTOR3                     GetMeshBBoxExtents( UINT iMesh );
+    const SDKMESH_SUBSET_BOUNDS*    GetSubsetBounds( UINT iMesh, UINT iSubset );
     UINT                            GetOutstandingResources();
     UINT                            GetOutstandingBufferResources();
     bool                            CheckLoadDone();
@@ -505,11 +849,112 @@ public:
     UINT                            GetNumInfluences( UINT iMesh );
     const D3DXMATRIX*               GetMeshInfluenceMatrix( UINT iMesh, UINT iInfluence );
     UINT                            GetAnimationKeyFromTime( double fTime );
+    void                            GetAnimationKeysFromTime( double fTime, UINT* piKey0, UINT* piKey1,
+                                                              float* pfBlend );
+    void                            SetAnimationInterpolation( SDKMESH_ANIMATION_INTERPOLATION Interpolation );
+    SDKMESH_ANIMATION_INTERPOLATION GetAnimationInterpolation();
+
+    //Replaces the loaded keys with a compressed copy (see SDKmeshAnimation.h) and frees
+    //them. pSettings may be NULL for the default error bounds.
+    HRESULT                         CompressAnimation( const SDKMESH_ANIMATION_COMPRESSION* pSettings = NULL,
+                                                       SDKMESH_ANIMATION_COMPRESSION_STATS* pStats = NULL );
+    bool                            IsAnimationCompressed();
     const D3DXMATRIX*               GetWorldMatrix( UINT iFrameIndex );
     const D3DXMATRIX*               GetInfluenceMatrix( UINT iFrameIndex );
     bool                            GetAnimationProperties( UINT* pNumKeys, FLOAT* pFrameTime );
+    UINT                            GetNumInstances();
+
+    //Animation clips. LoadAnimationClip adds an animation file as one more clip, bound
+    //to the frames by name, without touching what LoadAnimation set up. Clips must use
+    //relative frame transforms. TransformMeshBlended blends up to
+    //SDKMESH_MAX_ANIMATION_LAYERS layers over the clips (see SDKMESH_ANIMATION_LAYER)
+    //and leaves the pose where TransformMesh does. Keys within a clip are interpolated
+    //as SetAnimationInterpolation says.
+    HRESULT                         LoadAnimationClip( WCHAR* szFileName, UINT* piClip = NULL );
+    void                            DestroyAnimationClips();
+    UINT                            GetNumAnimationClips();
+    const SDKMESH_ANIMATION_CLIP*   GetAnimationClip( UINT iClip );
+    double                          GetAnimationClipLength( UINT iClip );
+    HRESULT                         TransformMeshBlended( const D3DXMATRIX* pWorld,
+                                                          const SDKMESH_ANIMATION_LAYER* pLayers, UINT NumLayers );
+};
+
+//--------------------------------------------------------------------------------------
+// Per-character animation state for a shared CDXUTSDKMesh. The mesh keeps the buffers,
+// materials, frames and keys; an instance only holds its world matrix, animation time
+// and pose, so a crowd costs one load plus a few matrices per frame per character.
+// The mesh must outlive its instances.
+//--------------------------------------------------------------------------------------
+class CDXUTSDKMeshInstance
+{
+public:
+                                    CDXUTSDKMeshInstance();
+                                    ~CDXUTSDKMeshInstance();
+
+    HRESULT                         Create( CDXUTSDKMesh* pMesh );
+    void                            Destroy();
+    CDXUTSDKMesh*                   GetMesh();
+
+    void                            SetWorld( const D3DXMATRIX* pWorld );
+    void                            SetTime( double fTime );
+    void                            AdvanceTime( double fElapsedTime );
+    double                          GetTime();
+
+    // Same as CDXUTSDKMesh::TransformMesh with this instance's world matrix and time
+    void                            Evaluate();
+
+    // Same as CDXUTSDKMesh::TransformMeshBlended with this instance's world matrix. The
+    // layers carry their own times.
+    HRESULT                         EvaluateBlended( const SDKMESH_ANIMATION_LAYER* pLayers, UINT NumLayers );
+
+    // Evaluates every instance, spread across the thread pool
+    static void                     EvaluateBatch( CDXUTSDKMeshInstance** ppInstances, UINT NumInstances );
+
+    const D3DXMATRIX*               GetWorldMatrix( UINT iFrameIndex );
+    const D3DXMATRIX*               GetInfluenceMatrix( UINT iFrameIndex );
+    const D3DXMATRIX*               GetMeshInfluenceMatrix( UINT iMesh, UINT iInfluence );
+
+protected:
+    CDXUTSDKMesh* m_pMesh;
+    D3DXMATRIX m_mWorld;
+    double m_fTime;
+    D3DXMATRIX* m_pLocalFrameMatrices;
+    D3DXMATRIX* m_pWorldPoseFrameMatrices;
+    D3DXMATRIX* m_pTransformedFrameMatrices;
 };
 
+//--------------------------------------------------------------------------------------
+// How DXUTCreateSharedSDKMesh loads a mesh: Create's arguments and the Set*OnLoad
+// options. A zeroed struct, like a NULL pointer, gives a default CDXUTSDKMesh load.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_LOAD_OPTIONS
+{
+    bool bCreateAdjacencyIndices;
+    bool bOptimize;                         // SetOptimizeOnLoad
+    bool bNarrowIndices;                    // SetNarrowIndicesOnLoad
+    bool bQuantize;                         // SetQuantizeOnLoad
+    bool bWaitForTextures;                  // SetAsyncTexturesOnLoad( false )
+    bool bLazyBuffers;                      // SetLazyBuffersOnLoad
+    SDKMESH_LOD_SETTINGS LODs;              // SetLODsOnLoad, none when NumLODs is 0
+    SDKMESH_CALLBACKS11* pLoaderCallbacks;  // may be NULL, compared by value
+};
+
+//--------------------------------------------------------------------------------------
+// Meshes shared by file name, device and load options. Every successful create must be
+// matched by a release; the mesh is destroyed with the last one. The cache keeps the
+// device alive until then.
+//
+// Everyone holding a shared mesh sees the same CDXUTSDKMesh, so what its calls change
+// is seen by all of them: the pose left by TransformMesh, the visible bits from Cull,
+// the LOD eye from SetLODView, RenderInstanced's instance ring, and which meshes are
+// resident after PrefetchMesh and EvictMesh. Keep each character's pose in its own
+// CDXUTSDKMeshInstance, and have one owner drive culling, LOD selection, instanced
+// rendering and residency for everyone, or call them right before each user's draws.
+//--------------------------------------------------------------------------------------
+HRESULT DXUTCreateSharedSDKMesh( ID3D11Device* pDev11, LPCTSTR szFileName, CDXUTSDKMesh** ppMesh,
+                                 const SDKMESH_LOAD_OPTIONS* pOptions = NULL );
+void DXUTReleaseSharedSDKMesh( CDXUTSDKMesh* pMesh );
+
 //-----------------------------------------------------------------------------
 // Name: class CDXUTXFileMesh
 // Desc: Class for loading and rendering file-based meshes
@@ -0,0 +1,190 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshAdjacency.cpp
+//
+// Triangle adjacency for .sdkmesh triangle lists
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKmeshAdjacency.h"
+
+#define ADJACENCY_NONE      0xffffffff
+#define ADJACENCY_EMPTY_KEY 0xffffffffffffffffULL
+
+//--------------------------------------------------------------------------------------
+// A directed edge between two welded vertices and the far vertex of its triangle
+//--------------------------------------------------------------------------------------
+struct ADJACENCY_EDGE
+{
+    UINT64 Key;
+    UINT Opposite;
+};
+
+static inline UINT64 EdgeKey( UINT From, UINT To )
+{
+    return ( ( UINT64 )From << 32 ) | To;
+}
+
+static inline UINT HashEdge( UINT64 Key, UINT Mask )
+{
+    return ( UINT )( ( Key * 0x9e3779b97f4a7c15ULL ) >> 32 ) & Mask;
+}
+
+//--------------------------------------------------------------------------------------
+// Maps each vertex to the first vertex with the same position bits
+//--------------------------------------------------------------------------------------
+static HRESULT WeldPositions( const BYTE* pPositions, UINT PositionStride, UINT NumVertices, UINT* pWeld )
+{
+    if( !pPositions )
+    {
+        for( UINT v = 0; v < NumVertices; v++ )
+            pWeld[v] = v;
+        return S_OK;
+    }
+
+    UINT TableSize = 1;
+    while( TableSize < NumVertices * 2 )
+        TableSize *= 2;
+
+    UINT* pTable = new UINT[TableSize];
+    float* pFolded = new float[( SIZE_T )NumVertices * 3];
+    if( !pTable || !pFolded )
+    {
+        SAFE_DELETE_ARRAY( pTable );
+        SAFE_DELETE_ARRAY( pFolded );
+        return E_OUTOFMEMORY;
+    }
+    memset( pTable, 0xff, sizeof( UINT ) * TableSize );
+
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        // Adding zero folds -0 into 0 so the hash sees them as equal
+        const float* p = ( const float* )( pPositions + ( SIZE_T )v * PositionStride );
+        float* pFold = &pFolded[( SIZE_T )v * 3];
+        pFold[0] = p[0] + 0.0f;
+        pFold[1] = p[1] + 0.0f;
+        pFold[2] = p[2] + 0.0f;
+
+        const UINT* pBits = ( const UINT* )pFold;
+        UINT Hash = ( pBits[0] * 73856093 ) ^ ( pBits[1] * 19349663 ) ^ ( pBits[2] * 83492791 );
+        for( UINT Slot = Hash & ( TableSize - 1 );; Slot = ( Slot + 1 ) & ( TableSize - 1 ) )
+        {
+            UINT Other = pTable[Slot];
+            if( Other == ADJACENCY_NONE )
+            {
+                pTable[Slot] = v;
+                pWeld[v] = v;
+                break;
+            }
+            if( memcmp( &pFolded[( SIZE_T )Other * 3], pFold, sizeof( float ) * 3 ) == 0 )
+            {
+                pWeld[v] = Other;
+                break;
+            }
+        }
+    }
+
+    delete []pTable;
+    delete []pFolded;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshGenerateAdjacency( const BYTE* pPositions, UINT PositionStride, UINT NumVertices,
+                                  const UINT* pIndices, UINT NumIndices, UINT* pAdjacency )
+{
+    if( !pIndices || !pAdjacency )
+        return E_INVALIDARG;
+
+    NumIndices = NumIndices / 3 * 3;
+    for( UINT i = 0; i < NumIndices; i++ )
+    {
+        if( pIndices[i] >= NumVertices )
+            return E_INVALIDARG;
+    }
+    if( NumIndices == 0 )
+        return S_OK;
+
+    UINT TableSize = 1;
+    while( TableSize < NumIndices * 2 )
+        TableSize *= 2;
+
+    UINT* pWeld = new UINT[NumVertices];
+    ADJACENCY_EDGE* pTable = new ADJACENCY_EDGE[TableSize];
+    if( !pWeld || !pTable )
+    {
+        SAFE_DELETE_ARRAY( pWeld );
+        SAFE_DELETE_ARRAY( pTable );
+        return E_OUTOFMEMORY;
+    }
+
+    HRESULT hr = WeldPositions( pPositions, PositionStride, NumVertices, pWeld );
+    if( FAILED( hr ) )
+    {
+        delete []pWeld;
+        delete []pTable;
+        return hr;
+    }
+
+    for( UINT i = 0; i < TableSize; i++ )
+        pTable[i].Key = ADJACENCY_EMPTY_KEY;
+
+    // Every directed edge goes in once; the first triangle to use it keeps it
+    UINT Mask = TableSize - 1;
+    for( UINT t = 0; t < NumIndices; t += 3 )
+    {
+        for( UINT e = 0; e < 3; e++ )
+        {
+            UINT From = pWeld[pIndices[t + e]];
+            UINT To = pWeld[pIndices[t + ( e + 1 ) % 3]];
+            if( From == To )
+                continue;
+
+            UINT64 Key = EdgeKey( From, To );
+            for( UINT Slot = HashEdge( Key, Mask );; Slot = ( Slot + 1 ) & Mask )
+            {
+                if( pTable[Slot].Key == ADJACENCY_EMPTY_KEY )
+                {
+                    pTable[Slot].Key = Key;
+                    pTable[Slot].Opposite = pIndices[t + ( e + 2 ) % 3];
+                    break;
+                }
+                if( pTable[Slot].Key == Key )
+                    break;
+            }
+        }
+    }
+
+    // The neighbour across an edge is the triangle that runs it the other way
+    for( UINT t = 0; t < NumIndices; t += 3 )
+    {
+        for( UINT e = 0; e < 3; e++ )
+        {
+            UINT From = pWeld[pIndices[t + e]];
+            UINT To = pWeld[pIndices[t + ( e + 1 ) % 3]];
+            UINT Opposite = pIndices[t + ( e + 2 ) % 3];
+
+            if( From != To )
+            {
+                UINT64 Key = EdgeKey( To, From );
+                for( UINT Slot = HashEdge( Key, Mask );; Slot = ( Slot + 1 ) & Mask )
+                {
+                    if( pTable[Slot].Key == ADJACENCY_EMPTY_KEY )
+                        break;
+                    if( pTable[Slot].Key == Key )
+                    {
+                        Opposite = pTable[Slot].Opposite;
+                        break;
+                    }
+                }
+            }
+
+            pAdjacency[t * 2 + e * 2] = pIndices[t + e];
+            pAdjacency[t * 2 + e * 2 + 1] = Opposite;
+        }
+    }
+
+    delete []pWeld;
+    delete []pTable;
+    return S_OK;
+}
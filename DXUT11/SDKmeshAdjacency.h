@@ -0,0 +1,26 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshAdjacency.h
+//
+// Triangle adjacency for .sdkmesh triangle lists, used by CDXUTSDKMesh to build the
+// index buffers drawn with D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST_ADJ
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHADJACENCY_H
+#define SDKMESHADJACENCY_H
+
+//--------------------------------------------------------------------------------------
+// Writes 2 * NumIndices indices to pAdjacency: each triangle v0 v1 v2 becomes
+// v0 a01 v1 a12 v2 a20, where aXY is the far vertex of the triangle across edge XY.
+// Edges are matched on welded positions, so triangles meet across attribute seams;
+// vertices are welded when their positions are bit for bit equal, or by index when
+// pPositions is NULL. An open edge gets the triangle's own far vertex, the usual
+// convention for silhouette and shadow volume shaders. Where more than two triangles
+// share an edge, the first one found is used.
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshGenerateAdjacency( __in_opt const BYTE* pPositions, UINT PositionStride, UINT NumVertices,
+                                  __in_ecount( NumIndices ) const UINT* pIndices, UINT NumIndices,
+                                  __out_ecount( NumIndices * 2 ) UINT* pAdjacency );
+
+#endif // SDKMESHADJACENCY_H
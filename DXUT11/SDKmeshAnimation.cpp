@@ -0,0 +1,854 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshAnimation.cpp
+//
+// Compressed keyframe tracks for .sdkmesh animations, and the blending of animation
+// layers
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+#include <emmintrin.h>
+#include <math.h>
+
+#define SDKMESH_SQRT1_2 0.707106781f
+
+// Longest run of source keys one stored key pair may span. Keeps the greedy reduction
+// linear in the track length and the segment lengths well inside 16 bits.
+#define SDKMESH_MAX_KEY_SPAN 256
+
+//--------------------------------------------------------------------------------------
+// Compression works on one channel at a time, with every key as four floats: ( x, y, z,
+// 0 ) for translation and scale, and a unit quaternion for rotation. All-zero source
+// orientations stand for the identity, as they do at playback, and every quaternion is
+// put in the same hemisphere as the one before so neighbours blend the short way.
+//--------------------------------------------------------------------------------------
+static void GatherChannel( const SDKANIMATION_DATA* pKeys, UINT NumKeys, UINT Channel, float ( *pOut )[4] )
+{
+    for( UINT k = 0; k < NumKeys; k++ )
+    {
+        float* pValue = pOut[k];
+        if( Channel == SDKMESH_CHANNEL_TRANSLATION || Channel == SDKMESH_CHANNEL_SCALE )
+        {
+            const D3DXVECTOR3& v = ( Channel == SDKMESH_CHANNEL_TRANSLATION ) ? pKeys[k].Translation : pKeys[k].Scaling;
+            pValue[0] = v.x;
+            pValue[1] = v.y;
+            pValue[2] = v.z;
+            pValue[3] = 0.0f;
+            continue;
+        }
+
+        const D3DXVECTOR4& q = pKeys[k].Orientation;
+        float fLengthSq = q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w;
+        if( fLengthSq <= 0.0f )
+        {
+            pValue[0] = pValue[1] = pValue[2] = 0.0f;
+            pValue[3] = 1.0f;
+        }
+        else
+        {
+            float fInvLength = 1.0f / sqrtf( fLengthSq );
+            pValue[0] = q.x * fInvLength;
+            pValue[1] = q.y * fInvLength;
+            pValue[2] = q.z * fInvLength;
+            pValue[3] = q.w * fInvLength;
+        }
+
+        if( k > 0 )
+        {
+            const float* pPrev = pOut[k - 1];
+            if( pPrev[0] * pValue[0] + pPrev[1] * pValue[1] + pPrev[2] * pValue[2] + pPrev[3] * pValue[3] < 0.0f )
+            {
+                for( UINT i = 0; i < 4; i++ )
+                    pValue[i] = -pValue[i];
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Largest component difference, or for rotations the angle between the two. The angle
+// comes from the chord lengths rather than acos of the dot product, which has no
+// precision left at the small angles the error bounds are about.
+//--------------------------------------------------------------------------------------
+static float GetChannelError( UINT Channel, const float* pA, const float* pB )
+{
+    if( Channel == SDKMESH_CHANNEL_ROTATION )
+    {
+        float fSign = ( pA[0] * pB[0] + pA[1] * pB[1] + pA[2] * pB[2] + pA[3] * pB[3] < 0.0f ) ? -1.0f : 1.0f;
+        float fDiffSq = 0.0f;
+        float fSumSq = 0.0f;
+        for( UINT i = 0; i < 4; i++ )
+        {
+            float b = pB[i] * fSign;
+            fDiffSq += ( pA[i] - b ) * ( pA[i] - b );
+            fSumSq += ( pA[i] + b ) * ( pA[i] + b );
+        }
+        return 4.0f * atan2f( sqrtf( fDiffSq ), sqrtf( fSumSq ) );
+    }
+
+    return max( fabsf( pA[0] - pB[0] ), max( fabsf( pA[1] - pB[1] ), fabsf( pA[2] - pB[2] ) ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Scalar twin of the blend in SampleChannel, used to decide which keys can go
+//--------------------------------------------------------------------------------------
+static void InterpolateChannel( UINT Channel, const float* pA, const float* pB, float t, float* pOut )
+{
+    if( Channel != SDKMESH_CHANNEL_ROTATION )
+    {
+        for( UINT i = 0; i < 4; i++ )
+            pOut[i] = pA[i] + ( pB[i] - pA[i] ) * t;
+        return;
+    }
+
+    float fSign = ( pA[0] * pB[0] + pA[1] * pB[1] + pA[2] * pB[2] + pA[3] * pB[3] < 0.0f ) ? -1.0f : 1.0f;
+    float fLengthSq = 0.0f;
+    for( UINT i = 0; i < 4; i++ )
+    {
+        pOut[i] = pA[i] + ( pB[i] * fSign - pA[i] ) * t;
+        fLengthSq += pOut[i] * pOut[i];
+    }
+    float fInvLength = 1.0f / sqrtf( fLengthSq );
+    for( UINT i = 0; i < 4; i++ )
+        pOut[i] *= fInvLength;
+}
+
+//--------------------------------------------------------------------------------------
+// Quantization
+//--------------------------------------------------------------------------------------
+static void QuantizeRotation( const float* q, USHORT* pWords )
+{
+    UINT iLargest = 0;
+    for( UINT i = 1; i < 4; i++ )
+    {
+        if( fabsf( q[i] ) > fabsf( q[iLargest] ) )
+            iLargest = i;
+    }
+
+    // q and -q are the same rotation, so the dropped component can always be positive,
+    // which leaves the other three within +/- sqrt( 1/2 )
+    float fSign = ( q[iLargest] < 0.0f ) ? -1.0f : 1.0f;
+    UINT n = 0;
+    for( UINT i = 0; i < 4; i++ )
+    {
+        if( i == iLargest )
+            continue;
+        float c = max( -SDKMESH_SQRT1_2, min( SDKMESH_SQRT1_2, q[i] * fSign ) );
+        pWords[n++] = ( USHORT )( ( c + SDKMESH_SQRT1_2 ) * ( 32767.0f / ( 2.0f * SDKMESH_SQRT1_2 ) ) + 0.5f );
+    }
+    pWords[0] |= ( USHORT )( ( iLargest & 1 ) << 15 );
+    pWords[1] |= ( USHORT )( ( iLargest >> 1 ) << 15 );
+}
+
+//--------------------------------------------------------------------------------------
+static void QuantizeVector( const float* v, const SDKMESH_COMPRESSED_CHANNEL* pChannel, USHORT* pWords )
+{
+    for( UINT i = 0; i < 3; i++ )
+    {
+        float fSteps = 0.0f;
+        if( pChannel->Scale[i] > 0.0f )
+            fSteps = ( v[i] - pChannel->Offset[i] ) / pChannel->Scale[i] + 0.5f;
+        pWords[i] = ( USHORT )max( 0.0f, min( 65535.0f, fSteps ) );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Dequantization. Each key's three words are read as four; the fourth belongs to the
+// next key (or the padding word) and is cleared by a zero scale.
+//--------------------------------------------------------------------------------------
+static inline __m128 LoadQuantized( const USHORT* pWords )
+{
+    __m128i Words = _mm_loadl_epi64( ( const __m128i* )pWords );
+    return _mm_cvtepi32_ps( _mm_unpacklo_epi16( Words, _mm_setzero_si128() ) );
+}
+
+static inline __m128 DequantizeVector( const SDKMESH_COMPRESSED_CHANNEL* pChannel, const USHORT* pWords )
+{
+    return _mm_add_ps( _mm_loadu_ps( pChannel->Offset ),
+                       _mm_mul_ps( LoadQuantized( pWords ), _mm_loadu_ps( pChannel->Scale ) ) );
+}
+
+static inline __m128 Dot4( __m128 a, __m128 b )
+{
+    __m128 m = _mm_mul_ps( a, b );
+    m = _mm_add_ps( m, _mm_movehl_ps( m, m ) );
+    m = _mm_add_ss( m, _mm_shuffle_ps( m, m, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+    return _mm_shuffle_ps( m, m, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+}
+
+static inline __m128 DequantizeRotation( const USHORT* pWords )
+{
+    __m128i Words = _mm_unpacklo_epi16( _mm_loadl_epi64( ( const __m128i* )pWords ), _mm_setzero_si128() );
+    Words = _mm_and_si128( Words, _mm_set_epi32( 0, 0x7fff, 0x7fff, 0x7fff ) );
+
+    // ( a, b, c, 0 ) for the three stored components
+    const float fStep = 2.0f * SDKMESH_SQRT1_2 / 32767.0f;
+    __m128 v = _mm_sub_ps( _mm_mul_ps( _mm_cvtepi32_ps( Words ), _mm_set_ps( 0.0f, fStep, fStep, fStep ) ),
+                           _mm_set_ps( 0.0f, SDKMESH_SQRT1_2, SDKMESH_SQRT1_2, SDKMESH_SQRT1_2 ) );
+    __m128 Largest = _mm_sqrt_ps( _mm_max_ps( _mm_sub_ps( _mm_set1_ps( 1.0f ), Dot4( v, v ) ), _mm_setzero_ps() ) );
+
+    // Open a gap at the dropped component's lane and put it back there
+    switch( ( pWords[0] >> 15 ) | ( ( pWords[1] >> 15 ) << 1 ) )
+    {
+        case 0:
+            v = _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 1, 0, 3 ) );
+            return _mm_move_ss( v, Largest );
+        case 1:
+            v = _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 1, 3, 0 ) );
+            return _mm_add_ps( v, _mm_and_ps( Largest, _mm_castsi128_ps( _mm_set_epi32( 0, 0, -1, 0 ) ) ) );
+        case 2:
+            v = _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 1, 0 ) );
+            return _mm_add_ps( v, _mm_and_ps( Largest, _mm_castsi128_ps( _mm_set_epi32( 0, -1, 0, 0 ) ) ) );
+        default:
+            return _mm_add_ps( v, _mm_and_ps( Largest, _mm_castsi128_ps( _mm_set_epi32( -1, 0, 0, 0 ) ) ) );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+static inline __m128 DequantizeKey( const SDKMESH_COMPRESSED_CHANNEL* pChannel, UINT Channel, const USHORT* pWords )
+{
+    if( Channel == SDKMESH_CHANNEL_ROTATION )
+        return DequantizeRotation( pWords );
+    return DequantizeVector( pChannel, pWords );
+}
+
+//--------------------------------------------------------------------------------------
+static __m128 SampleChannel( const SDKMESH_COMPRESSED_ANIMATION* pAnimation, const SDKMESH_COMPRESSED_CHANNEL* pChannel,
+                             UINT Channel, UINT iKey )
+{
+    if( pChannel->NumKeys == 0 )
+        return _mm_loadu_ps( pChannel->Offset );
+
+    // Find the last stored key at or before iKey. The first stored key is always source
+    // key 0 and the last is always the final source key.
+    const USHORT* pTimes = pAnimation->pKeyTimes + pChannel->FirstKey;
+    UINT Lo = 0;
+    UINT Hi = pChannel->NumKeys - 1;
+    if( iKey >= pTimes[Hi] )
+    {
+        Lo = Hi;
+    }
+    else
+    {
+        while( Hi - Lo > 1 )
+        {
+            UINT Mid = ( Lo + Hi ) / 2;
+            if( pTimes[Mid] <= iKey )
+                Lo = Mid;
+            else
+                Hi = Mid;
+        }
+    }
+
+    const USHORT* pWords = pAnimation->pValues + ( SIZE_T )( pChannel->FirstKey + Lo ) * 3;
+    __m128 v0 = DequantizeKey( pChannel, Channel, pWords );
+    if( pTimes[Lo] == iKey || Lo == pChannel->NumKeys - 1 )
+        return v0;
+
+    __m128 v1 = DequantizeKey( pChannel, Channel, pWords + 3 );
+    __m128 t = _mm_set1_ps( ( float )( iKey - pTimes[Lo] ) / ( float )( pTimes[Lo + 1] - pTimes[Lo] ) );
+    if( Channel != SDKMESH_CHANNEL_ROTATION )
+        return _mm_add_ps( v0, _mm_mul_ps( _mm_sub_ps( v1, v0 ), t ) );
+
+    // Stored rotations have their largest component made positive, so neighbours may be
+    // in opposite hemispheres
+    __m128 Flip = _mm_and_ps( _mm_cmplt_ps( Dot4( v0, v1 ), _mm_setzero_ps() ), _mm_set1_ps( -0.0f ) );
+    v1 = _mm_xor_ps( v1, Flip );
+    __m128 q = _mm_add_ps( v0, _mm_mul_ps( _mm_sub_ps( v1, v0 ), t ) );
+    return _mm_div_ps( q, _mm_sqrt_ps( Dot4( q, q ) ) );
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshSampleCompressedKey( const SDKMESH_COMPRESSED_ANIMATION* pAnimation, UINT iTrack, UINT iKey,
+                                 __m128* pTranslation, __m128* pRotation, __m128* pScale )
+{
+    const SDKMESH_COMPRESSED_TRACK* pTrack = &pAnimation->pTracks[iTrack];
+    *pTranslation = SampleChannel( pAnimation, &pTrack->Channels[SDKMESH_CHANNEL_TRANSLATION],
+                                   SDKMESH_CHANNEL_TRANSLATION, iKey );
+    *pRotation = SampleChannel( pAnimation, &pTrack->Channels[SDKMESH_CHANNEL_ROTATION], SDKMESH_CHANNEL_ROTATION,
+                                iKey );
+    *pScale = SampleChannel( pAnimation, &pTrack->Channels[SDKMESH_CHANNEL_SCALE], SDKMESH_CHANNEL_SCALE, iKey );
+}
+
+//--------------------------------------------------------------------------------------
+static bool SegmentFits( UINT Channel, const float ( *pSource )[4], const float ( *pDequantized )[4], UINT iStart,
+                         UINT iEnd, float fMaxError )
+{
+    float Value[4];
+    for( UINT k = iStart + 1; k < iEnd; k++ )
+    {
+        InterpolateChannel( Channel, pDequantized[iStart], pDequantized[iEnd],
+                            ( float )( k - iStart ) / ( float )( iEnd - iStart ), Value );
+        if( GetChannelError( Channel, Value, pSource[k] ) > fMaxError )
+            return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Builds one channel from its source keys and returns the number of keys it stores in
+// pTimes and pValues. The reduction measures against the dequantized keys, so the
+// error bound holds for what playback actually reads.
+//--------------------------------------------------------------------------------------
+static UINT BuildChannel( UINT Channel, const float ( *pSource )[4], UINT NumKeys, float fMaxError,
+                          SDKMESH_COMPRESSED_CHANNEL* pChannel, USHORT* pTimes, USHORT* pValues,
+                          USHORT* pQuantized, float ( *pDequantized )[4] )
+{
+    ZeroMemory( pChannel, sizeof( SDKMESH_COMPRESSED_CHANNEL ) );
+
+    bool bConstant = true;
+    for( UINT k = 1; k < NumKeys && bConstant; k++ )
+        bConstant = ( GetChannelError( Channel, pSource[0], pSource[k] ) <= fMaxError );
+    if( bConstant )
+    {
+        memcpy( pChannel->Offset, pSource[0], sizeof( pChannel->Offset ) );
+        return 0;
+    }
+
+    if( Channel != SDKMESH_CHANNEL_ROTATION )
+    {
+        for( UINT i = 0; i < 3; i++ )
+        {
+            float fMin = pSource[0][i];
+            float fMax = pSource[0][i];
+            for( UINT k = 1; k < NumKeys; k++ )
+            {
+                fMin = min( fMin, pSource[k][i] );
+                fMax = max( fMax, pSource[k][i] );
+            }
+            pChannel->Offset[i] = fMin;
+            pChannel->Scale[i] = ( fMax - fMin ) / 65535.0f;
+        }
+    }
+
+    pQuantized[NumKeys * 3] = 0;
+    for( UINT k = 0; k < NumKeys; k++ )
+    {
+        if( Channel == SDKMESH_CHANNEL_ROTATION )
+            QuantizeRotation( pSource[k], &pQuantized[k * 3] );
+        else
+            QuantizeVector( pSource[k], pChannel, &pQuantized[k * 3] );
+        _mm_storeu_ps( pDequantized[k], DequantizeKey( pChannel, Channel, &pQuantized[k * 3] ) );
+    }
+
+    // Greedy reduction: from each kept key, skip ahead as far as interpolation still
+    // reproduces every source key in between
+    UINT NumStored = 0;
+    UINT iStart = 0;
+    for(; ; )
+    {
+        pTimes[NumStored] = ( USHORT )iStart;
+        memcpy( &pValues[NumStored * 3], &pQuantized[iStart * 3], sizeof( USHORT ) * 3 );
+        NumStored++;
+
+        if( iStart == NumKeys - 1 )
+            break;
+
+        UINT iEnd = iStart + 1;
+        UINT iLast = min( NumKeys - 1, iStart + SDKMESH_MAX_KEY_SPAN );
+        while( iEnd < iLast && SegmentFits( Channel, pSource, pDequantized, iStart, iEnd + 1, fMaxError ) )
+            iEnd++;
+        iStart = iEnd;
+    }
+
+    return NumStored;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshCompressAnimation( const SDKANIMATION_FRAME_DATA* pFrames, UINT NumTracks, UINT NumKeys,
+                                  const SDKMESH_ANIMATION_COMPRESSION* pSettings,
+                                  SDKMESH_COMPRESSED_ANIMATION* pAnimation,
+                                  SDKMESH_ANIMATION_COMPRESSION_STATS* pStats )
+{
+    if( !pFrames || !pAnimation || NumKeys == 0 || NumKeys > 65536 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pAnimation, sizeof( SDKMESH_COMPRESSED_ANIMATION ) );
+    if( pStats )
+        ZeroMemory( pStats, sizeof( SDKMESH_ANIMATION_COMPRESSION_STATS ) );
+
+    SDKMESH_ANIMATION_COMPRESSION Defaults =
+    {
+        SDKMESH_DEFAULT_TRANSLATION_ERROR, SDKMESH_DEFAULT_ROTATION_ERROR, SDKMESH_DEFAULT_SCALE_ERROR
+    };
+    if( !pSettings )
+        pSettings = &Defaults;
+    const float MaxError[SDKMESH_CHANNEL_COUNT] =
+    {
+        pSettings->MaxTranslationError, pSettings->MaxRotationError, pSettings->MaxScaleError
+    };
+
+    // Worst case scratch: every key of every channel kept
+    SIZE_T MaxStored = ( SIZE_T )NumTracks * SDKMESH_CHANNEL_COUNT * NumKeys;
+    SDKMESH_COMPRESSED_TRACK* pTracks = new SDKMESH_COMPRESSED_TRACK[ max( 1, NumTracks ) ];
+    USHORT* pTimes = new USHORT[ MaxStored + 1 ];
+    USHORT* pValues = new USHORT[ MaxStored * 3 + 1 ];
+    USHORT* pQuantized = new USHORT[ NumKeys * 3 + 1 ];
+    float ( *pSource )[4] = new float[NumKeys][4];
+    float ( *pDequantized )[4] = new float[NumKeys][4];
+
+    HRESULT hr = S_OK;
+    if( !pTracks || !pTimes || !pValues || !pQuantized || !pSource || !pDequantized )
+        hr = E_OUTOFMEMORY;
+
+    UINT NumStored = 0;
+    for( UINT t = 0; t < NumTracks && SUCCEEDED( hr ); t++ )
+    {
+        for( UINT c = 0; c < SDKMESH_CHANNEL_COUNT; c++ )
+        {
+            GatherChannel( pFrames[t].pAnimationData, NumKeys, c, pSource );
+
+            SDKMESH_COMPRESSED_CHANNEL* pChannel = &pTracks[t].Channels[c];
+            UINT NumChannelKeys = BuildChannel( c, pSource, NumKeys, MaxError[c], pChannel, &pTimes[NumStored],
+                                                &pValues[NumStored * 3], pQuantized, pDequantized );
+            pChannel->NumKeys = NumChannelKeys;
+            pChannel->FirstKey = NumStored;
+            NumStored += NumChannelKeys;
+
+            if( pStats )
+            {
+                if( NumChannelKeys )
+                    pStats->NumAnimatedChannels++;
+                else
+                    pStats->NumConstantChannels++;
+            }
+        }
+    }
+
+    // Trim the key arrays to what was kept
+    if( SUCCEEDED( hr ) )
+    {
+        pAnimation->pKeyTimes = new USHORT[ NumStored + 1 ];
+        pAnimation->pValues = new USHORT[ NumStored * 3 + 1 ];
+        if( !pAnimation->pKeyTimes || !pAnimation->pValues )
+        {
+            hr = E_OUTOFMEMORY;
+        }
+        else
+        {
+            memcpy( pAnimation->pKeyTimes, pTimes, sizeof( USHORT ) * NumStored );
+            memcpy( pAnimation->pValues, pValues, sizeof( USHORT ) * NumStored * 3 );
+            pAnimation->pValues[NumStored * 3] = 0;
+
+            pAnimation->NumTracks = NumTracks;
+            pAnimation->NumSourceKeys = NumKeys;
+            pAnimation->NumStoredKeys = NumStored;
+            pAnimation->pTracks = pTracks;
+            pTracks = NULL;
+        }
+    }
+
+    if( SUCCEEDED( hr ) && pStats )
+    {
+        pStats->SourceBytes = ( UINT64 )NumTracks * NumKeys * sizeof( SDKANIMATION_DATA );
+        pStats->CompressedBytes = ( UINT64 )NumTracks * sizeof( SDKMESH_COMPRESSED_TRACK ) +
+            ( UINT64 )NumStored * sizeof( USHORT ) * 4 + sizeof( USHORT ) * 2;
+        pStats->NumStoredKeys = NumStored;
+
+        float* pMaxError[SDKMESH_CHANNEL_COUNT] =
+        {
+            &pStats->MaxTranslationError, &pStats->MaxRotationError, &pStats->MaxScaleError
+        };
+        for( UINT t = 0; t < NumTracks; t++ )
+        {
+            for( UINT c = 0; c < SDKMESH_CHANNEL_COUNT; c++ )
+            {
+                GatherChannel( pFrames[t].pAnimationData, NumKeys, c, pSource );
+                for( UINT k = 0; k < NumKeys; k++ )
+                {
+                    float Value[4];
+                    _mm_storeu_ps( Value, SampleChannel( pAnimation, &pAnimation->pTracks[t].Channels[c], c, k ) );
+                    *pMaxError[c] = max( *pMaxError[c], GetChannelError( c, Value, pSource[k] ) );
+                }
+            }
+        }
+    }
+
+    if( FAILED( hr ) )
+        SDKMeshDestroyCompressedAnimation( pAnimation );
+
+    SAFE_DELETE_ARRAY( pTracks );
+    SAFE_DELETE_ARRAY( pTimes );
+    SAFE_DELETE_ARRAY( pValues );
+    SAFE_DELETE_ARRAY( pQuantized );
+    SAFE_DELETE_ARRAY( pSource );
+    SAFE_DELETE_ARRAY( pDequantized );
+
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshDestroyCompressedAnimation( SDKMESH_COMPRESSED_ANIMATION* pAnimation )
+{
+    if( !pAnimation )
+        return;
+
+    SAFE_DELETE_ARRAY( pAnimation->pTracks );
+    SAFE_DELETE_ARRAY( pAnimation->pKeyTimes );
+    SAFE_DELETE_ARRAY( pAnimation->pValues );
+    ZeroMemory( pAnimation, sizeof( SDKMESH_COMPRESSED_ANIMATION ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Layer blending
+//--------------------------------------------------------------------------------------
+static inline __m128 LoadVector( const D3DXVECTOR3& v )
+{
+    return _mm_set_ps( 0.0f, v.z, v.y, v.x );
+}
+
+static inline __m128 NormalizeQuaternion( __m128 q )
+{
+    __m128 LengthSq = Dot4( q, q );
+    if( _mm_cvtss_f32( LengthSq ) <= 0.0f )
+        return _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f );
+    return _mm_div_ps( q, _mm_sqrt_ps( LengthSq ) );
+}
+
+static inline __m128 ConjugateQuaternion( __m128 q )
+{
+    return _mm_xor_ps( q, _mm_setr_ps( -0.0f, -0.0f, -0.0f, 0.0f ) );
+}
+
+// q, or -q when that's nearer to Reference
+static inline __m128 AlignQuaternion( __m128 q, __m128 Reference )
+{
+    __m128 Flip = _mm_and_ps( _mm_cmplt_ps( Dot4( Reference, q ), _mm_setzero_ps() ), _mm_set1_ps( -0.0f ) );
+    return _mm_xor_ps( q, Flip );
+}
+
+//--------------------------------------------------------------------------------------
+// Hamilton product a * b of ( x, y, z, w ) quaternions; as a rotation it applies b
+// first, then a. Each component of a scales b with its lanes swapped and signed.
+//--------------------------------------------------------------------------------------
+static inline __m128 MultiplyQuaternion( __m128 a, __m128 b )
+{
+    __m128 SwapX = _mm_xor_ps( _mm_shuffle_ps( b, b, _MM_SHUFFLE( 0, 1, 2, 3 ) ),
+                               _mm_setr_ps( 0.0f, -0.0f, 0.0f, -0.0f ) );      // ( w, -z, y, -x )
+    __m128 SwapY = _mm_xor_ps( _mm_shuffle_ps( b, b, _MM_SHUFFLE( 1, 0, 3, 2 ) ),
+                               _mm_setr_ps( 0.0f, 0.0f, -0.0f, -0.0f ) );      // ( z, w, -x, -y )
+    __m128 SwapZ = _mm_xor_ps( _mm_shuffle_ps( b, b, _MM_SHUFFLE( 2, 3, 0, 1 ) ),
+                               _mm_setr_ps( -0.0f, 0.0f, 0.0f, -0.0f ) );      // ( -y, x, w, -z )
+
+    __m128 r = _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 3, 3, 3 ) ), b );
+    r = _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 0, 0, 0, 0 ) ), SwapX ) );
+    r = _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 1, 1, 1, 1 ) ), SwapY ) );
+    return _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 2, 2, 2, 2 ) ), SwapZ ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Override rotations are summed on the side of the first one and normalized, which is
+// NLERP generalized to any number of weights. Scale components with no reference
+// scale are left alone by additive samples.
+//--------------------------------------------------------------------------------------
+void SDKMeshBlendLayerSamples( const SDKMESH_LAYER_SAMPLE* pSamples, UINT NumSamples, const SDKMESH_FRAME_TRS* pRest,
+                               __m128* pTranslation, __m128* pRotation, __m128* pScale )
+{
+    const __m128 Zero = _mm_setzero_ps();
+    const __m128 One = _mm_set1_ps( 1.0f );
+    const __m128 Identity = _mm_setr_ps( 0.0f, 0.0f, 0.0f, 1.0f );
+
+    __m128 Translation = Zero, Rotation = Zero, Scale = Zero;
+    float fTotal = 0.0f;
+    for( UINT i = 0; i < NumSamples; i++ )
+    {
+        const SDKMESH_LAYER_SAMPLE* pSample = &pSamples[i];
+        if( pSample->bAdditive )
+            continue;
+
+        __m128 r = pSample->Rotation;
+        if( fTotal > 0.0f )
+            r = AlignQuaternion( r, Rotation );
+
+        __m128 w = _mm_set1_ps( pSample->fWeight );
+        Translation = _mm_add_ps( Translation, _mm_mul_ps( pSample->Translation, w ) );
+        Rotation = _mm_add_ps( Rotation, _mm_mul_ps( r, w ) );
+        Scale = _mm_add_ps( Scale, _mm_mul_ps( pSample->Scale, w ) );
+        fTotal += pSample->fWeight;
+    }
+
+    if( fTotal < 1.0f )
+    {
+        __m128 r = _mm_loadu_ps( &pRest->Rotation.x );
+        if( fTotal > 0.0f )
+            r = AlignQuaternion( r, Rotation );
+
+        __m128 w = _mm_set1_ps( 1.0f - fTotal );
+        Translation = _mm_add_ps( Translation, _mm_mul_ps( LoadVector( pRest->Translation ), w ) );
+        Rotation = _mm_add_ps( Rotation, _mm_mul_ps( r, w ) );
+        Scale = _mm_add_ps( Scale, _mm_mul_ps( LoadVector( pRest->Scale ), w ) );
+    }
+    else
+    {
+        __m128 InvTotal = _mm_set1_ps( 1.0f / fTotal );
+        Translation = _mm_mul_ps( Translation, InvTotal );
+        Scale = _mm_mul_ps( Scale, InvTotal );
+    }
+    Rotation = NormalizeQuaternion( Rotation );
+
+    for( UINT i = 0; i < NumSamples; i++ )
+    {
+        const SDKMESH_LAYER_SAMPLE* pSample = &pSamples[i];
+        if( !pSample->bAdditive )
+            continue;
+
+        __m128 w = _mm_set1_ps( pSample->fWeight );
+        Translation = _mm_add_ps( Translation, _mm_mul_ps( _mm_sub_ps( pSample->Translation, pSample->RefTranslation ),
+                                                           w ) );
+
+        __m128 HasRef = _mm_cmpneq_ps( pSample->RefScale, Zero );
+        __m128 Ratio = _mm_div_ps( pSample->Scale, pSample->RefScale );
+        Ratio = _mm_or_ps( _mm_and_ps( HasRef, Ratio ), _mm_andnot_ps( HasRef, One ) );
+        Scale = _mm_mul_ps( Scale, _mm_add_ps( One, _mm_mul_ps( _mm_sub_ps( Ratio, One ), w ) ) );
+
+        __m128 Delta = MultiplyQuaternion( ConjugateQuaternion( pSample->RefRotation ), pSample->Rotation );
+        Delta = AlignQuaternion( Delta, Identity );
+        Delta = NormalizeQuaternion( _mm_add_ps( Identity, _mm_mul_ps( _mm_sub_ps( Delta, Identity ), w ) ) );
+        Rotation = MultiplyQuaternion( Rotation, Delta );
+    }
+
+    *pTranslation = Translation;
+    *pRotation = Rotation;
+    *pScale = Scale;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Benchmark
+//--------------------------------------------------------------------------------------
+static void NormalizeQuaternionScalar( float* q )
+{
+    float fLengthSq = q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3];
+    if( fLengthSq <= 0.0f )
+    {
+        q[0] = q[1] = q[2] = 0.0f;
+        q[3] = 1.0f;
+        return;
+    }
+    float fInvLength = 1.0f / sqrtf( fLengthSq );
+    for( UINT i = 0; i < 4; i++ )
+        q[i] *= fInvLength;
+}
+
+static void MultiplyQuaternionScalar( const float* a, const float* b, float* pOut )
+{
+    float r[4] = { a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1],
+                   a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0],
+                   a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3],
+                   a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2] };
+    memcpy( pOut, r, sizeof( r ) );
+}
+
+//--------------------------------------------------------------------------------------
+// SDKMeshBlendLayerSamples one component at a time
+//--------------------------------------------------------------------------------------
+static void BlendLayerSamplesScalar( const SDKMESH_LAYER_SAMPLE* pSamples, UINT NumSamples,
+                                     const SDKMESH_FRAME_TRS* pRest, float* pTranslation, float* pRotation,
+                                     float* pScale )
+{
+    float T[4] = { 0 }, R[4] = { 0 }, S[4] = { 0 };
+    float fTotal = 0.0f;
+    for( UINT i = 0; i < NumSamples; i++ )
+    {
+        const SDKMESH_LAYER_SAMPLE* pSample = &pSamples[i];
+        if( pSample->bAdditive )
+            continue;
+
+        const float* t = ( const float* )&pSample->Translation;
+        const float* r = ( const float* )&pSample->Rotation;
+        const float* s = ( const float* )&pSample->Scale;
+        float fSign = ( fTotal > 0.0f && R[0] * r[0] + R[1] * r[1] + R[2] * r[2] + R[3] * r[3] < 0.0f ) ? -1.0f : 1.0f;
+        for( UINT c = 0; c < 4; c++ )
+        {
+            T[c] += t[c] * pSample->fWeight;
+            R[c] += r[c] * fSign * pSample->fWeight;
+            S[c] += s[c] * pSample->fWeight;
+        }
+        fTotal += pSample->fWeight;
+    }
+
+    if( fTotal < 1.0f )
+    {
+        const float t[4] = { pRest->Translation.x, pRest->Translation.y, pRest->Translation.z, 0.0f };
+        const float* r = &pRest->Rotation.x;
+        const float s[4] = { pRest->Scale.x, pRest->Scale.y, pRest->Scale.z, 0.0f };
+        float fSign = ( fTotal > 0.0f && R[0] * r[0] + R[1] * r[1] + R[2] * r[2] + R[3] * r[3] < 0.0f ) ? -1.0f : 1.0f;
+        float fWeight = 1.0f - fTotal;
+        for( UINT c = 0; c < 4; c++ )
+        {
+            T[c] += t[c] * fWeight;
+            R[c] += r[c] * fSign * fWeight;
+            S[c] += s[c] * fWeight;
+        }
+    }
+    else
+    {
+        for( UINT c = 0; c < 4; c++ )
+        {
+            T[c] /= fTotal;
+            S[c] /= fTotal;
+        }
+    }
+    NormalizeQuaternionScalar( R );
+
+    for( UINT i = 0; i < NumSamples; i++ )
+    {
+        const SDKMESH_LAYER_SAMPLE* pSample = &pSamples[i];
+        if( !pSample->bAdditive )
+            continue;
+
+        const float* t = ( const float* )&pSample->Translation;
+        const float* t0 = ( const float* )&pSample->RefTranslation;
+        const float* s = ( const float* )&pSample->Scale;
+        const float* s0 = ( const float* )&pSample->RefScale;
+        const float* r0 = ( const float* )&pSample->RefRotation;
+        float w = pSample->fWeight;
+        for( UINT c = 0; c < 4; c++ )
+        {
+            T[c] += ( t[c] - t0[c] ) * w;
+            S[c] *= 1.0f + ( ( s0[c] != 0.0f ? s[c] / s0[c] : 1.0f ) - 1.0f ) * w;
+        }
+
+        const float Conjugate[4] = { -r0[0], -r0[1], -r0[2], r0[3] };
+        float Delta[4];
+        MultiplyQuaternionScalar( Conjugate, ( const float* )&pSample->Rotation, Delta );
+        float fSign = ( Delta[3] < 0.0f ) ? -1.0f : 1.0f;
+        for( UINT c = 0; c < 4; c++ )
+            Delta[c] = ( c == 3 ? 1.0f : 0.0f ) + ( Delta[c] * fSign - ( c == 3 ? 1.0f : 0.0f ) ) * w;
+        NormalizeQuaternionScalar( Delta );
+        MultiplyQuaternionScalar( R, Delta, R );
+    }
+
+    memcpy( pTranslation, T, sizeof( T ) );
+    memcpy( pRotation, R, sizeof( R ) );
+    memcpy( pScale, S, sizeof( S ) );
+}
+
+//--------------------------------------------------------------------------------------
+static float NextRandom( UINT* pSeed, float fMin, float fMax )
+{
+    *pSeed = *pSeed * 1664525 + 1013904223;
+    return fMin + ( fMax - fMin ) * ( float )( *pSeed >> 8 ) / ( float )( 1 << 24 );
+}
+
+static __m128 RandomQuaternion( UINT* pSeed )
+{
+    return NormalizeQuaternion( _mm_setr_ps( NextRandom( pSeed, -1.0f, 1.0f ), NextRandom( pSeed, -1.0f, 1.0f ),
+                                             NextRandom( pSeed, -1.0f, 1.0f ), NextRandom( pSeed, -1.0f, 1.0f ) ) );
+}
+
+static __m128 RandomVector( UINT* pSeed, float fMin, float fMax )
+{
+    return _mm_setr_ps( NextRandom( pSeed, fMin, fMax ), NextRandom( pSeed, fMin, fMax ),
+                        NextRandom( pSeed, fMin, fMax ), 0.0f );
+}
+
+static double GetElapsedMs( const LARGE_INTEGER& Start, const LARGE_INTEGER& Frequency )
+{
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter( &Now );
+    return ( double )( Now.QuadPart - Start.QuadPart ) * 1000.0 / ( double )Frequency.QuadPart;
+}
+
+#define SDKMESH_BLEND_BENCHMARK_PASSES 8
+
+// A few float ulps of the unit sized values blended
+#define SDKMESH_BLEND_BENCHMARK_TOLERANCE 1e-4f
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshBenchmarkBlending( UINT NumFrames, UINT NumLayers, SDKMESH_BLEND_BENCHMARK* pResults )
+{
+    if( !pResults || NumFrames == 0 || NumLayers == 0 || NumLayers > SDKMESH_MAX_ANIMATION_LAYERS )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResults, sizeof( SDKMESH_BLEND_BENCHMARK ) );
+    pResults->NumFrames = NumFrames;
+    pResults->NumLayers = NumLayers;
+
+    // __m128 members need the alignment new doesn't promise
+    SDKMESH_LAYER_SAMPLE* pSamples = ( SDKMESH_LAYER_SAMPLE* )_aligned_malloc(
+        sizeof( SDKMESH_LAYER_SAMPLE ) * NumFrames * NumLayers, 16 );
+    SDKMESH_FRAME_TRS* pRest = new SDKMESH_FRAME_TRS[NumFrames];
+    float* pOutput = new float[ ( SIZE_T )NumFrames * 24 ];
+    if( !pSamples || !pRest || !pOutput )
+    {
+        _aligned_free( pSamples );
+        SAFE_DELETE_ARRAY( pRest );
+        SAFE_DELETE_ARRAY( pOutput );
+        return E_OUTOFMEMORY;
+    }
+
+    // Override weights that sum to more than one on some frames and less on others
+    UINT Seed = 12345;
+    for( UINT f = 0; f < NumFrames; f++ )
+    {
+        for( UINT i = 0; i < NumLayers; i++ )
+        {
+            SDKMESH_LAYER_SAMPLE* pSample = &pSamples[f * NumLayers + i];
+            pSample->Translation = RandomVector( &Seed, -1.0f, 1.0f );
+            pSample->Rotation = RandomQuaternion( &Seed );
+            pSample->Scale = RandomVector( &Seed, 0.5f, 1.5f );
+            pSample->RefTranslation = RandomVector( &Seed, -1.0f, 1.0f );
+            pSample->RefRotation = RandomQuaternion( &Seed );
+            pSample->RefScale = RandomVector( &Seed, 0.5f, 1.5f );
+            pSample->fWeight = NextRandom( &Seed, 0.1f, 0.7f );
+            pSample->bAdditive = ( i % 3 == 2 );
+        }
+
+        __m128 t = RandomVector( &Seed, -1.0f, 1.0f );
+        __m128 r = RandomQuaternion( &Seed );
+        __m128 s = RandomVector( &Seed, 0.5f, 1.5f );
+        float Values[12];
+        _mm_storeu_ps( Values, t );
+        _mm_storeu_ps( Values + 4, r );
+        _mm_storeu_ps( Values + 8, s );
+        pRest[f].Translation = D3DXVECTOR3( Values[0], Values[1], Values[2] );
+        memcpy( &pRest[f].Rotation, Values + 4, sizeof( D3DXQUATERNION ) );
+        pRest[f].Scale = D3DXVECTOR3( Values[8], Values[9], Values[10] );
+    }
+
+    float* pSimd = pOutput;
+    float* pReference = pOutput + ( SIZE_T )NumFrames * 12;
+
+    LARGE_INTEGER Frequency, Start;
+    QueryPerformanceFrequency( &Frequency );
+
+    QueryPerformanceCounter( &Start );
+    for( UINT p = 0; p < SDKMESH_BLEND_BENCHMARK_PASSES; p++ )
+    {
+        for( UINT f = 0; f < NumFrames; f++ )
+        {
+            float* pOut = &pReference[f * 12];
+            BlendLayerSamplesScalar( &pSamples[f * NumLayers], NumLayers, &pRest[f], pOut, pOut + 4, pOut + 8 );
+        }
+    }
+    pResults->ScalarMs = GetElapsedMs( Start, Frequency ) / SDKMESH_BLEND_BENCHMARK_PASSES;
+
+    QueryPerformanceCounter( &Start );
+    for( UINT p = 0; p < SDKMESH_BLEND_BENCHMARK_PASSES; p++ )
+    {
+        for( UINT f = 0; f < NumFrames; f++ )
+        {
+            __m128 t, r, s;
+            SDKMeshBlendLayerSamples( &pSamples[f * NumLayers], NumLayers, &pRest[f], &t, &r, &s );
+            float* pOut = &pSimd[f * 12];
+            _mm_storeu_ps( pOut, t );
+            _mm_storeu_ps( pOut + 4, r );
+            _mm_storeu_ps( pOut + 8, s );
+        }
+    }
+    pResults->SimdMs = GetElapsedMs( Start, Frequency ) / SDKMESH_BLEND_BENCHMARK_PASSES;
+
+    if( pResults->SimdMs > 0.0 )
+        pResults->FramesPerSecond = NumFrames * 1000.0 / pResults->SimdMs;
+
+    for( SIZE_T i = 0; i < ( SIZE_T )NumFrames * 12; i++ )
+        pResults->MaxError = max( pResults->MaxError, fabsf( pSimd[i] - pReference[i] ) );
+
+    _aligned_free( pSamples );
+    SAFE_DELETE_ARRAY( pRest );
+    SAFE_DELETE_ARRAY( pOutput );
+
+    return ( pResults->MaxError <= SDKMESH_BLEND_BENCHMARK_TOLERANCE ) ? S_OK : E_FAIL;
+}
@@ -0,0 +1,181 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshAnimation.h
+//
+// Compressed keyframe tracks for .sdkmesh animations, used by
+// CDXUTSDKMesh::CompressAnimation, and the animation clips and layers blended by
+// CDXUTSDKMesh::TransformMeshBlended. Included by SDKmesh.h after the animation file
+// structures.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHANIMATION_H
+#define SDKMESHANIMATION_H
+
+#include <xmmintrin.h>
+
+//--------------------------------------------------------------------------------------
+// Every frame's track is split into translation, rotation and scale channels. A
+// channel that never moves further than its error bound from its first key is stored
+// as that one value. The others keep only the keys that can't be rebuilt within the
+// bound by interpolating their neighbours, each quantized to three 16 bit words:
+// translations and scales relative to the channel's range, and rotations as the
+// smallest three components of the quaternion (15 bits each, with the index of the
+// dropped component in the two top bits).
+//--------------------------------------------------------------------------------------
+enum SDKMESH_ANIMATION_CHANNEL
+{
+    SDKMESH_CHANNEL_TRANSLATION = 0,
+    SDKMESH_CHANNEL_ROTATION,
+    SDKMESH_CHANNEL_SCALE,
+    SDKMESH_CHANNEL_COUNT
+};
+
+struct SDKMESH_COMPRESSED_CHANNEL
+{
+    UINT NumKeys;       // 0 for a constant channel, whose value is Offset
+    UINT FirstKey;      // index into pKeyTimes; the values start at pValues[FirstKey * 3]
+    float Offset[4];    // value = Offset + quantized * Scale, for translation and scale
+    float Scale[4];
+};
+
+struct SDKMESH_COMPRESSED_TRACK
+{
+    SDKMESH_COMPRESSED_CHANNEL Channels[SDKMESH_CHANNEL_COUNT];
+};
+
+struct SDKMESH_COMPRESSED_ANIMATION
+{
+    UINT NumTracks;
+    UINT NumSourceKeys;
+    UINT NumStoredKeys;
+    SDKMESH_COMPRESSED_TRACK* pTracks;
+    USHORT* pKeyTimes;  // source key index of each stored key
+    USHORT* pValues;    // three words per stored key, plus one of padding
+};
+
+//--------------------------------------------------------------------------------------
+// Error bounds for key reduction and constant channel detection, in model units for
+// translation and scale and in radians for rotation. Quantization adds at most half a
+// step on top: 1/65535 of a channel's range, or about 0.002 degrees of rotation.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_ANIMATION_COMPRESSION
+{
+    float MaxTranslationError;
+    float MaxRotationError;
+    float MaxScaleError;
+};
+
+#define SDKMESH_DEFAULT_TRANSLATION_ERROR   0.001f
+#define SDKMESH_DEFAULT_ROTATION_ERROR      0.001f
+#define SDKMESH_DEFAULT_SCALE_ERROR         0.001f
+
+// Measured by sampling every source key of the result
+struct SDKMESH_ANIMATION_COMPRESSION_STATS
+{
+    UINT64 SourceBytes;
+    UINT64 CompressedBytes;
+    UINT NumConstantChannels;
+    UINT NumAnimatedChannels;
+    UINT NumStoredKeys;
+    float MaxTranslationError;
+    float MaxRotationError;
+    float MaxScaleError;
+};
+
+// Compresses NumTracks tracks of NumKeys keys each (at most 65536). pSettings may be NULL
+// for the defaults above.
+HRESULT SDKMeshCompressAnimation( __in_ecount( NumTracks ) const SDKANIMATION_FRAME_DATA* pFrames, UINT NumTracks,
+                                  UINT NumKeys, __in_opt const SDKMESH_ANIMATION_COMPRESSION* pSettings,
+                                  __out SDKMESH_COMPRESSED_ANIMATION* pAnimation,
+                                  __out_opt SDKMESH_ANIMATION_COMPRESSION_STATS* pStats = NULL );
+void SDKMeshDestroyCompressedAnimation( __inout SDKMESH_COMPRESSED_ANIMATION* pAnimation );
+
+// Rebuilds source key iKey of a track: ( x, y, z, 0 ) translation and scale and an
+// ( x, y, z, w ) unit quaternion
+void SDKMeshSampleCompressedKey( __in const SDKMESH_COMPRESSED_ANIMATION* pAnimation, UINT iTrack, UINT iKey,
+                                 __out __m128* pTranslation, __out __m128* pRotation, __out __m128* pScale );
+
+//--------------------------------------------------------------------------------------
+// Animation clips: animation files loaded next to the mesh's own animation with
+// CDXUTSDKMesh::LoadAnimationClip. Each is bound to the mesh's frames by name on its
+// own, so any number of them can be sampled and blended into one pose.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_ANIMATION_CLIP
+{
+    BYTE* pData;                            // the whole file
+    SDKANIMATION_FILE_HEADER* pHeader;
+    SDKANIMATION_FRAME_DATA* pFrameData;    // with pAnimationData fixed up
+    UINT* pFrameTracks;                     // track of each mesh frame, or INVALID_ANIMATION_DATA
+};
+
+//--------------------------------------------------------------------------------------
+// One clip's part in a blended pose. A frame's weight in the layer is fWeight, times
+// pFrameWeights[iFrame] when there are per-frame weights (to play a clip on the upper
+// body only, say). Override layers are averaged by weight, and where their weights
+// add up to less than one the rest goes to the frame's own transform, so a crossfade
+// is two override layers whose weights sum to one. Additive layers are then applied
+// in order, each applying its clip's motion away from key 0, the reference pose.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_ANIMATION_LAYER
+{
+    UINT iClip;
+    double fTime;                   // played back like TransformMesh's fTime
+    float fWeight;
+    const float* pFrameWeights;     // one for each mesh frame, or NULL
+    bool bAdditive;
+};
+
+#define SDKMESH_MAX_ANIMATION_LAYERS 16
+
+// A frame's local transform taken apart, for frames that blending only partly covers
+struct SDKMESH_FRAME_TRS
+{
+    D3DXVECTOR3 Translation;
+    D3DXQUATERNION Rotation;
+    D3DXVECTOR3 Scale;
+};
+
+//--------------------------------------------------------------------------------------
+// One layer's part in one frame of a blended pose, sampled from its clip: ( x, y, z, 0 )
+// translation and scale and an ( x, y, z, w ) unit quaternion, and for an additive
+// layer the same at key 0. fWeight is the frame's weight in the layer, above zero.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_LAYER_SAMPLE
+{
+    __m128 Translation;
+    __m128 Rotation;
+    __m128 Scale;
+    __m128 RefTranslation;
+    __m128 RefRotation;
+    __m128 RefScale;
+    float fWeight;
+    bool bAdditive;
+};
+
+// Blends one frame's samples, in layer order, as SDKMESH_ANIMATION_LAYER describes. An
+// additive sample adds its translation offset, rotates by its rotation offset and
+// multiplies by its scale ratio, each scaled towards none by its weight.
+void SDKMeshBlendLayerSamples( __in_ecount( NumSamples ) const SDKMESH_LAYER_SAMPLE* pSamples, UINT NumSamples,
+                               __in const SDKMESH_FRAME_TRS* pRest, __out __m128* pTranslation,
+                               __out __m128* pRotation, __out __m128* pScale );
+
+//--------------------------------------------------------------------------------------
+// Blends NumFrames frames of NumLayers random samples each (every third layer additive)
+// with SDKMeshBlendLayerSamples and with a scalar reference, and fails if any result
+// differs from the reference by more than MaxError. Times are the average of several
+// passes.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_BLEND_BENCHMARK
+{
+    UINT NumFrames;
+    UINT NumLayers;
+    double ScalarMs;
+    double SimdMs;
+    double FramesPerSecond;
+    float MaxError;
+};
+
+HRESULT SDKMeshBenchmarkBlending( UINT NumFrames, UINT NumLayers, __out SDKMESH_BLEND_BENCHMARK* pResults );
+
+#endif // SDKMESHANIMATION_H
@@ -0,0 +1,814 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshBVH.cpp
+//
+// Triangle bounding volume hierarchies for ray casting against .sdkmesh meshes
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKmeshBVH.h"
+#include <emmintrin.h>
+
+#define BVH_BINS            16
+#define BVH_MAX_LEAF        8
+#define BVH_TRAVERSAL_COST  1.0f        // one node visit against one triangle test
+#define BVH_SAH_DEPTH       40          // below this splits halve the triangles instead
+#define BVH_STACK_SIZE      96          // BVH_SAH_DEPTH plus a halving for each bit of a UINT, and then some
+#define BVH_TASK_TRIANGLES  16384       // subtrees this small are built whole by one thread
+#define BVH_FILE_MAGIC      0x48564253  // 'SBVH'
+#define BVH_FILE_VERSION    1
+
+struct BVH_BOX
+{
+    float Min[3];
+    float Max[3];
+};
+
+struct BVH_RANGE
+{
+    UINT iNode;
+    UINT Begin;
+    UINT End;
+    UINT Depth;
+};
+
+// A subtree left for the parallel pass, built into its own nodes and then moved in
+struct BVH_TASK
+{
+    BVH_RANGE Range;
+    SDKMESH_BVH_NODE* pNodes;
+    UINT NumNodes;
+};
+
+struct BVH_BUILD
+{
+    const BVH_BOX* pBounds;     // of each input triangle
+    const float* pCenters;      // three floats for each input triangle
+    UINT* pRefs;                // input triangles, partitioned as the tree is built
+    CGrowableArray <BVH_TASK> Tasks;
+    volatile LONG bOutOfMemory;
+};
+
+struct BVH_FILE_HEADER
+{
+    UINT Magic;
+    UINT Version;
+    UINT NumNodes;
+    UINT NumTriangles;
+};
+
+//--------------------------------------------------------------------------------------
+static inline void EmptyBox( BVH_BOX* pBox )
+{
+    for( UINT a = 0; a < 3; a++ )
+    {
+        pBox->Min[a] = FLT_MAX;
+        pBox->Max[a] = -FLT_MAX;
+    }
+}
+
+static inline void GrowBox( BVH_BOX* pBox, const BVH_BOX* pOther )
+{
+    for( UINT a = 0; a < 3; a++ )
+    {
+        pBox->Min[a] = min( pBox->Min[a], pOther->Min[a] );
+        pBox->Max[a] = max( pBox->Max[a], pOther->Max[a] );
+    }
+}
+
+static inline float BoxArea( const BVH_BOX* pBox )
+{
+    float x = pBox->Max[0] - pBox->Min[0];
+    float y = pBox->Max[1] - pBox->Min[1];
+    float z = pBox->Max[2] - pBox->Min[2];
+    return ( x < 0.0f ) ? 0.0f : x * y + y * z + z * x;
+}
+
+// Building and partitioning must agree exactly, so both go through this
+static inline UINT BinOf( float Center, float Min, float Scale )
+{
+    int Bin = ( int )( ( Center - Min ) * Scale );
+    return ( UINT )max( 0, min( Bin, BVH_BINS - 1 ) );
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshSetBVHTriangle( SDKMESH_BVH_TRIANGLE* pTriangle, const float* pV0, const float* pV1, const float* pV2,
+                            UINT iSubset, UINT iTriangle )
+{
+    for( UINT a = 0; a < 3; a++ )
+    {
+        pTriangle->V0[a] = pV0[a];
+        pTriangle->Edge1[a] = pV1[a] - pV0[a];
+        pTriangle->Edge2[a] = pV2[a] - pV0[a];
+    }
+    pTriangle->iSubset = iSubset;
+    pTriangle->iTriangle = iTriangle;
+    pTriangle->Reserved = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Where to split pRefs[ Begin, End ), which is partitioned to match, or Begin to keep it
+// as a leaf. Each axis is cut into BVH_BINS slabs of triangle centres and the cut
+// between slabs with the lowest surface area cost wins.
+//--------------------------------------------------------------------------------------
+static UINT SplitRange( BVH_BUILD* pBuild, const BVH_RANGE* pRange, const BVH_BOX* pBox )
+{
+    UINT* pRefs = pBuild->pRefs;
+    UINT Count = pRange->End - pRange->Begin;
+    if( Count <= 1 )
+        return pRange->Begin;
+
+    if( pRange->Depth < BVH_SAH_DEPTH )
+    {
+        BVH_BOX Centers;
+        EmptyBox( &Centers );
+        for( UINT i = pRange->Begin; i < pRange->End; i++ )
+        {
+            const float* pCenter = &pBuild->pCenters[ pRefs[i] * 3 ];
+            for( UINT a = 0; a < 3; a++ )
+            {
+                Centers.Min[a] = min( Centers.Min[a], pCenter[a] );
+                Centers.Max[a] = max( Centers.Max[a], pCenter[a] );
+            }
+        }
+
+        float BestCost = FLT_MAX;
+        UINT BestAxis = 3, BestBin = 0;
+        for( UINT a = 0; a < 3; a++ )
+        {
+            float Extent = Centers.Max[a] - Centers.Min[a];
+            if( !( Extent > 0.0f ) )
+                continue;
+            float Scale = BVH_BINS / Extent;
+
+            UINT BinCount[BVH_BINS];
+            BVH_BOX BinBox[BVH_BINS];
+            for( UINT b = 0; b < BVH_BINS; b++ )
+            {
+                BinCount[b] = 0;
+                EmptyBox( &BinBox[b] );
+            }
+            for( UINT i = pRange->Begin; i < pRange->End; i++ )
+            {
+                UINT Bin = BinOf( pBuild->pCenters[ pRefs[i] * 3 + a ], Centers.Min[a], Scale );
+                BinCount[Bin]++;
+                GrowBox( &BinBox[Bin], &pBuild->pBounds[ pRefs[i] ] );
+            }
+
+            // Sweep once from each side; cut b puts bins below b on the left
+            float LeftCost[BVH_BINS];
+            UINT LeftCount[BVH_BINS];
+            BVH_BOX Sweep;
+            EmptyBox( &Sweep );
+            UINT SweepCount = 0;
+            for( UINT b = 1; b < BVH_BINS; b++ )
+            {
+                GrowBox( &Sweep, &BinBox[b - 1] );
+                SweepCount += BinCount[b - 1];
+                LeftCount[b] = SweepCount;
+                LeftCost[b] = SweepCount ? BoxArea( &Sweep ) * SweepCount : 0.0f;
+            }
+            EmptyBox( &Sweep );
+            SweepCount = 0;
+            for( UINT b = BVH_BINS - 1; b > 0; b-- )
+            {
+                GrowBox( &Sweep, &BinBox[b] );
+                SweepCount += BinCount[b];
+                if( SweepCount == 0 || LeftCount[b] == 0 )
+                    continue;
+
+                float Cost = LeftCost[b] + BoxArea( &Sweep ) * SweepCount;
+                if( Cost < BestCost )
+                {
+                    BestCost = Cost;
+                    BestAxis = a;
+                    BestBin = b;
+                }
+            }
+        }
+
+        if( BestAxis < 3 )
+        {
+            float Area = BoxArea( pBox );
+            if( Count <= BVH_MAX_LEAF && Area * BVH_TRAVERSAL_COST + BestCost >= Area * Count )
+                return pRange->Begin;
+
+            float Scale = BVH_BINS / ( Centers.Max[BestAxis] - Centers.Min[BestAxis] );
+            UINT i = pRange->Begin, j = pRange->End;
+            while( i < j )
+            {
+                if( BinOf( pBuild->pCenters[ pRefs[i] * 3 + BestAxis ], Centers.Min[BestAxis], Scale ) < BestBin )
+                {
+                    i++;
+                }
+                else
+                {
+                    UINT Swap = pRefs[i];
+                    pRefs[i] = pRefs[--j];
+                    pRefs[j] = Swap;
+                }
+            }
+            return i;
+        }
+    }
+
+    // All centres coincide, or the tree is already deep: any halving will do
+    if( Count <= BVH_MAX_LEAF )
+        return pRange->Begin;
+    return pRange->Begin + Count / 2;
+}
+
+//--------------------------------------------------------------------------------------
+// Builds the subtree under pNodes[ pRoot->iNode ], adding nodes at *pNumNodes. With
+// bDefer, ranges of BVH_TASK_TRIANGLES or fewer are left as tasks instead.
+//--------------------------------------------------------------------------------------
+static void BuildNodes( BVH_BUILD* pBuild, SDKMESH_BVH_NODE* pNodes, UINT* pNumNodes, const BVH_RANGE* pRoot,
+                        bool bDefer )
+{
+    BVH_RANGE Stack[BVH_STACK_SIZE * 2];
+    UINT StackSize = 0;
+    Stack[StackSize++] = *pRoot;
+
+    while( StackSize > 0 )
+    {
+        BVH_RANGE Range = Stack[--StackSize];
+        SDKMESH_BVH_NODE* pNode = &pNodes[Range.iNode];
+
+        BVH_BOX Box;
+        EmptyBox( &Box );
+        for( UINT i = Range.Begin; i < Range.End; i++ )
+            GrowBox( &Box, &pBuild->pBounds[ pBuild->pRefs[i] ] );
+        for( UINT a = 0; a < 3; a++ )
+        {
+            pNode->Min[a] = Box.Min[a];
+            pNode->Max[a] = Box.Max[a];
+        }
+
+        if( bDefer && Range.End - Range.Begin <= BVH_TASK_TRIANGLES )
+        {
+            BVH_TASK Task;
+            Task.Range = Range;
+            Task.pNodes = NULL;
+            Task.NumNodes = 0;
+            if( FAILED( pBuild->Tasks.Add( Task ) ) )
+                pBuild->bOutOfMemory = TRUE;
+            pNode->Index = 0;
+            pNode->Count = 0;
+            continue;
+        }
+
+        UINT Split = SplitRange( pBuild, &Range, &Box );
+        if( Split == Range.Begin )
+        {
+            pNode->Index = Range.Begin;
+            pNode->Count = Range.End - Range.Begin;
+            continue;
+        }
+
+        UINT iLeft = *pNumNodes;
+        *pNumNodes += 2;
+        pNode->Index = iLeft;
+        pNode->Count = 0;
+
+        BVH_RANGE Right = { iLeft + 1, Split, Range.End, Range.Depth + 1 };
+        BVH_RANGE Left = { iLeft, Range.Begin, Split, Range.Depth + 1 };
+        Stack[StackSize++] = Right;
+        Stack[StackSize++] = Left;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+static void CALLBACK BuildTask( UINT iTask, void* pContext )
+{
+    BVH_BUILD* pBuild = ( BVH_BUILD* )pContext;
+    BVH_TASK* pTask = &pBuild->Tasks[iTask];
+
+    UINT Count = pTask->Range.End - pTask->Range.Begin;
+    pTask->pNodes = new SDKMESH_BVH_NODE[ Count * 2 - 1 ];
+    if( !pTask->pNodes )
+    {
+        pBuild->bOutOfMemory = TRUE;
+        return;
+    }
+
+    BVH_RANGE Root = pTask->Range;
+    Root.iNode = 0;
+    pTask->NumNodes = 1;
+    BuildNodes( pBuild, pTask->pNodes, &pTask->NumNodes, &Root, false );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshBuildBVH( const SDKMESH_BVH_TRIANGLE* pTriangles, UINT NumTriangles, SDKMESH_BVH* pBVH )
+{
+    if( !pBVH || ( NumTriangles > 0 && !pTriangles ) || NumTriangles > 0x7fffffff )
+        return E_INVALIDARG;
+    ZeroMemory( pBVH, sizeof( SDKMESH_BVH ) );
+    if( NumTriangles == 0 )
+        return S_OK;
+
+    BVH_BOX* pBounds = new BVH_BOX[ NumTriangles ];
+    float* pCenters = new float[ ( SIZE_T )NumTriangles * 3 ];
+    UINT* pRefs = new UINT[ NumTriangles ];
+    SDKMESH_BVH_NODE* pTop = new SDKMESH_BVH_NODE[ NumTriangles * 2 - 1 ];
+    if( !pBounds || !pCenters || !pRefs || !pTop )
+    {
+        SAFE_DELETE_ARRAY( pBounds );
+        SAFE_DELETE_ARRAY( pCenters );
+        SAFE_DELETE_ARRAY( pRefs );
+        SAFE_DELETE_ARRAY( pTop );
+        return E_OUTOFMEMORY;
+    }
+
+    for( UINT t = 0; t < NumTriangles; t++ )
+    {
+        const SDKMESH_BVH_TRIANGLE* pTri = &pTriangles[t];
+        for( UINT a = 0; a < 3; a++ )
+        {
+            float V0 = pTri->V0[a];
+            float V1 = V0 + pTri->Edge1[a];
+            float V2 = V0 + pTri->Edge2[a];
+            pBounds[t].Min[a] = min( V0, min( V1, V2 ) );
+            pBounds[t].Max[a] = max( V0, max( V1, V2 ) );
+            pCenters[t * 3 + a] = ( pBounds[t].Min[a] + pBounds[t].Max[a] ) * 0.5f;
+        }
+        pRefs[t] = t;
+    }
+
+    BVH_BUILD Build;
+    Build.pBounds = pBounds;
+    Build.pCenters = pCenters;
+    Build.pRefs = pRefs;
+    Build.bOutOfMemory = FALSE;
+
+    // The top of the tree, down to ranges small enough to hand out as tasks
+    UINT NumTop = 1;
+    BVH_RANGE Root = { 0, 0, NumTriangles, 0 };
+    BuildNodes( &Build, pTop, &NumTop, &Root, true );
+
+    DXUTParallelFor( ( UINT )Build.Tasks.GetSize(), BuildTask, &Build );
+
+    HRESULT hr = S_OK;
+    if( Build.bOutOfMemory )
+        hr = E_OUTOFMEMORY;
+
+    // Each task's root replaces its placeholder and the rest follow the top nodes
+    UINT NumNodes = NumTop;
+    for( int i = 0; i < Build.Tasks.GetSize(); i++ )
+        NumNodes += Build.Tasks[i].NumNodes - 1;
+
+    if( SUCCEEDED( hr ) )
+    {
+        pBVH->pNodes = new SDKMESH_BVH_NODE[ NumNodes ];
+        pBVH->pTriangles = new SDKMESH_BVH_TRIANGLE[ NumTriangles ];
+        if( !pBVH->pNodes || !pBVH->pTriangles )
+            hr = E_OUTOFMEMORY;
+    }
+
+    if( SUCCEEDED( hr ) )
+    {
+        CopyMemory( pBVH->pNodes, pTop, sizeof( SDKMESH_BVH_NODE ) * NumTop );
+        UINT Base = NumTop;
+        for( int i = 0; i < Build.Tasks.GetSize(); i++ )
+        {
+            const BVH_TASK* pTask = &Build.Tasks[i];
+            for( UINT n = 0; n < pTask->NumNodes; n++ )
+            {
+                SDKMESH_BVH_NODE Node = pTask->pNodes[n];
+                if( Node.Count == 0 )
+                    Node.Index += Base - 1;
+                pBVH->pNodes[ ( n == 0 ) ? pTask->Range.iNode : Base + n - 1 ] = Node;
+            }
+            Base += pTask->NumNodes - 1;
+        }
+        pBVH->NumNodes = NumNodes;
+
+        for( UINT t = 0; t < NumTriangles; t++ )
+            pBVH->pTriangles[t] = pTriangles[ pRefs[t] ];
+        pBVH->NumTriangles = NumTriangles;
+    }
+    else
+    {
+        SDKMeshDestroyBVH( pBVH );
+    }
+
+    for( int i = 0; i < Build.Tasks.GetSize(); i++ )
+        SAFE_DELETE_ARRAY( Build.Tasks[i].pNodes );
+    delete []pBounds;
+    delete []pCenters;
+    delete []pRefs;
+    delete []pTop;
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshDestroyBVH( SDKMESH_BVH* pBVH )
+{
+    if( !pBVH )
+        return;
+
+    SAFE_DELETE_ARRAY( pBVH->pNodes );
+    SAFE_DELETE_ARRAY( pBVH->pTriangles );
+    pBVH->NumNodes = 0;
+    pBVH->NumTriangles = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Slab test of one ray against a node. The fourth lane of the node's corners holds its
+// Index and Count, so it's masked off and stands in for the ray's own [ 0, MaxT ].
+//--------------------------------------------------------------------------------------
+static inline bool RayBox( const SDKMESH_BVH_NODE* pNode, __m128 Origin, __m128 InvDirection, __m128 Limits,
+                           float* pNear )
+{
+    const __m128 XYZ = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+
+    __m128 t0 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( pNode->Min ), Origin ), InvDirection );
+    __m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( pNode->Max ), Origin ), InvDirection );
+    __m128 Near = _mm_min_ps( t0, t1 );
+    __m128 Far = _mm_max_ps( t0, t1 );
+
+    // Limits is ( 0, MaxT, 0, MaxT ); lane 3 of each takes its part
+    Near = _mm_or_ps( _mm_and_ps( XYZ, Near ), _mm_andnot_ps( XYZ, _mm_shuffle_ps( Limits, Limits, 0 ) ) );
+    Far = _mm_or_ps( _mm_and_ps( XYZ, Far ), _mm_andnot_ps( XYZ, _mm_shuffle_ps( Limits, Limits, 0x55 ) ) );
+
+    Near = _mm_max_ps( Near, _mm_shuffle_ps( Near, Near, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    Near = _mm_max_ps( Near, _mm_movehl_ps( Near, Near ) );
+    Far = _mm_min_ps( Far, _mm_shuffle_ps( Far, Far, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    Far = _mm_min_ps( Far, _mm_movehl_ps( Far, Far ) );
+
+    *pNear = _mm_cvtss_f32( Near );
+    return _mm_comile_ss( Near, Far ) != 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Moller-Trumbore, hitting both faces
+//--------------------------------------------------------------------------------------
+static inline bool RayTriangle( const SDKMESH_BVH_TRIANGLE* pTri, const float* o, const float* d, float MaxT,
+                                float* pT, float* pU, float* pV )
+{
+    const float* e1 = pTri->Edge1;
+    const float* e2 = pTri->Edge2;
+
+    float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+    float Det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if( Det == 0.0f )
+        return false;
+    float InvDet = 1.0f / Det;
+
+    float s[3] = { o[0] - pTri->V0[0], o[1] - pTri->V0[1], o[2] - pTri->V0[2] };
+    float u = ( s[0] * p[0] + s[1] * p[1] + s[2] * p[2] ) * InvDet;
+    if( u < 0.0f || u > 1.0f )
+        return false;
+
+    float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+    float v = ( d[0] * q[0] + d[1] * q[1] + d[2] * q[2] ) * InvDet;
+    if( v < 0.0f || u + v > 1.0f )
+        return false;
+
+    float t = ( e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2] ) * InvDet;
+    if( t < 0.0f || t >= MaxT )
+        return false;
+
+    *pT = t;
+    *pU = u;
+    *pV = v;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Visits the nearer child first and keeps the farther on a stack
+//--------------------------------------------------------------------------------------
+bool SDKMeshIntersectBVH( const SDKMESH_BVH* pBVH, const D3DXVECTOR3* pOrigin, const D3DXVECTOR3* pDirection,
+                          float MaxDistance, bool bAnyHit, SDKMESH_RAY_HIT* pHit )
+{
+    pHit->Distance = MaxDistance;
+    pHit->u = 0.0f;
+    pHit->v = 0.0f;
+    pHit->iSubset = SDKMESH_BVH_MISS;
+    pHit->iTriangle = SDKMESH_BVH_MISS;
+    if( !pBVH || pBVH->NumNodes == 0 )
+        return false;
+
+    const float o[3] = { pOrigin->x, pOrigin->y, pOrigin->z };
+    const float d[3] = { pDirection->x, pDirection->y, pDirection->z };
+    __m128 Origin = _mm_setr_ps( o[0], o[1], o[2], 0.0f );
+    __m128 InvDirection = _mm_div_ps( _mm_set1_ps( 1.0f ), _mm_setr_ps( d[0], d[1], d[2], 1.0f ) );
+
+    const SDKMESH_BVH_NODE* pNodes = pBVH->pNodes;
+    float Best = MaxDistance;
+    __m128 Limits = _mm_setr_ps( 0.0f, Best, 0.0f, Best );
+    const SDKMESH_BVH_TRIANGLE* pBest = NULL;
+
+    float Near;
+    if( !RayBox( &pNodes[0], Origin, InvDirection, Limits, &Near ) )
+        return false;
+
+    UINT Stack[BVH_STACK_SIZE];
+    UINT StackSize = 0;
+    UINT iNode = 0;
+    for(; ; )
+    {
+        const SDKMESH_BVH_NODE* pNode = &pNodes[iNode];
+        if( pNode->Count > 0 )
+        {
+            for( UINT i = pNode->Index; i < pNode->Index + pNode->Count; i++ )
+            {
+                float t, u, v;
+                if( RayTriangle( &pBVH->pTriangles[i], o, d, Best, &t, &u, &v ) )
+                {
+                    Best = t;
+                    pHit->u = u;
+                    pHit->v = v;
+                    pBest = &pBVH->pTriangles[i];
+                    if( bAnyHit )
+                        break;
+                }
+            }
+            if( pBest && bAnyHit )
+                break;
+            Limits = _mm_setr_ps( 0.0f, Best, 0.0f, Best );
+        }
+        else
+        {
+            float NearLeft, NearRight;
+            bool bLeft = RayBox( &pNodes[pNode->Index], Origin, InvDirection, Limits, &NearLeft );
+            bool bRight = RayBox( &pNodes[pNode->Index + 1], Origin, InvDirection, Limits, &NearRight );
+            if( bLeft && bRight )
+            {
+                bool bLeftFirst = NearLeft <= NearRight;
+                Stack[StackSize++] = pNode->Index + ( bLeftFirst ? 1 : 0 );
+                iNode = pNode->Index + ( bLeftFirst ? 0 : 1 );
+                continue;
+            }
+            if( bLeft || bRight )
+            {
+                iNode = pNode->Index + ( bLeft ? 0 : 1 );
+                continue;
+            }
+        }
+
+        if( StackSize == 0 )
+            break;
+        iNode = Stack[--StackSize];
+    }
+
+    if( !pBest )
+        return false;
+
+    pHit->Distance = Best;
+    pHit->iSubset = pBest->iSubset;
+    pHit->iTriangle = pBest->iTriangle;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Nodes are tested against all four rays at once and entered while any ray still in
+// play reaches them; leaves run the triangle test four wide.
+//--------------------------------------------------------------------------------------
+UINT SDKMeshIntersectBVH4( const SDKMESH_BVH* pBVH, const SDKMESH_RAY4* pRays, bool bAnyHit,
+                           SDKMESH_RAY_HIT* pHits )
+{
+    UINT HitTriangle[4] = { SDKMESH_BVH_MISS, SDKMESH_BVH_MISS, SDKMESH_BVH_MISS, SDKMESH_BVH_MISS };
+    __m128 Best = pRays->MaxDistance;
+    __m128 BestU = _mm_setzero_ps();
+    __m128 BestV = _mm_setzero_ps();
+
+    const __m128 Zero = _mm_setzero_ps();
+    const __m128 One = _mm_set1_ps( 1.0f );
+    __m128 Active = _mm_cmpge_ps( Best, Zero );
+
+    if( pBVH && pBVH->NumNodes > 0 && _mm_movemask_ps( Active ) )
+    {
+        const __m128 ox = pRays->OriginX, oy = pRays->OriginY, oz = pRays->OriginZ;
+        const __m128 dx = pRays->DirectionX, dy = pRays->DirectionY, dz = pRays->DirectionZ;
+        const __m128 ix = _mm_div_ps( One, dx ), iy = _mm_div_ps( One, dy ), iz = _mm_div_ps( One, dz );
+
+        UINT Stack[BVH_STACK_SIZE];
+        UINT StackSize = 0;
+        UINT iNode = 0;
+        for(; ; )
+        {
+            const SDKMESH_BVH_NODE* pNode = &pBVH->pNodes[iNode];
+
+            __m128 t0 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( pNode->Min[0] ), ox ), ix );
+            __m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( pNode->Max[0] ), ox ), ix );
+            __m128 Near = _mm_max_ps( Zero, _mm_min_ps( t0, t1 ) );
+            __m128 Far = _mm_min_ps( Best, _mm_max_ps( t0, t1 ) );
+            t0 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( pNode->Min[1] ), oy ), iy );
+            t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( pNode->Max[1] ), oy ), iy );
+            Near = _mm_max_ps( Near, _mm_min_ps( t0, t1 ) );
+            Far = _mm_min_ps( Far, _mm_max_ps( t0, t1 ) );
+            t0 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( pNode->Min[2] ), oz ), iz );
+            t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( pNode->Max[2] ), oz ), iz );
+            Near = _mm_max_ps( Near, _mm_min_ps( t0, t1 ) );
+            Far = _mm_min_ps( Far, _mm_max_ps( t0, t1 ) );
+
+            if( _mm_movemask_ps( _mm_and_ps( Active, _mm_cmple_ps( Near, Far ) ) ) )
+            {
+                if( pNode->Count == 0 )
+                {
+                    Stack[StackSize++] = pNode->Index + 1;
+                    iNode = pNode->Index;
+                    continue;
+                }
+
+                for( UINT i = pNode->Index; i < pNode->Index + pNode->Count; i++ )
+                {
+                    const SDKMESH_BVH_TRIANGLE* pTri = &pBVH->pTriangles[i];
+                    __m128 e1x = _mm_set1_ps( pTri->Edge1[0] ), e1y = _mm_set1_ps( pTri->Edge1[1] ),
+                           e1z = _mm_set1_ps( pTri->Edge1[2] );
+                    __m128 e2x = _mm_set1_ps( pTri->Edge2[0] ), e2y = _mm_set1_ps( pTri->Edge2[1] ),
+                           e2z = _mm_set1_ps( pTri->Edge2[2] );
+
+                    __m128 px = _mm_sub_ps( _mm_mul_ps( dy, e2z ), _mm_mul_ps( dz, e2y ) );
+                    __m128 py = _mm_sub_ps( _mm_mul_ps( dz, e2x ), _mm_mul_ps( dx, e2z ) );
+                    __m128 pz = _mm_sub_ps( _mm_mul_ps( dx, e2y ), _mm_mul_ps( dy, e2x ) );
+                    __m128 Det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ),
+                                             _mm_mul_ps( e1z, pz ) );
+                    __m128 InvDet = _mm_div_ps( One, Det );
+
+                    __m128 sx = _mm_sub_ps( ox, _mm_set1_ps( pTri->V0[0] ) );
+                    __m128 sy = _mm_sub_ps( oy, _mm_set1_ps( pTri->V0[1] ) );
+                    __m128 sz = _mm_sub_ps( oz, _mm_set1_ps( pTri->V0[2] ) );
+                    __m128 u = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( sx, px ), _mm_mul_ps( sy, py ) ),
+                                                       _mm_mul_ps( sz, pz ) ), InvDet );
+
+                    __m128 qx = _mm_sub_ps( _mm_mul_ps( sy, e1z ), _mm_mul_ps( sz, e1y ) );
+                    __m128 qy = _mm_sub_ps( _mm_mul_ps( sz, e1x ), _mm_mul_ps( sx, e1z ) );
+                    __m128 qz = _mm_sub_ps( _mm_mul_ps( sx, e1y ), _mm_mul_ps( sy, e1x ) );
+                    __m128 v = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, qx ), _mm_mul_ps( dy, qy ) ),
+                                                       _mm_mul_ps( dz, qz ) ), InvDet );
+                    __m128 t = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ),
+                                                       _mm_mul_ps( e2z, qz ) ), InvDet );
+
+                    // Comparisons with a NaN are false, which also rejects Det = 0
+                    __m128 Hit = _mm_and_ps( Active, _mm_cmpneq_ps( Det, Zero ) );
+                    Hit = _mm_and_ps( Hit, _mm_and_ps( _mm_cmpge_ps( u, Zero ), _mm_cmpge_ps( v, Zero ) ) );
+                    Hit = _mm_and_ps( Hit, _mm_cmple_ps( _mm_add_ps( u, v ), One ) );
+                    Hit = _mm_and_ps( Hit, _mm_and_ps( _mm_cmpge_ps( t, Zero ), _mm_cmplt_ps( t, Best ) ) );
+
+                    int HitMask = _mm_movemask_ps( Hit );
+                    if( !HitMask )
+                        continue;
+
+                    Best = _mm_or_ps( _mm_and_ps( Hit, t ), _mm_andnot_ps( Hit, Best ) );
+                    BestU = _mm_or_ps( _mm_and_ps( Hit, u ), _mm_andnot_ps( Hit, BestU ) );
+                    BestV = _mm_or_ps( _mm_and_ps( Hit, v ), _mm_andnot_ps( Hit, BestV ) );
+                    for( UINT r = 0; r < 4; r++ )
+                    {
+                        if( HitMask & ( 1 << r ) )
+                            HitTriangle[r] = i;
+                    }
+                    if( bAnyHit )
+                        Active = _mm_andnot_ps( Hit, Active );
+                }
+
+                if( !_mm_movemask_ps( Active ) )
+                    break;
+            }
+
+            if( StackSize == 0 )
+                break;
+            iNode = Stack[--StackSize];
+        }
+    }
+
+    float Distance[4], u[4], v[4];
+    _mm_storeu_ps( Distance, Best );
+    _mm_storeu_ps( u, BestU );
+    _mm_storeu_ps( v, BestV );
+
+    UINT Mask = 0;
+    for( UINT r = 0; r < 4; r++ )
+    {
+        pHits[r].Distance = Distance[r];
+        pHits[r].u = u[r];
+        pHits[r].v = v[r];
+        pHits[r].iSubset = SDKMESH_BVH_MISS;
+        pHits[r].iTriangle = SDKMESH_BVH_MISS;
+        if( HitTriangle[r] != SDKMESH_BVH_MISS )
+        {
+            pHits[r].iSubset = pBVH->pTriangles[ HitTriangle[r] ].iSubset;
+            pHits[r].iTriangle = pBVH->pTriangles[ HitTriangle[r] ].iTriangle;
+            Mask |= 1 << r;
+        }
+    }
+    return Mask;
+}
+
+//--------------------------------------------------------------------------------------
+UINT64 SDKMeshGetBVHSize( const SDKMESH_BVH* pBVH )
+{
+    return sizeof( BVH_FILE_HEADER ) + ( UINT64 )pBVH->NumNodes * sizeof( SDKMESH_BVH_NODE ) +
+        ( UINT64 )pBVH->NumTriangles * sizeof( SDKMESH_BVH_TRIANGLE );
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshWriteBVH( const SDKMESH_BVH* pBVH, BYTE* pData )
+{
+    BVH_FILE_HEADER Header;
+    Header.Magic = BVH_FILE_MAGIC;
+    Header.Version = BVH_FILE_VERSION;
+    Header.NumNodes = pBVH->NumNodes;
+    Header.NumTriangles = pBVH->NumTriangles;
+
+    CopyMemory( pData, &Header, sizeof( BVH_FILE_HEADER ) );
+    pData += sizeof( BVH_FILE_HEADER );
+    CopyMemory( pData, pBVH->pNodes, sizeof( SDKMESH_BVH_NODE ) * pBVH->NumNodes );
+    pData += sizeof( SDKMESH_BVH_NODE ) * pBVH->NumNodes;
+    CopyMemory( pData, pBVH->pTriangles, sizeof( SDKMESH_BVH_TRIANGLE ) * pBVH->NumTriangles );
+}
+
+//--------------------------------------------------------------------------------------
+// A valid hierarchy is a tree laid out as the builder lays it out: every node but the
+// root is the child of exactly one node, which comes before it. One forward pass then
+// rules out cycles and nodes shared by two parents, which could otherwise make the
+// traversal stacks overflow, and bounds the depth traversal will reach. pDepth is 0
+// for a node no parent has claimed yet.
+//--------------------------------------------------------------------------------------
+static bool ValidateBVH( const SDKMESH_BVH* pBVH )
+{
+    if( ( pBVH->NumNodes == 0 ) != ( pBVH->NumTriangles == 0 ) )
+        return false;
+    if( pBVH->NumNodes == 0 )
+        return true;
+
+    BYTE* pDepth = new BYTE[ pBVH->NumNodes ];
+    if( !pDepth )
+        return false;
+    ZeroMemory( pDepth, pBVH->NumNodes );
+    pDepth[0] = 1;
+
+    bool bValid = true;
+    for( UINT i = 0; i < pBVH->NumNodes && bValid; i++ )
+    {
+        const SDKMESH_BVH_NODE* pNode = &pBVH->pNodes[i];
+        if( pDepth[i] == 0 )
+        {
+            bValid = false;
+        }
+        else if( pNode->Count > 0 )
+        {
+            bValid = pNode->Count <= pBVH->NumTriangles && pNode->Index <= pBVH->NumTriangles - pNode->Count;
+        }
+        else
+        {
+            bValid = pNode->Index > i && pNode->Index < pBVH->NumNodes - 1 && pDepth[i] < BVH_STACK_SIZE &&
+                     pDepth[pNode->Index] == 0 && pDepth[pNode->Index + 1] == 0;
+            if( bValid )
+            {
+                pDepth[pNode->Index] = pDepth[i] + 1;
+                pDepth[pNode->Index + 1] = pDepth[i] + 1;
+            }
+        }
+    }
+
+    delete []pDepth;
+    return bValid;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshReadBVH( const BYTE* pData, UINT64 DataBytes, SDKMESH_BVH* pBVH, UINT64* pBytesRead )
+{
+    if( !pData || !pBVH )
+        return E_INVALIDARG;
+    ZeroMemory( pBVH, sizeof( SDKMESH_BVH ) );
+
+    BVH_FILE_HEADER Header;
+    if( DataBytes < sizeof( BVH_FILE_HEADER ) )
+        return E_FAIL;
+    CopyMemory( &Header, pData, sizeof( BVH_FILE_HEADER ) );
+    if( Header.Magic != BVH_FILE_MAGIC || Header.Version != BVH_FILE_VERSION )
+        return E_FAIL;
+
+    SDKMESH_BVH Source;
+    Source.NumNodes = Header.NumNodes;
+    Source.NumTriangles = Header.NumTriangles;
+    UINT64 Size = SDKMeshGetBVHSize( &Source );
+    if( DataBytes < Size )
+        return E_FAIL;
+
+    pBVH->pNodes = new SDKMESH_BVH_NODE[ max( Header.NumNodes, 1 ) ];
+    pBVH->pTriangles = new SDKMESH_BVH_TRIANGLE[ max( Header.NumTriangles, 1 ) ];
+    if( !pBVH->pNodes || !pBVH->pTriangles )
+    {
+        SDKMeshDestroyBVH( pBVH );
+        return E_OUTOFMEMORY;
+    }
+
+    pData += sizeof( BVH_FILE_HEADER );
+    CopyMemory( pBVH->pNodes, pData, sizeof( SDKMESH_BVH_NODE ) * Header.NumNodes );
+    pData += sizeof( SDKMESH_BVH_NODE ) * Header.NumNodes;
+    CopyMemory( pBVH->pTriangles, pData, sizeof( SDKMESH_BVH_TRIANGLE ) * Header.NumTriangles );
+    pBVH->NumNodes = Header.NumNodes;
+    pBVH->NumTriangles = Header.NumTriangles;
+
+    if( !ValidateBVH( pBVH ) )
+    {
+        SDKMeshDestroyBVH( pBVH );
+        return E_FAIL;
+    }
+
+    if( pBytesRead )
+        *pBytesRead = Size;
+    return S_OK;
+}
@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshBVH.h
+//
+// Triangle bounding volume hierarchies for ray casting against .sdkmesh meshes
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHBVH_H
+#define SDKMESHBVH_H
+
+#include <xmmintrin.h>
+
+#define SDKMESH_BVH_MISS        0xffffffff
+
+//--------------------------------------------------------------------------------------
+// Nodes are 32 bytes: a leaf holds Count triangles from pTriangles[Index], an interior
+// node has Count = 0 and its children at Index and Index + 1.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_BVH_NODE
+{
+    float Min[3];
+    UINT Index;
+    float Max[3];
+    UINT Count;
+};
+
+// A triangle as the ray test wants it: a corner and the two edges leaving it
+struct SDKMESH_BVH_TRIANGLE
+{
+    float V0[3];
+    float Edge1[3];     // V1 - V0
+    float Edge2[3];     // V2 - V0
+    UINT iSubset;
+    UINT iTriangle;     // within the subset
+    UINT Reserved;
+};
+
+struct SDKMESH_BVH
+{
+    SDKMESH_BVH_NODE* pNodes;
+    UINT NumNodes;
+    SDKMESH_BVH_TRIANGLE* pTriangles;
+    UINT NumTriangles;
+};
+
+// Hit point V0 + u * Edge1 + v * Edge2 at Distance along the ray, counted in lengths of
+// its direction. iTriangle is SDKMESH_BVH_MISS when nothing was hit.
+struct SDKMESH_RAY_HIT
+{
+    float Distance;
+    float u;
+    float v;
+    UINT iSubset;
+    UINT iTriangle;
+};
+
+// Four rays, one per lane
+struct SDKMESH_RAY4
+{
+    __m128 OriginX, OriginY, OriginZ;
+    __m128 DirectionX, DirectionY, DirectionZ;
+    __m128 MaxDistance;
+};
+
+// Builds a hierarchy over a copy of the triangles with a binned surface area heuristic.
+// The large splits near the root are found first and the subtrees under them are then
+// built across the thread pool.
+HRESULT SDKMeshBuildBVH( __in_ecount( NumTriangles ) const SDKMESH_BVH_TRIANGLE* pTriangles, UINT NumTriangles,
+                         __out SDKMESH_BVH* pBVH );
+void SDKMeshDestroyBVH( __inout SDKMESH_BVH* pBVH );
+
+void SDKMeshSetBVHTriangle( __out SDKMESH_BVH_TRIANGLE* pTriangle, const float* pV0, const float* pV1,
+                            const float* pV2, UINT iSubset, UINT iTriangle );
+
+// Closest hit within MaxDistance, or with bAnyHit the first hit found, which is cheaper
+// for occlusion tests. Triangles are hit from both sides. Returns whether anything was.
+bool SDKMeshIntersectBVH( const SDKMESH_BVH* pBVH, const D3DXVECTOR3* pOrigin, const D3DXVECTOR3* pDirection,
+                          float MaxDistance, bool bAnyHit, __out SDKMESH_RAY_HIT* pHit );
+
+// The same for four rays traversed together, which pays off when they're coherent, like
+// neighbouring pixels. Returns a mask with bit i set when ray i hit something.
+UINT SDKMeshIntersectBVH4( const SDKMESH_BVH* pBVH, const SDKMESH_RAY4* pRays, bool bAnyHit,
+                           __out_ecount( 4 ) SDKMESH_RAY_HIT* pHits );
+
+// Serialization, so a hierarchy can be built once and stored next to its mesh. Reading
+// checks every node against the counts and that the nodes form a tree, so a damaged
+// file fails instead of crashing traversal later. *pBytesRead may be NULL.
+UINT64 SDKMeshGetBVHSize( const SDKMESH_BVH* pBVH );
+void SDKMeshWriteBVH( const SDKMESH_BVH* pBVH, __out_bcount( SDKMeshGetBVHSize( pBVH ) ) BYTE* pData );
+HRESULT SDKMeshReadBVH( __in_bcount( DataBytes ) const BYTE* pData, UINT64 DataBytes, __out SDKMESH_BVH* pBVH,
+                        __out_opt UINT64* pBytesRead );
+
+#endif // SDKMESHBVH_H
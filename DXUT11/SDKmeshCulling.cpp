@@ -0,0 +1,277 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshCulling.cpp
+//
+// Batched frustum culling of axis aligned boxes, used by CDXUTSDKMesh::Cull
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKmeshCulling.h"
+#include <emmintrin.h>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshCreateCullBoxes( UINT NumBoxes, SDKMESH_CULL_BOXES* pBoxes )
+{
+    if( !pBoxes )
+        return E_INVALIDARG;
+
+    ZeroMemory( pBoxes, sizeof( SDKMESH_CULL_BOXES ) );
+
+    // One allocation for all six arrays. The padding boxes are zero sized at the origin;
+    // their bits are cleared after the test.
+    UINT Padded = ( NumBoxes + 3 ) & ~3;
+    SIZE_T ArrayBytes = sizeof( float ) * max( 4, Padded );
+    float* pData = ( float* )_aligned_malloc( ArrayBytes * 6, 16 );
+    if( !pData )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pData, ArrayBytes * 6 );
+
+    SIZE_T Stride = ArrayBytes / sizeof( float );
+    pBoxes->pCenterX = pData;
+    pBoxes->pCenterY = pData + Stride;
+    pBoxes->pCenterZ = pData + Stride * 2;
+    pBoxes->pExtentX = pData + Stride * 3;
+    pBoxes->pExtentY = pData + Stride * 4;
+    pBoxes->pExtentZ = pData + Stride * 5;
+    pBoxes->NumBoxes = NumBoxes;
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshDestroyCullBoxes( SDKMESH_CULL_BOXES* pBoxes )
+{
+    if( !pBoxes )
+        return;
+
+    if( pBoxes->pCenterX )
+        _aligned_free( pBoxes->pCenterX );
+    ZeroMemory( pBoxes, sizeof( SDKMESH_CULL_BOXES ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Arvo's method: the new center is the transformed center, and each new half extent is
+// the old extents dotted with the absolute values of a matrix column
+//--------------------------------------------------------------------------------------
+void SDKMeshTransformCullBox( SDKMESH_CULL_BOXES* pBoxes, UINT iBox, const float* pMatrix,
+                              const float* pCenter, const float* pExtents )
+{
+    float Center[3];
+    float Extents[3];
+    for( UINT j = 0; j < 3; j++ )
+    {
+        Center[j] = pCenter[0] * pMatrix[j] + pCenter[1] * pMatrix[4 + j] + pCenter[2] * pMatrix[8 + j] +
+                    pMatrix[12 + j];
+        Extents[j] = pExtents[0] * fabsf( pMatrix[j] ) + pExtents[1] * fabsf( pMatrix[4 + j] ) +
+                     pExtents[2] * fabsf( pMatrix[8 + j] );
+    }
+
+    SDKMeshSetCullBox( pBoxes, iBox, Center, Extents );
+}
+
+//--------------------------------------------------------------------------------------
+// With row vectors, clip = v * M, so each clip coordinate is v dotted with a column
+//--------------------------------------------------------------------------------------
+void SDKMeshExtractFrustum( const float* pMatrix, SDKMESH_FRUSTUM* pFrustum )
+{
+    for( UINT i = 0; i < 4; i++ )
+    {
+        float x = pMatrix[i * 4 + 0];
+        float y = pMatrix[i * 4 + 1];
+        float z = pMatrix[i * 4 + 2];
+        float w = pMatrix[i * 4 + 3];
+
+        pFrustum->Planes[0][i] = w + x;     // left
+        pFrustum->Planes[1][i] = w - x;     // right
+        pFrustum->Planes[2][i] = w + y;     // bottom
+        pFrustum->Planes[3][i] = w - y;     // top
+        pFrustum->Planes[4][i] = z;         // near
+        pFrustum->Planes[5][i] = w - z;     // far
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// A box is outside when, for some plane, its center is further behind the plane than
+// the box's projected radius |a|*ex + |b|*ey + |c|*ez
+//--------------------------------------------------------------------------------------
+UINT SDKMeshCullBoxes( const SDKMESH_FRUSTUM* pFrustum, const SDKMESH_CULL_BOXES* pBoxes, DWORD* pVisibleBits )
+{
+    __m128 vA[6], vB[6], vC[6], vD[6];
+    __m128 vAbsA[6], vAbsB[6], vAbsC[6];
+    const __m128 vAbsMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+    for( UINT p = 0; p < 6; p++ )
+    {
+        vA[p] = _mm_set1_ps( pFrustum->Planes[p][0] );
+        vB[p] = _mm_set1_ps( pFrustum->Planes[p][1] );
+        vC[p] = _mm_set1_ps( pFrustum->Planes[p][2] );
+        vD[p] = _mm_set1_ps( pFrustum->Planes[p][3] );
+        vAbsA[p] = _mm_and_ps( vA[p], vAbsMask );
+        vAbsB[p] = _mm_and_ps( vB[p], vAbsMask );
+        vAbsC[p] = _mm_and_ps( vC[p], vAbsMask );
+    }
+
+    const __m128 vZero = _mm_setzero_ps();
+    UINT NumBoxes = pBoxes->NumBoxes;
+    UINT NumDwords = SDKMESH_CULL_MASK_DWORDS( NumBoxes );
+    UINT NumVisible = 0;
+    for( UINT iDword = 0; iDword < NumDwords; iDword++ )
+    {
+        DWORD Bits = 0;
+        UINT iEnd = min( NumBoxes, ( iDword + 1 ) * 32 );
+        for( UINT i = iDword * 32; i < iEnd; i += 4 )
+        {
+            __m128 cx = _mm_load_ps( pBoxes->pCenterX + i );
+            __m128 cy = _mm_load_ps( pBoxes->pCenterY + i );
+            __m128 cz = _mm_load_ps( pBoxes->pCenterZ + i );
+            __m128 ex = _mm_load_ps( pBoxes->pExtentX + i );
+            __m128 ey = _mm_load_ps( pBoxes->pExtentY + i );
+            __m128 ez = _mm_load_ps( pBoxes->pExtentZ + i );
+
+            __m128 vInside = _mm_cmpeq_ps( vZero, vZero );
+            for( UINT p = 0; p < 6; p++ )
+            {
+                __m128 Dist = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vA[p], cx ), _mm_mul_ps( vB[p], cy ) ),
+                                          _mm_add_ps( _mm_mul_ps( vC[p], cz ), vD[p] ) );
+                __m128 Radius = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vAbsA[p], ex ), _mm_mul_ps( vAbsB[p], ey ) ),
+                                            _mm_mul_ps( vAbsC[p], ez ) );
+                vInside = _mm_and_ps( vInside, _mm_cmpge_ps( _mm_add_ps( Dist, Radius ), vZero ) );
+            }
+
+            Bits |= ( DWORD )_mm_movemask_ps( vInside ) << ( i & 31 );
+        }
+
+        // Drop the padding boxes past the end
+        if( iEnd & 31 )
+            Bits &= ( 1u << ( iEnd & 31 ) ) - 1;
+
+        pVisibleBits[iDword] = Bits;
+        for( DWORD v = Bits; v; v &= v - 1 )
+            NumVisible++;
+    }
+
+    return NumVisible;
+}
+
+//--------------------------------------------------------------------------------------
+// Reference for the benchmark: one box and one plane at a time, with an early out
+//--------------------------------------------------------------------------------------
+static UINT CullBoxesScalar( const SDKMESH_FRUSTUM* pFrustum, const SDKMESH_CULL_BOXES* pBoxes,
+                             DWORD* pVisibleBits )
+{
+    UINT NumVisible = 0;
+    ZeroMemory( pVisibleBits, sizeof( DWORD ) * SDKMESH_CULL_MASK_DWORDS( pBoxes->NumBoxes ) );
+    for( UINT i = 0; i < pBoxes->NumBoxes; i++ )
+    {
+        bool bInside = true;
+        for( UINT p = 0; p < 6 && bInside; p++ )
+        {
+            const float* pPlane = pFrustum->Planes[p];
+            float Dist = pPlane[0] * pBoxes->pCenterX[i] + pPlane[1] * pBoxes->pCenterY[i] +
+                         pPlane[2] * pBoxes->pCenterZ[i] + pPlane[3];
+            float Radius = fabsf( pPlane[0] ) * pBoxes->pExtentX[i] + fabsf( pPlane[1] ) * pBoxes->pExtentY[i] +
+                           fabsf( pPlane[2] ) * pBoxes->pExtentZ[i];
+            bInside = ( Dist + Radius >= 0.0f );
+        }
+
+        if( bInside )
+        {
+            pVisibleBits[i >> 5] |= 1u << ( i & 31 );
+            NumVisible++;
+        }
+    }
+
+    return NumVisible;
+}
+
+//--------------------------------------------------------------------------------------
+static double GetElapsedMs( const LARGE_INTEGER& Start, const LARGE_INTEGER& Frequency )
+{
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter( &Now );
+    return ( double )( Now.QuadPart - Start.QuadPart ) * 1000.0 / ( double )Frequency.QuadPart;
+}
+
+#define SDKMESH_CULL_BENCHMARK_PASSES 16
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshBenchmarkCulling( UINT NumBoxes, SDKMESH_CULL_BENCHMARK* pResults )
+{
+    if( !pResults || NumBoxes == 0 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResults, sizeof( SDKMESH_CULL_BENCHMARK ) );
+    pResults->NumBoxes = NumBoxes;
+
+    SDKMESH_CULL_BOXES Boxes;
+    HRESULT hr = SDKMeshCreateCullBoxes( NumBoxes, &Boxes );
+    if( FAILED( hr ) )
+        return hr;
+
+    UINT NumDwords = SDKMESH_CULL_MASK_DWORDS( NumBoxes );
+    DWORD* pBatchedBits = new DWORD[NumDwords];
+    DWORD* pScalarBits = new DWORD[NumDwords];
+    if( !pBatchedBits || !pScalarBits )
+    {
+        SAFE_DELETE_ARRAY( pBatchedBits );
+        SAFE_DELETE_ARRAY( pScalarBits );
+        SDKMeshDestroyCullBoxes( &Boxes );
+        return E_OUTOFMEMORY;
+    }
+
+    // Boxes of 0.5 to 4.5 units scattered through a 200 unit cube around the camera,
+    // which puts about a tenth of them in view
+    DWORD Seed = 12345;
+    for( UINT i = 0; i < NumBoxes; i++ )
+    {
+        float Values[6];
+        for( UINT j = 0; j < 6; j++ )
+        {
+            Seed = Seed * 1664525 + 1013904223;
+            Values[j] = ( float )( Seed >> 8 ) / ( float )( 1 << 24 );
+        }
+        float Center[3] = { Values[0] * 200.0f - 100.0f, Values[1] * 200.0f - 100.0f, Values[2] * 200.0f - 100.0f };
+        float Extents[3] = { Values[3] * 2.0f + 0.25f, Values[4] * 2.0f + 0.25f, Values[5] * 2.0f + 0.25f };
+        SDKMeshSetCullBox( &Boxes, i, Center, Extents );
+    }
+
+    // Left handed perspective, 60 degree vertical field of view, 16:9, looking down +z
+    // from the origin, near 0.1 and far 150
+    float YScale = 1.0f / tanf( 3.14159265f / 6.0f );
+    float XScale = YScale / ( 16.0f / 9.0f );
+    float Far = 150.0f;
+    float Near = 0.1f;
+    float Proj[16] =
+    {
+        XScale, 0, 0, 0,
+        0, YScale, 0, 0,
+        0, 0, Far / ( Far - Near ), 1,
+        0, 0, -Near * Far / ( Far - Near ), 0
+    };
+    SDKMESH_FRUSTUM Frustum;
+    SDKMeshExtractFrustum( Proj, &Frustum );
+
+    LARGE_INTEGER Frequency, Start;
+    QueryPerformanceFrequency( &Frequency );
+
+    QueryPerformanceCounter( &Start );
+    for( UINT i = 0; i < SDKMESH_CULL_BENCHMARK_PASSES; i++ )
+        pResults->NumVisible = SDKMeshCullBoxes( &Frustum, &Boxes, pBatchedBits );
+    pResults->BatchedMs = GetElapsedMs( Start, Frequency ) / SDKMESH_CULL_BENCHMARK_PASSES;
+
+    UINT NumScalarVisible = 0;
+    QueryPerformanceCounter( &Start );
+    for( UINT i = 0; i < SDKMESH_CULL_BENCHMARK_PASSES; i++ )
+        NumScalarVisible = CullBoxesScalar( &Frustum, &Boxes, pScalarBits );
+    pResults->ScalarMs = GetElapsedMs( Start, Frequency ) / SDKMESH_CULL_BENCHMARK_PASSES;
+
+    if( NumScalarVisible != pResults->NumVisible ||
+        memcmp( pBatchedBits, pScalarBits, sizeof( DWORD ) * NumDwords ) != 0 )
+        hr = E_FAIL;
+
+    SAFE_DELETE_ARRAY( pBatchedBits );
+    SAFE_DELETE_ARRAY( pScalarBits );
+    SDKMeshDestroyCullBoxes( &Boxes );
+
+    return hr;
+}
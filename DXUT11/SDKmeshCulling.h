@@ -0,0 +1,89 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshCulling.h
+//
+// Batched frustum culling of axis aligned boxes, used by CDXUTSDKMesh::Cull. Nothing
+// here touches a device, so it can be driven and checked entirely on the CPU.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHCULLING_H
+#define SDKMESHCULLING_H
+
+//--------------------------------------------------------------------------------------
+// Boxes are stored structure-of-arrays so four of them are tested per SSE instruction.
+// Each array is 16 byte aligned and padded to a multiple of four boxes.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_CULL_BOXES
+{
+    float* pCenterX;
+    float* pCenterY;
+    float* pCenterZ;
+    float* pExtentX;
+    float* pExtentY;
+    float* pExtentZ;
+    UINT NumBoxes;
+};
+
+// Number of DWORDs in a visibility mask for NumBoxes boxes; box i is bit ( i & 31 ) of
+// DWORD i / 32
+#define SDKMESH_CULL_MASK_DWORDS( NumBoxes ) ( ( ( NumBoxes ) + 31 ) / 32 )
+
+HRESULT SDKMeshCreateCullBoxes( UINT NumBoxes, __out SDKMESH_CULL_BOXES* pBoxes );
+void SDKMeshDestroyCullBoxes( __inout SDKMESH_CULL_BOXES* pBoxes );
+
+inline void SDKMeshSetCullBox( __inout SDKMESH_CULL_BOXES* pBoxes, UINT iBox,
+                               const float* pCenter, const float* pExtents )
+{
+    pBoxes->pCenterX[iBox] = pCenter[0];
+    pBoxes->pCenterY[iBox] = pCenter[1];
+    pBoxes->pCenterZ[iBox] = pCenter[2];
+    pBoxes->pExtentX[iBox] = pExtents[0];
+    pBoxes->pExtentY[iBox] = pExtents[1];
+    pBoxes->pExtentZ[iBox] = pExtents[2];
+}
+
+// Stores the box that encloses the given box after transformation by a 4x4 row-vector
+// matrix laid out like D3DXMATRIX
+void SDKMeshTransformCullBox( __inout SDKMESH_CULL_BOXES* pBoxes, UINT iBox, const float* pMatrix,
+                              const float* pCenter, const float* pExtents );
+
+//--------------------------------------------------------------------------------------
+// Frustum planes ( a, b, c, d ) with the inside at a*x + b*y + c*z + d >= 0. They are
+// taken from a D3D style projection (0 <= z <= w) and are not normalized, which doesn't
+// matter for a sign test. Passing world * view * projection culls boxes given in object
+// space without transforming them.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_FRUSTUM
+{
+    float Planes[6][4];
+};
+
+void SDKMeshExtractFrustum( const float* pMatrix, __out SDKMESH_FRUSTUM* pFrustum );
+
+// Writes SDKMESH_CULL_MASK_DWORDS( NumBoxes ) DWORDs and returns the number of boxes
+// that are at least partly inside the frustum
+UINT SDKMeshCullBoxes( __in const SDKMESH_FRUSTUM* pFrustum, __in const SDKMESH_CULL_BOXES* pBoxes,
+                       __out DWORD* pVisibleBits );
+
+inline bool SDKMeshIsBoxVisible( const DWORD* pVisibleBits, UINT iBox )
+{
+    return ( pVisibleBits[iBox >> 5] & ( 1u << ( iBox & 31 ) ) ) != 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Culls NumBoxes random boxes against a perspective frustum with SDKMeshCullBoxes and
+// with a one-box-at-a-time reference, and fails if the two masks differ. Times are the
+// average of several passes.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_CULL_BENCHMARK
+{
+    UINT NumBoxes;
+    UINT NumVisible;
+    double BatchedMs;
+    double ScalarMs;
+};
+
+HRESULT SDKMeshBenchmarkCulling( UINT NumBoxes, __out SDKMESH_CULL_BENCHMARK* pResults );
+
+#endif // SDKMESHCULLING_H
@@ -0,0 +1,243 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshDrawList.cpp
+//
+// State sorted draw lists for .sdkmesh rendering
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+
+#define DRAW_KEY_MATERIAL_SHIFT 40
+#define DRAW_KEY_MESH_SHIFT     16
+#define DRAW_KEY_LOD_SHIFT      8
+#define DRAW_KEY_FIELD_MASK     0xffffff
+#define DRAW_KEY_LOD_ADJACENCY  0xff
+#define DRAW_NONE               0xffffffff
+
+//--------------------------------------------------------------------------------------
+// The adjacency buffer has its own LOD value, above every real LOD. Meshes with more
+// than 254 LODs share the last value for the rest, which only costs sort quality: the
+// command stream compares the records themselves.
+//--------------------------------------------------------------------------------------
+static UINT64 MakeDrawKey( const SDKMESH_DRAW_RECORD* pRecord )
+{
+    UINT LODKey = ( pRecord->iLOD == SDKMESH_DRAW_ADJACENCY ) ? DRAW_KEY_LOD_ADJACENCY :
+                  min( pRecord->iLOD, DRAW_KEY_LOD_ADJACENCY - 1 );
+    return ( ( UINT64 )min( pRecord->iMaterial, DRAW_KEY_FIELD_MASK ) << DRAW_KEY_MATERIAL_SHIFT ) |
+           ( ( UINT64 )( pRecord->iMesh & DRAW_KEY_FIELD_MASK ) << DRAW_KEY_MESH_SHIFT ) |
+           ( ( UINT64 )LODKey << DRAW_KEY_LOD_SHIFT ) |
+           ( UINT64 )( pRecord->Topology & 0xff );
+}
+
+//--------------------------------------------------------------------------------------
+// Two draws can only become one when the primitives of the second start fresh where
+// the first's end, which is true for lists but not for strips
+//--------------------------------------------------------------------------------------
+static bool IsListTopology( UINT Topology )
+{
+    switch( Topology )
+    {
+        case D3D11_PRIMITIVE_TOPOLOGY_POINTLIST:
+        case D3D11_PRIMITIVE_TOPOLOGY_LINELIST:
+        case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST:
+        case D3D11_PRIMITIVE_TOPOLOGY_LINELIST_ADJ:
+        case D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST_ADJ:
+            return true;
+    }
+    return ( Topology >= D3D11_PRIMITIVE_TOPOLOGY_1_CONTROL_POINT_PATCHLIST &&
+             Topology <= D3D11_PRIMITIVE_TOPOLOGY_32_CONTROL_POINT_PATCHLIST );
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT GrowDrawList( SDKMESH_DRAW_LIST* pList, UINT MaxRecords )
+{
+    SDKMESH_DRAW_RECORD* pRecords = new SDKMESH_DRAW_RECORD[ MaxRecords ];
+    SDKMESH_DRAW_SORT_ITEM* pSortItems = new SDKMESH_DRAW_SORT_ITEM[ MaxRecords * 2 ];
+    SDKMESH_DRAW_COMMAND* pCommands = new SDKMESH_DRAW_COMMAND[ MaxRecords * 4 ];
+    if( !pRecords || !pSortItems || !pCommands )
+    {
+        SAFE_DELETE_ARRAY( pRecords );
+        SAFE_DELETE_ARRAY( pSortItems );
+        SAFE_DELETE_ARRAY( pCommands );
+        return E_OUTOFMEMORY;
+    }
+
+    if( pList->NumRecords > 0 )
+        CopyMemory( pRecords, pList->pRecords, sizeof( SDKMESH_DRAW_RECORD ) * pList->NumRecords );
+    SAFE_DELETE_ARRAY( pList->pRecords );
+    SAFE_DELETE_ARRAY( pList->pSortItems );
+    SAFE_DELETE_ARRAY( pList->pCommands );
+    pList->pRecords = pRecords;
+    pList->pSortItems = pSortItems;
+    pList->pCommands = pCommands;
+    pList->NumCommands = 0;
+    pList->MaxRecords = MaxRecords;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshCreateDrawList( UINT MaxRecords, SDKMESH_DRAW_LIST* pList )
+{
+    if( !pList )
+        return E_INVALIDARG;
+
+    ZeroMemory( pList, sizeof( SDKMESH_DRAW_LIST ) );
+    return GrowDrawList( pList, max( MaxRecords, 16 ) );
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshDestroyDrawList( SDKMESH_DRAW_LIST* pList )
+{
+    if( !pList )
+        return;
+
+    SAFE_DELETE_ARRAY( pList->pRecords );
+    SAFE_DELETE_ARRAY( pList->pSortItems );
+    SAFE_DELETE_ARRAY( pList->pCommands );
+    ZeroMemory( pList, sizeof( SDKMESH_DRAW_LIST ) );
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshResetDrawList( SDKMESH_DRAW_LIST* pList )
+{
+    pList->NumRecords = 0;
+    pList->NumCommands = 0;
+    ZeroMemory( &pList->Stats, sizeof( SDKMESH_DRAW_LIST_STATS ) );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshAddDrawRecord( SDKMESH_DRAW_LIST* pList, const SDKMESH_DRAW_RECORD* pRecord )
+{
+    if( pList->NumRecords == pList->MaxRecords )
+    {
+        HRESULT hr = GrowDrawList( pList, max( pList->MaxRecords * 2, 16 ) );
+        if( FAILED( hr ) )
+            return hr;
+    }
+
+    pList->pRecords[ pList->NumRecords++ ] = *pRecord;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Least significant digit radix sort, a byte at a time. Passes where every key has the
+// same byte change nothing and are skipped, which with the key layout above leaves two
+// to five passes in practice.
+//--------------------------------------------------------------------------------------
+static SDKMESH_DRAW_SORT_ITEM* RadixSortDraws( SDKMESH_DRAW_SORT_ITEM* pItems, SDKMESH_DRAW_SORT_ITEM* pScratch,
+                                               UINT NumItems )
+{
+    UINT Counts[256];
+    for( UINT Shift = 0; Shift < 64; Shift += 8 )
+    {
+        ZeroMemory( Counts, sizeof( Counts ) );
+        for( UINT i = 0; i < NumItems; i++ )
+            Counts[ ( pItems[i].Key >> Shift ) & 0xff ]++;
+        if( Counts[ ( pItems[0].Key >> Shift ) & 0xff ] == NumItems )
+            continue;
+
+        UINT Offset = 0;
+        for( UINT b = 0; b < 256; b++ )
+        {
+            UINT Count = Counts[b];
+            Counts[b] = Offset;
+            Offset += Count;
+        }
+        for( UINT i = 0; i < NumItems; i++ )
+            pScratch[ Counts[ ( pItems[i].Key >> Shift ) & 0xff ]++ ] = pItems[i];
+
+        SDKMESH_DRAW_SORT_ITEM* pSwap = pItems;
+        pItems = pScratch;
+        pScratch = pSwap;
+    }
+    return pItems;
+}
+
+//--------------------------------------------------------------------------------------
+static void AddDrawCommand( SDKMESH_DRAW_LIST* pList, UINT Op, UINT Arg0, UINT Arg1, UINT Arg2 )
+{
+    SDKMESH_DRAW_COMMAND* pCommand = &pList->pCommands[ pList->NumCommands++ ];
+    pCommand->Op = Op;
+    pCommand->Args[0] = Arg0;
+    pCommand->Args[1] = Arg1;
+    pCommand->Args[2] = Arg2;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshBuildDrawCommands( SDKMESH_DRAW_LIST* pList )
+{
+    if( !pList || !pList->pRecords )
+        return E_INVALIDARG;
+
+    SDKMESH_DRAW_LIST_STATS* pStats = &pList->Stats;
+    ZeroMemory( pStats, sizeof( SDKMESH_DRAW_LIST_STATS ) );
+    pList->NumCommands = 0;
+    pStats->NumRecords = pList->NumRecords;
+    if( pList->NumRecords == 0 )
+        return S_OK;
+
+    UINT LastMesh = DRAW_NONE, LastLOD = DRAW_NONE;
+    for( UINT i = 0; i < pList->NumRecords; i++ )
+    {
+        SDKMESH_DRAW_RECORD* pRecord = &pList->pRecords[i];
+        pRecord->Key = MakeDrawKey( pRecord );
+        pList->pSortItems[i].Key = pRecord->Key;
+        pList->pSortItems[i].iRecord = i;
+
+        if( pRecord->iMesh != LastMesh || pRecord->iLOD != LastLOD )
+            pStats->NumUnsortedBufferChanges++;
+        LastMesh = pRecord->iMesh;
+        LastLOD = pRecord->iLOD;
+    }
+    pStats->NumUnsortedTopologyChanges = pList->NumRecords;
+    pStats->NumUnsortedMaterialChanges = pList->NumRecords;
+
+    const SDKMESH_DRAW_SORT_ITEM* pSorted = RadixSortDraws( pList->pSortItems, pList->pSortItems + pList->MaxRecords,
+                                                            pList->NumRecords );
+
+    UINT LastTopology = DRAW_NONE, LastMaterial = DRAW_NONE;
+    LastMesh = LastLOD = DRAW_NONE;
+    SDKMESH_DRAW_COMMAND* pLastDraw = NULL;
+    for( UINT i = 0; i < pList->NumRecords; i++ )
+    {
+        const SDKMESH_DRAW_RECORD* pRecord = &pList->pRecords[ pSorted[i].iRecord ];
+        if( pRecord->iMesh != LastMesh || pRecord->iLOD != LastLOD )
+        {
+            AddDrawCommand( pList, SDKMESH_DRAW_SET_BUFFERS, pRecord->iMesh, pRecord->iLOD, 0 );
+            pStats->NumBufferChanges++;
+            LastMesh = pRecord->iMesh;
+            LastLOD = pRecord->iLOD;
+            pLastDraw = NULL;
+        }
+        if( pRecord->Topology != LastTopology )
+        {
+            AddDrawCommand( pList, SDKMESH_DRAW_SET_TOPOLOGY, pRecord->Topology, 0, 0 );
+            pStats->NumTopologyChanges++;
+            LastTopology = pRecord->Topology;
+            pLastDraw = NULL;
+        }
+        if( pRecord->iMaterial != LastMaterial )
+        {
+            AddDrawCommand( pList, SDKMESH_DRAW_SET_MATERIAL, pRecord->iMaterial, 0, 0 );
+            pStats->NumMaterialChanges++;
+            LastMaterial = pRecord->iMaterial;
+            pLastDraw = NULL;
+        }
+
+        if( pRecord->IndexCount == 0 )
+            continue;
+        if( pLastDraw && IsListTopology( LastTopology ) &&
+            pLastDraw->Args[1] + pLastDraw->Args[0] == pRecord->IndexStart &&
+            pLastDraw->Args[2] == pRecord->VertexStart )
+        {
+            pLastDraw->Args[0] += pRecord->IndexCount;
+            continue;
+        }
+        AddDrawCommand( pList, SDKMESH_DRAW_INDEXED, pRecord->IndexCount, pRecord->IndexStart, pRecord->VertexStart );
+        pLastDraw = &pList->pCommands[ pList->NumCommands - 1 ];
+        pStats->NumDraws++;
+    }
+
+    return S_OK;
+}
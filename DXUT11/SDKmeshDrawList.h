@@ -0,0 +1,108 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshDrawList.h
+//
+// State sorted draw lists for .sdkmesh rendering, filled by CDXUTSDKMesh::GatherDraws
+// and replayed by CDXUTSDKMesh::ExecuteDrawList. Building and sorting a list doesn't
+// touch a device, so both can be driven and checked entirely on the CPU.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHDRAWLIST_H
+#define SDKMESHDRAWLIST_H
+
+//--------------------------------------------------------------------------------------
+// One subset to draw. Key is filled in by SDKMeshBuildDrawCommands: the material in
+// the top 24 bits, then the mesh (24 bits) and LOD (8 bits) whose buffers are bound,
+// then the topology, so draws are grouped by material first and by buffers within it.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_DRAW_RECORD
+{
+    UINT64 Key;
+    UINT iMesh;
+    UINT iLOD;          // 0 for the mesh's own index buffer, or SDKMESH_DRAW_ADJACENCY
+    UINT iMaterial;     // or INVALID_MATERIAL
+    UINT Topology;      // D3D11_PRIMITIVE_TOPOLOGY
+    UINT IndexStart;
+    UINT IndexCount;
+    UINT VertexStart;
+};
+
+// iLOD of a draw from the mesh's adjacency index buffer
+#define SDKMESH_DRAW_ADJACENCY ((UINT)-1)
+
+//--------------------------------------------------------------------------------------
+// The command stream. A state command is only emitted when the state changes, and
+// list draws that continue the previous one's index range with the same VertexStart
+// are merged into it. Strip draws are never merged.
+//--------------------------------------------------------------------------------------
+enum SDKMESH_DRAW_OP
+{
+    SDKMESH_DRAW_SET_BUFFERS = 0,   // Args: iMesh, iLOD
+    SDKMESH_DRAW_SET_TOPOLOGY,      // Args: Topology
+    SDKMESH_DRAW_SET_MATERIAL,      // Args: iMaterial
+    SDKMESH_DRAW_INDEXED,           // Args: IndexCount, IndexStart, VertexStart
+};
+
+struct SDKMESH_DRAW_COMMAND
+{
+    UINT Op;
+    UINT Args[3];
+};
+
+// State changes in the sorted command stream, next to what drawing the records in the
+// order they were added would cost the way RenderMesh draws: buffers whenever the mesh
+// or LOD changes, topology and material for every subset.
+struct SDKMESH_DRAW_LIST_STATS
+{
+    UINT NumRecords;
+    UINT NumDraws;
+    UINT NumBufferChanges;
+    UINT NumTopologyChanges;
+    UINT NumMaterialChanges;
+    UINT NumUnsortedBufferChanges;
+    UINT NumUnsortedTopologyChanges;
+    UINT NumUnsortedMaterialChanges;
+};
+
+struct SDKMESH_DRAW_SORT_ITEM
+{
+    UINT64 Key;
+    UINT iRecord;
+};
+
+struct SDKMESH_DRAW_LIST
+{
+    SDKMESH_DRAW_RECORD* pRecords;
+    UINT NumRecords;
+    UINT MaxRecords;
+    SDKMESH_DRAW_SORT_ITEM* pSortItems;     // two halves of MaxRecords, for the radix passes
+    SDKMESH_DRAW_COMMAND* pCommands;        // up to four per record
+    UINT NumCommands;
+    SDKMESH_DRAW_LIST_STATS Stats;
+};
+
+// MaxRecords is only a starting size; adding records grows the list as needed
+HRESULT SDKMeshCreateDrawList( UINT MaxRecords, __out SDKMESH_DRAW_LIST* pList );
+void SDKMeshDestroyDrawList( __inout SDKMESH_DRAW_LIST* pList );
+
+// Empties the list, keeping its memory
+void SDKMeshResetDrawList( __inout SDKMESH_DRAW_LIST* pList );
+HRESULT SDKMeshAddDrawRecord( __inout SDKMESH_DRAW_LIST* pList, __in const SDKMESH_DRAW_RECORD* pRecord );
+
+// Radix sorts the records by key (stably, so equal keys keep the order they were added
+// in) and writes the command stream and its stats
+HRESULT SDKMeshBuildDrawCommands( __inout SDKMESH_DRAW_LIST* pList );
+
+// What ExecuteDrawList actually set on the context. Shader resources that are already
+// bound to a slot aren't set again, so materials sharing textures cost nothing.
+struct SDKMESH_DRAW_EXECUTE_STATS
+{
+    UINT NumVertexBufferSets;
+    UINT NumIndexBufferSets;
+    UINT NumTopologySets;
+    UINT NumShaderResourceSets;
+    UINT NumDraws;
+};
+
+#endif // SDKMESHDRAWLIST_H
@@ -0,0 +1,97 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshFrameIndex.cpp
+//
+// Hashed lookup of .sdkmesh frames by name
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+
+//--------------------------------------------------------------------------------------
+// FNV-1a over the name with ASCII letters folded to lower case, which is what _stricmp
+// ignores in the "C" locale. Stops at MAX_FRAME_NAME like the names in the file.
+//--------------------------------------------------------------------------------------
+UINT SDKMeshHashFrameName( const char* pszName )
+{
+    UINT Hash = 2166136261u;
+    for( UINT i = 0; i < MAX_FRAME_NAME && pszName[i]; i++ )
+    {
+        UINT c = ( BYTE )pszName[i];
+        if( c >= 'A' && c <= 'Z' )
+            c += 'a' - 'A';
+        Hash = ( Hash ^ c ) * 16777619u;
+    }
+    return Hash;
+}
+
+//--------------------------------------------------------------------------------------
+SDKMESH_FRAME_NAME SDKMeshMakeFrameName( const char* pszName )
+{
+    SDKMESH_FRAME_NAME Name;
+    Name.pszName = pszName;
+    Name.Hash = SDKMeshHashFrameName( pszName );
+    return Name;
+}
+
+//--------------------------------------------------------------------------------------
+// Frames go in by index, so along any probe sequence an earlier frame sits before a
+// later one with the same name and is found first
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshCreateFrameIndex( const SDKMESH_FRAME* pFrames, UINT NumFrames, SDKMESH_FRAME_INDEX* pIndex )
+{
+    ZeroMemory( pIndex, sizeof( SDKMESH_FRAME_INDEX ) );
+    if( NumFrames > 0x40000000 )
+        return E_INVALIDARG;
+
+    UINT NumSlots = 2;
+    while( NumSlots < NumFrames * 2 )
+        NumSlots *= 2;
+
+    pIndex->pSlots = new SDKMESH_FRAME_INDEX_SLOT[ NumSlots ];
+    if( !pIndex->pSlots )
+        return E_OUTOFMEMORY;
+    pIndex->SlotMask = NumSlots - 1;
+    for( UINT i = 0; i < NumSlots; i++ )
+    {
+        pIndex->pSlots[i].Hash = 0;
+        pIndex->pSlots[i].iFrame = INVALID_FRAME;
+    }
+
+    for( UINT i = 0; i < NumFrames; i++ )
+    {
+        UINT Hash = SDKMeshHashFrameName( pFrames[i].Name );
+        UINT iSlot = Hash & pIndex->SlotMask;
+        while( pIndex->pSlots[iSlot].iFrame != INVALID_FRAME )
+            iSlot = ( iSlot + 1 ) & pIndex->SlotMask;
+        pIndex->pSlots[iSlot].Hash = Hash;
+        pIndex->pSlots[iSlot].iFrame = i;
+    }
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshDestroyFrameIndex( SDKMESH_FRAME_INDEX* pIndex )
+{
+    SAFE_DELETE_ARRAY( pIndex->pSlots );
+    pIndex->SlotMask = 0;
+}
+
+//--------------------------------------------------------------------------------------
+UINT SDKMeshLookupFrame( const SDKMESH_FRAME_INDEX* pIndex, const SDKMESH_FRAME* pFrames,
+                         const SDKMESH_FRAME_NAME* pName )
+{
+    if( !pIndex->pSlots )
+        return INVALID_FRAME;
+
+    UINT iSlot = pName->Hash & pIndex->SlotMask;
+    for(; ; )
+    {
+        const SDKMESH_FRAME_INDEX_SLOT* pSlot = &pIndex->pSlots[iSlot];
+        if( pSlot->iFrame == INVALID_FRAME )
+            return INVALID_FRAME;
+        if( pSlot->Hash == pName->Hash && _strnicmp( pFrames[pSlot->iFrame].Name, pName->pszName, MAX_FRAME_NAME ) == 0 )
+            return pSlot->iFrame;
+        iSlot = ( iSlot + 1 ) & pIndex->SlotMask;
+    }
+}
@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshFrameIndex.h
+//
+// Hashed lookup of .sdkmesh frames by name
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHFRAMEINDEX_H
+#define SDKMESHFRAMEINDEX_H
+
+//--------------------------------------------------------------------------------------
+// Names match case-insensitively, as FindFrame always has. The table is open addressed
+// with linear probing and at most half full; each slot keeps the name's full hash, so
+// names are only compared when their hashes agree, which for a name that's present is
+// almost always just the one it matches.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_FRAME_INDEX_SLOT
+{
+    UINT Hash;
+    UINT iFrame;        // INVALID_FRAME for an empty slot
+};
+
+struct SDKMESH_FRAME_INDEX
+{
+    SDKMESH_FRAME_INDEX_SLOT* pSlots;
+    UINT SlotMask;      // the slot count, a power of two, less one
+};
+
+// A name hashed once up front, for code that looks the same frames up over and over.
+// pszName isn't copied and has to outlive the handle.
+struct SDKMESH_FRAME_NAME
+{
+    const char* pszName;
+    UINT Hash;
+};
+
+UINT SDKMeshHashFrameName( const char* pszName );
+SDKMESH_FRAME_NAME SDKMeshMakeFrameName( const char* pszName );
+
+// When names repeat, lookups find the first frame with the name, like a linear search
+HRESULT SDKMeshCreateFrameIndex( __in_ecount( NumFrames ) const SDKMESH_FRAME* pFrames, UINT NumFrames,
+                                 __out SDKMESH_FRAME_INDEX* pIndex );
+void SDKMeshDestroyFrameIndex( __inout SDKMESH_FRAME_INDEX* pIndex );
+
+// The frame named pName, or INVALID_FRAME
+UINT SDKMeshLookupFrame( const SDKMESH_FRAME_INDEX* pIndex, const SDKMESH_FRAME* pFrames,
+                         const SDKMESH_FRAME_NAME* pName );
+
+#endif // SDKMESHFRAMEINDEX_H
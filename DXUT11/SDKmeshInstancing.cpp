@@ -0,0 +1,96 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshInstancing.cpp
+//
+// Per-instance vertex data for CDXUTSDKMesh::RenderInstanced
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+
+// Vertex buffer offsets only need to be 4 byte aligned; 16 keeps each map's rows aligned
+#define INSTANCE_RING_ALIGNMENT 16
+
+//--------------------------------------------------------------------------------------
+void SDKMeshGetInstanceLayout( D3D11_INPUT_ELEMENT_DESC* pLayout )
+{
+    for( UINT i = 0; i < SDKMESH_INSTANCE_LAYOUT_ELEMENTS; i++ )
+    {
+        pLayout[i].SemanticName = "INSTANCETRANSFORM";
+        pLayout[i].SemanticIndex = i;
+        pLayout[i].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+        pLayout[i].InputSlot = SDKMESH_INSTANCE_SLOT;
+        pLayout[i].AlignedByteOffset = i * sizeof( D3DXVECTOR4 );
+        pLayout[i].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+        pLayout[i].InstanceDataStepRate = 1;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshCreateInstanceRing( ID3D11Device* pd3dDevice, UINT SizeBytes, SDKMESH_INSTANCE_RING* pRing )
+{
+    HRESULT hr;
+
+    if( !pd3dDevice || !pRing || SizeBytes == 0 )
+        return E_INVALIDARG;
+    ZeroMemory( pRing, sizeof( SDKMESH_INSTANCE_RING ) );
+
+    D3D11_BUFFER_DESC BufDesc;
+    BufDesc.ByteWidth = SizeBytes;
+    BufDesc.Usage = D3D11_USAGE_DYNAMIC;
+    BufDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    BufDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    BufDesc.MiscFlags = 0;
+    BufDesc.StructureByteStride = 0;
+    V_RETURN( pd3dDevice->CreateBuffer( &BufDesc, NULL, &pRing->pBuffer ) );
+    DXUT_SetDebugName( pRing->pBuffer, "SDKMESH_INSTANCE_RING" );
+
+    pRing->SizeBytes = SizeBytes;
+    pRing->OffsetBytes = 0;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshDestroyInstanceRing( SDKMESH_INSTANCE_RING* pRing )
+{
+    if( !pRing )
+        return;
+
+    SAFE_RELEASE( pRing->pBuffer );
+    ZeroMemory( pRing, sizeof( SDKMESH_INSTANCE_RING ) );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshMapInstances( ID3D11DeviceContext* pd3dDeviceContext, SDKMESH_INSTANCE_RING* pRing, UINT Stride,
+                             UINT* pNumInstances, void** ppData, UINT* pOffset )
+{
+    HRESULT hr;
+
+    if( !pRing || !pRing->pBuffer || Stride == 0 || Stride > pRing->SizeBytes )
+        return E_INVALIDARG;
+
+    // Append after the last map when the whole request fits there, otherwise start over
+    UINT Offset = ( pRing->OffsetBytes + INSTANCE_RING_ALIGNMENT - 1 ) & ~( INSTANCE_RING_ALIGNMENT - 1 );
+    D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+    if( Offset == 0 || Offset >= pRing->SizeBytes || ( UINT64 )Stride * *pNumInstances > pRing->SizeBytes - Offset )
+    {
+        Offset = 0;
+        MapType = D3D11_MAP_WRITE_DISCARD;
+    }
+
+    *pNumInstances = min( *pNumInstances, ( pRing->SizeBytes - Offset ) / Stride );
+
+    D3D11_MAPPED_SUBRESOURCE MappedResource;
+    V_RETURN( pd3dDeviceContext->Map( pRing->pBuffer, 0, MapType, 0, &MappedResource ) );
+
+    *ppData = ( BYTE* )MappedResource.pData + Offset;
+    *pOffset = Offset;
+    pRing->OffsetBytes = Offset + Stride * *pNumInstances;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshUnmapInstances( ID3D11DeviceContext* pd3dDeviceContext, SDKMESH_INSTANCE_RING* pRing )
+{
+    pd3dDeviceContext->Unmap( pRing->pBuffer, 0 );
+}
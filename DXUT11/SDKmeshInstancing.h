@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshInstancing.h
+//
+// Per-instance vertex data for CDXUTSDKMesh::RenderInstanced
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHINSTANCING_H
+#define SDKMESHINSTANCING_H
+
+//--------------------------------------------------------------------------------------
+// Each instance is its world matrix, as four float4 rows so a shader can rebuild it with
+// float4x4( r0, r1, r2, r3 ) and mul( Pos, World ), followed by the caller's own
+// per-instance data. The instance stream is bound after every slot an sdkmesh mesh can
+// use, so input layouts add SDKMeshGetInstanceLayout's elements to the mesh's and place
+// any extra data from byte SDKMESH_INSTANCE_TRANSFORM_BYTES on in SDKMESH_INSTANCE_SLOT.
+//--------------------------------------------------------------------------------------
+#define SDKMESH_INSTANCE_SLOT               MAX_VERTEX_STREAMS
+#define SDKMESH_INSTANCE_TRANSFORM_BYTES    sizeof( D3DXMATRIX )
+#define SDKMESH_INSTANCE_LAYOUT_ELEMENTS    4
+#define SDKMESH_INSTANCE_RING_BYTES         ( 256 * 1024 )
+
+// INSTANCETRANSFORM0 to INSTANCETRANSFORM3, one per matrix row
+void SDKMeshGetInstanceLayout( __out_ecount( SDKMESH_INSTANCE_LAYOUT_ELEMENTS ) D3D11_INPUT_ELEMENT_DESC* pLayout );
+
+//--------------------------------------------------------------------------------------
+// A dynamic vertex buffer handed out front to back. Each map appends with
+// D3D11_MAP_WRITE_NO_OVERWRITE after what earlier draws are still reading, and only
+// discards the buffer to start over once it's full.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_INSTANCE_RING
+{
+    ID3D11Buffer* pBuffer;
+    UINT SizeBytes;
+    UINT OffsetBytes;       // where the next map starts
+};
+
+HRESULT SDKMeshCreateInstanceRing( ID3D11Device* pd3dDevice, UINT SizeBytes, __out SDKMESH_INSTANCE_RING* pRing );
+void SDKMeshDestroyInstanceRing( __inout SDKMESH_INSTANCE_RING* pRing );
+
+// Maps room for up to *pNumInstances instances of Stride bytes, lowering it to what
+// fits. *pOffset is the byte offset to bind the buffer at; unmap before drawing.
+HRESULT SDKMeshMapInstances( ID3D11DeviceContext* pd3dDeviceContext, __inout SDKMESH_INSTANCE_RING* pRing,
+                             UINT Stride, __inout UINT* pNumInstances, __out void** ppData, __out UINT* pOffset );
+void SDKMeshUnmapInstances( ID3D11DeviceContext* pd3dDeviceContext, __in SDKMESH_INSTANCE_RING* pRing );
+
+#endif // SDKMESHINSTANCING_H
@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshMapping.h
+//
+// Copy-on-write file views used by CDXUTSDKMesh to load .sdkmesh files without
+// reading the vertex and index data into a heap copy first
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHMAPPING_H
+#define SDKMESHMAPPING_H
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// Outside of Windows the header stands alone, so the few Windows types it uses are
+// declared here, with the Windows sizes. HRESULT is 32 bits, so error codes are negative.
+typedef int32_t HRESULT;
+typedef void* HANDLE;
+typedef unsigned char BYTE;
+typedef uint64_t UINT64;
+typedef size_t SIZE_T;
+typedef uintptr_t UINT_PTR;
+
+#ifndef S_OK
+#define S_OK            ( ( HRESULT )0L )
+#endif
+#ifndef E_FAIL
+#define E_FAIL          ( ( HRESULT )0x80004005L )
+#endif
+#ifndef E_INVALIDARG
+#define E_INVALIDARG    ( ( HRESULT )0x80070057L )
+#endif
+#ifndef __out
+#define __out
+#endif
+#endif
+
+//--------------------------------------------------------------------------------------
+// Maps Size bytes of an open file. The view is private and copy-on-write, so the pages
+// come straight from the file cache and only the ones written to get a private copy.
+// On Windows hFile is a handle from CreateFile and *phMapping receives the section
+// handle; on POSIX hFile carries a file descriptor and *phMapping is set to NULL. The
+// file itself can be closed once the view exists.
+//--------------------------------------------------------------------------------------
+inline HRESULT SDKMeshMapFileView( HANDLE hFile, UINT64 Size, __out HANDLE* phMapping, __out BYTE** ppView )
+{
+    *phMapping = NULL;
+    *ppView = NULL;
+
+    if( Size == 0 || Size != ( SIZE_T )Size )
+        return E_INVALIDARG;
+
+#ifdef _WIN32
+    HANDLE hMapping = CreateFileMapping( hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+    if( !hMapping )
+        return HRESULT_FROM_WIN32( GetLastError() );
+
+    void* pView = MapViewOfFile( hMapping, FILE_MAP_COPY, 0, 0, ( SIZE_T )Size );
+    if( !pView )
+    {
+        HRESULT hr = HRESULT_FROM_WIN32( GetLastError() );
+        CloseHandle( hMapping );
+        return hr;
+    }
+
+    *phMapping = hMapping;
+#else
+    int fd = ( int )( intptr_t )hFile;
+    void* pView = mmap( NULL, ( size_t )Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    if( pView == MAP_FAILED )
+        return E_FAIL;
+
+    // The whole view is consumed front to back while the buffers are created
+    madvise( pView, ( size_t )Size, MADV_SEQUENTIAL );
+#endif
+
+    *ppView = ( BYTE* )pView;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+inline void SDKMeshUnmapFileView( HANDLE hMapping, BYTE* pView, UINT64 Size )
+{
+#ifdef _WIN32
+    if( pView )
+        UnmapViewOfFile( pView );
+    if( hMapping )
+        CloseHandle( hMapping );
+#else
+    if( pView )
+        munmap( pView, ( size_t )Size );
+#endif
+}
+
+//--------------------------------------------------------------------------------------
+// Takes the whole pages inside [pData, pData + Size) of a view out of the working set.
+// They come back from the file the next time they're read, so this is only for ranges
+// that were never written to, or the private copies would be lost.
+//--------------------------------------------------------------------------------------
+inline void SDKMeshReleaseFileViewPages( BYTE* pData, UINT64 Size )
+{
+#ifdef _WIN32
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo( &SystemInfo );
+    UINT_PTR PageSize = SystemInfo.dwPageSize;
+#else
+    UINT_PTR PageSize = ( UINT_PTR )sysconf( _SC_PAGESIZE );
+#endif
+    UINT_PTR Start = ( ( UINT_PTR )pData + PageSize - 1 ) & ~( PageSize - 1 );
+    UINT_PTR End = ( ( UINT_PTR )pData + ( UINT_PTR )Size ) & ~( PageSize - 1 );
+    if( !pData || End <= Start )
+        return;
+
+#ifdef _WIN32
+    // Unlocking pages that were never locked fails, but still trims them
+    VirtualUnlock( ( void* )Start, End - Start );
+#else
+    madvise( ( void* )Start, End - Start, MADV_DONTNEED );
+#endif
+}
+
+#endif // SDKMESHMAPPING_H
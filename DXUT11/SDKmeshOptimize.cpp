@@ -0,0 +1,503 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshOptimize.cpp
+//
+// Triangle and vertex reordering for the post-transform vertex cache and vertex fetch
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKmeshOptimize.h"
+#include <emmintrin.h>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshAnalyzeVertexCache( const UINT* pIndices, UINT NumIndices, UINT NumVertices, UINT CacheSize,
+                                   UINT* pNumMisses, UINT* pNumVertices )
+{
+    if( !pIndices || CacheSize == 0 )
+        return E_INVALIDARG;
+
+    // A vertex is in the cache while fewer than CacheSize misses have happened since it
+    // was loaded, so the FIFO only needs the miss count at which each vertex went in.
+    UINT* pLoaded = new UINT[NumVertices];
+    if( !pLoaded )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pLoaded, sizeof( UINT ) * NumVertices );
+
+    UINT NumMisses = 0;
+    UINT NumUsed = 0;
+    for( UINT i = 0; i < NumIndices; i++ )
+    {
+        UINT v = pIndices[i];
+        if( v >= NumVertices )
+        {
+            delete []pLoaded;
+            return E_INVALIDARG;
+        }
+
+        if( pLoaded[v] == 0 )
+            NumUsed++;
+        else if( NumMisses + 1 - pLoaded[v] <= CacheSize )
+            continue;
+
+        NumMisses++;
+        pLoaded[v] = NumMisses;
+    }
+
+    delete []pLoaded;
+
+    if( pNumMisses )
+        *pNumMisses = NumMisses;
+    if( pNumVertices )
+        *pNumVertices = NumUsed;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Forsyth's scoring. Vertices used by the last triangle score a flat 0.75 so the next
+// triangle doesn't have to reuse them in any particular order, the rest of the cache
+// falls off with position, and vertices with few triangles left get a boost so that
+// lone triangles are picked up before they are stranded.
+//--------------------------------------------------------------------------------------
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_CACHE_DECAY_POWER   1.5f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+#define FORSYTH_MAX_VALENCE_SCORE   32
+
+struct FORSYTH_SCORES
+{
+    float Cache[SDKMESH_OPTIMIZE_CACHE_SIZE];
+    float Valence[FORSYTH_MAX_VALENCE_SCORE];
+};
+
+static void InitForsythScores( FORSYTH_SCORES* pScores )
+{
+    for( UINT i = 0; i < SDKMESH_OPTIMIZE_CACHE_SIZE; i++ )
+    {
+        if( i < 3 )
+            pScores->Cache[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+        else
+            pScores->Cache[i] = powf( 1.0f - ( float )( i - 3 ) / ( SDKMESH_OPTIMIZE_CACHE_SIZE - 3 ),
+                                      FORSYTH_CACHE_DECAY_POWER );
+    }
+
+    pScores->Valence[0] = 0.0f;
+    for( UINT i = 1; i < FORSYTH_MAX_VALENCE_SCORE; i++ )
+        pScores->Valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf( ( float )i, -FORSYTH_VALENCE_BOOST_POWER );
+}
+
+static inline float GetForsythScore( const FORSYTH_SCORES* pScores, int CachePosition, UINT TrianglesLeft )
+{
+    // No triangles left to add, so the vertex no longer matters
+    if( TrianglesLeft == 0 )
+        return -1.0f;
+
+    float Score = ( CachePosition >= 0 ) ? pScores->Cache[CachePosition] : 0.0f;
+    if( TrianglesLeft < FORSYTH_MAX_VALENCE_SCORE )
+        Score += pScores->Valence[TrianglesLeft];
+    else
+        Score += FORSYTH_VALENCE_BOOST_SCALE * powf( ( float )TrianglesLeft, -FORSYTH_VALENCE_BOOST_POWER );
+    return Score;
+}
+
+//--------------------------------------------------------------------------------------
+// Per vertex: the triangles not yet added, packed at the front of the vertex's slice of
+// pVertexTriangles, and its score and cache position
+//--------------------------------------------------------------------------------------
+struct FORSYTH_BUFFERS
+{
+    FORSYTH_SCORES Scores;
+    UINT* pTrianglesLeft;
+    UINT* pFirstTriangle;
+    UINT* pVertexTriangles;
+    int* pCachePosition;
+    float* pVertexScore;
+    bool* pTriangleAdded;
+};
+
+static void OrderTriangles( FORSYTH_BUFFERS* pBuffers, const UINT* pIndices, UINT NumTriangles, UINT NumVertices,
+                            UINT* pOut )
+{
+    const FORSYTH_SCORES* pScores = &pBuffers->Scores;
+    UINT* pTrianglesLeft = pBuffers->pTrianglesLeft;
+    UINT* pFirstTriangle = pBuffers->pFirstTriangle;
+    UINT* pVertexTriangles = pBuffers->pVertexTriangles;
+    int* pCachePosition = pBuffers->pCachePosition;
+    float* pVertexScore = pBuffers->pVertexScore;
+    bool* pTriangleAdded = pBuffers->pTriangleAdded;
+
+    ZeroMemory( pTrianglesLeft, sizeof( UINT ) * NumVertices );
+    for( UINT i = 0; i < NumTriangles * 3; i++ )
+        pTrianglesLeft[pIndices[i]]++;
+
+    pFirstTriangle[0] = 0;
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        pFirstTriangle[v + 1] = pFirstTriangle[v] + pTrianglesLeft[v];
+        pTrianglesLeft[v] = 0;
+        pCachePosition[v] = -1;
+    }
+    for( UINT t = 0; t < NumTriangles; t++ )
+    {
+        for( UINT k = 0; k < 3; k++ )
+        {
+            UINT v = pIndices[t * 3 + k];
+            pVertexTriangles[pFirstTriangle[v] + pTrianglesLeft[v]++] = t;
+        }
+    }
+
+    for( UINT v = 0; v < NumVertices; v++ )
+        pVertexScore[v] = GetForsythScore( pScores, -1, pTrianglesLeft[v] );
+
+    UINT BestTriangle = 0;
+    float BestScore = -1.0f;
+    for( UINT t = 0; t < NumTriangles; t++ )
+    {
+        pTriangleAdded[t] = false;
+        float Score = pVertexScore[pIndices[t * 3]] + pVertexScore[pIndices[t * 3 + 1]] +
+            pVertexScore[pIndices[t * 3 + 2]];
+        if( Score > BestScore )
+        {
+            BestScore = Score;
+            BestTriangle = t;
+        }
+    }
+
+    // The cache holds three extra entries while a triangle's vertices are pushed in
+    UINT Cache[SDKMESH_OPTIMIZE_CACHE_SIZE + 3];
+    UINT NewCache[SDKMESH_OPTIMIZE_CACHE_SIZE + 3];
+    UINT CacheCount = 0;
+    UINT NextUnadded = 0;
+
+    for( UINT iOut = 0; iOut < NumTriangles; iOut++ )
+    {
+        // Nothing in the cache has triangles left; carry on with the first triangle
+        // not yet added rather than searching the whole mesh for the best one
+        if( BestTriangle == UINT_MAX )
+        {
+            while( pTriangleAdded[NextUnadded] )
+                NextUnadded++;
+            BestTriangle = NextUnadded;
+        }
+
+        const UINT* pTri = &pIndices[BestTriangle * 3];
+        pOut[iOut * 3] = pTri[0];
+        pOut[iOut * 3 + 1] = pTri[1];
+        pOut[iOut * 3 + 2] = pTri[2];
+        pTriangleAdded[BestTriangle] = true;
+
+        // Take the triangle off its vertices' lists
+        for( UINT k = 0; k < 3; k++ )
+        {
+            UINT v = pTri[k];
+            UINT* pList = &pVertexTriangles[pFirstTriangle[v]];
+            UINT Last = --pTrianglesLeft[v];
+            for( UINT j = 0; j <= Last; j++ )
+            {
+                if( pList[j] == BestTriangle )
+                {
+                    pList[j] = pList[Last];
+                    break;
+                }
+            }
+        }
+
+        // Push the triangle's vertices to the front of the cache
+        UINT NewCount = 0;
+        for( UINT k = 0; k < 3; k++ )
+        {
+            if( NewCount == 0 || NewCache[0] != pTri[k] )
+            {
+                if( NewCount < 2 || NewCache[1] != pTri[k] )
+                    NewCache[NewCount++] = pTri[k];
+            }
+        }
+        for( UINT j = 0; j < CacheCount; j++ )
+        {
+            UINT v = Cache[j];
+            if( v != pTri[0] && v != pTri[1] && v != pTri[2] )
+                NewCache[NewCount++] = v;
+        }
+
+        // Rescore everything that moved, including what fell out of the cache
+        for( UINT j = 0; j < NewCount; j++ )
+        {
+            UINT v = NewCache[j];
+            pCachePosition[v] = ( j < SDKMESH_OPTIMIZE_CACHE_SIZE ) ? ( int )j : -1;
+            pVertexScore[v] = GetForsythScore( pScores, pCachePosition[v], pTrianglesLeft[v] );
+        }
+
+        BestTriangle = UINT_MAX;
+        BestScore = -1.0f;
+        for( UINT j = 0; j < NewCount; j++ )
+        {
+            UINT v = NewCache[j];
+            const UINT* pList = &pVertexTriangles[pFirstTriangle[v]];
+            for( UINT n = 0; n < pTrianglesLeft[v]; n++ )
+            {
+                UINT t = pList[n];
+                const UINT* pAdj = &pIndices[t * 3];
+                float Score = pVertexScore[pAdj[0]] + pVertexScore[pAdj[1]] + pVertexScore[pAdj[2]];
+                if( Score > BestScore )
+                {
+                    BestScore = Score;
+                    BestTriangle = t;
+                }
+            }
+        }
+
+        CacheCount = min( NewCount, ( UINT )SDKMESH_OPTIMIZE_CACHE_SIZE );
+        CopyMemory( Cache, NewCache, sizeof( UINT ) * CacheCount );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshOptimizeFaces( const UINT* pIndices, UINT NumIndices, UINT NumVertices, UINT* pOut )
+{
+    if( !pIndices || !pOut || pIndices == pOut )
+        return E_INVALIDARG;
+
+    UINT NumTriangles = NumIndices / 3;
+    if( NumTriangles == 0 )
+        return S_OK;
+
+    for( UINT i = 0; i < NumTriangles * 3; i++ )
+    {
+        if( pIndices[i] >= NumVertices )
+            return E_INVALIDARG;
+    }
+
+    FORSYTH_BUFFERS Buffers;
+    InitForsythScores( &Buffers.Scores );
+    Buffers.pTrianglesLeft = new UINT[NumVertices];
+    Buffers.pFirstTriangle = new UINT[NumVertices + 1];
+    Buffers.pVertexTriangles = new UINT[NumTriangles * 3];
+    Buffers.pCachePosition = new int[NumVertices];
+    Buffers.pVertexScore = new float[NumVertices];
+    Buffers.pTriangleAdded = new bool[NumTriangles];
+
+    HRESULT hr = E_OUTOFMEMORY;
+    if( Buffers.pTrianglesLeft && Buffers.pFirstTriangle && Buffers.pVertexTriangles && Buffers.pCachePosition &&
+        Buffers.pVertexScore && Buffers.pTriangleAdded )
+    {
+        OrderTriangles( &Buffers, pIndices, NumTriangles, NumVertices, pOut );
+        hr = S_OK;
+    }
+
+    SAFE_DELETE_ARRAY( Buffers.pTrianglesLeft );
+    SAFE_DELETE_ARRAY( Buffers.pFirstTriangle );
+    SAFE_DELETE_ARRAY( Buffers.pVertexTriangles );
+    SAFE_DELETE_ARRAY( Buffers.pCachePosition );
+    SAFE_DELETE_ARRAY( Buffers.pVertexScore );
+    SAFE_DELETE_ARRAY( Buffers.pTriangleAdded );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+UINT SDKMeshRemapVertices( UINT* pIndices, UINT NumIndices, UINT* pRemap, UINT NextVertex )
+{
+    for( UINT i = 0; i < NumIndices; i++ )
+    {
+        UINT v = pIndices[i];
+        if( pRemap[v] == SDKMESH_UNUSED_VERTEX )
+            pRemap[v] = NextVertex++;
+        pIndices[i] = pRemap[v];
+    }
+    return NextVertex;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshFinishVertexRemap( UINT* pRemap, UINT NumVertices, UINT NextVertex )
+{
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        if( pRemap[v] == SDKMESH_UNUSED_VERTEX )
+            pRemap[v] = NextVertex++;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshPermuteVertices( BYTE* pVertices, UINT Stride, UINT NumVertices, const UINT* pRemap )
+{
+    SIZE_T Bytes = ( SIZE_T )Stride * NumVertices;
+    BYTE* pCopy = new BYTE[Bytes];
+    if( !pCopy )
+        return E_OUTOFMEMORY;
+    CopyMemory( pCopy, pVertices, Bytes );
+
+    for( UINT v = 0; v < NumVertices; v++ )
+        CopyMemory( pVertices + ( SIZE_T )pRemap[v] * Stride, pCopy + ( SIZE_T )v * Stride, Stride );
+
+    delete []pCopy;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// The non-empty ranges are sorted by buffer and start, so a group is a run in which
+// each range starts before the furthest end seen so far
+//--------------------------------------------------------------------------------------
+struct SDKMESH_SORTED_RANGE
+{
+    UINT iBuffer;
+    UINT iRange;
+    UINT64 Start;
+    UINT64 End;
+};
+
+static int __cdecl CompareSortedRanges( const void* pA, const void* pB )
+{
+    const SDKMESH_SORTED_RANGE* pRangeA = ( const SDKMESH_SORTED_RANGE* )pA;
+    const SDKMESH_SORTED_RANGE* pRangeB = ( const SDKMESH_SORTED_RANGE* )pB;
+    if( pRangeA->iBuffer != pRangeB->iBuffer )
+        return pRangeA->iBuffer < pRangeB->iBuffer ? -1 : 1;
+    if( pRangeA->Start != pRangeB->Start )
+        return pRangeA->Start < pRangeB->Start ? -1 : 1;
+    return ( int )pRangeA->iRange - ( int )pRangeB->iRange;
+}
+
+HRESULT SDKMeshGroupIndexRanges( const SDKMESH_INDEX_RANGE* pRanges, UINT NumRanges, UINT* pGroup,
+                                 bool* pSameRange )
+{
+    if( ( !pRanges || !pGroup ) && NumRanges > 0 )
+        return E_INVALIDARG;
+
+    SDKMESH_SORTED_RANGE* pSorted = new SDKMESH_SORTED_RANGE[ max( NumRanges, 1 ) ];
+    if( !pSorted )
+        return E_OUTOFMEMORY;
+
+    UINT NumSorted = 0;
+    for( UINT i = 0; i < NumRanges; i++ )
+    {
+        pGroup[i] = i;
+        if( pSameRange )
+            pSameRange[i] = true;
+        if( pRanges[i].IndexCount == 0 )
+            continue;
+
+        SDKMESH_SORTED_RANGE* pRange = &pSorted[NumSorted++];
+        pRange->iBuffer = pRanges[i].iBuffer;
+        pRange->iRange = i;
+        pRange->Start = pRanges[i].IndexStart;
+        pRange->End = pRanges[i].IndexStart + pRanges[i].IndexCount;
+    }
+    qsort( pSorted, NumSorted, sizeof( SDKMESH_SORTED_RANGE ), CompareSortedRanges );
+
+    for( UINT iFirst = 0; iFirst < NumSorted; )
+    {
+        UINT iLast = iFirst + 1;
+        UINT iLowest = pSorted[iFirst].iRange;
+        UINT64 End = pSorted[iFirst].End;
+        bool bSame = true;
+        for( ; iLast < NumSorted && pSorted[iLast].iBuffer == pSorted[iFirst].iBuffer &&
+               pSorted[iLast].Start < End; iLast++ )
+        {
+            iLowest = min( iLowest, pSorted[iLast].iRange );
+            End = max( End, pSorted[iLast].End );
+            bSame = bSame && pSorted[iLast].Start == pSorted[iFirst].Start &&
+                    pSorted[iLast].End == pSorted[iFirst].End;
+        }
+
+        for( UINT i = iFirst; i < iLast; i++ )
+            pGroup[pSorted[i].iRange] = iLowest;
+        if( pSameRange )
+            pSameRange[iLowest] = bSame;
+        iFirst = iLast;
+    }
+
+    delete []pSorted;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Same sort and sweep as above. A merged group keeps its lowest range; a clipped one
+// walks its ranges by start, so the part already covered is always one span from the
+// group's start, and what's left of each range is the part past that span.
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshSplitIndexRanges( SDKMESH_INDEX_RANGE* pRanges, UINT NumRanges, const UINT64* pMergeKeys )
+{
+    if( ( !pRanges || !pMergeKeys ) && NumRanges > 0 )
+        return E_INVALIDARG;
+
+    SDKMESH_SORTED_RANGE* pSorted = new SDKMESH_SORTED_RANGE[ max( NumRanges, 1 ) ];
+    if( !pSorted )
+        return E_OUTOFMEMORY;
+
+    UINT NumSorted = 0;
+    for( UINT i = 0; i < NumRanges; i++ )
+    {
+        pRanges[i].IndexCount = pRanges[i].IndexCount / 3 * 3;
+        if( pRanges[i].IndexCount == 0 )
+            continue;
+
+        SDKMESH_SORTED_RANGE* pRange = &pSorted[NumSorted++];
+        pRange->iBuffer = pRanges[i].iBuffer;
+        pRange->iRange = i;
+        pRange->Start = pRanges[i].IndexStart;
+        pRange->End = pRanges[i].IndexStart + pRanges[i].IndexCount;
+    }
+    qsort( pSorted, NumSorted, sizeof( SDKMESH_SORTED_RANGE ), CompareSortedRanges );
+
+    for( UINT iFirst = 0; iFirst < NumSorted; )
+    {
+        const SDKMESH_SORTED_RANGE* pFirst = &pSorted[iFirst];
+        UINT iLast = iFirst + 1;
+        UINT iLowest = pFirst->iRange;
+        UINT64 End = pFirst->End;
+        bool bMerge = true;
+        for( ; iLast < NumSorted && pSorted[iLast].iBuffer == pFirst->iBuffer && pSorted[iLast].Start < End; iLast++ )
+        {
+            iLowest = min( iLowest, pSorted[iLast].iRange );
+            End = max( End, pSorted[iLast].End );
+            bMerge = bMerge && pMergeKeys[pSorted[iLast].iRange] == pMergeKeys[pFirst->iRange] &&
+                     ( pSorted[iLast].Start - pFirst->Start ) % 3 == 0;
+        }
+
+        if( bMerge )
+        {
+            for( UINT i = iFirst; i < iLast; i++ )
+                pRanges[pSorted[i].iRange].IndexCount = 0;
+            pRanges[iLowest].IndexStart = pFirst->Start;
+            pRanges[iLowest].IndexCount = End - pFirst->Start;
+        }
+        else
+        {
+            UINT64 Covered = pFirst->Start;
+            for( UINT i = iFirst; i < iLast; i++ )
+            {
+                // Round the clip up to the range's own next triangle
+                const SDKMESH_SORTED_RANGE* pRange = &pSorted[i];
+                UINT64 Start = max( pRange->Start, Covered );
+                Start = pRange->Start + ( Start - pRange->Start + 2 ) / 3 * 3;
+                pRanges[pRange->iRange].IndexStart = min( Start, pRange->End );
+                pRanges[pRange->iRange].IndexCount = ( Start < pRange->End ) ? pRange->End - Start : 0;
+                Covered = max( Covered, pRange->End );
+            }
+        }
+        iFirst = iLast;
+    }
+
+    delete []pSorted;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// SSE2 only packs with signed saturation, so the indices are biased into signed range
+// first and back again after. Each step reads 32 bytes before writing 16 at no more
+// than half the offset, so working in place never overwrites an unread index.
+//--------------------------------------------------------------------------------------
+void SDKMeshPackIndices16( const UINT* pIndices, UINT64 NumIndices, WORD* pOut )
+{
+    const __m128i vBias32 = _mm_set1_epi32( 0x8000 );
+    const __m128i vBias16 = _mm_set1_epi16( ( short )0x8000 );
+
+    UINT64 i = 0;
+    for( ; i + 8 <= NumIndices; i += 8 )
+    {
+        __m128i vLow = _mm_sub_epi32( _mm_loadu_si128( ( const __m128i* )( pIndices + i ) ), vBias32 );
+        __m128i vHigh = _mm_sub_epi32( _mm_loadu_si128( ( const __m128i* )( pIndices + i + 4 ) ), vBias32 );
+        _mm_storeu_si128( ( __m128i* )( pOut + i ), _mm_xor_si128( _mm_packs_epi32( vLow, vHigh ), vBias16 ) );
+    }
+    for( ; i < NumIndices; i++ )
+        pOut[i] = ( WORD )pIndices[i];
+}
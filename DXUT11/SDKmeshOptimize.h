@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshOptimize.h
+//
+// Triangle and vertex reordering for the post-transform vertex cache and vertex fetch,
+// used by CDXUTSDKMesh when load optimization is turned on
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHOPTIMIZE_H
+#define SDKMESHOPTIMIZE_H
+
+//--------------------------------------------------------------------------------------
+// Triangles are ordered for an LRU cache of SDKMESH_OPTIMIZE_CACHE_SIZE entries, using
+// Tom Forsyth's linear-speed vertex cache optimization. Results are measured against a
+// FIFO cache of SDKMESH_MEASURE_CACHE_SIZE entries, which is closer to what hardware
+// does and makes numbers comparable with other tools.
+//--------------------------------------------------------------------------------------
+#define SDKMESH_OPTIMIZE_CACHE_SIZE 32
+#define SDKMESH_MEASURE_CACHE_SIZE  16
+
+// ACMR is cache misses per triangle (0.5 at best for a regular grid, 3 at worst); ATVR is
+// cache misses per vertex referenced (1 at best).
+struct SDKMESH_VERTEX_CACHE_STATS
+{
+    UINT NumSubsets;        // triangle list subsets that were reordered
+    UINT NumTriangles;
+    UINT NumVertices;       // distinct vertices referenced by those subsets
+    UINT NumRemappedVertexRanges;
+    UINT NumMissesBefore;
+    UINT NumMissesAfter;
+    float ACMRBefore;
+    float ACMRAfter;
+    float ATVRBefore;
+    float ATVRAfter;
+};
+
+// Simulates a FIFO cache of CacheSize entries over a triangle list whose indices are all
+// below NumVertices. Either output may be NULL.
+HRESULT SDKMeshAnalyzeVertexCache( __in_ecount( NumIndices ) const UINT* pIndices, UINT NumIndices,
+                                   UINT NumVertices, UINT CacheSize, __out_opt UINT* pNumMisses,
+                                   __out_opt UINT* pNumVertices );
+
+// Writes the triangles of a triangle list to pOut in cache friendly order. The winding of
+// each triangle is kept. pOut may not be pIndices.
+HRESULT SDKMeshOptimizeFaces( __in_ecount( NumIndices ) const UINT* pIndices, UINT NumIndices,
+                              UINT NumVertices, __out_ecount( NumIndices ) UINT* pOut );
+
+//--------------------------------------------------------------------------------------
+// Vertex fetch ordering. pRemap maps each old vertex to its new position and starts out
+// filled with SDKMESH_UNUSED_VERTEX. SDKMeshRemapVertices numbers the vertices of
+// pIndices in order of first use from NextVertex on, rewrites pIndices and returns the
+// next free number, so several index lists sharing vertices can be run through it in
+// turn. SDKMeshFinishVertexRemap then places unused vertices after the used ones and
+// SDKMeshPermuteVertices moves each stream's vertices to match.
+//--------------------------------------------------------------------------------------
+#define SDKMESH_UNUSED_VERTEX 0xffffffff
+
+UINT SDKMeshRemapVertices( __inout_ecount( NumIndices ) UINT* pIndices, UINT NumIndices,
+                           __inout UINT* pRemap, UINT NextVertex );
+void SDKMeshFinishVertexRemap( __inout_ecount( NumVertices ) UINT* pRemap, UINT NumVertices, UINT NextVertex );
+HRESULT SDKMeshPermuteVertices( __inout BYTE* pVertices, UINT Stride, UINT NumVertices,
+                                __in_ecount( NumVertices ) const UINT* pRemap );
+
+//--------------------------------------------------------------------------------------
+// Index ranges of subsets, for finding the ones that share indices. Ranges of the same
+// buffer that overlap, directly or through a chain of others, form one group, and
+// pGroup[i] is the lowest numbered range in range i's group. A range overlapping
+// nothing, or empty, is a group of its own. pSameRange, which may be NULL, is set at
+// each group's lowest range to whether every range of the group is the same range,
+// meaning the subsets share their indices rather than partly overlap.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_INDEX_RANGE
+{
+    UINT iBuffer;
+    UINT64 IndexStart;
+    UINT64 IndexCount;
+};
+
+HRESULT SDKMeshGroupIndexRanges( __in_ecount( NumRanges ) const SDKMESH_INDEX_RANGE* pRanges, UINT NumRanges,
+                                 __out_ecount( NumRanges ) UINT* pGroup,
+                                 __out_ecount_opt( NumRanges ) bool* pSameRange = NULL );
+
+//--------------------------------------------------------------------------------------
+// Rewrites the ranges, each rounded down to whole triangles, so that no two overlap.
+// A group whose ranges all have the same merge key, and whose triangles line up,
+// becomes its lowest numbered range spanning the whole group, and the rest are
+// emptied. In any other group each range, taken by start, keeps only its triangles
+// past the ones before it cover.
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshSplitIndexRanges( __inout_ecount( NumRanges ) SDKMESH_INDEX_RANGE* pRanges, UINT NumRanges,
+                                 __in_ecount( NumRanges ) const UINT64* pMergeKeys );
+
+// Narrows 32 bit indices to 16 bits with SSE2. Every index must be below 65536. pOut
+// may be pIndices, which leaves the packed indices in the first half of the buffer.
+void SDKMeshPackIndices16( __in_ecount( NumIndices ) const UINT* pIndices, UINT64 NumIndices,
+                           __out_ecount( NumIndices ) WORD* pOut );
+
+#endif // SDKMESHOPTIMIZE_H
@@ -0,0 +1,351 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshQuantize.cpp
+//
+// Vertex stream quantization for .sdkmesh vertex buffers
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+#include <math.h>
+
+#define QUANTIZE_SNORM16_MAX 32767.0f
+
+// What each element of a stream turns into
+enum SDKMESH_QUANTIZE_OP
+{
+    QUANTIZE_COPY = 0,
+    QUANTIZE_POSITION,
+    QUANTIZE_DIRECTION,
+    QUANTIZE_TANGENT_FRAME,
+    QUANTIZE_TEXCOORD,
+};
+
+//--------------------------------------------------------------------------------------
+static UINT GetDeclTypeSize( BYTE Type )
+{
+    switch( Type )
+    {
+        case D3DDECLTYPE_FLOAT1:
+        case D3DDECLTYPE_D3DCOLOR:
+        case D3DDECLTYPE_UBYTE4:
+        case D3DDECLTYPE_UBYTE4N:
+        case D3DDECLTYPE_SHORT2:
+        case D3DDECLTYPE_SHORT2N:
+        case D3DDECLTYPE_USHORT2N:
+        case D3DDECLTYPE_UDEC3:
+        case D3DDECLTYPE_DEC3N:
+        case D3DDECLTYPE_FLOAT16_2:
+            return 4;
+        case D3DDECLTYPE_FLOAT2:
+        case D3DDECLTYPE_SHORT4:
+        case D3DDECLTYPE_SHORT4N:
+        case D3DDECLTYPE_USHORT4N:
+        case D3DDECLTYPE_FLOAT16_4:
+            return 8;
+        case D3DDECLTYPE_FLOAT3:
+            return 12;
+        case D3DDECLTYPE_FLOAT4:
+            return 16;
+    }
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+static LPCSTR GetDeclUsageSemantic( BYTE Usage )
+{
+    switch( Usage )
+    {
+        case D3DDECLUSAGE_POSITION:     return "POSITION";
+        case D3DDECLUSAGE_BLENDWEIGHT:  return "BLENDWEIGHT";
+        case D3DDECLUSAGE_BLENDINDICES: return "BLENDINDICES";
+        case D3DDECLUSAGE_NORMAL:       return "NORMAL";
+        case D3DDECLUSAGE_PSIZE:        return "PSIZE";
+        case D3DDECLUSAGE_TEXCOORD:     return "TEXCOORD";
+        case D3DDECLUSAGE_TANGENT:      return "TANGENT";
+        case D3DDECLUSAGE_BINORMAL:     return "BINORMAL";
+        case D3DDECLUSAGE_TESSFACTOR:   return "TESSFACTOR";
+        case D3DDECLUSAGE_POSITIONT:    return "POSITIONT";
+        case D3DDECLUSAGE_COLOR:        return "COLOR";
+        case D3DDECLUSAGE_FOG:          return "FOG";
+        case D3DDECLUSAGE_DEPTH:        return "DEPTH";
+        case D3DDECLUSAGE_SAMPLE:       return "SAMPLE";
+    }
+    return "TEXCOORD";
+}
+
+//--------------------------------------------------------------------------------------
+DXGI_FORMAT SDKMeshGetDeclTypeFormat( BYTE Type )
+{
+    switch( Type )
+    {
+        case D3DDECLTYPE_FLOAT1:    return DXGI_FORMAT_R32_FLOAT;
+        case D3DDECLTYPE_FLOAT2:    return DXGI_FORMAT_R32G32_FLOAT;
+        case D3DDECLTYPE_FLOAT3:    return DXGI_FORMAT_R32G32B32_FLOAT;
+        case D3DDECLTYPE_FLOAT4:    return DXGI_FORMAT_R32G32B32A32_FLOAT;
+        case D3DDECLTYPE_D3DCOLOR:  return DXGI_FORMAT_B8G8R8A8_UNORM;
+        case D3DDECLTYPE_UBYTE4:    return DXGI_FORMAT_R8G8B8A8_UINT;
+        case D3DDECLTYPE_SHORT2:    return DXGI_FORMAT_R16G16_SINT;
+        case D3DDECLTYPE_SHORT4:    return DXGI_FORMAT_R16G16B16A16_SINT;
+        case D3DDECLTYPE_UBYTE4N:   return DXGI_FORMAT_R8G8B8A8_UNORM;
+        case D3DDECLTYPE_SHORT2N:   return DXGI_FORMAT_R16G16_SNORM;
+        case D3DDECLTYPE_SHORT4N:   return DXGI_FORMAT_R16G16B16A16_SNORM;
+        case D3DDECLTYPE_USHORT2N:  return DXGI_FORMAT_R16G16_UNORM;
+        case D3DDECLTYPE_USHORT4N:  return DXGI_FORMAT_R16G16B16A16_UNORM;
+        case D3DDECLTYPE_UDEC3:     return DXGI_FORMAT_R10G10B10A2_UINT;
+        case D3DDECLTYPE_FLOAT16_2: return DXGI_FORMAT_R16G16_FLOAT;
+        case D3DDECLTYPE_FLOAT16_4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    }
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+//--------------------------------------------------------------------------------------
+static SDKMESH_QUANTIZE_OP GetQuantizeOp( const D3DVERTEXELEMENT9* pElement )
+{
+    switch( pElement->Usage )
+    {
+        case D3DDECLUSAGE_POSITION:
+            if( pElement->Type == D3DDECLTYPE_FLOAT3 )
+                return QUANTIZE_POSITION;
+            break;
+        case D3DDECLUSAGE_NORMAL:
+        case D3DDECLUSAGE_BINORMAL:
+            if( pElement->Type == D3DDECLTYPE_FLOAT3 )
+                return QUANTIZE_DIRECTION;
+            break;
+        case D3DDECLUSAGE_TANGENT:
+            if( pElement->Type == D3DDECLTYPE_FLOAT3 )
+                return QUANTIZE_DIRECTION;
+            if( pElement->Type == D3DDECLTYPE_FLOAT4 )
+                return QUANTIZE_TANGENT_FRAME;
+            break;
+        case D3DDECLUSAGE_TEXCOORD:
+            if( pElement->Type == D3DDECLTYPE_FLOAT2 )
+                return QUANTIZE_TEXCOORD;
+            break;
+    }
+    return QUANTIZE_COPY;
+}
+
+//--------------------------------------------------------------------------------------
+static inline SHORT PackSnorm16( float f )
+{
+    f = max( -1.0f, min( 1.0f, f ) );
+    return ( SHORT )( f * QUANTIZE_SNORM16_MAX + ( f >= 0.0f ? 0.5f : -0.5f ) );
+}
+
+static inline float UnpackSnorm16( SHORT s )
+{
+    return max( -1.0f, s / QUANTIZE_SNORM16_MAX );
+}
+
+//--------------------------------------------------------------------------------------
+// Octahedral encoding (Meyer et al.): the unit sphere is projected onto the octahedron
+// |x| + |y| + |z| = 1 and the lower half folded over the upper one, giving a square.
+//--------------------------------------------------------------------------------------
+static void EncodeOctahedral( const float* pDir, SHORT* pOut )
+{
+    float Sum = fabsf( pDir[0] ) + fabsf( pDir[1] ) + fabsf( pDir[2] );
+    float u = 0.0f, v = 0.0f;
+    if( Sum > 0.0f )
+    {
+        u = pDir[0] / Sum;
+        v = pDir[1] / Sum;
+        if( pDir[2] < 0.0f )
+        {
+            float FoldU = ( 1.0f - fabsf( v ) ) * ( u >= 0.0f ? 1.0f : -1.0f );
+            float FoldV = ( 1.0f - fabsf( u ) ) * ( v >= 0.0f ? 1.0f : -1.0f );
+            u = FoldU;
+            v = FoldV;
+        }
+    }
+    pOut[0] = PackSnorm16( u );
+    pOut[1] = PackSnorm16( v );
+}
+
+static void DecodeOctahedral( const SHORT* pIn, float* pDir )
+{
+    float u = UnpackSnorm16( pIn[0] );
+    float v = UnpackSnorm16( pIn[1] );
+    float z = 1.0f - fabsf( u ) - fabsf( v );
+    if( z < 0.0f )
+    {
+        float FoldU = ( 1.0f - fabsf( v ) ) * ( u >= 0.0f ? 1.0f : -1.0f );
+        float FoldV = ( 1.0f - fabsf( u ) ) * ( v >= 0.0f ? 1.0f : -1.0f );
+        u = FoldU;
+        v = FoldV;
+    }
+    float Length = sqrtf( u * u + v * v + z * z );
+    pDir[0] = u / Length;
+    pDir[1] = v / Length;
+    pDir[2] = z / Length;
+}
+
+//--------------------------------------------------------------------------------------
+// Angle between a direction that may not be unit length and a decoded one. acosf of
+// the dot product rounds angles below about 0.0005 radians, which is more than the
+// encoding's own error, so this goes through the sine as well.
+//--------------------------------------------------------------------------------------
+static float GetDirectionError( const float* pSource, const float* pDecoded )
+{
+    double Cross[3] =
+    {
+        ( double )pSource[1] * pDecoded[2] - ( double )pSource[2] * pDecoded[1],
+        ( double )pSource[2] * pDecoded[0] - ( double )pSource[0] * pDecoded[2],
+        ( double )pSource[0] * pDecoded[1] - ( double )pSource[1] * pDecoded[0],
+    };
+    double Dot = ( double )pSource[0] * pDecoded[0] + ( double )pSource[1] * pDecoded[1] +
+                 ( double )pSource[2] * pDecoded[2];
+    double Sin = sqrt( Cross[0] * Cross[0] + Cross[1] * Cross[1] + Cross[2] * Cross[2] );
+    if( Sin <= 0.0 && Dot == 0.0 )
+        return 0.0f;
+    return ( float )atan2( Sin, Dot );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshQuantizeStream( const D3DVERTEXELEMENT9* pDecl, UINT Stride, UINT64 NumVertices,
+                               const BYTE* pVertices, SDKMESH_QUANTIZED_STREAM* pStream )
+{
+    if( !pDecl || !pVertices || !pStream )
+        return E_INVALIDARG;
+
+    ZeroMemory( pStream, sizeof( SDKMESH_QUANTIZED_STREAM ) );
+
+    // Lay the packed elements out in Decl order
+    SDKMESH_QUANTIZE_OP Ops[MAX_VERTEX_ELEMENTS];
+    UINT NumElements = 0;
+    UINT Offset = 0;
+    bool bPacked = false;
+    for( ; NumElements < MAX_VERTEX_ELEMENTS - 1 && pDecl[NumElements].Stream != 0xff; NumElements++ )
+    {
+        const D3DVERTEXELEMENT9* pElement = &pDecl[NumElements];
+        UINT SourceSize = GetDeclTypeSize( pElement->Type );
+        if( SourceSize == 0 || pElement->Offset + SourceSize > Stride )
+            return E_INVALIDARG;
+
+        SDKMESH_QUANTIZE_OP Op = GetQuantizeOp( pElement );
+        D3DVERTEXELEMENT9* pPacked = &pStream->Decl[NumElements];
+        *pPacked = *pElement;
+        pPacked->Offset = ( WORD )Offset;
+        switch( Op )
+        {
+            case QUANTIZE_POSITION:
+            case QUANTIZE_TANGENT_FRAME:
+                pPacked->Type = D3DDECLTYPE_SHORT4N;
+                break;
+            case QUANTIZE_DIRECTION:
+                pPacked->Type = D3DDECLTYPE_SHORT2N;
+                break;
+            case QUANTIZE_TEXCOORD:
+                pPacked->Type = D3DDECLTYPE_FLOAT16_2;
+                break;
+            default:
+                break;
+        }
+        bPacked |= ( Op != QUANTIZE_COPY );
+        Ops[NumElements] = Op;
+        Offset += GetDeclTypeSize( pPacked->Type );
+    }
+    if( !bPacked )
+        return S_FALSE;
+
+    D3DVERTEXELEMENT9 End = D3DDECL_END();
+    pStream->Decl[NumElements] = End;
+    pStream->StrideBytes = Offset;
+    pStream->SizeBytes = NumVertices * Offset;
+
+    for( UINT i = 0; i < NumElements; i++ )
+    {
+        D3D11_INPUT_ELEMENT_DESC* pLayout = &pStream->Layout[i];
+        pLayout->SemanticName = GetDeclUsageSemantic( pStream->Decl[i].Usage );
+        pLayout->SemanticIndex = pStream->Decl[i].UsageIndex;
+        pLayout->Format = SDKMeshGetDeclTypeFormat( pStream->Decl[i].Type );
+        pLayout->InputSlot = pStream->Decl[i].Stream;
+        pLayout->AlignedByteOffset = pStream->Decl[i].Offset;
+        pLayout->InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+        pLayout->InstanceDataStepRate = 0;
+    }
+    pStream->NumLayoutElements = NumElements;
+
+    // Positions are normalized to the bounds of every position element of the stream
+    D3DXVECTOR3 vMin( FLT_MAX, FLT_MAX, FLT_MAX ), vMax( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+    for( UINT i = 0; i < NumElements; i++ )
+    {
+        if( Ops[i] != QUANTIZE_POSITION )
+            continue;
+        for( UINT64 v = 0; v < NumVertices; v++ )
+        {
+            const float* p = ( const float* )( pVertices + v * Stride + pDecl[i].Offset );
+            vMin.x = min( vMin.x, p[0] ); vMax.x = max( vMax.x, p[0] );
+            vMin.y = min( vMin.y, p[1] ); vMax.y = max( vMax.y, p[1] );
+            vMin.z = min( vMin.z, p[2] ); vMax.z = max( vMax.z, p[2] );
+        }
+    }
+    if( vMin.x > vMax.x )
+        vMin = vMax = D3DXVECTOR3( 0, 0, 0 );
+    pStream->PositionBias = D3DXVECTOR3( ( vMin.x + vMax.x ) * 0.5f, ( vMin.y + vMax.y ) * 0.5f,
+                                         ( vMin.z + vMax.z ) * 0.5f );
+    pStream->PositionScale = D3DXVECTOR3( ( vMax.x - vMin.x ) * 0.5f, ( vMax.y - vMin.y ) * 0.5f,
+                                          ( vMax.z - vMin.z ) * 0.5f );
+    const float* pBias = &pStream->PositionBias.x;
+    const float* pScale = &pStream->PositionScale.x;
+
+    pStream->pVertices = new BYTE[ ( SIZE_T )pStream->SizeBytes ];
+    if( !pStream->pVertices )
+        return E_OUTOFMEMORY;
+
+    for( UINT64 v = 0; v < NumVertices; v++ )
+    {
+        const BYTE* pSource = pVertices + v * Stride;
+        BYTE* pDest = pStream->pVertices + v * pStream->StrideBytes;
+        for( UINT i = 0; i < NumElements; i++ )
+        {
+            const float* pIn = ( const float* )( pSource + pDecl[i].Offset );
+            SHORT* pOut = ( SHORT* )( pDest + pStream->Decl[i].Offset );
+            switch( Ops[i] )
+            {
+                case QUANTIZE_POSITION:
+                {
+                    float Error = 0.0f;
+                    for( UINT c = 0; c < 3; c++ )
+                    {
+                        pOut[c] = ( pScale[c] > 0.0f ) ? PackSnorm16( ( pIn[c] - pBias[c] ) / pScale[c] ) : 0;
+                        float Delta = pBias[c] + pScale[c] * UnpackSnorm16( pOut[c] ) - pIn[c];
+                        Error += Delta * Delta;
+                    }
+                    pOut[3] = ( SHORT )QUANTIZE_SNORM16_MAX;
+                    pStream->MaxPositionError = max( pStream->MaxPositionError, sqrtf( Error ) );
+                    break;
+                }
+                case QUANTIZE_DIRECTION:
+                case QUANTIZE_TANGENT_FRAME:
+                {
+                    float Decoded[3];
+                    EncodeOctahedral( pIn, pOut );
+                    DecodeOctahedral( pOut, Decoded );
+                    pStream->MaxNormalError = max( pStream->MaxNormalError, GetDirectionError( pIn, Decoded ) );
+                    if( Ops[i] == QUANTIZE_TANGENT_FRAME )
+                    {
+                        pOut[2] = ( SHORT )( ( pIn[3] < 0.0f ) ? -QUANTIZE_SNORM16_MAX : QUANTIZE_SNORM16_MAX );
+                        pOut[3] = 0;
+                    }
+                    break;
+                }
+                case QUANTIZE_TEXCOORD:
+                {
+                    float Decoded[2];
+                    D3DXFloat32To16Array( ( D3DXFLOAT16* )pOut, pIn, 2 );
+                    D3DXFloat16To32Array( Decoded, ( const D3DXFLOAT16* )pOut, 2 );
+                    pStream->MaxTexCoordError = max( pStream->MaxTexCoordError,
+                                                     max( fabsf( Decoded[0] - pIn[0] ), fabsf( Decoded[1] - pIn[1] ) ) );
+                    break;
+                }
+                default:
+                    CopyMemory( pOut, pIn, GetDeclTypeSize( pDecl[i].Type ) );
+                    break;
+            }
+        }
+    }
+
+    return S_OK;
+}
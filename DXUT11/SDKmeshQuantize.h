@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshQuantize.h
+//
+// Vertex stream quantization for .sdkmesh vertex buffers, used by CDXUTSDKMesh when
+// quantization on load is turned on
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHQUANTIZE_H
+#define SDKMESHQUANTIZE_H
+
+//--------------------------------------------------------------------------------------
+// A vertex stream repacked for the GPU, element by element according to its Decl:
+//
+//  POSITION  FLOAT3            -> SHORT4N, ( x, y, z ) normalized to the stream's bounds
+//                                 and w = 1. PositionBias + PositionScale * xyz decodes it.
+//  NORMAL, TANGENT, BINORMAL
+//            FLOAT3            -> SHORT2N octahedral encoding
+//  TANGENT   FLOAT4            -> SHORT4N, octahedral xy, handedness in z
+//  TEXCOORD  FLOAT2            -> FLOAT16_2
+//
+// Everything else is copied as it is. Decl and Layout describe the packed vertices for
+// D3D9 and D3D11; Layout's InputSlot is the Decl's Stream, which for an sdkmesh vertex
+// buffer is the buffer's index in its mesh once the caller sets it. The errors are the
+// largest found decoding every packed vertex again.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_QUANTIZED_STREAM
+{
+    D3DVERTEXELEMENT9 Decl[MAX_VERTEX_ELEMENTS];
+    D3D11_INPUT_ELEMENT_DESC Layout[MAX_VERTEX_ELEMENTS];
+    UINT NumLayoutElements;
+    UINT StrideBytes;
+    UINT64 SizeBytes;
+    D3DXVECTOR3 PositionScale;
+    D3DXVECTOR3 PositionBias;
+    float MaxPositionError;     // model units
+    float MaxNormalError;       // radians, over normals, tangents and binormals
+    float MaxTexCoordError;
+    BYTE* pVertices;            // the packed vertices until the buffer is created
+};
+
+struct SDKMESH_QUANTIZATION_STATS
+{
+    UINT NumStreams;            // vertex buffers that were repacked
+    UINT64 NumVertices;
+    UINT64 BytesBefore;
+    UINT64 BytesAfter;
+    float MaxPositionError;
+    float MaxNormalError;
+    float MaxTexCoordError;
+};
+
+// Fills pStream for NumVertices vertices of Stride bytes laid out as pDecl. Returns
+// S_FALSE, with nothing allocated, when no element of the stream can be packed.
+HRESULT SDKMeshQuantizeStream( __in_ecount( MAX_VERTEX_ELEMENTS ) const D3DVERTEXELEMENT9* pDecl, UINT Stride,
+                               UINT64 NumVertices, __in const BYTE* pVertices,
+                               __out SDKMESH_QUANTIZED_STREAM* pStream );
+
+// The DXGI format matching a D3DDECLTYPE, or DXGI_FORMAT_UNKNOWN (DEC3N has none)
+DXGI_FORMAT SDKMeshGetDeclTypeFormat( BYTE Type );
+
+#endif // SDKMESHQUANTIZE_H
@@ -0,0 +1,149 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshResidency.cpp
+//
+// Residency of lazily created .sdkmesh buffers
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshCreateResidency( UINT NumMeshes, UINT NumVertexBuffers, UINT NumIndexBuffers,
+                                LPSDKMESHCREATELAZYBUFFER pfnCreateBuffer,
+                                LPSDKMESHRELEASELAZYBUFFER pfnReleaseBuffer, void* pContext,
+                                SDKMESH_RESIDENCY* pResidency )
+{
+    if( !pResidency || !pfnCreateBuffer || !pfnReleaseBuffer )
+        return E_INVALIDARG;
+    ZeroMemory( pResidency, sizeof( SDKMESH_RESIDENCY ) );
+
+    pResidency->pMeshResident = new bool[ max( NumMeshes, 1 ) ];
+    pResidency->pVertexBufferRefs = new UINT[ max( NumVertexBuffers, 1 ) ];
+    pResidency->pIndexBufferRefs = new UINT[ max( NumIndexBuffers, 1 ) ];
+    pResidency->pVertexBufferBytes = new UINT64[ max( NumVertexBuffers, 1 ) ];
+    pResidency->pIndexBufferBytes = new UINT64[ max( NumIndexBuffers, 1 ) ];
+    if( !pResidency->pMeshResident || !pResidency->pVertexBufferRefs || !pResidency->pIndexBufferRefs ||
+        !pResidency->pVertexBufferBytes || !pResidency->pIndexBufferBytes )
+    {
+        SDKMeshDestroyResidency( pResidency );
+        return E_OUTOFMEMORY;
+    }
+    ZeroMemory( pResidency->pMeshResident, sizeof( bool ) * NumMeshes );
+    ZeroMemory( pResidency->pVertexBufferRefs, sizeof( UINT ) * NumVertexBuffers );
+    ZeroMemory( pResidency->pIndexBufferRefs, sizeof( UINT ) * NumIndexBuffers );
+    ZeroMemory( pResidency->pVertexBufferBytes, sizeof( UINT64 ) * NumVertexBuffers );
+    ZeroMemory( pResidency->pIndexBufferBytes, sizeof( UINT64 ) * NumIndexBuffers );
+
+    pResidency->NumMeshes = NumMeshes;
+    pResidency->NumVertexBuffers = NumVertexBuffers;
+    pResidency->NumIndexBuffers = NumIndexBuffers;
+    pResidency->pfnCreateBuffer = pfnCreateBuffer;
+    pResidency->pfnReleaseBuffer = pfnReleaseBuffer;
+    pResidency->pContext = pContext;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshDestroyResidency( SDKMESH_RESIDENCY* pResidency )
+{
+    if( !pResidency )
+        return;
+
+    SAFE_DELETE_ARRAY( pResidency->pMeshResident );
+    SAFE_DELETE_ARRAY( pResidency->pVertexBufferRefs );
+    SAFE_DELETE_ARRAY( pResidency->pIndexBufferRefs );
+    SAFE_DELETE_ARRAY( pResidency->pVertexBufferBytes );
+    SAFE_DELETE_ARRAY( pResidency->pIndexBufferBytes );
+    ZeroMemory( pResidency, sizeof( SDKMESH_RESIDENCY ) );
+}
+
+//--------------------------------------------------------------------------------------
+// One more user of a buffer, which is created for the first
+//--------------------------------------------------------------------------------------
+static HRESULT AcquireBuffer( SDKMESH_RESIDENCY* pResidency, bool bVertices, UINT iBuffer )
+{
+    UINT* pRefs = bVertices ? &pResidency->pVertexBufferRefs[iBuffer] : &pResidency->pIndexBufferRefs[iBuffer];
+    UINT64* pBytes = bVertices ? &pResidency->pVertexBufferBytes[iBuffer] : &pResidency->pIndexBufferBytes[iBuffer];
+    if( *pRefs == 0 )
+    {
+        HRESULT hr = pResidency->pfnCreateBuffer( bVertices, iBuffer, pResidency->pContext, pBytes );
+        if( FAILED( hr ) )
+            return hr;
+
+        pResidency->Stats.NumResidentBuffers++;
+        pResidency->Stats.ResidentBytes += *pBytes;
+    }
+    ( *pRefs )++;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static void ReleaseBuffer( SDKMESH_RESIDENCY* pResidency, bool bVertices, UINT iBuffer )
+{
+    UINT* pRefs = bVertices ? &pResidency->pVertexBufferRefs[iBuffer] : &pResidency->pIndexBufferRefs[iBuffer];
+    UINT64* pBytes = bVertices ? &pResidency->pVertexBufferBytes[iBuffer] : &pResidency->pIndexBufferBytes[iBuffer];
+    if( --( *pRefs ) > 0 )
+        return;
+
+    pResidency->pfnReleaseBuffer( bVertices, iBuffer, pResidency->pContext );
+    pResidency->Stats.NumResidentBuffers--;
+    pResidency->Stats.ResidentBytes -= *pBytes;
+    *pBytes = 0;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshAcquireMesh( SDKMESH_RESIDENCY* pResidency, UINT iMesh, const UINT* pVertexBuffers,
+                            UINT NumVertexBuffers, UINT iIndexBuffer )
+{
+    if( !pResidency || !pResidency->pMeshResident || iMesh >= pResidency->NumMeshes ||
+        iIndexBuffer >= pResidency->NumIndexBuffers )
+        return E_INVALIDARG;
+    for( UINT i = 0; i < NumVertexBuffers; i++ )
+    {
+        if( pVertexBuffers[i] >= pResidency->NumVertexBuffers )
+            return E_INVALIDARG;
+    }
+    if( pResidency->pMeshResident[iMesh] )
+        return S_OK;
+
+    HRESULT hr = S_OK;
+    UINT NumAcquired = 0;
+    while( NumAcquired < NumVertexBuffers && SUCCEEDED( hr ) )
+    {
+        hr = AcquireBuffer( pResidency, true, pVertexBuffers[NumAcquired] );
+        if( SUCCEEDED( hr ) )
+            NumAcquired++;
+    }
+    if( SUCCEEDED( hr ) )
+        hr = AcquireBuffer( pResidency, false, iIndexBuffer );
+
+    if( FAILED( hr ) )
+    {
+        while( NumAcquired > 0 )
+            ReleaseBuffer( pResidency, true, pVertexBuffers[--NumAcquired] );
+        return hr;
+    }
+
+    pResidency->pMeshResident[iMesh] = true;
+    pResidency->Stats.NumResidentMeshes++;
+    pResidency->Stats.NumUploads++;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshReleaseMesh( SDKMESH_RESIDENCY* pResidency, UINT iMesh, const UINT* pVertexBuffers,
+                         UINT NumVertexBuffers, UINT iIndexBuffer )
+{
+    if( !pResidency || !pResidency->pMeshResident || iMesh >= pResidency->NumMeshes ||
+        !pResidency->pMeshResident[iMesh] )
+        return;
+
+    for( UINT i = 0; i < NumVertexBuffers; i++ )
+        ReleaseBuffer( pResidency, true, pVertexBuffers[i] );
+    ReleaseBuffer( pResidency, false, iIndexBuffer );
+
+    pResidency->pMeshResident[iMesh] = false;
+    pResidency->Stats.NumResidentMeshes--;
+    pResidency->Stats.NumEvictions++;
+}
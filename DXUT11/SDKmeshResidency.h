@@ -0,0 +1,69 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshResidency.h
+//
+// Residency of the vertex and index buffers CDXUTSDKMesh creates lazily (see
+// SetLazyBuffersOnLoad). Meshes can share buffers, so each buffer counts the resident
+// meshes that use it: it's created when its count leaves zero and released when it
+// gets back there. The device work is left to two callbacks, so the bookkeeping can be
+// driven and checked without a device.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHRESIDENCY_H
+#define SDKMESHRESIDENCY_H
+
+//--------------------------------------------------------------------------------------
+// What CDXUTSDKMesh's lazily created buffers add up to, see SetLazyBuffersOnLoad
+//--------------------------------------------------------------------------------------
+struct SDKMESH_STREAMING_STATS
+{
+    UINT NumResidentMeshes;
+    UINT NumResidentBuffers;    // vertex and index buffers on the device
+    UINT64 ResidentBytes;       // their size
+    UINT NumUploads;            // meshes made resident since the load
+    UINT NumEvictions;
+};
+
+// Creates vertex buffer iBuffer, or index buffer iBuffer, and returns its size
+typedef HRESULT ( CALLBACK*LPSDKMESHCREATELAZYBUFFER )( bool bVertices, UINT iBuffer, void* pContext,
+                                                        UINT64* pSizeBytes );
+typedef void ( CALLBACK*LPSDKMESHRELEASELAZYBUFFER )( bool bVertices, UINT iBuffer, void* pContext );
+
+struct SDKMESH_RESIDENCY
+{
+    UINT NumMeshes;
+    UINT NumVertexBuffers;
+    UINT NumIndexBuffers;
+    bool* pMeshResident;
+    UINT* pVertexBufferRefs;        // resident meshes using each buffer
+    UINT* pIndexBufferRefs;
+    UINT64* pVertexBufferBytes;     // as the create callback returned them
+    UINT64* pIndexBufferBytes;
+    LPSDKMESHCREATELAZYBUFFER pfnCreateBuffer;
+    LPSDKMESHRELEASELAZYBUFFER pfnReleaseBuffer;
+    void* pContext;
+    SDKMESH_STREAMING_STATS Stats;
+};
+
+// Starts with nothing resident. Destroying doesn't release the buffers.
+HRESULT SDKMeshCreateResidency( UINT NumMeshes, UINT NumVertexBuffers, UINT NumIndexBuffers,
+                                LPSDKMESHCREATELAZYBUFFER pfnCreateBuffer,
+                                LPSDKMESHRELEASELAZYBUFFER pfnReleaseBuffer, void* pContext,
+                                __out SDKMESH_RESIDENCY* pResidency );
+void SDKMeshDestroyResidency( __inout SDKMESH_RESIDENCY* pResidency );
+
+// Makes mesh iMesh, which uses the listed buffers, resident, creating the buffers no
+// other resident mesh uses. When one can't be created those just created are released
+// again and the mesh stays as it was. Does nothing for a resident mesh.
+HRESULT SDKMeshAcquireMesh( __inout SDKMESH_RESIDENCY* pResidency, UINT iMesh,
+                            __in_ecount( NumVertexBuffers ) const UINT* pVertexBuffers, UINT NumVertexBuffers,
+                            UINT iIndexBuffer );
+
+// Undoes SDKMeshAcquireMesh, releasing the buffers no other resident mesh uses. Does
+// nothing for a mesh that isn't resident.
+void SDKMeshReleaseMesh( __inout SDKMESH_RESIDENCY* pResidency, UINT iMesh,
+                         __in_ecount( NumVertexBuffers ) const UINT* pVertexBuffers, UINT NumVertexBuffers,
+                         UINT iIndexBuffer );
+
+#endif // SDKMESHRESIDENCY_H
@@ -0,0 +1,548 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshSimplify.cpp
+//
+// Quadric error mesh simplification for .sdkmesh triangle lists
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKmeshSimplify.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Open border edges also get a quadric for the plane through the edge perpendicular
+// to its triangle, weighted by this times the edge's squared length
+#define SIMPLIFY_BORDER_WEIGHT 10.0
+
+// Cosine of the largest turn a collapse may give a triangle, squared (0.25^2)
+#define SIMPLIFY_MIN_TURN_COSINE_SQ 0.0625
+
+#define SIMPLIFY_NONE 0xffffffff
+
+//--------------------------------------------------------------------------------------
+// A sum of squared distances to planes, weighted by triangle area. Weight is the total
+// area, so dividing by it gives a mean squared distance.
+//--------------------------------------------------------------------------------------
+struct SIMPLIFY_QUADRIC
+{
+    double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+    double Weight;
+};
+
+static void AddPlaneQuadric( SIMPLIFY_QUADRIC* pQ, double a, double b, double c, double d, double w )
+{
+    pQ->a2 += a * a * w;
+    pQ->b2 += b * b * w;
+    pQ->c2 += c * c * w;
+    pQ->ab += a * b * w;
+    pQ->ac += a * c * w;
+    pQ->bc += b * c * w;
+    pQ->ad += a * d * w;
+    pQ->bd += b * d * w;
+    pQ->cd += c * d * w;
+    pQ->d2 += d * d * w;
+}
+
+static void AddQuadric( SIMPLIFY_QUADRIC* pQ, const SIMPLIFY_QUADRIC* pR )
+{
+    pQ->a2 += pR->a2;
+    pQ->b2 += pR->b2;
+    pQ->c2 += pR->c2;
+    pQ->ab += pR->ab;
+    pQ->ac += pR->ac;
+    pQ->bc += pR->bc;
+    pQ->ad += pR->ad;
+    pQ->bd += pR->bd;
+    pQ->cd += pR->cd;
+    pQ->d2 += pR->d2;
+    pQ->Weight += pR->Weight;
+}
+
+static double EvaluateQuadric( const SIMPLIFY_QUADRIC* pQ, const float* p )
+{
+    double x = p[0], y = p[1], z = p[2];
+    double e = pQ->a2 * x * x + pQ->b2 * y * y + pQ->c2 * z * z +
+        2.0 * ( pQ->ab * x * y + pQ->ac * x * z + pQ->bc * y * z + pQ->ad * x + pQ->bd * y + pQ->cd * z ) + pQ->d2;
+    return max( e, 0.0 ) / max( pQ->Weight, 1e-20 );
+}
+
+static inline void Cross( double* pOut, const float* a, const float* b, const float* c )
+{
+    double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    pOut[0] = u[1] * v[2] - u[2] * v[1];
+    pOut[1] = u[2] * v[0] - u[0] * v[2];
+    pOut[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+//--------------------------------------------------------------------------------------
+enum SIMPLIFY_VERTEX_KIND
+{
+    SIMPLIFY_MANIFOLD = 0,  // moves anywhere
+    SIMPLIFY_BORDER,        // moves along its open border
+    SIMPLIFY_LOCKED
+};
+
+struct SIMPLIFY_COLLAPSE
+{
+    float Cost;
+    UINT From;
+    UINT To;
+};
+
+static int __cdecl CompareCollapses( const void* pA, const void* pB )
+{
+    float a = ( ( const SIMPLIFY_COLLAPSE* )pA )->Cost;
+    float b = ( ( const SIMPLIFY_COLLAPSE* )pB )->Cost;
+    return ( a < b ) ? -1 : ( ( a > b ) ? 1 : 0 );
+}
+
+struct SIMPLIFY_STATE
+{
+    const SDKMESH_SIMPLIFY_SOURCE* pSource;
+    UINT NumVertices;
+    float NormalWeightSq;
+    float TexCoordWeightSq;
+
+    float* pPositions;              // three floats per vertex
+    UINT* pGroup;                   // first vertex with the same position
+    UINT* pWedges;                  // referenced vertices at each group's position
+    BYTE* pKind;
+    UINT* pBorderOut;               // group across the open edge leaving a border vertex
+    UINT* pBorderIn;                // group across the open edge reaching it
+    SIMPLIFY_QUADRIC* pQuadrics;
+    UINT* pFirstTriangle;           // vertex to triangle adjacency
+    UINT* pTriangles;
+    UINT* pRemap;
+    bool* pTouched;
+    SIMPLIFY_COLLAPSE* pCollapses;
+};
+
+//--------------------------------------------------------------------------------------
+// Vertices at the same position are found with an open addressed hash of the bits
+//--------------------------------------------------------------------------------------
+static HRESULT GroupPositions( SIMPLIFY_STATE* pState )
+{
+    UINT NumVertices = pState->NumVertices;
+    UINT TableSize = 1;
+    while( TableSize < NumVertices * 2 )
+        TableSize *= 2;
+
+    UINT* pTable = new UINT[TableSize];
+    if( !pTable )
+        return E_OUTOFMEMORY;
+    memset( pTable, 0xff, sizeof( UINT ) * TableSize );
+
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        const UINT* pBits = ( const UINT* )&pState->pPositions[v * 3];
+        UINT Hash = ( pBits[0] * 73856093 ) ^ ( pBits[1] * 19349663 ) ^ ( pBits[2] * 83492791 );
+        for( UINT Slot = Hash & ( TableSize - 1 );; Slot = ( Slot + 1 ) & ( TableSize - 1 ) )
+        {
+            UINT Other = pTable[Slot];
+            if( Other == SIMPLIFY_NONE )
+            {
+                pTable[Slot] = v;
+                pState->pGroup[v] = v;
+                break;
+            }
+            if( memcmp( &pState->pPositions[Other * 3], pBits, sizeof( float ) * 3 ) == 0 )
+            {
+                pState->pGroup[v] = Other;
+                break;
+            }
+        }
+    }
+
+    delete []pTable;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static void BuildAdjacency( SIMPLIFY_STATE* pState, const UINT* pIndices, UINT NumIndices )
+{
+    UINT* pFirst = pState->pFirstTriangle;
+    ZeroMemory( pFirst, sizeof( UINT ) * ( pState->NumVertices + 1 ) );
+    for( UINT i = 0; i < NumIndices; i++ )
+        pFirst[pIndices[i]]++;
+
+    UINT Start = 0;
+    for( UINT v = 0; v < pState->NumVertices; v++ )
+    {
+        UINT Count = pFirst[v];
+        pFirst[v] = Start;
+        Start += Count;
+    }
+
+    // Filling moves each start up to the next vertex's, so shift them back afterwards
+    for( UINT i = 0; i < NumIndices; i++ )
+        pState->pTriangles[pFirst[pIndices[i]]++] = i / 3;
+    for( UINT v = pState->NumVertices; v > 0; v-- )
+        pFirst[v] = pFirst[v - 1];
+    pFirst[0] = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Finds the open edges around each movable vertex and sorts vertices into kinds. On
+// the first pass the open edges also add their border planes to the quadrics.
+//--------------------------------------------------------------------------------------
+static void ClassifyVertices( SIMPLIFY_STATE* pState, const UINT* pIndices, UINT NumIndices, bool bAddBorders )
+{
+    const UINT* pGroup = pState->pGroup;
+    const float* pPositions = pState->pPositions;
+    UINT NumVertices = pState->NumVertices;
+
+    ZeroMemory( pState->pWedges, sizeof( UINT ) * NumVertices );
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        if( pState->pFirstTriangle[v + 1] > pState->pFirstTriangle[v] )
+            pState->pWedges[pGroup[v]]++;
+    }
+
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        pState->pBorderOut[v] = SIMPLIFY_NONE;
+        pState->pBorderIn[v] = SIMPLIFY_NONE;
+        if( pState->pWedges[pGroup[v]] != 1 || ( pState->pSource->pLocked && pState->pSource->pLocked[v] ) )
+        {
+            pState->pKind[v] = SIMPLIFY_LOCKED;
+            continue;
+        }
+
+        // A vertex alone at its position is in every triangle touching that position,
+        // so its own triangles are enough to tell whether an edge has a twin
+        UINT NumOpenOut = 0, NumOpenIn = 0;
+        UINT First = pState->pFirstTriangle[v], End = pState->pFirstTriangle[v + 1];
+        for( UINT i = First; i < End; i++ )
+        {
+            const UINT* pTri = &pIndices[pState->pTriangles[i] * 3];
+            UINT k = ( pTri[0] == v ) ? 0 : ( ( pTri[1] == v ) ? 1 : 2 );
+            UINT Next = pTri[( k + 1 ) % 3], Prev = pTri[( k + 2 ) % 3];
+
+            bool bOutTwin = false, bInTwin = false;
+            for( UINT j = First; j < End; j++ )
+            {
+                const UINT* pOther = &pIndices[pState->pTriangles[j] * 3];
+                UINT k2 = ( pOther[0] == v ) ? 0 : ( ( pOther[1] == v ) ? 1 : 2 );
+                bOutTwin |= ( pGroup[pOther[( k2 + 2 ) % 3]] == pGroup[Next] );
+                bInTwin |= ( pGroup[pOther[( k2 + 1 ) % 3]] == pGroup[Prev] );
+            }
+
+            if( !bOutTwin )
+            {
+                NumOpenOut++;
+                pState->pBorderOut[v] = pGroup[Next];
+            }
+            if( !bInTwin )
+            {
+                NumOpenIn++;
+                pState->pBorderIn[v] = pGroup[Prev];
+            }
+
+            if( bAddBorders && !bOutTwin )
+            {
+                double Normal[3], Edge[3], Plane[3];
+                Cross( Normal, &pPositions[pTri[0] * 3], &pPositions[pTri[1] * 3], &pPositions[pTri[2] * 3] );
+                for( UINT c = 0; c < 3; c++ )
+                    Edge[c] = pPositions[Next * 3 + c] - pPositions[v * 3 + c];
+                Plane[0] = Edge[1] * Normal[2] - Edge[2] * Normal[1];
+                Plane[1] = Edge[2] * Normal[0] - Edge[0] * Normal[2];
+                Plane[2] = Edge[0] * Normal[1] - Edge[1] * Normal[0];
+                double Length = sqrt( Plane[0] * Plane[0] + Plane[1] * Plane[1] + Plane[2] * Plane[2] );
+                if( Length > 0.0 )
+                {
+                    double a = Plane[0] / Length, b = Plane[1] / Length, c = Plane[2] / Length;
+                    double d = -( a * pPositions[v * 3] + b * pPositions[v * 3 + 1] + c * pPositions[v * 3 + 2] );
+                    double w = SIMPLIFY_BORDER_WEIGHT * ( Edge[0] * Edge[0] + Edge[1] * Edge[1] + Edge[2] * Edge[2] );
+                    AddPlaneQuadric( &pState->pQuadrics[v], a, b, c, d, w );
+                    AddPlaneQuadric( &pState->pQuadrics[Next], a, b, c, d, w );
+                }
+            }
+        }
+
+        if( NumOpenOut == 0 && NumOpenIn == 0 )
+            pState->pKind[v] = SIMPLIFY_MANIFOLD;
+        else if( NumOpenOut == 1 && NumOpenIn == 1 )
+            pState->pKind[v] = SIMPLIFY_BORDER;
+        else
+            pState->pKind[v] = SIMPLIFY_LOCKED;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+static float GetCollapseCost( const SIMPLIFY_STATE* pState, UINT From, UINT To )
+{
+    const SDKMESH_SIMPLIFY_SOURCE* pSource = pState->pSource;
+    double Cost = EvaluateQuadric( &pState->pQuadrics[From], &pState->pPositions[To * 3] );
+
+    if( pSource->pNormals && pState->NormalWeightSq > 0.0f )
+    {
+        const float* n0 = ( const float* )( pSource->pNormals + ( SIZE_T )From * pSource->NormalStride );
+        const float* n1 = ( const float* )( pSource->pNormals + ( SIZE_T )To * pSource->NormalStride );
+        float dx = n0[0] - n1[0], dy = n0[1] - n1[1], dz = n0[2] - n1[2];
+        Cost += pState->NormalWeightSq * ( dx * dx + dy * dy + dz * dz );
+    }
+    if( pSource->pTexCoords && pState->TexCoordWeightSq > 0.0f )
+    {
+        const float* t0 = ( const float* )( pSource->pTexCoords + ( SIZE_T )From * pSource->TexCoordStride );
+        const float* t1 = ( const float* )( pSource->pTexCoords + ( SIZE_T )To * pSource->TexCoordStride );
+        float du = t0[0] - t1[0], dv = t0[1] - t1[1];
+        Cost += pState->TexCoordWeightSq * ( du * du + dv * dv );
+    }
+
+    return ( float )Cost;
+}
+
+static bool CanCollapse( const SIMPLIFY_STATE* pState, UINT From, UINT To )
+{
+    if( pState->pGroup[From] == pState->pGroup[To] )
+        return false;
+
+    switch( pState->pKind[From] )
+    {
+        case SIMPLIFY_MANIFOLD:
+            return true;
+        case SIMPLIFY_BORDER:
+            return pState->pGroup[To] == pState->pBorderOut[From] || pState->pGroup[To] == pState->pBorderIn[From];
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------
+// Moving From onto To must not turn any remaining triangle around From over
+//--------------------------------------------------------------------------------------
+static bool CollapseKeepsWinding( const SIMPLIFY_STATE* pState, const UINT* pIndices, UINT From, UINT To )
+{
+    const float* pPositions = pState->pPositions;
+    for( UINT i = pState->pFirstTriangle[From]; i < pState->pFirstTriangle[From + 1]; i++ )
+    {
+        const UINT* pTri = &pIndices[pState->pTriangles[i] * 3];
+        if( pTri[0] == To || pTri[1] == To || pTri[2] == To )
+            continue;
+
+        const float* p[3];
+        for( UINT k = 0; k < 3; k++ )
+            p[k] = &pPositions[pTri[k] * 3];
+        double Before[3], After[3];
+        Cross( Before, p[0], p[1], p[2] );
+        for( UINT k = 0; k < 3; k++ )
+        {
+            if( pTri[k] == From )
+                p[k] = &pPositions[To * 3];
+        }
+        Cross( After, p[0], p[1], p[2] );
+
+        // Sharper turns than SIMPLIFY_MIN_TURN_COSINE_SQ allows add up to flips over a
+        // few passes
+        double Dot = Before[0] * After[0] + Before[1] * After[1] + Before[2] * After[2];
+        double LengthSq = ( Before[0] * Before[0] + Before[1] * Before[1] + Before[2] * Before[2] ) *
+            ( After[0] * After[0] + After[1] * After[1] + After[2] * After[2] );
+        if( Dot <= 0.0 || Dot * Dot < SIMPLIFY_MIN_TURN_COSINE_SQ * LengthSq )
+            return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+static UINT RemoveDegenerateTriangles( const SIMPLIFY_STATE* pState, UINT* pIndices, UINT NumIndices )
+{
+    const UINT* pGroup = pState->pGroup;
+    UINT NumOut = 0;
+    for( UINT i = 0; i + 3 <= NumIndices; i += 3 )
+    {
+        UINT a = pIndices[i], b = pIndices[i + 1], c = pIndices[i + 2];
+        if( pGroup[a] == pGroup[b] || pGroup[b] == pGroup[c] || pGroup[c] == pGroup[a] )
+            continue;
+        pIndices[NumOut++] = a;
+        pIndices[NumOut++] = b;
+        pIndices[NumOut++] = c;
+    }
+    return NumOut;
+}
+
+//--------------------------------------------------------------------------------------
+// Each pass collapses the cheapest edges whose neighbourhoods don't overlap, so the
+// costs and winding checks it sorted by stay valid, then rebuilds the adjacency.
+//--------------------------------------------------------------------------------------
+static void RunSimplify( SIMPLIFY_STATE* pState, UINT* pIndices, UINT* pNumIndices, UINT TargetIndices,
+                         float MaxCost, float* pMaxCostUsed )
+{
+    UINT NumIndices = RemoveDegenerateTriangles( pState, pIndices, *pNumIndices );
+    const float* pPositions = pState->pPositions;
+
+    ZeroMemory( pState->pQuadrics, sizeof( SIMPLIFY_QUADRIC ) * pState->NumVertices );
+    for( UINT i = 0; i < NumIndices; i += 3 )
+    {
+        double Normal[3];
+        Cross( Normal, &pPositions[pIndices[i] * 3], &pPositions[pIndices[i + 1] * 3],
+               &pPositions[pIndices[i + 2] * 3] );
+        double Length = sqrt( Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2] );
+        if( Length <= 0.0 )
+            continue;
+
+        double a = Normal[0] / Length, b = Normal[1] / Length, c = Normal[2] / Length;
+        const float* p = &pPositions[pIndices[i] * 3];
+        double d = -( a * p[0] + b * p[1] + c * p[2] );
+        double Area = Length * 0.5;
+        for( UINT k = 0; k < 3; k++ )
+        {
+            AddPlaneQuadric( &pState->pQuadrics[pIndices[i + k]], a, b, c, d, Area );
+            pState->pQuadrics[pIndices[i + k]].Weight += Area;
+        }
+    }
+
+    float MaxCostUsed = 0.0f;
+    for( bool bFirstPass = true; NumIndices > TargetIndices; bFirstPass = false )
+    {
+        BuildAdjacency( pState, pIndices, NumIndices );
+        ClassifyVertices( pState, pIndices, NumIndices, bFirstPass );
+
+        UINT NumCollapses = 0;
+        for( UINT i = 0; i < NumIndices; i++ )
+        {
+            UINT a = pIndices[i];
+            UINT b = pIndices[( i % 3 == 2 ) ? i - 2 : i + 1];
+            bool bAB = CanCollapse( pState, a, b );
+            bool bBA = CanCollapse( pState, b, a );
+            if( !bAB && !bBA )
+                continue;
+
+            float CostAB = bAB ? GetCollapseCost( pState, a, b ) : FLT_MAX;
+            float CostBA = bBA ? GetCollapseCost( pState, b, a ) : FLT_MAX;
+            SIMPLIFY_COLLAPSE* pCollapse = &pState->pCollapses[NumCollapses++];
+            pCollapse->Cost = min( CostAB, CostBA );
+            pCollapse->From = ( CostAB <= CostBA ) ? a : b;
+            pCollapse->To = ( CostAB <= CostBA ) ? b : a;
+        }
+        qsort( pState->pCollapses, NumCollapses, sizeof( SIMPLIFY_COLLAPSE ), CompareCollapses );
+
+        for( UINT v = 0; v < pState->NumVertices; v++ )
+        {
+            pState->pRemap[v] = v;
+            pState->pTouched[v] = false;
+        }
+
+        UINT TrianglesToRemove = ( NumIndices - TargetIndices + 2 ) / 3;
+        UINT TrianglesRemoved = 0;
+        UINT NumApplied = 0;
+        for( UINT i = 0; i < NumCollapses && TrianglesRemoved < TrianglesToRemove; i++ )
+        {
+            const SIMPLIFY_COLLAPSE* pCollapse = &pState->pCollapses[i];
+            if( pCollapse->Cost > MaxCost )
+                break;
+
+            UINT From = pCollapse->From, To = pCollapse->To;
+            if( pState->pTouched[From] || pState->pTouched[To] )
+                continue;
+            if( !CollapseKeepsWinding( pState, pIndices, From, To ) )
+                continue;
+
+            pState->pRemap[From] = To;
+            AddQuadric( &pState->pQuadrics[To], &pState->pQuadrics[From] );
+            MaxCostUsed = max( MaxCostUsed, pCollapse->Cost );
+            NumApplied++;
+
+            // Nothing around From may move again this pass
+            for( UINT j = pState->pFirstTriangle[From]; j < pState->pFirstTriangle[From + 1]; j++ )
+            {
+                const UINT* pTri = &pIndices[pState->pTriangles[j] * 3];
+                pState->pTouched[pTri[0]] = true;
+                pState->pTouched[pTri[1]] = true;
+                pState->pTouched[pTri[2]] = true;
+                if( pTri[0] == To || pTri[1] == To || pTri[2] == To )
+                    TrianglesRemoved++;
+            }
+        }
+
+        if( NumApplied == 0 )
+            break;
+
+        for( UINT i = 0; i < NumIndices; i++ )
+            pIndices[i] = pState->pRemap[pIndices[i]];
+        NumIndices = RemoveDegenerateTriangles( pState, pIndices, NumIndices );
+    }
+
+    *pNumIndices = NumIndices;
+    *pMaxCostUsed = MaxCostUsed;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshSimplify( const SDKMESH_SIMPLIFY_SOURCE* pSource, const UINT* pIndices, UINT NumIndices,
+                         UINT TargetIndices, float MaxError, float NormalWeight, float TexCoordWeight,
+                         UINT* pOut, UINT* pNumOut, float* pError )
+{
+    if( !pSource || !pSource->pPositions || !pIndices || !pOut || !pNumOut )
+        return E_INVALIDARG;
+
+    UINT NumVertices = pSource->NumVertices;
+    NumIndices = NumIndices / 3 * 3;
+    for( UINT i = 0; i < NumIndices; i++ )
+    {
+        if( pIndices[i] >= NumVertices )
+            return E_INVALIDARG;
+    }
+
+    if( pOut != pIndices )
+        CopyMemory( pOut, pIndices, sizeof( UINT ) * NumIndices );
+    *pNumOut = NumIndices;
+    if( pError )
+        *pError = 0.0f;
+    if( NumIndices <= TargetIndices )
+        return S_OK;
+
+    SIMPLIFY_STATE State;
+    State.pSource = pSource;
+    State.NumVertices = NumVertices;
+    State.NormalWeightSq = NormalWeight * NormalWeight;
+    State.TexCoordWeightSq = TexCoordWeight * TexCoordWeight;
+    State.pPositions = new float[NumVertices * 3];
+    State.pGroup = new UINT[NumVertices];
+    State.pWedges = new UINT[NumVertices];
+    State.pKind = new BYTE[NumVertices];
+    State.pBorderOut = new UINT[NumVertices];
+    State.pBorderIn = new UINT[NumVertices];
+    State.pQuadrics = new SIMPLIFY_QUADRIC[NumVertices];
+    State.pFirstTriangle = new UINT[NumVertices + 1];
+    State.pTriangles = new UINT[NumIndices];
+    State.pRemap = new UINT[NumVertices];
+    State.pTouched = new bool[NumVertices];
+    State.pCollapses = new SIMPLIFY_COLLAPSE[NumIndices];
+
+    HRESULT hr = E_OUTOFMEMORY;
+    if( State.pPositions && State.pGroup && State.pWedges && State.pKind && State.pBorderOut && State.pBorderIn &&
+        State.pQuadrics && State.pFirstTriangle && State.pTriangles && State.pRemap && State.pTouched &&
+        State.pCollapses )
+    {
+        // Adding zero folds -0 into 0 so the position hash sees them as equal
+        for( UINT v = 0; v < NumVertices; v++ )
+        {
+            const float* p = ( const float* )( pSource->pPositions + ( SIZE_T )v * pSource->PositionStride );
+            State.pPositions[v * 3] = p[0] + 0.0f;
+            State.pPositions[v * 3 + 1] = p[1] + 0.0f;
+            State.pPositions[v * 3 + 2] = p[2] + 0.0f;
+        }
+
+        hr = GroupPositions( &State );
+        if( SUCCEEDED( hr ) )
+        {
+            float MaxCostUsed;
+            RunSimplify( &State, pOut, pNumOut, TargetIndices, MaxError * MaxError, &MaxCostUsed );
+            if( pError )
+                *pError = sqrtf( MaxCostUsed );
+        }
+    }
+
+    SAFE_DELETE_ARRAY( State.pPositions );
+    SAFE_DELETE_ARRAY( State.pGroup );
+    SAFE_DELETE_ARRAY( State.pWedges );
+    SAFE_DELETE_ARRAY( State.pKind );
+    SAFE_DELETE_ARRAY( State.pBorderOut );
+    SAFE_DELETE_ARRAY( State.pBorderIn );
+    SAFE_DELETE_ARRAY( State.pQuadrics );
+    SAFE_DELETE_ARRAY( State.pFirstTriangle );
+    SAFE_DELETE_ARRAY( State.pTriangles );
+    SAFE_DELETE_ARRAY( State.pRemap );
+    SAFE_DELETE_ARRAY( State.pTouched );
+    SAFE_DELETE_ARRAY( State.pCollapses );
+    return hr;
+}
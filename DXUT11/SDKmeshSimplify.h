@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshSimplify.h
+//
+// Quadric error mesh simplification for .sdkmesh triangle lists, used by
+// CDXUTSDKMesh::GenerateLODs
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHSIMPLIFY_H
+#define SDKMESHSIMPLIFY_H
+
+//--------------------------------------------------------------------------------------
+// The vertices a triangle list is simplified against. Positions are required; normals
+// and texture coordinates are optional and only add to the cost of collapsing an edge
+// whose ends differ in them.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_SIMPLIFY_SOURCE
+{
+    const BYTE* pPositions;     // float3
+    UINT PositionStride;
+    const BYTE* pNormals;       // float3, or NULL
+    UINT NormalStride;
+    const BYTE* pTexCoords;     // float2, or NULL
+    UINT TexCoordStride;
+    UINT NumVertices;
+    const bool* pLocked;        // vertices that must stay where they are, or NULL
+};
+
+//--------------------------------------------------------------------------------------
+// Simplifies a triangle list by collapsing edges onto existing vertices, so the result
+// indexes the same vertex buffer, in order of least quadric error (Garland and
+// Heckbert), until at most TargetIndices indices are left or the next collapse would
+// cost more than MaxError. Errors are distances in model units: the quadric error of
+// a collapse plus NormalWeight times the change of normal and TexCoordWeight times the
+// change of texture coordinate.
+//
+// Vertices that share a position with another vertex (attribute seams), that lie on
+// more than one open border, or that pLocked marks never move, and vertices on an open
+// border only move along it, so seams, borders and the outline between subsets drawn
+// from the same vertices are kept exactly. pOut needs room for NumIndices indices and
+// may be pIndices. pError receives the largest error of any collapse made.
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshSimplify( __in const SDKMESH_SIMPLIFY_SOURCE* pSource,
+                         __in_ecount( NumIndices ) const UINT* pIndices, UINT NumIndices, UINT TargetIndices,
+                         float MaxError, float NormalWeight, float TexCoordWeight,
+                         __out_ecount( NumIndices ) UINT* pOut, __out UINT* pNumOut,
+                         __out_opt float* pError );
+
+#endif // SDKMESHSIMPLIFY_H
@@ -0,0 +1,644 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshSkinning.cpp
+//
+// CPU skinning of raw .sdkmesh vertex streams, used by CDXUTSDKMesh::SkinMesh
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKmeshSkinning.h"
+#include <xmmintrin.h>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+// Decoding of the vertex element types skinning accepts
+//--------------------------------------------------------------------------------------
+static bool IsSkinElementType( BYTE Type )
+{
+    switch( Type )
+    {
+        case D3DDECLTYPE_FLOAT1:
+        case D3DDECLTYPE_FLOAT2:
+        case D3DDECLTYPE_FLOAT3:
+        case D3DDECLTYPE_FLOAT4:
+        case D3DDECLTYPE_D3DCOLOR:
+        case D3DDECLTYPE_UBYTE4:
+        case D3DDECLTYPE_UBYTE4N:
+        case D3DDECLTYPE_SHORT2:
+        case D3DDECLTYPE_SHORT4:
+        case D3DDECLTYPE_SHORT2N:
+        case D3DDECLTYPE_SHORT4N:
+        case D3DDECLTYPE_USHORT2N:
+        case D3DDECLTYPE_USHORT4N:
+        case D3DDECLTYPE_UDEC3:
+        case D3DDECLTYPE_DEC3N:
+        case D3DDECLTYPE_FLOAT16_2:
+        case D3DDECLTYPE_FLOAT16_4:
+            return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------
+static UINT GetSkinElementComponents( BYTE Type )
+{
+    switch( Type )
+    {
+        case D3DDECLTYPE_FLOAT1:
+            return 1;
+        case D3DDECLTYPE_FLOAT2:
+        case D3DDECLTYPE_SHORT2:
+        case D3DDECLTYPE_SHORT2N:
+        case D3DDECLTYPE_USHORT2N:
+        case D3DDECLTYPE_FLOAT16_2:
+            return 2;
+        case D3DDECLTYPE_FLOAT3:
+        case D3DDECLTYPE_UDEC3:
+        case D3DDECLTYPE_DEC3N:
+            return 3;
+    }
+    return 4;
+}
+
+//--------------------------------------------------------------------------------------
+// Expands one element to four floats. Missing components default to ( 0, 0, 0, 1 ) as
+// they would in a shader.
+//--------------------------------------------------------------------------------------
+static void DecodeSkinElement( BYTE Type, const BYTE* pData, float* pOut )
+{
+    pOut[0] = pOut[1] = pOut[2] = 0.0f;
+    pOut[3] = 1.0f;
+
+    switch( Type )
+    {
+        case D3DDECLTYPE_FLOAT4:
+            pOut[3] = ( ( const float* )pData )[3];
+        case D3DDECLTYPE_FLOAT3:
+            pOut[2] = ( ( const float* )pData )[2];
+        case D3DDECLTYPE_FLOAT2:
+            pOut[1] = ( ( const float* )pData )[1];
+        case D3DDECLTYPE_FLOAT1:
+            pOut[0] = ( ( const float* )pData )[0];
+            break;
+
+        case D3DDECLTYPE_D3DCOLOR:
+            pOut[0] = pData[2] / 255.0f;
+            pOut[1] = pData[1] / 255.0f;
+            pOut[2] = pData[0] / 255.0f;
+            pOut[3] = pData[3] / 255.0f;
+            break;
+
+        case D3DDECLTYPE_UBYTE4:
+            for( UINT i = 0; i < 4; i++ )
+                pOut[i] = ( float )pData[i];
+            break;
+
+        case D3DDECLTYPE_UBYTE4N:
+            for( UINT i = 0; i < 4; i++ )
+                pOut[i] = pData[i] / 255.0f;
+            break;
+
+        case D3DDECLTYPE_SHORT4:
+            pOut[2] = ( float )( ( const SHORT* )pData )[2];
+            pOut[3] = ( float )( ( const SHORT* )pData )[3];
+        case D3DDECLTYPE_SHORT2:
+            pOut[0] = ( float )( ( const SHORT* )pData )[0];
+            pOut[1] = ( float )( ( const SHORT* )pData )[1];
+            break;
+
+        case D3DDECLTYPE_SHORT4N:
+            pOut[2] = max( -1.0f, ( ( const SHORT* )pData )[2] / 32767.0f );
+            pOut[3] = max( -1.0f, ( ( const SHORT* )pData )[3] / 32767.0f );
+        case D3DDECLTYPE_SHORT2N:
+            pOut[0] = max( -1.0f, ( ( const SHORT* )pData )[0] / 32767.0f );
+            pOut[1] = max( -1.0f, ( ( const SHORT* )pData )[1] / 32767.0f );
+            break;
+
+        case D3DDECLTYPE_USHORT4N:
+            pOut[2] = ( ( const USHORT* )pData )[2] / 65535.0f;
+            pOut[3] = ( ( const USHORT* )pData )[3] / 65535.0f;
+        case D3DDECLTYPE_USHORT2N:
+            pOut[0] = ( ( const USHORT* )pData )[0] / 65535.0f;
+            pOut[1] = ( ( const USHORT* )pData )[1] / 65535.0f;
+            break;
+
+        case D3DDECLTYPE_UDEC3:
+        {
+            DWORD Packed = *( const DWORD* )pData;
+            pOut[0] = ( float )( Packed & 0x3ff );
+            pOut[1] = ( float )( ( Packed >> 10 ) & 0x3ff );
+            pOut[2] = ( float )( ( Packed >> 20 ) & 0x3ff );
+            break;
+        }
+
+        case D3DDECLTYPE_DEC3N:
+        {
+            // Sign extend each 10 bit field
+            DWORD Packed = *( const DWORD* )pData;
+            pOut[0] = max( -1.0f, ( ( INT )( Packed << 22 ) >> 22 ) / 511.0f );
+            pOut[1] = max( -1.0f, ( ( INT )( Packed << 12 ) >> 22 ) / 511.0f );
+            pOut[2] = max( -1.0f, ( ( INT )( Packed << 2 ) >> 22 ) / 511.0f );
+            break;
+        }
+
+        case D3DDECLTYPE_FLOAT16_2:
+            D3DXFloat16To32Array( pOut, ( const D3DXFLOAT16* )pData, 2 );
+            break;
+
+        case D3DDECLTYPE_FLOAT16_4:
+            D3DXFloat16To32Array( pOut, ( const D3DXFLOAT16* )pData, 4 );
+            break;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Blend indices are integers whatever their type. Byte types are read raw rather than
+// normalized, with D3DCOLOR's BGRA order swapped the way D3DCOLORtoUBYTE4 does in a
+// shader. Normalized 16 and 10 bit types can't hold an index and are rejected.
+//--------------------------------------------------------------------------------------
+static bool IsSkinIndexType( BYTE Type )
+{
+    switch( Type )
+    {
+        case D3DDECLTYPE_SHORT2N:
+        case D3DDECLTYPE_SHORT4N:
+        case D3DDECLTYPE_USHORT2N:
+        case D3DDECLTYPE_USHORT4N:
+        case D3DDECLTYPE_DEC3N:
+            return false;
+    }
+    return IsSkinElementType( Type );
+}
+
+//--------------------------------------------------------------------------------------
+static void DecodeSkinIndices( BYTE Type, const BYTE* pData, UINT* pIndices )
+{
+    switch( Type )
+    {
+        case D3DDECLTYPE_D3DCOLOR:
+            pIndices[0] = pData[2];
+            pIndices[1] = pData[1];
+            pIndices[2] = pData[0];
+            pIndices[3] = pData[3];
+            break;
+
+        case D3DDECLTYPE_UBYTE4:
+        case D3DDECLTYPE_UBYTE4N:
+            for( UINT i = 0; i < 4; i++ )
+                pIndices[i] = pData[i];
+            break;
+
+        default:
+        {
+            // Negative values end up out of range and fall back to bone 0
+            float fIndices[4];
+            DecodeSkinElement( Type, pData, fIndices );
+            for( UINT i = 0; i < 4; i++ )
+                pIndices[i] = fIndices[i] >= 0.0f ? ( UINT )( fIndices[i] + 0.5f ) : UINT_MAX;
+            break;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshAddSkinStream( SDKMESH_SKIN_SOURCE* pSource, const D3DVERTEXELEMENT9* pDecl,
+                              const BYTE* pVertices, UINT Stride, UINT NumVertices )
+{
+    if( !pSource || !pDecl || !pVertices )
+        return E_INVALIDARG;
+
+    for( UINT i = 0; i < MAX_FVF_DECL_SIZE && pDecl[i].Stream != 0xff; i++ )
+    {
+        if( pDecl[i].UsageIndex != 0 )
+            continue;
+
+        SDKMESH_SKIN_ATTRIBUTE Attribute;
+        switch( pDecl[i].Usage )
+        {
+            case D3DDECLUSAGE_POSITION:
+                Attribute = SDKMESH_SKIN_POSITION; break;
+            case D3DDECLUSAGE_NORMAL:
+                Attribute = SDKMESH_SKIN_NORMAL; break;
+            case D3DDECLUSAGE_TANGENT:
+                Attribute = SDKMESH_SKIN_TANGENT; break;
+            case D3DDECLUSAGE_BLENDWEIGHT:
+                Attribute = SDKMESH_SKIN_BLENDWEIGHT; break;
+            case D3DDECLUSAGE_BLENDINDICES:
+                Attribute = SDKMESH_SKIN_BLENDINDICES; break;
+            default:
+                continue;
+        }
+
+        if( Attribute == SDKMESH_SKIN_BLENDINDICES ? !IsSkinIndexType( pDecl[i].Type )
+                                                   : !IsSkinElementType( pDecl[i].Type ) )
+            return E_NOTIMPL;
+
+        SDKMESH_SKIN_ELEMENT* pElement = &pSource->Elements[Attribute];
+        pElement->pData = pVertices + pDecl[i].Offset;
+        pElement->Stride = Stride;
+        pElement->Type = pDecl[i].Type;
+    }
+
+    // Streams of one mesh should agree; never read past the shortest
+    pSource->NumVertices = pSource->NumVertices ? min( pSource->NumVertices, NumVertices ) : NumVertices;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Each bone is kept as its four matrix rows. Blending the rows and then multiplying
+// broadcast coordinates by them needs no horizontal adds, so every vertex stays in
+// registers from the weights to the stores.
+//--------------------------------------------------------------------------------------
+#define SDKMESH_SKIN_CHUNK 2048
+
+struct SDKMESH_SKIN_JOB
+{
+    const SDKMESH_SKIN_SOURCE* pSource;
+    const __m128* pPalette;
+    UINT NumBones;
+    D3DXVECTOR3* pPositions;
+    D3DXVECTOR3* pNormals;
+    D3DXVECTOR3* pTangents;
+};
+
+//--------------------------------------------------------------------------------------
+static inline void StoreFloat3( D3DXVECTOR3* pOut, __m128 V )
+{
+    _mm_storel_pi( ( __m64* )pOut, V );
+    _mm_store_ss( &pOut->z, _mm_movehl_ps( V, V ) );
+}
+
+//--------------------------------------------------------------------------------------
+static inline __m128 NormalizeFloat3( __m128 V )
+{
+    __m128 Squared = _mm_mul_ps( V, V );
+    __m128 LengthSq = _mm_add_ss( Squared, _mm_shuffle_ps( Squared, Squared, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+    LengthSq = _mm_add_ss( LengthSq, _mm_movehl_ps( Squared, Squared ) );
+    if( _mm_cvtss_f32( LengthSq ) <= 0.0f )
+        return V;
+    __m128 Length = _mm_sqrt_ss( LengthSq );
+    return _mm_div_ps( V, _mm_shuffle_ps( Length, Length, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
+}
+
+//--------------------------------------------------------------------------------------
+static inline __m128 TransformDirection( const float* pV, const __m128* pRows )
+{
+    __m128 R = _mm_mul_ps( _mm_set1_ps( pV[0] ), pRows[0] );
+    R = _mm_add_ps( R, _mm_mul_ps( _mm_set1_ps( pV[1] ), pRows[1] ) );
+    R = _mm_add_ps( R, _mm_mul_ps( _mm_set1_ps( pV[2] ), pRows[2] ) );
+    return R;
+}
+
+//--------------------------------------------------------------------------------------
+static void SkinRange( const SDKMESH_SKIN_JOB* pJob, UINT iStart, UINT iEnd )
+{
+    const SDKMESH_SKIN_ELEMENT* pElements = pJob->pSource->Elements;
+    const SDKMESH_SKIN_ELEMENT& Weights = pElements[SDKMESH_SKIN_BLENDWEIGHT];
+    const SDKMESH_SKIN_ELEMENT& Indices = pElements[SDKMESH_SKIN_BLENDINDICES];
+    const SDKMESH_SKIN_ELEMENT& Position = pElements[SDKMESH_SKIN_POSITION];
+    const SDKMESH_SKIN_ELEMENT& Normal = pElements[SDKMESH_SKIN_NORMAL];
+    const SDKMESH_SKIN_ELEMENT& Tangent = pElements[SDKMESH_SKIN_TANGENT];
+
+    UINT NumWeights = Weights.pData ? GetSkinElementComponents( Weights.Type ) : 0;
+    bool bBiasedNormal = ( Normal.Type == D3DDECLTYPE_UBYTE4N || Normal.Type == D3DDECLTYPE_D3DCOLOR );
+    bool bBiasedTangent = ( Tangent.Type == D3DDECLTYPE_UBYTE4N || Tangent.Type == D3DDECLTYPE_D3DCOLOR );
+
+    for( UINT v = iStart; v < iEnd; v++ )
+    {
+        float fWeights[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+        UINT Bones[4] = { 0, 0, 0, 0 };
+
+        if( Weights.pData )
+        {
+            DecodeSkinElement( Weights.Type, Weights.pData + ( SIZE_T )v * Weights.Stride, fWeights );
+            if( NumWeights < 4 )
+            {
+                float fLast = 1.0f;
+                for( UINT i = 0; i < NumWeights; i++ )
+                    fLast -= fWeights[i];
+                for( UINT i = NumWeights; i < 4; i++ )
+                    fWeights[i] = 0.0f;
+                fWeights[NumWeights] = fLast;
+            }
+        }
+        if( Indices.pData )
+            DecodeSkinIndices( Indices.Type, Indices.pData + ( SIZE_T )v * Indices.Stride, Bones );
+
+        // Blend the bone rows
+        __m128 Rows[4];
+        Rows[0] = Rows[1] = Rows[2] = Rows[3] = _mm_setzero_ps();
+        for( UINT i = 0; i < 4; i++ )
+        {
+            if( fWeights[i] == 0.0f )
+                continue;
+
+            UINT iBone = Bones[i];
+            if( iBone >= pJob->NumBones )
+                iBone = 0;
+
+            const __m128* pBone = pJob->pPalette + iBone * 4;
+            __m128 W = _mm_set1_ps( fWeights[i] );
+            Rows[0] = _mm_add_ps( Rows[0], _mm_mul_ps( W, pBone[0] ) );
+            Rows[1] = _mm_add_ps( Rows[1], _mm_mul_ps( W, pBone[1] ) );
+            Rows[2] = _mm_add_ps( Rows[2], _mm_mul_ps( W, pBone[2] ) );
+            Rows[3] = _mm_add_ps( Rows[3], _mm_mul_ps( W, pBone[3] ) );
+        }
+
+        float fValue[4];
+        if( pJob->pPositions )
+        {
+            DecodeSkinElement( Position.Type, Position.pData + ( SIZE_T )v * Position.Stride, fValue );
+            StoreFloat3( &pJob->pPositions[v], _mm_add_ps( TransformDirection( fValue, Rows ), Rows[3] ) );
+        }
+        if( pJob->pNormals )
+        {
+            DecodeSkinElement( Normal.Type, Normal.pData + ( SIZE_T )v * Normal.Stride, fValue );
+            if( bBiasedNormal )
+            {
+                for( UINT i = 0; i < 3; i++ )
+                    fValue[i] = fValue[i] * 2.0f - 1.0f;
+            }
+            StoreFloat3( &pJob->pNormals[v], NormalizeFloat3( TransformDirection( fValue, Rows ) ) );
+        }
+        if( pJob->pTangents )
+        {
+            DecodeSkinElement( Tangent.Type, Tangent.pData + ( SIZE_T )v * Tangent.Stride, fValue );
+            if( bBiasedTangent )
+            {
+                for( UINT i = 0; i < 3; i++ )
+                    fValue[i] = fValue[i] * 2.0f - 1.0f;
+            }
+            StoreFloat3( &pJob->pTangents[v], NormalizeFloat3( TransformDirection( fValue, Rows ) ) );
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+static void CALLBACK SkinChunk( UINT iItem, void* pContext )
+{
+    SDKMESH_SKIN_JOB* pJob = ( SDKMESH_SKIN_JOB* )pContext;
+    UINT iStart = iItem * SDKMESH_SKIN_CHUNK;
+    UINT iEnd = min( iStart + SDKMESH_SKIN_CHUNK, pJob->pSource->NumVertices );
+    SkinRange( pJob, iStart, iEnd );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshSkinVertices( const SDKMESH_SKIN_SOURCE* pSource, const D3DXMATRIX* pBones, UINT NumBones,
+                             D3DXVECTOR3* pPositions, D3DXVECTOR3* pNormals, D3DXVECTOR3* pTangents,
+                             bool bMultithreaded )
+{
+    if( !pSource || !pBones || NumBones == 0 )
+        return E_INVALIDARG;
+    if( ( pPositions && !pSource->Elements[SDKMESH_SKIN_POSITION].pData ) ||
+        ( pNormals && !pSource->Elements[SDKMESH_SKIN_NORMAL].pData ) ||
+        ( pTangents && !pSource->Elements[SDKMESH_SKIN_TANGENT].pData ) )
+        return E_INVALIDARG;
+
+    __m128* pPalette = ( __m128* )_aligned_malloc( sizeof( __m128 ) * 4 * NumBones, 16 );
+    if( !pPalette )
+        return E_OUTOFMEMORY;
+
+    for( UINT i = 0; i < NumBones; i++ )
+    {
+        pPalette[i * 4 + 0] = _mm_loadu_ps( &pBones[i]._11 );
+        pPalette[i * 4 + 1] = _mm_loadu_ps( &pBones[i]._21 );
+        pPalette[i * 4 + 2] = _mm_loadu_ps( &pBones[i]._31 );
+        pPalette[i * 4 + 3] = _mm_loadu_ps( &pBones[i]._41 );
+    }
+
+    SDKMESH_SKIN_JOB Job;
+    Job.pSource = pSource;
+    Job.pPalette = pPalette;
+    Job.NumBones = NumBones;
+    Job.pPositions = pPositions;
+    Job.pNormals = pNormals;
+    Job.pTangents = pTangents;
+
+    if( bMultithreaded )
+    {
+        UINT NumChunks = ( pSource->NumVertices + SDKMESH_SKIN_CHUNK - 1 ) / SDKMESH_SKIN_CHUNK;
+        DXUTParallelFor( NumChunks, SkinChunk, &Job );
+    }
+    else
+    {
+        SkinRange( &Job, 0, pSource->NumVertices );
+    }
+
+    _aligned_free( pPalette );
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Benchmark
+//--------------------------------------------------------------------------------------
+struct SDKMESH_SKIN_BENCHMARK_VERTEX
+{
+    float Position[3];
+    float Normal[3];
+    float Tangent[3];
+    BYTE Weights[4];
+    BYTE Indices[4];
+};
+
+//--------------------------------------------------------------------------------------
+// One vertex at a time with the bones blended as whole matrices, the way skinning code
+// is usually written
+//--------------------------------------------------------------------------------------
+static void SkinVerticesScalar( const SDKMESH_SKIN_BENCHMARK_VERTEX* pVertices, UINT NumVertices,
+                                const D3DXMATRIX* pBones, D3DXVECTOR3* pPositions, D3DXVECTOR3* pNormals,
+                                D3DXVECTOR3* pTangents )
+{
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        const SDKMESH_SKIN_BENCHMARK_VERTEX& Vertex = pVertices[v];
+
+        float M[16] = { 0 };
+        for( UINT i = 0; i < 4; i++ )
+        {
+            float fWeight = Vertex.Weights[i] / 255.0f;
+            const float* pBone = &pBones[ Vertex.Indices[i] ]._11;
+            for( UINT j = 0; j < 16; j++ )
+                M[j] += fWeight * pBone[j];
+        }
+
+        const float* pIn[3] = { Vertex.Position, Vertex.Normal, Vertex.Tangent };
+        D3DXVECTOR3* pOut[3] = { &pPositions[v], &pNormals[v], &pTangents[v] };
+        for( UINT k = 0; k < 3; k++ )
+        {
+            float Out[3];
+            for( UINT j = 0; j < 3; j++ )
+            {
+                Out[j] = pIn[k][0] * M[j] + pIn[k][1] * M[4 + j] + pIn[k][2] * M[8 + j];
+                if( k == 0 )
+                    Out[j] += M[12 + j];
+            }
+            if( k > 0 )
+            {
+                float fLength = sqrtf( Out[0] * Out[0] + Out[1] * Out[1] + Out[2] * Out[2] );
+                if( fLength > 0.0f )
+                {
+                    for( UINT j = 0; j < 3; j++ )
+                        Out[j] /= fLength;
+                }
+            }
+            pOut[k]->x = Out[0];
+            pOut[k]->y = Out[1];
+            pOut[k]->z = Out[2];
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+static double GetElapsedMs( const LARGE_INTEGER& Start, const LARGE_INTEGER& Frequency )
+{
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter( &Now );
+    return ( double )( Now.QuadPart - Start.QuadPart ) * 1000.0 / ( double )Frequency.QuadPart;
+}
+
+//--------------------------------------------------------------------------------------
+static float GetMaxError( const D3DXVECTOR3* pA, const D3DXVECTOR3* pB, UINT Count )
+{
+    float fMax = 0.0f;
+    for( UINT i = 0; i < Count; i++ )
+    {
+        fMax = max( fMax, fabsf( pA[i].x - pB[i].x ) );
+        fMax = max( fMax, fabsf( pA[i].y - pB[i].y ) );
+        fMax = max( fMax, fabsf( pA[i].z - pB[i].z ) );
+    }
+    return fMax;
+}
+
+//--------------------------------------------------------------------------------------
+static float NextRandom( DWORD* pSeed )
+{
+    *pSeed = *pSeed * 1664525 + 1013904223;
+    return ( float )( *pSeed >> 8 ) / ( float )( 1 << 24 );
+}
+
+#define SDKMESH_SKIN_BENCHMARK_PASSES 8
+
+// Positions reach a few tens of units, so this is a few float ulps at that scale
+#define SDKMESH_SKIN_BENCHMARK_TOLERANCE 1e-3f
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshBenchmarkSkinning( UINT NumVertices, UINT NumBones, SDKMESH_SKIN_BENCHMARK* pResults )
+{
+    if( !pResults || NumVertices == 0 || NumBones == 0 || NumBones > 256 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResults, sizeof( SDKMESH_SKIN_BENCHMARK ) );
+    pResults->NumVertices = NumVertices;
+    pResults->NumBones = NumBones;
+
+    SDKMESH_SKIN_BENCHMARK_VERTEX* pVertices = new SDKMESH_SKIN_BENCHMARK_VERTEX[NumVertices];
+    D3DXMATRIX* pBones = new D3DXMATRIX[NumBones];
+    D3DXVECTOR3* pOutput = new D3DXVECTOR3[NumVertices * 6];
+    if( !pVertices || !pBones || !pOutput )
+    {
+        SAFE_DELETE_ARRAY( pVertices );
+        SAFE_DELETE_ARRAY( pBones );
+        SAFE_DELETE_ARRAY( pOutput );
+        return E_OUTOFMEMORY;
+    }
+
+    DWORD Seed = 12345;
+
+    // Affine bones with a translation of up to 10 units
+    for( UINT i = 0; i < NumBones; i++ )
+    {
+        float* pBone = &pBones[i]._11;
+        for( UINT j = 0; j < 16; j++ )
+            pBone[j] = NextRandom( &Seed ) * 2.0f - 1.0f;
+        for( UINT j = 12; j < 15; j++ )
+            pBone[j] *= 10.0f;
+        pBones[i]._14 = pBones[i]._24 = pBones[i]._34 = 0.0f;
+        pBones[i]._44 = 1.0f;
+    }
+
+    // Four influences per vertex with weights that sum to exactly 255
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        SDKMESH_SKIN_BENCHMARK_VERTEX& Vertex = pVertices[v];
+        for( UINT j = 0; j < 3; j++ )
+        {
+            Vertex.Position[j] = NextRandom( &Seed ) * 2.0f - 1.0f;
+            Vertex.Normal[j] = NextRandom( &Seed ) * 2.0f - 1.0f;
+            Vertex.Tangent[j] = NextRandom( &Seed ) * 2.0f - 1.0f;
+        }
+
+        UINT Remaining = 255;
+        for( UINT j = 0; j < 3; j++ )
+        {
+            Vertex.Weights[j] = ( BYTE )( NextRandom( &Seed ) * ( Remaining + 1 ) );
+            Remaining -= Vertex.Weights[j];
+        }
+        Vertex.Weights[3] = ( BYTE )Remaining;
+
+        for( UINT j = 0; j < 4; j++ )
+            Vertex.Indices[j] = ( BYTE )( NextRandom( &Seed ) * NumBones );
+    }
+
+    const D3DVERTEXELEMENT9 Decl[] =
+    {
+        { 0, 0,  D3DDECLTYPE_FLOAT3,  D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION,     0 },
+        { 0, 12, D3DDECLTYPE_FLOAT3,  D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL,       0 },
+        { 0, 24, D3DDECLTYPE_FLOAT3,  D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TANGENT,      0 },
+        { 0, 36, D3DDECLTYPE_UBYTE4N, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDWEIGHT,  0 },
+        { 0, 40, D3DDECLTYPE_UBYTE4,  D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDINDICES, 0 },
+        D3DDECL_END()
+    };
+
+    SDKMESH_SKIN_SOURCE Source;
+    ZeroMemory( &Source, sizeof( SDKMESH_SKIN_SOURCE ) );
+    HRESULT hr = SDKMeshAddSkinStream( &Source, Decl, ( const BYTE* )pVertices,
+                                       sizeof( SDKMESH_SKIN_BENCHMARK_VERTEX ), NumVertices );
+
+    D3DXVECTOR3* pPositions = pOutput;
+    D3DXVECTOR3* pNormals = pOutput + NumVertices;
+    D3DXVECTOR3* pTangents = pOutput + NumVertices * 2;
+    D3DXVECTOR3* pRefPositions = pOutput + NumVertices * 3;
+    D3DXVECTOR3* pRefNormals = pOutput + NumVertices * 4;
+    D3DXVECTOR3* pRefTangents = pOutput + NumVertices * 5;
+
+    LARGE_INTEGER Frequency, Start;
+    QueryPerformanceFrequency( &Frequency );
+
+    if( SUCCEEDED( hr ) )
+    {
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 0; i < SDKMESH_SKIN_BENCHMARK_PASSES; i++ )
+            SkinVerticesScalar( pVertices, NumVertices, pBones, pRefPositions, pRefNormals, pRefTangents );
+        pResults->ScalarMs = GetElapsedMs( Start, Frequency ) / SDKMESH_SKIN_BENCHMARK_PASSES;
+
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 0; i < SDKMESH_SKIN_BENCHMARK_PASSES; i++ )
+            SDKMeshSkinVertices( &Source, pBones, NumBones, pPositions, pNormals, pTangents, false );
+        pResults->SingleThreadMs = GetElapsedMs( Start, Frequency ) / SDKMESH_SKIN_BENCHMARK_PASSES;
+
+        ZeroMemory( pOutput, sizeof( D3DXVECTOR3 ) * NumVertices * 3 );
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 0; i < SDKMESH_SKIN_BENCHMARK_PASSES; i++ )
+            SDKMeshSkinVertices( &Source, pBones, NumBones, pPositions, pNormals, pTangents, true );
+        pResults->MultiThreadMs = GetElapsedMs( Start, Frequency ) / SDKMESH_SKIN_BENCHMARK_PASSES;
+
+        if( pResults->SingleThreadMs > 0.0 )
+            pResults->SingleThreadVerticesPerSecond = NumVertices * 1000.0 / pResults->SingleThreadMs;
+        if( pResults->MultiThreadMs > 0.0 )
+            pResults->MultiThreadVerticesPerSecond = NumVertices * 1000.0 / pResults->MultiThreadMs;
+
+        pResults->MaxError = max( GetMaxError( pPositions, pRefPositions, NumVertices ),
+                                  max( GetMaxError( pNormals, pRefNormals, NumVertices ),
+                                       GetMaxError( pTangents, pRefTangents, NumVertices ) ) );
+
+        if( pResults->MaxError > SDKMESH_SKIN_BENCHMARK_TOLERANCE )
+            hr = E_FAIL;
+    }
+
+    SAFE_DELETE_ARRAY( pVertices );
+    SAFE_DELETE_ARRAY( pBones );
+    SAFE_DELETE_ARRAY( pOutput );
+
+    return hr;
+}
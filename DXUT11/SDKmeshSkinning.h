@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshSkinning.h
+//
+// CPU skinning of raw .sdkmesh vertex streams, used by CDXUTSDKMesh::SkinMesh for tools,
+// physics proxies and checking skinned results without a device
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHSKINNING_H
+#define SDKMESHSKINNING_H
+
+//--------------------------------------------------------------------------------------
+// The vertex attributes skinning reads, each found by usage (index 0) in a vertex
+// declaration. Elements may come from different streams.
+//--------------------------------------------------------------------------------------
+enum SDKMESH_SKIN_ATTRIBUTE
+{
+    SDKMESH_SKIN_POSITION = 0,
+    SDKMESH_SKIN_NORMAL,
+    SDKMESH_SKIN_TANGENT,
+    SDKMESH_SKIN_BLENDWEIGHT,
+    SDKMESH_SKIN_BLENDINDICES,
+    SDKMESH_SKIN_ATTRIBUTE_COUNT
+};
+
+struct SDKMESH_SKIN_ELEMENT
+{
+    const BYTE* pData;  // the element in the first vertex, or NULL if the mesh has none
+    UINT Stride;
+    BYTE Type;          // D3DDECLTYPE
+};
+
+struct SDKMESH_SKIN_SOURCE
+{
+    SDKMESH_SKIN_ELEMENT Elements[SDKMESH_SKIN_ATTRIBUTE_COUNT];
+    UINT NumVertices;
+};
+
+// Adds the elements of one stream to pSource, which should be zeroed before the first
+// stream; NumVertices ends up as the shortest stream's. Fails with E_NOTIMPL if an
+// element's type can't be decoded, or if the blend indices are a normalized 16 or 10
+// bit type. Byte blend indices (UBYTE4, UBYTE4N, D3DCOLOR) are read as raw integers.
+HRESULT SDKMeshAddSkinStream( __inout SDKMESH_SKIN_SOURCE* pSource, const D3DVERTEXELEMENT9* pDecl,
+                              const BYTE* pVertices, UINT Stride, UINT NumVertices );
+
+//--------------------------------------------------------------------------------------
+// Skins every vertex of pSource by up to four bones from pBones, which are indexed by
+// the vertex's blend indices. Weights given with fewer than four components get a last
+// weight of one minus the others, as in fixed function blending; a vertex without
+// weights is bound rigidly to its first index, and one without indices to bone 0.
+// Normals and tangents are renormalized; UBYTE4N and D3DCOLOR ones are taken to be
+// biased into 0..1. Any output may be NULL. The vertices are split into ranges that run
+// on the thread pool unless bMultithreaded is false.
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshSkinVertices( __in const SDKMESH_SKIN_SOURCE* pSource, __in const D3DXMATRIX* pBones,
+                             UINT NumBones, __out_opt D3DXVECTOR3* pPositions, __out_opt D3DXVECTOR3* pNormals,
+                             __out_opt D3DXVECTOR3* pTangents, bool bMultithreaded = true );
+
+//--------------------------------------------------------------------------------------
+// Skins NumVertices synthetic vertices (float3 position, normal and tangent, UBYTE4N
+// weights over four of NumBones bones) single threaded, multithreaded and with a scalar
+// reference, and fails if any result differs from the reference by more than MaxError.
+// Times are the average of several passes.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_SKIN_BENCHMARK
+{
+    UINT NumVertices;
+    UINT NumBones;
+    double ScalarMs;
+    double SingleThreadMs;
+    double MultiThreadMs;
+    double SingleThreadVerticesPerSecond;
+    double MultiThreadVerticesPerSecond;
+    float MaxError;
+};
+
+HRESULT SDKMeshBenchmarkSkinning( UINT NumVertices, UINT NumBones, __out SDKMESH_SKIN_BENCHMARK* pResults );
+
+#endif // SDKMESHSKINNING_H
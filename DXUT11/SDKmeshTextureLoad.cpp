@@ -0,0 +1,314 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshTextureLoad.cpp
+//
+// Parallel, deduplicated Direct3D 11 texture loading for .sdkmesh materials
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKmisc.h"
+#include "SDKmeshTextureLoad.h"
+
+#define TEXTURE_FROM_CACHE 0xffffffff
+
+//--------------------------------------------------------------------------------------
+// The requests of file i are pOrder[ pFirstRequest[i] ] up to pFirstRequest[i + 1], and
+// ppViews[i] keeps its view for the resource cache. hDone is only created for a
+// background load.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_TEXTURE_LOADER
+{
+    ID3D11Device* pDevice;
+    bool bUseCache;
+    SDKMESH_TEXTURE_REQUEST* pRequests;
+    UINT NumRequests;
+    UINT* pOrder;
+    UINT* pFirstRequest;
+    ID3D11ShaderResourceView** ppViews;
+    UINT NumFiles;
+    UINT NumCached;
+    volatile LONG NumFailed;
+    volatile LONG bDone;
+    HANDLE hDone;
+};
+
+//--------------------------------------------------------------------------------------
+static void FreeTextureLoader( SDKMESH_TEXTURE_LOADER* pLoader )
+{
+    if( pLoader->hDone )
+        CloseHandle( pLoader->hDone );
+    for( UINT i = 0; pLoader->ppViews && i < pLoader->NumFiles; i++ )
+        SAFE_RELEASE( pLoader->ppViews[i] );
+    SAFE_RELEASE( pLoader->pDevice );
+    SAFE_DELETE_ARRAY( pLoader->pRequests );
+    SAFE_DELETE_ARRAY( pLoader->pOrder );
+    SAFE_DELETE_ARRAY( pLoader->pFirstRequest );
+    SAFE_DELETE_ARRAY( pLoader->ppViews );
+    delete pLoader;
+}
+
+//--------------------------------------------------------------------------------------
+static void GetWidePath( const SDKMESH_TEXTURE_REQUEST* pRequest, WCHAR* wszPath )
+{
+    MultiByteToWideChar( CP_ACP, 0, pRequest->szPath, -1, wszPath, MAX_PATH );
+    wszPath[MAX_PATH - 1] = 0;
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT ReadTextureFile( const WCHAR* wszPath, BYTE** ppData, DWORD* pBytes )
+{
+    HANDLE hFile = CreateFileW( wszPath, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return HRESULT_FROM_WIN32( GetLastError() );
+
+    HRESULT hr = S_OK;
+    DWORD Bytes = GetFileSize( hFile, NULL );
+    BYTE* pData = ( Bytes != INVALID_FILE_SIZE ) ? new BYTE[ max( Bytes, 1 ) ] : NULL;
+    DWORD BytesRead = 0;
+    if( !pData )
+        hr = E_OUTOFMEMORY;
+    else if( !ReadFile( hFile, pData, Bytes, &BytesRead, NULL ) || BytesRead != Bytes )
+        hr = E_FAIL;
+    CloseHandle( hFile );
+
+    if( FAILED( hr ) )
+    {
+        SAFE_DELETE_ARRAY( pData );
+        return hr;
+    }
+
+    *ppData = pData;
+    *pBytes = Bytes;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Loads one file and hands its view to every request for it. sRGB textures are created
+// in the sRGB format with D3DX11_FILTER_SRGB, which says the data already is sRGB, so
+// D3DX doesn't convert it and nothing has to be copied through the immediate context.
+//--------------------------------------------------------------------------------------
+static void CALLBACK LoadTextureFile( UINT iFile, void* pContext )
+{
+    SDKMESH_TEXTURE_LOADER* pLoader = ( SDKMESH_TEXTURE_LOADER* )pContext;
+    const SDKMESH_TEXTURE_REQUEST* pFirst = &pLoader->pRequests[ pLoader->pOrder[ pLoader->pFirstRequest[iFile] ] ];
+
+    WCHAR wszPath[MAX_PATH];
+    GetWidePath( pFirst, wszPath );
+
+    ID3D11ShaderResourceView* pSRV = NULL;
+    BYTE* pData = NULL;
+    DWORD Bytes = 0;
+    HRESULT hr = ReadTextureFile( wszPath, &pData, &Bytes );
+    if( SUCCEEDED( hr ) )
+    {
+        D3DX11_IMAGE_INFO SrcInfo;
+        hr = D3DX11GetImageInfoFromMemory( pData, Bytes, NULL, &SrcInfo, NULL );
+        if( SUCCEEDED( hr ) )
+        {
+            D3DX11_IMAGE_LOAD_INFO LoadInfo;
+            LoadInfo.pSrcInfo = &SrcInfo;
+            LoadInfo.Format = SrcInfo.Format;
+            if( pFirst->bSRGB )
+            {
+                LoadInfo.Format = MAKE_SRGB( SrcInfo.Format );
+                LoadInfo.Filter = D3DX11_FILTER_NONE | D3DX11_FILTER_SRGB;
+            }
+            hr = D3DX11CreateShaderResourceViewFromMemory( pLoader->pDevice, pData, Bytes, &LoadInfo, NULL, &pSRV,
+                                                           NULL );
+        }
+        SAFE_DELETE_ARRAY( pData );
+    }
+
+    if( FAILED( hr ) )
+    {
+        pSRV = NULL;
+        InterlockedIncrement( &pLoader->NumFailed );
+    }
+    else
+    {
+        DXUT_SetDebugName( pSRV, "CDXUTSDKMesh" );
+    }
+
+    for( UINT r = pLoader->pFirstRequest[iFile]; r < pLoader->pFirstRequest[iFile + 1]; r++ )
+    {
+        ID3D11ShaderResourceView* pTarget = ( ID3D11ShaderResourceView* )ERROR_RESOURCE_VALUE;
+        if( pSRV )
+        {
+            pSRV->AddRef();
+            pTarget = pSRV;
+        }
+        InterlockedExchangePointer( ( PVOID* )pLoader->pRequests[ pLoader->pOrder[r] ].ppTarget, pTarget );
+    }
+    pLoader->ppViews[iFile] = pSRV;
+}
+
+//--------------------------------------------------------------------------------------
+static DWORD WINAPI TextureLoaderProc( LPVOID pParam )
+{
+    SDKMESH_TEXTURE_LOADER* pLoader = ( SDKMESH_TEXTURE_LOADER* )pParam;
+    DXUTParallelFor( pLoader->NumFiles, LoadTextureFile, pLoader );
+    InterlockedExchange( &pLoader->bDone, TRUE );
+    SetEvent( pLoader->hDone );
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT SDKMeshBeginTextureLoads( ID3D11Device* pd3dDevice, const SDKMESH_TEXTURE_REQUEST* pRequests,
+                                  UINT NumRequests, bool bAsync, SDKMESH_TEXTURE_LOADER** ppLoader )
+{
+    if( !pd3dDevice || ( NumRequests > 0 && !pRequests ) || !ppLoader )
+        return E_INVALIDARG;
+    *ppLoader = NULL;
+
+    SDKMESH_TEXTURE_LOADER* pLoader = new SDKMESH_TEXTURE_LOADER;
+    if( !pLoader )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pLoader, sizeof( SDKMESH_TEXTURE_LOADER ) );
+
+    pLoader->pRequests = new SDKMESH_TEXTURE_REQUEST[ max( NumRequests, 1 ) ];
+    pLoader->pOrder = new UINT[ max( NumRequests, 1 ) ];
+    pLoader->pFirstRequest = new UINT[ NumRequests + 1 ];
+    pLoader->ppViews = new ID3D11ShaderResourceView*[ max( NumRequests, 1 ) ];
+    UINT* pFileOf = new UINT[ max( NumRequests, 1 ) ];
+    UINT* pFileRequest = new UINT[ max( NumRequests, 1 ) ];
+    if( !pLoader->pRequests || !pLoader->pOrder || !pLoader->pFirstRequest || !pLoader->ppViews || !pFileOf ||
+        !pFileRequest )
+    {
+        SAFE_DELETE_ARRAY( pFileOf );
+        SAFE_DELETE_ARRAY( pFileRequest );
+        FreeTextureLoader( pLoader );
+        return E_OUTOFMEMORY;
+    }
+    ZeroMemory( pLoader->ppViews, sizeof( ID3D11ShaderResourceView* ) * max( NumRequests, 1 ) );
+    if( NumRequests > 0 )
+        CopyMemory( pLoader->pRequests, pRequests, sizeof( SDKMESH_TEXTURE_REQUEST ) * NumRequests );
+    pLoader->NumRequests = NumRequests;
+    pLoader->pDevice = pd3dDevice;
+    pd3dDevice->AddRef();
+
+    // The resource cache holds views for DXUT's device, and is only used from this
+    // thread. Files another mesh already loaded through it aren't loaded again.
+    pLoader->bUseCache = ( pd3dDevice == DXUTGetD3D11Device() );
+
+    // Materials number in the tens or hundreds, so comparing each request against the
+    // files found so far costs nothing next to a single load
+    for( UINT r = 0; r < NumRequests; r++ )
+    {
+        const SDKMESH_TEXTURE_REQUEST* pRequest = &pLoader->pRequests[r];
+        if( pLoader->bUseCache )
+        {
+            WCHAR wszPath[MAX_PATH];
+            ID3D11ShaderResourceView* pCached = NULL;
+            GetWidePath( pRequest, wszPath );
+            if( DXUTGetGlobalResourceCache().FindTextureFromFile( pd3dDevice, wszPath, pRequest->bSRGB,
+                                                                  &pCached ) == S_OK )
+            {
+                *pRequest->ppTarget = pCached;
+                pFileOf[r] = TEXTURE_FROM_CACHE;
+                pLoader->NumCached++;
+                continue;
+            }
+        }
+
+        UINT iFile = 0;
+        for( ; iFile < pLoader->NumFiles; iFile++ )
+        {
+            const SDKMESH_TEXTURE_REQUEST* pOther = &pLoader->pRequests[ pFileRequest[iFile] ];
+            if( pOther->bSRGB == pRequest->bSRGB && _stricmp( pOther->szPath, pRequest->szPath ) == 0 )
+                break;
+        }
+        if( iFile == pLoader->NumFiles )
+            pFileRequest[ pLoader->NumFiles++ ] = r;
+        pFileOf[r] = iFile;
+    }
+
+    // Group the requests by file
+    ZeroMemory( pLoader->pFirstRequest, sizeof( UINT ) * ( NumRequests + 1 ) );
+    for( UINT r = 0; r < NumRequests; r++ )
+    {
+        if( pFileOf[r] != TEXTURE_FROM_CACHE )
+            pLoader->pFirstRequest[ pFileOf[r] + 1 ]++;
+    }
+    for( UINT i = 0; i < pLoader->NumFiles; i++ )
+        pLoader->pFirstRequest[i + 1] += pLoader->pFirstRequest[i];
+    for( UINT r = 0; r < NumRequests; r++ )
+    {
+        if( pFileOf[r] != TEXTURE_FROM_CACHE )
+            pLoader->pOrder[ pLoader->pFirstRequest[ pFileOf[r] ]++ ] = r;
+    }
+    for( UINT i = pLoader->NumFiles; i > 0; i-- )
+        pLoader->pFirstRequest[i] = pLoader->pFirstRequest[i - 1];
+    pLoader->pFirstRequest[0] = 0;
+
+    SAFE_DELETE_ARRAY( pFileOf );
+    SAFE_DELETE_ARRAY( pFileRequest );
+
+    if( pd3dDevice->GetCreationFlags() & D3D11_CREATE_DEVICE_SINGLETHREADED )
+    {
+        for( UINT i = 0; i < pLoader->NumFiles; i++ )
+            LoadTextureFile( i, pLoader );
+        pLoader->bDone = TRUE;
+    }
+    else if( bAsync && pLoader->NumFiles > 0 )
+    {
+        pLoader->hDone = CreateEvent( NULL, TRUE, FALSE, NULL );
+        if( !pLoader->hDone || !QueueUserWorkItem( TextureLoaderProc, pLoader, WT_EXECUTELONGFUNCTION ) )
+        {
+            if( pLoader->hDone )
+                CloseHandle( pLoader->hDone );
+            pLoader->hDone = NULL;
+            DXUTParallelFor( pLoader->NumFiles, LoadTextureFile, pLoader );
+            pLoader->bDone = TRUE;
+        }
+    }
+    else
+    {
+        DXUTParallelFor( pLoader->NumFiles, LoadTextureFile, pLoader );
+        pLoader->bDone = TRUE;
+    }
+
+    *ppLoader = pLoader;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+bool SDKMeshIsTextureLoadDone( SDKMESH_TEXTURE_LOADER* pLoader )
+{
+    return pLoader->bDone != FALSE;
+}
+
+//--------------------------------------------------------------------------------------
+void SDKMeshEndTextureLoads( SDKMESH_TEXTURE_LOADER* pLoader, SDKMESH_TEXTURE_LOAD_STATS* pStats )
+{
+    if( !pLoader )
+        return;
+
+    // The background load sets bDone just before its event, so wait on the event even
+    // when bDone is already set, or the handle could be closed under it
+    if( pLoader->hDone )
+        WaitForSingleObject( pLoader->hDone, INFINITE );
+
+    // Hand the new views to the resource cache, so the next mesh using these files
+    // shares them
+    for( UINT i = 0; pLoader->bUseCache && i < pLoader->NumFiles; i++ )
+    {
+        if( !pLoader->ppViews[i] )
+            continue;
+
+        const SDKMESH_TEXTURE_REQUEST* pFirst = &pLoader->pRequests[ pLoader->pOrder[ pLoader->pFirstRequest[i] ] ];
+        WCHAR wszPath[MAX_PATH];
+        GetWidePath( pFirst, wszPath );
+        DXUTGetGlobalResourceCache().AddTextureFromFile( pLoader->pDevice, wszPath, pFirst->bSRGB,
+                                                         pLoader->ppViews[i] );
+    }
+
+    if( pStats )
+    {
+        pStats->NumRequests = pLoader->NumRequests;
+        pStats->NumFiles = pLoader->NumFiles;
+        pStats->NumCached = pLoader->NumCached;
+        pStats->NumFailed = ( UINT )pLoader->NumFailed;
+    }
+    FreeTextureLoader( pLoader );
+}
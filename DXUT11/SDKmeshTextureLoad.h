@@ -0,0 +1,56 @@
+//--------------------------------------------------------------------------------------
+// File: SDKmeshTextureLoad.h
+//
+// Parallel, deduplicated Direct3D 11 texture loading for .sdkmesh materials
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef SDKMESHTEXTURELOAD_H
+#define SDKMESHTEXTURELOAD_H
+
+//--------------------------------------------------------------------------------------
+// One material texture slot to fill. Requests naming the same file (case-insensitively)
+// with the same bSRGB share one load, and each target gets its own reference to the
+// view. Targets are written as the loads finish: the view, or ERROR_RESOURCE_VALUE when
+// the file couldn't be loaded, so until then they read NULL the way the mesh's
+// outstanding resource count expects.
+//
+// On DXUT's device the loads also go through the global resource cache, as the
+// samples' texture loads do: views of files already in it are handed out at once, and
+// SDKMeshEndTextureLoads adds the new ones, so other meshes share them.
+//--------------------------------------------------------------------------------------
+struct SDKMESH_TEXTURE_REQUEST
+{
+    char szPath[MAX_PATH];
+    bool bSRGB;
+    ID3D11ShaderResourceView** ppTarget;
+};
+
+struct SDKMESH_TEXTURE_LOAD_STATS
+{
+    UINT NumRequests;
+    UINT NumFiles;          // distinct loads after deduplication
+    UINT NumCached;         // requests served by views already in the resource cache
+    UINT NumFailed;         // files that couldn't be loaded
+};
+
+struct SDKMESH_TEXTURE_LOADER;
+
+// Starts loading the requests, which are copied. Files are read and decoded across the
+// thread pool; with bAsync the call returns at once and the loads finish in the
+// background, otherwise it returns when they're done. A device created with
+// D3D11_CREATE_DEVICE_SINGLETHREADED is only ever used from the calling thread, one
+// file at a time.
+HRESULT SDKMeshBeginTextureLoads( ID3D11Device* pd3dDevice, __in_ecount( NumRequests ) const SDKMESH_TEXTURE_REQUEST* pRequests,
+                                  UINT NumRequests, bool bAsync, __out SDKMESH_TEXTURE_LOADER** ppLoader );
+
+// True once every target has been written
+bool SDKMeshIsTextureLoadDone( __in SDKMESH_TEXTURE_LOADER* pLoader );
+
+// Blocks until the loads are done, adds the new views to the resource cache and frees
+// the loader. Call it from the thread that began the loads. The stats are complete only
+// after this.
+void SDKMeshEndTextureLoads( __in SDKMESH_TEXTURE_LOADER* pLoader, __out_opt SDKMESH_TEXTURE_LOAD_STATS* pStats );
+
+#endif // SDKMESHTEXTURELOAD_H
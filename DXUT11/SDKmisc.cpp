@@ -552,7 +552,6 @@ HRESULT CDXUTResourceCache::CreateTextureFromFileEx( ID3D11Device* pDevice, ID3D
                                                      ID3D11ShaderResourceView** ppOutputRV, bool bSRGB )
 {
 
-    bool is10L9 = DXUTGetDeviceSettings().d3d11.DeviceFeatureLevel < D3D_FEATURE_LEVEL_10_0; 
     HRESULT hr = S_OK;
     D3DX11_IMAGE_LOAD_INFO ZeroInfo;	//D3DX11_IMAGE_LOAD_INFO has a default constructor
     D3DX11_IMAGE_INFO SrcInfo;
@@ -570,12 +569,14 @@ HRESULT CDXUTResourceCache::CreateTextureFromFileEx( ID3D11Device* pDevice, ID3D
         pLoadInfo->Format = pLoadInfo->pSrcInfo->Format;
     }
 
-    // Search the cache for a matching entry.
+    // Search the cache for a matching entry. File names compare without case, as the
+    // file system does.
     for( int i = 0; i < m_TextureCache.GetSize(); ++i )
     {
         DXUTCache_Texture& Entry = m_TextureCache[i];
         if( Entry.Location == DXUTCACHE_LOCATION_FILE &&
-            !lstrcmpW( Entry.wszSource, pSrcFile ) &&
+            !_wcsicmp( Entry.wszSource, pSrcFile ) &&
+            Entry.bSRGB == bSRGB &&
             Entry.Width == pLoadInfo->Width &&
             Entry.Height == pLoadInfo->Height &&
             Entry.MipLevels == pLoadInfo->MipLevels &&
@@ -609,12 +610,8 @@ HRESULT CDXUTResourceCache::CreateTextureFromFileEx( ID3D11Device* pDevice, ID3D
     NewEntry.Height = pLoadInfo->Height;
     NewEntry.MipLevels = pLoadInfo->MipLevels;
     NewEntry.Usage11 = pLoadInfo->Usage;
-    // 10L9 can't handle typesless, so we cant make a typesless format 
-    if (is10L9 && bSRGB) {
-        NewEntry.Format = MAKE_SRGB(pLoadInfo->Format);
-    }else {
-        NewEntry.Format = pLoadInfo->Format;
-    }
+    NewEntry.Format = pLoadInfo->Format;
+    NewEntry.bSRGB = bSRGB;
     NewEntry.CpuAccessFlags = pLoadInfo->CpuAccessFlags;
     NewEntry.BindFlags = pLoadInfo->BindFlags;
     NewEntry.MiscFlags = pLoadInfo->MiscFlags;
@@ -731,6 +728,88 @@ HRESULT CDXUTResourceCache::CreateTextureFromFileEx( ID3D11Device* pDevice, ID3D
     return S_OK;
 }
 
+//--------------------------------------------------------------------------------------
+// The inverse of MAKE_SRGB
+//--------------------------------------------------------------------------------------
+static DXGI_FORMAT MakeTextureFormatLinear( DXGI_FORMAT Format )
+{
+    switch( Format )
+    {
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:   return DXGI_FORMAT_R8G8B8A8_UNORM;
+        case DXGI_FORMAT_BC1_UNORM_SRGB:        return DXGI_FORMAT_BC1_UNORM;
+        case DXGI_FORMAT_BC2_UNORM_SRGB:        return DXGI_FORMAT_BC2_UNORM;
+        case DXGI_FORMAT_BC3_UNORM_SRGB:        return DXGI_FORMAT_BC3_UNORM;
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:   return DXGI_FORMAT_B8G8R8A8_UNORM;
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:   return DXGI_FORMAT_B8G8R8X8_UNORM;
+        case DXGI_FORMAT_BC7_UNORM_SRGB:        return DXGI_FORMAT_BC7_UNORM;
+    }
+    return Format;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTResourceCache::FindTextureFromFile( ID3D11Device* pDevice, LPCTSTR pSrcFile, bool bSRGB,
+                                                 ID3D11ShaderResourceView** ppOutputRV )
+{
+    if( !pDevice || !pSrcFile || !ppOutputRV )
+        return E_INVALIDARG;
+    *ppOutputRV = NULL;
+
+    for( int i = 0; i < m_TextureCache.GetSize(); ++i )
+    {
+        DXUTCache_Texture& Entry = m_TextureCache[i];
+        if( Entry.Location == DXUTCACHE_LOCATION_FILE && Entry.pSRV11 && Entry.bSRGB == bSRGB &&
+            !_wcsicmp( Entry.wszSource, pSrcFile ) )
+            return Entry.pSRV11->QueryInterface( __uuidof( ID3D11ShaderResourceView ), ( LPVOID* )ppOutputRV );
+    }
+
+    return S_FALSE;
+}
+
+//--------------------------------------------------------------------------------------
+// The entry is keyed like a default CreateTextureFromFile load with the same bSRGB: the
+// file's format, which is the view's without sRGB, and the sRGB flag. So a view added
+// here is also what CreateTextureFromFile hands out for the file.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTResourceCache::AddTextureFromFile( ID3D11Device* pDevice, LPCTSTR pSrcFile, bool bSRGB,
+                                                ID3D11ShaderResourceView* pSRV )
+{
+    if( !pDevice || !pSrcFile || !pSRV || wcslen( pSrcFile ) >= MAX_PATH )
+        return E_INVALIDARG;
+
+    // Another load of the same file may have got here first
+    ID3D11ShaderResourceView* pCached = NULL;
+    if( FindTextureFromFile( pDevice, pSrcFile, bSRGB, &pCached ) == S_OK )
+    {
+        SAFE_RELEASE( pCached );
+        return S_OK;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC Desc;
+    pSRV->GetDesc( &Desc );
+
+    D3DX11_IMAGE_LOAD_INFO DefaultInfo;
+    DXUTCache_Texture NewEntry;
+    NewEntry.Location = DXUTCACHE_LOCATION_FILE;
+    wcscpy_s( NewEntry.wszSource, MAX_PATH, pSrcFile );
+    NewEntry.hSrcModule = NULL;
+    NewEntry.Width = DefaultInfo.Width;
+    NewEntry.Height = DefaultInfo.Height;
+    NewEntry.Depth = DefaultInfo.Depth;
+    NewEntry.MipLevels = DefaultInfo.MipLevels;
+    NewEntry.Usage11 = DefaultInfo.Usage;
+    NewEntry.Format = MakeTextureFormatLinear( Desc.Format );
+    NewEntry.bSRGB = bSRGB;
+    NewEntry.CpuAccessFlags = DefaultInfo.CpuAccessFlags;
+    NewEntry.BindFlags = DefaultInfo.BindFlags;
+    NewEntry.MiscFlags = DefaultInfo.MiscFlags;
+    NewEntry.pSRV11 = pSRV;
+
+    HRESULT hr = m_TextureCache.Add( NewEntry );
+    if( SUCCEEDED( hr ) )
+        pSRV->AddRef();
+    return hr;
+}
+
 
 //--------------------------------------------------------------------------------------
 HRESULT CDXUTResourceCache::CreateTextureFromResource( LPDIRECT3DDEVICE9 pDevice, HMODULE hSrcModule,
@@ -51,11 +51,13 @@ struct DXUTCache_Texture
         D3DRESOURCETYPE Type9;
         UINT BindFlags;
     };
+    bool bSRGB;     // D3D11 only: the view reads the texels as sRGB
     IDirect3DBaseTexture9* pTexture9;
     ID3D11ShaderResourceView* pSRV11;
 
             DXUTCache_Texture()
             {
+                bSRGB = false;
                 pTexture9 = NULL;
                 pSRV11 = NULL;
             }
@@ -97,6 +99,15 @@ public:
     HRESULT                 CreateTextureFromFileEx( ID3D11Device* pDevice, ID3D11DeviceContext* pContext, LPCTSTR pSrcFile,
                                                      D3DX11_IMAGE_LOAD_INFO* pLoadInfo, ID3DX11ThreadPump* pPump,
                                                      ID3D11ShaderResourceView** ppOutputRV, bool bSRGB );
+    // Views loaded from a file outside the cache, such as the .sdkmesh material textures
+    // (see SDKmeshTextureLoad.h), are shared through it as well. Find returns S_FALSE and
+    // NULL when there's no cached view of the file with the same sRGB-ness; both take
+    // their own reference to the view. Like CreateTextureFromFileEx they match file
+    // names without case and keep sRGB and linear views of a file apart.
+    HRESULT                 FindTextureFromFile( ID3D11Device* pDevice, LPCTSTR pSrcFile, bool bSRGB,
+                                                 ID3D11ShaderResourceView** ppOutputRV );
+    HRESULT                 AddTextureFromFile( ID3D11Device* pDevice, LPCTSTR pSrcFile, bool bSRGB,
+                                                ID3D11ShaderResourceView* pSRV );
     HRESULT                 CreateTextureFromResource( LPDIRECT3DDEVICE9 pDevice, HMODULE hSrcModule,
                                                        LPCTSTR pSrcResource, LPDIRECT3DTEXTURE9* ppTexture );
     HRESULT                 CreateTextureFromResourceEx( LPDIRECT3DDEVICE9 pDevice, HMODULE hSrcModule,
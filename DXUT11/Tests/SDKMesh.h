@@ -0,0 +1,10 @@
+//--------------------------------------------------------------------------------------
+// File: SDKMesh.h
+//
+// Sources include the mesh header as "SDKMesh.h", which a case sensitive file system
+// doesn't match to SDKmesh.h. The tests that compile those sources define its guard
+// and include what they need themselves, so this stand-in is empty.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
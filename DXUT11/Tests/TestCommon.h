@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------
+// File: TestCommon.h
+//
+// Minimal check macro shared by the headless DXUT11 tests
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef TESTCOMMON_H
+#define TESTCOMMON_H
+
+#include <stdio.h>
+
+static int g_NumTestFailures = 0;
+
+#define TEST_CHECK( x ) \
+    do { \
+        if( !( x ) ) \
+        { \
+            fprintf( stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x ); \
+            g_NumTestFailures++; \
+        } \
+    } while( 0 )
+
+// Exit code for main
+static inline int TestResult()
+{
+    if( g_NumTestFailures == 0 )
+        printf( "passed\n" );
+    return g_NumTestFailures == 0 ? 0 : 1;
+}
+
+#endif // TESTCOMMON_H
@@ -0,0 +1,202 @@
+//--------------------------------------------------------------------------------------
+// File: TestD3DX.h
+//
+// The D3D9 vertex declaration types, D3D11 input layout and D3DX math types that the
+// device-free SDKmesh sources use, with the same layouts and enum values, for the
+// headless tests.
+// DXUTParallelFor runs its items in order on the calling thread.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef TESTD3DX_H
+#define TESTD3DX_H
+
+#include "TestWindows.h"
+#include "dxgiformat.h"
+#include <float.h>
+
+typedef int16_t SHORT;
+typedef uint16_t USHORT;
+typedef int32_t INT;
+typedef const char* LPCSTR;
+
+#define CALLBACK
+#define E_NOTIMPL       ((HRESULT)0x80004001L)
+
+//--------------------------------------------------------------------------------------
+// Vertex declarations
+//--------------------------------------------------------------------------------------
+#define MAX_FVF_DECL_SIZE 65
+
+enum D3DDECLTYPE
+{
+    D3DDECLTYPE_FLOAT1 = 0,
+    D3DDECLTYPE_FLOAT2 = 1,
+    D3DDECLTYPE_FLOAT3 = 2,
+    D3DDECLTYPE_FLOAT4 = 3,
+    D3DDECLTYPE_D3DCOLOR = 4,
+    D3DDECLTYPE_UBYTE4 = 5,
+    D3DDECLTYPE_SHORT2 = 6,
+    D3DDECLTYPE_SHORT4 = 7,
+    D3DDECLTYPE_UBYTE4N = 8,
+    D3DDECLTYPE_SHORT2N = 9,
+    D3DDECLTYPE_SHORT4N = 10,
+    D3DDECLTYPE_USHORT2N = 11,
+    D3DDECLTYPE_USHORT4N = 12,
+    D3DDECLTYPE_UDEC3 = 13,
+    D3DDECLTYPE_DEC3N = 14,
+    D3DDECLTYPE_FLOAT16_2 = 15,
+    D3DDECLTYPE_FLOAT16_4 = 16,
+    D3DDECLTYPE_UNUSED = 17,
+};
+
+enum D3DDECLMETHOD
+{
+    D3DDECLMETHOD_DEFAULT = 0,
+};
+
+enum D3DDECLUSAGE
+{
+    D3DDECLUSAGE_POSITION = 0,
+    D3DDECLUSAGE_BLENDWEIGHT = 1,
+    D3DDECLUSAGE_BLENDINDICES = 2,
+    D3DDECLUSAGE_NORMAL = 3,
+    D3DDECLUSAGE_PSIZE = 4,
+    D3DDECLUSAGE_TEXCOORD = 5,
+    D3DDECLUSAGE_TANGENT = 6,
+    D3DDECLUSAGE_BINORMAL = 7,
+    D3DDECLUSAGE_TESSFACTOR = 8,
+    D3DDECLUSAGE_POSITIONT = 9,
+    D3DDECLUSAGE_COLOR = 10,
+    D3DDECLUSAGE_FOG = 11,
+    D3DDECLUSAGE_DEPTH = 12,
+    D3DDECLUSAGE_SAMPLE = 13,
+};
+
+struct D3DVERTEXELEMENT9
+{
+    WORD Stream;
+    WORD Offset;
+    BYTE Type;
+    BYTE Method;
+    BYTE Usage;
+    BYTE UsageIndex;
+};
+
+#define D3DDECL_END() { 0xFF, 0, D3DDECLTYPE_UNUSED, 0, 0, 0 }
+
+enum D3D11_INPUT_CLASSIFICATION
+{
+    D3D11_INPUT_PER_VERTEX_DATA = 0,
+    D3D11_INPUT_PER_INSTANCE_DATA = 1,
+};
+
+struct D3D11_INPUT_ELEMENT_DESC
+{
+    LPCSTR SemanticName;
+    UINT SemanticIndex;
+    DXGI_FORMAT Format;
+    UINT InputSlot;
+    UINT AlignedByteOffset;
+    D3D11_INPUT_CLASSIFICATION InputSlotClass;
+    UINT InstanceDataStepRate;
+};
+
+//--------------------------------------------------------------------------------------
+// Math
+//--------------------------------------------------------------------------------------
+struct D3DXVECTOR3
+{
+    float x, y, z;
+
+    D3DXVECTOR3()
+    {
+    }
+    D3DXVECTOR3( float fx, float fy, float fz ) : x( fx ), y( fy ), z( fz )
+    {
+    }
+};
+
+struct D3DXVECTOR4
+{
+    float x, y, z, w;
+};
+
+struct D3DXQUATERNION
+{
+    float x, y, z, w;
+};
+
+struct D3DXMATRIX
+{
+    float _11, _12, _13, _14;
+    float _21, _22, _23, _24;
+    float _31, _32, _33, _34;
+    float _41, _42, _43, _44;
+};
+
+struct D3DXFLOAT16
+{
+    WORD value;
+};
+
+// IEEE half to float, denormals included
+inline float* D3DXFloat16To32Array( float* pOut, const D3DXFLOAT16* pIn, UINT n )
+{
+    for( UINT i = 0; i < n; i++ )
+    {
+        UINT h = pIn[i].value;
+        UINT Exponent = ( h >> 10 ) & 0x1f;
+        float fMantissa = ( float )( h & 0x3ff );
+        float f;
+        if( Exponent == 0 )
+            f = ldexpf( fMantissa, -24 );
+        else if( Exponent == 31 )
+            f = fMantissa ? NAN : INFINITY;
+        else
+            f = ldexpf( fMantissa + 1024.0f, ( int )Exponent - 25 );
+        pOut[i] = ( h & 0x8000 ) ? -f : f;
+    }
+    return pOut;
+}
+
+// Float to IEEE half, rounded to nearest even; too large becomes infinity
+inline D3DXFLOAT16* D3DXFloat32To16Array( D3DXFLOAT16* pOut, const float* pIn, UINT n )
+{
+    for( UINT i = 0; i < n; i++ )
+    {
+        UINT Bits;
+        memcpy( &Bits, &pIn[i], sizeof( UINT ) );
+        UINT Sign = ( Bits >> 16 ) & 0x8000;
+        float f = fabsf( pIn[i] );
+        UINT h;
+        if( f != f )
+            h = 0x7e00;
+        else if( f >= 65520.0f )
+            h = 0x7c00;
+        else if( f < ldexpf( 1.0f, -14 ) )
+            h = ( UINT )nearbyintf( ldexpf( f, 24 ) );
+        else
+        {
+            int Exponent;
+            float Mantissa = frexpf( f, &Exponent );
+            h = ( UINT )nearbyintf( ldexpf( Mantissa, 11 ) ) + ( ( UINT )( Exponent + 14 ) << 10 ) - 1024;
+        }
+        pOut[i].value = ( WORD )( Sign | h );
+    }
+    return pOut;
+}
+
+//--------------------------------------------------------------------------------------
+// Thread pool
+//--------------------------------------------------------------------------------------
+typedef void ( CALLBACK*LPDXUTPARALLELCALLBACK )( UINT iItem, void* pContext );
+
+inline void DXUTParallelFor( UINT NumItems, LPDXUTPARALLELCALLBACK pfnCallback, void* pContext )
+{
+    for( UINT i = 0; i < NumItems; i++ )
+        pfnCallback( i, pContext );
+}
+
+#endif // TESTD3DX_H
@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// File: TestDDSConvert.cpp
+//
+// Runs the D3D11 loader's 8bpc conversion steps from DDSConvert.cpp over X8R8G8B8 and
+// A8R8G8B8 mip chains with DDS_LOADER_PREMULTIPLY_ALPHA set, and checks the colours
+// that come out
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestWindows.h"
+#include "TestCommon.h"
+#include "../../DDSConvert.cpp"
+
+//--------------------------------------------------------------------------------------
+// What CreateTextureFromDDS does to an A8R8G8B8 or X8R8G8B8 file when premultiplying:
+// swap to RGBA, premultiply the top level and rebuild the smaller levels from it
+//--------------------------------------------------------------------------------------
+static void ConvertLikeLoader( BYTE* pBits, UINT Width, UINT Height, UINT MipCount, bool bX8 )
+{
+    UINT NumPixels = 0;
+    for( UINT i = 0, w = Width, h = Height; i < MipCount; i++ )
+    {
+        NumPixels += w * h;
+        w = max( 1, w >> 1 );
+        h = max( 1, h >> 1 );
+    }
+    SwizzleBGRA8ToRGBA8( pBits, NumPixels, bX8 );
+
+    PremultiplyAlphaRGBA8( pBits, ( SIZE_T )Width * Height );
+    BYTE* pLevel = pBits;
+    BYTE* pNext = pBits + Width * Height * 4;
+    for( UINT i = 1, w = Width, h = Height; i < MipCount; i++ )
+    {
+        DownsampleRGBA8( pLevel, w, h, w * 4, pNext, max( 1, w >> 1 ) * 4 );
+        pLevel = pNext;
+        w = max( 1, w >> 1 );
+        h = max( 1, h >> 1 );
+        pNext += w * h * 4;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// A 6x6 X8R8G8B8 chain of one flat colour, with the X bytes left as 0 or as garbage.
+// Six pixels per row leave a scalar tail after the SSE premultiply. Every level must
+// come out as the same opaque colour, not black.
+//--------------------------------------------------------------------------------------
+static void TestX8Premultiply()
+{
+    const UINT Width = 6, Height = 6, MipCount = 3;
+    const UINT NumPixels = 36 + 9 + 1;
+    const BYTE XBytes[] = { 0x00, 0x5a };
+
+    for( UINT x = 0; x < sizeof( XBytes ); x++ )
+    {
+        BYTE Bits[NumPixels * 4];
+        for( UINT i = 0; i < NumPixels; i++ )
+        {
+            // B, G, R, X as stored in the file
+            Bits[i * 4 + 0] = 0x30;
+            Bits[i * 4 + 1] = 0x80;
+            Bits[i * 4 + 2] = 0xc0;
+            Bits[i * 4 + 3] = ( BYTE )( XBytes[x] + i );
+        }
+        ConvertLikeLoader( Bits, Width, Height, MipCount, true );
+
+        UINT NumWrong = 0;
+        for( UINT i = 0; i < NumPixels; i++ )
+        {
+            if( Bits[i * 4 + 0] != 0xc0 || Bits[i * 4 + 1] != 0x80 || Bits[i * 4 + 2] != 0x30 ||
+                Bits[i * 4 + 3] != 0xff )
+                NumWrong++;
+        }
+        if( NumWrong )
+        {
+            fprintf( stderr, "X byte 0x%02x: %u of %u pixels changed, first is %02x %02x %02x %02x\n", XBytes[x],
+                     NumWrong, NumPixels, Bits[0], Bits[1], Bits[2], Bits[3] );
+            g_NumTestFailures++;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// A8R8G8B8 keeps its own alpha and is scaled by it
+//--------------------------------------------------------------------------------------
+static void TestA8Premultiply()
+{
+    const UINT NumPixels = 5;
+    const BYTE Alpha[NumPixels] = { 0x00, 0x40, 0x80, 0xc0, 0xff };
+    BYTE Bits[NumPixels * 4];
+    for( UINT i = 0; i < NumPixels; i++ )
+    {
+        Bits[i * 4 + 0] = 0x30;
+        Bits[i * 4 + 1] = 0x80;
+        Bits[i * 4 + 2] = 0xff;
+        Bits[i * 4 + 3] = Alpha[i];
+    }
+    ConvertLikeLoader( Bits, NumPixels, 1, 1, false );
+
+    for( UINT i = 0; i < NumPixels; i++ )
+    {
+        TEST_CHECK( Bits[i * 4 + 0] == MulDiv255( 0xff, Alpha[i] ) );
+        TEST_CHECK( Bits[i * 4 + 1] == MulDiv255( 0x80, Alpha[i] ) );
+        TEST_CHECK( Bits[i * 4 + 2] == MulDiv255( 0x30, Alpha[i] ) );
+        TEST_CHECK( Bits[i * 4 + 3] == Alpha[i] );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestX8Premultiply();
+    TestA8Premultiply();
+
+    return TestResult();
+}
@@ -0,0 +1,242 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshAnimation.cpp
+//
+// Blends layer samples through SDKmeshAnimation.cpp and checks a crossfade, a partial
+// weight that falls back to the frame's own transform and additive layers against
+// their closed forms, checks the quaternion product against the scalar one, then runs
+// the library's benchmark, which compares the SSE blend with a scalar one
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestD3DX.h"
+#include "TestCommon.h"
+
+// SDKmeshAnimation.h only needs the animation file structures from SDKMesh.h
+#define _SDKMESH_
+#define MAX_FRAME_NAME 100
+
+struct SDKANIMATION_FILE_HEADER
+{
+    UINT Version;
+    BYTE IsBigEndian;
+    UINT FrameTransformType;
+    UINT NumFrames;
+    UINT NumAnimationKeys;
+    UINT AnimationFPS;
+    UINT64 AnimationDataSize;
+    UINT64 AnimationDataOffset;
+};
+
+struct SDKANIMATION_DATA
+{
+    D3DXVECTOR3 Translation;
+    D3DXVECTOR4 Orientation;
+    D3DXVECTOR3 Scaling;
+};
+
+struct SDKANIMATION_FRAME_DATA
+{
+    char FrameName[MAX_FRAME_NAME];
+    union
+    {
+        UINT64 DataOffset;
+        SDKANIMATION_DATA* pAnimationData;
+    };
+};
+
+#include "../SDKmeshAnimation.h"
+#include "../SDKmeshAnimation.cpp"
+
+#define TEST_TOLERANCE 1e-5f
+
+//--------------------------------------------------------------------------------------
+// A rotation of fAngle radians about the z axis
+//--------------------------------------------------------------------------------------
+static __m128 RotationZ( float fAngle )
+{
+    return _mm_setr_ps( 0.0f, 0.0f, sinf( fAngle * 0.5f ), cosf( fAngle * 0.5f ) );
+}
+
+static bool NearlyEqual( __m128 a, const float* pExpected )
+{
+    float Values[4];
+    _mm_storeu_ps( Values, a );
+    for( UINT c = 0; c < 4; c++ )
+    {
+        if( fabsf( Values[c] - pExpected[c] ) > TEST_TOLERANCE )
+        {
+            fprintf( stderr, "got ( %g, %g, %g, %g ), expected ( %g, %g, %g, %g )\n", Values[0], Values[1], Values[2],
+                     Values[3], pExpected[0], pExpected[1], pExpected[2], pExpected[3] );
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool NearlyEqual( __m128 a, __m128 b )
+{
+    float Expected[4];
+    _mm_storeu_ps( Expected, b );
+    return NearlyEqual( a, Expected );
+}
+
+//--------------------------------------------------------------------------------------
+static void SetSample( SDKMESH_LAYER_SAMPLE* pSample, __m128 Translation, __m128 Rotation, __m128 Scale,
+                       float fWeight )
+{
+    ZeroMemory( pSample, sizeof( SDKMESH_LAYER_SAMPLE ) );
+    pSample->Translation = Translation;
+    pSample->Rotation = Rotation;
+    pSample->Scale = Scale;
+    pSample->fWeight = fWeight;
+}
+
+// A rest pose far from every sample, so any weight it gets shows
+static void SetRest( SDKMESH_FRAME_TRS* pRest )
+{
+    pRest->Translation = D3DXVECTOR3( 100.0f, 200.0f, 300.0f );
+    pRest->Rotation.x = pRest->Rotation.y = pRest->Rotation.z = 0.0f;
+    pRest->Rotation.w = 1.0f;
+    pRest->Scale = D3DXVECTOR3( 10.0f, 10.0f, 10.0f );
+}
+
+//--------------------------------------------------------------------------------------
+// Two override layers whose weights sum to one take nothing from the rest pose; with
+// rotations a quarter turn apart the blend is their weighted NLERP
+//--------------------------------------------------------------------------------------
+static void TestCrossfade()
+{
+    SDKMESH_FRAME_TRS Rest;
+    SetRest( &Rest );
+
+    SDKMESH_LAYER_SAMPLE Samples[2];
+    SetSample( &Samples[0], _mm_setr_ps( 1.0f, 2.0f, 3.0f, 0.0f ), RotationZ( 0.0f ),
+               _mm_setr_ps( 1.0f, 1.0f, 1.0f, 0.0f ), 0.25f );
+    SetSample( &Samples[1], _mm_setr_ps( 5.0f, -2.0f, 7.0f, 0.0f ), RotationZ( 1.5707963f ),
+               _mm_setr_ps( 2.0f, 3.0f, 5.0f, 0.0f ), 0.75f );
+
+    __m128 Translation, Rotation, Scale;
+    SDKMeshBlendLayerSamples( Samples, 2, &Rest, &Translation, &Rotation, &Scale );
+
+    const float ExpectedTranslation[4] = { 4.0f, -1.0f, 6.0f, 0.0f };
+    const float ExpectedScale[4] = { 1.75f, 2.5f, 4.0f, 0.0f };
+    float q[4] = { 0.0f, 0.0f, 0.75f * sinf( 0.7853982f ), 0.25f + 0.75f * cosf( 0.7853982f ) };
+    NormalizeQuaternionScalar( q );
+    TEST_CHECK( NearlyEqual( Translation, ExpectedTranslation ) );
+    TEST_CHECK( NearlyEqual( Rotation, q ) );
+    TEST_CHECK( NearlyEqual( Scale, ExpectedScale ) );
+
+    // The same rotation stored as -q blends the short way round all the same
+    Samples[1].Rotation = _mm_xor_ps( Samples[1].Rotation, _mm_set1_ps( -0.0f ) );
+    SDKMeshBlendLayerSamples( Samples, 2, &Rest, &Translation, &Rotation, &Scale );
+    TEST_CHECK( NearlyEqual( Rotation, q ) );
+
+    // Weights over one are averaged
+    Samples[0].fWeight = 1.0f;
+    Samples[1].fWeight = 3.0f;
+    SDKMeshBlendLayerSamples( Samples, 2, &Rest, &Translation, &Rotation, &Scale );
+    TEST_CHECK( NearlyEqual( Translation, ExpectedTranslation ) );
+    TEST_CHECK( NearlyEqual( Scale, ExpectedScale ) );
+}
+
+//--------------------------------------------------------------------------------------
+// One override layer at a quarter weight leaves the other three quarters to the rest
+// pose
+//--------------------------------------------------------------------------------------
+static void TestPartialWeight()
+{
+    SDKMESH_FRAME_TRS Rest;
+    SetRest( &Rest );
+
+    SDKMESH_LAYER_SAMPLE Sample;
+    SetSample( &Sample, _mm_setr_ps( 4.0f, 8.0f, -4.0f, 0.0f ), RotationZ( 1.0f ), _mm_setr_ps( 2.0f, 2.0f, 2.0f, 0.0f ),
+               0.25f );
+
+    __m128 Translation, Rotation, Scale;
+    SDKMeshBlendLayerSamples( &Sample, 1, &Rest, &Translation, &Rotation, &Scale );
+
+    const float ExpectedTranslation[4] = { 76.0f, 152.0f, 224.0f, 0.0f };
+    const float ExpectedScale[4] = { 8.0f, 8.0f, 8.0f, 0.0f };
+    float q[4] = { 0.0f, 0.0f, 0.25f * sinf( 0.5f ), 0.75f + 0.25f * cosf( 0.5f ) };
+    NormalizeQuaternionScalar( q );
+    TEST_CHECK( NearlyEqual( Translation, ExpectedTranslation ) );
+    TEST_CHECK( NearlyEqual( Rotation, q ) );
+    TEST_CHECK( NearlyEqual( Scale, ExpectedScale ) );
+}
+
+//--------------------------------------------------------------------------------------
+// An additive layer sampled at key 0 is its own reference and changes nothing. One
+// that has moved adds its translation offset, rotates by its rotation offset and
+// multiplies by its scale ratio, each partway at a partial weight.
+//--------------------------------------------------------------------------------------
+static void TestAdditive()
+{
+    SDKMESH_FRAME_TRS Rest;
+    SetRest( &Rest );
+
+    SDKMESH_LAYER_SAMPLE Samples[2];
+    SetSample( &Samples[0], _mm_setr_ps( 1.0f, 2.0f, 3.0f, 0.0f ), RotationZ( 0.5f ),
+               _mm_setr_ps( 2.0f, 2.0f, 2.0f, 0.0f ), 1.0f );
+
+    __m128 BaseTranslation, BaseRotation, BaseScale;
+    SDKMeshBlendLayerSamples( Samples, 1, &Rest, &BaseTranslation, &BaseRotation, &BaseScale );
+
+    // At key 0
+    SetSample( &Samples[1], _mm_setr_ps( -3.0f, 4.0f, 0.5f, 0.0f ), _mm_setr_ps( 0.5f, -0.5f, 0.5f, 0.5f ),
+               _mm_setr_ps( 1.5f, 0.5f, 3.0f, 0.0f ), 1.0f );
+    Samples[1].RefTranslation = Samples[1].Translation;
+    Samples[1].RefRotation = Samples[1].Rotation;
+    Samples[1].RefScale = Samples[1].Scale;
+    Samples[1].bAdditive = true;
+
+    __m128 Translation, Rotation, Scale;
+    SDKMeshBlendLayerSamples( Samples, 2, &Rest, &Translation, &Rotation, &Scale );
+    TEST_CHECK( NearlyEqual( Translation, BaseTranslation ) );
+    TEST_CHECK( NearlyEqual( Rotation, BaseRotation ) );
+    TEST_CHECK( NearlyEqual( Scale, BaseScale ) );
+
+    // Moved a third of a turn about z from a sixth of a turn, at half weight: half the
+    // offset, a twelfth of a turn, and half way from no scaling to the scale ratio
+    Samples[1].RefTranslation = _mm_setr_ps( -1.0f, 4.0f, 2.5f, 0.0f );
+    Samples[1].RefRotation = RotationZ( 1.0471976f );
+    Samples[1].Rotation = RotationZ( 2.0943951f );
+    Samples[1].RefScale = _mm_setr_ps( 0.5f, 0.5f, 1.5f, 0.0f );
+    Samples[1].fWeight = 0.5f;
+    SDKMeshBlendLayerSamples( Samples, 2, &Rest, &Translation, &Rotation, &Scale );
+
+    const float ExpectedTranslation[4] = { 0.0f, 2.0f, 2.0f, 0.0f };
+    const float ExpectedScale[4] = { 2.0f * 2.0f, 2.0f, 2.0f * 1.5f, 0.0f };
+    TEST_CHECK( NearlyEqual( Translation, ExpectedTranslation ) );
+    TEST_CHECK( NearlyEqual( Rotation, RotationZ( 0.5f + 0.5235988f ) ) );
+    TEST_CHECK( NearlyEqual( Scale, ExpectedScale ) );
+}
+
+//--------------------------------------------------------------------------------------
+static void TestMultiply()
+{
+    UINT Seed = 3;
+    for( UINT i = 0; i < 100; i++ )
+    {
+        __m128 a = RandomQuaternion( &Seed );
+        __m128 b = RandomQuaternion( &Seed );
+        float A[4], B[4], Expected[4];
+        _mm_storeu_ps( A, a );
+        _mm_storeu_ps( B, b );
+        MultiplyQuaternionScalar( A, B, Expected );
+        TEST_CHECK( NearlyEqual( MultiplyQuaternion( a, b ), Expected ) );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestCrossfade();
+    TestPartialWeight();
+    TestAdditive();
+    TestMultiply();
+
+    SDKMESH_BLEND_BENCHMARK Results;
+    TEST_CHECK( SDKMeshBenchmarkBlending( 10000, 6, &Results ) == S_OK );
+
+    return TestResult();
+}
@@ -0,0 +1,269 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshBVH.cpp
+//
+// Builds a hierarchy through SDKmeshBVH.cpp over more triangles than one build task
+// takes, casts random rays through it one and four at a time, and checks each against
+// a brute-force test of every triangle. Then checks that reading rejects node layouts
+// that aren't trees.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestD3DX.h"
+#include "TestCommon.h"
+#include "../SDKmeshBVH.h"
+#include "../SDKmeshBVH.cpp"
+
+#define TEST_NUM_TRIANGLES  ( BVH_TASK_TRIANGLES + 4000 )
+#define TEST_NUM_RAYS       4000
+
+//--------------------------------------------------------------------------------------
+static float Random( UINT* pSeed, float fMin, float fMax )
+{
+    *pSeed = *pSeed * 1664525 + 1013904223;
+    return fMin + ( fMax - fMin ) * ( float )( *pSeed >> 8 ) / ( float )( 1 << 24 );
+}
+
+//--------------------------------------------------------------------------------------
+// Small triangles scattered through a cube, with every 500th one large enough to cross
+// many of the others' boxes
+//--------------------------------------------------------------------------------------
+static void MakeTriangles( SDKMESH_BVH_TRIANGLE* pTriangles, UINT NumTriangles )
+{
+    UINT Seed = 1;
+    for( UINT t = 0; t < NumTriangles; t++ )
+    {
+        float Size = ( t % 500 == 0 ) ? 1.0f : 0.05f;
+        float Center[3], V[3][3];
+        for( UINT c = 0; c < 3; c++ )
+            Center[c] = Random( &Seed, -1.0f, 1.0f );
+        for( UINT i = 0; i < 3; i++ )
+        {
+            for( UINT c = 0; c < 3; c++ )
+                V[i][c] = Center[c] + Random( &Seed, -Size, Size );
+        }
+        SDKMeshSetBVHTriangle( &pTriangles[t], V[0], V[1], V[2], t % 7, t );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// The closest hit over every triangle, by the same test the hierarchy runs at its leaves
+//--------------------------------------------------------------------------------------
+static UINT BruteForce( const SDKMESH_BVH_TRIANGLE* pTriangles, UINT NumTriangles, const float* pOrigin,
+                        const float* pDirection, float MaxDistance, float* pDistance )
+{
+    UINT iHit = SDKMESH_BVH_MISS;
+    float Best = MaxDistance;
+    for( UINT t = 0; t < NumTriangles; t++ )
+    {
+        float Distance, u, v;
+        if( RayTriangle( &pTriangles[t], pOrigin, pDirection, Best, &Distance, &u, &v ) )
+        {
+            Best = Distance;
+            iHit = t;
+        }
+    }
+    *pDistance = Best;
+    return iHit;
+}
+
+//--------------------------------------------------------------------------------------
+// A hit the hierarchy reported has to be one the triangle test agrees with
+//--------------------------------------------------------------------------------------
+static bool IsHit( const SDKMESH_BVH_TRIANGLE* pTriangles, UINT NumTriangles, const float* pOrigin,
+                   const float* pDirection, float MaxDistance, const SDKMESH_RAY_HIT* pHit )
+{
+    if( pHit->iTriangle >= NumTriangles || pHit->iSubset != pHit->iTriangle % 7 )
+        return false;
+
+    float Distance, u, v;
+    return RayTriangle( &pTriangles[pHit->iTriangle], pOrigin, pDirection, MaxDistance, &Distance, &u, &v ) &&
+           fabsf( Distance - pHit->Distance ) <= 1e-5f * max( 1.0f, Distance );
+}
+
+//--------------------------------------------------------------------------------------
+static void TestRays()
+{
+    SDKMESH_BVH_TRIANGLE* pTriangles = new SDKMESH_BVH_TRIANGLE[ TEST_NUM_TRIANGLES ];
+    MakeTriangles( pTriangles, TEST_NUM_TRIANGLES );
+
+    SDKMESH_BVH Built;
+    TEST_CHECK( SDKMeshBuildBVH( pTriangles, TEST_NUM_TRIANGLES, &Built ) == S_OK );
+    TEST_CHECK( Built.NumTriangles == TEST_NUM_TRIANGLES && Built.NumNodes < TEST_NUM_TRIANGLES * 2 );
+
+    // Traverse what was read back, which also has to pass validation
+    UINT64 Size = SDKMeshGetBVHSize( &Built );
+    BYTE* pFile = new BYTE[ ( SIZE_T )Size ];
+    SDKMeshWriteBVH( &Built, pFile );
+    SDKMESH_BVH BVH;
+    UINT64 BytesRead = 0;
+    TEST_CHECK( SDKMeshReadBVH( pFile, Size, &BVH, &BytesRead ) == S_OK && BytesRead == Size );
+    TEST_CHECK( BVH.NumNodes == Built.NumNodes &&
+                memcmp( BVH.pNodes, Built.pNodes, sizeof( SDKMESH_BVH_NODE ) * BVH.NumNodes ) == 0 );
+    SDKMeshDestroyBVH( &Built );
+    delete []pFile;
+
+    UINT Seed = 7;
+    UINT NumHits = 0, NumMismatches = 0;
+    for( UINT r = 0; r < TEST_NUM_RAYS; r += 4 )
+    {
+        float Origins[4][3], Directions[4][3], MaxDistances[4];
+        float Expected[4];
+        UINT iExpected[4];
+        for( UINT l = 0; l < 4; l++ )
+        {
+            for( UINT c = 0; c < 3; c++ )
+            {
+                Origins[l][c] = Random( &Seed, -1.5f, 1.5f );
+                Directions[l][c] = Random( &Seed, -1.0f, 1.0f );
+            }
+
+            // Half the rays stop short, which has to cut off hits past them
+            MaxDistances[l] = ( ( r / 4 + l ) % 2 ) ? Random( &Seed, 0.1f, 2.0f ) : FLT_MAX;
+            iExpected[l] = BruteForce( pTriangles, TEST_NUM_TRIANGLES, Origins[l], Directions[l], MaxDistances[l],
+                                       &Expected[l] );
+            NumHits += ( iExpected[l] != SDKMESH_BVH_MISS ) ? 1 : 0;
+
+            D3DXVECTOR3 Origin( Origins[l][0], Origins[l][1], Origins[l][2] );
+            D3DXVECTOR3 Direction( Directions[l][0], Directions[l][1], Directions[l][2] );
+
+            // The closest hit is the brute-force one, or a tie with it
+            SDKMESH_RAY_HIT Hit;
+            bool bHit = SDKMeshIntersectBVH( &BVH, &Origin, &Direction, MaxDistances[l], false, &Hit );
+            bool bMatch = bHit == ( iExpected[l] != SDKMESH_BVH_MISS );
+            if( bHit && bMatch )
+                bMatch = IsHit( pTriangles, TEST_NUM_TRIANGLES, Origins[l], Directions[l], MaxDistances[l], &Hit ) &&
+                         Hit.Distance == Expected[l];
+
+            // Any hit finds something exactly when there is something to find
+            SDKMESH_RAY_HIT AnyHit;
+            bool bAnyHit = SDKMeshIntersectBVH( &BVH, &Origin, &Direction, MaxDistances[l], true, &AnyHit );
+            if( bAnyHit != bHit ||
+                ( bAnyHit && !IsHit( pTriangles, TEST_NUM_TRIANGLES, Origins[l], Directions[l], MaxDistances[l],
+                                     &AnyHit ) ) )
+                bMatch = false;
+
+            if( !bMatch )
+            {
+                fprintf( stderr, "ray %u: hit %d at %g ( triangle %u ), expected %g ( triangle %u )\n", r + l,
+                         bHit, Hit.Distance, Hit.iTriangle, Expected[l], iExpected[l] );
+                NumMismatches++;
+            }
+        }
+
+        SDKMESH_RAY4 Rays;
+        Rays.OriginX = _mm_setr_ps( Origins[0][0], Origins[1][0], Origins[2][0], Origins[3][0] );
+        Rays.OriginY = _mm_setr_ps( Origins[0][1], Origins[1][1], Origins[2][1], Origins[3][1] );
+        Rays.OriginZ = _mm_setr_ps( Origins[0][2], Origins[1][2], Origins[2][2], Origins[3][2] );
+        Rays.DirectionX = _mm_setr_ps( Directions[0][0], Directions[1][0], Directions[2][0], Directions[3][0] );
+        Rays.DirectionY = _mm_setr_ps( Directions[0][1], Directions[1][1], Directions[2][1], Directions[3][1] );
+        Rays.DirectionZ = _mm_setr_ps( Directions[0][2], Directions[1][2], Directions[2][2], Directions[3][2] );
+        Rays.MaxDistance = _mm_loadu_ps( MaxDistances );
+
+        for( UINT a = 0; a < 2; a++ )
+        {
+            SDKMESH_RAY_HIT Hits[4];
+            UINT Mask = SDKMeshIntersectBVH4( &BVH, &Rays, a == 1, Hits );
+            for( UINT l = 0; l < 4; l++ )
+            {
+                bool bHit = ( Mask & ( 1 << l ) ) != 0;
+                bool bMatch = bHit == ( iExpected[l] != SDKMESH_BVH_MISS );
+                if( bHit && bMatch )
+                    bMatch = IsHit( pTriangles, TEST_NUM_TRIANGLES, Origins[l], Directions[l], MaxDistances[l],
+                                    &Hits[l] ) &&
+                             ( a == 1 || fabsf( Hits[l].Distance - Expected[l] ) <= 1e-5f * max( 1.0f, Expected[l] ) );
+                if( !bMatch )
+                {
+                    fprintf( stderr, "ray %u of four, any hit %u: hit %d at %g, expected %g\n", r + l, a, bHit,
+                             Hits[l].Distance, Expected[l] );
+                    NumMismatches++;
+                }
+            }
+        }
+    }
+
+    // Enough of both hits and misses for the comparison to mean something
+    TEST_CHECK( NumHits > TEST_NUM_RAYS / 4 && NumHits < TEST_NUM_RAYS * 3 / 4 );
+    TEST_CHECK( NumMismatches == 0 );
+
+    SDKMeshDestroyBVH( &BVH );
+    delete []pTriangles;
+}
+
+//--------------------------------------------------------------------------------------
+// Writes NumNodes nodes over one triangle and reads them back. Interior nodes get
+// their first child from pChildren, leaves have -1 there.
+//--------------------------------------------------------------------------------------
+static HRESULT ReadNodes( const int* pChildren, UINT NumNodes )
+{
+    SDKMESH_BVH_NODE Nodes[256];
+    for( UINT i = 0; i < NumNodes; i++ )
+    {
+        for( UINT a = 0; a < 3; a++ )
+        {
+            Nodes[i].Min[a] = -1.0f;
+            Nodes[i].Max[a] = 1.0f;
+        }
+        Nodes[i].Index = pChildren[i] < 0 ? 0 : ( UINT )pChildren[i];
+        Nodes[i].Count = pChildren[i] < 0 ? 1 : 0;
+    }
+
+    const float V[3][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+    SDKMESH_BVH_TRIANGLE Triangle;
+    SDKMeshSetBVHTriangle( &Triangle, V[0], V[1], V[2], 0, 0 );
+
+    SDKMESH_BVH Source = { Nodes, NumNodes, &Triangle, 1 };
+    BYTE File[sizeof( BVH_FILE_HEADER ) + sizeof( Nodes ) + sizeof( SDKMESH_BVH_TRIANGLE )];
+    UINT64 Size = SDKMeshGetBVHSize( &Source );
+    SDKMeshWriteBVH( &Source, File );
+
+    SDKMESH_BVH BVH;
+    HRESULT hr = SDKMeshReadBVH( File, Size, &BVH, NULL );
+    SDKMeshDestroyBVH( &BVH );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+static void TestValidation()
+{
+    // 0 -> ( 1, 2 ), 1 -> ( 3, 4 )
+    const int Tree[] = { 1, 3, -1, -1, -1 };
+    TEST_CHECK( ReadNodes( Tree, 5 ) == S_OK );
+
+    // 1 and 2 share their children, which traversal would visit twice
+    const int Shared[] = { 1, 3, 3, -1, -1 };
+    TEST_CHECK( ReadNodes( Shared, 5 ) == E_FAIL );
+
+    // 0 and 1 both claim 2
+    const int TwoParents[] = { 1, 2, -1, -1 };
+    TEST_CHECK( ReadNodes( TwoParents, 4 ) == E_FAIL );
+
+    // Nothing points at 3 and 4
+    const int Orphans[] = { 1, -1, -1, -1, -1 };
+    TEST_CHECK( ReadNodes( Orphans, 5 ) == E_FAIL );
+
+    // A node pointing back at the root, and a node that is its own child
+    const int Backwards[] = { 1, -1, 0 };
+    TEST_CHECK( ReadNodes( Backwards, 3 ) == E_FAIL );
+    const int Self[] = { 0, -1 };
+    TEST_CHECK( ReadNodes( Self, 2 ) == E_FAIL );
+
+    // A chain with a leaf hanging off each link is a tree, but deeper than the
+    // traversal stacks once it passes BVH_STACK_SIZE links
+    int Chain[255];
+    for( UINT Links = BVH_STACK_SIZE - 1; Links <= BVH_STACK_SIZE; Links++ )
+    {
+        UINT NumNodes = Links * 2 + 1;
+        for( UINT i = 0; i < NumNodes; i++ )
+            Chain[i] = ( i % 2 == 0 && i + 1 < NumNodes ) ? ( int )i + 1 : -1;
+        TEST_CHECK( ReadNodes( Chain, NumNodes ) == ( Links < BVH_STACK_SIZE ? S_OK : E_FAIL ) );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestRays();
+    TestValidation();
+
+    return TestResult();
+}
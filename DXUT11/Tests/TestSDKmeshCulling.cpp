@@ -0,0 +1,199 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshCulling.cpp
+//
+// Checks the SSE box culling in SDKmeshCulling.cpp against a plain one-box-at-a-time
+// plane test, for boxes inside, outside and straddling each frustum plane
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestWindows.h"
+#include "TestCommon.h"
+#include "../SDKmeshCulling.cpp"
+
+//--------------------------------------------------------------------------------------
+// Reference test in double precision. Returns 1 for visible, 0 for culled and -1 when
+// the box is within Epsilon of a plane, where float rounding may go either way.
+//--------------------------------------------------------------------------------------
+static int ReferenceVisible( const SDKMESH_FRUSTUM* pFrustum, const float* pCenter, const float* pExtents,
+                             double Epsilon )
+{
+    int Result = 1;
+    for( UINT p = 0; p < 6; p++ )
+    {
+        const float* pPlane = pFrustum->Planes[p];
+        double Dist = ( double )pPlane[3];
+        double Radius = 0.0;
+        for( UINT j = 0; j < 3; j++ )
+        {
+            Dist += ( double )pPlane[j] * pCenter[j];
+            Radius += fabs( ( double )pPlane[j] ) * pExtents[j];
+        }
+
+        double Side = Dist + Radius;
+        if( Side < -Epsilon )
+            return 0;
+        if( Side < Epsilon )
+            Result = -1;
+    }
+    return Result;
+}
+
+//--------------------------------------------------------------------------------------
+// Culls the boxes and compares every bit and the count with the reference
+//--------------------------------------------------------------------------------------
+static void CheckAgainstReference( const SDKMESH_FRUSTUM* pFrustum, const SDKMESH_CULL_BOXES* pBoxes,
+                                   const int* pExpected )
+{
+    UINT NumDwords = SDKMESH_CULL_MASK_DWORDS( pBoxes->NumBoxes );
+    DWORD* pBits = new DWORD[NumDwords + 1];
+    pBits[NumDwords] = 0xdeadbeef;
+    UINT NumVisible = SDKMeshCullBoxes( pFrustum, pBoxes, pBits );
+    TEST_CHECK( pBits[NumDwords] == 0xdeadbeef );
+
+    UINT NumSetBits = 0;
+    for( UINT i = 0; i < NumDwords * 32; i++ )
+    {
+        bool bVisible = SDKMeshIsBoxVisible( pBits, i );
+        if( bVisible )
+            NumSetBits++;
+        if( i >= pBoxes->NumBoxes )
+            TEST_CHECK( !bVisible );
+        else if( pExpected[i] >= 0 && bVisible != ( pExpected[i] == 1 ) )
+        {
+            fprintf( stderr, "box %u: culled %d, expected %d\n", i, !bVisible, pExpected[i] == 0 );
+            g_NumTestFailures++;
+        }
+    }
+    TEST_CHECK( NumVisible == NumSetBits );
+
+    delete[] pBits;
+}
+
+//--------------------------------------------------------------------------------------
+// The identity matrix gives the frustum -1 <= x <= 1, -1 <= y <= 1, 0 <= z <= 1. For
+// each plane there is a box well outside it, one straddling it and one just touching
+// it from outside, which counts as visible.
+//--------------------------------------------------------------------------------------
+static void TestPlanes()
+{
+    const float Identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    SDKMESH_FRUSTUM Frustum;
+    SDKMeshExtractFrustum( Identity, &Frustum );
+
+    // Center of the frustum and, per plane, the axis and the side it is on
+    const float Mid[3] = { 0.0f, 0.0f, 0.5f };
+    const UINT Axis[6] = { 0, 0, 1, 1, 2, 2 };
+    const float Bound[6] = { -1.0f, 1.0f, -1.0f, 1.0f, 0.0f, 1.0f };
+    const float Out[6] = { -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f };
+
+    const UINT NumBoxes = 2 + 6 * 3;
+    SDKMESH_CULL_BOXES Boxes;
+    TEST_CHECK( SDKMeshCreateCullBoxes( NumBoxes, &Boxes ) == S_OK );
+    int Expected[NumBoxes];
+
+    // Fully inside, and one enclosing the whole frustum
+    const float Small[3] = { 0.25f, 0.25f, 0.25f };
+    const float Huge[3] = { 10.0f, 10.0f, 10.0f };
+    SDKMeshSetCullBox( &Boxes, 0, Mid, Small );
+    SDKMeshSetCullBox( &Boxes, 1, Mid, Huge );
+    Expected[0] = Expected[1] = 1;
+
+    const float Extents[3] = { 0.25f, 0.25f, 0.25f };
+    for( UINT p = 0; p < 6; p++ )
+    {
+        float Center[3] = { Mid[0], Mid[1], Mid[2] };
+        UINT iBox = 2 + p * 3;
+
+        Center[Axis[p]] = Bound[p] + Out[p] * 2.0f;
+        SDKMeshSetCullBox( &Boxes, iBox, Center, Extents );
+        Expected[iBox] = 0;
+
+        Center[Axis[p]] = Bound[p] + Out[p] * 0.125f;
+        SDKMeshSetCullBox( &Boxes, iBox + 1, Center, Extents );
+        Expected[iBox + 1] = 1;
+
+        Center[Axis[p]] = Bound[p] + Out[p] * 0.25f;
+        SDKMeshSetCullBox( &Boxes, iBox + 2, Center, Extents );
+        Expected[iBox + 2] = 1;
+    }
+
+    for( UINT i = 0; i < NumBoxes; i++ )
+    {
+        float Center[3] = { Boxes.pCenterX[i], Boxes.pCenterY[i], Boxes.pCenterZ[i] };
+        float BoxExtents[3] = { Boxes.pExtentX[i], Boxes.pExtentY[i], Boxes.pExtentZ[i] };
+        TEST_CHECK( ReferenceVisible( &Frustum, Center, BoxExtents, 0.0 ) == Expected[i] );
+    }
+    CheckAgainstReference( &Frustum, &Boxes, Expected );
+
+    SDKMeshDestroyCullBoxes( &Boxes );
+}
+
+//--------------------------------------------------------------------------------------
+// Random boxes against a perspective frustum looking down a tilted axis, with a count
+// that leaves a partial group of four and a partial mask DWORD
+//--------------------------------------------------------------------------------------
+static void TestRandomBoxes()
+{
+    const UINT NumBoxes = 4099;
+    SDKMESH_CULL_BOXES Boxes;
+    TEST_CHECK( SDKMeshCreateCullBoxes( NumBoxes, &Boxes ) == S_OK );
+
+    // Left handed perspective, 60 degree field of view, near 0.1, far 100, after a
+    // rotation of 30 degrees about y
+    float YScale = 1.0f / tanf( 3.14159265f / 6.0f );
+    float XScale = YScale / 1.5f;
+    float Far = 100.0f, Near = 0.1f;
+    float Q = Far / ( Far - Near );
+    float c = cosf( 3.14159265f / 6.0f ), s = sinf( 3.14159265f / 6.0f );
+    float ViewProj[16] =
+    {
+        c * XScale, 0, -s * Q, -s,
+        0, YScale, 0, 0,
+        s * XScale, 0, c * Q, c,
+        0, 0, -Near * Q, 0
+    };
+    SDKMESH_FRUSTUM Frustum;
+    SDKMeshExtractFrustum( ViewProj, &Frustum );
+
+    int* pExpected = new int[NumBoxes];
+    UINT NumVisible = 0, NumCulled = 0;
+    DWORD Seed = 4711;
+    for( UINT i = 0; i < NumBoxes; i++ )
+    {
+        float Values[6];
+        for( UINT j = 0; j < 6; j++ )
+        {
+            Seed = Seed * 1664525 + 1013904223;
+            Values[j] = ( float )( Seed >> 8 ) / ( float )( 1 << 24 );
+        }
+        float Center[3] = { Values[0] * 160.0f - 80.0f, Values[1] * 160.0f - 80.0f, Values[2] * 160.0f - 80.0f };
+        float Extents[3] = { Values[3] * 4.0f, Values[4] * 4.0f, Values[5] * 4.0f };
+        SDKMeshSetCullBox( &Boxes, i, Center, Extents );
+
+        pExpected[i] = ReferenceVisible( &Frustum, Center, Extents, 1e-3 );
+        if( pExpected[i] == 1 )
+            NumVisible++;
+        else if( pExpected[i] == 0 )
+            NumCulled++;
+    }
+
+    // Both outcomes have to be well represented for the comparison to mean anything
+    TEST_CHECK( NumVisible > NumBoxes / 20 && NumCulled > NumBoxes / 2 );
+    CheckAgainstReference( &Frustum, &Boxes, pExpected );
+
+    delete[] pExpected;
+    SDKMeshDestroyCullBoxes( &Boxes );
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestPlanes();
+    TestRandomBoxes();
+
+    // The library's own self check over the same kind of data
+    SDKMESH_CULL_BENCHMARK Results;
+    TEST_CHECK( SDKMeshBenchmarkCulling( 1001, &Results ) == S_OK );
+
+    return TestResult();
+}
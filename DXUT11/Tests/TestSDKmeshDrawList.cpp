@@ -0,0 +1,208 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshDrawList.cpp
+//
+// Builds draw lists from hand made records and checks the command stream that
+// SDKmeshDrawList.cpp emits: state changes, merged index ranges, no merging across
+// strips, and sort keys that keep LODs and the adjacency buffer apart
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestWindows.h"
+#include "TestCommon.h"
+
+// SDKmeshDrawList.cpp only needs the draw list declarations from SDKMesh.h
+#define _SDKMESH_
+#include "../SDKmeshDrawList.h"
+#include "../SDKmeshDrawList.cpp"
+
+#define TRIANGLELIST D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+
+//--------------------------------------------------------------------------------------
+static void AddRecord( SDKMESH_DRAW_LIST* pList, UINT iMesh, UINT iLOD, UINT iMaterial, UINT Topology,
+                       UINT IndexStart, UINT IndexCount, UINT VertexStart )
+{
+    SDKMESH_DRAW_RECORD Record;
+    ZeroMemory( &Record, sizeof( SDKMESH_DRAW_RECORD ) );
+    Record.iMesh = iMesh;
+    Record.iLOD = iLOD;
+    Record.iMaterial = iMaterial;
+    Record.Topology = Topology;
+    Record.IndexStart = IndexStart;
+    Record.IndexCount = IndexCount;
+    Record.VertexStart = VertexStart;
+    TEST_CHECK( SDKMeshAddDrawRecord( pList, &Record ) == S_OK );
+}
+
+//--------------------------------------------------------------------------------------
+static void CheckCommands( const SDKMESH_DRAW_LIST* pList, const SDKMESH_DRAW_COMMAND* pExpected,
+                           UINT NumExpected, int Line )
+{
+    bool bMatch = ( pList->NumCommands == NumExpected );
+    for( UINT i = 0; i < NumExpected && bMatch; i++ )
+        bMatch = ( memcmp( &pList->pCommands[i], &pExpected[i], sizeof( SDKMESH_DRAW_COMMAND ) ) == 0 );
+    if( bMatch )
+        return;
+
+    fprintf( stderr, "%s(%d): command stream differs, got:\n", __FILE__, Line );
+    for( UINT i = 0; i < pList->NumCommands; i++ )
+    {
+        const SDKMESH_DRAW_COMMAND* pCommand = &pList->pCommands[i];
+        fprintf( stderr, "  %u: %u %u %u\n", pCommand->Op, pCommand->Args[0], pCommand->Args[1], pCommand->Args[2] );
+    }
+    g_NumTestFailures++;
+}
+
+//--------------------------------------------------------------------------------------
+// Records added out of order are grouped by material, then buffers. Contiguous ranges
+// merge, but not across a state change or a different VertexStart.
+//--------------------------------------------------------------------------------------
+static void TestSortAndMerge()
+{
+    SDKMESH_DRAW_LIST List;
+    TEST_CHECK( SDKMeshCreateDrawList( 0, &List ) == S_OK );
+
+    AddRecord( &List, 1, 0, 2, TRIANGLELIST, 0, 30, 0 );
+    AddRecord( &List, 0, 0, 1, TRIANGLELIST, 0, 6, 0 );
+    AddRecord( &List, 1, 0, 2, TRIANGLELIST, 30, 12, 0 );
+    AddRecord( &List, 0, 0, 1, TRIANGLELIST, 6, 3, 0 );
+    AddRecord( &List, 0, 0, 1, TRIANGLELIST, 9, 3, 5 );
+    AddRecord( &List, 1, 0, 1, TRIANGLELIST, 100, 3, 0 );
+    AddRecord( &List, 1, 0, 1, TRIANGLELIST, 103, 0, 0 );
+    TEST_CHECK( SDKMeshBuildDrawCommands( &List ) == S_OK );
+
+    const SDKMESH_DRAW_COMMAND Expected[] =
+    {
+        { SDKMESH_DRAW_SET_BUFFERS, { 0, 0, 0 } },
+        { SDKMESH_DRAW_SET_TOPOLOGY, { TRIANGLELIST, 0, 0 } },
+        { SDKMESH_DRAW_SET_MATERIAL, { 1, 0, 0 } },
+        { SDKMESH_DRAW_INDEXED, { 9, 0, 0 } },
+        { SDKMESH_DRAW_INDEXED, { 3, 9, 5 } },
+        { SDKMESH_DRAW_SET_BUFFERS, { 1, 0, 0 } },
+        { SDKMESH_DRAW_INDEXED, { 3, 100, 0 } },
+        { SDKMESH_DRAW_SET_MATERIAL, { 2, 0, 0 } },
+        { SDKMESH_DRAW_INDEXED, { 42, 0, 0 } },
+    };
+    CheckCommands( &List, Expected, sizeof( Expected ) / sizeof( Expected[0] ), __LINE__ );
+
+    const SDKMESH_DRAW_LIST_STATS* pStats = &List.Stats;
+    TEST_CHECK( pStats->NumRecords == 7 );
+    TEST_CHECK( pStats->NumDraws == 4 );
+    TEST_CHECK( pStats->NumBufferChanges == 2 );
+    TEST_CHECK( pStats->NumTopologyChanges == 1 );
+    TEST_CHECK( pStats->NumMaterialChanges == 2 );
+    TEST_CHECK( pStats->NumUnsortedBufferChanges == 5 );
+    TEST_CHECK( pStats->NumUnsortedTopologyChanges == 7 );
+    TEST_CHECK( pStats->NumUnsortedMaterialChanges == 7 );
+
+    // Reset keeps the memory and starts over
+    SDKMeshResetDrawList( &List );
+    TEST_CHECK( List.NumRecords == 0 && List.NumCommands == 0 && List.pRecords != NULL );
+    TEST_CHECK( SDKMeshBuildDrawCommands( &List ) == S_OK && List.NumCommands == 0 );
+
+    SDKMeshDestroyDrawList( &List );
+}
+
+//--------------------------------------------------------------------------------------
+// Two contiguous draws of each topology: list draws become one, strip draws don't
+//--------------------------------------------------------------------------------------
+static void TestStripsDontMerge()
+{
+    const struct
+    {
+        UINT Topology;
+        bool bMerges;
+    } Cases[] =
+    {
+        { D3D11_PRIMITIVE_TOPOLOGY_POINTLIST, true },
+        { D3D11_PRIMITIVE_TOPOLOGY_LINELIST, true },
+        { D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP, false },
+        { D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, true },
+        { D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, false },
+        { D3D11_PRIMITIVE_TOPOLOGY_LINELIST_ADJ, true },
+        { D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP_ADJ, false },
+        { D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST_ADJ, true },
+        { D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP_ADJ, false },
+        { D3D11_PRIMITIVE_TOPOLOGY_1_CONTROL_POINT_PATCHLIST + 2, true },
+    };
+
+    SDKMESH_DRAW_LIST List;
+    TEST_CHECK( SDKMeshCreateDrawList( 4, &List ) == S_OK );
+    for( UINT i = 0; i < sizeof( Cases ) / sizeof( Cases[0] ); i++ )
+    {
+        SDKMeshResetDrawList( &List );
+        AddRecord( &List, 0, 0, 0, Cases[i].Topology, 0, 12, 0 );
+        AddRecord( &List, 0, 0, 0, Cases[i].Topology, 12, 12, 0 );
+        TEST_CHECK( SDKMeshBuildDrawCommands( &List ) == S_OK );
+
+        UINT NumDraws = Cases[i].bMerges ? 1 : 2;
+        if( List.Stats.NumDraws != NumDraws || List.NumCommands != 3 + NumDraws )
+        {
+            fprintf( stderr, "topology %u: %u draws, expected %u\n", Cases[i].Topology, List.Stats.NumDraws,
+                     NumDraws );
+            g_NumTestFailures++;
+            continue;
+        }
+        TEST_CHECK( List.pCommands[3].Op == SDKMESH_DRAW_INDEXED );
+        TEST_CHECK( List.pCommands[3].Args[0] == ( Cases[i].bMerges ? 24u : 12u ) );
+    }
+
+    // A strip followed by a list on the same range still isn't merged into the strip
+    SDKMeshResetDrawList( &List );
+    AddRecord( &List, 0, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, 0, 12, 0 );
+    AddRecord( &List, 0, 0, 0, TRIANGLELIST, 12, 12, 0 );
+    TEST_CHECK( SDKMeshBuildDrawCommands( &List ) == S_OK );
+    TEST_CHECK( List.Stats.NumDraws == 2 && List.Stats.NumTopologyChanges == 2 );
+
+    SDKMeshDestroyDrawList( &List );
+}
+
+//--------------------------------------------------------------------------------------
+// LODs past 15 and the adjacency buffer each get their own key, so records using them
+// are grouped instead of interleaved. Also grows the list past its starting size.
+//--------------------------------------------------------------------------------------
+static void TestLODKeys()
+{
+    const UINT LODs[] = { 15, SDKMESH_DRAW_ADJACENCY, 15, 20, SDKMESH_DRAW_ADJACENCY, 20, 15, 16 };
+    const UINT NumLODs = sizeof( LODs ) / sizeof( LODs[0] );
+
+    SDKMESH_DRAW_LIST List;
+    TEST_CHECK( SDKMeshCreateDrawList( 0, &List ) == S_OK );
+    for( UINT Repeat = 0; Repeat < 8; Repeat++ )
+    {
+        for( UINT i = 0; i < NumLODs; i++ )
+            AddRecord( &List, 3, LODs[i], 0, TRIANGLELIST, ( Repeat * NumLODs + i ) * 300, 3, 0 );
+    }
+    TEST_CHECK( List.NumRecords == 8 * NumLODs && List.MaxRecords >= List.NumRecords );
+    TEST_CHECK( SDKMeshBuildDrawCommands( &List ) == S_OK );
+
+    for( UINT i = 0; i < NumLODs; i++ )
+    {
+        for( UINT j = 0; j < NumLODs; j++ )
+            TEST_CHECK( ( List.pRecords[i].Key == List.pRecords[j].Key ) == ( LODs[i] == LODs[j] ) );
+    }
+
+    // One buffer change per distinct LOD, in LOD order with adjacency last
+    const UINT Order[] = { 15, 16, 20, SDKMESH_DRAW_ADJACENCY };
+    UINT NumBufferChanges = 0;
+    for( UINT i = 0; i < List.NumCommands; i++ )
+    {
+        const SDKMESH_DRAW_COMMAND* pCommand = &List.pCommands[i];
+        if( pCommand->Op != SDKMESH_DRAW_SET_BUFFERS )
+            continue;
+        TEST_CHECK( NumBufferChanges < 4 && pCommand->Args[0] == 3 && pCommand->Args[1] == Order[NumBufferChanges] );
+        NumBufferChanges++;
+    }
+    TEST_CHECK( NumBufferChanges == 4 && List.Stats.NumBufferChanges == 4 );
+
+    SDKMeshDestroyDrawList( &List );
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestSortAndMerge();
+    TestStripsDontMerge();
+    TestLODKeys();
+
+    return TestResult();
+}
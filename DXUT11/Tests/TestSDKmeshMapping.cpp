@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshMapping.cpp
+//
+// Checks the POSIX backend of SDKmeshMapping.h: a view shows the file, writes to it
+// stay private, and released pages read back from the file while the partial pages at
+// either end of a released range are kept
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "../SDKmeshMapping.h"
+#include "TestCommon.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE_BYTES ( 1 << 20 )
+
+static BYTE TestByte( size_t i )
+{
+    return ( BYTE )( ( i * 7 + ( i >> 12 ) ) & 0xff );
+}
+
+//--------------------------------------------------------------------------------------
+// Writes are private to the view, so a page that has lost its writes was released and a
+// page that still has them wasn't. pView must be at least 16 pages.
+//--------------------------------------------------------------------------------------
+static void TestReleaseRounding( BYTE* pView, const BYTE* pExpected )
+{
+    size_t PageSize = ( size_t )sysconf( _SC_PAGESIZE );
+
+    // Only the whole pages 9 to 11 of [ 8 pages + 100, 12 pages + 200 ) are released;
+    // the part pages 8 and 12 keep their writes, before and inside the range alike
+    memset( pView + 8 * PageSize, 0xab, 5 * PageSize );
+    SDKMeshReleaseFileViewPages( pView + 8 * PageSize + 100, 4 * PageSize + 100 );
+    TEST_CHECK( pView[8 * PageSize] == 0xab && pView[8 * PageSize + 100] == 0xab );
+    TEST_CHECK( pView[9 * PageSize - 1] == 0xab );
+    TEST_CHECK( memcmp( pView + 9 * PageSize, pExpected + 9 * PageSize, 3 * PageSize ) == 0 );
+    TEST_CHECK( pView[12 * PageSize] == 0xab && pView[12 * PageSize + 199] == 0xab );
+    TEST_CHECK( pView[13 * PageSize - 1] == 0xab );
+
+    // A range that is exactly page 13 releases it
+    memset( pView + 13 * PageSize, 0xab, PageSize );
+    SDKMeshReleaseFileViewPages( pView + 13 * PageSize, PageSize );
+    TEST_CHECK( memcmp( pView + 13 * PageSize, pExpected + 13 * PageSize, PageSize ) == 0 );
+
+    // A range inside page 14, or one page long but straddling 14 and 15, releases nothing
+    memset( pView + 14 * PageSize, 0xab, 2 * PageSize );
+    SDKMeshReleaseFileViewPages( pView + 14 * PageSize + 1, PageSize - 2 );
+    SDKMeshReleaseFileViewPages( pView + 14 * PageSize + 1, PageSize );
+    TEST_CHECK( pView[14 * PageSize] == 0xab && pView[15 * PageSize] == 0xab );
+    TEST_CHECK( pView[16 * PageSize - 1] == 0xab );
+
+    SDKMeshReleaseFileViewPages( NULL, PageSize * 4 );
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    char szPath[] = "/tmp/TestSDKmeshMappingXXXXXX";
+    int fd = mkstemp( szPath );
+    TEST_CHECK( fd >= 0 );
+    if( fd < 0 )
+        return TestResult();
+
+    BYTE* pExpected = new BYTE[TEST_FILE_BYTES];
+    for( size_t i = 0; i < TEST_FILE_BYTES; i++ )
+        pExpected[i] = TestByte( i );
+    TEST_CHECK( write( fd, pExpected, TEST_FILE_BYTES ) == TEST_FILE_BYTES );
+
+    HANDLE hMapping = NULL;
+    BYTE* pView = NULL;
+    TEST_CHECK( SDKMeshMapFileView( ( HANDLE )( intptr_t )fd, 0, &hMapping, &pView ) == E_INVALIDARG );
+    TEST_CHECK( SDKMeshMapFileView( ( HANDLE )( intptr_t )fd, TEST_FILE_BYTES, &hMapping, &pView ) == S_OK );
+    TEST_CHECK( pView != NULL && hMapping == NULL );
+
+    // The file can be closed once the view exists
+    close( fd );
+
+    if( pView )
+    {
+        TEST_CHECK( memcmp( pView, pExpected, TEST_FILE_BYTES ) == 0 );
+
+        // Writes show in the view but not in the file
+        memset( pView + 4096, 0xcd, 8192 );
+        pView[TEST_FILE_BYTES - 1] = ( BYTE )~pView[TEST_FILE_BYTES - 1];
+        TEST_CHECK( pView[4096] == 0xcd && pView[4096 + 8191] == 0xcd );
+
+        // Untouched pages dropped from the working set come back from the file
+        SDKMeshReleaseFileViewPages( pView + 65536 + 100, 262144 );
+        TEST_CHECK( memcmp( pView + 65536, pExpected + 65536, 262144 + 4096 ) == 0 );
+
+        if( ( size_t )sysconf( _SC_PAGESIZE ) * 16 <= TEST_FILE_BYTES )
+            TestReleaseRounding( pView, pExpected );
+
+        SDKMeshUnmapFileView( hMapping, pView, TEST_FILE_BYTES );
+    }
+
+    BYTE* pOnDisk = new BYTE[TEST_FILE_BYTES];
+    fd = open( szPath, O_RDONLY );
+    TEST_CHECK( fd >= 0 && read( fd, pOnDisk, TEST_FILE_BYTES ) == TEST_FILE_BYTES );
+    TEST_CHECK( memcmp( pOnDisk, pExpected, TEST_FILE_BYTES ) == 0 );
+    if( fd >= 0 )
+        close( fd );
+    unlink( szPath );
+
+    delete[] pOnDisk;
+    delete[] pExpected;
+    return TestResult();
+}
@@ -0,0 +1,196 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshOptimize.cpp
+//
+// Checks how SDKmeshOptimize.cpp groups subsets that share or overlap index ranges,
+// which decides the subsets OptimizeVertexCache reorders, how it splits them into the
+// disjoint ranges CreateAdjacencyIndices runs its jobs on, and that reordering a grid
+// keeps its triangles and lowers its cache misses
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestWindows.h"
+#include "TestCommon.h"
+#include "../SDKmeshOptimize.cpp"
+
+//--------------------------------------------------------------------------------------
+// Shared ranges (0, 1), a partial overlap (2, 3) and a chain through a range that
+// overlaps two others (5, 6, 7) are groups; ranges that only touch (3, 4), sit in
+// another buffer (8) or are empty (9) are not.
+//--------------------------------------------------------------------------------------
+static void TestGroups()
+{
+    const SDKMESH_INDEX_RANGE Ranges[] =
+    {
+        { 0, 0, 30 },
+        { 0, 0, 30 },
+        { 0, 30, 12 },
+        { 0, 36, 12 },
+        { 0, 48, 6 },
+        { 0, 100, 6 },
+        { 0, 103, 9 },
+        { 0, 110, 30 },
+        { 1, 0, 30 },
+        { 0, 10, 0 },
+    };
+    const UINT Expected[] = { 0, 0, 2, 2, 4, 5, 5, 5, 8, 9 };
+    const UINT NumRanges = sizeof( Ranges ) / sizeof( Ranges[0] );
+
+    // OptimizeVertexCache reorders a group's first range when the group's subsets all
+    // share it, and nothing in a group that partly overlaps
+    const bool Reordered[] = { true, false, false, false, true, false, false, false, true, true };
+
+    UINT Group[NumRanges];
+    bool bSameRange[NumRanges];
+    TEST_CHECK( SDKMeshGroupIndexRanges( Ranges, NumRanges, Group, bSameRange ) == S_OK );
+    for( UINT i = 0; i < NumRanges; i++ )
+    {
+        bool bReordered = ( Group[i] == i && bSameRange[i] );
+        if( Group[i] != Expected[i] || bReordered != Reordered[i] )
+        {
+            fprintf( stderr, "range %u: group %u, expected %u, reordered %d\n", i, Group[i], Expected[i],
+                     bReordered );
+            g_NumTestFailures++;
+        }
+    }
+
+    // Listing the ranges in another order names each group by its lowest range still
+    const SDKMESH_INDEX_RANGE Reversed[] = { Ranges[7], Ranges[6], Ranges[5], Ranges[1], Ranges[0] };
+    const UINT ExpectedReversed[] = { 0, 0, 0, 3, 3 };
+    UINT GroupReversed[5];
+    TEST_CHECK( SDKMeshGroupIndexRanges( Reversed, 5, GroupReversed ) == S_OK );
+    TEST_CHECK( memcmp( GroupReversed, ExpectedReversed, sizeof( ExpectedReversed ) ) == 0 );
+
+    TEST_CHECK( SDKMeshGroupIndexRanges( NULL, 0, NULL ) == S_OK );
+}
+
+//--------------------------------------------------------------------------------------
+// Shared ranges over the same vertices (0, 1) and a partial overlap over the same
+// vertices (2, 3) merge into their lowest range. A partial overlap over other vertices
+// (4, 5, 6) and one whose triangles don't line up (7, 8) are clipped, so the triangles
+// past the overlap still get a range. Range 9 is rounded down to whole triangles.
+//--------------------------------------------------------------------------------------
+static void TestSplit()
+{
+    SDKMESH_INDEX_RANGE Ranges[] =
+    {
+        { 0, 0, 30 },
+        { 0, 0, 30 },
+        { 0, 60, 12 },
+        { 0, 66, 12 },
+        { 0, 100, 30 },
+        { 0, 118, 30 },
+        { 0, 109, 9 },
+        { 0, 200, 12 },
+        { 0, 205, 12 },
+        { 1, 0, 8 },
+    };
+    const UINT64 MergeKeys[] = { 5, 5, 5, 5, 1, 2, 3, 5, 5, 0 };
+    const SDKMESH_INDEX_RANGE Expected[] =
+    {
+        { 0, 0, 30 },
+        { 0, 0, 0 },
+        { 0, 60, 18 },
+        { 0, 66, 0 },
+        { 0, 100, 30 },
+        { 0, 130, 18 },
+        { 0, 118, 0 },
+        { 0, 200, 12 },
+        { 0, 214, 3 },
+        { 1, 0, 6 },
+    };
+    const UINT NumRanges = sizeof( Ranges ) / sizeof( Ranges[0] );
+
+    TEST_CHECK( SDKMeshSplitIndexRanges( Ranges, NumRanges, MergeKeys ) == S_OK );
+    for( UINT i = 0; i < NumRanges; i++ )
+    {
+        if( Ranges[i].iBuffer != Expected[i].iBuffer || Ranges[i].IndexCount != Expected[i].IndexCount ||
+            ( Expected[i].IndexCount > 0 && Ranges[i].IndexStart != Expected[i].IndexStart ) )
+        {
+            fprintf( stderr, "range %u: %u %u, expected %u %u\n", i, ( UINT )Ranges[i].IndexStart,
+                     ( UINT )Ranges[i].IndexCount, ( UINT )Expected[i].IndexStart, ( UINT )Expected[i].IndexCount );
+            g_NumTestFailures++;
+        }
+    }
+
+    // Every index is in one range at most, and only the two that 8's clip rounds past
+    // have been dropped
+    UINT Covered[256] = { 0 };
+    for( UINT i = 0; i < NumRanges; i++ )
+    {
+        for( UINT64 j = 0; Ranges[i].iBuffer == 0 && j < Ranges[i].IndexCount; j++ )
+            Covered[Ranges[i].IndexStart + j]++;
+    }
+    const UINT Spans[][2] = { { 0, 30 }, { 60, 78 }, { 100, 148 }, { 200, 212 }, { 214, 217 } };
+    for( UINT i = 0; i < 256; i++ )
+    {
+        UINT Wanted = 0;
+        for( UINT j = 0; j < 5; j++ )
+            Wanted += ( i >= Spans[j][0] && i < Spans[j][1] ) ? 1 : 0;
+        TEST_CHECK( Covered[i] == Wanted );
+    }
+
+    TEST_CHECK( SDKMeshSplitIndexRanges( NULL, 0, NULL ) == S_OK );
+}
+
+//--------------------------------------------------------------------------------------
+// A 16x16 quad grid listed row by row, reordered: the same triangles
+// with the same winding come back, with fewer FIFO misses
+//--------------------------------------------------------------------------------------
+static void TestGridFaces()
+{
+    const UINT Size = 16;
+    const UINT NumIndices = Size * Size * 6;
+    const UINT NumVertices = ( Size + 1 ) * ( Size + 1 );
+    UINT Indices[NumIndices];
+    UINT n = 0;
+    for( UINT y = 0; y < Size; y++ )
+    {
+        for( UINT x = 0; x < Size; x++ )
+        {
+            UINT v = y * ( Size + 1 ) + x;
+            UINT Quad[6] = { v, v + 1, v + Size + 1, v + 1, v + Size + 2, v + Size + 1 };
+            for( UINT i = 0; i < 6; i++ )
+                Indices[n++] = Quad[i];
+        }
+    }
+
+    UINT Optimized[NumIndices];
+    TEST_CHECK( SDKMeshOptimizeFaces( Indices, NumIndices, NumVertices, Optimized ) == S_OK );
+
+    // Every triangle comes back, possibly rotated but with its winding
+    UINT NumFound = 0;
+    for( UINT t = 0; t < NumIndices; t += 3 )
+    {
+        for( UINT r = 0; r < 3; r++ )
+        {
+            bool bFound = false;
+            for( UINT u = 0; u < NumIndices && !bFound; u += 3 )
+                bFound = Optimized[u] == Indices[t + r] && Optimized[u + 1] == Indices[t + ( r + 1 ) % 3] &&
+                         Optimized[u + 2] == Indices[t + ( r + 2 ) % 3];
+            if( bFound )
+            {
+                NumFound++;
+                break;
+            }
+        }
+    }
+    TEST_CHECK( NumFound == NumIndices / 3 );
+
+    UINT NumMissesBefore = 0, NumMissesAfter = 0, NumUsed = 0;
+    TEST_CHECK( SDKMeshAnalyzeVertexCache( Indices, NumIndices, NumVertices, SDKMESH_MEASURE_CACHE_SIZE,
+                                           &NumMissesBefore, &NumUsed ) == S_OK );
+    TEST_CHECK( SDKMeshAnalyzeVertexCache( Optimized, NumIndices, NumVertices, SDKMESH_MEASURE_CACHE_SIZE,
+                                           &NumMissesAfter, NULL ) == S_OK );
+    TEST_CHECK( NumUsed == NumVertices );
+    TEST_CHECK( NumMissesAfter < NumMissesBefore );
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestGroups();
+    TestSplit();
+    TestGridFaces();
+
+    return TestResult();
+}
@@ -0,0 +1,239 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshQuantize.cpp
+//
+// Packs a stream through SDKmeshQuantize.cpp, decodes it the way a shader reading the
+// packed layout would, and checks each element against the bound its format allows:
+// half a SNORM16 step of the stream's bounds for positions, a small angle for the
+// octahedral directions, and half precision for texture coordinates
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestD3DX.h"
+#include "TestCommon.h"
+
+// SDKmeshQuantize.cpp only needs the quantization declarations from SDKMesh.h
+#define _SDKMESH_
+#define MAX_VERTEX_ELEMENTS 32
+#include "../SDKmeshQuantize.h"
+#include "../SDKmeshQuantize.cpp"
+
+// 16 bit octahedral directions land within about 0.006 degrees
+#define TEST_MAX_DIRECTION_ERROR 1e-4f
+
+//--------------------------------------------------------------------------------------
+struct TEST_QUANTIZE_VERTEX
+{
+    float Position[3];
+    float Normal[3];
+    float Tangent[4];
+    float TexCoord[2];
+    DWORD Color;
+};
+
+static float Random( UINT* pSeed, float fMin, float fMax )
+{
+    *pSeed = *pSeed * 1664525 + 1013904223;
+    return fMin + ( fMax - fMin ) * ( float )( *pSeed >> 8 ) / ( float )( 1 << 24 );
+}
+
+static void Normalize( float* p )
+{
+    float Length = sqrtf( p[0] * p[0] + p[1] * p[1] + p[2] * p[2] );
+    for( UINT c = 0; c < 3; c++ )
+        p[c] /= Length;
+}
+
+static float Snorm16( SHORT s )
+{
+    return max( -1.0f, s / 32767.0f );
+}
+
+// The decode a shader does on the SHORT2N pair
+static void DecodeDirection( const SHORT* pIn, float* pDir )
+{
+    float u = Snorm16( pIn[0] ), v = Snorm16( pIn[1] );
+    float z = 1.0f - fabsf( u ) - fabsf( v );
+    if( z < 0.0f )
+    {
+        float FoldU = ( 1.0f - fabsf( v ) ) * ( u >= 0.0f ? 1.0f : -1.0f );
+        v = ( 1.0f - fabsf( u ) ) * ( v >= 0.0f ? 1.0f : -1.0f );
+        u = FoldU;
+    }
+    pDir[0] = u;
+    pDir[1] = v;
+    pDir[2] = z;
+    Normalize( pDir );
+}
+
+// acos loses small angles to rounding, so this takes the angle from sine and cosine
+static float GetAngle( const float* pA, const float* pB )
+{
+    double Cross[3] =
+    {
+        ( double )pA[1] * pB[2] - ( double )pA[2] * pB[1],
+        ( double )pA[2] * pB[0] - ( double )pA[0] * pB[2],
+        ( double )pA[0] * pB[1] - ( double )pA[1] * pB[0],
+    };
+    double Dot = ( double )pA[0] * pB[0] + ( double )pA[1] * pB[1] + ( double )pA[2] * pB[2];
+    return ( float )atan2( sqrt( Cross[0] * Cross[0] + Cross[1] * Cross[1] + Cross[2] * Cross[2] ), Dot );
+}
+
+//--------------------------------------------------------------------------------------
+// Directions cover the axes, the octahedron's edges and the fold at z = 0, where the
+// encoding is least even, plus random ones. Positions sit in an off-center box with
+// very different extents per axis.
+//--------------------------------------------------------------------------------------
+static void TestRoundTrip()
+{
+    const float Special[][3] =
+    {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+        { 1, 1, 1 }, { -1, 1, -1 }, { 1, -1, -1 }, { -1, -1, 1 }, { 1, 1, 0 }, { -1, 0, -1 },
+        { 1, 0, -1e-6f }, { 0.3f, -0.7f, -1e-6f }, { 1e-6f, 1e-6f, -1 }, { -1e-6f, 1e-6f, -1 },
+    };
+    const UINT NumSpecial = sizeof( Special ) / sizeof( Special[0] );
+    const UINT NumVertices = 4096;
+    const float BoxMin[3] = { -3.0f, 10.0f, -100.0f };
+    const float BoxMax[3] = { 5.0f, 10.5f, 200.0f };
+
+    TEST_QUANTIZE_VERTEX* pVertices = new TEST_QUANTIZE_VERTEX[NumVertices];
+    UINT Seed = 12345;
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        TEST_QUANTIZE_VERTEX* pVertex = &pVertices[v];
+        for( UINT c = 0; c < 3; c++ )
+        {
+            // The first two vertices pin the bounds
+            pVertex->Position[c] = ( v < 2 ) ? ( v == 0 ? BoxMin[c] : BoxMax[c] ) : Random( &Seed, BoxMin[c], BoxMax[c] );
+            pVertex->Normal[c] = ( v < NumSpecial ) ? Special[v][c] : Random( &Seed, -1.0f, 1.0f );
+            pVertex->Tangent[c] = Random( &Seed, -1.0f, 1.0f );
+        }
+        Normalize( pVertex->Normal );
+        Normalize( pVertex->Tangent );
+        pVertex->Tangent[3] = ( v & 1 ) ? -1.0f : 1.0f;
+        pVertex->TexCoord[0] = Random( &Seed, -4.0f, 4.0f );
+        pVertex->TexCoord[1] = Random( &Seed, 0.0f, 1.0f );
+        pVertex->Color = 0x80ff4020 + v;
+    }
+
+    const D3DVERTEXELEMENT9 Decl[] =
+    {
+        { 0, 0, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+        { 0, 12, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL, 0 },
+        { 0, 24, D3DDECLTYPE_FLOAT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TANGENT, 0 },
+        { 0, 40, D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0 },
+        { 0, 48, D3DDECLTYPE_D3DCOLOR, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_COLOR, 0 },
+        D3DDECL_END()
+    };
+
+    SDKMESH_QUANTIZED_STREAM Stream;
+    TEST_CHECK( SDKMeshQuantizeStream( Decl, sizeof( TEST_QUANTIZE_VERTEX ), NumVertices, ( const BYTE* )pVertices,
+                                       &Stream ) == S_OK );
+
+    // SHORT4N, SHORT2N, SHORT4N, FLOAT16_2 and the color as it was
+    const BYTE PackedTypes[] = { D3DDECLTYPE_SHORT4N, D3DDECLTYPE_SHORT2N, D3DDECLTYPE_SHORT4N,
+                                 D3DDECLTYPE_FLOAT16_2, D3DDECLTYPE_D3DCOLOR };
+    const WORD PackedOffsets[] = { 0, 8, 12, 20, 24 };
+    TEST_CHECK( Stream.StrideBytes == 28 && Stream.SizeBytes == 28 * NumVertices );
+    TEST_CHECK( Stream.NumLayoutElements == 5 && Stream.Decl[5].Stream == 0xff );
+    for( UINT i = 0; i < 5; i++ )
+    {
+        TEST_CHECK( Stream.Decl[i].Type == PackedTypes[i] && Stream.Decl[i].Offset == PackedOffsets[i] );
+        TEST_CHECK( Stream.Layout[i].Format == SDKMeshGetDeclTypeFormat( PackedTypes[i] ) );
+        TEST_CHECK( Stream.Layout[i].AlignedByteOffset == PackedOffsets[i] );
+    }
+
+    const float* pBias = &Stream.PositionBias.x;
+    const float* pScale = &Stream.PositionScale.x;
+    float MaxPositionError = 0.0f, MaxNormalError = 0.0f, MaxTexCoordError = 0.0f;
+    UINT NumPositionFailures = 0, NumNormalFailures = 0, NumOtherFailures = 0;
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        const TEST_QUANTIZE_VERTEX* pSource = &pVertices[v];
+        const BYTE* pPacked = Stream.pVertices + v * Stream.StrideBytes;
+        const SHORT* pPosition = ( const SHORT* )pPacked;
+
+        // Each component is within half a step of the stream's bounds, give or take
+        // float rounding of the bias
+        float Error = 0.0f;
+        for( UINT c = 0; c < 3; c++ )
+        {
+            float Delta = pBias[c] + pScale[c] * Snorm16( pPosition[c] ) - pSource->Position[c];
+            float Bound = pScale[c] * 0.5f / 32767.0f + fabsf( pSource->Position[c] ) * FLT_EPSILON * 2;
+            NumPositionFailures += ( fabsf( Delta ) > Bound ) ? 1 : 0;
+            Error += Delta * Delta;
+        }
+        MaxPositionError = max( MaxPositionError, sqrtf( Error ) );
+        NumPositionFailures += ( pPosition[3] != 32767 ) ? 1 : 0;
+
+        float Normal[3], Tangent[3];
+        const SHORT* pTangent = ( const SHORT* )( pPacked + 12 );
+        DecodeDirection( ( const SHORT* )( pPacked + 8 ), Normal );
+        DecodeDirection( pTangent, Tangent );
+        float NormalError = max( GetAngle( Normal, pSource->Normal ), GetAngle( Tangent, pSource->Tangent ) );
+        MaxNormalError = max( MaxNormalError, NormalError );
+        NumNormalFailures += ( NormalError > TEST_MAX_DIRECTION_ERROR ) ? 1 : 0;
+        NumNormalFailures += ( pTangent[2] != ( pSource->Tangent[3] < 0.0f ? -32767 : 32767 ) ) ? 1 : 0;
+
+        float TexCoord[2];
+        D3DXFloat16To32Array( TexCoord, ( const D3DXFLOAT16* )( pPacked + 20 ), 2 );
+        for( UINT c = 0; c < 2; c++ )
+        {
+            float Delta = fabsf( TexCoord[c] - pSource->TexCoord[c] );
+            MaxTexCoordError = max( MaxTexCoordError, Delta );
+            NumOtherFailures += ( Delta > fabsf( pSource->TexCoord[c] ) * ldexpf( 1.0f, -11 ) ) ? 1 : 0;
+        }
+        NumOtherFailures += ( memcmp( pPacked + 24, &pSource->Color, sizeof( DWORD ) ) != 0 ) ? 1 : 0;
+    }
+    TEST_CHECK( NumPositionFailures == 0 );
+    TEST_CHECK( NumNormalFailures == 0 );
+    TEST_CHECK( NumOtherFailures == 0 );
+
+    // The stream reports the errors it was packed with
+    const float PositionBound = sqrtf( pScale[0] * pScale[0] + pScale[1] * pScale[1] + pScale[2] * pScale[2] ) *
+                                0.5f / 32767.0f;
+    TEST_CHECK( fabsf( Stream.MaxPositionError - MaxPositionError ) <= PositionBound * 0.01f );
+    TEST_CHECK( Stream.MaxPositionError <= PositionBound * 1.01f );
+    TEST_CHECK( fabsf( Stream.MaxNormalError - MaxNormalError ) <= TEST_MAX_DIRECTION_ERROR * 0.5f );
+    TEST_CHECK( Stream.MaxNormalError <= TEST_MAX_DIRECTION_ERROR );
+    TEST_CHECK( fabsf( Stream.MaxTexCoordError - MaxTexCoordError ) <= 1e-6f );
+
+    delete []Stream.pVertices;
+    delete []pVertices;
+}
+
+//--------------------------------------------------------------------------------------
+// A stream with nothing to pack is left alone, and a flat one doesn't divide by zero
+//--------------------------------------------------------------------------------------
+static void TestUnpacked()
+{
+    const D3DVERTEXELEMENT9 ColorDecl[] =
+    {
+        { 0, 0, D3DDECLTYPE_D3DCOLOR, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_COLOR, 0 },
+        D3DDECL_END()
+    };
+    DWORD Colors[4] = { 1, 2, 3, 4 };
+    SDKMESH_QUANTIZED_STREAM Stream;
+    TEST_CHECK( SDKMeshQuantizeStream( ColorDecl, sizeof( DWORD ), 4, ( const BYTE* )Colors, &Stream ) == S_FALSE );
+    TEST_CHECK( Stream.pVertices == NULL && Stream.StrideBytes == 0 );
+
+    const D3DVERTEXELEMENT9 PositionDecl[] =
+    {
+        { 0, 0, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+        D3DDECL_END()
+    };
+    const float Positions[2][3] = { { 1, 2, 3 }, { 1, 5, 3 } };
+    TEST_CHECK( SDKMeshQuantizeStream( PositionDecl, sizeof( Positions[0] ), 2, ( const BYTE* )Positions,
+                                       &Stream ) == S_OK );
+    TEST_CHECK( Stream.MaxPositionError <= 5.0f * FLT_EPSILON * 2 );
+    delete []Stream.pVertices;
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestRoundTrip();
+    TestUnpacked();
+
+    return TestResult();
+}
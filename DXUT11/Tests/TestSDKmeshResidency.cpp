@@ -0,0 +1,230 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshResidency.cpp
+//
+// Drives SDKmeshResidency.cpp the way PrefetchMesh and EvictMesh do, with callbacks
+// that only count, and checks the buffer counts, the callbacks made and the streaming
+// stats for two meshes sharing a vertex buffer, a create that fails part way and
+// bad arguments
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestD3DX.h"
+#include "TestCommon.h"
+
+// SDKmeshResidency.cpp only needs its own declarations from SDKMesh.h
+#define _SDKMESH_
+#include "../SDKmeshResidency.h"
+#include "../SDKmeshResidency.cpp"
+
+#define NUM_TEST_BUFFERS 3
+
+// Vertex buffer i is 1000 * ( i + 1 ) bytes and index buffer i 100 * ( i + 1 )
+struct TEST_DEVICE
+{
+    bool bVertexBufferLive[NUM_TEST_BUFFERS];
+    bool bIndexBufferLive[NUM_TEST_BUFFERS];
+    UINT NumCreates;
+    UINT NumReleases;
+    bool bFailVertices;         // the buffer whose create fails, if any
+    UINT iFailBuffer;
+};
+
+//--------------------------------------------------------------------------------------
+static HRESULT CALLBACK CreateTestBuffer( bool bVertices, UINT iBuffer, void* pContext, UINT64* pSizeBytes )
+{
+    TEST_DEVICE* pDevice = ( TEST_DEVICE* )pContext;
+    if( bVertices == pDevice->bFailVertices && iBuffer == pDevice->iFailBuffer )
+        return E_OUTOFMEMORY;
+
+    bool* pLive = bVertices ? &pDevice->bVertexBufferLive[iBuffer] : &pDevice->bIndexBufferLive[iBuffer];
+    TEST_CHECK( !*pLive );
+    *pLive = true;
+    pDevice->NumCreates++;
+    *pSizeBytes = ( bVertices ? 1000 : 100 ) * ( iBuffer + 1 );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static void CALLBACK ReleaseTestBuffer( bool bVertices, UINT iBuffer, void* pContext )
+{
+    TEST_DEVICE* pDevice = ( TEST_DEVICE* )pContext;
+    bool* pLive = bVertices ? &pDevice->bVertexBufferLive[iBuffer] : &pDevice->bIndexBufferLive[iBuffer];
+    TEST_CHECK( *pLive );
+    *pLive = false;
+    pDevice->NumReleases++;
+}
+
+//--------------------------------------------------------------------------------------
+static void ResetDevice( TEST_DEVICE* pDevice )
+{
+    ZeroMemory( pDevice, sizeof( TEST_DEVICE ) );
+    pDevice->iFailBuffer = UINT_MAX;
+}
+
+static bool CheckStats( const SDKMESH_RESIDENCY* pResidency, UINT NumResidentMeshes, UINT NumResidentBuffers,
+                        UINT64 ResidentBytes, UINT NumUploads, UINT NumEvictions, int Line )
+{
+    const SDKMESH_STREAMING_STATS* pStats = &pResidency->Stats;
+    if( pStats->NumResidentMeshes == NumResidentMeshes && pStats->NumResidentBuffers == NumResidentBuffers &&
+        pStats->ResidentBytes == ResidentBytes && pStats->NumUploads == NumUploads &&
+        pStats->NumEvictions == NumEvictions )
+        return true;
+
+    fprintf( stderr, "line %d: stats %u %u %u %u %u, expected %u %u %u %u %u\n", Line, pStats->NumResidentMeshes,
+             pStats->NumResidentBuffers, ( UINT )pStats->ResidentBytes, pStats->NumUploads, pStats->NumEvictions,
+             NumResidentMeshes, NumResidentBuffers, ( UINT )ResidentBytes, NumUploads, NumEvictions );
+    return false;
+}
+
+#define CHECK_STATS( p, Meshes, Buffers, Bytes, Uploads, Evictions ) \
+    TEST_CHECK( CheckStats( p, Meshes, Buffers, Bytes, Uploads, Evictions, __LINE__ ) )
+
+//--------------------------------------------------------------------------------------
+// Mesh 0 draws from vertex buffers 0 and 1 with index buffer 0, mesh 1 from vertex
+// buffer 0 with index buffer 1. Vertex buffer 0 is created once, and stays until both
+// meshes have been evicted.
+//--------------------------------------------------------------------------------------
+static void TestSharedBuffer()
+{
+    const UINT VertexBuffers0[] = { 0, 1 };
+    const UINT VertexBuffers1[] = { 0 };
+
+    TEST_DEVICE Device;
+    ResetDevice( &Device );
+    SDKMESH_RESIDENCY Residency;
+    TEST_CHECK( SDKMeshCreateResidency( 2, 2, 2, CreateTestBuffer, ReleaseTestBuffer, &Device,
+                                        &Residency ) == S_OK );
+    CHECK_STATS( &Residency, 0, 0, 0, 0, 0 );
+
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers0, 2, 0 ) == S_OK );
+    TEST_CHECK( Residency.pMeshResident[0] && !Residency.pMeshResident[1] );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 1 && Residency.pVertexBufferRefs[1] == 1 );
+    TEST_CHECK( Residency.pIndexBufferRefs[0] == 1 && Residency.pIndexBufferRefs[1] == 0 );
+    TEST_CHECK( Device.NumCreates == 3 );
+    CHECK_STATS( &Residency, 1, 3, 1000 + 2000 + 100, 1, 0 );
+
+    // Prefetching a resident mesh again changes nothing
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers0, 2, 0 ) == S_OK );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 1 && Device.NumCreates == 3 );
+    CHECK_STATS( &Residency, 1, 3, 3100, 1, 0 );
+
+    // Mesh 1 only creates its index buffer
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 1, VertexBuffers1, 1, 1 ) == S_OK );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 2 && Residency.pIndexBufferRefs[1] == 1 );
+    TEST_CHECK( Device.NumCreates == 4 && Device.bIndexBufferLive[1] );
+    CHECK_STATS( &Residency, 2, 4, 3100 + 200, 2, 0 );
+
+    // Evicting mesh 0 keeps the vertex buffer mesh 1 still uses
+    SDKMeshReleaseMesh( &Residency, 0, VertexBuffers0, 2, 0 );
+    TEST_CHECK( !Residency.pMeshResident[0] && Residency.pMeshResident[1] );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 1 && Residency.pVertexBufferRefs[1] == 0 );
+    TEST_CHECK( Device.bVertexBufferLive[0] && !Device.bVertexBufferLive[1] && !Device.bIndexBufferLive[0] );
+    TEST_CHECK( Device.NumReleases == 2 );
+    CHECK_STATS( &Residency, 1, 2, 1000 + 200, 2, 1 );
+
+    // Evicting it again changes nothing
+    SDKMeshReleaseMesh( &Residency, 0, VertexBuffers0, 2, 0 );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 1 && Device.NumReleases == 2 );
+    CHECK_STATS( &Residency, 1, 2, 1200, 2, 1 );
+
+    SDKMeshReleaseMesh( &Residency, 1, VertexBuffers1, 1, 1 );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 0 && Residency.pIndexBufferRefs[1] == 0 );
+    TEST_CHECK( !Device.bVertexBufferLive[0] && !Device.bIndexBufferLive[1] );
+    TEST_CHECK( Device.NumReleases == 4 );
+    CHECK_STATS( &Residency, 0, 0, 0, 2, 2 );
+
+    // Prefetching again creates the buffers again, in the other order
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 1, VertexBuffers1, 1, 1 ) == S_OK );
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers0, 2, 0 ) == S_OK );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 2 && Residency.pVertexBufferRefs[1] == 1 );
+    TEST_CHECK( Residency.pIndexBufferRefs[0] == 1 && Residency.pIndexBufferRefs[1] == 1 );
+    TEST_CHECK( Device.NumCreates == 8 );
+    CHECK_STATS( &Residency, 2, 4, 3300, 4, 2 );
+
+    SDKMeshReleaseMesh( &Residency, 0, VertexBuffers0, 2, 0 );
+    SDKMeshReleaseMesh( &Residency, 1, VertexBuffers1, 1, 1 );
+    TEST_CHECK( Device.NumReleases == 8 );
+    CHECK_STATS( &Residency, 0, 0, 0, 4, 4 );
+
+    SDKMeshDestroyResidency( &Residency );
+    TEST_CHECK( Residency.pMeshResident == NULL && Residency.Stats.NumUploads == 0 );
+}
+
+//--------------------------------------------------------------------------------------
+// A create that fails releases what the prefetch created, but not a buffer another
+// mesh holds, and leaves the mesh as it was
+//--------------------------------------------------------------------------------------
+static void TestFailedCreate()
+{
+    const UINT VertexBuffers0[] = { 0, 1, 2 };
+    const UINT VertexBuffers1[] = { 0 };
+
+    TEST_DEVICE Device;
+    ResetDevice( &Device );
+    SDKMESH_RESIDENCY Residency;
+    TEST_CHECK( SDKMeshCreateResidency( 2, 3, 2, CreateTestBuffer, ReleaseTestBuffer, &Device,
+                                        &Residency ) == S_OK );
+
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 1, VertexBuffers1, 1, 1 ) == S_OK );
+    CHECK_STATS( &Residency, 1, 2, 1200, 1, 0 );
+
+    // Vertex buffer 2 fails after 1 was created
+    Device.bFailVertices = true;
+    Device.iFailBuffer = 2;
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers0, 3, 0 ) == E_OUTOFMEMORY );
+    TEST_CHECK( !Residency.pMeshResident[0] );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 1 && Residency.pVertexBufferRefs[1] == 0 );
+    TEST_CHECK( Device.bVertexBufferLive[0] && !Device.bVertexBufferLive[1] && !Device.bIndexBufferLive[0] );
+    CHECK_STATS( &Residency, 1, 2, 1200, 1, 0 );
+
+    // Then the index buffer, after all three vertex buffers
+    Device.bFailVertices = false;
+    Device.iFailBuffer = 0;
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers0, 3, 0 ) == E_OUTOFMEMORY );
+    TEST_CHECK( Residency.pVertexBufferRefs[0] == 1 && Residency.pVertexBufferRefs[1] == 0 &&
+                Residency.pVertexBufferRefs[2] == 0 );
+    TEST_CHECK( !Device.bVertexBufferLive[1] && !Device.bVertexBufferLive[2] );
+    CHECK_STATS( &Residency, 1, 2, 1200, 1, 0 );
+
+    Device.iFailBuffer = UINT_MAX;
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers0, 3, 0 ) == S_OK );
+    CHECK_STATS( &Residency, 2, 5, 1000 + 2000 + 3000 + 100 + 200, 2, 0 );
+
+    SDKMeshDestroyResidency( &Residency );
+}
+
+//--------------------------------------------------------------------------------------
+static void TestBadArguments()
+{
+    const UINT VertexBuffers[] = { 0, 2 };
+
+    TEST_DEVICE Device;
+    ResetDevice( &Device );
+    SDKMESH_RESIDENCY Residency;
+    TEST_CHECK( SDKMeshCreateResidency( 1, 2, 1, NULL, ReleaseTestBuffer, &Device, &Residency ) == E_INVALIDARG );
+    TEST_CHECK( SDKMeshCreateResidency( 1, 2, 1, CreateTestBuffer, ReleaseTestBuffer, &Device,
+                                        &Residency ) == S_OK );
+
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 1, VertexBuffers, 1, 0 ) == E_INVALIDARG );
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers, 1, 1 ) == E_INVALIDARG );
+    TEST_CHECK( SDKMeshAcquireMesh( &Residency, 0, VertexBuffers, 2, 0 ) == E_INVALIDARG );
+    TEST_CHECK( Device.NumCreates == 0 );
+    CHECK_STATS( &Residency, 0, 0, 0, 0, 0 );
+
+    // Out of range meshes are never resident, so there's nothing to release
+    SDKMeshReleaseMesh( &Residency, 1, VertexBuffers, 1, 0 );
+    TEST_CHECK( Device.NumReleases == 0 );
+
+    SDKMeshDestroyResidency( &Residency );
+    SDKMeshDestroyResidency( NULL );
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestSharedBuffer();
+    TestFailedCreate();
+    TestBadArguments();
+
+    return TestResult();
+}
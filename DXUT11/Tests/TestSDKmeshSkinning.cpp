@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------------------
+// File: TestSDKmeshSkinning.cpp
+//
+// Skins vertices through SDKmeshSkinning.cpp with blend indices of each byte type and
+// checks that every index picks its own bone, then runs the library's benchmark, which
+// compares the SSE path with a scalar one
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TestD3DX.h"
+#include "TestCommon.h"
+#include "../SDKmeshSkinning.h"
+#include "../SDKmeshSkinning.cpp"
+
+//--------------------------------------------------------------------------------------
+static D3DXMATRIX Translation( float x, float y, float z )
+{
+    D3DXMATRIX M;
+    ZeroMemory( &M, sizeof( D3DXMATRIX ) );
+    M._11 = M._22 = M._33 = M._44 = 1.0f;
+    M._41 = x;
+    M._42 = y;
+    M._43 = z;
+    return M;
+}
+
+//--------------------------------------------------------------------------------------
+struct TEST_SKIN_VERTEX
+{
+    float Position[3];
+    BYTE Weights[4];
+    BYTE Indices[4];
+};
+
+//--------------------------------------------------------------------------------------
+// Bone i moves a vertex by ( i, 10 * i, 100 * i ). Each vertex is bound fully to one
+// bone through one of its four index slots, so a wrong index or a wrong slot order
+// lands it somewhere else. The indices are stored in the file's byte order, which for
+// D3DCOLOR is B, G, R, A.
+//--------------------------------------------------------------------------------------
+static void TestIndexType( BYTE IndexType )
+{
+    const UINT NumBones = 200;
+    D3DXMATRIX Bones[NumBones];
+    for( UINT i = 0; i < NumBones; i++ )
+        Bones[i] = Translation( ( float )i, 10.0f * i, 100.0f * i );
+
+    const D3DVERTEXELEMENT9 Decl[] =
+    {
+        { 0, 0, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+        { 0, 12, D3DDECLTYPE_UBYTE4N, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDWEIGHT, 0 },
+        { 0, 16, IndexType, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDINDICES, 0 },
+        D3DDECL_END()
+    };
+
+    // The shader component each stored byte turns into
+    const UINT Slot[4] = { IndexType == D3DDECLTYPE_D3DCOLOR ? 2u : 0u, 1, IndexType == D3DDECLTYPE_D3DCOLOR ? 0u : 2u, 3 };
+
+    const UINT NumVertices = 8;
+    const BYTE Targets[NumVertices] = { 0, 1, 7, 37, 100, 128, 199, 255 };
+    TEST_SKIN_VERTEX Vertices[NumVertices];
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        TEST_SKIN_VERTEX& Vertex = Vertices[v];
+        Vertex.Position[0] = 0.5f;
+        Vertex.Position[1] = -0.25f;
+        Vertex.Position[2] = 2.0f;
+
+        // Weight the slot that shader component v % 4 comes from; the other slots
+        // point at bones that would be visible if they were used
+        UINT iByte = Slot[v % 4];
+        for( UINT i = 0; i < 4; i++ )
+        {
+            Vertex.Weights[i] = 0;
+            Vertex.Indices[i] = ( BYTE )( 150 + i );
+        }
+        Vertex.Weights[v % 4] = 255;
+        Vertex.Indices[iByte] = Targets[v];
+    }
+
+    SDKMESH_SKIN_SOURCE Source;
+    ZeroMemory( &Source, sizeof( SDKMESH_SKIN_SOURCE ) );
+    TEST_CHECK( SDKMeshAddSkinStream( &Source, Decl, ( const BYTE* )Vertices, sizeof( TEST_SKIN_VERTEX ),
+                                      NumVertices ) == S_OK );
+
+    D3DXVECTOR3 Positions[NumVertices];
+    TEST_CHECK( SDKMeshSkinVertices( &Source, Bones, NumBones, Positions, NULL, NULL, false ) == S_OK );
+
+    for( UINT v = 0; v < NumVertices; v++ )
+    {
+        // Out of range indices fall back to bone 0
+        float fBone = Targets[v] < NumBones ? ( float )Targets[v] : 0.0f;
+        D3DXVECTOR3 Expected( 0.5f + fBone, -0.25f + 10.0f * fBone, 2.0f + 100.0f * fBone );
+        if( fabsf( Positions[v].x - Expected.x ) > 1e-3f || fabsf( Positions[v].y - Expected.y ) > 1e-3f ||
+            fabsf( Positions[v].z - Expected.z ) > 1e-2f )
+        {
+            fprintf( stderr, "type %u, vertex %u: got ( %g, %g, %g ), expected bone %g\n", IndexType, v,
+                     Positions[v].x, Positions[v].y, Positions[v].z, fBone );
+            g_NumTestFailures++;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Normalized 16 and 10 bit types can't hold an index
+//--------------------------------------------------------------------------------------
+static void TestRejectedIndexTypes()
+{
+    const BYTE Types[] = { D3DDECLTYPE_SHORT2N, D3DDECLTYPE_SHORT4N, D3DDECLTYPE_USHORT2N, D3DDECLTYPE_USHORT4N,
+                           D3DDECLTYPE_DEC3N };
+    BYTE Vertex[32] = { 0 };
+    for( UINT i = 0; i < sizeof( Types ); i++ )
+    {
+        const D3DVERTEXELEMENT9 Decl[] =
+        {
+            { 0, 0, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+            { 0, 12, Types[i], D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDINDICES, 0 },
+            D3DDECL_END()
+        };
+        SDKMESH_SKIN_SOURCE Source;
+        ZeroMemory( &Source, sizeof( SDKMESH_SKIN_SOURCE ) );
+        TEST_CHECK( SDKMeshAddSkinStream( &Source, Decl, Vertex, sizeof( Vertex ), 1 ) == E_NOTIMPL );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+int main()
+{
+    TestIndexType( D3DDECLTYPE_UBYTE4 );
+    TestIndexType( D3DDECLTYPE_UBYTE4N );
+    TestIndexType( D3DDECLTYPE_D3DCOLOR );
+    TestRejectedIndexTypes();
+
+    SDKMESH_SKIN_BENCHMARK Results;
+    TEST_CHECK( SDKMeshBenchmarkSkinning( 10001, 64, &Results ) == S_OK );
+
+    return TestResult();
+}
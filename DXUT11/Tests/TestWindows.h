@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// File: TestWindows.h
+//
+// Stands in for DXUT.h when a device-free DXUT11 source is compiled into a headless
+// test. It declares only what those sources use, with the Windows sizes, and defines
+// DXUT_H so the real header they include is skipped.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef TESTWINDOWS_H
+#define TESTWINDOWS_H
+
+#define DXUT_H
+
+// The C++ headers come first, before min and max become macros
+#include <stdint.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <emmintrin.h>
+
+typedef int32_t HRESULT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t UINT;
+typedef int32_t LONG;
+typedef uint64_t UINT64;
+typedef size_t SIZE_T;
+
+union LARGE_INTEGER
+{
+    int64_t QuadPart;
+};
+
+#define TRUE            1
+#define FALSE           0
+
+#define S_OK            ((HRESULT)0L)
+#define S_FALSE         ((HRESULT)1L)
+#define E_FAIL          ((HRESULT)0x80004005L)
+#define E_INVALIDARG    ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY   ((HRESULT)0x8007000EL)
+#define SUCCEEDED( hr ) ( ( HRESULT )( hr ) >= 0 )
+#define FAILED( hr )    ( ( HRESULT )( hr ) < 0 )
+
+#define __in
+#define __in_z
+#define __in_opt
+#define __out
+#define __out_opt
+#define __inout
+#define __cdecl
+#define __in_ecount( x )
+#define __out_ecount( x )
+#define __inout_ecount( x )
+#define __out_ecount_opt( x )
+#define __in_bcount( x )
+#define __out_bcount( x )
+#define __inout_bcount( x )
+
+#ifndef min
+#define min( a, b ) ( ( ( a ) < ( b ) ) ? ( a ) : ( b ) )
+#endif
+#ifndef max
+#define max( a, b ) ( ( ( a ) > ( b ) ) ? ( a ) : ( b ) )
+#endif
+
+#define ZeroMemory( p, n )      memset( ( void* )( p ), 0, ( n ) )
+#define CopyMemory( d, s, n )   memcpy( ( void* )( d ), ( s ), ( n ) )
+
+#define SAFE_DELETE_ARRAY( p ) { if( p ) { delete[] ( p ); ( p ) = NULL; } }
+
+inline void* _aligned_malloc( size_t Size, size_t Alignment )
+{
+    void* p = NULL;
+    return posix_memalign( &p, Alignment, Size ) == 0 ? p : NULL;
+}
+
+inline void _aligned_free( void* p )
+{
+    free( p );
+}
+
+inline int QueryPerformanceFrequency( LARGE_INTEGER* pFrequency )
+{
+    pFrequency->QuadPart = 1000000000;
+    return 1;
+}
+
+inline int QueryPerformanceCounter( LARGE_INTEGER* pCounter )
+{
+    timespec Now;
+    clock_gettime( CLOCK_MONOTONIC, &Now );
+    pCounter->QuadPart = ( int64_t )Now.tv_sec * 1000000000 + Now.tv_nsec;
+    return 1;
+}
+
+// DXUTmisc.h's array, as far as the sources use it; elements are copied as bytes
+template<typename TYPE> class CGrowableArray
+{
+public:
+    CGrowableArray()  { m_pData = NULL; m_nSize = 0; m_nMaxSize = 0; }
+    ~CGrowableArray() { RemoveAll(); }
+
+    const TYPE& operator[]( int nIndex ) const { return m_pData[nIndex]; }
+    TYPE& operator[]( int nIndex ) { return m_pData[nIndex]; }
+
+    HRESULT Add( const TYPE& value )
+    {
+        if( m_nSize == m_nMaxSize )
+        {
+            int nNewMaxSize = max( 16, m_nMaxSize * 2 );
+            TYPE* pData = ( TYPE* )realloc( m_pData, sizeof( TYPE ) * nNewMaxSize );
+            if( !pData )
+                return E_OUTOFMEMORY;
+            m_pData = pData;
+            m_nMaxSize = nNewMaxSize;
+        }
+        memcpy( &m_pData[m_nSize++], &value, sizeof( TYPE ) );
+        return S_OK;
+    }
+    int     GetSize() const { return m_nSize; }
+    TYPE*   GetData() { return m_pData; }
+    void    RemoveAll() { free( m_pData ); m_pData = NULL; m_nSize = 0; m_nMaxSize = 0; }
+    void    Reset() { m_nSize = 0; }
+
+protected:
+    TYPE* m_pData;
+    int m_nSize;
+    int m_nMaxSize;
+};
+
+// The D3D11_PRIMITIVE_TOPOLOGY values the draw list looks at
+enum D3D11_PRIMITIVE_TOPOLOGY
+{
+    D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+    D3D11_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+    D3D11_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+    D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+    D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+    D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+    D3D11_PRIMITIVE_TOPOLOGY_LINELIST_ADJ = 10,
+    D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP_ADJ = 11,
+    D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST_ADJ = 12,
+    D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP_ADJ = 13,
+    D3D11_PRIMITIVE_TOPOLOGY_1_CONTROL_POINT_PATCHLIST = 33,
+    D3D11_PRIMITIVE_TOPOLOGY_32_CONTROL_POINT_PATCHLIST = 64,
+};
+
+#endif // TESTWINDOWS_H